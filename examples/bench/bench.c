@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <string.h>
+#include "fagpio.h"
+#include "fagpio_inline.h"
+#include "fagpio_bbspi.h"
+
+/*
+GPIO benchmark for accepting library upgrades. Every operation runs in
+BENCH_BATCHES batches on each available backend and API variant; one CSV
+row per (backend, api, op) goes to stdout:
+
+	backend,api,op,iterations,ns_mean,ns_min,ns_max
+
+ns_min and ns_max are the fastest and slowest batch averages. Drives PE3
+and PE4 as outputs and reads PE5, so leave them unconnected. The driver
+rows clock a bit-banged SPI byte out on them (SCK PE3, MOSI PE4, MISO
+PE5), which also makes the bench the training run of `make pgo`.
+
+	./bench [iterations] > bench.csv
+*/
+
+#define BENCH_BATCHES	100
+#define OUT_PIN			PIO_PIN(PIO_PORT_E, 3)
+#define IN_PIN			PIO_PIN(PIO_PORT_E, 5)
+#define PORT_MASK		(PIO_PIN_MASK(PIO_PIN(PIO_PORT_E, 3)) | PIO_PIN_MASK(PIO_PIN(PIO_PORT_E, 4)))
+
+static struct pio_bank *banks;
+static struct fagpio_bbspi spi;
+static volatile uint32_t sink;		//Keeps the reads from being optimised out
+
+static void op_toggle(long n) {
+	for (long i = 0; i < n; i++)
+		digitalToggle(OUT_PIN);
+}
+
+static void op_write(long n) {
+	for (long i = 0; i < n; i++)
+		digitalWrite(OUT_PIN, i & 1);
+}
+
+static void op_read(long n) {
+	for (long i = 0; i < n; i++)
+		sink = digitalRead(IN_PIN);
+}
+
+static void op_write_port(long n) {
+	for (long i = 0; i < n; i++)
+		digitalWritePort(PIO_PORT_E, PORT_MASK, (i & 1) ? PORT_MASK : 0);
+}
+
+static void op_read_port(long n) {
+	for (long i = 0; i < n; i++)
+		sink = digitalReadPort(PIO_PORT_E);
+}
+
+static void op_pinmode(long n) {
+	for (long i = 0; i < n; i++)
+		pinMode(OUT_PIN, 0);
+}
+
+static void op_pinmode_mask(long n) {
+	for (long i = 0; i < n; i++)
+		pinModeMask(PIO_PORT_E, PORT_MASK, 0);
+}
+
+static void op_write_fast(long n) {
+	for (long i = 0; i < n; i++)
+		digitalWriteFast(banks, OUT_PIN, i & 1);
+}
+
+static void op_read_fast(long n) {
+	for (long i = 0; i < n; i++)
+		sink = digitalReadFast(banks, IN_PIN);
+}
+
+static void op_write_port_fast(long n) {
+	for (long i = 0; i < n; i++)
+		digitalWritePortFast(banks, PIO_PORT_E, PORT_MASK, (i & 1) ? PORT_MASK : 0);
+}
+
+static void op_read_port_fast(long n) {
+	for (long i = 0; i < n; i++)
+		sink = digitalReadPortFast(banks, PIO_PORT_E);
+}
+
+static void op_bbspi_byte(long n) {
+	uint8_t tx = 0xA5, rx;
+
+	for (long i = 0; i < n; i++) {
+		fagpio_bbspi_transfer(&spi, &tx, &rx, 1);
+		tx ^= rx;
+	}
+}
+
+struct bench {
+	const char *api;
+	const char *op;
+	void (*fn)(long n);
+	uint8_t mapped;		//Needs the register mapping
+	uint8_t shadow;
+};
+
+static const struct bench benches[] = {
+	{ "call",   "toggle",       op_toggle,          0, 0 },
+	{ "call",   "write",        op_write,           0, 0 },
+	{ "call",   "read",         op_read,            0, 0 },
+	{ "call",   "write_port",   op_write_port,      0, 0 },
+	{ "call",   "read_port",    op_read_port,       0, 0 },
+	{ "call",   "pinmode",      op_pinmode,         0, 0 },
+	{ "call",   "pinmode_mask", op_pinmode_mask,    0, 0 },
+	{ "shadow", "toggle",       op_toggle,          1, 1 },
+	{ "shadow", "write",        op_write,           1, 1 },
+	{ "shadow", "write_port",   op_write_port,      1, 1 },
+	{ "inline", "write",        op_write_fast,      1, 0 },
+	{ "inline", "read",         op_read_fast,       1, 0 },
+	{ "inline", "write_port",   op_write_port_fast, 1, 0 },
+	{ "inline", "read_port",    op_read_port_fast,  1, 0 },
+	{ "driver", "bbspi_byte",   op_bbspi_byte,      1, 0 },
+};
+
+static double now_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void run(const char *backend, const struct bench *b, long iterations) {
+	long batch = iterations / BENCH_BATCHES;
+	double total = 0, min = 0, max = 0;
+
+	if (batch < 1)
+		batch = 1;
+
+	fagpio_shadow_enable(b->shadow);
+	b->fn(batch);		//Warm-up
+	for (int i = 0; i < BENCH_BATCHES; i++) {
+		double start = now_ns();
+
+		b->fn(batch);
+
+		double ns = now_ns() - start;
+
+		total += ns;
+		ns /= batch;
+		if (!i || ns < min)
+			min = ns;
+		if (ns > max)
+			max = ns;
+	}
+	fagpio_shadow_enable(0);
+
+	printf("%s,%s,%s,%ld,%.1f,%.1f,%.1f\n", backend, b->api, b->op, batch * BENCH_BATCHES,
+		total / (batch * BENCH_BATCHES), min, max);
+}
+
+static void run_backend(const char *backend, long iterations) {
+	setenv("FAGPIO_BACKEND", backend, 1);
+	if (fagpio_setup() < 0 || strcmp(backend, (gpio.backend == FAGPIO_BACKEND_CHIP) ? "chip" :
+			(gpio.backend == FAGPIO_BACKEND_UIO) ? "uio" : "devmem")) {
+		fprintf(stderr, "%s unavailable\n", backend);
+		fagpio_free();
+		return;
+	}
+
+	banks = fagpio_banks();
+	pinModeMask(PIO_PORT_E, PORT_MASK, 0);
+	pinMode(IN_PIN, 1);
+	if (banks)
+		fagpio_bbspi_init(&spi, OUT_PIN, PIO_PIN(PIO_PORT_E, 4), IN_PIN, 0, 0);
+
+	for (unsigned int i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+		if (!benches[i].mapped || banks)
+			run(backend, &benches[i], iterations);
+	}
+
+	fagpio_free();
+}
+
+int main(int argc, char **argv) {
+	long iterations = argc > 1 ? atol(argv[1]) : 100000;
+
+	if (iterations <= 0)
+		iterations = 100000;
+
+	printf("backend,api,op,iterations,ns_mean,ns_min,ns_max\n");
+	run_backend("devmem", iterations);
+	run_backend("uio", iterations);
+	run_backend("chip", iterations);
+
+	return 0;
+}
@@ -1,27 +1,33 @@
 #include <stdio.h>
 #include "fagpio.h"
+#include "fagpio_periodic.h"
+
+#define HALF_PERIOD_NS	118000
 
 int main(void) {
+	struct fagpio_periodic period;
 
 	fagpio_setup();
 
-	pinMode(3, 0);
-	pinMode(4, 0);
-	pinMode(5, 0);
+	pinMode(PIO_PIN(PIO_PORT_E, 3), 0);
+	pinMode(PIO_PIN(PIO_PORT_E, 4), 0);
+	pinMode(PIO_PIN(PIO_PORT_E, 5), 0);
 
+	// Absolute deadlines: the writes do not stretch the period as a usleep() after them would
+	fagpio_periodic_begin(&period, HALF_PERIOD_NS, 20000, NULL, NULL);
 	while(1) {
 
-		digitalWrite(3, 1);
-		digitalWrite(4, 1);
-		digitalWrite(5, 1);
+		digitalWrite(PIO_PIN(PIO_PORT_E, 3), 1);
+		digitalWrite(PIO_PIN(PIO_PORT_E, 4), 1);
+		digitalWrite(PIO_PIN(PIO_PORT_E, 5), 1);
 
-		usleep(118);
+		fagpio_periodic_next(&period);
 
-		digitalWrite(3, 0);
-		digitalWrite(4, 0);
-		digitalWrite(5, 0);
+		digitalWrite(PIO_PIN(PIO_PORT_E, 3), 0);
+		digitalWrite(PIO_PIN(PIO_PORT_E, 4), 0);
+		digitalWrite(PIO_PIN(PIO_PORT_E, 5), 0);
 
-		usleep(118);
+		fagpio_periodic_next(&period);
 	}
 
 	fagpio_free();
@@ -0,0 +1,54 @@
+#include <stdio.h>
+#include "fagpio.h"
+
+/*
+Compares whole-port writes through the register mapping with the gpiochip
+backend. Drives PE3-PE5 as outputs, so leave them unconnected.
+
+	./chipbench [iterations]
+*/
+
+#define BENCH_MASK	(PIO_PIN_MASK(PIO_PIN(PIO_PORT_E, 3)) | PIO_PIN_MASK(PIO_PIN(PIO_PORT_E, 4)) | PIO_PIN_MASK(PIO_PIN(PIO_PORT_E, 5)))
+
+static double now_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int run(const char *backend, long iterations) {
+	setenv("FAGPIO_BACKEND", backend, 1);
+	if (fagpio_setup() < 0) {
+		printf("%-8s unavailable\n", backend);
+		return -1;
+	}
+
+	pinModeMask(PIO_PORT_E, BENCH_MASK, 0);
+
+	double start = now_ns();
+	for (long i = 0; i < iterations; i++)
+		digitalWritePort(PIO_PORT_E, BENCH_MASK, (i & 1) ? BENCH_MASK : 0);
+	double write_ns = (now_ns() - start) / iterations;
+
+	start = now_ns();
+	for (long i = 0; i < iterations; i++)
+		digitalReadPort(PIO_PORT_E);
+	double read_ns = (now_ns() - start) / iterations;
+
+	printf("%-8s port write %8.1f ns  port read %8.1f ns\n", backend, write_ns, read_ns);
+	fagpio_free();
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	long iterations = argc > 1 ? atol(argv[1]) : 100000;
+
+	if (iterations <= 0)
+		iterations = 100000;
+
+	run("devmem", iterations);
+	run("chip", iterations);
+
+	return 0;
+}
@@ -0,0 +1,368 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+#include "fagpio.h"
+#include "fagpio_timer.h"
+#include "fagpio_rt.h"
+#include "fagpio_async.h"
+#include "fagpio_bbspi.h"
+#include "fagpio_spi.h"
+#include "fagpio_bbi2c.h"
+#include "fagpio_twi.h"
+#include "fagpio_ws2812.h"
+#include "fagpio_uart.h"
+#include "fagpio_suart.h"
+#include "fagpio_onewire.h"
+#include "fagpio_lcd.h"
+
+/*
+Sustained throughput of the protocol drivers, for choosing between a
+bit-banged bus and the controller (or DMA) per product. Each driver runs
+back-to-back transactions of len bytes for secs seconds; one CSV row per
+driver goes to stdout:
+
+	driver,len,transactions,errors,bytes_per_s,lat_min_us,lat_median_us,lat_max_us,cpu_pct
+
+Latencies are per transaction on the AVS counter. cpu_pct is the process
+CPU time (user and system, worker threads included) over the wall time,
+so a driver that sleeps while the hardware works shows well under 100.
+
+	./drvbench [-t secs] [-n len] [-p prio] [-l] [driver...] > drv.csv
+
+Without names every driver runs; the controller ones (spi, spi-dma, twi,
+uart) only on a register backend, so on FAGPIO_BACKEND=sim the rest are
+timed against the simulated PIO. Wiring, each row alone:
+ - bbspi: SCK PE3, MOSI PE4, MISO PE5; spi and spi-dma: SPI0 on PC0-PC3
+   (spi-dma needs a DMA pool, FAGPIO_DMA_POOL). With -l, MOSI jumpered
+   to MISO, every byte read back is checked
+ - bbi2c and twi: SCL PE11, SDA PE12, a device at I2C_ADDR (an EEPROM
+   page write); a NAK counts as an error
+ - ws2812: PE0, len / 3 pixels per frame; a late slot is an error
+ - uart: UART2 on PE7/PE8; suart: TX PE10, RX PE13 left an input
+ - onewire: PE6 with its pull-up, a reset then len bytes
+ - lcd: 8080 bus, D0-D7 PE0-PE7, DC PE8, WR PE9
+*/
+
+#define DEF_SECS		2
+#define DEF_LEN			256
+#define LAT_MAX			4096		//Latencies kept for the median, the last ones
+#define SPI_BUS			0
+#define SPI_HZ			12000000
+#define SPI_DMA_CH		0
+#define I2C_ADDR		0x50
+#define I2C_HZ			400000
+#define UART_NUM		2
+#define UART_BAUD		921600
+#define SUART_BAUD		115200
+#define SCK_PIN			PIO_PIN(PIO_PORT_E, 3)
+#define MOSI_PIN		PIO_PIN(PIO_PORT_E, 4)
+#define MISO_PIN		PIO_PIN(PIO_PORT_E, 5)
+#define OW_PIN			PIO_PIN(PIO_PORT_E, 6)
+#define SUART_TX_PIN	PIO_PIN(PIO_PORT_E, 10)
+#define SUART_RX_PIN	PIO_PIN(PIO_PORT_E, 13)
+#define SCL_PIN			PIO_PIN(PIO_PORT_E, 11)
+#define SDA_PIN			PIO_PIN(PIO_PORT_E, 12)
+#define WS_PIN			PIO_PIN(PIO_PORT_E, 0)
+#define LCD_D0_PIN		PIO_PIN(PIO_PORT_E, 0)
+#define LCD_DC_PIN		PIO_PIN(PIO_PORT_E, 8)
+#define LCD_WR_PIN		PIO_PIN(PIO_PORT_E, 9)
+
+struct drv {
+	const char *name;
+	int hw;					//Needs the controller registers
+	int (*open)(void);
+	int (*xfer)(void);		//Bytes moved, -1 failed
+	void (*close)(void);
+};
+
+static size_t len = DEF_LEN;
+static int loopback;
+static uint8_t *tx, *rx;
+
+static struct fagpio_bbspi bbspi;
+static struct fagpio_bbi2c bbi2c;
+static struct fagpio_dmabuf dmabuf;
+static struct fagpio_ws2812 ws;
+static uint32_t *ws_slots;
+static struct fagpio_suart suart;
+static struct fagpio_seq_op *suart_ops;
+static struct fagpio_onewire ow;
+static struct fagpio_lcd lcd;
+
+static int checked(size_t n) {
+	return loopback && memcmp(tx, rx, n) ? -1 : (int)n;
+}
+
+static int bbspi_open(void) {
+	return fagpio_bbspi_init(&bbspi, SCK_PIN, MOSI_PIN, MISO_PIN, 0, 0);
+}
+
+static int bbspi_xfer(void) {
+	fagpio_bbspi_transfer(&bbspi, tx, rx, len);
+	return checked(len);
+}
+
+static int spi_open(void) {
+	return fagpio_spi_open(SPI_BUS, SPI_HZ, 0);
+}
+
+static int spi_xfer(void) {
+	return fagpio_spi_transfer(SPI_BUS, tx, rx, len) < 0 ? -1 : checked(len);
+}
+
+static void spi_close(void) {
+	fagpio_spi_close(SPI_BUS);
+}
+
+static int spi_dma_open(void) {
+	if (fagpio_dmabuf_alloc(&dmabuf, len) < 0)
+		return -1;
+	memcpy((void *)dmabuf.virt, tx, len);
+	if (spi_open() < 0) {
+		fagpio_dmabuf_free(&dmabuf);
+		return -1;
+	}
+	return 0;
+}
+
+// Submitted and waited for asleep, the way a caller that has other work would
+static int spi_dma_xfer(void) {
+	fagpio_async_t t = fagpio_async_spi_write_dma(SPI_BUS, SPI_DMA_CH, &dmabuf, 0, len, NULL, NULL);
+	int result;
+
+	if (t < 0 || fagpio_async_wait(t, &result, 1000) != 1 || result < 0)
+		return -1;
+	return len;
+}
+
+static void spi_dma_close(void) {
+	spi_close();
+	fagpio_dmabuf_free(&dmabuf);
+}
+
+static struct fagpio_i2c_msg i2c_msg(void) {
+	return (struct fagpio_i2c_msg){ I2C_ADDR, 0, len > 0xFFFF ? 0xFFFF : len, tx };
+}
+
+static int bbi2c_open(void) {
+	pinPull(SCL_PIN, PULL_UP);
+	pinPull(SDA_PIN, PULL_UP);
+	return fagpio_bbi2c_init(&bbi2c, SDA_PIN, SCL_PIN, I2C_HZ, 1000);
+}
+
+static int bbi2c_xfer(void) {
+	struct fagpio_i2c_msg m = i2c_msg();
+
+	return fagpio_bbi2c_transfer(&bbi2c, &m, 1) == 1 ? m.len : -1;
+}
+
+static int twi_open(void) {
+	return fagpio_twi_open(0, I2C_HZ);
+}
+
+static int twi_xfer(void) {
+	struct fagpio_i2c_msg m = i2c_msg();
+
+	return fagpio_twi_transfer(0, &m, 1) == 1 ? m.len : -1;
+}
+
+static void twi_close(void) {
+	fagpio_twi_close(0);
+}
+
+static int ws_open(void) {
+	unsigned int pixels = len / 3 ? len / 3 : 1;
+
+	ws_slots = malloc(pixels * 24 * sizeof(*ws_slots));
+	return ws_slots ? fagpio_ws2812_init(&ws, WS_PIN, 1, ws_slots, pixels) : -1;
+}
+
+static int ws_xfer(void) {
+	const uint8_t *grb[1] = { tx };
+	unsigned int pixels = ws.max_pixels;
+
+	if (fagpio_ws2812_compile(&ws, grb, pixels) < 0 || fagpio_ws2812_show(&ws))
+		return -1;
+	return pixels * 3;
+}
+
+static void ws_close(void) {
+	free(ws_slots);
+}
+
+static int uart_open(void) {
+	return fagpio_uart_open(UART_NUM, UART_BAUD, UART_NO_PIN);
+}
+
+static int uart_xfer(void) {
+	return fagpio_uart_write(UART_NUM, tx, len) == (int)len ? (int)len : -1;
+}
+
+static void uart_close(void) {
+	fagpio_uart_close(UART_NUM);
+}
+
+static int suart_open(void) {
+	unsigned int nops = len * 10 + 1;
+
+	suart_ops = malloc(nops * sizeof(*suart_ops));
+	return suart_ops ? fagpio_suart_init(&suart, SUART_TX_PIN, SUART_RX_PIN, SUART_BAUD, suart_ops, nops) : -1;
+}
+
+static int suart_xfer(void) {
+	return fagpio_suart_write(&suart, tx, len) == (int)len ? (int)len : -1;
+}
+
+static void suart_close(void) {
+	free(suart_ops);
+}
+
+static int ow_open(void) {
+	return fagpio_onewire_init(&ow, OW_PIN);
+}
+
+static int ow_xfer(void) {
+	fagpio_onewire_reset(&ow);
+	for (size_t i = 0; i < len; i++)
+		fagpio_onewire_write(&ow, tx[i]);
+	return len;
+}
+
+static int lcd_open(void) {
+	return fagpio_lcd_init(&lcd, LCD_D0_PIN, LCD_DC_PIN, LCD_WR_PIN, FAGPIO_LCD_NO_PIN, FAGPIO_LCD_8080, 0);
+}
+
+static int lcd_xfer(void) {
+	fagpio_lcd_data(&lcd, tx, len);
+	return len;
+}
+
+static const struct drv drvs[] = {
+	{ "bbspi", 0, bbspi_open, bbspi_xfer, NULL },
+	{ "spi", 1, spi_open, spi_xfer, spi_close },
+	{ "spi-dma", 1, spi_dma_open, spi_dma_xfer, spi_dma_close },
+	{ "bbi2c", 0, bbi2c_open, bbi2c_xfer, NULL },
+	{ "twi", 1, twi_open, twi_xfer, twi_close },
+	{ "ws2812", 0, ws_open, ws_xfer, ws_close },
+	{ "uart", 1, uart_open, uart_xfer, uart_close },
+	{ "suart", 0, suart_open, suart_xfer, suart_close },
+	{ "onewire", 0, ow_open, ow_xfer, NULL },
+	{ "lcd", 0, lcd_open, lcd_xfer, NULL },
+};
+
+static double now_s(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double cpu_s(void) {
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1e-6;
+}
+
+static int cmp_u32(const void *a, const void *b) {
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void run(const struct drv *d, double secs) {
+	static uint32_t lat[LAT_MAX];
+	uint32_t min = UINT32_MAX, max = 0;
+	unsigned long count = 0, errors = 0;
+	unsigned long long bytes = 0;
+
+	if (d->open() < 0) {
+		fprintf(stderr, "%s: could not be opened, skipped\n", d->name);
+		return;
+	}
+	d->xfer();		//Warm-up: first-touch faults, lazy mappings
+
+	double t0 = now_s(), c0 = cpu_s(), t;
+
+	do {
+		uint32_t start = fagpio_ticks();
+		int n = d->xfer();
+		uint32_t ticks = fagpio_ticks() - start;
+
+		if (n < 0)
+			errors++;
+		else
+			bytes += n;
+		lat[count++ % LAT_MAX] = ticks;
+		if (ticks < min)
+			min = ticks;
+		if (ticks > max)
+			max = ticks;
+		t = now_s();
+	} while (t - t0 < secs);
+
+	double wall = t - t0, cpu = cpu_s() - c0;
+	unsigned long kept = count < LAT_MAX ? count : LAT_MAX;
+
+	if (d->close)
+		d->close();
+	qsort(lat, kept, sizeof(*lat), cmp_u32);
+	printf("%s,%zu,%lu,%lu,%.0f,%.1f,%.1f,%.1f,%.1f\n", d->name, len, count, errors, bytes / wall,
+		fagpio_ticks_to_ns(min) / 1e3, fagpio_ticks_to_ns(lat[kept / 2]) / 1e3, fagpio_ticks_to_ns(max) / 1e3,
+		100 * cpu / wall);
+	fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+	double secs = DEF_SECS;
+	int prio = 0, c;
+
+	while ((c = getopt(argc, argv, "t:n:p:l")) != -1) {
+		switch (c) {
+		case 't': secs = atof(optarg); break;
+		case 'n': len = strtoul(optarg, NULL, 0); break;
+		case 'p': prio = atoi(optarg); break;
+		case 'l': loopback = 1; break;
+		default:
+			fprintf(stderr, "usage: %s [-t secs] [-n len] [-p prio] [-l] [driver...]\n", argv[0]);
+			return 2;
+		}
+	}
+	if (!len)
+		len = DEF_LEN;
+	if (fagpio_setup() < 0)
+		return 1;
+	if (prio && fagpio_rt_enter(prio) < 0)
+		fprintf(stderr, "no real-time scheduling, timings include preemption\n");
+
+	int backend = fagpio_handle_backend(fagpio_default());
+	int regs = backend == FAGPIO_BACKEND_DEVMEM || backend == FAGPIO_BACKEND_UIO;
+
+	tx = malloc(len);
+	rx = malloc(len);
+	if (!tx || !rx)
+		return 1;
+	for (size_t i = 0; i < len; i++)
+		tx[i] = i * 37 + 11;
+
+	printf("driver,len,transactions,errors,bytes_per_s,lat_min_us,lat_median_us,lat_max_us,cpu_pct\n");
+	for (size_t i = 0; i < sizeof(drvs) / sizeof(drvs[0]); i++) {
+		const struct drv *d = &drvs[i];
+		int wanted = optind == argc;
+
+		for (int a = optind; a < argc; a++)
+			wanted |= !strcmp(argv[a], d->name);
+		if (!wanted)
+			continue;
+		if (d->hw && !regs) {
+			fprintf(stderr, "%s: needs the controller registers, skipped on this backend\n", d->name);
+			continue;
+		}
+		run(d, secs);
+	}
+	fagpio_free();
+	return 0;
+}
@@ -0,0 +1,110 @@
+#include <poll.h>
+#include <stdio.h>
+#include "fagpio.h"
+#include "fagpio_eint.h"
+#include "fagpio_timer.h"
+
+/*
+Edge-to-userspace latency. Jumper PE3 (output) to PE4 (EINT input): each
+round raises PE3 and measures until this process sees the edge:
+
+	poll     sleeping in poll() on the PE EINT UIO fd (needs fagpio-eint-pe)
+	busy     spinning on digitalReadPort(PIO_PORT_E)
+
+Percentiles of both are printed in ns.
+
+	./irqlatency [rounds]
+*/
+
+#define DRIVE_PIN	PIO_PIN(PIO_PORT_E, 3)
+#define SENSE_PIN	PIO_PIN(PIO_PORT_E, 4)
+#define MAX_ROUNDS	100000
+
+static uint32_t lat[MAX_ROUNDS];
+
+static int cmp_u32(const void *a, const void *b) {
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void report(const char *name, int n) {
+	static const double pct[] = { 50, 90, 99, 99.9 };
+
+	if (!n) {
+		printf("%-6s no samples\n", name);
+		return;
+	}
+	qsort(lat, n, sizeof(lat[0]), cmp_u32);
+	printf("%-6s n=%d min %u", name, n, fagpio_ticks_to_ns(lat[0]));
+	for (unsigned int i = 0; i < sizeof(pct) / sizeof(pct[0]); i++)
+		printf("  p%g %u", pct[i], fagpio_ticks_to_ns(lat[(int)(pct[i] / 100 * (n - 1))]));
+	printf("  max %u ns\n", fagpio_ticks_to_ns(lat[n - 1]));
+}
+
+static int run_poll(int fd, int rounds) {
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	uint32_t count;
+	int n = 0;
+
+	for (int i = 0; i < rounds; i++) {
+		digitalWrite(DRIVE_PIN, LOW);
+		fagpio_delay_ns(100000);
+		fagpio_eint_ack(PIO_PORT_E);
+
+		uint32_t t0 = fagpio_ticks();
+
+		digitalWrite(DRIVE_PIN, HIGH);
+		if (poll(&pfd, 1, 100) <= 0 || read(fd, &count, sizeof(count)) != sizeof(count))
+			continue;
+		lat[n++] = fagpio_ticks() - t0;
+	}
+	fagpio_eint_ack(PIO_PORT_E);
+	return n;
+}
+
+static int run_busy(int rounds) {
+	uint32_t mask = PIO_PIN_MASK(SENSE_PIN);
+	int n = 0;
+
+	for (int i = 0; i < rounds; i++) {
+		digitalWrite(DRIVE_PIN, LOW);
+		fagpio_delay_ns(100000);
+
+		uint32_t t0 = fagpio_ticks(), t1;
+
+		digitalWrite(DRIVE_PIN, HIGH);
+		while (!(digitalReadPort(PIO_PORT_E) & mask) && (t1 = fagpio_ticks()) - t0 < fagpio_tick_hz / 10)
+			;
+		t1 = fagpio_ticks();
+		if (digitalReadPort(PIO_PORT_E) & mask)
+			lat[n++] = t1 - t0;
+	}
+	return n;
+}
+
+int main(int argc, char **argv) {
+	int rounds = argc > 1 ? atoi(argv[1]) : 10000;
+	int fd;
+
+	if (rounds <= 0 || rounds > MAX_ROUNDS)
+		rounds = 10000;
+	if (fagpio_setup() < 0)
+		return 1;
+
+	pinMode(DRIVE_PIN, 0);
+	digitalWrite(DRIVE_PIN, LOW);
+
+	if ((fd = attachInterrupt(SENSE_PIN, RISING)) >= 0) {
+		report("poll", run_poll(fd, rounds));
+		detachInterrupt(SENSE_PIN);
+	} else {
+		printf("poll   unavailable, no fagpio-eint-pe UIO node\n");
+	}
+
+	pinMode(SENSE_PIN, 1);
+	report("busy", run_busy(rounds));
+
+	fagpio_free();
+	return 0;
+}
@@ -0,0 +1,88 @@
+#include <math.h>
+#include <stdio.h>
+#include "fagpio.h"
+#include "fagpio_timer.h"
+
+/*
+Loopback self-test for boards without a scope. Jumper PE3 to PE4: PE3 is
+toggled as fast as the partner follows, every level seen on PE4 through
+digitalReadPort() is timestamped with the AVS counter, and the achieved
+edge rate, minimum pulse width and pulse jitter are printed. Exits with 1
+if PE4 does not follow or the edge rate is below min_rate.
+
+	./loopback [edges] [min_rate_hz]
+*/
+
+#define DRIVE_PIN		PIO_PIN(PIO_PORT_E, 3)
+#define SENSE_PIN		PIO_PIN(PIO_PORT_E, 4)
+#define FOLLOW_TIMEOUT	1000000		//ns to wait for the partner to follow one edge
+
+int main(int argc, char **argv) {
+	long edges = argc > 1 ? atol(argv[1]) : 100000;
+	double min_rate = argc > 2 ? atof(argv[2]) : 0;
+	uint32_t sense = PIO_PIN_MASK(SENSE_PIN);
+
+	if (edges < 2)
+		edges = 100000;
+	if (fagpio_setup() < 0)
+		return 1;
+
+	pinMode(DRIVE_PIN, 0);
+	pinMode(SENSE_PIN, 1);
+	pinPull(SENSE_PIN, PULL_NONE);
+
+	uint32_t timeout = fagpio_ns_to_ticks(FOLLOW_TIMEOUT);
+	uint32_t level = digitalReadPort(PIO_PORT_E) & sense;
+	uint32_t start = fagpio_ticks(), prev = start;
+	uint32_t min = UINT32_MAX, max = 0;
+	double sum = 0, sum2 = 0;
+
+	for (long i = 0; i < edges; i++) {
+		uint32_t t;
+
+		level ^= sense;
+		digitalWrite(DRIVE_PIN, level ? HIGH : LOW);
+		while ((digitalReadPort(PIO_PORT_E) & sense) != level) {
+			if (fagpio_ticks() - prev > timeout) {
+				printf("FAIL: PE4 does not follow PE3 (edge %ld), check the jumper\n", i);
+				fagpio_free();
+				return 1;
+			}
+		}
+		t = fagpio_ticks();
+
+		uint32_t width = t - prev;
+
+		prev = t;
+		if (!i)
+			continue;		//The first interval starts before the first write
+		if (width < min)
+			min = width;
+		if (width > max)
+			max = width;
+		sum += width;
+		sum2 += (double)width * width;
+	}
+
+	long n = edges - 1;
+	double tick_ns = 1e9 / fagpio_tick_hz;
+	double mean = sum / n;
+	double sd = sqrt(fmax(sum2 / n - mean * mean, 0));
+	double rate = edges / ((prev - start) * tick_ns * 1e-9);
+
+	fagpio_free();
+
+	printf("edges            %ld\n", edges);
+	printf("edge rate        %.0f edges/s\n", rate);
+	printf("min pulse width  %.1f ns\n", min * tick_ns);
+	printf("mean pulse width %.1f ns\n", mean * tick_ns);
+	printf("max pulse width  %.1f ns\n", max * tick_ns);
+	printf("jitter (stddev)  %.1f ns\n", sd * tick_ns);
+	printf("tick             %.1f ns\n", tick_ns);
+
+	if (rate < min_rate) {
+		printf("FAIL: edge rate below %.0f edges/s\n", min_rate);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,127 @@
+#define _GNU_SOURCE		//CPU_SET and sched_setaffinity
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fagpio.h"
+#include "fagpio_rt.h"
+#include "fagpio_timer.h"
+#include "mbench.h"
+
+static struct mbench_opts opts = { 1000, 100, 10, 80, 0, NULL };
+static struct mbench_result results[MBENCH_MAX];
+static unsigned int nresults;
+static uint32_t *samples;
+static uint32_t overhead;		//Ticks of timing an empty batch
+static char board[64];
+
+static void empty(void *arg, unsigned int n) {
+	__asm__ __volatile__("" ::: "memory");
+}
+
+static int cmp_u32(const void *a, const void *b) {
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+// Sorted ticks of opts.trials batches
+static void trials(mbench_fn fn, void *arg) {
+	for (unsigned int i = 0; i < opts.warmup; i++)
+		fn(arg, opts.batch);
+	for (unsigned int i = 0; i < opts.trials; i++) {
+		uint32_t t0 = fagpio_ticks();
+
+		fn(arg, opts.batch);
+		samples[i] = fagpio_ticks() - t0;
+	}
+	qsort(samples, opts.trials, sizeof(*samples), cmp_u32);
+}
+
+static void read_board(void) {
+	FILE *f = fopen("/proc/device-tree/model", "r");
+
+	strcpy(board, "unknown");
+	if (f) {
+		if (!fgets(board, sizeof(board), f))
+			strcpy(board, "unknown");
+		fclose(f);
+	}
+	board[strcspn(board, "\n")] = 0;
+}
+
+int mbench_init(const struct mbench_opts *o) {
+	if (o) {
+		opts = *o;
+		if (!opts.trials)
+			opts.trials = 1000;
+		if (!opts.batch)
+			opts.batch = 100;
+	}
+	if (fagpio_setup() < 0 || !fagpio_counter)
+		return -1;
+	if (!(samples = calloc(opts.trials, sizeof(*samples))))
+		return -1;
+
+	if (opts.board)
+		snprintf(board, sizeof(board), "%s", opts.board);
+	else
+		read_board();
+
+	if (opts.cpu >= 0) {
+		cpu_set_t set;
+
+		CPU_ZERO(&set);
+		CPU_SET(opts.cpu, &set);
+		sched_setaffinity(0, sizeof(set), &set);
+	}
+	fagpio_rt_enter(opts.prio);		//Carries on without real time when not permitted
+
+	trials(empty, NULL);
+	overhead = samples[opts.trials / 2];
+	return 0;
+}
+
+static double ticks_to_ns(uint32_t ticks) {
+	ticks = ticks > overhead ? ticks - overhead : 0;
+	return (double)ticks * 1e9 / fagpio_tick_hz / opts.batch;
+}
+
+const struct mbench_result *mbench_run(const char *name, mbench_fn fn, void *arg) {
+	if (nresults == MBENCH_MAX || !samples)
+		return NULL;
+
+	struct mbench_result *r = &results[nresults++];
+	unsigned int p99 = (opts.trials * 99 + 99) / 100 - 1;
+
+	trials(fn, arg);
+	r->name = name;
+	r->trials = opts.trials;
+	r->batch = opts.batch;
+	r->median_ns = ticks_to_ns(samples[opts.trials / 2]);
+	r->p99_ns = ticks_to_ns(samples[p99]);
+	r->min_ns = ticks_to_ns(samples[0]);
+	r->max_ns = ticks_to_ns(samples[opts.trials - 1]);
+	return r;
+}
+
+void mbench_print(FILE *f) {
+	fprintf(f, "%-24s %10s %10s %10s %10s\n", "ns per call", "median", "p99", "min", "max");
+	for (unsigned int i = 0; i < nresults; i++) {
+		const struct mbench_result *r = &results[i];
+
+		fprintf(f, "%-24s %10.1f %10.1f %10.1f %10.1f\n", r->name, r->median_ns, r->p99_ns, r->min_ns, r->max_ns);
+	}
+}
+
+// Names and the board string are printed as given: keep quotes and backslashes out of them
+void mbench_json(FILE *f) {
+	fprintf(f, "{\n\t\"board\": \"%s\",\n\t\"tick_hz\": %u,\n\t\"trials\": %u,\n\t\"batch\": %u,\n\t\"overhead_ticks\": %u,\n\t\"results\": [",
+		board, fagpio_tick_hz, opts.trials, opts.batch, overhead);
+	for (unsigned int i = 0; i < nresults; i++) {
+		const struct mbench_result *r = &results[i];
+
+		fprintf(f, "%s\n\t\t{ \"name\": \"%s\", \"median_ns\": %.1f, \"p99_ns\": %.1f, \"min_ns\": %.1f, \"max_ns\": %.1f }",
+			i ? "," : "", r->name, r->median_ns, r->p99_ns, r->min_ns, r->max_ns);
+	}
+	fprintf(f, "\n\t]\n}\n");
+}
@@ -0,0 +1,43 @@
+#ifndef _MBENCH_H
+#define _MBENCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Microbenchmark harness on the AVS counter (fagpio_timer.h). Each bench
+ * runs `warmup` untimed batches, then `trials` timed batches of `batch`
+ * calls; the cost of timing an empty batch is subtracted. Results are
+ * per call: median, p99, min and max over the trials. mbench_init()
+ * enters real time (fagpio_rt_enter: locked memory, SCHED_FIFO at prio)
+ * and pins the thread to cpu, so the trials see as little of the rest of
+ * the system as possible. mbench_json() writes every result as one JSON
+ * document, tagged with the board, for comparing boards and versions.
+ */
+
+#define MBENCH_MAX		64		//Benches per run
+
+struct mbench_opts {
+	unsigned int trials;	//Default 1000
+	unsigned int batch;		//Calls per trial, default 100
+	unsigned int warmup;	//Untimed batches, default 10
+	int prio;				//SCHED_FIFO priority, default 80, 0 keeps the current policy
+	int cpu;				//-1 leaves the affinity alone
+	const char *board;		//NULL reads /proc/device-tree/model
+};
+
+struct mbench_result {
+	const char *name;
+	unsigned int trials;
+	unsigned int batch;
+	double median_ns, p99_ns, min_ns, max_ns;
+};
+
+typedef void (*mbench_fn)(void *arg, unsigned int n);		//Runs the operation n times
+
+int mbench_init(const struct mbench_opts *opts);		//-1 without the hardware counter
+const struct mbench_result *mbench_run(const char *name, mbench_fn fn, void *arg);
+void mbench_print(FILE *f);		//Text table
+void mbench_json(FILE *f);
+
+#endif
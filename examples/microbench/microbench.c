@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "fagpio.h"
+#include "fagpio_inline.h"
+#include "fagpio_bbspi.h"
+#include "fagpio_transpose.h"
+#include "mbench.h"
+
+/*
+GPIO microbenchmarks on the harness in mbench.c. Unlike the bench example
+(means over CLOCK_MONOTONIC batches, for accepting upgrades) this reports
+the distribution per call, timed on the hardware counter under SCHED_FIFO,
+and writes it as JSON for comparing boards and library versions:
+
+	./microbench [-n trials] [-b batch] [-p prio] [-B board] [-o out.json]
+
+The table goes to stderr, the JSON to stdout or -o. Same pins as the bench:
+PE3 and PE4 are driven, PE5 is read, so leave them unconnected.
+*/
+
+#define OUT_PIN			PIO_PIN(PIO_PORT_E, 3)
+#define IN_PIN			PIO_PIN(PIO_PORT_E, 5)
+#define PORT_MASK		(PIO_PIN_MASK(PIO_PIN(PIO_PORT_E, 3)) | PIO_PIN_MASK(PIO_PIN(PIO_PORT_E, 4)))
+
+static struct pio_bank *banks;
+static struct fagpio_bbspi spi;
+static volatile uint32_t sink;		//Keeps the reads from being optimised out
+
+static void op_toggle(void *arg, unsigned int n) {
+	for (unsigned int i = 0; i < n; i++)
+		digitalToggle(OUT_PIN);
+}
+
+static void op_write(void *arg, unsigned int n) {
+	for (unsigned int i = 0; i < n; i++)
+		digitalWrite(OUT_PIN, i & 1);
+}
+
+static void op_read(void *arg, unsigned int n) {
+	for (unsigned int i = 0; i < n; i++)
+		sink = digitalRead(IN_PIN);
+}
+
+static void op_write_port(void *arg, unsigned int n) {
+	for (unsigned int i = 0; i < n; i++)
+		digitalWritePort(PIO_PORT_E, PORT_MASK, (i & 1) ? PORT_MASK : 0);
+}
+
+static void op_read_port(void *arg, unsigned int n) {
+	for (unsigned int i = 0; i < n; i++)
+		sink = digitalReadPort(PIO_PORT_E);
+}
+
+static void op_pinmode(void *arg, unsigned int n) {
+	for (unsigned int i = 0; i < n; i++)
+		pinMode(OUT_PIN, OUTPUT);
+}
+
+static void op_write_fast(void *arg, unsigned int n) {
+	for (unsigned int i = 0; i < n; i++)
+		digitalWriteFast(banks, OUT_PIN, i & 1);
+}
+
+static void op_read_fast(void *arg, unsigned int n) {
+	for (unsigned int i = 0; i < n; i++)
+		sink = digitalReadFast(banks, IN_PIN);
+}
+
+static void op_bbspi_byte(void *arg, unsigned int n) {
+	uint8_t tx = 0xA5, rx;
+
+	for (unsigned int i = 0; i < n; i++) {
+		fagpio_bbspi_transfer(&spi, &tx, &rx, 1);
+		tx ^= rx;
+	}
+}
+
+// Eight lanes to one word per bit: the kernel against the per-bit loop it replaced
+static uint8_t lanes[8] = { 0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC, 0xDE, 0xF0 };
+
+static void op_transpose8(void *arg, unsigned int n) {
+	uint8_t out[8];
+
+	for (unsigned int i = 0; i < n; i++) {
+		lanes[i & 7] ^= i;
+		fagpio_transpose8(lanes, out);
+		sink = out[i & 7];
+	}
+}
+
+static void op_transpose8_loop(void *arg, unsigned int n) {
+	uint8_t out[8];
+
+	for (unsigned int i = 0; i < n; i++) {
+		lanes[i & 7] ^= i;
+		for (int bit = 7; bit >= 0; bit--) {
+			uint32_t ones = 0;
+
+			for (unsigned int l = 0; l < 8; l++)
+				ones |= (uint32_t)((lanes[l] >> bit) & 1) << l;
+			out[7 - bit] = ones;
+		}
+		sink = out[i & 7];
+	}
+}
+
+int main(int argc, char **argv) {
+	struct mbench_opts opts = { 1000, 100, 10, 80, 0, NULL };
+	const char *out = NULL;
+	int c;
+
+	while ((c = getopt(argc, argv, "n:b:p:B:o:")) != -1) {
+		switch (c) {
+		case 'n': opts.trials = atoi(optarg); break;
+		case 'b': opts.batch = atoi(optarg); break;
+		case 'p': opts.prio = atoi(optarg); break;
+		case 'B': opts.board = optarg; break;
+		case 'o': out = optarg; break;
+		default:
+			fprintf(stderr, "usage: %s [-n trials] [-b batch] [-p prio] [-B board] [-o out.json]\n", argv[0]);
+			return 2;
+		}
+	}
+	if (mbench_init(&opts) < 0) {
+		fprintf(stderr, "no hardware counter: run as root on the board\n");
+		return 1;
+	}
+
+	banks = fagpio_banks();
+	pinModeMask(PIO_PORT_E, PORT_MASK, OUTPUT);
+	pinMode(IN_PIN, INPUT);
+
+	mbench_run("toggle", op_toggle, NULL);
+	mbench_run("write", op_write, NULL);
+	mbench_run("read", op_read, NULL);
+	mbench_run("write_port", op_write_port, NULL);
+	mbench_run("read_port", op_read_port, NULL);
+	mbench_run("pinmode", op_pinmode, NULL);
+	mbench_run("transpose8", op_transpose8, NULL);
+	mbench_run("transpose8_loop", op_transpose8_loop, NULL);
+	if (banks) {
+		fagpio_bbspi_init(&spi, OUT_PIN, PIO_PIN(PIO_PORT_E, 4), IN_PIN, 0, 0);
+		mbench_run("inline_write", op_write_fast, NULL);
+		mbench_run("inline_read", op_read_fast, NULL);
+		mbench_run("bbspi_byte", op_bbspi_byte, NULL);
+	}
+
+	mbench_print(stderr);
+
+	FILE *f = out ? fopen(out, "w") : stdout;
+
+	if (!f) {
+		perror(out);
+		return 1;
+	}
+	mbench_json(f);
+	if (f != stdout)
+		fclose(f);
+	fagpio_free();
+	return 0;
+}
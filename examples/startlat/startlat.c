@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "fagpio.h"
+
+/*
+Time from exec to the first pin write, for the dynamically linked and
+the fully static build of this program. The parent stamps
+CLOCK_MONOTONIC into STARTLAT_EXEC_NS just before execve(); the child
+makes PE3 an output, drives it high, stamps again and sends the
+difference back through a pipe. It covers the loader, relocations,
+fagpio_setup() (mapping, timer calibration) and the first store.
+
+	./startlat [runs] [program...]
+
+runs defaults to 100, the programs to build_startlat/startlat and
+build_startlat/startlat_static. Prints min, median and max in
+microseconds. Drives PE3, so leave it unconnected.
+*/
+
+#define OUT_PIN		PIO_PIN(PIO_PORT_E, 3)
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int child(const char *exec_ns) {
+	uint64_t t0 = strtoull(exec_ns, NULL, 10);
+	const char *fd = getenv("STARTLAT_FD");
+
+	pinMode(OUT_PIN, OUTPUT);
+	digitalWrite(OUT_PIN, HIGH);
+
+	uint64_t dt = now_ns() - t0;
+
+	if (!fd || write(atoi(fd), &dt, sizeof(dt)) != sizeof(dt))
+		return 1;
+	return 0;
+}
+
+// One exec of prog; 0 when the child did not report
+static uint64_t run_once(const char *prog) {
+	int fds[2];
+	uint64_t dt = 0;
+
+	if (pipe(fds) < 0)
+		return 0;
+
+	pid_t pid = fork();
+
+	if (!pid) {
+		char fd_env[32], ns_env[48];
+		char *argv[] = { (char *)prog, NULL };
+		char *envp[] = { fd_env, ns_env, NULL };
+
+		close(fds[0]);
+		snprintf(fd_env, sizeof(fd_env), "STARTLAT_FD=%d", fds[1]);
+		snprintf(ns_env, sizeof(ns_env), "STARTLAT_EXEC_NS=%llu", (unsigned long long)now_ns());
+		execve(prog, argv, envp);
+		_exit(127);
+	}
+	close(fds[1]);
+	if (pid > 0) {
+		if (read(fds[0], &dt, sizeof(dt)) != sizeof(dt))
+			dt = 0;
+		waitpid(pid, NULL, 0);
+	}
+	close(fds[0]);
+	return dt;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void measure(const char *prog, int runs) {
+	uint64_t *dt = calloc(runs, sizeof(*dt));
+	int n = 0;
+
+	if (!dt)
+		return;
+	for (int i = 0; i < runs; i++) {
+		if ((dt[n] = run_once(prog)))
+			n++;
+	}
+	if (!n) {
+		printf("%-36s failed\n", prog);
+	} else {
+		qsort(dt, n, sizeof(*dt), cmp_u64);
+		printf("%-36s %8.1f %8.1f %8.1f\n", prog, dt[0] / 1e3, dt[n / 2] / 1e3, dt[n - 1] / 1e3);
+	}
+	free(dt);
+}
+
+int main(int argc, char **argv) {
+	const char *exec_ns = getenv("STARTLAT_EXEC_NS");
+
+	if (exec_ns)
+		return child(exec_ns);
+
+	int runs = argc > 1 ? atoi(argv[1]) : 100;
+	const char *defaults[] = { "build_startlat/startlat", "build_startlat/startlat_static" };
+
+	if (runs <= 0)
+		runs = 100;
+	printf("%-36s %8s %8s %8s\n", "program (us from exec)", "min", "median", "max");
+	if (argc > 2) {
+		for (int i = 2; i < argc; i++)
+			measure(argv[i], runs);
+	} else {
+		for (unsigned int i = 0; i < sizeof(defaults) / sizeof(defaults[0]); i++)
+			measure(defaults[i], runs);
+	}
+	return 0;
+}
@@ -0,0 +1,52 @@
+#include <stdio.h>
+#include "fagpio.h"
+
+/*
+Toggle rate of PE3 through digitalWrite, with and without shadow mode.
+Build once against libfagpio.so (make) and once against libfagpio.a with
+LTO (make STATIC=1) to compare the two.
+
+	./togglerate [toggles]
+*/
+
+#define TOGGLE_PIN	PIO_PIN(PIO_PORT_E, 3)
+
+static double now_s(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void run(const char *name, long toggles) {
+	double start = now_s();
+
+	for (long i = 0; i < toggles; i += 2) {
+		digitalWrite(TOGGLE_PIN, HIGH);
+		digitalWrite(TOGGLE_PIN, LOW);
+	}
+
+	double elapsed = now_s() - start;
+
+	printf("%-16s %10.0f toggles/s  %7.1f ns/write\n", name, toggles / elapsed, elapsed * 1e9 / toggles);
+}
+
+int main(int argc, char **argv) {
+	long toggles = argc > 1 ? atol(argv[1]) : 1000000;
+
+	if (toggles <= 0)
+		toggles = 1000000;
+	if (fagpio_setup() < 0)
+		return 1;
+
+	pinMode(TOGGLE_PIN, 0);
+
+	run("digitalWrite", toggles);
+	fagpio_shadow_enable(1);
+	run("shadow", toggles);
+	fagpio_shadow_enable(0);
+
+	fagpio_free();
+
+	return 0;
+}
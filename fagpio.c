@@ -1,36 +1,335 @@
-#include "fagpio.h"
+#include <errno.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "fagpio_priv.h"
+#include "fagpio_log.h"
+#include "fagpio_region.h"
+#include "fagpio_dmabuf.h"
+#include "fagpio_chip.h"
+#include "fagpio_fdpass.h"
+#include "fagpio_atomic.h"
+#include "fagpio_shm.h"
+#include "fagpio_timer.h"
+#include "fagpio_inline.h"
+#include "fagpio_pinmap.h"
+#include "fagpio_soc.h"
+#include "fagpio_mem.h"
 
 struct cpu_peripheral gpio = {GPIO_PAGE_OFFSET};
 
+/*
+Register offsets and shifts of every pin, from the Port A bank. They do
+not depend on the mapping or the SoC, so the table is built by the
+compiler into .rodata and shared by every process using libfagpio.so;
+a handle only adds its banks pointer and which pins its SoC has.
+*/
+struct pio_pin {
+	uint16_t dat;
+	uint16_t cfg;				//CFG word holding the 4-bit function field
+	uint16_t pull;				//PULL word holding the 2-bit pull field
+	uint16_t drv;				//DRV word holding the 2-bit drive field (same shift as pull)
+	uint32_t mask;				//Bit of the pin in DAT
+	uint8_t port;
+	uint8_t cfg_shift;
+	uint8_t pull_shift;
+};
+
+#define PIO_NPINS			(PIO_NPORTS * 32)
+
+#define PIO_REG(port, field)	((port) * sizeof(struct pio_bank) + offsetof(struct pio_bank, field))
+#define PIO_PIN_ENTRY(port, n) { \
+		PIO_REG(port, dat), PIO_REG(port, cfg[(n) >> 3]), PIO_REG(port, pull[(n) >> 4]), PIO_REG(port, drv[(n) >> 4]), \
+		1u << (n), port, ((n) & 7) * 4, ((n) & 15) * 2 }
+#define PIO_PIN_ENTRY8(port, n) \
+	PIO_PIN_ENTRY(port, n), PIO_PIN_ENTRY(port, (n) + 1), PIO_PIN_ENTRY(port, (n) + 2), PIO_PIN_ENTRY(port, (n) + 3), \
+	PIO_PIN_ENTRY(port, (n) + 4), PIO_PIN_ENTRY(port, (n) + 5), PIO_PIN_ENTRY(port, (n) + 6), PIO_PIN_ENTRY(port, (n) + 7)
+#define PIO_PORT_ENTRIES(port) \
+	PIO_PIN_ENTRY8(port, 0), PIO_PIN_ENTRY8(port, 8), PIO_PIN_ENTRY8(port, 16), PIO_PIN_ENTRY8(port, 24)
+
+static const struct pio_pin pio_pins[PIO_NPINS] = {
+	PIO_PORT_ENTRIES(0), PIO_PORT_ENTRIES(1), PIO_PORT_ENTRIES(2), PIO_PORT_ENTRIES(3),
+	PIO_PORT_ENTRIES(4), PIO_PORT_ENTRIES(5), PIO_PORT_ENTRIES(6),
+};
+
+_Static_assert(PIO_NPORTS == 7, "pio_pins lists 7 ports");
+
+#define BACKEND_ON(id)		(FAGPIO_BACKENDS & FAGPIO_BACKEND_BIT(id))
+
+#if BACKEND_ON(FAGPIO_BACKEND_CHIP)
+static int chip_open(void) {
+	return fagpio_chip_open(NULL);
+}
+
+static const struct fagpio_ops chip_ops = {
+	chip_open,
+	fagpio_chip_pin_mode,
+	fagpio_chip_write_port,
+	fagpio_chip_read_port,
+	fagpio_chip_close,
+};
+#endif
+
+#if BACKEND_ON(FAGPIO_BACKEND_DAEMON)
+// Weak: a link without fagpio_daemon.o (make split's core, libfagpio.a) has no daemon backend
+#pragma weak fagpio_daemon_open
+#pragma weak fagpio_daemon_pin_mode
+#pragma weak fagpio_daemon_write_port
+#pragma weak fagpio_daemon_read_port
+#pragma weak fagpio_daemon_close
+
+static const struct fagpio_ops daemon_ops = {
+	fagpio_daemon_open,
+	fagpio_daemon_pin_mode,
+	fagpio_daemon_write_port,
+	fagpio_daemon_read_port,
+	fagpio_daemon_close,
+};
+#endif
+#define BACKENDS_MAPPED		(FAGPIO_BACKENDS & (FAGPIO_BACKEND_BIT(FAGPIO_BACKEND_DEVMEM) | \
+								FAGPIO_BACKEND_BIT(FAGPIO_BACKEND_UIO) | FAGPIO_BACKEND_BIT(FAGPIO_BACKEND_SIM)))
+#define BACKENDS_PORT		(FAGPIO_BACKENDS & (FAGPIO_BACKEND_BIT(FAGPIO_BACKEND_CHIP) | FAGPIO_BACKEND_BIT(FAGPIO_BACKEND_DAEMON)))
+
+#if BACKENDS_PORT == FAGPIO_BACKEND_BIT(FAGPIO_BACKEND_CHIP)
+#define BACKEND_ONLY_OPS	(&chip_ops)
+#elif BACKENDS_PORT == FAGPIO_BACKEND_BIT(FAGPIO_BACKEND_DAEMON)
+#define BACKEND_ONLY_OPS	(&daemon_ops)
+#endif
+
+/*
+Everything one mapping needs: the registers, a pin table on them and the
+DAT shadows. Mapped backends (devmem, uio, sim) go straight to the
+registers; ops is only set for a backend without a mapping (chip,
+daemon), chosen once by handle_map(), and only the slow paths use it. The
+Arduino-style calls work on default_handle, whose mapping is the global
+gpio and which is set up on first use.
+*/
+struct fagpio_handle {
+	struct cpu_peripheral *per;
+	struct cpu_peripheral own;			//per of the handles from fagpio_open()
+	struct pio_bank *banks;				//Port A bank in the mapping, where the SoC puts the PIO
+	const struct fagpio_ops *ops;		//NULL while mapped
+	volatile uint32_t *dat_shadow;		//Cached DAT of each port, local_shadow or the shared segment (fagpio_shm.c)
+	volatile uint32_t local_shadow[PIO_NPORTS];
+	uint8_t shadow_mode;				//Write from the shadows instead of reading DAT
+	uint8_t epoch;						//digitalRead() from epoch_dat[] (fagpio_epoch_begin())
+	uint8_t epoch_valid;				//Ports read in this epoch
+	uint32_t epoch_dat[PIO_NPORTS];
+	uint8_t defer;						//Pin writes wait for fagpio_flush() (fagpio_defer_enable())
+	uint8_t defer_dirty;				//Ports with writes pending
+	uint32_t defer_mask[PIO_NPORTS];	//Pins set to defer_value
+	uint32_t defer_value[PIO_NPORTS];
+	uint32_t defer_toggle[PIO_NPORTS];	//Pins inverted, outside defer_mask
+	uint8_t lazy;						//Set up on first use
+	uint8_t pins[PIO_NPORTS];			//Pins of each port in pio_pins[], 0 until mapped
+};
+
+static struct fagpio_handle default_handle = {
+	.per = &gpio,
+	.dat_shadow = default_handle.local_shadow,
+	.lazy = 1,
+};
+
+// The handle internals below are inlined into both the handle API and the Arduino wrappers
+#define HANDLE_INLINE		static inline __attribute__((always_inline))
+
+HANDLE_INLINE struct pio_bank *pio_bank(struct fagpio_handle *h, uint8_t port) {
+	return h->banks + port;
+}
+
+static int fagpio_lazy_setup(void);
+
+HANDLE_INLINE volatile uint32_t *pio_reg(struct fagpio_handle *h, uint16_t offset) {
+	return (volatile uint32_t *)((unsigned char *)h->banks + offset);
+}
+
+// Slow path of every entry point: no pins may only mean "not set up yet"
+HANDLE_INLINE const struct pio_pin *pio_pin_lookup(struct fagpio_handle *h, uint8_t pin) {
+	if (!BACKENDS_MAPPED || pin >= PIO_NPINS)
+		return NULL;
+	if (PIO_PIN_NUM(pin) >= h->pins[PIO_PIN_PORT(pin)]) {
+		if (!h->lazy || fagpio_lazy_setup() < 0 || PIO_PIN_NUM(pin) >= h->pins[PIO_PIN_PORT(pin)])
+			return NULL;
+	}
+	return &pio_pins[pin];
+}
+
+/*
+Publishes a fresh mapping to the entry points, which test banks
+(pio_mapped()) or pins (pio_pin_lookup()) without the setup lock: the
+shadows are loaded first, then banks, then pins, each behind a barrier,
+so a thread that sees either finds everything it uses ready.
+*/
+static void pio_pins_init(struct fagpio_handle *h) {
+	const struct fagpio_soc *soc = fagpio_soc();
+	struct pio_bank *banks = (struct pio_bank *)((unsigned char *)h->per->addr + (soc->pio_phys - h->per->addr_p));
+
+	for (uint8_t port = 0; port < soc->nports; port++)
+		h->dat_shadow[port] = banks[port].dat;
+	fagpio_barrier();
+	h->banks = banks;
+	fagpio_barrier();
+	memcpy(h->pins, soc->port_pins, sizeof(h->pins));
+}
+
+static int read_sysfs(const char *path, char *buf, size_t len) {
+	int fd = open(path, O_RDONLY);
+	ssize_t n;
+
+	if (fd < 0)
+		return -1;
+	n = read(fd, buf, len - 1);
+	close(fd);
+	if (n <= 0)
+		return -1;
+	while (n > 0 && (buf[n - 1] == '\n' || buf[n - 1] == ' '))
+		n--;
+	buf[n] = '\0';
+	return 0;
+}
+
+// Number N of the /dev/uioN whose sysfs name matches, -1 if none
+int fagpio_uio_find(const char *name) {
+	char path[64], buf[32];
+
+	for (int i = 0; i < 16; i++) {
+		snprintf(path, sizeof(path), "/sys/class/uio/uio%d/name", i);
+		if (read_sysfs(path, buf, sizeof(buf)) == 0 && !strcmp(buf, name))
+			return i;
+	}
+	return -1;
+}
+
+/*
+Low-memory mode (fagpio_mem.h) maps the pages of the PIO block only: the
+banks, EINT and debounce registers. fagpio_region() maps the CCU, timer
+and the rest on their own when they are first used. That takes /dev/mem:
+a UIO mmap always starts at the start of its map, so the UIO backend
+keeps all of map0 and the blocks in it are reached through that.
+*/
+#define PIO_BLOCK_SIZE		0x400
+
+static unsigned long pio_window_end(unsigned long page) {
+	return (fagpio_soc()->pio_phys + PIO_BLOCK_SIZE + page - 1) & ~(page - 1);
+}
+
+/*
+UIO backend: a generic-uio device tree node named FAGPIO_UIO_NAME (or the
+name in the FAGPIO_UIO environment variable) whose map0 starts in the
+GPIO_PAGE_OFFSET page, e.g.
+
+	fagpio-pio {
+		compatible = "generic-uio";
+		reg = <0x01c20000 0x4000>;
+	};
+
+with uio_pdrv_genirq.of_id=generic-uio on the kernel command line. The
+/dev/uioN node can be handed to a non-root group; no /dev/mem needed.
+*/
+static int uio_map_peripheral(struct cpu_peripheral *p) {
+	const char *want = getenv("FAGPIO_UIO");
+	const struct fagpio_soc *soc = fagpio_soc();
+	char path[64], buf[32];
+	unsigned long page = sysconf(_SC_PAGESIZE);
+
+	if (!want)
+		want = FAGPIO_UIO_NAME;
+
+	int i = fagpio_uio_find(want);
+
+	if (i < 0)
+		return -1;
+
+	snprintf(path, sizeof(path), "/sys/class/uio/uio%d/maps/map0/addr", i);
+	if (read_sysfs(path, buf, sizeof(buf)) < 0)
+		return -1;
+	unsigned long addr = strtoul(buf, NULL, 0);
+	snprintf(path, sizeof(path), "/sys/class/uio/uio%d/maps/map0/size", i);
+	if (read_sysfs(path, buf, sizeof(buf)) < 0)
+		return -1;
+	unsigned long size = strtoul(buf, NULL, 0);
+
+	if ((addr & ~(page - 1)) != soc->window_phys || addr + size < soc->pio_phys + soc->nports * PIO_BANK_SIZE) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "uio%d does not cover the PIO block\n", i);
+		return -1;
+	}
+
+	snprintf(path, sizeof(path), "/dev/uio%d", i);
+	if ((p->mem_fd = open(path, O_RDWR)) < 0)
+		return -1;
+
+	p->size = (addr - soc->window_phys + size + page - 1) & ~(page - 1);		//All of map0, in low-memory mode too
+	p->map = mmap(NULL, p->size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, p->mem_fd, 0);	//Offset 0 selects map0
+	if (p->map == MAP_FAILED) {
+		close(p->mem_fd);
+		return -1;
+	}
+
+	p->addr_p = soc->window_phys;
+	p->addr = (volatile unsigned int *)p->map;
+	p->backend = FAGPIO_BACKEND_UIO;
+	FAGPIO_LOG(FAGPIO_LOG_INFO, "Using %s\n", path);
+	return 0;
+}
+
 // Exposes the physical address defined in the passed structure using mmap on /dev/mem
-int map_peripheral(struct cpu_peripheral *p) {
-	if ((p->mem_fd = open("/dev/mem", O_RDWR|O_SYNC) ) < 0) {
-		printf("Failed to open /dev/mem, try checking permissions.\n");
+static int devmem_map_peripheral(struct cpu_peripheral *p) {
+	const char *helper = getenv("FAGPIO_FD_SOCKET");
+	const struct fagpio_soc *soc = fagpio_soc();
+
+	if (helper && (p->mem_fd = fagpio_fd_recv(*helper ? helper : FAGPIO_FD_SOCKET)) >= 0) {
+		FAGPIO_LOG(FAGPIO_LOG_INFO, "Using the /dev/mem fd from %s\n", helper);
+	} else if ((p->mem_fd = open("/dev/mem", O_RDWR|O_SYNC) ) < 0) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "Failed to open /dev/mem, try checking permissions.\n");
 		return -1;
 	}
 
+	unsigned long page = sysconf(_SC_PAGESIZE);
+
+	if (fagpio_lowmem()) {
+		p->addr_p = soc->pio_phys & ~(page - 1);
+		p->size = pio_window_end(page) - p->addr_p;
+	} else {
+		p->addr_p = soc->window_phys;
+		p->size = soc->window_size;
+	}
 	p->map = mmap(
 				NULL,
-				BLOCK_SIZE,
+				p->size,
 				PROT_READ|PROT_WRITE,
-				MAP_SHARED,
+				MAP_SHARED|MAP_POPULATE,		// Build the page tables now, not on the first access
 				p->mem_fd,						// File descriptor to physical memory virtual file '/dev/mem'
 				p->addr_p						// Address in physical map that we want this memory block to expose
 				);
 
 	if (p->map == MAP_FAILED) {
-		perror("mmap");
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "mmap: %s\n", strerror(errno));
+		close(p->mem_fd);
 		return -1;
 	}
 
 	p->addr = (volatile unsigned int *)p->map;
+	p->backend = FAGPIO_BACKEND_DEVMEM;
+	FAGPIO_LOG(FAGPIO_LOG_INFO, "Mapped %lu bytes at 0x%lx\n", p->size, p->addr_p);
 
 	return 0;
 }
 
+// Prefers a UIO device (no root needed) and falls back to /dev/mem
+int map_peripheral(struct cpu_peripheral *p) {
+	if (uio_map_peripheral(p) == 0)
+		return 0;
+	return devmem_map_peripheral(p);
+}
+
 void unmap_peripheral(struct cpu_peripheral *p) {
-	munmap(p->map, BLOCK_SIZE);
-	close(p->mem_fd);
+	if (BACKEND_ON(FAGPIO_BACKEND_SIM) && p->backend == FAGPIO_BACKEND_SIM) {
+		fagpio_sim_unmap(p);
+	} else {
+		munmap(p->map, p->size);
+		close(p->mem_fd);
+	}
+	p->map = NULL;
+	p->addr = NULL;
 }
 
 /*
@@ -50,96 +349,914 @@ BIT
 32                                            0
   PE7   PE6   PE5   PE4   PE3   PE2   PE1   PE0
 0 000 0 000 0 000 0 000 0 000 0 000 0 000 0 000
+
+Every port A-F uses the same bank layout (struct pio_bank) at
+GPIO_REG_BASE + port * 0x24; PE_CFG0 above is bank 4, CFG word 0.
+Pins 8-15 live in CFG1, 16-23 in CFG2 and 24-31 in CFG3.
 */
 
+// True when the handle runs on a backend without a mapping (chip, daemon)
+HANDLE_INLINE int chip_backend(struct fagpio_handle *h) {
+	return BACKENDS_PORT && h->ops != NULL;
+}
+
+// The table is a constant when the build has one such backend, so its calls are direct
+HANDLE_INLINE const struct fagpio_ops *backend_ops(struct fagpio_handle *h) {
+#ifdef BACKEND_ONLY_OPS
+	(void)h;
+	return BACKEND_ONLY_OPS;
+#else
+	return h->ops;
+#endif
+}
+
+static pthread_mutex_t setup_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int fagpio_setup_locked(void);
+
+/*
+FAGPIO_BACKEND in the environment forces a backend: "devmem" skips the
+UIO lookup, "uio" skips /dev/mem, "chip" uses /dev/gpiochip0 only, "sim"
+the simulated PIO of fagpio_sim.h, "daemon" the fagpiod of
+fagpio_daemon.h. By default the register mapping is tried first and the
+gpiochip is the last resort, also when a named register backend fails.
+
+Calling fagpio_setup() is optional: the first GPIO call of the process
+sets up on demand, and concurrent first calls are serialised. Calling it
+again once set up is a no-op.
+*/
 int fagpio_setup(void) {
-	if(map_peripheral(&gpio) == -1) {
-		printf("Failed to map the physical GPIO registers into the virtual memory space.\n");
+	int ret;
+
+	FAGPIO_PROBE0(setup_start);
+	pthread_mutex_lock(&setup_lock);
+	ret = fagpio_setup_locked();
+	pthread_mutex_unlock(&setup_lock);
+	FAGPIO_PROBE1(setup_done, ret);
+	return ret;
+}
+
+static uint8_t lazy_failed;		//Do not retry a failed on-demand setup on every call
+
+// On-demand setup from the entry points; 0 once registers are mapped
+static int fagpio_lazy_setup(void) {
+	if (chip_backend(&default_handle) || lazy_failed)
+		return -1;
+	if (fagpio_setup() < 0) {
+		lazy_failed = 1;
+		return -1;
+	}
+	return gpio.addr ? 0 : -1;
+}
+
+// True if the registers are mapped, setting up the default handle on first use
+HANDLE_INLINE int pio_mapped(struct fagpio_handle *h) {
+	return h->banks || (h->lazy && fagpio_lazy_setup() == 0);
+}
+
+// Through the compare-and-swap of shadow_update(): the shadows may be shared
+static void handle_sync(struct fagpio_handle *h, uint8_t port) {
+	volatile uint32_t *shadow = &h->dat_shadow[port];
+	uint32_t dat, old;
+
+	if (port >= PIO_NPORTS || !h->banks)
+		return;
+	dat = pio_bank(h, port)->dat;
+	do {
+		old = *shadow;
+	} while (!fagpio_cas(shadow, old, dat));
+}
+
+/*
+The backends of this build, in the order tried when FAGPIO_BACKEND names
+none: a register backend has map, one without a mapping has ops. Each
+entry only exists when FAGPIO_BACKENDS has its bit, so a build for one
+backend references nothing of the others.
+*/
+struct fagpio_backend {
+	char name[8];
+	uint8_t id;					//FAGPIO_BACKEND_*
+	uint8_t by_default;			//Tried when none is named
+	int (*map)(struct cpu_peripheral *p);
+	const struct fagpio_ops *ops;
+};
+
+static const struct fagpio_backend backends[] = {
+#if BACKEND_ON(FAGPIO_BACKEND_UIO)
+	{ "uio",	FAGPIO_BACKEND_UIO,		1, uio_map_peripheral,		NULL },
+#endif
+#if BACKEND_ON(FAGPIO_BACKEND_DEVMEM)
+	{ "devmem",	FAGPIO_BACKEND_DEVMEM,	1, devmem_map_peripheral,	NULL },
+#endif
+#if BACKEND_ON(FAGPIO_BACKEND_SIM)
+	{ "sim",	FAGPIO_BACKEND_SIM,		0, fagpio_sim_map,			NULL },
+#endif
+#if BACKEND_ON(FAGPIO_BACKEND_DAEMON)
+	{ "daemon",	FAGPIO_BACKEND_DAEMON,	0, NULL,					&daemon_ops },
+#endif
+#if BACKEND_ON(FAGPIO_BACKEND_CHIP)
+	{ "chip",	FAGPIO_BACKEND_CHIP,	1, NULL,					&chip_ops },
+#endif
+};
+
+#define NBACKENDS			(sizeof(backends) / sizeof(backends[0]))
+
+_Static_assert(FAGPIO_BACKENDS & 0x1F, "FAGPIO_BACKENDS selects no backend");
+
+static int backend_try(struct fagpio_handle *h, const struct fagpio_backend *b) {
+	struct cpu_peripheral *per = h->per;
+
+	if (b->map) {
+		if (b->map(per) < 0)
+			return -1;
+		pio_pins_init(h);
+		return 0;
+	}
+	if (!b->ops->open || b->ops->open() < 0)		//NULL when the weak daemon calls are not linked
 		return -1;
+	per->backend = b->id;
+	h->ops = b->ops;
+	FAGPIO_LOG(FAGPIO_LOG_INFO, "Using the %s backend\n", b->name);
+	return 0;
+}
+
+// Maps the registers of h with a backend named like FAGPIO_BACKEND, NULL for the default order
+static int handle_map(struct fagpio_handle *h, const char *backend) {
+	const struct fagpio_backend *named = NULL;
+
+	for (unsigned int i = 0; backend && i < NBACKENDS; i++) {
+		if (!strcmp(backends[i].name, backend))
+			named = &backends[i];
+	}
+	if (named && backend_try(h, named) == 0)
+		return 0;
+	if (!named || named->map) {		//After a named register backend, the gpiochip is left
+		for (unsigned int i = 0; i < NBACKENDS; i++) {
+			const struct fagpio_backend *b = &backends[i];
+
+			if (b->by_default && !(named && b->map) && backend_try(h, b) == 0)
+				return 0;
+		}
+	}
+	FAGPIO_LOG(FAGPIO_LOG_ERR, "Failed to map the physical GPIO registers into the virtual memory space.\n");
+	return -1;
+}
+
+static void handle_unmap(struct fagpio_handle *h) {
+	if (chip_backend(h)) {
+		backend_ops(h)->close();
+		h->ops = NULL;
+		h->per->backend = FAGPIO_BACKEND_DEVMEM;
+	} else if (h->per->addr) {
+		memset(h->pins, 0, sizeof(h->pins));
+		unmap_peripheral(h->per);
+		h->banks = NULL;
 	}
+}
+
+static int fagpio_setup_locked(void) {
+	if (gpio.addr || chip_backend(&default_handle))
+		return 0;
+
+	fagpio_log_init();
+
+	if (handle_map(&default_handle, getenv("FAGPIO_BACKEND")) < 0)
+		return -1;
+	if (chip_backend(&default_handle))
+		return 0;
+	if (fagpio_timer_init() == 0)
+		fagpio_costs_measure();
+
+	const char *shm_name = getenv("FAGPIO_SHM");
+
+	if (shm_name)
+		fagpio_shm_attach(*shm_name ? shm_name : NULL);
+
+	if (getenv("FAGPIO_STATS"))
+		fagpio_stats_enable();
+
+	const char *pinmap = getenv("FAGPIO_PINMAP");
+
+	if (pinmap && *pinmap)
+		fagpio_pinmap_load(pinmap);		//Logs its own errors; a bad map does not fail setup
 	return 0;
 }
 
 void fagpio_free(void) {
-	unmap_peripheral(&gpio);
+	pthread_mutex_lock(&setup_lock);
+	if (gpio.addr) {
+		fagpio_failsafe_on_free();
+		fagpio_counter = NULL;
+		fagpio_shm_detach();
+		fagpio_stats_disable();
+		fagpio_region_unmap_all();
+		fagpio_dmapool_close();
+	}
+	handle_unmap(&default_handle);
+	pthread_mutex_unlock(&setup_lock);
 }
 
-void pinMode(uint8_t Pin, uint8_t Mode) {
+/*
+Handles of their own: a mapping, pin table and shadows per handle, no
+lazy setup. Only one handle at a time can use the gpiochip backend. The
+timer, regions and shared shadows stay with the default handle.
+*/
+fagpio_t *fagpio_open(const char *backend) {
+	struct fagpio_handle *h = fagpio_mem_alloc(sizeof(*h), 0);
+
+	if (!h)
+		return NULL;
+	h->per = &h->own;
+	h->own.addr_p = GPIO_PAGE_OFFSET;
+	h->dat_shadow = h->local_shadow;
+	fagpio_log_init();
+	if (handle_map(h, backend ? backend : getenv("FAGPIO_BACKEND")) < 0) {
+		fagpio_mem_free(h);
+		return NULL;
+	}
+	return h;
+}
+
+void fagpio_close(fagpio_t *h) {
+	if (!h)
+		return;
+	if (h == &default_handle) {
+		fagpio_free();
+		return;
+	}
+	handle_unmap(h);
+	fagpio_mem_free(h);
+}
+
+fagpio_t *fagpio_default(void) {
+	pio_mapped(&default_handle);
+	return &default_handle;
+}
+
+int fagpio_handle_backend(fagpio_t *h) {
+	return h->per->backend;
+}
+
+struct pio_bank *fagpio_handle_banks(fagpio_t *h) {
+	return pio_mapped(h) ? pio_bank(h, 0) : NULL;
+}
+
+// Bank array of the mapped PIO block (bank[PIO_PORT_E] is port E), for fagpio_inline.h
+struct pio_bank *fagpio_banks(void) {
+	return fagpio_handle_banks(&default_handle);
+}
+
+/*
+Shadow mode: digitalWrite builds the new DAT word from dat_shadow[] and
+issues a single store, skipping the uncached DAT read. The pin writes
+outside shadow mode leave dat_shadow[] alone, so turning it on reloads
+every port from DAT first. Call fagpio_shadow_sync() after anything
+outside this library changed the port.
+*/
+/*
+In shadow mode updates from several threads are lock-free: the new value
+is published in dat_shadow[] with a compare-and-swap, then stored to DAT.
+A writer that finds the shadow moved on after its store writes the newer
+value again, so the last store always carries every thread's update.
+*/
+static void shadow_update(struct fagpio_handle *h, uint8_t port, uint32_t mask, uint32_t value, uint32_t toggle) {
+	struct pio_bank *bank = pio_bank(h, port);
+	volatile uint32_t *shadow = &h->dat_shadow[port];
+	uint32_t old, dat;
+
+	do {
+		old = *shadow;
+		dat = ((old & ~mask) | (value & mask)) ^ toggle;
+	} while (!fagpio_cas(shadow, old, dat));
+
+	bank->dat = dat;
+	while ((old = *shadow) != dat) {
+		dat = old;
+		bank->dat = dat;
+	}
+}
+
+/*
+Shadows handed in are already seeded (fagpio_shm.c does it once, in the
+process that creates the segment), and other processes update them with
+shadow_update(): shadow mode goes on without reloading them from DAT.
+*/
+void fagpio_shadow_bind(volatile uint32_t *shadows) {
+	struct fagpio_handle *h = &default_handle;
+
+	if (!shadows) {
+		for (unsigned int port = 0; port < PIO_NPORTS; port++)
+			h->local_shadow[port] = h->dat_shadow[port];
+		shadows = h->local_shadow;
+	} else {
+		h->shadow_mode = 1;
+	}
+	h->dat_shadow = shadows;
+}
+
+void fagpio_handle_shadow(fagpio_t *h, uint8_t enable) {
+	if (enable && !h->shadow_mode)
+		for (unsigned int port = 0; port < PIO_NPORTS; port++)
+			handle_sync(h, port);
+	h->shadow_mode = enable ? 1 : 0;
+}
+
+void fagpio_handle_sync(fagpio_t *h, uint8_t port) {
+	handle_sync(h, port);
+}
+
+void fagpio_shadow_enable(uint8_t enable) {
+	fagpio_handle_shadow(&default_handle, enable);
+}
+
+void fagpio_shadow_sync(uint8_t port) {
+	handle_sync(&default_handle, port);
+}
+
+HANDLE_INLINE void h_pin_mode(struct fagpio_handle *h, uint8_t Pin, uint8_t Mode) {
+	const struct pio_pin *p = pio_pin_lookup(h, Pin);
+
+	FAGPIO_TRACE_OP(FAGPIO_TRACE_MODE, Pin, Mode);
+	FAGPIO_PROBE2(pin_mode, Pin, Mode);
+	if (Mode > DISABLE || (!p && !(chip_backend(h) && Pin < PIO_NPINS)))
+		return;		//Nothing to configure, so nothing to claim
+	if (DISABLE == Mode) {
+		if (p)
+			*pio_reg(h, p->cfg) = (*pio_reg(h, p->cfg) & ~(15u << p->cfg_shift)) | (7u << p->cfg_shift);
+		if (h == &default_handle)
+			fagpio_pin_release(Pin);
+		return;
+	}
+	if (h == &default_handle && fagpio_pin_claim(Pin) < 0)
+		return;		//Another process owns the pin (fagpio_shm.h)
+	if (!p) {
+		backend_ops(h)->pin_mode(PIO_PIN_PORT(Pin), PIO_PIN_MASK(Pin), 0 == Mode);
+		return;
+	}
+
 	if (0 == Mode) {
-		printf("Set output\n");
-		volatile unsigned int PE_CFG0;
-		PE_CFG0 = *(volatile unsigned int *)((unsigned char*)gpio.addr + PIO_ADDR_PORT + rPE_CFG0);
-		volatile unsigned int MASK_CONFIG = (~(15 << (4*Pin)));
-		volatile unsigned int MASK_X      = (1 << (4*Pin));
+		FAGPIO_LOG(FAGPIO_LOG_DEBUG, "Set output\n");
+		*pio_reg(h, p->cfg) = (*pio_reg(h, p->cfg) & ~(15u << p->cfg_shift)) | (1u << p->cfg_shift);
+		FAGPIO_LOG(FAGPIO_LOG_DEBUG, "([OUTPUT] P%c_CFG = %08X\n", 'A' + p->port, *pio_reg(h, p->cfg));
+	} else {
+		FAGPIO_LOG(FAGPIO_LOG_DEBUG, "Set input\n");
+		*pio_reg(h, p->cfg) = *pio_reg(h, p->cfg) & ~(15u << p->cfg_shift);
+	}
+}
+
+void fagpio_pin_mode(fagpio_t *h, uint8_t pin, uint8_t mode) {
+	h_pin_mode(h, pin, mode);
+}
+
+void pinMode(uint8_t Pin, uint8_t Mode) {
+	uint32_t t = FAGPIO_STAT_START();
+
+	h_pin_mode(&default_handle, Pin, Mode);
+	FAGPIO_STAT_PIN(t, Pin, FAGPIO_STAT_MODE);
+}
+
+// Selects CFG function func (0-7, 7 disables the pin); -1 for an unimplemented pin
+int fagpio_pin_func(uint8_t pin, uint8_t func) {
+	struct fagpio_handle *h = &default_handle;
+	const struct pio_pin *p = pio_pin_lookup(h, pin);
+
+	if (!p || func > 7)
+		return -1;
+	if (func != 7 && fagpio_pin_claim(pin) < 0)
+		return -1;
+	*pio_reg(h, p->cfg) = (*pio_reg(h, p->cfg) & ~(15u << p->cfg_shift)) | ((uint32_t)func << p->cfg_shift);
+	if (func == 7)
+		fagpio_pin_release(pin);
+	return 0;
+}
+
+/*
+clear 2bit to 0
+
+Example:
+00: Pull-up/down disable
+01: Pull-up
+10: Pull-down
+
+			   0xFFFFFFF = 0b 1111 1111 1111 1111 1111 1111 1111 1111 (32 Bit)
+			   F = 0b1111 (binary)
+			   0x1  1 | 1  1
+		  Bit    3  2 | 1  0
+					  | Bit 0 and 1, set pull up/down for PE0
+
+				 Bit 2 and 3, set pull up/down for PE1
 
-		*(volatile unsigned int *)((unsigned char*)gpio.addr + GPIO_BASE_OFFSET+rPE_CFG0)=((PE_CFG0 & MASK_CONFIG)|MASK_X);
-		printf("([OUTPUT] PE_CFG0 = %08X\n", *(volatile unsigned int *)((unsigned char*)gpio.addr + PIO_ADDR_PORT + rPE_CFG0));
-	} else if (1 == Mode) {
-		printf("Set input\n");
-		volatile unsigned int PE_CFG0, PE_PULL_REG;
+Pins 0-15 live in PULL0, pins 16-31 in PULL1.
+*/
+
+/* clear two bit to zero */
+/* Example: PE2 => 3 << (2*2) => 3 << 4 => 0b00110000 => ~(0b00110000) => 0b11001111 */
+/* MASK_PULL = 0b11001111 => 0b1111 1111 1111 1111 1111 1111 1100 1111 */
+void fagpio_pin_pull(fagpio_t *h, uint8_t pin, uint8_t pull) {
+	const struct pio_pin *p = pio_pin_lookup(h, pin);
+
+	if (!p || pull > PULL_DOWN)
+		return;
+
+	*pio_reg(h, p->pull) = (*pio_reg(h, p->pull) & ~(3u << p->pull_shift)) | ((uint32_t)pull << p->pull_shift);
+}
+
+void pinPull(uint8_t pin, uint8_t pull) {
+	fagpio_pin_pull(&default_handle, pin, pull);
+}
+
+// Moves bit i of an 8-bit mask to bit 4*i (one nibble per CFG field)
+static uint32_t spread_nibbles(uint32_t x) {
+	x &= 0xFF;
+	x = (x | (x << 12)) & 0x000F000F;
+	x = (x | (x << 6)) & 0x03030303;
+	x = (x | (x << 3)) & 0x11111111;
+	return x;
+}
+
+// Moves bit i of a 16-bit mask to bit 2*i (one pair per PULL/DRV field)
+static uint32_t spread_pairs(uint32_t x) {
+	x &= 0xFFFF;
+	x = (x | (x << 8)) & 0x00FF00FF;
+	x = (x | (x << 4)) & 0x0F0F0F0F;
+	x = (x | (x << 2)) & 0x33333333;
+	x = (x | (x << 1)) & 0x55555555;
+	return x;
+}
 
-		PE_CFG0 = *(volatile unsigned int *)((unsigned char*)gpio.addr + PIO_ADDR_PORT + rPE_CFG0);
+// Implemented pins of a port as a DAT-style mask
+static uint32_t pio_port_mask(uint8_t port) {
+	return (1u << fagpio_port_pins(port)) - 1;
+}
 
-		PE_PULL_REG = *(volatile unsigned int *)((unsigned char*)gpio.addr + PIO_ADDR_PORT + rPE_PULL0);
+/*
+Same Mode encoding as pinMode(), applied to every pin in mask. Each
+CFG0-3 word that covers a selected pin is read and written exactly once.
+*/
+void fagpio_port_mode(fagpio_t *h, uint8_t port, uint32_t mask, uint8_t Mode) {
+	FAGPIO_PROBE3(port_mode, port, mask, Mode);
+	if (port >= PIO_NPORTS || Mode > 1)
+		return;
+	if (h == &default_handle && fagpio_port_reserve(port, mask) < 0)
+		return;
+	if (!pio_mapped(h)) {
+		if (chip_backend(h))
+			backend_ops(h)->pin_mode(port, mask, 0 == Mode);
+		return;
+	}
 
-		volatile unsigned int MASK_CONFIG = (~(15 << (4*Pin)));
-		volatile unsigned int MASK_X      = (0 << (4*Pin));
+	struct pio_bank *bank = pio_bank(h, port);
+	uint32_t fn = (0 == Mode) ? 1 : 0;
 
-		/*
-		clear 2bit to 0
+	mask &= pio_port_mask(port);
+	for (unsigned int i = 0; i < 4; i++) {
+		uint32_t sel = spread_nibbles(mask >> (i * 8));
 
-		Example:
-		00: Pull-up/down disable
-		01: Pull-up
-		10: Pull-down
+		if (sel)
+			bank->cfg[i] = (bank->cfg[i] & ~(sel * 15)) | (sel * fn);
+	}
+}
 
-					   0xFFFFFFF = 0b 1111 1111 1111 1111 1111 1111 1111 1111 (32 Bit)
-					   F = 0b1111 (binary)
-					   0x1  1 | 1  1
-				  Bit    3  2 | 1  0
-							  | Bit 0 and 1, set pull up/down for PE0
+void pinModeMask(uint8_t port, uint32_t mask, uint8_t Mode) {
+	uint32_t t = FAGPIO_STAT_START();
 
-						 Bit 2 and 3, set pull up/down for PE1
-		*/
+	fagpio_port_mode(&default_handle, port, mask, Mode);
+	FAGPIO_STAT_PORT(t, port, mask, FAGPIO_STAT_MODE);
+}
+
+// Same pull for every pin in mask, one write per PULL0/PULL1 word
+void fagpio_port_pull(fagpio_t *h, uint8_t port, uint32_t mask, uint8_t pull) {
+	if (port >= PIO_NPORTS || pull > PULL_DOWN || !pio_mapped(h))
+		return;
 
-		/* clear two bit to zero */
-		/* Example: PE2 => 3 << (2*2) => 3 << 4 => 0b00110000 => ~(0b00110000) => 0b11001111 */
-		/* volatile unsigned int MASK_PULL = 0b11001111 => 0b1111 1111 1111 1111 1111 1111 1100 1111 */
+	struct pio_bank *bank = pio_bank(h, port);
 
-		volatile unsigned int MASK_PULL    = (~(3 << (Pin*2)));
-		volatile unsigned int MASK_XPULL   = (1 << (Pin*2));
+	mask &= pio_port_mask(port);
+	for (unsigned int i = 0; i < 2; i++) {
+		uint32_t sel = spread_pairs(mask >> (i * 16));
 
-		*(volatile unsigned int *)((unsigned char*)gpio.addr + GPIO_BASE_OFFSET+rPE_CFG0) = ((PE_CFG0 & MASK_CONFIG)|MASK_X);
-		*(volatile unsigned int *)((unsigned char*)gpio.addr + GPIO_BASE_OFFSET+rPE_PULL0) = ((PE_PULL_REG & MASK_PULL) | MASK_XPULL);
+		if (sel)
+			bank->pull[i] = (bank->pull[i] & ~(sel * 3)) | (sel * pull);
 	}
 }
 
+void pinPullMask(uint8_t port, uint32_t mask, uint8_t pull) {
+	fagpio_port_pull(&default_handle, port, mask, pull);
+}
+
+// Drive level 0 (weakest) to 3 (strongest) of an output pin
+void fagpio_pin_drive(fagpio_t *h, uint8_t pin, uint8_t level) {
+	const struct pio_pin *p = pio_pin_lookup(h, pin);
+
+	if (!p || level > 3)
+		return;
+
+	*pio_reg(h, p->drv) = (*pio_reg(h, p->drv) & ~(3u << p->pull_shift)) | ((uint32_t)level << p->pull_shift);
+}
+
+void pinDrive(uint8_t pin, uint8_t level) {
+	fagpio_pin_drive(&default_handle, pin, level);
+}
+
+// Same level for every pin in mask, one write per DRV0/DRV1 word
+void fagpio_port_drive(fagpio_t *h, uint8_t port, uint32_t mask, uint8_t level) {
+	if (port >= PIO_NPORTS || level > 3 || !pio_mapped(h))
+		return;
+
+	struct pio_bank *bank = pio_bank(h, port);
+
+	mask &= pio_port_mask(port);
+	for (unsigned int i = 0; i < 2; i++) {
+		uint32_t sel = spread_pairs(mask >> (i * 16));
+
+		if (sel)
+			bank->drv[i] = (bank->drv[i] & ~(sel * 3)) | (sel * level);
+	}
+}
+
+void pinDriveMask(uint8_t port, uint32_t mask, uint8_t level) {
+	fagpio_port_drive(&default_handle, port, mask, level);
+}
+
+HANDLE_INLINE void h_digital_write(struct fagpio_handle *h, uint8_t pin, uint8_t value) {
+	const struct pio_pin *p = pio_pin_lookup(h, pin);
+
+	FAGPIO_TRACE_OP(FAGPIO_TRACE_WRITE, pin, value);
+	FAGPIO_PROBE2(pin_write, pin, value);
+	if (!p) {
+		if (chip_backend(h) && pin < PIO_NPINS && value <= 1)
+			backend_ops(h)->write_port(PIO_PIN_PORT(pin), PIO_PIN_MASK(pin), value ? PIO_PIN_MASK(pin) : 0);
+		return;
+	}
+
+	if (h->shadow_mode) {
+		if (value <= 1)
+			shadow_update(h, p->port, p->mask, value ? p->mask : 0, 0);
+		return;
+	}
+
+	if(value == 1)
+		*pio_reg(h, p->dat) |= p->mask;
+	else if(value == 0)
+		*pio_reg(h, p->dat) &= ~p->mask;
+}
+
+void fagpio_digital_write(fagpio_t *h, uint8_t pin, uint8_t value) {
+	h_digital_write(h, pin, value);
+}
+
+#define DEFER_TOGGLE	2
+
+// Records a pin write for fagpio_flush(); value 0, 1 or DEFER_TOGGLE
+static __attribute__((noinline)) void defer_pin(uint8_t pin, uint8_t value) {
+	struct fagpio_handle *h = &default_handle;
+	uint8_t port = PIO_PIN_PORT(pin);
+	uint32_t bit = PIO_PIN_MASK(pin);
+
+	if (!pio_pin_lookup(h, pin) && !(chip_backend(h) && pin < PIO_NPINS))
+		return;
+	if (value == DEFER_TOGGLE) {
+		if (h->defer_mask[port] & bit)
+			h->defer_value[port] ^= bit;
+		else
+			h->defer_toggle[port] ^= bit;
+	} else {
+		FAGPIO_TRACE_OP(FAGPIO_TRACE_WRITE, pin, value);
+		h->defer_mask[port] |= bit;
+		h->defer_value[port] = (h->defer_value[port] & ~bit) | (value ? bit : 0);
+		h->defer_toggle[port] &= ~bit;
+	}
+	h->defer_dirty |= 1u << port;
+}
+
+/*
+One store per dirty port: from the shadow in shadow mode, else after a
+DAT read that keeps the pins nobody deferred a write to.
+*/
+static void handle_flush(struct fagpio_handle *h) {
+	while (h->defer_dirty) {
+		uint8_t port = __builtin_ctz(h->defer_dirty);
+		uint32_t mask = h->defer_mask[port], value = h->defer_value[port], toggle = h->defer_toggle[port];
+
+		h->defer_dirty &= h->defer_dirty - 1;
+		h->defer_mask[port] = h->defer_value[port] = h->defer_toggle[port] = 0;
+		if (!pio_mapped(h)) {
+			if (chip_backend(h)) {
+				uint32_t cur = toggle ? backend_ops(h)->read_port(port) : 0;
+
+				backend_ops(h)->write_port(port, mask | toggle, value | (~cur & toggle));
+			}
+			continue;
+		}
+		if (h->shadow_mode) {
+			shadow_update(h, port, mask, value, toggle);
+			continue;
+		}
+
+		struct pio_bank *bank = pio_bank(h, port);
+		uint32_t dat = ((bank->dat & ~mask) | value) ^ toggle;
+
+		FAGPIO_TRACE_PORT(FAGPIO_TRACE_WRITE, port, mask | toggle, dat, fagpio_ticks());
+		h->dat_shadow[port] = dat;
+		bank->dat = dat;
+	}
+}
+
+void fagpio_flush(void) {
+	handle_flush(&default_handle);
+}
+
+void fagpio_defer_enable(uint8_t enable) {
+	if (!enable)
+		handle_flush(&default_handle);
+	default_handle.defer = enable ? 1 : 0;
+}
+
 void digitalWrite(uint8_t pin, uint8_t value) {
-	if(value == 1) {
-		volatile unsigned int PE_DAT;
-		volatile unsigned int MASK_CONFIG = (~(1 << (pin)));
-		volatile unsigned int MASK_X      = (1 << (pin));
-		PE_DAT = *(volatile unsigned int *)((unsigned char*)gpio.addr + GPIO_BASE_OFFSET+rPE_DAT);
-		*(volatile unsigned int *)((unsigned char*)gpio.addr + GPIO_BASE_OFFSET + rPE_DAT)=((PE_DAT & MASK_CONFIG)|MASK_X);
+	uint32_t t = FAGPIO_STAT_START();
+
+	if (default_handle.defer) {
+		if (value <= 1)
+			defer_pin(pin, value);
+	} else {
+		h_digital_write(&default_handle, pin, value);
 	}
-	else if(value == 0) {
-		volatile unsigned int PE_DAT;
-		volatile unsigned int MASK_CONFIG = (~(1 << (pin)));
-		PE_DAT = *(volatile unsigned int *)((unsigned char*)gpio.addr + GPIO_BASE_OFFSET+rPE_DAT);
-		*(volatile unsigned int *)((unsigned char*)gpio.addr + GPIO_BASE_OFFSET + rPE_DAT)=((PE_DAT & MASK_CONFIG));
+	FAGPIO_STAT_PIN(t, pin, FAGPIO_STAT_WRITE);
+}
+
+/*
+Branchless writes: bit 0 of value is spread over the pin's mask with a
+negation, so the new DAT word is computed without a data-dependent branch
+and every value is meaningful, unlike digitalWrite() which ignores all
+but 0 and 1.
+*/
+HANDLE_INLINE void h_digital_write_bit(struct fagpio_handle *h, uint8_t pin, uint32_t value) {
+	const struct pio_pin *p = pio_pin_lookup(h, pin);
+	uint32_t bits;
+
+	FAGPIO_TRACE_OP(FAGPIO_TRACE_WRITE, pin, value & 1);
+	FAGPIO_PROBE2(pin_write, pin, value & 1);
+	if (!p) {
+		if (chip_backend(h) && pin < PIO_NPINS)
+			backend_ops(h)->write_port(PIO_PIN_PORT(pin), PIO_PIN_MASK(pin), -(value & 1));
+		return;
+	}
+
+	bits = -(value & 1) & p->mask;
+	if (h->shadow_mode) {
+		shadow_update(h, p->port, p->mask, bits, 0);
+		return;
+	}
+	*pio_reg(h, p->dat) = (*pio_reg(h, p->dat) & ~p->mask) | bits;
+}
+
+void fagpio_digital_write_bit(fagpio_t *h, uint8_t pin, uint32_t value) {
+	h_digital_write_bit(h, pin, value);
+}
+
+void digitalWriteBit(uint8_t pin, uint32_t value) {
+	uint32_t t = FAGPIO_STAT_START();
+
+	if (default_handle.defer)
+		defer_pin(pin, value & 1);
+	else
+		h_digital_write_bit(&default_handle, pin, value);
+	FAGPIO_STAT_PIN(t, pin, FAGPIO_STAT_WRITE);
+}
+
+void digitalSet(uint8_t pin) {
+	uint32_t t = FAGPIO_STAT_START();
+
+	if (default_handle.defer)
+		defer_pin(pin, 1);
+	else
+		h_digital_write_bit(&default_handle, pin, 1);
+	FAGPIO_STAT_PIN(t, pin, FAGPIO_STAT_WRITE);
+}
+
+void digitalClear(uint8_t pin) {
+	uint32_t t = FAGPIO_STAT_START();
+
+	if (default_handle.defer)
+		defer_pin(pin, 0);
+	else
+		h_digital_write_bit(&default_handle, pin, 0);
+	FAGPIO_STAT_PIN(t, pin, FAGPIO_STAT_WRITE);
+}
+
+// Sets the pins selected by mask to the matching bits of value with one DAT store
+HANDLE_INLINE void h_port_write(struct fagpio_handle *h, uint8_t port, uint32_t mask, uint32_t value) {
+	FAGPIO_PROBE3(port_write, port, mask, value);
+	if (port >= PIO_NPORTS)
+		return;
+	if (!pio_mapped(h)) {
+		if (chip_backend(h))
+			backend_ops(h)->write_port(port, mask, value);
+		return;
+	}
+
+	struct pio_bank *bank = pio_bank(h, port);
+
+	if (h->shadow_mode) {
+		FAGPIO_TRACE_PORT(FAGPIO_TRACE_WRITE, port, (h->dat_shadow[port] ^ value) & mask, value, fagpio_ticks());
+		shadow_update(h, port, mask, value, 0);
+		return;
+	}
+
+	uint32_t old = bank->dat;
+	uint32_t dat = (old & ~mask) | (value & mask);
+
+	FAGPIO_TRACE_PORT(FAGPIO_TRACE_WRITE, port, old ^ dat, dat, fagpio_ticks());
+	h->dat_shadow[port] = dat;
+	bank->dat = dat;
+}
+
+void fagpio_port_write(fagpio_t *h, uint8_t port, uint32_t mask, uint32_t value) {
+	h_port_write(h, port, mask, value);
+}
+
+void digitalWritePort(uint8_t port, uint32_t mask, uint32_t value) {
+	uint32_t t = FAGPIO_STAT_START();
+
+	h_port_write(&default_handle, port, mask, value);
+	FAGPIO_STAT_PORT(t, port, mask, FAGPIO_STAT_WRITE);
+}
+
+// Inverts the pins selected by mask; one DAT store (no DAT read in shadow mode)
+HANDLE_INLINE void h_port_toggle(struct fagpio_handle *h, uint8_t port, uint32_t mask) {
+	FAGPIO_PROBE2(port_toggle, port, mask);
+	if (port >= PIO_NPORTS)
+		return;
+	if (!pio_mapped(h)) {
+		if (chip_backend(h))
+			backend_ops(h)->write_port(port, mask, ~backend_ops(h)->read_port(port));
+		return;
+	}
+
+	struct pio_bank *bank = pio_bank(h, port);
+
+	if (h->shadow_mode) {
+		FAGPIO_TRACE_PORT(FAGPIO_TRACE_WRITE, port, mask, h->dat_shadow[port] ^ mask, fagpio_ticks());
+		shadow_update(h, port, 0, 0, mask);
+		return;
+	}
+
+	uint32_t dat = bank->dat ^ mask;
+
+	FAGPIO_TRACE_PORT(FAGPIO_TRACE_WRITE, port, mask, dat, fagpio_ticks());
+	h->dat_shadow[port] = dat;
+	bank->dat = dat;
+}
+
+void fagpio_port_toggle(fagpio_t *h, uint8_t port, uint32_t mask) {
+	h_port_toggle(h, port, mask);
+}
+
+void digitalTogglePort(uint8_t port, uint32_t mask) {
+	uint32_t t = FAGPIO_STAT_START();
+
+	h_port_toggle(&default_handle, port, mask);
+	FAGPIO_STAT_PORT(t, port, mask, FAGPIO_STAT_WRITE);
+}
+
+void digitalToggle(uint8_t pin) {
+	uint32_t t = FAGPIO_STAT_START();
+
+	if (default_handle.defer)
+		defer_pin(pin, DEFER_TOGGLE);
+	else if (pin < PIO_NPINS)
+		h_port_toggle(&default_handle, PIO_PIN_PORT(pin), PIO_PIN_MASK(pin));
+	FAGPIO_STAT_PIN(t, pin, FAGPIO_STAT_WRITE);
+}
+
+// Raw DAT word of a port: every pin sampled by the same bus read
+HANDLE_INLINE uint32_t h_port_read(struct fagpio_handle *h, uint8_t port) {
+	if (port >= PIO_NPORTS)
+		return 0;
+	if (!pio_mapped(h))
+		return chip_backend(h) ? backend_ops(h)->read_port(port) : 0;
+
+	return pio_bank(h, port)->dat;
+}
+
+HANDLE_INLINE uint8_t h_digital_read(struct fagpio_handle *h, uint8_t pin) {
+	const struct pio_pin *p = pio_pin_lookup(h, pin);
+	uint8_t value = 0;
+
+	if (p)
+		value = (*pio_reg(h, p->dat) & p->mask) ? 1 : 0;
+	else if (chip_backend(h) && pin < PIO_NPINS)
+		value = (backend_ops(h)->read_port(PIO_PIN_PORT(pin)) & PIO_PIN_MASK(pin)) ? 1 : 0;
+
+	FAGPIO_TRACE_OP(FAGPIO_TRACE_READ, pin, value);
+	return value;
+}
+
+uint8_t fagpio_digital_read(fagpio_t *h, uint8_t pin) {
+	return h_digital_read(h, pin);
+}
+
+// Kept out of line so digitalRead() outside an epoch pays one test
+static __attribute__((noinline)) uint8_t epoch_read(uint8_t pin) {
+	struct fagpio_handle *h = &default_handle;
+	uint8_t port = PIO_PIN_PORT(pin), value;
+
+	if (!pio_pin_lookup(h, pin) && !(chip_backend(h) && pin < PIO_NPINS))
+		return 0;
+	if (!(h->epoch_valid & (1u << port))) {
+		h->epoch_dat[port] = h_port_read(h, port);
+		h->epoch_valid |= 1u << port;
 	}
+	value = (h->epoch_dat[port] & PIO_PIN_MASK(pin)) ? 1 : 0;
+	FAGPIO_TRACE_OP(FAGPIO_TRACE_READ, pin, value);
+	return value;
+}
+
+void fagpio_epoch_begin(void) {
+	handle_flush(&default_handle);
+	default_handle.epoch_valid = 0;
+	default_handle.epoch = 1;
+}
+
+void fagpio_epoch_end(void) {
+	handle_flush(&default_handle);
+	default_handle.epoch = 0;
 }
 
 uint8_t digitalRead(uint8_t pin) {
-	volatile unsigned int PE_DAT;
+	uint32_t t = FAGPIO_STAT_START();
+	uint8_t value = default_handle.epoch ? epoch_read(pin) : h_digital_read(&default_handle, pin);
 
-	volatile uint8_t value;
+	FAGPIO_STAT_PIN(t, pin, FAGPIO_STAT_READ);
+	return value;
+}
+
+uint32_t fagpio_port_read(fagpio_t *h, uint8_t port) {
+	return h_port_read(h, port);
+}
 
-	PE_DAT = *(volatile unsigned int *)((unsigned char*)gpio.addr + GPIO_BASE_OFFSET + rPE_DAT);
+// Counted per port only: a read samples every pin
+uint32_t digitalReadPort(uint8_t port) {
+	uint32_t t = FAGPIO_STAT_START();
+	uint32_t value = h_port_read(&default_handle, port);
 
-	value = (uint8_t)(((0x000000FF & PE_DAT) >> pin) & 0x1);
+	FAGPIO_STAT_PORT(t, port, 0, FAGPIO_STAT_READ);
+	return value;
+}
+
+// A read-back of the PIO block; the gpiochip ioctls are synchronous already
+void fagpio_handle_io_barrier(fagpio_t *h) {
+	if (h->per->addr)
+		fagpio_io_barrier_fast(pio_bank(h, 0));
+}
+
+void fagpio_io_barrier(void) {
+	fagpio_handle_io_barrier(&default_handle);
+}
+
+int fagpio_port_save(fagpio_t *h, uint8_t port, struct fagpio_bank_state *state) {
+	if (port >= PIO_NPORTS || !pio_mapped(h))
+		return -1;
+
+	struct pio_bank *bank = pio_bank(h, port);
+
+	for (unsigned int i = 0; i < 4; i++)
+		state->cfg[i] = bank->cfg[i];
+	state->dat = bank->dat;
+	state->drv[0] = bank->drv[0];
+	state->drv[1] = bank->drv[1];
+	state->pull[0] = bank->pull[0];
+	state->pull[1] = bank->pull[1];
+	return 0;
+}
+
+int fagpio_bank_save(uint8_t port, struct fagpio_bank_state *state) {
+	return fagpio_port_save(&default_handle, port, state);
+}
+
+/*
+Nine stores, no reads. DAT, DRV and PULL go first so that pins switched
+to output by the CFG stores come up at their saved level.
+*/
+int fagpio_port_restore(fagpio_t *h, uint8_t port, const struct fagpio_bank_state *state) {
+	if (port >= PIO_NPORTS || !pio_mapped(h))
+		return -1;
+
+	struct pio_bank *bank = pio_bank(h, port);
+
+	h->dat_shadow[port] = state->dat;
+	bank->dat = state->dat;
+	bank->drv[0] = state->drv[0];
+	bank->drv[1] = state->drv[1];
+	bank->pull[0] = state->pull[0];
+	bank->pull[1] = state->pull[1];
+	for (unsigned int i = 0; i < 4; i++)
+		bank->cfg[i] = state->cfg[i];
+	return 0;
+}
 
-	return value ;
+int fagpio_bank_restore(uint8_t port, const struct fagpio_bank_state *state) {
+	return fagpio_port_restore(&default_handle, port, state);
 }
 
 //int main(void) {
@@ -11,38 +11,196 @@
 #include <sys/mman.h>
 
 #define MAP_SIZE			0x400							//MMU page size
-#define GPIO_REG_BASE		0x01C20800						//GPIO physical base address (small page 4kb)
+#define GPIO_REG_BASE		0x01C20800						//GPIO physical base address (small page 4kb), the same on every fagpio_soc.h SoC
 #define GPIO_BASE_OFFSET	(GPIO_REG_BASE & 0X00000FFF)	//GPIO base address offset calculation
 #define GPIO_PAGE_OFFSET	(GPIO_REG_BASE & 0XFFFFF000)	//Get page offset
 
 #define PIO_DAT_OFF			0x10
 #define PIO_ADDR_PORT		0x800
-#define INPUT				0
-#define OUTPUT				1
-#define DISABLE				2
+#define OUTPUT				0	//pinMode() modes, numbered like the legacy 0/1 calls
+#define INPUT				1
+#define DISABLE				2	//CFG function 7, pin disconnected
 
 #define HIGH				1
 #define LOW					0
 
+#define RISING				0	//Edges, numbered like the EINT trigger codes
+#define FALLING				1
+#define CHANGE				4
+
+#define PULL_NONE			0	//Pull-up/down disabled
+#define PULL_UP				1
+#define PULL_DOWN			2
+
+#define DRIVE_LEVEL0		0	//Weakest drive, slowest edges
+#define DRIVE_LEVEL1		1
+#define DRIVE_LEVEL2		2
+#define DRIVE_LEVEL3		3	//Strongest drive, fastest edges
+
 #define rPE_CFG0			0X90	//PE_CFG0 register address offset
 #define rPE_DAT				0XA0	//PE_DAT register address offset
 #define rPE_PULL0			0XAC	//PE_PULL0 register address offset
 #define rPE_PULL1			0XB0	//PE_PULL1 register address offset
 
+#define PIO_PORT_A			0
+#define PIO_PORT_B			1
+#define PIO_PORT_C			2
+#define PIO_PORT_D			3
+#define PIO_PORT_E			4
+#define PIO_PORT_F			5
+#define PIO_PORT_G			6	//V3s and H3 only
+#define PIO_NPORTS			7	//Banks of the largest supported SoC, see fagpio_soc.h
+#define PIO_BANK_SIZE		0x24	//Each port bank: CFG0-3, DAT, DRV0-1, PULL0-1
+
+/*
+ * Pins are numbered port * 32 + index, so PE3 is PIO_PIN(PIO_PORT_E, 3).
+ */
+#define PIO_PIN(port, n)	((uint8_t)(((port) << 5) | ((n) & 0x1F)))
+#define PIO_PIN_PORT(pin)	((pin) >> 5)
+#define PIO_PIN_NUM(pin)	((pin) & 0x1F)
+#define PIO_PIN_MASK(pin)	(1u << PIO_PIN_NUM(pin))	//Bit of the pin in its port DAT word
+
+// Implemented pins of each F1C100s port: PA0-3, PB0-3, PC0-3, PD0-21, PE0-12, PF0-5
+#define PIO_PORT_NPINS(port)	((port) == PIO_PORT_D ? 22 : (port) == PIO_PORT_E ? 13 : (port) == PIO_PORT_F ? 6 : (port) == PIO_PORT_G ? 0 : 4)
+
+// Most pins of each port on any supported SoC, for code that cannot ask fagpio_port_pins()
+#define PIO_PORT_MAXPINS(port)	((port) == PIO_PORT_E ? 25 : (port) == PIO_PORT_A || (port) == PIO_PORT_D ? 22 : \
+								 (port) == PIO_PORT_C ? 19 : (port) == PIO_PORT_G ? 14 : (port) == PIO_PORT_B ? 10 : 7)
+
 #define BLOCK_SIZE			0x4000
 
+#define FAGPIO_BACKEND_DEVMEM	0	//O_SYNC mapping of /dev/mem, needs root
+#define FAGPIO_BACKEND_UIO		1	//map0 of a generic-uio device, see FAGPIO_UIO_NAME
+#define FAGPIO_BACKEND_CHIP		2	//GPIO character device, no mapping (gpio.addr is NULL)
+#define FAGPIO_BACKEND_SIM		3	//In-memory PIO for host builds, see fagpio_sim.h
+#define FAGPIO_BACKEND_DAEMON	4	//Port commands to fagpiod (fagpio_daemon.h), no mapping
+#define FAGPIO_BACKEND_BIT(b)	(1u << (b))
+
+/*
+ * Backends built into the library, a mask of FAGPIO_BACKEND_BIT()s. With
+ * no backend lacking a mapping (chip, daemon) the slow paths that call
+ * one are compiled out; with one of them only, its calls are direct; a
+ * library on register backends only never calls through a pointer.
+ */
+#ifndef FAGPIO_BACKENDS
+#define FAGPIO_BACKENDS			0x1F
+#endif
+#define FAGPIO_UIO_NAME			"fagpio-pio"
+
+struct pio_bank {
+	volatile uint32_t cfg[4];	//0x00 CFG0-3: 4 bits per pin, 8 pins per register
+	volatile uint32_t dat;		//0x10 DAT: 1 bit per pin
+	volatile uint32_t drv[2];	//0x14 DRV0-1: 2 bits per pin, 16 pins per register
+	volatile uint32_t pull[2];	//0x1C PULL0-1: 2 bits per pin, 16 pins per register
+};
+
+// Snapshot of one port bank for fagpio_bank_save/fagpio_bank_restore
+struct fagpio_bank_state {
+	uint32_t cfg[4];
+	uint32_t dat;
+	uint32_t drv[2];
+	uint32_t pull[2];
+};
+
 struct cpu_peripheral {
 	unsigned long addr_p;
 	int mem_fd;
 	void *map;
 	volatile unsigned int *addr;
+	unsigned long size;				//Bytes mapped at addr
+	int backend;					//FAGPIO_BACKEND_*
 };
 
+/*
+ * Opaque GPIO handle: one register mapping with its own pin table and DAT
+ * shadows. fagpio_default() is the handle behind pinMode()/digitalWrite()
+ * and the other Arduino-style calls, which stay wrappers around it.
+ */
+typedef struct fagpio_handle fagpio_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern struct cpu_peripheral gpio;
+
 int fagpio_setup(void);
 void fagpio_free(void);
+struct pio_bank *fagpio_banks(void);
+
+void fagpio_shadow_enable(uint8_t enable);
+void fagpio_shadow_sync(uint8_t port);
+
+/*
+ * Read epochs for loop-style sketches: after fagpio_epoch_begin(),
+ * digitalRead() reads each port's DAT once and serves every later pin of
+ * that port from the copy, until the next fagpio_epoch_begin() or
+ * fagpio_epoch_end(), pins the loop wrote meanwhile included. Only
+ * digitalRead() is cached; digitalReadPort(), the handle calls and the
+ * drivers still read the registers, so a pin is never stale mid-protocol.
+ * Single-threaded: the epoch belongs to the loop that begins it.
+ */
+void fagpio_epoch_begin(void);
+void fagpio_epoch_end(void);
+
+/*
+ * Deferred pin writes: with fagpio_defer_enable(1), digitalWrite(),
+ * digitalWriteBit(), digitalSet(), digitalClear() and digitalToggle()
+ * only record the new level; fagpio_flush(), an epoch boundary or
+ * fagpio_defer_enable(0) then issues one DAT store per port written.
+ * Bracketing a loop with fagpio_epoch_begin() and fagpio_epoch_end()
+ * turns its pin writes into port writes. Port writes and the drivers are
+ * never deferred. Single-threaded, like the epochs.
+ */
+void fagpio_defer_enable(uint8_t enable);
+void fagpio_flush(void);
 
 void pinMode(uint8_t Pin, uint8_t Mode);
+int pinFunction(uint8_t pin, uint8_t fn);		//CFG function 0-7, see fagpio_pinfunc.h; -1 if the pin lacks it
+void pinModeMask(uint8_t port, uint32_t mask, uint8_t Mode);
+void pinPull(uint8_t pin, uint8_t pull);
+void pinPullMask(uint8_t port, uint32_t mask, uint8_t pull);
+void pinDrive(uint8_t pin, uint8_t level);
+void pinDriveMask(uint8_t port, uint32_t mask, uint8_t level);
 void digitalWrite(uint8_t pin, uint8_t value);
+void digitalWriteBit(uint8_t pin, uint32_t value);		//Bit 0 of value, without branching on it
+void digitalSet(uint8_t pin);
+void digitalClear(uint8_t pin);
 uint8_t digitalRead(uint8_t pin);
+void digitalWritePort(uint8_t port, uint32_t mask, uint32_t value);
+uint32_t digitalReadPort(uint8_t port);
+void digitalToggle(uint8_t pin);
+int fagpio_bank_save(uint8_t port, struct fagpio_bank_state *state);
+int fagpio_bank_restore(uint8_t port, const struct fagpio_bank_state *state);
+void digitalTogglePort(uint8_t port, uint32_t mask);
+void fagpio_io_barrier(void);		//Waits for earlier PIO stores to land, see fagpio_inline.h
+
+fagpio_t *fagpio_open(const char *backend);		//"devmem", "uio", "chip", "sim", "daemon" or NULL for FAGPIO_BACKEND
+void fagpio_close(fagpio_t *h);
+fagpio_t *fagpio_default(void);
+int fagpio_handle_backend(fagpio_t *h);
+struct pio_bank *fagpio_handle_banks(fagpio_t *h);
+void fagpio_handle_shadow(fagpio_t *h, uint8_t enable);
+void fagpio_handle_sync(fagpio_t *h, uint8_t port);
+
+void fagpio_pin_mode(fagpio_t *h, uint8_t pin, uint8_t mode);
+void fagpio_pin_pull(fagpio_t *h, uint8_t pin, uint8_t pull);
+void fagpio_pin_drive(fagpio_t *h, uint8_t pin, uint8_t level);
+void fagpio_port_mode(fagpio_t *h, uint8_t port, uint32_t mask, uint8_t mode);
+void fagpio_port_pull(fagpio_t *h, uint8_t port, uint32_t mask, uint8_t pull);
+void fagpio_port_drive(fagpio_t *h, uint8_t port, uint32_t mask, uint8_t level);
+void fagpio_digital_write(fagpio_t *h, uint8_t pin, uint8_t value);
+void fagpio_digital_write_bit(fagpio_t *h, uint8_t pin, uint32_t value);
+uint8_t fagpio_digital_read(fagpio_t *h, uint8_t pin);
+void fagpio_port_write(fagpio_t *h, uint8_t port, uint32_t mask, uint32_t value);
+void fagpio_port_toggle(fagpio_t *h, uint8_t port, uint32_t mask);
+uint32_t fagpio_port_read(fagpio_t *h, uint8_t port);
+int fagpio_port_save(fagpio_t *h, uint8_t port, struct fagpio_bank_state *state);
+int fagpio_port_restore(fagpio_t *h, uint8_t port, const struct fagpio_bank_state *state);
+void fagpio_handle_io_barrier(fagpio_t *h);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif
@@ -0,0 +1,160 @@
+#ifndef _FAGPIO_HPP
+#define _FAGPIO_HPP
+
+/*
+ * Header-only C++17 access to single pins. Everything about a pin is a
+ * compile-time constant, so Pin<Port::E, 3>::set() compiles to a load of
+ * gpio.addr and a read-modify-write of DAT at an immediate offset with an
+ * immediate mask, without the call into libfagpio.so.
+ *
+ * fagpio_setup() must still be called once to map the registers. These
+ * accessors always read DAT and do not use the shadow registers.
+ */
+
+#include "fagpio.h"
+#include "fagpio_pinname.h"
+
+namespace fagpio {
+
+enum class Port : uint8_t {
+	A = PIO_PORT_A,
+	B = PIO_PORT_B,
+	C = PIO_PORT_C,
+	D = PIO_PORT_D,
+	E = PIO_PORT_E,
+	F = PIO_PORT_F,
+	G = PIO_PORT_G,
+};
+
+inline volatile uint32_t &reg(uint32_t offset) {
+	return *reinterpret_cast<volatile uint32_t *>(reinterpret_cast<volatile unsigned char *>(gpio.addr) + offset);
+}
+
+template <Port P, unsigned N>
+struct Pin {
+	static_assert(static_cast<unsigned>(P) < PIO_NPORTS, "no such port");
+	static_assert(N < 32, "pin index out of range");
+
+	static constexpr uint8_t port = static_cast<uint8_t>(P);
+	static constexpr uint8_t number = N;
+	static constexpr uint8_t id = (port << 5) | N;		//Same numbering as PIO_PIN()
+	static constexpr uint32_t mask = 1u << N;
+
+	static constexpr uint32_t bank_offset = GPIO_BASE_OFFSET + port * PIO_BANK_SIZE;
+	static constexpr uint32_t cfg_offset = bank_offset + (N >> 3) * 4;
+	static constexpr uint32_t dat_offset = bank_offset + PIO_DAT_OFF;
+	static constexpr unsigned cfg_shift = (N & 7) * 4;
+	static constexpr uint32_t cfg_mask = 0xFu << cfg_shift;
+
+	// Raw CFG function number: 0 input, 1 output, 7 disabled
+	static void function(uint32_t fn) {
+		volatile uint32_t &cfg = reg(cfg_offset);
+		cfg = (cfg & ~cfg_mask) | ((fn & 0xF) << cfg_shift);
+	}
+	static void output() { function(1); }
+	static void input() { function(0); }
+
+	static void set() { reg(dat_offset) |= mask; }
+	static void clear() { reg(dat_offset) &= ~mask; }
+	static void write(bool value) { value ? set() : clear(); }
+	static bool read() { return (reg(dat_offset) & mask) != 0; }
+};
+
+// Not constexpr: reached during constant evaluation it makes a bad name a compile error
+inline uint8_t invalid_pin_name() { return FAGPIO_NO_PIN; }
+
+// "PE3"_pin is PIO_PIN(PIO_PORT_E, 3); FAGPIO_NO_PIN for a bad name parsed at run time
+constexpr uint8_t operator""_pin(const char *name, size_t len) {
+	return fagpio_pin_parse_n(name, len) < 0 ? invalid_pin_name() : static_cast<uint8_t>(fagpio_pin_parse_n(name, len));
+}
+
+/*
+ * Whole-port access with the bank offset as a compile-time constant, for
+ * writes of several pins of one port. Each call exists in two forms: on the
+ * global mapping like Pin, and on a bank array kept in a local (from
+ * fagpio_banks() or GpioController::banks()), where store() is a single
+ * STR at an immediate offset from that register. Dynamic pin numbers keep
+ * using the runtime-indexed C calls.
+ */
+template <Port P>
+struct PortBank {
+	static_assert(static_cast<unsigned>(P) < PIO_NPORTS, "no such port");
+
+	static constexpr uint8_t port = static_cast<uint8_t>(P);
+	static constexpr uint32_t bank_offset = GPIO_BASE_OFFSET + port * PIO_BANK_SIZE;
+	static constexpr uint32_t dat_offset = bank_offset + PIO_DAT_OFF;
+
+	static volatile uint32_t &dat() { return reg(dat_offset); }
+	static volatile uint32_t &dat(struct pio_bank *banks) { return banks[port].dat; }
+	static volatile uint32_t &cfg(unsigned i) { return reg(bank_offset + (i & 3) * 4); }
+	static volatile uint32_t &cfg(struct pio_bank *banks, unsigned i) { return banks[port].cfg[i & 3]; }
+
+	static void store(uint32_t value) { dat() = value; }		//Whole word, no read
+	static void write(uint32_t mask, uint32_t value) { dat() = (dat() & ~mask) | (value & mask); }
+	static void set(uint32_t mask) { dat() |= mask; }
+	static void clear(uint32_t mask) { dat() &= ~mask; }
+	static void toggle(uint32_t mask) { dat() ^= mask; }
+	static uint32_t read() { return dat(); }
+
+	static void store(struct pio_bank *banks, uint32_t value) { dat(banks) = value; }
+	static void write(struct pio_bank *banks, uint32_t mask, uint32_t value) {
+		dat(banks) = (dat(banks) & ~mask) | (value & mask);
+	}
+	static void set(struct pio_bank *banks, uint32_t mask) { dat(banks) |= mask; }
+	static void clear(struct pio_bank *banks, uint32_t mask) { dat(banks) &= ~mask; }
+	static void toggle(struct pio_bank *banks, uint32_t mask) { dat(banks) ^= mask; }
+	static uint32_t read(struct pio_bank *banks) { return dat(banks); }
+};
+
+/*
+ * Pins anywhere on the chip folded at compile time into one DAT mask per
+ * port, e.g. using Leds = PinSet<PIO_PIN(PIO_PORT_E, 3), PIO_PIN(PIO_PORT_E, 5),
+ * PIO_PIN(PIO_PORT_D, 1)>. Ports without pins in the set cost nothing, so
+ * Leds::write() is one read-modify-write of DAT per port in the set, here
+ * D then E.
+ */
+template <uint8_t... Pins>
+struct PinSet {
+	static_assert(((PIO_PIN_PORT(Pins) < PIO_NPORTS) && ...), "no such port");
+
+	static constexpr uint32_t mask(unsigned port) {
+		return ((PIO_PIN_PORT(Pins) == port ? PIO_PIN_MASK(Pins) : 0u) | ... | 0u);
+	}
+	static constexpr bool contains(uint8_t pin) { return ((Pins == pin) || ...); }
+	static constexpr unsigned ports() {
+		unsigned n = 0;
+		for (unsigned p = 0; p < PIO_NPORTS; p++)
+			n += mask(p) != 0;
+		return n;
+	}
+
+	static void write(bool value) {
+		each([value](volatile uint32_t &dat, uint32_t m) { dat = value ? dat | m : dat & ~m; });
+	}
+	static void set() { write(true); }
+	static void clear() { write(false); }
+	static void toggle() { each([](volatile uint32_t &dat, uint32_t m) { dat ^= m; }); }
+	static void output() { (Pin<static_cast<Port>(PIO_PIN_PORT(Pins)), PIO_PIN_NUM(Pins)>::output(), ...); }
+	static void input() { (Pin<static_cast<Port>(PIO_PIN_PORT(Pins)), PIO_PIN_NUM(Pins)>::input(), ...); }
+
+private:
+	template <unsigned P, typename F>
+	static void port_op(F f) {
+		if constexpr (mask(P) != 0)
+			f(reg(GPIO_BASE_OFFSET + P * PIO_BANK_SIZE + PIO_DAT_OFF), mask(P));
+	}
+	template <typename F>
+	static void each(F f) {
+		port_op<PIO_PORT_A>(f);
+		port_op<PIO_PORT_B>(f);
+		port_op<PIO_PORT_C>(f);
+		port_op<PIO_PORT_D>(f);
+		port_op<PIO_PORT_E>(f);
+		port_op<PIO_PORT_F>(f);
+		port_op<PIO_PORT_G>(f);
+	}
+};
+
+}
+
+#endif
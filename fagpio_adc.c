@@ -0,0 +1,128 @@
+#include "fagpio_priv.h"
+#include "fagpio_adc.h"
+#include "fagpio_region.h"
+#include "fagpio_timer.h"
+#include "fagpio_log.h"
+
+#define TP_CTRL0_CLK_DIV6	(2u << 20)
+#define TP_CTRL0_FS_DIV(n)	((uint32_t)(n) << 16)		//Rate TPADC_CLK_HZ >> (20 - n)
+#define TP_CTRL0_T_ACQ(n)	((uint32_t)(n) << 0)		//16 * (n + 1) clocks of acquisition
+#define TP_CTRL1_MODE_EN	(1u << 4)
+#define TP_CTRL1_ADC		(1u << 3)					//Auxiliary ADC instead of touch panel
+#define TP_FIFO_FLUSH		(1u << 4)
+#define TP_FIFO_OVERRUN		(1u << 17)
+#define TP_FIFO_CNT(stat)	(((stat) >> 8) & 0x1F)
+
+static struct {
+	uint8_t channels;
+	uint8_t next;			//Channel of the next sample out of the FIFO
+	uint32_t period;		//Ticks between samples
+} tpadc;
+
+static volatile uint32_t *tpadc_regs(void) {
+	if (!fagpio_banks())
+		return NULL;
+	return fagpio_region(FAGPIO_REGION_TPADC);
+}
+
+// Next enabled channel after ch, round robin like the converter
+static uint8_t next_channel(uint8_t ch) {
+	for (unsigned int i = 0; i < TPADC_CHANNELS; i++) {
+		ch = (ch + 1) % TPADC_CHANNELS;
+		if (tpadc.channels & (1u << ch))
+			return ch;
+	}
+	return ch;
+}
+
+uint32_t fagpio_tpadc_start(uint8_t channels, uint32_t hz) {
+	volatile uint32_t *tp = tpadc_regs();
+
+	channels &= (1u << TPADC_CHANNELS) - 1;
+	if (!tp || !channels || !hz)
+		return 0;
+
+	// Fastest rate not above hz, FS_DIV 0-15
+	unsigned int fs = 0;
+
+	while (fs < 15 && (TPADC_CLK_HZ >> (20 - (fs + 1))) <= hz)
+		fs++;
+
+	uint32_t rate = TPADC_CLK_HZ >> (20 - fs);
+	uint32_t acq = TPADC_CLK_HZ / (32 * rate);		//Half a sample period
+
+	if (acq)
+		acq--;
+	if (acq > 0xFFFF)
+		acq = 0xFFFF;
+
+	tp[rTP_CTRL1 / 4] = 0;
+	tp[rTP_CTRL0 / 4] = TP_CTRL0_CLK_DIV6 | TP_CTRL0_FS_DIV(fs) | TP_CTRL0_T_ACQ(acq);
+	tp[rTP_CTRL2 / 4] = 0;
+	tp[rTP_CTRL3 / 4] = 0;							//No median filter, every conversion is a sample
+	tp[rTP_INT_FIFO_CTRL / 4] = TP_FIFO_FLUSH;		//Interrupts and DRQ off
+	tp[rTP_INT_FIFO_STAT / 4] = ~0u;
+
+	tpadc.channels = channels;
+	tpadc.next = next_channel(TPADC_CHANNELS - 1);
+	tpadc.period = fagpio_tick_hz / rate;
+	tp[rTP_CTRL1 / 4] = TP_CTRL1_MODE_EN | TP_CTRL1_ADC | channels;
+	FAGPIO_LOG(FAGPIO_LOG_INFO, "TP ADC at %u Hz, channels %X\n", rate, channels);
+	return rate;
+}
+
+int fagpio_tpadc_read(struct fagpio_adc_sample *buf, unsigned int max) {
+	volatile uint32_t *tp = tpadc_regs();
+
+	if (!tp || !tpadc.channels)
+		return -1;
+
+	uint32_t n = TP_FIFO_CNT(tp[rTP_INT_FIFO_STAT / 4]);
+	uint32_t now = fagpio_ticks();
+
+	if (n > max)
+		n = max;
+	for (uint32_t i = 0; i < n; i++) {
+		buf[i].ticks = now - (n - 1 - i) * tpadc.period;
+		buf[i].value = tp[rTP_DATA / 4] & 0xFFF;
+		buf[i].channel = tpadc.next;
+		buf[i].pad = 0;
+		tpadc.next = next_channel(tpadc.next);
+	}
+	return n;
+}
+
+int fagpio_tpadc_capture(struct fagpio_adc_sample *buf, unsigned int count, uint32_t timeout_ticks) {
+	uint32_t start = fagpio_ticks();
+	unsigned int got = 0;
+
+	while (got < count) {
+		int n = fagpio_tpadc_read(buf + got, count - got);
+
+		if (n < 0)
+			return got ? (int)got : -1;
+		got += n;
+		if (timeout_ticks && fagpio_ticks() - start > timeout_ticks)
+			break;
+	}
+	return got;
+}
+
+int fagpio_tpadc_overrun(void) {
+	volatile uint32_t *tp = tpadc_regs();
+
+	if (!tp || !(tp[rTP_INT_FIFO_STAT / 4] & TP_FIFO_OVERRUN))
+		return 0;
+	tp[rTP_INT_FIFO_STAT / 4] = TP_FIFO_OVERRUN;
+	return 1;
+}
+
+void fagpio_tpadc_stop(void) {
+	volatile uint32_t *tp = tpadc_regs();
+
+	if (!tp)
+		return;
+	tp[rTP_CTRL1 / 4] = 0;
+	tp[rTP_INT_FIFO_CTRL / 4] = TP_FIFO_FLUSH;
+	tpadc.channels = 0;
+}
@@ -0,0 +1,51 @@
+#ifndef _FAGPIO_ADC_H
+#define _FAGPIO_ADC_H
+
+#include <stdint.h>
+
+/*
+ * The touch-panel ADC (0x01C24800, mapped with fagpio_region()) as a
+ * 12-bit auxiliary ADC on its X1, X2, Y1 and Y2 inputs. In continuous mode
+ * the block converts the enabled channels round robin into a FIFO, which
+ * fagpio_tpadc_read() drains without a syscall. Each sample is stamped on
+ * the AVS counter (fagpio_timer.h): the last one in the FIFO at the time
+ * of the drain, earlier ones one sample period apart, so they line up
+ * with fagpio_capture_edges() timestamps. Do not use it while the kernel
+ * touchscreen driver is bound.
+ */
+
+#define rTP_CTRL0			0x00
+#define rTP_CTRL1			0x04
+#define rTP_CTRL2			0x08
+#define rTP_CTRL3			0x0C
+#define rTP_INT_FIFO_CTRL	0x10
+#define rTP_INT_FIFO_STAT	0x14
+#define rTP_DATA			0x24
+
+#define TPADC_CHANNELS		4		//X1, X2, Y1, Y2
+#define TPADC_CLK_HZ		4000000	//24 MHz oscillator / 6
+#define TPADC_FIFO_DEPTH	32
+
+struct fagpio_adc_sample {
+	uint32_t ticks;
+	uint16_t value;			//0-4095
+	uint8_t channel;
+	uint8_t pad;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// channels is a bit mask of inputs; returns the conversion rate in Hz (shared by the channels), 0 on error
+uint32_t fagpio_tpadc_start(uint8_t channels, uint32_t hz);
+int fagpio_tpadc_read(struct fagpio_adc_sample *buf, unsigned int max);		//Whatever the FIFO holds now
+int fagpio_tpadc_capture(struct fagpio_adc_sample *buf, unsigned int count, uint32_t timeout_ticks);
+int fagpio_tpadc_overrun(void);						//Non-zero once per FIFO overflow; with several channels, restart to realign them
+void fagpio_tpadc_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
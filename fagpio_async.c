@@ -0,0 +1,412 @@
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "fagpio_async.h"
+#include "fagpio_dma.h"
+#include "fagpio_spi.h"
+#include "fagpio_uart.h"
+#include "fagpio_log.h"
+
+enum { OP_FREE, OP_STARTING, OP_QUEUED, OP_RUNNING, OP_DONE };
+enum { KIND_DMA_WAVE, KIND_SPI_DMA, KIND_SPI, KIND_UART, KIND_CALL };
+
+// What an operation holds: a class in the high byte, the unit in the low one
+#define KEY_DMA(ch)		(0x100 | (ch))
+#define KEY_SPI(bus)	(0x200 | (bus))
+#define KEY_UART(n)		(0x300 | (n))
+
+struct op {
+	uint8_t state;
+	uint8_t kind;
+	uint8_t unit;			//SPI bus or UART
+	uint8_t ch;				//DMA channel
+	uint16_t key[2];		//0 for none
+	uint32_t gen;			//Token is gen << 8 | slot
+	uint32_t seq;			//Submission order of queued jobs
+	const uint8_t *tx;
+	uint8_t *rx;
+	size_t len;
+	int (*fn)(void *);
+	void *fn_arg;
+	fagpio_async_cb cb;
+	void *arg;
+	int result;
+};
+
+static struct op ops[FAGPIO_ASYNC_MAX];
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work, done;		//Monotonic, set up by start()
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+static int started;
+static int event_fd = -1;
+static uint32_t next_seq;
+
+static fagpio_async_t token_of(const struct op *op) {
+	return (fagpio_async_t)((op->gen << 8) | (op - ops));
+}
+
+static struct op *find(fagpio_async_t token) {
+	struct op *op;
+
+	if (token < 0 || (token & 0xFF) >= FAGPIO_ASYNC_MAX)
+		return NULL;
+	op = &ops[token & 0xFF];
+	return op->state != OP_FREE && token_of(op) == token ? op : NULL;
+}
+
+static void timespec_after(struct timespec *ts, uint32_t us) {
+	clock_gettime(CLOCK_MONOTONIC, ts);
+	ts->tv_nsec += (long)(us % 1000000) * 1000;
+	ts->tv_sec += us / 1000000 + ts->tv_nsec / 1000000000;
+	ts->tv_nsec %= 1000000000;
+}
+
+static int before(const struct timespec *a, const struct timespec *b) {
+	return a->tv_sec < b->tv_sec || (a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec);
+}
+
+static void complete(struct op *op, int result) {
+	uint64_t one = 1;
+
+	op->result = result;
+	op->state = OP_DONE;
+	pthread_cond_broadcast(&done);
+	if (write(event_fd, &one, sizeof(one)) < 0)
+		return;		//Counter saturated, the fd is readable anyway
+}
+
+// Completes the hardware operations that ended; returns how many still run
+static unsigned int check_hw(void) {
+	unsigned int running = 0;
+
+	for (unsigned int i = 0; i < FAGPIO_ASYNC_MAX; i++) {
+		struct op *op = &ops[i];
+
+		if (op->state != OP_RUNNING)
+			continue;
+		if (op->kind == KIND_DMA_WAVE && !fagpio_dma_wave_busy(op->ch))
+			complete(op, fagpio_dma_wave_wait(op->ch, 0));
+		else if (op->kind == KIND_SPI_DMA && fagpio_spi_dma_done(op->unit))
+			complete(op, fagpio_spi_dma_wait(op->unit, op->ch));
+		else if (op->kind == KIND_DMA_WAVE || op->kind == KIND_SPI_DMA)
+			running++;
+	}
+	return running;
+}
+
+static struct op *oldest_queued(void) {
+	struct op *best = NULL;
+
+	for (unsigned int i = 0; i < FAGPIO_ASYNC_MAX; i++) {
+		if (ops[i].state == OP_QUEUED && (!best || (int32_t)(ops[i].seq - best->seq) < 0))
+			best = &ops[i];
+	}
+	return best;
+}
+
+static int run(struct op *op) {
+	switch (op->kind) {
+	case KIND_SPI:
+		return fagpio_spi_transfer(op->unit, op->tx, op->rx, op->len);
+	case KIND_UART:
+		return fagpio_uart_write(op->unit, op->tx, op->len);
+	default:
+		return op->fn(op->fn_arg);
+	}
+}
+
+/*
+Runs the queued jobs one at a time in submission order; between them it
+wakes every FAGPIO_ASYNC_POLL_US while hardware operations run, and
+sleeps on the condition otherwise.
+*/
+static void *worker(void *unused) {
+	struct timespec ts;
+
+	(void)unused;
+	pthread_mutex_lock(&lock);
+	for (;;) {
+		struct op *job = oldest_queued();
+
+		if (job) {
+			int result;
+
+			job->state = OP_RUNNING;
+			pthread_mutex_unlock(&lock);
+			result = run(job);
+			pthread_mutex_lock(&lock);
+			complete(job, result);
+			continue;
+		}
+		if (check_hw()) {
+			timespec_after(&ts, FAGPIO_ASYNC_POLL_US);
+			pthread_cond_timedwait(&work, &lock, &ts);
+		} else {
+			pthread_cond_wait(&work, &lock);
+		}
+	}
+	return NULL;
+}
+
+static void init_conds(void) {
+	pthread_condattr_t attr;
+
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&work, &attr);
+	pthread_cond_init(&done, &attr);
+	pthread_condattr_destroy(&attr);
+}
+
+// Under the lock: the eventfd and the worker, on first use
+static int start(void) {
+	pthread_t thread;
+
+	pthread_once(&once, init_conds);
+	if (started)
+		return 0;
+	if (event_fd < 0 && (event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "async: %s\n", strerror(errno));
+		return -1;
+	}
+	if (pthread_create(&thread, NULL, worker, NULL)) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "async: no worker thread\n");
+		return -1;
+	}
+	pthread_detach(thread);
+	started = 1;
+	return 0;
+}
+
+// Under the lock: a free slot, unless something uncollected holds one of the keys
+static struct op *alloc(uint8_t kind, uint16_t key0, uint16_t key1, fagpio_async_cb cb, void *arg) {
+	struct op *free_op = NULL;
+
+	if (start() < 0)
+		return NULL;
+	for (unsigned int i = 0; i < FAGPIO_ASYNC_MAX; i++) {
+		struct op *op = &ops[i];
+
+		if (op->state == OP_FREE) {
+			if (!free_op)
+				free_op = op;
+			continue;
+		}
+		for (unsigned int k = 0; k < 2; k++) {
+			if (op->key[k] && (op->key[k] == key0 || op->key[k] == key1))
+				return NULL;
+		}
+	}
+	if (!free_op)
+		return NULL;
+
+	uint32_t gen = (free_op->gen + 1) & 0x7FFFFF;
+
+	memset(free_op, 0, sizeof(*free_op));
+	free_op->gen = gen ? gen : 1;
+	free_op->state = OP_STARTING;
+	free_op->kind = kind;
+	free_op->key[0] = key0;
+	free_op->key[1] = key1;
+	free_op->cb = cb;
+	free_op->arg = arg;
+	return free_op;
+}
+
+static fagpio_async_t queue(struct op *op) {
+	op->seq = next_seq++;
+	op->state = OP_QUEUED;
+	pthread_cond_signal(&work);
+	return token_of(op);
+}
+
+// Hardware started: the worker begins polling it; a failed start frees the slot
+static fagpio_async_t launched(struct op *op, int ret) {
+	fagpio_async_t token = token_of(op);
+
+	pthread_mutex_lock(&lock);
+	if (ret < 0) {
+		op->state = OP_FREE;
+		token = -1;
+	} else {
+		op->state = OP_RUNNING;
+		pthread_cond_signal(&work);
+	}
+	pthread_mutex_unlock(&lock);
+	return token;
+}
+
+fagpio_async_t fagpio_async_dma_wave(uint8_t ch, uint8_t port, const struct fagpio_dmabuf *buf, size_t words, uint8_t drq, uint8_t wait, fagpio_async_cb cb, void *arg) {
+	struct op *op;
+
+	pthread_mutex_lock(&lock);
+	op = alloc(KIND_DMA_WAVE, KEY_DMA(ch), 0, cb, arg);
+	pthread_mutex_unlock(&lock);
+	if (!op)
+		return -1;
+	op->ch = ch;
+	return launched(op, fagpio_dma_wave_start(ch, port, buf, words, drq, wait, 0));
+}
+
+fagpio_async_t fagpio_async_spi_write_dma(uint8_t bus, uint8_t ch, const struct fagpio_dmabuf *buf, size_t offset, size_t len, fagpio_async_cb cb, void *arg) {
+	struct op *op;
+
+	pthread_mutex_lock(&lock);
+	op = alloc(KIND_SPI_DMA, KEY_SPI(bus), KEY_DMA(ch), cb, arg);
+	pthread_mutex_unlock(&lock);
+	if (!op)
+		return -1;
+	op->unit = bus;
+	op->ch = ch;
+	return launched(op, fagpio_spi_write_dma(bus, ch, buf, offset, len));
+}
+
+fagpio_async_t fagpio_async_spi_transfer(uint8_t bus, const uint8_t *tx, uint8_t *rx, size_t len, fagpio_async_cb cb, void *arg) {
+	fagpio_async_t token = -1;
+	struct op *op;
+
+	pthread_mutex_lock(&lock);
+	if ((op = alloc(KIND_SPI, KEY_SPI(bus), 0, cb, arg))) {
+		op->unit = bus;
+		op->tx = tx;
+		op->rx = rx;
+		op->len = len;
+		token = queue(op);
+	}
+	pthread_mutex_unlock(&lock);
+	return token;
+}
+
+fagpio_async_t fagpio_async_uart_write(uint8_t uart, const uint8_t *buf, size_t len, fagpio_async_cb cb, void *arg) {
+	fagpio_async_t token = -1;
+	struct op *op;
+
+	pthread_mutex_lock(&lock);
+	if ((op = alloc(KIND_UART, KEY_UART(uart), 0, cb, arg))) {
+		op->unit = uart;
+		op->tx = buf;
+		op->len = len;
+		token = queue(op);
+	}
+	pthread_mutex_unlock(&lock);
+	return token;
+}
+
+fagpio_async_t fagpio_async_call(int (*fn)(void *), void *fn_arg, fagpio_async_cb cb, void *arg) {
+	fagpio_async_t token = -1;
+	struct op *op;
+
+	if (!fn)
+		return -1;
+	pthread_mutex_lock(&lock);
+	if ((op = alloc(KIND_CALL, 0, 0, cb, arg))) {
+		op->fn = fn;
+		op->fn_arg = fn_arg;
+		token = queue(op);
+	}
+	pthread_mutex_unlock(&lock);
+	return token;
+}
+
+// Under the lock, which it releases: frees op and hands its result to the callback and the caller
+static void collect(struct op *op, int *result) {
+	fagpio_async_t token = token_of(op);
+	fagpio_async_cb cb = op->cb;
+	void *arg = op->arg;
+	int r = op->result;
+
+	op->state = OP_FREE;
+	pthread_mutex_unlock(&lock);
+	if (result)
+		*result = r;
+	if (cb)
+		cb(token, r, arg);
+}
+
+int fagpio_async_poll(fagpio_async_t token, int *result) {
+	struct op *op;
+
+	pthread_mutex_lock(&lock);
+	if (!(op = find(token))) {
+		pthread_mutex_unlock(&lock);
+		return -1;
+	}
+	if (op->state == OP_RUNNING)
+		check_hw();
+	if (op->state != OP_DONE) {
+		pthread_mutex_unlock(&lock);
+		return 0;
+	}
+	collect(op, result);
+	return 1;
+}
+
+int fagpio_async_wait(fagpio_async_t token, int *result, int timeout_ms) {
+	struct timespec deadline, ts;
+	struct op *op;
+
+	timespec_after(&deadline, timeout_ms > 0 ? (uint32_t)timeout_ms * 1000 : 0);
+	pthread_mutex_lock(&lock);
+	if (!(op = find(token))) {
+		pthread_mutex_unlock(&lock);
+		return -1;
+	}
+	for (;;) {
+		if (op->state == OP_RUNNING)
+			check_hw();
+		if (op->state == OP_DONE)
+			break;
+		if (!timeout_ms) {
+			pthread_mutex_unlock(&lock);
+			return 0;
+		}
+		timespec_after(&ts, FAGPIO_ASYNC_POLL_US);
+		if (timeout_ms > 0 && before(&deadline, &ts)) {
+			clock_gettime(CLOCK_MONOTONIC, &ts);
+			if (!before(&ts, &deadline)) {
+				pthread_mutex_unlock(&lock);
+				return 0;
+			}
+			ts = deadline;
+		}
+		pthread_cond_timedwait(&done, &lock, &ts);
+	}
+	collect(op, result);
+	return 1;
+}
+
+int fagpio_async_fd(void) {
+	int fd;
+
+	pthread_mutex_lock(&lock);
+	fd = start() < 0 ? -1 : event_fd;
+	pthread_mutex_unlock(&lock);
+	return fd;
+}
+
+// Operations without a callback stay for their poll or wait
+int fagpio_async_dispatch(void) {
+	uint64_t count;
+	int ran = 0;
+
+	if (event_fd >= 0 && read(event_fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+		return -1;
+	for (;;) {
+		struct op *op = NULL;
+
+		pthread_mutex_lock(&lock);
+		for (unsigned int i = 0; i < FAGPIO_ASYNC_MAX && !op; i++) {
+			if (ops[i].state == OP_DONE && ops[i].cb)
+				op = &ops[i];
+		}
+		if (!op) {
+			pthread_mutex_unlock(&lock);
+			return ran;
+		}
+		collect(op, NULL);
+		ran++;
+	}
+}
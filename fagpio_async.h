@@ -0,0 +1,66 @@
+#ifndef _FAGPIO_ASYNC_H
+#define _FAGPIO_ASYNC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fagpio_dmabuf.h"
+
+/*
+ * Non-blocking submission of the long transfers, each returning a
+ * completion token. Operations the hardware finishes by itself (DMA
+ * waveforms, SPI bursts fed by DMA) are started at once and cost no CPU
+ * until they end; CPU-driven ones (FIFO SPI transfers, UART writes, any
+ * function through fagpio_async_call()) run in submission order on one
+ * worker thread, so the caller can compute while they go.
+ *
+ * A result is collected once, by one of:
+ * - fagpio_async_poll(token, &result), which never blocks;
+ * - fagpio_async_wait(token, &result, timeout_ms);
+ * - the callback given at submission, run by fagpio_async_dispatch() in
+ *   the caller's thread (or by a poll or wait that finds it done).
+ *
+ * fagpio_async_fd() is an eventfd readable while completions are
+ * waiting: put it in an epoll set, or in fagpio_notify_fd()'s with
+ * fagpio_notify_add(), and call fagpio_async_dispatch() when it fires.
+ * The worker checks running hardware operations every
+ * FAGPIO_ASYNC_POLL_US; a wait checks them too while it sleeps.
+ *
+ * Each operation holds its SPI bus, UART or DMA channel until its result
+ * is collected, and a submission for one that is held fails.
+ */
+
+#ifndef FAGPIO_ASYNC_MAX
+#define FAGPIO_ASYNC_MAX		32		//Operations in flight or uncollected
+#endif
+#ifndef FAGPIO_ASYNC_POLL_US
+#define FAGPIO_ASYNC_POLL_US	200
+#endif
+
+typedef int32_t fagpio_async_t;		//Token, -1 when the submission failed
+
+typedef void (*fagpio_async_cb)(fagpio_async_t token, int result, void *arg);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Hardware: the result is fagpio_dma_wave_wait()'s ticks for a waveform, 0 or -1 for SPI
+fagpio_async_t fagpio_async_dma_wave(uint8_t ch, uint8_t port, const struct fagpio_dmabuf *buf, size_t words, uint8_t drq, uint8_t wait, fagpio_async_cb cb, void *arg);
+fagpio_async_t fagpio_async_spi_write_dma(uint8_t bus, uint8_t ch, const struct fagpio_dmabuf *buf, size_t offset, size_t len, fagpio_async_cb cb, void *arg);
+
+// Worker thread: the buffers must stay valid until the result is collected
+fagpio_async_t fagpio_async_spi_transfer(uint8_t bus, const uint8_t *tx, uint8_t *rx, size_t len, fagpio_async_cb cb, void *arg);
+fagpio_async_t fagpio_async_uart_write(uint8_t uart, const uint8_t *buf, size_t len, fagpio_async_cb cb, void *arg);
+fagpio_async_t fagpio_async_call(int (*fn)(void *), void *fn_arg, fagpio_async_cb cb, void *arg);
+
+int fagpio_async_poll(fagpio_async_t token, int *result);		//1 done and collected, 0 running, -1 no such token
+int fagpio_async_wait(fagpio_async_t token, int *result, int timeout_ms);	//Same, waiting up to timeout_ms (-1 forever)
+
+int fagpio_async_fd(void);
+int fagpio_async_dispatch(void);		//Callbacks run
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef _FAGPIO_ATOMIC_H
+#define _FAGPIO_ATOMIC_H
+
+#include <stdint.h>
+
+/*
+ * Compare-and-swap for the ARM926EJ-S, which has no LDREX/STREX. The
+ * kernel's __kuser_cmpxchg helper at 0xffff0fc0 is a restartable sequence
+ * on uniprocessor kernels and uses the right barriers on SMP ones, so it
+ * is safe against preemption without a syscall. Other targets (host
+ * builds) use the compiler builtin.
+ */
+#if defined(__arm__) && defined(__linux__)
+typedef int (fagpio_kuser_cmpxchg_t)(int oldval, int newval, volatile int *ptr);
+#define fagpio_kuser_cmpxchg	(*(fagpio_kuser_cmpxchg_t *)0xffff0fc0)
+
+// Non-zero if *ptr held old and now holds val
+static inline int fagpio_cas(volatile uint32_t *ptr, uint32_t old, uint32_t val) {
+	return fagpio_kuser_cmpxchg((int)old, (int)val, (volatile int *)ptr) == 0;
+}
+
+/*
+ * ARMv5 has no DMB. The kernel's __kuser_memory_barrier at 0xffff0fa0 is
+ * a plain return on uniprocessor kernels and the right barrier on SMP
+ * ones; being an opaque call it is also a compiler barrier.
+ */
+typedef void (fagpio_kuser_barrier_t)(void);
+#define fagpio_kuser_barrier	(*(fagpio_kuser_barrier_t *)0xffff0fa0)
+
+static inline void fagpio_barrier(void) {
+	__asm__ __volatile__("" ::: "memory");
+	fagpio_kuser_barrier();
+}
+#else
+static inline int fagpio_cas(volatile uint32_t *ptr, uint32_t old, uint32_t val) {
+	return __sync_bool_compare_and_swap(ptr, old, val);
+}
+
+static inline void fagpio_barrier(void) {
+	__sync_synchronize();
+}
+#endif
+
+#endif
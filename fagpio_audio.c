@@ -0,0 +1,230 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "fagpio_priv.h"
+#include "fagpio_audio.h"
+#include "fagpio_dma.h"
+#include "fagpio_spi.h"
+#include "fagpio_log.h"
+#include "fagpio_mem.h"
+#include "fagpio_timer.h"
+
+struct memory_source {
+	const uint8_t *p;
+	size_t left;			//Samples
+	size_t size;			//Bytes per sample
+};
+
+// The rate fagpio_spi_open() sets for hz
+static uint32_t spi_rate(uint32_t hz) {
+	uint32_t div = SPI_AHB_HZ / (2 * hz);
+
+	if (div)
+		div--;
+	if (div > 255)
+		div = 255;
+	return SPI_AHB_HZ / (2 * (div + 1));
+}
+
+int fagpio_audio_open(struct fagpio_audio *a, uint8_t bus, uint32_t spi_hz, uint8_t dma_ch, uint32_t rate, uint8_t format) {
+	return fagpio_audio_open_arena(a, bus, spi_hz, dma_ch, rate, format, NULL);
+}
+
+int fagpio_audio_open_arena(struct fagpio_audio *a, uint8_t bus, uint32_t spi_hz, uint8_t dma_ch, uint32_t rate, uint8_t format, struct fagpio_arena *arena) {
+	memset(a, 0, sizeof(*a));
+	a->arena = arena;
+	if (bus > 1 || dma_ch >= FAGPIO_DMA_CHANNELS || !rate || !spi_hz || format > FAGPIO_AUDIO_S16)
+		return -1;
+
+	uint32_t hz = spi_rate(spi_hz);
+
+	a->bus = bus;
+	a->dma_ch = dma_ch;
+	a->format = format;
+	a->periods = (FAGPIO_AUDIO_CARRIER_HZ + rate - 1) / rate;
+	a->frame_bytes = hz / ((uint64_t)rate * a->periods * 8);
+	if (a->frame_bytes < 2) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "audio: %u Hz SPI is too slow for %u samples/s\n", hz, rate);
+		return -1;
+	}
+	a->levels = a->frame_bytes * 8;
+	a->rate = hz / (a->frame_bytes * 8 * a->periods);
+	a->part_samples = FAGPIO_AUDIO_PART_BYTES / (a->frame_bytes * a->periods);
+	a->part_bytes = a->part_samples * a->frame_bytes * a->periods;
+	if (!a->part_samples)
+		return -1;
+
+	if (!(a->pcm = fagpio_mem_take(arena, a->part_samples * (format == FAGPIO_AUDIO_S16 ? 2 : 1), 0)))
+		return -1;
+	if (fagpio_dmabuf_alloc(&a->dma, FAGPIO_AUDIO_PARTS * a->part_bytes) < 0) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "audio: no DMA buffer of %u bytes\n", (unsigned int)(FAGPIO_AUDIO_PARTS * a->part_bytes));
+		fagpio_audio_close(a);
+		return -1;
+	}
+	if (fagpio_spi_open(bus, hz, 0) < 0) {
+		fagpio_audio_close(a);
+		return -1;
+	}
+	FAGPIO_LOG(FAGPIO_LOG_INFO, "audio: %u samples/s, %u levels, %u PWM periods per sample\n", a->rate, a->levels, a->periods);
+	return 0;
+}
+
+void fagpio_audio_close(struct fagpio_audio *a) {
+	fagpio_audio_stop(a);
+	if (a->dma.size) {
+		fagpio_dmabuf_free(&a->dma);
+		fagpio_spi_close(a->bus);
+	}
+	fagpio_mem_give(a->arena, a->pcm);
+	a->pcm = NULL;
+}
+
+// One period of duty high bits, MSB first, then its copies for the sample
+static uint8_t *expand_sample(const struct fagpio_audio *a, uint8_t *dst, uint32_t duty) {
+	uint32_t full = duty >> 3;
+
+	memset(dst, 0xFF, full);
+	if (full < a->frame_bytes) {
+		dst[full] = (0xFF00 >> (duty & 7)) & 0xFF;
+		memset(dst + full + 1, 0, a->frame_bytes - full - 1);
+	}
+	for (uint32_t p = 1; p < a->periods; p++)
+		memcpy(dst + p * a->frame_bytes, dst, a->frame_bytes);
+	return dst + a->periods * a->frame_bytes;
+}
+
+// Calls the refill callback for part k; the samples it got
+static size_t fill_part(struct fagpio_audio *a, unsigned int k) {
+	uint8_t *dst = (uint8_t *)a->dma.virt + k * a->part_bytes;
+	size_t n = a->refill(a->pcm, a->part_samples, a->arg);
+
+	if (n > a->part_samples)
+		n = a->part_samples;
+	if (a->format == FAGPIO_AUDIO_S16) {
+		const int16_t *s = a->pcm;
+
+		for (size_t i = 0; i < n; i++)
+			dst = expand_sample(a, dst, ((uint32_t)(s[i] + 32768) * a->levels) >> 16);
+	} else {
+		const uint8_t *s = a->pcm;
+
+		for (size_t i = 0; i < n; i++)
+			dst = expand_sample(a, dst, (s[i] * a->levels + 128) >> 8);
+	}
+	return n;
+}
+
+static int start_part(struct fagpio_audio *a, unsigned int k) {
+	return fagpio_spi_write_dma(a->bus, a->dma_ch, &a->dma, k * a->part_bytes, a->filled[k] * a->frame_bytes * a->periods);
+}
+
+/*
+Sleeps through a part but its last FAGPIO_AUDIO_SPIN_US, then polls for
+its end and starts the next one, which the ring filled earlier; only then
+is the finished part refilled, so the callback's time is hidden behind
+the part now playing.
+*/
+static void *audio_main(void *arg) {
+	struct fagpio_audio *a = arg;
+	uint32_t spin = (uint64_t)FAGPIO_AUDIO_SPIN_US * fagpio_tick_hz / 1000000;
+	unsigned int k = 0;
+	int ended = 0;
+
+	if (start_part(a, 0) < 0) {
+		a->done = 1;
+		return NULL;
+	}
+	for (;;) {
+		uint32_t start = fagpio_ticks();
+		uint32_t len = (uint64_t)a->filled[k] * fagpio_tick_hz / a->rate;
+
+		if (len > spin)
+			usleep((uint64_t)(len - spin) * 1000000 / fagpio_tick_hz);
+		if (fagpio_spi_dma_done(a->bus) && fagpio_ticks() - start > len + spin)
+			a->underruns++;
+		fagpio_spi_dma_wait(a->bus, a->dma_ch);
+
+		unsigned int next = (k + 1) % FAGPIO_AUDIO_PARTS;
+
+		if (a->stop || !a->filled[next] || start_part(a, next) < 0)
+			break;
+		if (!ended) {
+			a->filled[k] = fill_part(a, k);
+			ended = a->filled[k] < a->part_samples;
+		} else {
+			a->filled[k] = 0;
+		}
+		k = next;
+	}
+	a->done = 1;
+	return NULL;
+}
+
+int fagpio_audio_start(struct fagpio_audio *a, fagpio_audio_refill refill, void *arg, int prio) {
+	pthread_attr_t attr;
+	int ended = 0, err;
+
+	if (!a->dma.size || a->running || !refill)
+		return -1;
+	a->refill = refill;
+	a->arg = arg;
+	a->stop = 0;
+	a->done = 0;
+	for (unsigned int k = 0; k < FAGPIO_AUDIO_PARTS; k++) {
+		a->filled[k] = ended ? 0 : fill_part(a, k);
+		ended = a->filled[k] < a->part_samples;
+	}
+	if (!a->filled[0]) {
+		a->done = 1;
+		return 0;
+	}
+
+	pthread_attr_init(&attr);
+	if (prio > 0) {
+		struct sched_param sp = { .sched_priority = prio };
+
+		pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+		pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+		pthread_attr_setschedparam(&attr, &sp);
+	}
+	err = pthread_create(&a->thread, &attr, audio_main, a);
+	pthread_attr_destroy(&attr);
+	if (err) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "audio: %s\n", strerror(err));
+		return -1;
+	}
+	a->running = 1;
+	return 0;
+}
+
+int fagpio_audio_wait(struct fagpio_audio *a) {
+	if (a->running) {
+		pthread_join(a->thread, NULL);
+		a->running = 0;
+	}
+	return 0;
+}
+
+void fagpio_audio_stop(struct fagpio_audio *a) {
+	a->stop = 1;
+	fagpio_audio_wait(a);
+}
+
+static size_t refill_memory(void *pcm, size_t count, void *arg) {
+	struct memory_source *m = arg;
+
+	if (count > m->left)
+		count = m->left;
+	memcpy(pcm, m->p, count * m->size);
+	m->p += count * m->size;
+	m->left -= count;
+	return count;
+}
+
+int fagpio_audio_play(struct fagpio_audio *a, const void *pcm, size_t count) {
+	struct memory_source m = { pcm, count, a->format == FAGPIO_AUDIO_S16 ? 2 : 1 };
+
+	if (fagpio_audio_start(a, refill_memory, &m, 0) < 0)
+		return -1;
+	return fagpio_audio_wait(a);
+}
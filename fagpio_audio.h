@@ -0,0 +1,94 @@
+#ifndef _FAGPIO_AUDIO_H
+#define _FAGPIO_AUDIO_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "fagpio_dmabuf.h"
+#include "fagpio_mem.h"
+
+/*
+ * PCM playback as PWM on a pin, fed by DMA. The PWM block of the F1C100s
+ * has no DMA request line, so the PWM periods are built as bit patterns
+ * instead and shifted out of an SPI bus's MOSI pin (fagpio_spi.h), whose
+ * request line paces the DMA channel to the bit clock: each sample
+ * becomes periods_per_sample periods of frame_bytes * 8 bits, the first
+ * duty bits high. Put an RC low-pass and an amplifier after MOSI (PC3 on
+ * SPI0, PE9 on SPI1).
+ *
+ * The patterns live in a ring of FAGPIO_AUDIO_PARTS parts of one
+ * physically contiguous DMA buffer (fagpio_dmabuf.h). A playback thread
+ * starts each part as the previous one ends and then refills the part
+ * that finished: it calls the refill callback for the next samples and
+ * expands them with memset(), so the CPU time is a few stores per byte
+ * and nothing toggles pins. A short part gap is covered by the SPI FIFO.
+ *
+ * The refill callback gets a buffer for up to count samples (uint8_t
+ * unsigned for FAGPIO_AUDIO_U8, int16_t signed for FAGPIO_AUDIO_S16) and
+ * returns how many it stored; fewer than count ends the playback once
+ * they have been played. fagpio_audio_stop() takes effect at the end of
+ * the part being played.
+ */
+
+#define FAGPIO_AUDIO_U8			0
+#define FAGPIO_AUDIO_S16		1
+
+#ifndef FAGPIO_AUDIO_PARTS
+#define FAGPIO_AUDIO_PARTS		4
+#endif
+#ifndef FAGPIO_AUDIO_PART_BYTES
+#define FAGPIO_AUDIO_PART_BYTES	(32 * 1024)		//At most one DMA burst, 128 KB
+#endif
+#ifndef FAGPIO_AUDIO_SPIN_US
+#define FAGPIO_AUDIO_SPIN_US	1000			//Polled rather than slept before a part ends
+#endif
+#ifndef FAGPIO_AUDIO_CARRIER_HZ
+#define FAGPIO_AUDIO_CARRIER_HZ	32000			//Lowest PWM frequency, above the audio band of small speakers
+#endif
+
+typedef size_t (*fagpio_audio_refill)(void *pcm, size_t count, void *arg);
+
+struct fagpio_audio {
+	uint8_t bus, dma_ch;
+	uint8_t format;
+	uint32_t rate;				//Samples per second played, after rounding
+	uint32_t frame_bytes;		//SPI bytes per PWM period
+	uint32_t periods;			//PWM periods per sample
+	uint32_t levels;			//Duty steps, frame_bytes * 8
+	size_t part_samples;
+	size_t part_bytes;
+	struct fagpio_dmabuf dma;
+	void *pcm;					//part_samples samples for the callback
+	struct fagpio_arena *arena;	//Holds pcm, NULL for fagpio_mem_alloc()
+	size_t filled[FAGPIO_AUDIO_PARTS];	//Samples in each part, 0 past the end
+	fagpio_audio_refill refill;
+	void *arg;
+	pthread_t thread;
+	int running;
+	volatile int stop;
+	volatile int done;
+	uint32_t underruns;			//Parts whose end was seen late, each a short gap
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// SPI bus 0 or 1 at about spi_hz, DMA channel 0-3; rate is adjusted to what the clocks allow
+int fagpio_audio_open(struct fagpio_audio *a, uint8_t bus, uint32_t spi_hz, uint8_t dma_ch, uint32_t rate, uint8_t format);
+int fagpio_audio_open_arena(struct fagpio_audio *a, uint8_t bus, uint32_t spi_hz, uint8_t dma_ch, uint32_t rate, uint8_t format, struct fagpio_arena *arena);
+void fagpio_audio_close(struct fagpio_audio *a);
+
+// Prefills every part and starts the playback thread, SCHED_FIFO at prio if non-zero
+int fagpio_audio_start(struct fagpio_audio *a, fagpio_audio_refill refill, void *arg, int prio);
+int fagpio_audio_wait(struct fagpio_audio *a);		//Until the last sample was played
+void fagpio_audio_stop(struct fagpio_audio *a);
+
+// Plays count samples from memory and waits for the end
+int fagpio_audio_play(struct fagpio_audio *a, const void *pcm, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "fagpio_priv.h"
+#include "fagpio_autotune.h"
+#include "fagpio_log.h"
+
+static int passes(fagpio_autotune_check check, void *bus, void *arg, unsigned int trials, uint32_t *checks) {
+	for (unsigned int i = 0; i < trials; i++) {
+		++*checks;
+		if (check(bus, arg))
+			return 0;
+	}
+	return 1;
+}
+
+int fagpio_autotune_run(const struct fagpio_autotune *t, fagpio_autotune_set set, fagpio_autotune_check check,
+		void *bus, void *arg, struct fagpio_autotune_result *res) {
+	unsigned int step = t->step_pct ? t->step_pct : FAGPIO_AUTOTUNE_STEP;
+	unsigned int margin = t->margin_pct ? t->margin_pct : FAGPIO_AUTOTUNE_MARGIN;
+	unsigned int trials = t->trials ? t->trials : FAGPIO_AUTOTUNE_TRIALS;
+	uint32_t hz = t->min_hz, good = 0;
+	struct fagpio_autotune_result r = { 0 };
+
+	if (!t->min_hz || margin >= 100 || (t->max_hz && t->max_hz < t->min_hz))
+		return -1;
+	for (;;) {
+		int sat = set(bus, hz) > 0;
+
+		if (!passes(check, bus, arg, trials, &r.checks)) {
+			r.fail_hz = hz;
+			break;
+		}
+		good = hz;
+		if (sat || (t->max_hz && hz >= t->max_hz)) {
+			r.saturated = sat;
+			break;
+		}
+		hz += (uint64_t)hz * step / 100 ? (uint64_t)hz * step / 100 : 1;
+		if (hz < good)
+			break;		//Wrapped around
+		if (t->max_hz && hz > t->max_hz)
+			hz = t->max_hz;
+	}
+
+	// Only a rate that failed is backed off from; hz saturating or at max_hz stays
+	hz = r.fail_hz ? (uint64_t)good * (100 - margin) / 100 : good;
+	while (good && hz >= t->min_hz) {
+		set(bus, hz);
+		if (passes(check, bus, arg, trials * FAGPIO_AUTOTUNE_CONFIRM, &r.checks))
+			break;
+		hz = (uint64_t)hz * (100 - margin) / 100;
+	}
+	if (!good || hz < t->min_hz) {
+		set(bus, t->min_hz);
+		hz = 0;
+	}
+	r.hz = hz;
+	FAGPIO_LOG(FAGPIO_LOG_INFO, "autotune: %u Hz (first failure at %u Hz, %u checks)\n", r.hz, r.fail_hz, r.checks);
+	if (res)
+		*res = r;
+	return hz ? 0 : -1;
+}
+
+static int set_bbi2c(void *bus, uint32_t hz) {
+	return fagpio_bbi2c_set_hz(bus, hz);
+}
+
+static int set_bbspi(void *spi, uint32_t hz) {
+	return fagpio_bbspi_set_hz(spi, hz);
+}
+
+int fagpio_autotune_bbi2c(struct fagpio_bbi2c *bus, const struct fagpio_autotune *t, fagpio_autotune_check check,
+		void *arg, struct fagpio_autotune_result *res) {
+	return fagpio_autotune_run(t, set_bbi2c, check, bus, arg, res);
+}
+
+int fagpio_autotune_bbspi(struct fagpio_bbspi *spi, const struct fagpio_autotune *t, fagpio_autotune_check check,
+		void *arg, struct fagpio_autotune_result *res) {
+	return fagpio_autotune_run(t, set_bbspi, check, spi, arg, res);
+}
+
+int fagpio_autotune_i2c_reg(void *bbi2c, void *autotune_i2c) {
+	const struct fagpio_autotune_i2c *c = autotune_i2c;
+	uint8_t buf[256];
+
+	if (c->len > sizeof(buf) || fagpio_bbi2c_read_reg(bbi2c, c->addr, c->reg, buf, c->len) != 2)
+		return -1;
+	return memcmp(buf, c->expect, c->len) ? -1 : 0;
+}
+
+int fagpio_autotune_spi_ref(void *bbspi, void *autotune_spi) {
+	const struct fagpio_autotune_spi *c = autotune_spi;
+	uint8_t tx[FAGPIO_AUTOTUNE_SPI_MAX] = { 0 }, rx[FAGPIO_AUTOTUNE_SPI_MAX];
+	size_t n = c->tx_len + c->len;
+
+	if (n > sizeof(tx))
+		return -1;
+	memcpy(tx, c->tx, c->tx_len);
+	if (c->cs != FAGPIO_BBSPI_NO_PIN)
+		digitalWrite(c->cs, LOW);
+	fagpio_bbspi_transfer(bbspi, tx, rx, n);
+	if (c->cs != FAGPIO_BBSPI_NO_PIN)
+		digitalWrite(c->cs, HIGH);
+	return memcmp(rx + c->tx_len, c->expect, c->len) ? -1 : 0;
+}
+
+static const char *tune_path(const char *path) {
+	if (!path && !(path = getenv("FAGPIO_TUNE")))
+		path = FAGPIO_AUTOTUNE_FILE;
+	return path;
+}
+
+struct tune_entry {
+	char name[FAGPIO_AUTOTUNE_NAME];
+	unsigned long hz;
+};
+
+// The "name hz" lines of the file, read through an fd rather than a stdio stream
+static unsigned int tune_read(const char *path, struct tune_entry *e) {
+	char text[FAGPIO_AUTOTUNE_ENTRIES * (FAGPIO_AUTOTUNE_NAME + 12)];
+	int fd = open(path, O_RDONLY), len;
+	unsigned int count = 0;
+	ssize_t n;
+
+	if (fd < 0)
+		return 0;
+	n = read(fd, text, sizeof(text) - 1);
+	close(fd);
+	text[n > 0 ? n : 0] = '\0';
+	for (const char *p = text; count < FAGPIO_AUTOTUNE_ENTRIES && sscanf(p, "%31s %lu%n", e[count].name, &e[count].hz, &len) == 2; p += len)
+		count++;
+	return count;
+}
+
+uint32_t fagpio_autotune_load(const char *path, const char *name) {
+	struct tune_entry e[FAGPIO_AUTOTUNE_ENTRIES];
+	unsigned int count = tune_read(tune_path(path), e);
+
+	for (unsigned int i = 0; i < count; i++) {
+		if (!strcmp(e[i].name, name))
+			return e[i].hz;
+	}
+	return 0;
+}
+
+/*
+The other buses' lines are kept; the file is replaced through a rename,
+so a reader never sees it half written.
+*/
+int fagpio_autotune_save(const char *path, const char *name, uint32_t hz) {
+	struct tune_entry e[FAGPIO_AUTOTUNE_ENTRIES];
+	char tmp[4096];
+	unsigned int count, i;
+	int fd, ok = 1;
+
+	path = tune_path(path);
+	if (!*name || strlen(name) >= FAGPIO_AUTOTUNE_NAME || strpbrk(name, " \t\n"))
+		return -1;
+	count = tune_read(path, e);
+	for (i = 0; i < count && strcmp(e[i].name, name); i++)
+		;
+	if (i == count) {
+		if (count == FAGPIO_AUTOTUNE_ENTRIES)
+			return -1;
+		strcpy(e[count++].name, name);
+	}
+	e[i].hz = hz;
+
+	if ((size_t)snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= sizeof(tmp) || (fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)
+		return -1;
+	for (i = 0; i < count; i++)
+		ok &= dprintf(fd, "%s %lu\n", e[i].name, e[i].hz) > 0;
+	if (close(fd) < 0 || !ok || rename(tmp, path) < 0) {
+		unlink(tmp);
+		return -1;
+	}
+	return 0;
+}
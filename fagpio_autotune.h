@@ -0,0 +1,92 @@
+#ifndef _FAGPIO_AUTOTUNE_H
+#define _FAGPIO_AUTOTUNE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fagpio_bbi2c.h"
+#include "fagpio_bbspi.h"
+
+/*
+ * Clock rate search for the bit-banged buses. From min_hz the rate goes
+ * up step_pct at a time, each rate checked by trials transfers that must
+ * all verify, until one fails, max_hz is reached or the bus runs as fast
+ * as its accesses go. After a failure the rate backs off margin_pct below
+ * the last good one; that rate is then confirmed with
+ * FAGPIO_AUTOTUNE_CONFIRM times as many trials, backing off again while
+ * it still fails. Zero fields take the defaults below.
+ *
+ * A check returns 0 when its transfer verified: a register of known
+ * value read back (fagpio_autotune_i2c_reg(), fagpio_autotune_spi_ref()),
+ * data written and read again, or a frame whose CRC matched
+ * (fagpio_crc.h). It should cover the slowest edges the bus sees, e.g.
+ * a long read from the far end of the cable.
+ *
+ * fagpio_autotune_save() keeps the result per bus name in a text file of
+ * "name hz" lines (path NULL: $FAGPIO_TUNE, else FAGPIO_AUTOTUNE_FILE),
+ * so later runs start from fagpio_autotune_load() instead of searching.
+ */
+
+#define FAGPIO_AUTOTUNE_STEP	20		//Percent
+#define FAGPIO_AUTOTUNE_MARGIN	20		//Percent
+#define FAGPIO_AUTOTUNE_TRIALS	16
+#define FAGPIO_AUTOTUNE_CONFIRM	4
+#define FAGPIO_AUTOTUNE_FILE	"/var/lib/fagpio/tune"
+#define FAGPIO_AUTOTUNE_NAME	32		//Bus name with its NUL
+#define FAGPIO_AUTOTUNE_ENTRIES	64		//Buses in one file
+
+struct fagpio_autotune {
+	uint32_t min_hz, max_hz;		//max_hz 0 for no limit
+	uint8_t step_pct, margin_pct;
+	uint16_t trials;
+};
+
+struct fagpio_autotune_result {
+	uint32_t hz;			//Rate set, 0 if min_hz already failed
+	uint32_t fail_hz;		//First failing rate, 0 if none
+	uint32_t checks;		//Checks run
+	uint8_t saturated;		//The accesses, not the bus, set the limit
+};
+
+typedef int (*fagpio_autotune_check)(void *bus, void *arg);
+typedef int (*fagpio_autotune_set)(void *bus, uint32_t hz);		//1 once hz is beyond the accesses
+
+// For the check argument of the helpers below
+struct fagpio_autotune_i2c {
+	uint8_t addr, reg;
+	const uint8_t *expect;
+	uint16_t len;
+};
+
+struct fagpio_autotune_spi {
+	uint8_t cs;				//Active low, FAGPIO_BBSPI_NO_PIN if the caller holds it
+	const uint8_t *tx;		//Command, e.g. { 0x9F } for a flash JEDEC ID
+	size_t tx_len;
+	const uint8_t *expect;	//Answer after the command
+	size_t len;
+};
+
+#define FAGPIO_AUTOTUNE_SPI_MAX	64		//tx_len + len
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fagpio_autotune_run(const struct fagpio_autotune *t, fagpio_autotune_set set, fagpio_autotune_check check,
+	void *bus, void *arg, struct fagpio_autotune_result *res);		//0, -1 if no rate passed
+
+int fagpio_autotune_bbi2c(struct fagpio_bbi2c *bus, const struct fagpio_autotune *t, fagpio_autotune_check check,
+	void *arg, struct fagpio_autotune_result *res);
+int fagpio_autotune_bbspi(struct fagpio_bbspi *spi, const struct fagpio_autotune *t, fagpio_autotune_check check,
+	void *arg, struct fagpio_autotune_result *res);
+
+int fagpio_autotune_i2c_reg(void *bbi2c, void *autotune_i2c);
+int fagpio_autotune_spi_ref(void *bbspi, void *autotune_spi);
+
+int fagpio_autotune_save(const char *path, const char *name, uint32_t hz);
+uint32_t fagpio_autotune_load(const char *path, const char *name);		//0 if not stored
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,347 @@
+#include "fagpio_priv.h"
+#include "fagpio_bbi2c.h"
+#include "fagpio_timer.h"
+#include "fagpio_transpose.h"
+
+static inline void line_release(volatile uint32_t *cfg, uint8_t shift) {
+	*cfg &= ~(15u << shift);						//Input, the pull-up takes the line high
+}
+
+static inline void line_low(volatile uint32_t *cfg, uint8_t shift) {
+	*cfg = (*cfg & ~(15u << shift)) | (1u << shift);	//Output driving the 0 in DAT
+}
+
+#define SDA_HIGH(b)		line_release((b)->sda_cfg, (b)->sda_shift)
+#define SDA_LOW(b)		line_low((b)->sda_cfg, (b)->sda_shift)
+#define SCL_LOW(b)		line_low((b)->scl_cfg, (b)->scl_shift)
+#define SDA_READ(b)		((*(b)->sda_dat & (b)->sda_mask) != 0)
+#define DELAY(b)		fagpio_delay_cycles((b)->half)
+
+// Releases SCL and waits while a slave stretches the clock; 0 if it never came up
+static int scl_high(struct fagpio_bbi2c *b) {
+	uint32_t start = fagpio_ticks();
+
+	line_release(b->scl_cfg, b->scl_shift);
+	while (!(*b->scl_dat & b->scl_mask)) {
+		if (fagpio_ticks() - start > b->stretch)
+			return 0;
+	}
+	return 1;
+}
+
+int fagpio_bbi2c_init(struct fagpio_bbi2c *bus, uint8_t sda, uint8_t scl, uint32_t hz, uint32_t stretch_us) {
+	struct pio_bank *banks = fagpio_banks();
+
+	if (!banks || !hz || PIO_PIN_PORT(sda) >= PIO_NPORTS || PIO_PIN_PORT(scl) >= PIO_NPORTS)
+		return -1;
+
+	struct pio_bank *sb = &banks[PIO_PIN_PORT(sda)], *cb = &banks[PIO_PIN_PORT(scl)];
+
+	bus->sda_cfg = &sb->cfg[PIO_PIN_NUM(sda) >> 3];
+	bus->scl_cfg = &cb->cfg[PIO_PIN_NUM(scl) >> 3];
+	bus->sda_dat = &sb->dat;
+	bus->scl_dat = &cb->dat;
+	bus->sda_mask = PIO_PIN_MASK(sda);
+	bus->scl_mask = PIO_PIN_MASK(scl);
+	bus->sda_shift = (PIO_PIN_NUM(sda) & 7) * 4;
+	bus->scl_shift = (PIO_PIN_NUM(scl) & 7) * 4;
+	bus->half_ns = 1000000000 / (2 * hz);
+	bus->costs_gen = fagpio_costs_gen;
+	bus->half = fagpio_pad_ticks(bus->half_ns, 1, 1);	//One CFG read-modify-write per half clock
+	bus->stretch = (uint32_t)((uint64_t)stretch_us * fagpio_tick_hz / 1000000);
+
+	pinMode(sda, 1);
+	pinMode(scl, 1);
+	digitalWritePort(PIO_PIN_PORT(sda), bus->sda_mask, 0);
+	digitalWritePort(PIO_PIN_PORT(scl), bus->scl_mask, 0);
+	pinPull(sda, PULL_NONE);
+	pinPull(scl, PULL_NONE);
+	return 0;
+}
+
+static void i2c_start(struct fagpio_bbi2c *b) {
+	SDA_HIGH(b);
+	DELAY(b);
+	scl_high(b);
+	DELAY(b);
+	SDA_LOW(b);
+	DELAY(b);
+	SCL_LOW(b);
+}
+
+static void i2c_stop(struct fagpio_bbi2c *b) {
+	SDA_LOW(b);
+	DELAY(b);
+	scl_high(b);
+	DELAY(b);
+	SDA_HIGH(b);
+	DELAY(b);
+}
+
+// 1 if the slave ACKed
+FAGPIO_ARM_CODE static int i2c_write_byte(struct fagpio_bbi2c *b, uint8_t v) {
+	int ack;
+
+	for (int i = 7; i >= 0; i--) {
+		if ((v >> i) & 1)
+			SDA_HIGH(b);
+		else
+			SDA_LOW(b);
+		DELAY(b);
+		if (!scl_high(b))
+			return 0;
+		DELAY(b);
+		SCL_LOW(b);
+	}
+	SDA_HIGH(b);
+	DELAY(b);
+	if (!scl_high(b))
+		return 0;
+	ack = !SDA_READ(b);
+	DELAY(b);
+	SCL_LOW(b);
+	return ack;
+}
+
+FAGPIO_ARM_CODE static uint8_t i2c_read_byte(struct fagpio_bbi2c *b, int ack) {
+	uint8_t v = 0;
+
+	SDA_HIGH(b);
+	for (int i = 0; i < 8; i++) {
+		DELAY(b);
+		scl_high(b);
+		v = (v << 1) | SDA_READ(b);
+		DELAY(b);
+		SCL_LOW(b);
+	}
+	if (ack)
+		SDA_LOW(b);
+	DELAY(b);
+	scl_high(b);
+	DELAY(b);
+	SCL_LOW(b);
+	SDA_HIGH(b);
+	return v;
+}
+
+int fagpio_bbi2c_set_hz(struct fagpio_bbi2c *bus, uint32_t hz) {
+	if (!hz)
+		return -1;
+	bus->half_ns = 1000000000 / (2 * hz);
+	bus->half = fagpio_pad_ticks(bus->half_ns, 1, 1);
+	return !bus->half;
+}
+
+int fagpio_bbi2c_transfer(struct fagpio_bbi2c *bus, const struct fagpio_i2c_msg *msgs, unsigned int count) {
+	unsigned int done;
+
+	if (fagpio_costs_update(&bus->costs_gen))
+		bus->half = fagpio_pad_ticks(bus->half_ns, 1, 1);
+	FAGPIO_PROBE2(bbi2c_start, bus, count);
+	for (done = 0; done < count; done++) {
+		const struct fagpio_i2c_msg *m = &msgs[done];
+		int rd = m->flags & FAGPIO_I2C_READ;
+
+		i2c_start(bus);		//A repeated start after the first message
+		if (!i2c_write_byte(bus, (m->addr << 1) | rd))
+			break;
+		if (rd) {
+			for (uint16_t i = 0; i < m->len; i++)
+				m->buf[i] = i2c_read_byte(bus, i + 1 < m->len);
+		} else {
+			uint16_t i;
+
+			for (i = 0; i < m->len && i2c_write_byte(bus, m->buf[i]); i++)
+				;
+			if (i < m->len)
+				break;
+		}
+	}
+	i2c_stop(bus);
+	FAGPIO_PROBE2(bbi2c_done, bus, done);
+	return done;
+}
+
+int fagpio_bbi2c_read_reg(struct fagpio_bbi2c *bus, uint8_t addr, uint8_t reg, uint8_t *buf, uint16_t len) {
+	struct fagpio_i2c_msg msgs[2] = {
+		{ addr, 0, 1, &reg },
+		{ addr, FAGPIO_I2C_READ, len, buf },
+	};
+
+	return fagpio_bbi2c_transfer(bus, msgs, 2) == 2 ? 0 : -1;
+}
+
+// Bit n of the low byte to bit 4n: a pin mask to the CFG fields it covers
+static inline uint32_t nibbles(uint32_t x) {
+	x &= 0xFF;
+	x = (x | x << 12) & 0x000F000F;
+	x = (x | x << 6) & 0x03030303;
+	return (x | x << 3) & 0x11111111;
+}
+
+int fagpio_bbi2c_multi_init(struct fagpio_bbi2c_multi *m, uint8_t first_sda, uint8_t lanes, uint8_t scl, uint32_t hz, uint32_t stretch_us) {
+	struct pio_bank *banks = fagpio_banks();
+	uint8_t port = PIO_PIN_PORT(first_sda), first = PIO_PIN_NUM(first_sda);
+
+	if (!banks || !hz || !lanes || lanes > FAGPIO_BBI2C_MULTI_MAX || port >= PIO_NPORTS || first + lanes > 32)
+		return -1;
+	if (PIO_PIN_PORT(scl) >= PIO_NPORTS || (PIO_PIN_PORT(scl) == port && (unsigned int)(PIO_PIN_NUM(scl) - first) < lanes))
+		return -1;
+
+	uint32_t pins = ((1u << lanes) - 1) << first;
+	struct pio_bank *cb = &banks[PIO_PIN_PORT(scl)];
+
+	m->sda_cfg = banks[port].cfg;
+	m->sda_dat = &banks[port].dat;
+	m->scl_cfg = &cb->cfg[PIO_PIN_NUM(scl) >> 3];
+	m->scl_dat = &cb->dat;
+	m->scl_mask = PIO_PIN_MASK(scl);
+	m->scl_shift = (PIO_PIN_NUM(scl) & 7) * 4;
+	m->first = first;
+	m->lanes = lanes;
+	m->cfg_lo = first >> 3;
+	m->cfg_hi = (first + lanes - 1) >> 3;
+	for (unsigned int w = 0; w < 4; w++)
+		m->field[w] = nibbles(pins >> (8 * w)) * 15;
+	m->half_ns = 1000000000 / (2 * hz);
+	m->costs_gen = fagpio_costs_gen;
+	m->half = fagpio_pad_ticks(m->half_ns, 1, 1);
+	m->stretch = (uint32_t)((uint64_t)stretch_us * fagpio_tick_hz / 1000000);
+
+	pinModeMask(port, pins, INPUT);
+	pinMode(scl, INPUT);
+	digitalWritePort(port, pins, 0);
+	digitalWritePort(PIO_PIN_PORT(scl), m->scl_mask, 0);
+	pinPullMask(port, pins, PULL_NONE);
+	pinPull(scl, PULL_NONE);
+	return 0;
+}
+
+// Pulls the SDA of the buses in low, releases the others
+static inline void multi_sda(struct fagpio_bbi2c_multi *m, uint32_t low) {
+	uint32_t pins = low << m->first;
+
+	for (unsigned int w = m->cfg_lo; w <= m->cfg_hi; w++)
+		m->sda_cfg[w] = (m->sda_cfg[w] & ~m->field[w]) | nibbles(pins >> (8 * w));
+}
+
+static inline uint32_t multi_read(struct fagpio_bbi2c_multi *m) {
+	return (*m->sda_dat >> m->first) & ((1u << m->lanes) - 1);
+}
+
+static int multi_scl_high(struct fagpio_bbi2c_multi *m) {
+	uint32_t start = fagpio_ticks();
+
+	line_release(m->scl_cfg, m->scl_shift);
+	while (!(*m->scl_dat & m->scl_mask)) {
+		if (fagpio_ticks() - start > m->stretch)
+			return 0;
+	}
+	return 1;
+}
+
+#define MULTI_DELAY(m)	fagpio_delay_cycles((m)->half)
+#define MULTI_ALL(m)	((1u << (m)->lanes) - 1)
+
+// Also picks up re-measured access costs, at every (repeated) start
+static void multi_start(struct fagpio_bbi2c_multi *m) {
+	if (fagpio_costs_update(&m->costs_gen))
+		m->half = fagpio_pad_ticks(m->half_ns, 1, 1);
+	multi_sda(m, 0);
+	MULTI_DELAY(m);
+	multi_scl_high(m);
+	MULTI_DELAY(m);
+	multi_sda(m, MULTI_ALL(m));
+	MULTI_DELAY(m);
+	line_low(m->scl_cfg, m->scl_shift);
+}
+
+static void multi_stop(struct fagpio_bbi2c_multi *m) {
+	multi_sda(m, MULTI_ALL(m));
+	MULTI_DELAY(m);
+	multi_scl_high(m);
+	MULTI_DELAY(m);
+	multi_sda(m, 0);
+	MULTI_DELAY(m);
+}
+
+// Sends v on the buses in active; returns those that ACKed
+FAGPIO_ARM_CODE static uint32_t multi_write_byte(struct fagpio_bbi2c_multi *m, uint8_t v, uint32_t active) {
+	uint32_t nack;
+
+	for (int i = 7; i >= 0; i--) {
+		multi_sda(m, (v >> i) & 1 ? 0 : active);
+		MULTI_DELAY(m);
+		if (!multi_scl_high(m))
+			return 0;
+		MULTI_DELAY(m);
+		line_low(m->scl_cfg, m->scl_shift);
+	}
+	multi_sda(m, 0);
+	MULTI_DELAY(m);
+	if (!multi_scl_high(m))
+		return 0;
+	nack = multi_read(m);
+	MULTI_DELAY(m);
+	line_low(m->scl_cfg, m->scl_shift);
+	return active & ~nack;
+}
+
+// One byte from every bus: snap[n] holds bit n of each, transposed into buf[i][at]
+FAGPIO_ARM_CODE static void multi_read_byte(struct fagpio_bbi2c_multi *m, uint8_t *const buf[], uint16_t at, uint32_t active, int ack) {
+	uint8_t snap[8], bus[8];
+
+	multi_sda(m, 0);
+	for (int i = 7; i >= 0; i--) {
+		MULTI_DELAY(m);
+		multi_scl_high(m);
+		snap[i] = multi_read(m) | ~active;
+		MULTI_DELAY(m);
+		line_low(m->scl_cfg, m->scl_shift);
+	}
+	if (ack)
+		multi_sda(m, active);
+	MULTI_DELAY(m);
+	multi_scl_high(m);
+	MULTI_DELAY(m);
+	line_low(m->scl_cfg, m->scl_shift);
+	multi_sda(m, 0);
+
+	fagpio_transpose8(snap, bus);
+	for (unsigned int b = 0; b < m->lanes; b++)
+		buf[b][at] = bus[7 - b];
+}
+
+uint32_t fagpio_bbi2c_multi_write(struct fagpio_bbi2c_multi *m, uint8_t addr, const uint8_t *data, uint16_t len) {
+	uint32_t active;
+
+	multi_start(m);
+	active = multi_write_byte(m, addr << 1, MULTI_ALL(m));
+	for (uint16_t i = 0; i < len && active; i++)
+		active = multi_write_byte(m, data[i], active);
+	multi_stop(m);
+	return active;
+}
+
+uint32_t fagpio_bbi2c_multi_read_reg(struct fagpio_bbi2c_multi *m, uint8_t addr, uint8_t reg, uint8_t *const buf[], uint16_t len) {
+	uint32_t active;
+
+	multi_start(m);
+	active = multi_write_byte(m, addr << 1, MULTI_ALL(m));
+	if (active)
+		active = multi_write_byte(m, reg, active);
+	if (active) {
+		multi_start(m);		//Repeated start
+		active = multi_write_byte(m, (addr << 1) | FAGPIO_I2C_READ, active);
+	}
+	for (uint16_t i = 0; i < len; i++) {
+		if (active) {
+			multi_read_byte(m, buf, i, active, i + 1 < len);
+		} else {
+			for (unsigned int b = 0; b < m->lanes; b++)
+				buf[b][i] = 0xFF;
+		}
+	}
+	multi_stop(m);
+	return active;
+}
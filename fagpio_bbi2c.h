@@ -0,0 +1,83 @@
+#ifndef _FAGPIO_BBI2C_H
+#define _FAGPIO_BBI2C_H
+
+#include <stdint.h>
+#include "fagpio_i2c.h"
+
+/*
+ * Bit-banged I2C master on any two pins. Open drain is emulated with the
+ * DAT bits held at 0: a line is released by switching its CFG nibble to
+ * input and pulled low by switching it to output. The CFG register and
+ * shift of each line are resolved once, so a line change is one
+ * read-modify-write. A released SCL is polled until it reads high, which
+ * honours clock stretching up to stretch_us. External pull-ups are
+ * required.
+ */
+
+struct fagpio_bbi2c {
+	volatile uint32_t *sda_cfg, *scl_cfg;
+	volatile uint32_t *sda_dat, *scl_dat;
+	uint32_t sda_mask, scl_mask;
+	uint8_t sda_shift, scl_shift;
+	uint32_t half;			//Counter ticks per half clock
+	uint32_t stretch;		//Ticks a slave may hold SCL low
+	uint32_t half_ns;		//Half clock asked for, half is recomputed from it
+	uint32_t costs_gen;		//fagpio_costs_gen half was computed at
+};
+
+/*
+ * Multi-bus mode: up to 8 buses with identical slaves (same address)
+ * sharing one SCL, each with its own SDA on consecutive pins of one port.
+ * SCL is driven once for all of them; the SDA lines of a bit change with
+ * one CFG read-modify-write per CFG word they span, and each sampled bit
+ * of every bus comes from one DAT load. Reads are transposed into a byte
+ * per bus with fagpio_transpose8(). Results are bus masks: bit i set when
+ * bus i ACKed everything; a bus that NACKs is released and reads 0xFF for
+ * the rest of the transfer.
+ */
+
+#define FAGPIO_BBI2C_MULTI_MAX	8
+
+struct fagpio_bbi2c_multi {
+	volatile uint32_t *sda_cfg;		//CFG words of the SDA port
+	volatile uint32_t *sda_dat;
+	volatile uint32_t *scl_cfg, *scl_dat;
+	uint32_t scl_mask;
+	uint8_t scl_shift;
+	uint8_t first;			//Pin number of bus 0's SDA
+	uint8_t lanes;
+	uint8_t cfg_lo, cfg_hi;	//CFG words holding the SDA pins
+	uint32_t field[4];		//SDA nibbles in each CFG word
+	uint32_t half;
+	uint32_t stretch;
+	uint32_t half_ns;
+	uint32_t costs_gen;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fagpio_bbi2c_init(struct fagpio_bbi2c *bus, uint8_t sda, uint8_t scl, uint32_t hz, uint32_t stretch_us);
+int fagpio_bbi2c_set_hz(struct fagpio_bbi2c *bus, uint32_t hz);		//1 if hz is beyond what the accesses allow
+
+// Runs msgs back to back; returns the number completed, fewer if a slave did not ACK
+int fagpio_bbi2c_transfer(struct fagpio_bbi2c *bus, const struct fagpio_i2c_msg *msgs, unsigned int count);
+
+// Register access as one transfer: write reg, repeated start, read len bytes
+int fagpio_bbi2c_read_reg(struct fagpio_bbi2c *bus, uint8_t addr, uint8_t reg, uint8_t *buf, uint16_t len);
+
+// SDA of bus i is first_sda + i
+int fagpio_bbi2c_multi_init(struct fagpio_bbi2c_multi *m, uint8_t first_sda, uint8_t lanes, uint8_t scl, uint32_t hz, uint32_t stretch_us);
+
+// The same bytes to every bus; returns the buses that ACKed all of them
+uint32_t fagpio_bbi2c_multi_write(struct fagpio_bbi2c_multi *m, uint8_t addr, const uint8_t *data, uint16_t len);
+
+// Write reg, repeated start, read len bytes of bus i into buf[i]; returns the buses that ACKed
+uint32_t fagpio_bbi2c_multi_read_reg(struct fagpio_bbi2c_multi *m, uint8_t addr, uint8_t reg, uint8_t *const buf[], uint16_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
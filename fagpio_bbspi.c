@@ -0,0 +1,210 @@
+#include "fagpio_priv.h"
+#include "fagpio_bbspi.h"
+#include "fagpio_timer.h"
+#include "fagpio_transpose.h"
+
+int fagpio_bbspi_init(struct fagpio_bbspi *spi, uint8_t sck, uint8_t mosi, uint8_t miso, uint8_t mode, uint32_t hz) {
+	struct pio_bank *banks = fagpio_banks();
+
+	if (!banks || mode > 3 || PIO_PIN_PORT(sck) >= PIO_NPORTS)
+		return -1;
+	if (mosi != FAGPIO_BBSPI_NO_PIN && PIO_PIN_PORT(mosi) != PIO_PIN_PORT(sck))
+		return -1;
+	if (miso != FAGPIO_BBSPI_NO_PIN && PIO_PIN_PORT(miso) >= PIO_NPORTS)
+		return -1;
+
+	spi->port = PIO_PIN_PORT(sck);
+	spi->mode = mode;
+	spi->sck = PIO_PIN_MASK(sck);
+	spi->mosi = mosi != FAGPIO_BBSPI_NO_PIN ? PIO_PIN_MASK(mosi) : 0;
+	spi->dat = &banks[spi->port].dat;
+	spi->miso_dat = NULL;
+	spi->half_ns = hz ? 1000000000 / (2 * hz) : 0;
+	spi->costs_gen = fagpio_costs_gen;
+	spi->half_ticks = hz ? fagpio_pad_ticks(spi->half_ns, 0, 1) : 0;	//Each half clock is one store
+
+	digitalWritePort(spi->port, spi->sck, (mode & 2) ? spi->sck : 0);		//Idle level of CPOL
+	pinMode(sck, 0);
+	if (mosi != FAGPIO_BBSPI_NO_PIN)
+		pinMode(mosi, 0);
+	if (miso != FAGPIO_BBSPI_NO_PIN) {
+		pinMode(miso, 1);
+		spi->miso_dat = &banks[PIO_PIN_PORT(miso)].dat;
+		spi->miso_bit = PIO_PIN_NUM(miso);
+	}
+	return 0;
+}
+
+int fagpio_bbspi_set_hz(struct fagpio_bbspi *spi, uint32_t hz) {
+	spi->half_ns = hz ? 1000000000 / (2 * hz) : 0;
+	spi->half_ticks = hz ? fagpio_pad_ticks(spi->half_ns, 0, 1) : 0;
+	return !spi->half_ticks;
+}
+
+static inline void half_clock(uint32_t ticks) {
+	if (ticks)
+		fagpio_delay_cycles(ticks);
+}
+
+// half_ticks again after the access costs were measured again, out of the transfer loops
+static void __attribute__((noinline)) retime_slow(struct fagpio_bbspi *spi) {
+	if (fagpio_costs_update(&spi->costs_gen))
+		spi->half_ticks = spi->half_ns ? fagpio_pad_ticks(spi->half_ns, 0, 1) : 0;
+}
+
+static inline void retime(struct fagpio_bbspi *spi) {
+	if (spi->costs_gen != fagpio_costs_gen)
+		retime_slow(spi);
+}
+
+/*
+Each bit is two stores: with CPHA=0 the first returns SCK to idle with the
+new MOSI level and the second is the sampling (leading) edge; with CPHA=1
+the first is the leading edge carrying MOSI and the second the sampling
+(trailing) edge. Either way MISO is read after the second store.
+*/
+#define BBSPI_BIT(n) do { \
+		uint32_t b = (out >> (n)) & 1; \
+		*dat = w[b][first]; \
+		half_clock(half); \
+		*dat = w[b][second]; \
+		if (miso) \
+			in |= ((*miso >> miso_bit) & 1) << (n); \
+		half_clock(half); \
+	} while (0)
+
+// Bit sent at step n of 7..0
+#define BBSPI_ORDER(n)	(lsb ? 7 - (n) : (n))
+
+/*
+The transfer loop for a mode and bit order. With constants for both, as
+in the fagpio_bbspi_transfer_mode*() variants, the edge words are fixed
+and the bit order is folded into the shifts.
+*/
+static inline __attribute__((always_inline)) void bbspi_kernel(struct fagpio_bbspi *spi, const uint8_t *tx, uint8_t *rx, size_t len, unsigned int mode, unsigned int lsb) {
+	retime(spi);
+
+	volatile uint32_t *dat = spi->dat;
+	volatile uint32_t *miso = rx ? spi->miso_dat : NULL;
+	uint8_t miso_bit = spi->miso_bit;
+	uint32_t half = spi->half_ticks;
+	unsigned int idle = (mode >> 1) & 1;
+	unsigned int first = (mode & 1) ? !idle : idle;
+	unsigned int second = !first;
+	uint32_t base = *dat & ~(spi->sck | spi->mosi);
+	uint32_t w[2][2];
+
+	w[0][0] = base;
+	w[0][1] = base | spi->sck;
+	w[1][0] = base | spi->mosi;
+	w[1][1] = base | spi->mosi | spi->sck;
+
+	FAGPIO_PROBE2(bbspi_start, spi, len);
+	for (size_t i = 0; i < len; i++) {
+		uint32_t out = tx ? tx[i] : 0, in = 0;
+
+		BBSPI_BIT(BBSPI_ORDER(7));
+		BBSPI_BIT(BBSPI_ORDER(6));
+		BBSPI_BIT(BBSPI_ORDER(5));
+		BBSPI_BIT(BBSPI_ORDER(4));
+		BBSPI_BIT(BBSPI_ORDER(3));
+		BBSPI_BIT(BBSPI_ORDER(2));
+		BBSPI_BIT(BBSPI_ORDER(1));
+		BBSPI_BIT(BBSPI_ORDER(0));
+		if (rx)
+			rx[i] = in;
+	}
+
+	*dat = w[0][idle];
+	fagpio_shadow_sync(spi->port);
+	FAGPIO_PROBE1(bbspi_done, spi);
+}
+
+FAGPIO_ARM_CODE void fagpio_bbspi_transfer(struct fagpio_bbspi *spi, const uint8_t *tx, uint8_t *rx, size_t len) {
+	bbspi_kernel(spi, tx, rx, len, spi->mode, 0);
+}
+
+FAGPIO_ARM_CODE void fagpio_bbspi_transfer_lsb(struct fagpio_bbspi *spi, const uint8_t *tx, uint8_t *rx, size_t len) {
+	bbspi_kernel(spi, tx, rx, len, spi->mode, 1);
+}
+
+#define BBSPI_VARIANT(mode) \
+	FAGPIO_ARM_CODE void fagpio_bbspi_transfer_mode##mode(struct fagpio_bbspi *spi, const uint8_t *tx, uint8_t *rx, size_t len) { \
+		bbspi_kernel(spi, tx, rx, len, mode, 0); \
+	}
+
+BBSPI_VARIANT(0)
+BBSPI_VARIANT(1)
+BBSPI_VARIANT(2)
+BBSPI_VARIANT(3)
+
+int fagpio_bbspi_wide_init(struct fagpio_bbspi_wide *w, uint8_t sck, uint8_t mosi, uint8_t first_miso, uint8_t lanes, uint8_t mode, uint32_t hz) {
+	uint8_t port = PIO_PIN_PORT(first_miso);
+
+	if (!lanes || lanes > FAGPIO_BBSPI_WIDE_MAX || port >= PIO_NPORTS || PIO_PIN_NUM(first_miso) + lanes > 32)
+		return -1;
+	if (fagpio_bbspi_init(&w->spi, sck, mosi, FAGPIO_BBSPI_NO_PIN, mode, hz) < 0)
+		return -1;
+
+	w->lanes = lanes;
+	w->miso_shift = PIO_PIN_NUM(first_miso);
+	w->miso_dat = &fagpio_banks()[port].dat;
+	pinModeMask(port, ((1u << lanes) - 1) << w->miso_shift, INPUT);
+	return 0;
+}
+
+// As BBSPI_BIT, keeping the whole MISO snapshot: snap[n] has bit n of every device
+#define WIDE_BIT(n) do { \
+		uint32_t b = (out >> (n)) & 1; \
+		*dat = w[b][first]; \
+		half_clock(half); \
+		*dat = w[b][second]; \
+		snap[n] = *miso >> shift; \
+		half_clock(half); \
+	} while (0)
+
+FAGPIO_ARM_CODE void fagpio_bbspi_wide_transfer(struct fagpio_bbspi_wide *wide, const uint8_t *tx, uint8_t *const rx[], size_t len) {
+	struct fagpio_bbspi *spi = &wide->spi;
+
+	retime(spi);
+
+	volatile uint32_t *dat = spi->dat;
+	volatile uint32_t *miso = wide->miso_dat;
+	uint8_t shift = wide->miso_shift;
+	uint32_t half = spi->half_ticks;
+	unsigned int idle = (spi->mode >> 1) & 1;
+	unsigned int first = (spi->mode & 1) ? !idle : idle;
+	unsigned int second = !first;
+	uint32_t base = *dat & ~(spi->sck | spi->mosi);
+	uint32_t w[2][2];
+
+	w[0][0] = base;
+	w[0][1] = base | spi->sck;
+	w[1][0] = base | spi->mosi;
+	w[1][1] = base | spi->mosi | spi->sck;
+
+	FAGPIO_PROBE2(bbspi_start, spi, len);
+	for (size_t i = 0; i < len; i++) {
+		uint32_t out = tx ? tx[i] : 0;
+		uint8_t snap[8], dev[8];
+
+		WIDE_BIT(7);
+		WIDE_BIT(6);
+		WIDE_BIT(5);
+		WIDE_BIT(4);
+		WIDE_BIT(3);
+		WIDE_BIT(2);
+		WIDE_BIT(1);
+		WIDE_BIT(0);
+		if (!rx)
+			continue;
+		// Transposing the snapshots back gives device d's byte in dev[7 - d]
+		fagpio_transpose8(snap, dev);
+		for (unsigned int d = 0; d < wide->lanes; d++)
+			rx[d][i] = dev[7 - d];
+	}
+
+	*dat = w[0][idle];
+	fagpio_shadow_sync(spi->port);
+	FAGPIO_PROBE1(bbspi_done, spi);
+}
@@ -0,0 +1,78 @@
+#ifndef _FAGPIO_BBSPI_H
+#define _FAGPIO_BBSPI_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Bit-banged SPI master, MSB or LSB first, modes 0-3. SCK and MOSI must share a
+ * port: the four DAT words for every (MOSI, SCK) combination are computed
+ * once per transfer, and each bit is then two stores of a precomputed word
+ * (one per clock edge) in an unrolled byte loop. MISO may be on any port
+ * and is taken from a DAT snapshot after the sampling edge. Chip select
+ * is left to the caller.
+ */
+
+#define FAGPIO_BBSPI_NO_PIN		0xFF
+#define FAGPIO_BBSPI_WIDE_MAX	8
+
+struct fagpio_bbspi {
+	uint8_t port;			//Port of SCK and MOSI
+	uint8_t mode;
+	uint8_t miso_bit;
+	uint32_t sck;			//Pin masks
+	uint32_t mosi;
+	volatile uint32_t *dat;
+	volatile uint32_t *miso_dat;	//NULL without MISO
+	uint32_t half_ticks;	//Counter ticks per half clock, 0 for full speed
+	uint32_t half_ns;		//Half clock asked for, half_ticks is recomputed from it
+	uint32_t costs_gen;		//fagpio_costs_gen half_ticks was computed at
+};
+
+/*
+ * Wide mode: up to 8 devices sharing SCK, MOSI and chip select, each with
+ * its own MISO on consecutive pins of one port. Every clock reads all the
+ * MISO lines with one DAT load, and each byte's eight snapshots are turned
+ * into one byte per device with fagpio_transpose8(), so the devices are
+ * read in the time of one.
+ */
+struct fagpio_bbspi_wide {
+	struct fagpio_bbspi spi;	//SCK and MOSI, no MISO
+	uint8_t lanes;
+	uint8_t miso_shift;		//Pin number of the first MISO
+	volatile uint32_t *miso_dat;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// mosi and miso may be FAGPIO_BBSPI_NO_PIN; hz 0 runs as fast as the stores go
+int fagpio_bbspi_init(struct fagpio_bbspi *spi, uint8_t sck, uint8_t mosi, uint8_t miso, uint8_t mode, uint32_t hz);
+int fagpio_bbspi_set_hz(struct fagpio_bbspi *spi, uint32_t hz);		//1 if hz is beyond the stores (0 for full speed)
+
+// tx NULL sends zeros, rx NULL discards what is read
+void fagpio_bbspi_transfer(struct fagpio_bbspi *spi, const uint8_t *tx, uint8_t *rx, size_t len);
+void fagpio_bbspi_transfer_lsb(struct fagpio_bbspi *spi, const uint8_t *tx, uint8_t *rx, size_t len);	//LSB first
+
+/*
+ * The same loop compiled for one mode, which must be the one spi was set
+ * up with: the edge words are no longer picked at run time. For finer
+ * control, pins and width included, see SoftSpi in fagpio_softspi.hpp.
+ */
+void fagpio_bbspi_transfer_mode0(struct fagpio_bbspi *spi, const uint8_t *tx, uint8_t *rx, size_t len);
+void fagpio_bbspi_transfer_mode1(struct fagpio_bbspi *spi, const uint8_t *tx, uint8_t *rx, size_t len);
+void fagpio_bbspi_transfer_mode2(struct fagpio_bbspi *spi, const uint8_t *tx, uint8_t *rx, size_t len);
+void fagpio_bbspi_transfer_mode3(struct fagpio_bbspi *spi, const uint8_t *tx, uint8_t *rx, size_t len);
+
+// MISO of device i is first_miso + i; same modes and hz as fagpio_bbspi_init()
+int fagpio_bbspi_wide_init(struct fagpio_bbspi_wide *w, uint8_t sck, uint8_t mosi, uint8_t first_miso, uint8_t lanes, uint8_t mode, uint32_t hz);
+
+// tx goes to every device, rx[i] receives len bytes from device i (rx NULL discards)
+void fagpio_bbspi_wide_transfer(struct fagpio_bbspi_wide *w, const uint8_t *tx, uint8_t *const rx[], size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,132 @@
+#include <string.h>
+#include "fagpio_priv.h"
+#include "fagpio_bist.h"
+#include "fagpio_soc.h"
+#include "fagpio_timer.h"
+
+struct bist_pin {
+	uint8_t port;
+	uint8_t word;			//CFG register
+	uint32_t bit;
+	uint32_t drive;			//That CFG register with the pin switched to output
+	uint32_t loop[PIO_NPORTS];	//Pins looped to it on the fixture
+};
+
+// Every bank's DAT, tested pins only
+static inline void snapshot(struct pio_bank *banks, const uint32_t *mask, uint32_t *dat) {
+	for (unsigned int port = 0; port < PIO_NPORTS; port++)
+		dat[port] = mask[port] ? banks[port].dat & mask[port] : 0;
+}
+
+// The tested pins as inputs with the given pull and DAT level, the rest of each bank as saved
+static void setup(const struct fagpio_bank_state *saved, const uint32_t *mask, uint32_t pull, int level) {
+	for (unsigned int port = 0; port < PIO_NPORTS; port++) {
+		struct fagpio_bank_state st = saved[port];
+
+		if (!mask[port])
+			continue;
+		for (unsigned int n = 0; n < 32; n++) {
+			if (!(mask[port] & (1u << n)))
+				continue;
+			st.cfg[n >> 3] &= ~(15u << ((n & 7) * 4));
+			st.pull[n >> 4] = (st.pull[n >> 4] & ~(3u << ((n & 15) * 2))) | (pull << ((n & 15) * 2));
+		}
+		st.dat = (st.dat & ~mask[port]) | (level ? mask[port] : 0);
+		fagpio_bank_restore(port, &st);
+	}
+}
+
+/*
+One walk: rest is what the tested pins read undriven. A driven pin that
+reads rest cannot drive; other pins that read the driven level follow it.
+*/
+static void walk(struct fagpio_bist *b, struct pio_bank *banks, const struct bist_pin *pins, unsigned int npins,
+		uint32_t settle, int level, uint32_t *stuck) {
+	uint32_t dat[PIO_NPORTS];
+	uint32_t rest[PIO_NPORTS];
+
+	fagpio_delay_cycles(settle);
+	snapshot(banks, b->mask, dat);
+	for (unsigned int port = 0; port < PIO_NPORTS; port++) {
+		stuck[port] |= level ? dat[port] : b->mask[port] & ~dat[port];
+		rest[port] = level ? 0 : b->mask[port];
+	}
+	for (unsigned int i = 0; i < npins; i++) {
+		const struct bist_pin *p = &pins[i];
+		volatile uint32_t *cfg = &banks[p->port].cfg[p->word];
+		uint32_t idle = *cfg;
+
+		*cfg = p->drive;
+		fagpio_delay_cycles(settle);
+		snapshot(banks, b->mask, dat);
+		*cfg = idle;
+		if (!((dat[p->port] ^ rest[p->port]) & p->bit))
+			b->no_drive[p->port] |= p->bit;
+		for (unsigned int port = 0; port < PIO_NPORTS; port++) {
+			uint32_t moved = (dat[port] ^ rest[port]) & ~stuck[port];
+
+			if (port == p->port)
+				moved &= ~p->bit;
+			b->shorted[port] |= moved & ~p->loop[port];
+			if (!(stuck[p->port] & p->bit) && !(b->no_drive[p->port] & p->bit))
+				b->open[port] |= p->loop[port] & ~moved & ~stuck[port];
+		}
+	}
+	fagpio_delay_cycles(settle);		//Lets the last pin fall back before the next walk
+}
+
+int fagpio_bist_run(struct fagpio_bist *b, const uint32_t *mask, const uint8_t (*pairs)[2], unsigned int npairs, uint32_t settle_ns) {
+	static struct bist_pin pins[PIO_NPORTS * 32];
+	struct fagpio_bank_state saved[PIO_NPORTS];
+	struct pio_bank *banks = fagpio_banks();
+	uint32_t settle = fagpio_ns_to_ticks(settle_ns ? settle_ns : FAGPIO_BIST_SETTLE_NS), start;
+	unsigned int npins = 0;
+
+	memset(b, 0, sizeof(*b));
+	if (!banks)
+		return -1;
+	for (unsigned int port = 0; port < PIO_NPORTS; port++) {
+		unsigned int n = fagpio_port_pins(port);
+
+		b->mask[port] = (mask ? mask[port] : ~0u) & (n >= 32 ? ~0u : (1u << n) - 1);
+		if (b->mask[port])
+			fagpio_bank_save(port, &saved[port]);
+	}
+
+	start = fagpio_ticks();
+	setup(saved, b->mask, PULL_DOWN, 1);
+	for (unsigned int port = 0; port < PIO_NPORTS; port++) {
+		for (unsigned int n = 0; n < 32; n++) {
+			struct bist_pin *p = &pins[npins];
+
+			if (!(b->mask[port] & (1u << n)))
+				continue;
+			memset(p, 0, sizeof(*p));
+			p->port = port;
+			p->word = n >> 3;
+			p->bit = 1u << n;
+			p->drive = banks[port].cfg[n >> 3] | (1u << ((n & 7) * 4));
+			for (unsigned int k = 0; k < npairs; k++) {
+				uint8_t other = pairs[k][0] == PIO_PIN(port, n) ? pairs[k][1] : pairs[k][1] == PIO_PIN(port, n) ? pairs[k][0] : 0xFF;
+
+				if (other != 0xFF && PIO_PIN_PORT(other) < PIO_NPORTS)
+					p->loop[PIO_PIN_PORT(other)] |= PIO_PIN_MASK(other) & b->mask[PIO_PIN_PORT(other)];
+			}
+			npins++;
+		}
+	}
+	walk(b, banks, pins, npins, settle, 1, b->stuck_high);
+	setup(saved, b->mask, PULL_UP, 0);
+	walk(b, banks, pins, npins, settle, 0, b->stuck_low);
+	for (unsigned int port = 0; port < PIO_NPORTS; port++) {
+		if (b->mask[port])
+			fagpio_bank_restore(port, &saved[port]);
+	}
+	b->ticks = fagpio_ticks() - start;
+
+	for (unsigned int port = 0; port < PIO_NPORTS; port++) {
+		if (b->stuck_high[port] | b->stuck_low[port] | b->no_drive[port] | b->shorted[port] | b->open[port])
+			return 1;
+	}
+	return 0;
+}
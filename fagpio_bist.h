@@ -0,0 +1,56 @@
+#ifndef _FAGPIO_BIST_H
+#define _FAGPIO_BIST_H
+
+#include <stdint.h>
+#include "fagpio.h"
+
+/*
+ * Board self-test of the pins for shorts and opens, in a few
+ * milliseconds. Every tested pin of every bank is set up at once through
+ * fagpio_bank_restore(): input with a pull-down and DAT 1. Walking
+ * ones then switches one pin at a time to output, one CFG store that
+ * drives it high, and after settle_ns reads every bank's DAT; walking
+ * zeros repeats it with pull-ups and DAT 0. The saved banks are restored
+ * at the end.
+ *
+ * A pin that reads against its pull with nothing driven is stuck; a
+ * driven pin that does not read back its own level cannot drive; a pin
+ * that follows another driven one is shorted to it unless the pair was
+ * given as a fixture loopback, and a loopback pin that does not follow
+ * its partner is open. Results are bitmaps per port.
+ *
+ * The test drives every tested pin in turn, so leave out the pins of the
+ * DRAM, boot flash, console and anything the board must not see driven.
+ * The settle time covers the weak pull (tens of kOhm) charging the pad
+ * and trace; 5 us suits bare boards, a fixture with long wires needs
+ * more.
+ */
+
+#define FAGPIO_BIST_SETTLE_NS	5000
+
+struct fagpio_bist {
+	uint32_t mask[PIO_NPORTS];			//Pins tested
+	uint32_t stuck_high[PIO_NPORTS];	//Read 1 against the pull-down
+	uint32_t stuck_low[PIO_NPORTS];		//Read 0 against the pull-up
+	uint32_t no_drive[PIO_NPORTS];		//Did not read back their own level
+	uint32_t shorted[PIO_NPORTS];		//Followed a pin they are not looped to
+	uint32_t open[PIO_NPORTS];			//Did not follow their loopback partner
+	uint32_t ticks;						//Length of the test
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * mask: pins to test per port, NULL for every implemented pin; pairs:
+ * npairs fixture loopbacks as pin numbers, NULL for none. 1 if a fault
+ * was found, 0 if none, -1 without the register mapping.
+ */
+int fagpio_bist_run(struct fagpio_bist *b, const uint32_t *mask, const uint8_t (*pairs)[2], unsigned int npairs, uint32_t settle_ns);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
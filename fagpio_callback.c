@@ -0,0 +1,33 @@
+#include "fagpio_callback.h"
+
+int fagpio_cb_set(struct fagpio_cb_table *t, uint8_t pin, fagpio_pin_cb cb, void *arg) {
+	uint8_t i;
+
+	if (pin >= FAGPIO_CB_PINS || !cb)
+		return -1;
+	i = t->index[pin];
+	if (!i) {
+		if (t->used == t->capacity)
+			return -1;
+		i = ++t->used;
+	}
+	t->slots[i - 1].cb = cb;
+	t->slots[i - 1].arg = arg;
+	t->slots[i - 1].pin = pin;
+	t->index[pin] = i;
+	return 0;
+}
+
+// The last slot moves into the hole, so the used slots stay packed
+void fagpio_cb_clear(struct fagpio_cb_table *t, uint8_t pin) {
+	uint8_t i = pin < FAGPIO_CB_PINS ? t->index[pin] : 0;
+
+	if (!i)
+		return;
+	t->index[pin] = 0;
+	if (i != t->used) {
+		t->slots[i - 1] = t->slots[t->used - 1];
+		t->index[t->slots[i - 1].pin] = i;
+	}
+	t->used--;
+}
@@ -0,0 +1,64 @@
+#ifndef _FAGPIO_CALLBACK_H
+#define _FAGPIO_CALLBACK_H
+
+#include <stdint.h>
+#include "fagpio.h"
+
+/*
+ * Fixed-capacity callback table: a function pointer and a user pointer
+ * per pin, in storage sized at compile time, plus a byte per pin that
+ * indexes it, so a lookup is two loads and nothing on the event path
+ * allocates. Each table's capacity is a FAGPIO_*_MAX macro that can be
+ * overridden when building the library, e.g. -DFAGPIO_DISPATCH_MAX=64.
+ */
+
+#define FAGPIO_CB_PINS		(PIO_NPORTS * 32)
+
+typedef void (*fagpio_pin_cb)(uint8_t pin, uint8_t value, void *arg);
+
+struct fagpio_cb_slot {
+	fagpio_pin_cb cb;
+	void *arg;
+	uint8_t pin;
+};
+
+struct fagpio_cb_table {
+	struct fagpio_cb_slot *slots;
+	uint8_t capacity;			//At most 255
+	uint8_t used;
+	uint8_t index[FAGPIO_CB_PINS];	//Slot + 1 per pin, 0 if none
+};
+
+// Static table with its slots, for file scope
+#define FAGPIO_CB_TABLE(name, cap) \
+	static struct fagpio_cb_slot name##_slots[cap]; \
+	static struct fagpio_cb_table name = { name##_slots, (cap), 0, { 0 } }
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fagpio_cb_set(struct fagpio_cb_table *t, uint8_t pin, fagpio_pin_cb cb, void *arg);	//Replaces; -1 when full
+void fagpio_cb_clear(struct fagpio_cb_table *t, uint8_t pin);
+
+static inline const struct fagpio_cb_slot *fagpio_cb_find(const struct fagpio_cb_table *t, uint8_t pin) {
+	uint8_t i = pin < FAGPIO_CB_PINS ? t->index[pin] : 0;
+
+	return i ? &t->slots[i - 1] : 0;
+}
+
+// Runs the pin's callback if it has one; 1 if it ran
+static inline int fagpio_cb_call(const struct fagpio_cb_table *t, uint8_t pin, uint8_t value) {
+	const struct fagpio_cb_slot *s = fagpio_cb_find(t, pin);
+
+	if (!s)
+		return 0;
+	s->cb(pin, value, s->arg);
+	return 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
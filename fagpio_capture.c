@@ -0,0 +1,165 @@
+#include <string.h>
+#include "fagpio_priv.h"
+#include "fagpio_capture.h"
+#include "fagpio_timer.h"
+#include "fagpio_ring.h"
+
+#define TIMEOUT_CHECK		16		//DAT polls between timeout checks
+
+int fagpio_capture_edges(uint8_t port, uint32_t mask, struct fagpio_sample *buf, unsigned int count, uint32_t timeout_ticks) {
+	struct pio_bank *banks = fagpio_banks();
+
+	if (!banks || port >= PIO_NPORTS || !count)
+		return -1;
+
+	volatile uint32_t *dat = &banks[port].dat;
+	uint32_t start = fagpio_ticks();
+	uint32_t last = *dat & mask;
+	unsigned int n = 0;
+
+	buf[n].ticks = start;
+	buf[n++].value = last;
+
+	while (n < count) {
+		for (unsigned int i = 0; i < TIMEOUT_CHECK; i++) {
+			uint32_t v = *dat & mask;
+
+			if (v != last) {
+				buf[n].ticks = fagpio_ticks();
+				buf[n++].value = v;
+				last = v;
+				if (n == count)
+					return n;
+			}
+		}
+		if (timeout_ticks && fagpio_ticks() - start >= timeout_ticks)
+			break;
+	}
+
+	return n;
+}
+
+// Returns the number of edges seen, including any the full ring dropped
+int fagpio_capture_ring(uint8_t port, uint32_t mask, struct fagpio_ring *ring, unsigned int count, uint32_t timeout_ticks) {
+	struct pio_bank *banks = fagpio_banks();
+
+	if (!banks || port >= PIO_NPORTS || !count)
+		return -1;
+
+	volatile uint32_t *dat = &banks[port].dat;
+	uint32_t start = fagpio_ticks();
+	uint32_t last = *dat & mask;
+	unsigned int n = 0;
+
+	while (n < count) {
+		for (unsigned int i = 0; i < TIMEOUT_CHECK; i++) {
+			uint32_t v = *dat & mask;
+
+			if (v != last) {
+				fagpio_ring_push(ring, fagpio_ticks(), port, last, v);
+				last = v;
+				if (++n == count)
+					return n;
+			}
+		}
+		if (timeout_ticks && fagpio_ticks() - start >= timeout_ticks)
+			break;
+	}
+
+	return n;
+}
+
+int fagpio_pack_init(struct fagpio_pack *p, uint32_t mask) {
+	unsigned int lo, hi, bit = 0;
+
+	memset(p, 0, sizeof(*p));
+	if (!mask)
+		return -1;
+	lo = __builtin_ctz(mask);
+	hi = 31 - __builtin_clz(mask);
+	if (hi - lo >= 8 * FAGPIO_PACK_LUTS)
+		return -1;
+	p->mask = mask;
+	p->shift = lo;
+	for (unsigned int n = lo; n <= hi; n++) {
+		unsigned int at = n - lo;
+
+		if (!(mask & (1u << n)))
+			continue;
+		for (unsigned int v = 0; v < 256; v++) {
+			if (v & (1u << (at % 8)))
+				p->lut[at / 8][v] |= 1u << bit;
+		}
+		bit++;
+	}
+	p->width = bit;
+	return 0;
+}
+
+uint32_t fagpio_pack_expand(const struct fagpio_pack *p, uint32_t packed) {
+	uint32_t dat = 0, mask = p->mask;
+
+	for (unsigned int bit = 0; mask; bit++) {
+		uint32_t low = mask & -mask;
+
+		if (packed & (1u << bit))
+			dat |= low;
+		mask &= ~low;
+	}
+	return dat;
+}
+
+uint32_t fagpio_pack_get(const struct fagpio_pack *p, const uint32_t *buf, size_t i) {
+	uint64_t at = (uint64_t)i * p->width;
+	size_t w = at / 32;
+	unsigned int b = at % 32;
+	uint32_t v = buf[w] >> b;
+
+	if (b + p->width > 32)
+		v |= buf[w + 1] << (32 - b);
+	return p->width == 32 ? v : v & ((1u << p->width) - 1);
+}
+
+/*
+The bitstream is assembled in acc, nbits of it used; a word is stored
+once full and the sample's remaining high bits start the next one.
+*/
+size_t fagpio_capture_packed(uint8_t port, const struct fagpio_pack *p, uint32_t *buf, size_t words, size_t max,
+		uint32_t period_ticks, uint32_t *span) {
+	struct pio_bank *banks = fagpio_banks();
+
+	if (!banks || port >= PIO_NPORTS || !p->width || !words)
+		return 0;
+
+	volatile uint32_t *dat = &banks[port].dat;
+	uint64_t room = (uint64_t)words * 32 / p->width;
+	size_t count = max && max < room ? max : room, n = 0, w = 0;
+	unsigned int width = p->width, nbits = 0;
+	uint32_t acc = 0, start = fagpio_ticks(), at = start, last = start;
+
+	while (n < count) {
+		uint32_t v;
+
+		if (period_ticks)
+			while ((int32_t)(fagpio_ticks() - at) < 0)
+				;
+		v = fagpio_pack(p, *dat);
+		if (period_ticks) {
+			last = at;
+			at += period_ticks;
+		}
+		acc |= v << nbits;
+		nbits += width;
+		if (nbits >= 32) {
+			buf[w++] = acc;
+			nbits -= 32;
+			acc = nbits ? v >> (width - nbits) : 0;
+		}
+		n++;
+	}
+	if (nbits)
+		buf[w] = acc;
+	if (span)
+		*span = (period_ticks ? last : fagpio_ticks()) - start;
+	return n;
+}
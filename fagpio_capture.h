@@ -0,0 +1,73 @@
+#ifndef _FAGPIO_CAPTURE_H
+#define _FAGPIO_CAPTURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Edge capture by polling: the hot loop is one DAT read and a compare;
+ * each change of the watched pins is stored with the AVS counter value
+ * (fagpio_timer.h) read right after it was seen.
+ *
+ * Packed capture keeps every sample, but only the watched bits of it:
+ * fagpio_pack_init() builds three 256-entry gather tables, one per byte
+ * of the port the mask spans (as fagpio_pbus.h does, the ARM926 has no
+ * PEXT), so a snapshot becomes width dense bits with three loads and two
+ * ORs. Samples go back to back into a bitstream of 32-bit words, low
+ * bits first, samples straddling words: three pins take 3 bits a sample
+ * instead of 32.
+ */
+
+#define FAGPIO_PACK_LUTS		3		//Port bytes a watched mask may span
+
+struct fagpio_sample {
+	uint32_t ticks;		//fagpio_ticks() when the change was seen
+	uint32_t value;		//Port DAT & mask after the change
+};
+
+struct fagpio_pack {
+	uint32_t mask;
+	uint8_t width;			//Bits per sample
+	uint8_t shift;			//Bit of the port the first table covers
+	uint32_t lut[FAGPIO_PACK_LUTS][256];
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * buf[0] is the initial state, every further entry an edge. Returns the
+ * number of entries stored: stops when count entries are filled or
+ * timeout_ticks have passed (0 waits for count entries forever).
+ */
+int fagpio_capture_edges(uint8_t port, uint32_t mask, struct fagpio_sample *buf, unsigned int count, uint32_t timeout_ticks);
+
+// Same loop, pushing each edge into an SPSC ring (fagpio_ring.h) for another thread
+struct fagpio_ring;
+int fagpio_capture_ring(uint8_t port, uint32_t mask, struct fagpio_ring *ring, unsigned int count, uint32_t timeout_ticks);
+
+int fagpio_pack_init(struct fagpio_pack *p, uint32_t mask);		//-1 if the mask spans over 24 bits
+
+static inline uint32_t fagpio_pack(const struct fagpio_pack *p, uint32_t dat) {
+	dat >>= p->shift;
+	return p->lut[0][dat & 0xFF] | p->lut[1][(dat >> 8) & 0xFF] | p->lut[2][(dat >> 16) & 0xFF];
+}
+
+uint32_t fagpio_pack_expand(const struct fagpio_pack *p, uint32_t packed);		//Back to port bit positions
+uint32_t fagpio_pack_get(const struct fagpio_pack *p, const uint32_t *buf, size_t i);	//Sample i of a bitstream
+
+/*
+ * Samples the port into buf (words 32-bit words) every period_ticks on
+ * the counter, or as fast as the loop goes for 0, until buf is full or
+ * max samples are taken (0 for no limit). Returns the samples stored;
+ * span gets the ticks from the first to the last one.
+ */
+size_t fagpio_capture_packed(uint8_t port, const struct fagpio_pack *p, uint32_t *buf, size_t words, size_t max,
+	uint32_t period_ticks, uint32_t *span);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
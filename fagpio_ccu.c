@@ -0,0 +1,135 @@
+#include "fagpio_priv.h"
+#include "fagpio_ccu.h"
+#include "fagpio_region.h"
+#include "fagpio_timer.h"
+#include "fagpio_log.h"
+
+#define FIELD(v, shift, width)	(((v) >> (shift)) & ((1u << (width)) - 1))
+
+#define AHB_DIV_SHIFT		4		//AHB_CLK_DIV_RATIO, power of two
+#define AHB_PREDIV_SHIFT	6
+#define APB_DIV_SHIFT		8		//APB_CLK_RATIO: 0 and 1 divide by 2
+#define AHB_SRC_SHIFT		12
+#define HCLKC_DIV_SHIFT		16
+
+static const uint16_t gating_reg[3] = { 0x060, 0x064, 0x068 };
+static const uint16_t reset_reg[3] = { 0x2C0, 0x2C4, 0x2D0 };
+
+static volatile uint32_t *ccu_regs(void) {
+	if (!fagpio_banks())
+		return NULL;
+	return fagpio_region(FAGPIO_REGION_CCU);
+}
+
+// N and K multiply the 24 MHz oscillator, fields 12:8 and 5:4 in both PLLs
+static uint32_t pll_nk(uint32_t reg) {
+	return (uint32_t)((uint64_t)FAGPIO_OSC_HZ * (FIELD(reg, 8, 5) + 1) * (FIELD(reg, 4, 2) + 1));
+}
+
+int fagpio_ccu_clocks(struct fagpio_clocks *clk) {
+	volatile uint32_t *ccu = ccu_regs();
+
+	if (!ccu)
+		return -1;
+
+	uint32_t pll = ccu[rCCU_PLL_CPU / 4];
+	uint32_t cfg = ccu[rCCU_AHB_APB_CFG / 4];
+
+	clk->pll_cpu = pll_nk(pll) / ((FIELD(pll, 0, 2) + 1) << FIELD(pll, 16, 2));
+	clk->pll_periph = pll_nk(ccu[rCCU_PLL_PERIPH / 4]);
+
+	switch (FIELD(ccu[rCCU_CPU_CLK_SRC / 4], 16, 2)) {
+	case 0:		clk->cpu = FAGPIO_LOSC_HZ; break;
+	case 1:		clk->cpu = FAGPIO_OSC_HZ; break;
+	default:	clk->cpu = clk->pll_cpu; break;
+	}
+	clk->hclk = clk->cpu / (FIELD(cfg, HCLKC_DIV_SHIFT, 2) + 1);
+
+	uint32_t ahb;
+
+	switch (FIELD(cfg, AHB_SRC_SHIFT, 2)) {
+	case FAGPIO_AHB_LOSC:	ahb = FAGPIO_LOSC_HZ; break;
+	case FAGPIO_AHB_OSC24M:	ahb = FAGPIO_OSC_HZ; break;
+	case FAGPIO_AHB_CPU:	ahb = clk->cpu; break;
+	default:				ahb = clk->pll_periph / (FIELD(cfg, AHB_PREDIV_SHIFT, 2) + 1); break;
+	}
+	clk->ahb = ahb >> FIELD(cfg, AHB_DIV_SHIFT, 2);
+
+	uint32_t apb_ratio = FIELD(cfg, APB_DIV_SHIFT, 2);
+
+	clk->apb = clk->ahb >> (apb_ratio ? apb_ratio : 1);
+	return 0;
+}
+
+uint32_t fagpio_ccu_pio_hz(void) {
+	struct fagpio_clocks clk;
+
+	return fagpio_ccu_clocks(&clk) == 0 ? clk.apb : 0;
+}
+
+int fagpio_ccu_set_ahb(uint8_t src, uint8_t prediv, uint8_t div) {
+	volatile uint32_t *ccu = ccu_regs();
+
+	if (!ccu || src > FAGPIO_AHB_PLL_PERIPH || prediv < 1 || prediv > 4 || !div || div > 8 || (div & (div - 1)))
+		return -1;
+
+	uint32_t cfg = ccu[rCCU_AHB_APB_CFG / 4];
+	uint32_t log2 = __builtin_ctz(div);
+
+	cfg &= ~((3u << AHB_SRC_SHIFT) | (3u << AHB_PREDIV_SHIFT) | (3u << AHB_DIV_SHIFT));
+	cfg |= ((uint32_t)src << AHB_SRC_SHIFT) | ((uint32_t)(prediv - 1) << AHB_PREDIV_SHIFT) | (log2 << AHB_DIV_SHIFT);
+	ccu[rCCU_AHB_APB_CFG / 4] = cfg;
+	FAGPIO_LOG(FAGPIO_LOG_INFO, "AHB_APB_CFG = %08X\n", cfg);
+	fagpio_costs_measure();
+	return 0;
+}
+
+int fagpio_ccu_set_apb(uint8_t div) {
+	volatile uint32_t *ccu = ccu_regs();
+
+	if (!ccu || (div != 2 && div != 4 && div != 8))
+		return -1;
+
+	uint32_t ratio = div == 2 ? 1 : div == 4 ? 2 : 3;
+
+	ccu[rCCU_AHB_APB_CFG / 4] = (ccu[rCCU_AHB_APB_CFG / 4] & ~(3u << APB_DIV_SHIFT)) | (ratio << APB_DIV_SHIFT);
+	fagpio_costs_measure();
+	return 0;
+}
+
+static volatile uint32_t *gate_reg(uint8_t gate, const uint16_t *regs) {
+	volatile uint32_t *ccu = ccu_regs();
+
+	if (!ccu || (gate >> 5) > 2)
+		return NULL;
+	return &ccu[regs[gate >> 5] / 4];
+}
+
+int fagpio_ccu_gate(uint8_t gate, uint8_t enable) {
+	volatile uint32_t *reg = gate_reg(gate, gating_reg);
+	uint32_t bit = 1u << (gate & 31);
+
+	if (!reg)
+		return -1;
+	*reg = enable ? (*reg | bit) : (*reg & ~bit);
+	return 0;
+}
+
+int fagpio_ccu_gated(uint8_t gate) {
+	volatile uint32_t *reg = gate_reg(gate, gating_reg);
+
+	if (!reg)
+		return -1;
+	return (*reg >> (gate & 31)) & 1;
+}
+
+// Soft reset lines are active low: assert clears the bit
+int fagpio_ccu_reset(uint8_t gate, uint8_t assert) {
+	volatile uint32_t *reg = gate_reg(gate, reset_reg);
+	uint32_t bit = 1u << (gate & 31);
+
+	if (!reg)
+		return -1;
+	*reg = assert ? (*reg & ~bit) : (*reg | bit);
+	return 0;
+}
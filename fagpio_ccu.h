@@ -0,0 +1,81 @@
+#ifndef _FAGPIO_CCU_H
+#define _FAGPIO_CCU_H
+
+#include <stdint.h>
+
+/*
+ * Clock control unit (0x01C20000, inside the window mapped by
+ * fagpio_setup()). fagpio_ccu_clocks() decodes the PLL and divider
+ * registers into rates; the PIO block sits on APB, so fagpio_ccu_pio_hz()
+ * bounds how fast DAT can be written. Changing AHB or APB also changes the
+ * rate of every other bus peripheral, including the kernel's UART.
+ */
+
+#define rCCU_PLL_CPU		0x000
+#define rCCU_PLL_PERIPH		0x028
+#define rCCU_CPU_CLK_SRC	0x050
+#define rCCU_AHB_APB_CFG	0x054
+
+#define FAGPIO_OSC_HZ		24000000
+#define FAGPIO_LOSC_HZ		32768
+
+// AHB sources, as in AHB_CLK_SRC_SEL
+#define FAGPIO_AHB_LOSC			0
+#define FAGPIO_AHB_OSC24M		1
+#define FAGPIO_AHB_CPU			2
+#define FAGPIO_AHB_PLL_PERIPH	3		//Through the 1-4 pre-divider
+
+/*
+ * Bus clock gates: register 0-2 of BUS_CLK_GATING (0x060-0x068) and the
+ * bit, the same bit as in BUS_SOFT_RST (0x2C0, 0x2C4, 0x2D0). The PIO
+ * block has no gate of its own.
+ */
+#define FAGPIO_CCU_GATE(reg, bit)	(((reg) << 5) | (bit))
+
+#define FAGPIO_GATE_DMA		FAGPIO_CCU_GATE(0, 6)
+#define FAGPIO_GATE_SD0		FAGPIO_CCU_GATE(0, 8)
+#define FAGPIO_GATE_SD1		FAGPIO_CCU_GATE(0, 9)
+#define FAGPIO_GATE_SDRAM	FAGPIO_CCU_GATE(0, 14)
+#define FAGPIO_GATE_SPI0	FAGPIO_CCU_GATE(0, 20)
+#define FAGPIO_GATE_SPI1	FAGPIO_CCU_GATE(0, 21)
+#define FAGPIO_GATE_USB		FAGPIO_CCU_GATE(0, 24)
+#define FAGPIO_GATE_LCD		FAGPIO_CCU_GATE(1, 4)
+#define FAGPIO_GATE_CSI		FAGPIO_CCU_GATE(1, 8)
+#define FAGPIO_GATE_TVD		FAGPIO_CCU_GATE(1, 9)
+#define FAGPIO_GATE_TVE		FAGPIO_CCU_GATE(1, 10)
+#define FAGPIO_GATE_DEBE	FAGPIO_CCU_GATE(1, 12)
+#define FAGPIO_GATE_DEFE	FAGPIO_CCU_GATE(1, 14)
+#define FAGPIO_GATE_CODEC	FAGPIO_CCU_GATE(2, 0)
+#define FAGPIO_GATE_CIR		FAGPIO_CCU_GATE(2, 2)
+#define FAGPIO_GATE_DAUDIO	FAGPIO_CCU_GATE(2, 12)
+#define FAGPIO_GATE_TWI(n)	FAGPIO_CCU_GATE(2, 16 + (n))
+#define FAGPIO_GATE_UART(n)	FAGPIO_CCU_GATE(2, 20 + (n))
+
+struct fagpio_clocks {
+	uint32_t pll_cpu;
+	uint32_t pll_periph;
+	uint32_t cpu;
+	uint32_t hclk;			//CPU side of AHB, cpu / HCLKC_DIV
+	uint32_t ahb;
+	uint32_t apb;			//Also the PIO block
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fagpio_ccu_clocks(struct fagpio_clocks *clk);
+uint32_t fagpio_ccu_pio_hz(void);					//0 if the CCU is not mapped
+
+int fagpio_ccu_set_ahb(uint8_t src, uint8_t prediv, uint8_t div);	//prediv 1-4, div 1, 2, 4 or 8
+int fagpio_ccu_set_apb(uint8_t div);					//2, 4 or 8 AHB cycles
+
+int fagpio_ccu_gate(uint8_t gate, uint8_t enable);
+int fagpio_ccu_gated(uint8_t gate);					//1 running, 0 gated, -1 error
+int fagpio_ccu_reset(uint8_t gate, uint8_t assert);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
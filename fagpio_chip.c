@@ -0,0 +1,141 @@
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+#include "fagpio.h"
+#include "fagpio_chip.h"
+#include "fagpio_log.h"
+
+/*
+The toolchain ships 5.4 kernel headers, so this uses the v1 line-handle
+uAPI: GPIO_GET_LINEHANDLE_IOCTL with every line of a port in one request
+and GPIOHANDLE_SET/GET_LINE_VALUES_IOCTL for the whole handle. v1 cannot
+change the direction of a requested line, so pinMode re-requests the
+port's handles.
+*/
+
+struct chip_handle {
+	int fd;						//Line handle fd, -1 if no lines
+	uint32_t mask;				//Pins held by the handle
+	uint8_t nlines;
+	uint8_t bit[32];			//Handle line index -> pin index
+};
+
+struct chip_port {
+	struct chip_handle out;
+	struct chip_handle in;
+	uint32_t out_value;			//Last value written to the outputs
+};
+
+static int chip_fd = -1;
+static struct chip_port chip_ports[PIO_NPORTS];
+
+static int chip_request(uint8_t port, struct chip_handle *h, uint32_t flags, uint32_t values) {
+	struct gpiohandle_request req;
+
+	if (h->fd >= 0)
+		close(h->fd);
+	h->fd = -1;
+	h->nlines = 0;
+
+	memset(&req, 0, sizeof(req));
+	for (unsigned int n = 0; n < 32; n++) {
+		if (!(h->mask & (1u << n)))
+			continue;
+		req.lineoffsets[h->nlines] = port * 32 + n;
+		req.default_values[h->nlines] = (values >> n) & 1;
+		h->bit[h->nlines++] = n;
+	}
+	if (!h->nlines)
+		return 0;
+
+	req.lines = h->nlines;
+	req.flags = flags;
+	strncpy(req.consumer_label, "fagpio", sizeof(req.consumer_label) - 1);
+	if (ioctl(chip_fd, GPIO_GET_LINEHANDLE_IOCTL, &req) < 0) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "P%c line request failed\n", 'A' + port);
+		h->nlines = 0;
+		return -1;
+	}
+	h->fd = req.fd;
+	return 0;
+}
+
+int fagpio_chip_open(const char *path) {
+	if ((chip_fd = open(path ? path : FAGPIO_CHIP_DEV, O_RDWR)) < 0)
+		return -1;
+
+	memset(chip_ports, 0, sizeof(chip_ports));
+	for (unsigned int port = 0; port < PIO_NPORTS; port++) {
+		chip_ports[port].out.fd = -1;
+		chip_ports[port].in.fd = -1;
+	}
+	return 0;
+}
+
+void fagpio_chip_close(void) {
+	for (unsigned int port = 0; port < PIO_NPORTS; port++) {
+		if (chip_ports[port].out.fd >= 0)
+			close(chip_ports[port].out.fd);
+		if (chip_ports[port].in.fd >= 0)
+			close(chip_ports[port].in.fd);
+	}
+	if (chip_fd >= 0)
+		close(chip_fd);
+	chip_fd = -1;
+}
+
+int fagpio_chip_pin_mode(uint8_t port, uint32_t mask, int output) {
+	if (chip_fd < 0 || port >= PIO_NPORTS)
+		return -1;
+
+	struct chip_port *cp = &chip_ports[port];
+	uint32_t out = output ? (cp->out.mask | mask) : (cp->out.mask & ~mask);
+	uint32_t in = output ? (cp->in.mask & ~mask) : (cp->in.mask | mask);
+	int ret = 0;
+
+	// Release first so lines can move between the two handles
+	if (in != cp->in.mask) {
+		close(cp->in.fd);
+		cp->in.fd = -1;
+	}
+	if (out != cp->out.mask) {
+		cp->out.mask = out;
+		ret |= chip_request(port, &cp->out, GPIOHANDLE_REQUEST_OUTPUT, cp->out_value);
+	}
+	if (in != cp->in.mask) {
+		cp->in.mask = in;
+		ret |= chip_request(port, &cp->in, GPIOHANDLE_REQUEST_INPUT, 0);
+	}
+	return ret;
+}
+
+int fagpio_chip_write_port(uint8_t port, uint32_t mask, uint32_t value) {
+	if (port >= PIO_NPORTS)
+		return -1;
+
+	struct chip_port *cp = &chip_ports[port];
+	struct gpiohandle_data data;
+
+	if (cp->out.fd < 0)
+		return -1;
+
+	cp->out_value = (cp->out_value & ~mask) | (value & mask);
+	for (unsigned int i = 0; i < cp->out.nlines; i++)
+		data.values[i] = (cp->out_value >> cp->out.bit[i]) & 1;
+	return ioctl(cp->out.fd, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data);
+}
+
+// Inputs come from one GET ioctl, outputs from the last written value
+uint32_t fagpio_chip_read_port(uint8_t port) {
+	if (port >= PIO_NPORTS)
+		return 0;
+
+	struct chip_port *cp = &chip_ports[port];
+	struct gpiohandle_data data;
+	uint32_t value = cp->out_value & cp->out.mask;
+
+	if (cp->in.fd >= 0 && ioctl(cp->in.fd, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data) == 0) {
+		for (unsigned int i = 0; i < cp->in.nlines; i++)
+			value |= (uint32_t)(data.values[i] & 1) << cp->in.bit[i];
+	}
+	return value;
+}
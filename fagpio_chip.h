@@ -0,0 +1,28 @@
+#ifndef _FAGPIO_CHIP_H
+#define _FAGPIO_CHIP_H
+
+#include <stdint.h>
+
+/*
+ * GPIO character-device backend for images without /dev/mem. Lines are
+ * numbered like PIO_PIN() (port * 32 + index) on the sunxi pinctrl chip.
+ * Each port keeps one line handle for its outputs and one for its inputs,
+ * so a whole-port write or read is a single ioctl.
+ */
+#define FAGPIO_CHIP_DEV		"/dev/gpiochip0"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fagpio_chip_open(const char *path);		//NULL opens FAGPIO_CHIP_DEV
+void fagpio_chip_close(void);
+int fagpio_chip_pin_mode(uint8_t port, uint32_t mask, int output);
+int fagpio_chip_write_port(uint8_t port, uint32_t mask, uint32_t value);
+uint32_t fagpio_chip_read_port(uint8_t port);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
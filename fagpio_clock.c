@@ -0,0 +1,182 @@
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include "fagpio.h"
+#include "fagpio_clock.h"
+#include "fagpio_log.h"
+
+struct fagpio_clock_fit fagpio_clock;
+
+static pthread_mutex_t sync_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t sync_thread;
+static volatile uint8_t sync_stop;
+static uint32_t sync_interval_ms;
+static uint32_t prev_ticks;			//Sample the slope is measured from
+static uint64_t prev_ns;
+
+static uint64_t monotonic_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint64_t realtime_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+The counter at the middle of the tightest bracket around two
+CLOCK_MONOTONIC reads with a CLOCK_REALTIME one between them, which the
+midpoint of the two is taken to be simultaneous with.
+*/
+static void sample(uint32_t *ticks, uint64_t *ns, int64_t *realtime, uint32_t *bracket) {
+	*bracket = ~0u;		//The first try always replaces these
+	*ticks = 0;
+	*ns = 0;
+	*realtime = 0;
+	for (int i = 0; i < FAGPIO_CLOCK_TRIES; i++) {
+		uint32_t a = fagpio_ticks();
+		uint64_t m0 = monotonic_ns();
+		uint64_t r = realtime_ns();
+		uint64_t m1 = monotonic_ns();
+		uint32_t b = fagpio_ticks();
+
+		if (b - a < *bracket) {
+			*bracket = b - a;
+			*ticks = a + (b - a) / 2;
+			*ns = m0 + (m1 - m0) / 2;
+			*realtime = r - *ns;
+		}
+	}
+}
+
+static void publish(uint32_t ticks, uint64_t ns, int64_t realtime, uint64_t ns_per_tick, uint32_t bracket) {
+	fagpio_clock.seq++;
+	fagpio_barrier();
+	fagpio_clock.ticks = ticks;
+	fagpio_clock.ns = ns;
+	fagpio_clock.realtime = realtime;
+	fagpio_clock.ns_int = ns_per_tick >> 32;
+	fagpio_clock.ns_frac = (uint32_t)ns_per_tick;
+	fagpio_clock.ticks_per_ns = ns_per_tick ? ((uint64_t)1 << 63) / ns_per_tick * 2 : 0;
+	fagpio_clock.syncs++;
+	fagpio_clock.bracket = bracket;
+	fagpio_barrier();
+	fagpio_clock.seq++;
+}
+
+/*
+The first sync takes the rate calibrated at setup. Later ones refit the
+slope once FAGPIO_CLOCK_MIN_FIT ms have passed since the sample it is
+measured from; closer samples would let their jitter dominate.
+*/
+int fagpio_clock_sync(void) {
+	uint32_t ticks, bracket;
+	uint64_t ns, ns_per_tick;
+	int64_t realtime;
+
+	pthread_mutex_lock(&sync_lock);
+	sample(&ticks, &ns, &realtime, &bracket);
+	if (!fagpio_clock.syncs) {
+		ns_per_tick = (1000000000ull << 32) / fagpio_tick_hz;
+		prev_ticks = ticks;
+		prev_ns = ns;
+	} else {
+		uint32_t dt = ticks - prev_ticks;
+
+		ns_per_tick = (uint64_t)fagpio_clock.ns_int << 32 | fagpio_clock.ns_frac;
+		if (ns - prev_ns >= FAGPIO_CLOCK_MIN_FIT * 1000000ull && dt) {
+			// 32.32 without overflow: dt and so the remainder are under 2^32
+			uint64_t dns = ns - prev_ns;
+
+			ns_per_tick = (dns / dt) << 32 | ((dns % dt) << 32) / dt;
+			prev_ticks = ticks;
+			prev_ns = ns;
+		}
+	}
+	publish(ticks, ns, realtime, ns_per_tick, bracket);
+	pthread_mutex_unlock(&sync_lock);
+	return 0;
+}
+
+static void *clock_thread(void *arg) {
+	struct timespec ts = { sync_interval_ms / 1000, (sync_interval_ms % 1000) * 1000000 };
+
+	(void)arg;
+	while (!sync_stop) {
+		nanosleep(&ts, NULL);
+		fagpio_clock_sync();
+	}
+	return NULL;
+}
+
+int fagpio_clock_start(uint32_t interval_ms) {
+	if (!interval_ms || sync_thread)
+		return -1;
+	if ((uint64_t)interval_ms * fagpio_tick_hz / 1000 >= 0x80000000u) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "Clock sync every %u ms is longer than half a counter wrap\n", interval_ms);
+		return -1;
+	}
+	fagpio_clock_sync();
+	sync_interval_ms = interval_ms;
+	sync_stop = 0;
+	if (pthread_create(&sync_thread, NULL, clock_thread, NULL)) {
+		sync_thread = 0;
+		return -1;
+	}
+	return 0;
+}
+
+void fagpio_clock_stop(void) {
+	sync_stop = 1;
+	if (sync_thread) {
+		pthread_join(sync_thread, NULL);
+		sync_thread = 0;
+	}
+}
+
+static uint32_t wake_late;		//ns, decaying peak of how late the sleep returns
+
+/*
+The sleep ends early by the wake-up latency seen so far plus
+FAGPIO_SCHEDULE_SPIN_NS, so only the margin is spun once the latency is
+learnt. The fit is refreshed after the sleep, so the conversion uses a
+sample taken just before the edge; sleeping on CLOCK_REALTIME itself
+follows any step or slew NTP makes meanwhile.
+*/
+int fagpio_schedule_seq_at(const struct timespec *at, struct fagpio_seq *seq) {
+	uint64_t target = (uint64_t)at->tv_sec * 1000000000 + at->tv_nsec;
+	uint64_t wake = target - FAGPIO_SCHEDULE_SPIN_NS - wake_late;
+	struct timespec ts = { wake / 1000000000, wake % 1000000000 };
+	int late;
+
+	if (realtime_ns() < wake) {
+		while (clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &ts, NULL) == EINTR)
+			;
+
+		uint64_t over = realtime_ns() - wake;
+
+		if (over > 10000000)
+			over = 10000000;		//A step of the clock, not latency
+		wake_late = over > wake_late ? over : wake_late - wake_late / 16;
+	}
+	fagpio_clock_sync();
+	late = fagpio_seq_play_ops(seq->ops, seq->count, fagpio_clock_realtime_to_ticks(target));
+	if (late < 0)
+		return -1;
+	seq->late = late;
+	return late ? 1 : 0;
+}
+
+int fagpio_schedule_at(const struct timespec *at, uint8_t port, uint32_t mask, uint32_t value) {
+	struct fagpio_seq_op op = { 0, mask, value & mask, port, { 0 } };
+	struct fagpio_seq seq = { &op, 1, 1, 0, 0 };
+
+	if (port >= PIO_NPORTS)
+		return -1;
+	return fagpio_schedule_seq_at(at, &seq);
+}
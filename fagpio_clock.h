@@ -0,0 +1,124 @@
+#ifndef _FAGPIO_CLOCK_H
+#define _FAGPIO_CLOCK_H
+
+#include <stdint.h>
+#include <time.h>
+#include "fagpio_atomic.h"
+#include "fagpio_seq.h"
+#include "fagpio_timer.h"
+
+/*
+ * Counter to CLOCK_MONOTONIC correlation. Capture and trace timestamps are
+ * AVS counter ticks; fagpio_clock_to_ns() turns one into CLOCK_MONOTONIC
+ * nanoseconds, comparable with application logs, with a multiply-add on
+ * a linear fit instead of a clock_gettime() per event.
+ *
+ * fagpio_clock_sync() samples both clocks, the counter read on either
+ * side of clock_gettime() and the tightest of a few tries kept, and
+ * refits: the new sample is the anchor and the slope is taken over the
+ * time since the previous one, so it tracks the counter's real rate
+ * rather than the one calibrated at setup. fagpio_clock_start() resyncs
+ * from a thread every interval_ms; the interval has to stay under half
+ * the counter's wrap (89 s at 24 MHz, 2 s on the host fallback).
+ *
+ * The fit is published under a sequence count, odd while being written:
+ * readers retry instead of locking, so conversions work from any thread
+ * and from signal handlers. Ticks within half a wrap of the last sync
+ * convert correctly.
+ *
+ * Each sync also records CLOCK_REALTIME, which NTP or PTP keeps in step
+ * across boards. fagpio_schedule_at() sleeps on CLOCK_REALTIME until
+ * shortly before the wall-clock time at, the wake-up latency it has seen
+ * plus FAGPIO_SCHEDULE_SPIN_NS, resyncs, and leaves the last stretch to
+ * the sequencer spinning on the counter, so synchronised boards switch
+ * within their clock offset plus a few microseconds without busy-waiting
+ * for long. It returns 1 if the edge went out late, 0 on time and -1 on
+ * error.
+ */
+
+#define FAGPIO_CLOCK_TRIES		5		//Samples per sync, the tightest bracket is kept
+#define FAGPIO_CLOCK_MIN_FIT	100		//ms between samples before the slope is refitted
+#ifndef FAGPIO_SCHEDULE_SPIN_NS
+#define FAGPIO_SCHEDULE_SPIN_NS	20000	//Spun beyond the learnt wake-up latency before an edge
+#endif
+
+struct fagpio_clock_fit {
+	volatile uint32_t seq;
+	uint32_t ticks;				//Counter at the anchor
+	uint64_t ns;				//CLOCK_MONOTONIC at the anchor
+	int64_t realtime;			//CLOCK_REALTIME minus CLOCK_MONOTONIC there
+	uint32_t ns_int;			//ns per tick, 32.32 fixed point in two words
+	uint32_t ns_frac;
+	uint64_t ticks_per_ns;		//32.32 fixed point, for the inverse
+	uint32_t syncs;
+	uint32_t bracket;			//Ticks around clock_gettime() in the last sync
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern struct fagpio_clock_fit fagpio_clock;
+
+int fagpio_clock_sync(void);
+int fagpio_clock_start(uint32_t interval_ms);		//Syncs now, then every interval_ms
+void fagpio_clock_stop(void);
+
+// A consistent copy of the fit
+static inline void fagpio_clock_read(struct fagpio_clock_fit *f) {
+	uint32_t seq;
+
+	do {
+		while ((seq = fagpio_clock.seq) & 1)
+			;
+		fagpio_barrier();
+		*f = fagpio_clock;
+		fagpio_barrier();
+	} while (fagpio_clock.seq != seq);
+}
+
+// CLOCK_MONOTONIC nanoseconds at counter value ticks
+static inline uint64_t fagpio_clock_to_ns(uint32_t ticks) {
+	struct fagpio_clock_fit f;
+
+	fagpio_clock_read(&f);
+
+	int32_t d = ticks - f.ticks;
+	uint32_t u = d < 0 ? -(uint32_t)d : (uint32_t)d;
+	uint64_t ns = (uint64_t)u * f.ns_int + (((uint64_t)u * f.ns_frac) >> 32);
+
+	return d < 0 ? f.ns - ns : f.ns + ns;
+}
+
+static inline uint32_t fagpio_clock_fit_ticks(const struct fagpio_clock_fit *f, uint64_t ns) {
+	int64_t d = ns - f->ns;
+	uint64_t u = d < 0 ? -(uint64_t)d : (uint64_t)d;
+	uint32_t t = (uint32_t)((u * f->ticks_per_ns) >> 32);
+
+	return d < 0 ? f->ticks - t : f->ticks + t;
+}
+
+// Counter value at CLOCK_MONOTONIC nanoseconds ns
+static inline uint32_t fagpio_clock_to_ticks(uint64_t ns) {
+	struct fagpio_clock_fit f;
+
+	fagpio_clock_read(&f);
+	return fagpio_clock_fit_ticks(&f, ns);
+}
+
+// Counter value at CLOCK_REALTIME nanoseconds ns
+static inline uint32_t fagpio_clock_realtime_to_ticks(uint64_t ns) {
+	struct fagpio_clock_fit f;
+
+	fagpio_clock_read(&f);
+	return fagpio_clock_fit_ticks(&f, ns - f.realtime);
+}
+
+int fagpio_schedule_at(const struct timespec *at, uint8_t port, uint32_t mask, uint32_t value);
+int fagpio_schedule_seq_at(const struct timespec *at, struct fagpio_seq *seq);		//Plays seq from at
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,198 @@
+#ifndef _FAGPIO_CONTROLLER_HPP
+#define _FAGPIO_CONTROLLER_HPP
+
+/*
+ * Header-only C++17 owner of the register mapping. A GpioController maps
+ * the PIO block on construction (fagpio_setup()) and unmaps it when it is
+ * destroyed (fagpio_free()); it can be moved but not copied, so exactly one
+ * object is responsible for the mapping. Keep one owning controller per
+ * process, as the mapping underneath is still the library's.
+ *
+ * pin() and port() return small handles holding the DAT and CFG pointers
+ * and masks computed once, so later calls never touch gpio or recompute
+ * offsets. A controller built on a caller's pio_bank array does not own
+ * it, which lets the handles run against plain memory off target.
+ *
+ * batch() collects set, clear and toggle operations on any pins into
+ * per-port masks and commit() applies them with one read and one store of
+ * each touched DAT, in port order. A later operation on a pin replaces an
+ * earlier one, so the result is what the calls would have done one by one.
+ * Like fagpio.hpp these handles bypass the shadow registers; call
+ * fagpio_shadow_sync() afterwards when shadow mode is on.
+ */
+
+#include <utility>
+#include "fagpio.h"
+
+namespace fagpio {
+
+class PinHandle {
+public:
+	PinHandle() = default;
+	PinHandle(struct pio_bank *bank, unsigned n)
+		: dat_(&bank->dat), cfg_(&bank->cfg[(n & 31) >> 3]), mask_(1u << (n & 31)), cfg_shift_((n & 7) * 4) {}
+
+	explicit operator bool() const { return dat_ != nullptr; }
+
+	// Raw CFG function number: 0 input, 1 output, 7 disabled
+	void function(uint32_t fn) const { *cfg_ = (*cfg_ & ~(0xFu << cfg_shift_)) | ((fn & 0xF) << cfg_shift_); }
+	void output() const { function(1); }
+	void input() const { function(0); }
+
+	void set() const { *dat_ |= mask_; }
+	void clear() const { *dat_ &= ~mask_; }
+	void write(bool value) const { value ? set() : clear(); }
+	void toggle() const { *dat_ ^= mask_; }
+	bool read() const { return (*dat_ & mask_) != 0; }
+
+	uint32_t mask() const { return mask_; }
+	volatile uint32_t *dat() const { return dat_; }
+
+private:
+	volatile uint32_t *dat_ = nullptr;
+	volatile uint32_t *cfg_ = nullptr;
+	uint32_t mask_ = 0;
+	unsigned cfg_shift_ = 0;
+};
+
+class PortHandle {
+public:
+	PortHandle() = default;
+	explicit PortHandle(struct pio_bank *bank) : bank_(bank) {}
+
+	explicit operator bool() const { return bank_ != nullptr; }
+
+	// One store: pins in mask take value, the others keep their level
+	void write(uint32_t mask, uint32_t value) const { bank_->dat = (bank_->dat & ~mask) | (value & mask); }
+	void set(uint32_t mask) const { bank_->dat |= mask; }
+	void clear(uint32_t mask) const { bank_->dat &= ~mask; }
+	void toggle(uint32_t mask) const { bank_->dat ^= mask; }
+	uint32_t read() const { return bank_->dat; }
+
+	PinHandle pin(unsigned n) const { return PinHandle(bank_, n); }
+	struct pio_bank *bank() const { return bank_; }
+
+private:
+	struct pio_bank *bank_ = nullptr;
+};
+
+class Batch {
+public:
+	explicit Batch(struct pio_bank *banks) : banks_(banks) {}
+
+	Batch &set(uint8_t pin) { return set_mask(PIO_PIN_PORT(pin), PIO_PIN_MASK(pin)); }
+	Batch &clear(uint8_t pin) { return clear_mask(PIO_PIN_PORT(pin), PIO_PIN_MASK(pin)); }
+	Batch &toggle(uint8_t pin) { return toggle_mask(PIO_PIN_PORT(pin), PIO_PIN_MASK(pin)); }
+	Batch &write(uint8_t pin, bool value) { return value ? set(pin) : clear(pin); }
+
+	Batch &set_mask(uint8_t port, uint32_t mask) {
+		if (port < PIO_NPORTS) {
+			set_[port] |= mask;
+			clear_[port] &= ~mask;
+			toggle_[port] &= ~mask;
+		}
+		return *this;
+	}
+	Batch &clear_mask(uint8_t port, uint32_t mask) {
+		if (port < PIO_NPORTS) {
+			clear_[port] |= mask;
+			set_[port] &= ~mask;
+			toggle_[port] &= ~mask;
+		}
+		return *this;
+	}
+	// A pending set becomes a clear and the other way round; other pins flip at commit
+	Batch &toggle_mask(uint8_t port, uint32_t mask) {
+		if (port < PIO_NPORTS) {
+			uint32_t s = set_[port] & mask, c = clear_[port] & mask;
+
+			set_[port] = (set_[port] & ~s) | c;
+			clear_[port] = (clear_[port] & ~c) | s;
+			toggle_[port] ^= mask & ~(s | c);
+		}
+		return *this;
+	}
+
+	// Applies and empties the batch; returns the number of ports stored
+	unsigned commit() {
+		unsigned stored = 0;
+
+		for (unsigned p = 0; p < PIO_NPORTS; p++) {
+			uint32_t forced = set_[p] | clear_[p];
+
+			if (!(forced | toggle_[p]))
+				continue;
+			volatile uint32_t &dat = banks_[p].dat;
+			dat = (((dat & ~forced) | set_[p]) ^ toggle_[p]);
+			set_[p] = clear_[p] = toggle_[p] = 0;
+			stored++;
+		}
+		return stored;
+	}
+
+private:
+	struct pio_bank *banks_;
+	uint32_t set_[PIO_NPORTS] = {};
+	uint32_t clear_[PIO_NPORTS] = {};
+	uint32_t toggle_[PIO_NPORTS] = {};
+};
+
+class GpioController {
+public:
+	// Maps the registers; check with ok() or operator bool
+	GpioController() {
+		if (fagpio_setup() == 0 && (banks_ = fagpio_banks()) != nullptr)
+			owner_ = true;
+	}
+
+	// Not owning: handles on a caller's bank array, e.g. a fake one in host tests
+	explicit GpioController(struct pio_bank *banks) : banks_(banks) {}
+
+	GpioController(const GpioController &) = delete;
+	GpioController &operator=(const GpioController &) = delete;
+
+	GpioController(GpioController &&other) noexcept
+		: banks_(std::exchange(other.banks_, nullptr)), owner_(std::exchange(other.owner_, false)) {}
+
+	GpioController &operator=(GpioController &&other) noexcept {
+		if (this != &other) {
+			release();
+			banks_ = std::exchange(other.banks_, nullptr);
+			owner_ = std::exchange(other.owner_, false);
+		}
+		return *this;
+	}
+
+	~GpioController() { release(); }
+
+	bool ok() const { return banks_ != nullptr; }
+	explicit operator bool() const { return ok(); }
+
+	// Empty handles for a port out of range or an unmapped controller
+	PortHandle port(uint8_t port) const {
+		return banks_ && port < PIO_NPORTS ? PortHandle(&banks_[port]) : PortHandle();
+	}
+	PinHandle pin(uint8_t pin) const {
+		return banks_ && PIO_PIN_PORT(pin) < PIO_NPORTS ? PinHandle(&banks_[PIO_PIN_PORT(pin)], PIO_PIN_NUM(pin)) : PinHandle();
+	}
+
+	// Empty batch on this controller's banks; build and commit it while the controller lives
+	Batch batch() const { return Batch(banks_); }
+
+	struct pio_bank *banks() const { return banks_; }
+
+private:
+	void release() {
+		if (owner_)
+			fagpio_free();
+		banks_ = nullptr;
+		owner_ = false;
+	}
+
+	struct pio_bank *banks_ = nullptr;
+	bool owner_ = false;
+};
+
+}
+
+#endif
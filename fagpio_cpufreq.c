@@ -0,0 +1,144 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "fagpio_cpufreq.h"
+#include "fagpio_timer.h"
+#include "fagpio_log.h"
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static int cur_fd = -2;				//scaling_cur_freq, -2 until first opened
+static uint32_t costs_khz;			//Frequency the costs were last marked stale at, 0 before
+static unsigned int lock_depth;
+static uint32_t saved_min, saved_max;
+static pthread_t watch_thread;
+static volatile uint8_t watch_stop;
+static uint32_t watch_ms;
+
+static uint32_t read_khz(int fd) {
+	char buf[16];
+	ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);		//sysfs attributes reread from offset 0
+
+	if (n <= 0)
+		return 0;
+	buf[n] = 0;
+	return strtoul(buf, NULL, 10);
+}
+
+static uint32_t read_attr(const char *name) {
+	char path[96];
+	uint32_t khz;
+	int fd;
+
+	snprintf(path, sizeof(path), FAGPIO_CPUFREQ_DIR "%s", name);
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+		return 0;
+	khz = read_khz(fd);
+	close(fd);
+	return khz;
+}
+
+static int write_attr(const char *name, uint32_t khz) {
+	char path[96], buf[16];
+	int fd, n, ok;
+
+	snprintf(path, sizeof(path), FAGPIO_CPUFREQ_DIR "%s", name);
+	if ((fd = open(path, O_WRONLY | O_CLOEXEC)) < 0)
+		return -1;
+	n = snprintf(buf, sizeof(buf), "%u\n", khz);
+	ok = write(fd, buf, n) == n;
+	close(fd);
+	return ok ? 0 : -1;
+}
+
+uint32_t fagpio_cpufreq_khz(void) {
+	if (cur_fd == -2)
+		cur_fd = open(FAGPIO_CPUFREQ_DIR "scaling_cur_freq", O_RDONLY | O_CLOEXEC);
+	return cur_fd >= 0 ? read_khz(cur_fd) : 0;
+}
+
+// The first frequency seen also counts as a change: setup may have measured at another
+int fagpio_cpufreq_check(void) {
+	uint32_t khz = fagpio_cpufreq_khz();
+
+	if (!khz)
+		return -1;
+	if (khz == costs_khz)
+		return 0;
+	FAGPIO_LOG(FAGPIO_LOG_DEBUG, "CPU at %u kHz, access costs to be measured again\n", khz);
+	costs_khz = khz;
+	fagpio_costs_stale = 1;
+	fagpio_costs_gen++;		//So a gen compare alone catches it
+	return 1;
+}
+
+static void *watch(void *arg) {
+	struct timespec ts = { watch_ms / 1000, (watch_ms % 1000) * 1000000 };
+
+	(void)arg;
+	while (!watch_stop) {
+		fagpio_cpufreq_check();
+		nanosleep(&ts, NULL);
+	}
+	return NULL;
+}
+
+int fagpio_cpufreq_watch(uint32_t interval_ms) {
+	if (!interval_ms || watch_thread || fagpio_cpufreq_check() < 0)
+		return -1;
+	watch_ms = interval_ms;
+	watch_stop = 0;
+	if (pthread_create(&watch_thread, NULL, watch, NULL)) {
+		watch_thread = 0;
+		return -1;
+	}
+	return 0;
+}
+
+void fagpio_cpufreq_unwatch(void) {
+	watch_stop = 1;
+	if (watch_thread) {
+		pthread_join(watch_thread, NULL);
+		watch_thread = 0;
+	}
+}
+
+/*
+The maximum goes down to the current frequency first, then the minimum up
+to it; unlocking raises the maximum again before lowering the minimum, so
+min <= max holds after every single write.
+*/
+int fagpio_cpufreq_lock(void) {
+	int ret = 0;
+
+	pthread_mutex_lock(&lock);
+	if (!lock_depth) {
+		uint32_t khz = fagpio_cpufreq_khz();
+
+		saved_min = read_attr("scaling_min_freq");
+		saved_max = read_attr("scaling_max_freq");
+		if (!khz || !saved_min || !saved_max || write_attr("scaling_max_freq", khz) < 0) {
+			ret = -1;
+		} else if (write_attr("scaling_min_freq", khz) < 0) {
+			write_attr("scaling_max_freq", saved_max);
+			ret = -1;
+		}
+	}
+	if (!ret) {
+		lock_depth++;
+		fagpio_cpufreq_check();
+	}
+	pthread_mutex_unlock(&lock);
+	return ret;
+}
+
+void fagpio_cpufreq_unlock(void) {
+	pthread_mutex_lock(&lock);
+	if (lock_depth && !--lock_depth) {
+		write_attr("scaling_max_freq", saved_max);
+		write_attr("scaling_min_freq", saved_min);
+	}
+	pthread_mutex_unlock(&lock);
+}
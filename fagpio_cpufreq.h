@@ -0,0 +1,43 @@
+#ifndef _FAGPIO_CPUFREQ_H
+#define _FAGPIO_CPUFREQ_H
+
+#include <stdint.h>
+
+/*
+ * CPU frequency changes. Delays count the 24 MHz AVS counter and keep
+ * their length whatever cpufreq does, but the PIO access costs measured
+ * at setup, which the bit-bang drivers take off their delays, change with
+ * the bus clocks. Two ways to keep them right without pinning the CPU at
+ * its top clock:
+ *  - fagpio_cpufreq_watch(interval_ms) polls
+ *    /sys/devices/system/cpu/cpu0/cpufreq/scaling_cur_freq from a thread
+ *    and marks the costs stale when it moves; the next bit-bang transfer
+ *    re-measures them in its own thread and retimes itself
+ *    (fagpio_costs_update() in fagpio_timer.h)
+ *  - fagpio_cpufreq_lock() pins the governor to the current frequency,
+ *    by setting scaling_min_freq and scaling_max_freq to it, for a
+ *    critical section; fagpio_cpufreq_unlock() puts the limits back.
+ *    Locks nest. Writing the limits needs root.
+ * Both return -1 when the kernel has no cpufreq.
+ */
+
+#ifndef FAGPIO_CPUFREQ_DIR
+#define FAGPIO_CPUFREQ_DIR	"/sys/devices/system/cpu/cpu0/cpufreq/"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t fagpio_cpufreq_khz(void);		//Current frequency, 0 without cpufreq
+int fagpio_cpufreq_check(void);			//1 and costs marked stale if the frequency moved
+int fagpio_cpufreq_watch(uint32_t interval_ms);
+void fagpio_cpufreq_unwatch(void);
+int fagpio_cpufreq_lock(void);
+void fagpio_cpufreq_unlock(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
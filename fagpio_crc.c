@@ -0,0 +1,92 @@
+#include <pthread.h>
+#include <string.h>
+#include "fagpio_crc.h"
+
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+static uint16_t modbus[4][256];		//modbus[k][i]: byte i followed by k zero bytes
+static uint16_t ccitt[4][256];
+static uint8_t maxim[256], sensirion[256], crc7[256];	//crc7 kept in the top 7 bits
+
+static void init_tables(void) {
+	for (unsigned int i = 0; i < 256; i++) {
+		uint16_t m = i, c = i << 8;
+		uint8_t x = i, s = i, d = i;
+
+		for (int b = 0; b < 8; b++) {
+			m = (m & 1) ? (m >> 1) ^ 0xA001 : m >> 1;
+			c = (c & 0x8000) ? (c << 1) ^ 0x1021 : c << 1;
+			x = (x & 1) ? (x >> 1) ^ 0x8C : x >> 1;
+			s = (s & 0x80) ? (s << 1) ^ 0x31 : s << 1;
+			d = (d & 0x80) ? (d << 1) ^ (0x09 << 1) : d << 1;
+		}
+		modbus[0][i] = m;
+		ccitt[0][i] = c;
+		maxim[i] = x;
+		sensirion[i] = s;
+		crc7[i] = d;
+	}
+	for (unsigned int k = 1; k < 4; k++)
+		for (unsigned int i = 0; i < 256; i++) {
+			modbus[k][i] = (modbus[k - 1][i] >> 8) ^ modbus[0][modbus[k - 1][i] & 0xFF];
+			ccitt[k][i] = (ccitt[k - 1][i] << 8) ^ ccitt[0][ccitt[k - 1][i] >> 8];
+		}
+}
+
+static inline uint8_t table8(const uint8_t *t, uint8_t crc, const uint8_t *p, size_t len) {
+	while (len--)
+		crc = t[crc ^ *p++];
+	return crc;
+}
+
+uint8_t fagpio_crc8_maxim(uint8_t crc, const void *data, size_t len) {
+	pthread_once(&once, init_tables);
+	return table8(maxim, crc, data, len);
+}
+
+uint8_t fagpio_crc8_sensirion(uint8_t crc, const void *data, size_t len) {
+	pthread_once(&once, init_tables);
+	return table8(sensirion, crc, data, len);
+}
+
+uint8_t fagpio_crc7(uint8_t crc, const void *data, size_t len) {
+	pthread_once(&once, init_tables);
+	return table8(crc7, crc << 1, data, len) >> 1;
+}
+
+// Bytes up to a word boundary, then one aligned little-endian word per step
+uint16_t fagpio_crc16_modbus(uint16_t crc, const void *data, size_t len) {
+	const uint8_t *p = data;
+
+	pthread_once(&once, init_tables);
+	for (; len && ((uintptr_t)p & 3); len--)
+		crc = (crc >> 8) ^ modbus[0][(crc ^ *p++) & 0xFF];
+	for (; len >= 4; len -= 4, p += 4) {
+		uint32_t w;
+
+		memcpy(&w, __builtin_assume_aligned(p, 4), 4);
+		w ^= crc;
+
+		crc = modbus[3][w & 0xFF] ^ modbus[2][(w >> 8) & 0xFF] ^ modbus[1][(w >> 16) & 0xFF] ^ modbus[0][w >> 24];
+	}
+	while (len--)
+		crc = (crc >> 8) ^ modbus[0][(crc ^ *p++) & 0xFF];
+	return crc;
+}
+
+uint16_t fagpio_crc16_ccitt(uint16_t crc, const void *data, size_t len) {
+	const uint8_t *p = data;
+
+	pthread_once(&once, init_tables);
+	for (; len && ((uintptr_t)p & 3); len--)
+		crc = (crc << 8) ^ ccitt[0][(crc >> 8) ^ *p++];
+	for (; len >= 4; len -= 4, p += 4) {
+		uint32_t w;
+
+		memcpy(&w, __builtin_assume_aligned(p, 4), 4);
+		w = (w >> 24 | (w >> 8 & 0xFF00) | (w << 8 & 0xFF0000) | w << 24) ^ ((uint32_t)crc << 16);
+		crc = ccitt[3][w >> 24] ^ ccitt[2][(w >> 16) & 0xFF] ^ ccitt[1][(w >> 8) & 0xFF] ^ ccitt[0][w & 0xFF];
+	}
+	while (len--)
+		crc = (crc << 8) ^ ccitt[0][(crc >> 8) ^ *p++];
+	return crc;
+}
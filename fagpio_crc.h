@@ -0,0 +1,43 @@
+#ifndef _FAGPIO_CRC_H
+#define _FAGPIO_CRC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Table-driven CRCs of the protocol drivers. Each takes the running
+ * value, so a message can be checked in pieces: start from the _INIT
+ * value and pass the result back in. On a whole message that ends with
+ * its own CRC most of them come out 0 (Modbus: low byte first).
+ *
+ * The 16-bit CRCs go through slicing-by-4: four 256-entry tables (2 KiB
+ * each) fold one aligned word per step, for SD blocks and long Modbus
+ * frames. The 8-bit ones use a single 256-byte table, as their messages
+ * are a few bytes. All the tables take under 5 KiB, less than a third
+ * of the ARM926's 16 KiB data cache, and are filled on first use.
+ *
+ * The DShot checksum is three XORs of the frame (fagpio_dshot.h) and
+ * has no table.
+ */
+
+#define FAGPIO_CRC8_MAXIM_INIT		0x00	//1-Wire: x^8 + x^5 + x^4 + 1, reflected
+#define FAGPIO_CRC8_SENSIRION_INIT	0xFF	//SHT3x, SCD4x, SGP: poly 0x31
+#define FAGPIO_CRC7_INIT			0x00	//SD commands: x^7 + x^3 + 1
+#define FAGPIO_CRC16_MODBUS_INIT	0xFFFF	//Poly 0xA001 reflected
+#define FAGPIO_CRC16_CCITT_INIT		0x0000	//SD data blocks (XMODEM): poly 0x1021
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint8_t fagpio_crc8_maxim(uint8_t crc, const void *data, size_t len);
+uint8_t fagpio_crc8_sensirion(uint8_t crc, const void *data, size_t len);
+uint8_t fagpio_crc7(uint8_t crc, const void *data, size_t len);		//7 bits; an SD command ends with crc << 1 | 1
+uint16_t fagpio_crc16_modbus(uint16_t crc, const void *data, size_t len);
+uint16_t fagpio_crc16_ccitt(uint16_t crc, const void *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
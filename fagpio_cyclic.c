@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "fagpio_cyclic.h"
+#include "fagpio_log.h"
+
+static uint32_t gcd(uint32_t a, uint32_t b) {
+	while (b) {
+		uint32_t t = a % b;
+
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+/*
+Offsets are multiples of the minor frame too, so every release falls on
+a frame start: task i is in frame f when f * minor - offset is a
+multiple of its period.
+*/
+int fagpio_cyclic_build(struct fagpio_cyclic *c, struct fagpio_cyclic_task *tasks, unsigned int ntasks, uint32_t spin_ns) {
+	uint64_t major = 1;
+	uint32_t minor = 0;
+	unsigned int n = 0;
+
+	memset(c, 0, sizeof(*c));
+	if (!ntasks || ntasks > FAGPIO_CYCLIC_TASKS)
+		return -1;
+	for (unsigned int i = 0; i < ntasks; i++) {
+		if (!tasks[i].fn || !tasks[i].period_us || tasks[i].offset_us >= tasks[i].period_us) {
+			FAGPIO_LOG(FAGPIO_LOG_ERR, "Cyclic: task %u needs a function, a period and an offset below it\n", i);
+			return -1;
+		}
+		minor = gcd(gcd(minor, tasks[i].period_us), tasks[i].offset_us);
+		major = major / gcd(major, tasks[i].period_us) * tasks[i].period_us;
+		if (major > UINT32_MAX || major / minor > FAGPIO_CYCLIC_FRAMES) {
+			FAGPIO_LOG(FAGPIO_LOG_ERR, "Cyclic: over %u minor frames in the major frame\n", FAGPIO_CYCLIC_FRAMES);
+			return -1;
+		}
+		tasks[i].runs = 0;
+		tasks[i].worst = 0;
+	}
+	c->tasks = tasks;
+	c->ntasks = ntasks;
+	c->minor_us = minor;
+	c->major_us = major;
+	c->nframes = major / minor;
+	for (unsigned int f = 0; f < c->nframes; f++) {
+		uint64_t t = (uint64_t)f * minor;
+		uint32_t load = 0;
+
+		c->first[f] = n;
+		for (unsigned int i = 0; i < ntasks; i++) {
+			if (t < tasks[i].offset_us || (t - tasks[i].offset_us) % tasks[i].period_us)
+				continue;
+			if (n == FAGPIO_CYCLIC_SLOTS) {
+				FAGPIO_LOG(FAGPIO_LOG_ERR, "Cyclic: over %u releases in the major frame\n", FAGPIO_CYCLIC_SLOTS);
+				return -1;
+			}
+			c->slot[n++] = i;
+			load += tasks[i].wcet_us;
+		}
+		if (load > minor) {
+			FAGPIO_LOG(FAGPIO_LOG_ERR, "Cyclic: minor frame %u needs %u us of %u\n", f, load, minor);
+			return -1;
+		}
+		if (load > c->load_us)
+			c->load_us = load;
+	}
+	c->first[c->nframes] = n;
+	c->minor_ticks = (uint64_t)minor * fagpio_tick_hz / 1000000;
+	c->spin_ticks = fagpio_ns_to_ticks(spin_ns);
+	if (!c->minor_ticks || c->minor_ticks > 0x7FFFFFFF)
+		return -1;
+	FAGPIO_LOG(FAGPIO_LOG_DEBUG, "Cyclic: minor %u us, major %u us, %u releases, load %u us\n", minor, c->major_us, n, c->load_us);
+	return 0;
+}
+
+void fagpio_cyclic_dump(const struct fagpio_cyclic *c, int fd) {
+	dprintf(fd, "minor %u us, major %u us, %u frames, worst load %u us\n", c->minor_us, c->major_us, c->nframes, c->load_us);
+	for (unsigned int f = 0; f < c->nframes; f++) {
+		dprintf(fd, "%8u", f * c->minor_us);
+		for (unsigned int s = c->first[f]; s < c->first[f + 1]; s++) {
+			const struct fagpio_cyclic_task *t = &c->tasks[c->slot[s]];
+
+			if (t->name)
+				dprintf(fd, " %s", t->name);
+			else
+				dprintf(fd, " #%u", c->slot[s]);
+		}
+		dprintf(fd, "\n");
+	}
+}
+
+// Sleep, then spin, to the frame start; a late start is counted, never skipped
+static void wait_frame(struct fagpio_cyclic *c) {
+	int32_t left = c->deadline - fagpio_ticks();
+	uint32_t now;
+
+	while (left > (int32_t)c->spin_ticks) {
+		uint32_t ns = fagpio_ticks_to_ns(left - c->spin_ticks);
+		struct timespec ts = { ns / 1000000000, ns % 1000000000 };
+
+		nanosleep(&ts, NULL);
+		left = c->deadline - fagpio_ticks();
+	}
+	while ((int32_t)(c->deadline - (now = fagpio_ticks())) > 0)
+		;
+	if (now - c->deadline > c->worst_late)
+		c->worst_late = now - c->deadline;
+	if (left < 0)
+		c->late++;
+}
+
+int fagpio_cyclic_step(struct fagpio_cyclic *c) {
+	uint32_t start = c->first[c->frame], end = c->first[c->frame + 1];
+
+	if (!c->frames)
+		c->deadline = fagpio_ticks() + c->minor_ticks;
+	wait_frame(c);
+	for (uint32_t s = start; s < end; s++) {
+		struct fagpio_cyclic_task *t = &c->tasks[c->slot[s]];
+		uint32_t t0 = fagpio_ticks(), d;
+
+		t->fn(t->arg);
+		d = fagpio_ticks() - t0;
+		t->runs++;
+		if (d > t->worst)
+			t->worst = d;
+	}
+	c->deadline += c->minor_ticks;
+	c->frames++;
+	if (++c->frame == c->nframes)
+		c->frame = 0;
+	if ((int32_t)(fagpio_ticks() - c->deadline) > 0) {
+		c->overruns++;
+		return 1;
+	}
+	return 0;
+}
+
+void fagpio_cyclic_run(struct fagpio_cyclic *c) {
+	c->stop = 0;
+	while (!c->stop)
+		fagpio_cyclic_step(c);
+}
+
+void fagpio_cyclic_stop(struct fagpio_cyclic *c) {
+	c->stop = 1;
+}
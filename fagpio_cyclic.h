@@ -0,0 +1,86 @@
+#ifndef _FAGPIO_CYCLIC_H
+#define _FAGPIO_CYCLIC_H
+
+#include <stdint.h>
+#include "fagpio_timer.h"
+
+/*
+ * Cyclic executive: a static schedule of periodic tasks on one thread.
+ * fagpio_cyclic_build() takes the task table once, makes the minor frame
+ * the GCD of all periods and offsets and the major frame their LCM, and
+ * lists for every minor frame the tasks released in it, in table order.
+ * If the tasks give their worst-case execution times, the build also
+ * checks that no minor frame holds more work than its length.
+ *
+ * fagpio_cyclic_run() then only walks that table: each minor frame starts
+ * on an absolute deadline of the AVS counter (sleep, then spin, as in
+ * fagpio_periodic.h) and runs its tasks back to back. Nothing is decided
+ * at run time, so the timeline is the one fagpio_cyclic_dump() prints. A
+ * frame that starts late still runs all its tasks, and the next ones
+ * stay on the grid, catching up in the slack; late frames and frames
+ * running past their end are counted, like each task's longest run.
+ *
+ *	static struct fagpio_cyclic_task tasks[] = {
+ *		{ "adc", read_adc, NULL, 1000, 0, 200 },		//1 ms
+ *		{ "pid", control, NULL, 2000, 0, 300 },
+ *		{ "leds", leds, NULL, 10000, 500, 50 },		//10 ms, 0.5 ms in
+ *	};
+ *	fagpio_cyclic_build(&c, tasks, 3, 50000);		//Minor 0.5 ms, major 10 ms
+ *	fagpio_cyclic_run(&c);
+ */
+
+#define FAGPIO_CYCLIC_TASKS		32
+#ifndef FAGPIO_CYCLIC_FRAMES
+#define FAGPIO_CYCLIC_FRAMES	1024		//Minor frames per major frame
+#endif
+#ifndef FAGPIO_CYCLIC_SLOTS
+#define FAGPIO_CYCLIC_SLOTS		4096		//Task releases per major frame
+#endif
+
+struct fagpio_cyclic_task {
+	const char *name;
+	void (*fn)(void *arg);
+	void *arg;
+	uint32_t period_us;
+	uint32_t offset_us;		//First release after the major frame start, below period_us
+	uint32_t wcet_us;		//Worst-case run time for the build's check, 0 if unknown
+	uint32_t runs;			//Kept by the executive
+	uint32_t worst;			//Ticks of the longest run
+};
+
+struct fagpio_cyclic {
+	struct fagpio_cyclic_task *tasks;
+	unsigned int ntasks;
+	uint32_t minor_us, major_us;
+	uint32_t load_us;		//Largest sum of WCETs in one minor frame
+	uint32_t minor_ticks, spin_ticks;
+	uint32_t deadline;		//Start of the next minor frame
+	uint32_t frame;			//Its index in the major frame
+	uint32_t frames;		//Minor frames run
+	uint32_t late;			//Started after their deadline
+	uint32_t overruns;		//Ran past the start of the next one
+	uint32_t worst_late;	//Ticks
+	volatile int stop;
+	unsigned int nframes;
+	uint16_t first[FAGPIO_CYCLIC_FRAMES + 1];	//First slot of each minor frame
+	uint8_t slot[FAGPIO_CYCLIC_SLOTS];			//Task indices
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -1 if the table does not fit or a minor frame is overloaded; spin_ns as in fagpio_periodic_begin()
+int fagpio_cyclic_build(struct fagpio_cyclic *c, struct fagpio_cyclic_task *tasks, unsigned int ntasks, uint32_t spin_ns);
+void fagpio_cyclic_dump(const struct fagpio_cyclic *c, int fd);		//One line per minor frame
+
+// Waits for the next minor frame and runs it; the first call starts the major frame one minor frame later
+int fagpio_cyclic_step(struct fagpio_cyclic *c);		//1 if the frame overran
+void fagpio_cyclic_run(struct fagpio_cyclic *c);		//Steps until fagpio_cyclic_stop()
+void fagpio_cyclic_stop(struct fagpio_cyclic *c);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,330 @@
+#include <errno.h>
+#include <signal.h>
+#include <sched.h>
+#include <time.h>
+#include <linux/futex.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "fagpio_priv.h"
+#include "fagpio_daemon.h"
+#include "fagpio_atomic.h"
+#include "fagpio_log.h"
+
+#define FAGPIOD_IDLE_MS		1000		//Daemon sleep between dead-client sweeps
+#define FAGPIOD_SPIN		1000		//Polls of the mailbox before sleeping on it
+#define FAGPIOD_FULL_TRIES	100000		//Yields while a ring is full before giving up
+#define FAGPIOD_BACKEND_READ_MS	100
+
+// Shared (not FUTEX_PRIVATE) operations, the words live in a segment of several processes
+static int futex_wait(volatile uint32_t *word, uint32_t val, int timeout_ms) {
+	struct timespec ts = { timeout_ms / 1000, (timeout_ms % 1000) * 1000000L };
+
+	return syscall(SYS_futex, word, FUTEX_WAIT, val, timeout_ms < 0 ? NULL : &ts, NULL, 0);
+}
+
+static void futex_wake(volatile uint32_t *word) {
+	syscall(SYS_futex, word, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+pthread_mutex_t fagpio_server_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct fagpiod_shm *client_shm;
+static struct fagpiod_slot *client_slot;
+static uint32_t client_seq;
+
+int fagpiod_connect(const char *name) {
+	if (client_slot)
+		return 0;
+	if (!name)
+		name = FAGPIOD_SHM_NAME;
+
+	int fd = shm_open(name, O_RDWR, 0);
+
+	if (fd < 0) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "%s: %s, is fagpiod running?\n", name, strerror(errno));
+		return -1;
+	}
+
+	struct fagpiod_shm *s = mmap(NULL, sizeof(*s), PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+
+	close(fd);
+	if (s == MAP_FAILED)
+		return -1;
+	if (s->magic != FAGPIOD_MAGIC) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "%s is not a fagpiod segment\n", name);
+		munmap(s, sizeof(*s));
+		return -1;
+	}
+
+	uint32_t pid = getpid();
+
+	for (unsigned int i = 0; i < FAGPIOD_CLIENTS; i++) {
+		if (fagpio_cas(&s->slot[i].owner, 0, pid)) {
+			client_shm = s;
+			client_slot = &s->slot[i];
+			client_seq = client_slot->reply_seq;
+			return 0;
+		}
+	}
+	FAGPIO_LOG(FAGPIO_LOG_ERR, "fagpiod: all %u client slots taken\n", FAGPIOD_CLIENTS);
+	munmap(s, sizeof(*s));
+	return -1;
+}
+
+void fagpiod_disconnect(void) {
+	if (!client_slot)
+		return;
+	// The daemon frees the slot once the ring is drained, like for a dead client
+	for (int i = 0; i < FAGPIOD_FULL_TRIES && client_slot->tail != client_slot->head; i++)
+		sched_yield();
+	client_slot->owner = 0;
+	munmap(client_shm, sizeof(*client_shm));
+	client_shm = NULL;
+	client_slot = NULL;
+}
+
+static void doorbell(void) {
+	client_shm->doorbell++;
+	fagpio_barrier();
+	if (client_shm->sleeping)
+		futex_wake(&client_shm->doorbell);
+}
+
+static int push(uint8_t op, uint8_t port, uint8_t arg, uint32_t mask, uint32_t value) {
+	struct fagpiod_slot *s = client_slot;
+
+	if (!s || port >= PIO_NPORTS)
+		return -1;
+
+	uint32_t head = s->head;
+
+	for (int i = 0; head - s->tail == FAGPIOD_RING; i++) {
+		if (i == FAGPIOD_FULL_TRIES)
+			return -1;
+		doorbell();
+		sched_yield();
+	}
+
+	struct fagpiod_cmd *c = &s->cmd[head & (FAGPIOD_RING - 1)];
+
+	c->op = op;
+	c->port = port;
+	c->arg = arg;
+	c->mask = mask;
+	c->value = value;
+	fagpio_barrier();
+	s->head = head + 1;
+	doorbell();
+	return 0;
+}
+
+int fagpiod_write_port(uint8_t port, uint32_t mask, uint32_t value) {
+	return push(FAGPIOD_WRITE, port, 0, mask, value);
+}
+
+int fagpiod_toggle_port(uint8_t port, uint32_t mask) {
+	return push(FAGPIOD_TOGGLE, port, 0, mask, 0);
+}
+
+int fagpiod_write(uint8_t pin, uint8_t value) {
+	return push(FAGPIOD_WRITE, PIO_PIN_PORT(pin), 0, PIO_PIN_MASK(pin), value ? PIO_PIN_MASK(pin) : 0);
+}
+
+int fagpiod_mode(uint8_t pin, uint8_t mode) {
+	return push(FAGPIOD_MODE, PIO_PIN_PORT(pin), mode, PIO_PIN_MASK(pin), 0);
+}
+
+int fagpiod_pull(uint8_t pin, uint8_t pull) {
+	return push(FAGPIOD_PULL, PIO_PIN_PORT(pin), pull, PIO_PIN_MASK(pin), 0);
+}
+
+int64_t fagpiod_read_port(uint8_t port, int timeout_ms) {
+	uint32_t seq = ++client_seq;
+
+	if (push(FAGPIOD_READ, port, 0, 0, seq) < 0)
+		return -1;
+
+	volatile uint32_t *reply = &client_slot->reply_seq;
+
+	for (int i = 0; *reply != seq; i++) {
+		uint32_t now = *reply;
+
+		if (i < FAGPIOD_SPIN)
+			continue;
+		if (now != seq && futex_wait(reply, now, timeout_ms) < 0 && errno == ETIMEDOUT)
+			return -1;
+	}
+	fagpio_barrier();
+	return client_slot->reply_value;
+}
+
+/*
+FAGPIO_BACKEND=daemon: the Arduino-style calls of a client become
+commands on its slot, and a read waits up to FAGPIOD_BACKEND_READ_MS for
+the reply (0 when none came).
+*/
+int fagpio_daemon_open(void) {
+	return fagpiod_connect(NULL);
+}
+
+int fagpio_daemon_pin_mode(uint8_t port, uint32_t mask, int output) {
+	return push(FAGPIOD_MODE, port, output ? OUTPUT : INPUT, mask, 0);
+}
+
+int fagpio_daemon_write_port(uint8_t port, uint32_t mask, uint32_t value) {
+	return push(FAGPIOD_WRITE, port, 0, mask, value);
+}
+
+uint32_t fagpio_daemon_read_port(uint8_t port) {
+	int64_t v = fagpiod_read_port(port, FAGPIOD_BACKEND_READ_MS);
+
+	return v < 0 ? 0 : v;
+}
+
+void fagpio_daemon_close(void) {
+	fagpiod_disconnect();
+}
+
+// Daemon side: every drain pass folds each port's updates, see struct fagpio_coalesce
+static void flush_port(struct fagpiod_shm *s, struct fagpio_coalesce *p, uint8_t port) {
+	s->stores += fagpio_coalesce_flush(&p[port], port);
+}
+
+static void run_cmd(struct fagpiod_shm *s, struct fagpiod_slot *slot, struct fagpio_coalesce *p, const struct fagpiod_cmd *c) {
+	switch (c->op) {
+	case FAGPIOD_WRITE:
+		fagpio_coalesce_write(&p[c->port], c->mask, c->value);
+		break;
+	case FAGPIOD_TOGGLE:
+		fagpio_coalesce_toggle(&p[c->port], c->mask);
+		break;
+	case FAGPIOD_MODE:
+		flush_port(s, p, c->port);
+		pinModeMask(c->port, c->mask, c->arg);
+		break;
+	case FAGPIOD_PULL:
+		flush_port(s, p, c->port);
+		pinPullMask(c->port, c->mask, c->arg);
+		break;
+	case FAGPIOD_READ:
+		flush_port(s, p, c->port);
+		slot->reply_value = digitalReadPort(c->port);
+		fagpio_barrier();
+		slot->reply_seq = c->value;
+		futex_wake(&slot->reply_seq);
+		break;
+	}
+}
+
+// On the daemon's copy: the ring is client memory and may change under it
+static int cmd_valid(const struct fagpiod_cmd *c) {
+	if (c->port >= PIO_NPORTS || c->op > FAGPIOD_READ)
+		return 0;
+	if (c->op == FAGPIOD_MODE)
+		return c->arg <= INPUT;
+	if (c->op == FAGPIOD_PULL)
+		return c->arg <= PULL_DOWN;
+	return 1;
+}
+
+// One pass over every ring; returns the number of commands run
+static unsigned int drain(struct fagpiod_shm *s) {
+	struct fagpio_coalesce p[PIO_NPORTS] = { { 0 } };
+	unsigned int n = 0;
+
+	for (unsigned int i = 0; i < FAGPIOD_CLIENTS; i++) {
+		struct fagpiod_slot *slot = &s->slot[i];
+		uint32_t tail = slot->tail, head = slot->head;
+
+		if (tail == head)
+			continue;
+		if (head - tail > FAGPIOD_RING)
+			tail = head - FAGPIOD_RING;		//A client head no ring holds, run the last ring's worth
+		if (!n)
+			pthread_mutex_lock(&fagpio_server_lock);
+		fagpio_barrier();
+		for (; tail != head; tail++, n++) {
+			struct fagpiod_cmd cmd = *(volatile struct fagpiod_cmd *)&slot->cmd[tail & (FAGPIOD_RING - 1)];	//Read once
+
+			if (cmd_valid(&cmd))
+				run_cmd(s, slot, p, &cmd);
+		}
+		fagpio_barrier();
+		slot->tail = tail;
+	}
+	if (!n)
+		return 0;
+	for (uint8_t port = 0; port < PIO_NPORTS; port++)
+		flush_port(s, p, port);
+	pthread_mutex_unlock(&fagpio_server_lock);
+	s->batches++;
+	s->commands += n;
+	return n;
+}
+
+static int rings_empty(struct fagpiod_shm *s) {
+	for (unsigned int i = 0; i < FAGPIOD_CLIENTS; i++) {
+		if (s->slot[i].head != s->slot[i].tail)
+			return 0;
+	}
+	return 1;
+}
+
+static void reclaim(struct fagpiod_shm *s) {
+	for (unsigned int i = 0; i < FAGPIOD_CLIENTS; i++) {
+		struct fagpiod_slot *slot = &s->slot[i];
+		uint32_t pid = slot->owner;
+
+		if (pid && kill(pid, 0) < 0 && errno == ESRCH) {
+			slot->head = slot->tail = 0;
+			fagpio_cas(&slot->owner, pid, 0);
+		}
+	}
+}
+
+int fagpiod_serve(const char *name, mode_t mode, volatile int *stop) {
+	if (!fagpio_banks()) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "fagpiod: cannot map the PIO registers\n");
+		return -1;
+	}
+	if (!name)
+		name = FAGPIOD_SHM_NAME;
+
+	shm_unlink(name);		//A segment of an earlier daemon has stale rings
+
+	int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, mode);
+
+	if (fd < 0 || fchmod(fd, mode) < 0 || ftruncate(fd, sizeof(struct fagpiod_shm)) < 0) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "%s: %s\n", name, strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+
+	struct fagpiod_shm *s = mmap(NULL, sizeof(*s), PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+
+	close(fd);
+	if (s == MAP_FAILED)
+		return -1;
+	fagpio_barrier();
+	s->magic = FAGPIOD_MAGIC;
+
+	while (!*stop) {
+		uint32_t bell = s->doorbell;
+
+		if (drain(s))
+			continue;
+
+		// Announce the sleep, then look once more so a push in between is not missed
+		s->sleeping = 1;
+		fagpio_barrier();
+		if (rings_empty(s) && futex_wait(&s->doorbell, bell, FAGPIOD_IDLE_MS) < 0 && errno == ETIMEDOUT)
+			reclaim(s);		//Only when idle, a woken daemon drains first
+		s->sleeping = 0;
+	}
+
+	s->magic = 0;
+	munmap(s, sizeof(*s));
+	shm_unlink(name);
+	return 0;
+}
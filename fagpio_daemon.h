@@ -0,0 +1,85 @@
+#ifndef _FAGPIO_DAEMON_H
+#define _FAGPIO_DAEMON_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include "fagpio.h"
+#include "fagpio_ring.h"
+
+/*
+ * fagpiod (tools/fagpiod) owns the register mapping; clients need no
+ * /dev/mem access, only the permission of its /dev/shm segment. Each
+ * client claims one slot of the segment: a single-producer ring of port
+ * commands, plus a mailbox for read replies. A push rings the shared
+ * futex doorbell only when the daemon is asleep, so a busy daemon costs
+ * a client no syscall at all.
+ *
+ * The daemon drains every ring in one pass and folds each port's writes
+ * and toggles into a single DAT store. A mode, pull or read command
+ * first flushes what is pending for its port. Slots of clients that died
+ * are reclaimed.
+ */
+
+#define FAGPIOD_SHM_NAME	"/fagpiod"
+#define FAGPIOD_MAGIC		0x44474146		//"FAGD"
+#define FAGPIOD_CLIENTS		16
+#define FAGPIOD_RING		256				//Commands per client, power of two
+
+enum {
+	FAGPIOD_WRITE,			//DAT bits in mask := value
+	FAGPIOD_TOGGLE,			//DAT bits in mask inverted
+	FAGPIOD_MODE,			//pinModeMask(port, mask, arg)
+	FAGPIOD_PULL,			//pinPullMask(port, mask, arg)
+	FAGPIOD_READ,			//DAT of port into the slot's mailbox, seq in value
+};
+
+struct fagpiod_cmd {
+	uint8_t op;
+	uint8_t port;
+	uint8_t arg;
+	uint8_t pad;
+	uint32_t mask;
+	uint32_t value;
+};
+
+struct fagpiod_slot {
+	volatile uint32_t owner;				//Client pid, 0 if free
+	volatile uint32_t head __attribute__((aligned(FAGPIO_CACHE_LINE)));	//Client side
+	volatile uint32_t tail __attribute__((aligned(FAGPIO_CACHE_LINE)));	//Daemon side
+	volatile uint32_t reply_seq;
+	volatile uint32_t reply_value;
+	struct fagpiod_cmd cmd[FAGPIOD_RING] __attribute__((aligned(FAGPIO_CACHE_LINE)));
+};
+
+struct fagpiod_shm {
+	volatile uint32_t magic;
+	volatile uint32_t doorbell;				//Futex word, bumped by clients
+	volatile uint32_t sleeping;				//Daemon waits on the doorbell
+	uint32_t batches;						//Drain passes that found commands
+	uint32_t commands;
+	uint32_t stores;						//DAT stores after coalescing
+	struct fagpiod_slot slot[FAGPIOD_CLIENTS];
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Client side; NULL selects FAGPIOD_SHM_NAME. One connection per process
+int fagpiod_connect(const char *name);
+void fagpiod_disconnect(void);
+int fagpiod_write_port(uint8_t port, uint32_t mask, uint32_t value);
+int fagpiod_toggle_port(uint8_t port, uint32_t mask);
+int fagpiod_write(uint8_t pin, uint8_t value);
+int fagpiod_mode(uint8_t pin, uint8_t mode);
+int fagpiod_pull(uint8_t pin, uint8_t pull);
+int64_t fagpiod_read_port(uint8_t port, int timeout_ms);	//DAT after every earlier command, -1 on timeout
+
+// Daemon side: creates the segment with mode and serves until *stop
+int fagpiod_serve(const char *name, mode_t mode, volatile int *stop);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,41 @@
+#include <string.h>
+#include "fagpio_debounce.h"
+
+void fagpio_debounce_init(struct fagpio_debounce *db) {
+	memset(db, 0, sizeof(*db));
+}
+
+void fagpio_debounce_watch(struct fagpio_debounce *db, uint8_t port, uint32_t mask) {
+	if (port >= PIO_NPORTS)
+		return;
+
+	struct fagpio_debounce_port *p = &db->port[port];
+	uint32_t now = digitalReadPort(port);
+
+	p->state = (p->state & ~mask) | (now & mask);
+	p->cnt0 &= ~mask;
+	p->cnt1 &= ~mask;
+	p->mask |= mask;
+	if (p->mask)
+		db->ports |= 1u << port;
+}
+
+uint32_t fagpio_debounce_tick(struct fagpio_debounce *db, uint32_t changed[PIO_NPORTS]) {
+	uint32_t ports = 0;
+
+	for (uint8_t port = 0; port < PIO_NPORTS; port++) {
+		struct fagpio_debounce_port *p = &db->port[port];
+
+		changed[port] = 0;
+		if (!(db->ports & (1u << port)))
+			continue;
+
+		uint32_t toggle = fagpio_debounce_step(p, digitalReadPort(port));
+
+		if (toggle) {
+			changed[port] = toggle;
+			ports |= 1u << port;
+		}
+	}
+	return ports;
+}
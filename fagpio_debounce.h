@@ -0,0 +1,69 @@
+#ifndef _FAGPIO_DEBOUNCE_H
+#define _FAGPIO_DEBOUNCE_H
+
+#include <stdint.h>
+#include "fagpio.h"
+
+/*
+ * Debounce for many inputs at once. Each tick samples every watched port
+ * once with digitalReadPort() and runs a 2-bit vertical counter across all
+ * 32 pins in parallel: bit n of cnt0/cnt1 counts how many ticks pin n has
+ * disagreed with its debounced state, and the pin flips after
+ * FAGPIO_DEBOUNCE_TICKS disagreeing ticks in a row. Any agreeing sample
+ * resets the pin's count. The cost is a port read and six ALU ops per
+ * port, whatever the number of pins.
+ */
+
+#define FAGPIO_DEBOUNCE_TICKS	4
+
+struct fagpio_debounce_port {
+	uint32_t mask;		//Watched pins
+	uint32_t state;		//Debounced levels
+	uint32_t cnt0;
+	uint32_t cnt1;
+};
+
+struct fagpio_debounce {
+	uint32_t ports;		//Bit per watched port
+	struct fagpio_debounce_port port[PIO_NPORTS];
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void fagpio_debounce_init(struct fagpio_debounce *db);
+void fagpio_debounce_watch(struct fagpio_debounce *db, uint8_t port, uint32_t mask);	//Seeds the state from the pins
+
+/*
+ * Samples and debounces every watched port. changed[port] receives the
+ * pins whose debounced level flipped on this tick; the return value has a
+ * bit set for every port with a change.
+ */
+uint32_t fagpio_debounce_tick(struct fagpio_debounce *db, uint32_t changed[PIO_NPORTS]);
+
+/*
+ * One vertical counter step on a word sampled elsewhere (fagpio_keypad.h
+ * runs it per matrix row): returns the bits of mask that flipped state.
+ */
+static inline uint32_t fagpio_debounce_step(struct fagpio_debounce_port *p, uint32_t sample) {
+	uint32_t delta = (sample ^ p->state) & p->mask;
+	uint32_t toggle;
+
+	// Count 1, 2, 3 on disagreeing bits, clear on agreeing ones; the 4th wraps to 0 and flips
+	p->cnt1 = (p->cnt1 ^ p->cnt0) & delta;
+	p->cnt0 = ~p->cnt0 & delta;
+	toggle = delta & ~(p->cnt0 | p->cnt1);
+	p->state ^= toggle;
+	return toggle;
+}
+
+static inline uint32_t fagpio_debounce_state(const struct fagpio_debounce *db, uint8_t port) {
+	return db->port[port].state & db->port[port].mask;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
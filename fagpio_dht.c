@@ -0,0 +1,116 @@
+#include "fagpio_priv.h"
+#include "fagpio_dht.h"
+#include "fagpio_timer.h"
+
+#define DHT_START_US_DHT11		18000
+#define DHT_START_US_DHT22		1100
+#define DHT_CAPTURE_US			8000	//Response and 40 bits take at most about 5.5 ms
+#define DHT_INTERVAL_MS_DHT11	1000	//Minimum time between two reads
+#define DHT_INTERVAL_MS_DHT22	2000
+
+// Datasheet windows with margin, in microseconds
+#define DHT_LOW_MIN				30		//50 us before every bit, 80 us for the response
+#define DHT_LOW_MAX				100
+#define DHT_HIGH_MIN			12
+#define DHT_HIGH_MAX			100
+#define DHT_RESPONSE_MIN		50		//80 us high before the first bit
+#define DHT_RESPONSE_MAX		110
+
+int fagpio_dht_init(struct fagpio_dht *dht, uint8_t pin, uint8_t type) {
+	if (!fagpio_banks() || PIO_PIN_PORT(pin) >= PIO_NPORTS || (type != DHT11 && type != DHT22))
+		return -1;
+
+	dht->pin = pin;
+	dht->type = type;
+	dht->decicelsius = 0;
+	dht->permille = 0;
+	dht->rejected = 0;
+
+	fagpio_digital_write(fagpio_default(), pin, LOW);		//Open drain: DAT stays 0, the pull-up drives high
+	pinMode(pin, 1);
+	pinPull(pin, PULL_UP);
+	return 0;
+}
+
+static inline uint32_t phase_us(const struct fagpio_sample *s) {
+	return fagpio_ticks_to_ns(s[1].ticks - s[0].ticks) / 1000;
+}
+
+/*
+Every complete high phase is checked; the last 40 are the bits, and the
+one before them the sensor's response. An edge lost to preemption leaves
+the wrong number of phases or merges two of them into one that is too long.
+*/
+int fagpio_dht_decode(const struct fagpio_sample *samples, unsigned int count, uint8_t data[5]) {
+	uint32_t highs[DHT_SAMPLES / 2];
+	unsigned int nhigh = 0, first;
+
+	for (unsigned int i = 0; i + 1 < count; i++) {
+		uint32_t us = phase_us(&samples[i]);
+
+		if (samples[i].value) {
+			if (nhigh == DHT_SAMPLES / 2)
+				return -1;
+			highs[nhigh++] = us;
+		} else if (nhigh && (us < DHT_LOW_MIN || us > DHT_LOW_MAX)) {
+			return -1;		//Lows after the release: response, bit preambles, end
+		}
+	}
+	if (nhigh < 41)
+		return -1;
+	first = nhigh - 40;
+	if (highs[first - 1] < DHT_RESPONSE_MIN || highs[first - 1] > DHT_RESPONSE_MAX)
+		return -1;
+
+	memset(data, 0, 5);
+	for (unsigned int b = 0; b < 40; b++) {
+		uint32_t us = highs[first + b];
+
+		if (us < DHT_HIGH_MIN || us > DHT_HIGH_MAX)
+			return -1;
+		if (us > DHT_BIT_THRESHOLD_US)
+			data[b >> 3] |= 0x80 >> (b & 7);
+	}
+
+	if ((uint8_t)(data[0] + data[1] + data[2] + data[3]) != data[4])
+		return -1;
+	return 0;
+}
+
+static int read_once(struct fagpio_dht *dht) {
+	struct fagpio_sample samples[DHT_SAMPLES];
+	uint8_t data[5];
+	int n;
+
+	pinMode(dht->pin, 0);		//Start pulse
+	usleep(dht->type == DHT11 ? DHT_START_US_DHT11 : DHT_START_US_DHT22);
+	pinMode(dht->pin, 1);
+	n = fagpio_capture_edges(PIO_PIN_PORT(dht->pin), PIO_PIN_MASK(dht->pin), samples, DHT_SAMPLES,
+		fagpio_ns_to_ticks(DHT_CAPTURE_US * 1000));
+	if (n < 0 || fagpio_dht_decode(samples, n, data) < 0)
+		return -1;
+
+	if (dht->type == DHT11) {
+		dht->permille = data[0] * 10 + data[1] % 10;
+		dht->decicelsius = (data[2] & 0x7F) * 10 + data[3] % 10;
+		if (data[2] & 0x80)
+			dht->decicelsius = -dht->decicelsius;
+	} else {
+		dht->permille = (data[0] << 8) | data[1];
+		dht->decicelsius = ((data[2] & 0x7F) << 8) | data[3];
+		if (data[2] & 0x80)
+			dht->decicelsius = -dht->decicelsius;
+	}
+	return 0;
+}
+
+int fagpio_dht_read(struct fagpio_dht *dht, unsigned int attempts) {
+	for (unsigned int i = 0; i < attempts; i++) {
+		if (i)
+			usleep((dht->type == DHT11 ? DHT_INTERVAL_MS_DHT11 : DHT_INTERVAL_MS_DHT22) * 1000);
+		if (read_once(dht) == 0)
+			return 0;
+		dht->rejected++;
+	}
+	return -1;
+}
@@ -0,0 +1,47 @@
+#ifndef _FAGPIO_DHT_H
+#define _FAGPIO_DHT_H
+
+#include <stdint.h>
+#include "fagpio_capture.h"
+
+/*
+ * DHT11/DHT22 (AM2302) reader. After the start pulse the whole answer is
+ * recorded with fagpio_capture_edges() and only then classified, a bit
+ * being a 1 when its high phase is longer than DHT_BIT_THRESHOLD_US. A
+ * preemption during the capture shows up as a missing edge or as a phase
+ * outside the datasheet windows, so such reads are rejected before the
+ * checksum is even looked at, and fagpio_dht_read() tries again after the
+ * sensor's minimum read interval. An external pull-up is required.
+ */
+
+#define DHT11					11
+#define DHT22					22
+
+#define DHT_BIT_THRESHOLD_US	48		//0 is 26-28 us high, 1 is 70 us
+#define DHT_SAMPLES				96		//Initial state, response and 40 bits with margin
+
+struct fagpio_dht {
+	uint8_t pin;
+	uint8_t type;
+	int16_t decicelsius;
+	uint16_t permille;		//Relative humidity in 0.1 %
+	unsigned int rejected;	//Captures thrown away, including each retried one
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fagpio_dht_init(struct fagpio_dht *dht, uint8_t pin, uint8_t type);
+
+// 0 with decicelsius and permille updated, -1 when all attempts failed
+int fagpio_dht_read(struct fagpio_dht *dht, unsigned int attempts);
+
+// Classifies one capture of the pin into the 5 data bytes; -1 when it is damaged or the checksum fails
+int fagpio_dht_decode(const struct fagpio_sample *samples, unsigned int count, uint8_t data[5]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
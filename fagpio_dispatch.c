@@ -0,0 +1,55 @@
+#include "fagpio_dispatch.h"
+
+FAGPIO_CB_TABLE(handlers, FAGPIO_DISPATCH_MAX);
+
+static uint32_t watch[PIO_NPORTS];
+static uint32_t rise_mask[PIO_NPORTS];
+static uint32_t fall_mask[PIO_NPORTS];
+static uint32_t snapshot[PIO_NPORTS];
+
+int fagpio_dispatch_attach(uint8_t pin, uint8_t edge, fagpio_pin_cb cb, void *arg) {
+	uint8_t port = PIO_PIN_PORT(pin);
+	uint32_t mask = PIO_PIN_MASK(pin);
+
+	if (port >= PIO_NPORTS || !cb || (edge != RISING && edge != FALLING && edge != CHANGE))
+		return -1;
+
+	if (fagpio_cb_set(&handlers, pin, cb, arg) < 0)
+		return -1;
+	rise_mask[port] = (edge == FALLING) ? rise_mask[port] & ~mask : rise_mask[port] | mask;
+	fall_mask[port] = (edge == RISING) ? fall_mask[port] & ~mask : fall_mask[port] | mask;
+	snapshot[port] = (snapshot[port] & ~mask) | (digitalReadPort(port) & mask);
+	watch[port] |= mask;
+	return 0;
+}
+
+void fagpio_dispatch_detach(uint8_t pin) {
+	uint8_t port = PIO_PIN_PORT(pin);
+
+	if (port >= PIO_NPORTS)
+		return;
+	watch[port] &= ~PIO_PIN_MASK(pin);
+	fagpio_cb_clear(&handlers, pin);
+}
+
+int fagpio_dispatch_poll(void) {
+	int fired = 0;
+
+	for (uint8_t port = 0; port < PIO_NPORTS; port++) {
+		if (!watch[port])
+			continue;
+
+		uint32_t now = digitalReadPort(port);
+		uint32_t changed = (now ^ snapshot[port]) & watch[port];
+
+		snapshot[port] = now;
+		changed &= (now & rise_mask[port]) | (~now & fall_mask[port]);
+		while (changed) {
+			unsigned int n = 31 - __builtin_clz(changed);
+
+			changed &= ~(1u << n);
+			fired += fagpio_cb_call(&handlers, PIO_PIN(port, n), (now >> n) & 1);
+		}
+	}
+	return fired;
+}
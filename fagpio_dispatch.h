@@ -0,0 +1,31 @@
+#ifndef _FAGPIO_DISPATCH_H
+#define _FAGPIO_DISPATCH_H
+
+#include <stdint.h>
+#include "fagpio_callback.h"
+
+/*
+ * Change dispatcher. Callbacks live in a fixed table of
+ * FAGPIO_DISPATCH_MAX entries (fagpio_callback.h); every
+ * fagpio_dispatch_poll() reads each port with a watched pin once, XORs
+ * the sample with the previous snapshot and walks only the changed bits
+ * with CLZ, so unchanged pins cost nothing.
+ */
+
+#ifndef FAGPIO_DISPATCH_MAX
+#define FAGPIO_DISPATCH_MAX		32		//Pins with a callback
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fagpio_dispatch_attach(uint8_t pin, uint8_t edge, fagpio_pin_cb cb, void *arg);	//RISING, FALLING or CHANGE
+void fagpio_dispatch_detach(uint8_t pin);
+int fagpio_dispatch_poll(void);		//Returns the number of callbacks run
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
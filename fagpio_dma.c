@@ -0,0 +1,126 @@
+#include "fagpio_priv.h"
+#include "fagpio_dma.h"
+#include "fagpio_region.h"
+#include "fagpio_timer.h"
+#include "fagpio_atomic.h"
+#include "fagpio_log.h"
+
+#define NDMA_CFG_LOAD		(1u << 31)		//Start; reads 1 until the channel is done
+#define NDMA_CFG_CONT		(1u << 30)
+#define NDMA_CFG_WAIT(n)	((uint32_t)(n) << 27)
+#define NDMA_CFG_DST_W32	(2u << 25)
+#define NDMA_CFG_DST_IO		(1u << 21)		//Keep the destination address
+#define NDMA_CFG_DST_DRQ(t)	((uint32_t)(t) << 16)
+#define NDMA_CFG_SRC_W32	(2u << 9)
+#define NDMA_CFG_W8			0			//Source and destination widths of byte FIFOs
+#define NDMA_CFG_SRC_DRQ(t)	((uint32_t)(t) << 0)
+#define DMA_BUS_BIT			(1u << 6)
+
+#define PIO_DAT_PHYS(port)	(fagpio_region_phys(FAGPIO_REGION_PIO) + (port) * sizeof(struct pio_bank) + 0x10)
+
+static uint32_t started[FAGPIO_DMA_CHANNELS];	//fagpio_ticks() at the last start
+
+static volatile uint32_t *dma_regs(void) {
+	if (!fagpio_banks())
+		return NULL;
+	return fagpio_region(FAGPIO_REGION_DMA);
+}
+
+size_t fagpio_dma_wave_build(struct fagpio_dmabuf *buf, uint8_t port, uint32_t mask, const uint32_t *samples, size_t n, uint32_t repeat) {
+	size_t cap = buf->size / 4, words = 0;
+
+	if (port >= PIO_NPORTS || !buf->virt || !repeat)
+		return 0;
+
+	uint32_t rest = digitalReadPort(port) & ~mask;
+
+	for (size_t i = 0; i < n; i++) {
+		uint32_t word = rest | (samples[i] & mask);
+
+		for (uint32_t r = 0; r < repeat && words < cap; r++)
+			buf->virt[words++] = word;
+	}
+	return words;
+}
+
+int fagpio_dma_wave_start(uint8_t ch, uint8_t port, const struct fagpio_dmabuf *buf, size_t words, uint8_t drq, uint8_t wait, unsigned int flags) {
+	volatile uint32_t *dma = dma_regs();
+	volatile uint32_t *ccu = fagpio_region(FAGPIO_REGION_CCU);
+
+	if (!dma || !ccu || ch >= FAGPIO_DMA_CHANNELS || port >= PIO_NPORTS || drq > 0x1F || wait > FAGPIO_DMA_MAX_WAIT)
+		return -1;
+	if (!words || words > FAGPIO_DMA_MAX_WORDS || words * 4 > buf->size)
+		return -1;
+
+	ccu[rCCU_BUS_RST0 / 4] |= DMA_BUS_BIT;
+	ccu[rCCU_BUS_GATING0 / 4] |= DMA_BUS_BIT;
+
+	dma[rNDMA_CFG(ch) / 4] = 0;
+	dma[rDMA_INT_CTRL / 4] &= ~(3u << (ch * 2));
+	dma[rDMA_INT_STA / 4] = 3u << (ch * 2);
+	dma[rNDMA_SRC(ch) / 4] = buf->phys;
+	dma[rNDMA_DST(ch) / 4] = PIO_DAT_PHYS(port);
+	dma[rNDMA_BCNT(ch) / 4] = words * 4;
+
+	uint32_t cfg = NDMA_CFG_WAIT(wait) |
+		NDMA_CFG_DST_W32 | NDMA_CFG_DST_IO | NDMA_CFG_DST_DRQ(drq) |
+		NDMA_CFG_SRC_W32 | NDMA_CFG_SRC_DRQ(FAGPIO_DMA_DRQ_SDRAM);
+
+	if (flags & FAGPIO_DMA_LOOP)
+		cfg |= NDMA_CFG_CONT;
+	fagpio_barrier();		//Buffer stores before the channel starts reading
+	started[ch] = fagpio_ticks();
+	dma[rNDMA_CFG(ch) / 4] = cfg | NDMA_CFG_LOAD;
+	FAGPIO_LOG(FAGPIO_LOG_DEBUG, "DMA%u: %u words to P%c_DAT, drq %u\n", ch, (unsigned)words, 'A' + port, drq);
+	return 0;
+}
+
+int fagpio_dma_fifo_start(uint8_t ch, unsigned long src, unsigned long dst, size_t bytes, uint8_t drq) {
+	volatile uint32_t *dma = dma_regs();
+	volatile uint32_t *ccu = fagpio_region(FAGPIO_REGION_CCU);
+
+	if (!dma || !ccu || ch >= FAGPIO_DMA_CHANNELS || drq > 0x1F || !bytes || bytes > FAGPIO_DMA_MAX_WORDS * 4)
+		return -1;
+
+	ccu[rCCU_BUS_RST0 / 4] |= DMA_BUS_BIT;
+	ccu[rCCU_BUS_GATING0 / 4] |= DMA_BUS_BIT;
+	dma[rNDMA_CFG(ch) / 4] = 0;
+	dma[rDMA_INT_CTRL / 4] &= ~(3u << (ch * 2));
+	dma[rDMA_INT_STA / 4] = 3u << (ch * 2);
+	dma[rNDMA_SRC(ch) / 4] = src;
+	dma[rNDMA_DST(ch) / 4] = dst;
+	dma[rNDMA_BCNT(ch) / 4] = bytes;
+
+	fagpio_barrier();
+	started[ch] = fagpio_ticks();
+	dma[rNDMA_CFG(ch) / 4] = NDMA_CFG_W8 | NDMA_CFG_DST_IO | NDMA_CFG_DST_DRQ(drq) | NDMA_CFG_SRC_DRQ(FAGPIO_DMA_DRQ_SDRAM) | NDMA_CFG_LOAD;
+	return 0;
+}
+
+int fagpio_dma_wave_busy(uint8_t ch) {
+	volatile uint32_t *dma = dma_regs();
+
+	if (!dma || ch >= FAGPIO_DMA_CHANNELS)
+		return 0;
+	return (dma[rNDMA_CFG(ch) / 4] & NDMA_CFG_LOAD) ? 1 : 0;
+}
+
+int32_t fagpio_dma_wave_wait(uint8_t ch, uint32_t timeout_ticks) {
+	if (ch >= FAGPIO_DMA_CHANNELS)
+		return -1;
+
+	while (fagpio_dma_wave_busy(ch)) {
+		if (fagpio_ticks() - started[ch] > timeout_ticks)
+			return -1;
+	}
+	return (int32_t)(fagpio_ticks() - started[ch]);
+}
+
+void fagpio_dma_wave_stop(uint8_t ch) {
+	volatile uint32_t *dma = dma_regs();
+
+	if (!dma || ch >= FAGPIO_DMA_CHANNELS)
+		return;
+	dma[rNDMA_CFG(ch) / 4] = 0;
+	dma[rDMA_INT_STA / 4] = 3u << (ch * 2);
+}
@@ -0,0 +1,60 @@
+#ifndef _FAGPIO_DMA_H
+#define _FAGPIO_DMA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fagpio_dmabuf.h"
+
+/*
+ * GPIO waveform playback on a normal DMA channel of the DMA controller
+ * (0x01C02000, mapped with fagpio_region()). The channel copies a buffer
+ * of whole DAT words to one port's DAT register with no CPU time, so
+ * kernel ticks cannot stretch any step. fagpio_dma_wave_build() merges
+ * the samples with the current level of the port's other pins.
+ *
+ * Pacing: with FAGPIO_DMA_DRQ_SDRAM the channel runs free, one word per
+ * burst plus wait states, at a rate fixed by the bus clocks; measure it
+ * once with fagpio_dma_wave_wait() and repeat samples to slow it down.
+ * Any other DRQ paces the stores by that peripheral's request line, which
+ * keeps requesting only while the peripheral itself consumes data. Do not
+ * use a channel the kernel dma driver owns.
+ */
+
+#define rDMA_INT_CTRL		0x000
+#define rDMA_INT_STA		0x004
+#define rNDMA_CFG(ch)		(0x100 + (ch) * 0x20)
+#define rNDMA_SRC(ch)		(0x104 + (ch) * 0x20)
+#define rNDMA_DST(ch)		(0x108 + (ch) * 0x20)
+#define rNDMA_BCNT(ch)		(0x10C + (ch) * 0x20)
+
+#define rCCU_BUS_GATING0	0x060	//DMA bit 6
+#define rCCU_BUS_RST0		0x2C0
+
+#define FAGPIO_DMA_CHANNELS		4
+#define FAGPIO_DMA_DRQ_SDRAM	0x11		//Memory side: always ready
+#define FAGPIO_DMA_MAX_WORDS	(0x20000 / 4)	//128 KB byte counter
+#define FAGPIO_DMA_MAX_WAIT		7
+
+#define FAGPIO_DMA_LOOP			(1u << 0)	//Replay the buffer until fagpio_dma_wave_stop()
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Fills buf with n samples, each repeated repeat times: the pins in mask from the sample, the rest as they are now; words written
+size_t fagpio_dma_wave_build(struct fagpio_dmabuf *buf, uint8_t port, uint32_t mask, const uint32_t *samples, size_t n, uint32_t repeat);
+
+// Streams the first words of buf to the DAT register of port; wait is 0-7
+int fagpio_dma_wave_start(uint8_t ch, uint8_t port, const struct fagpio_dmabuf *buf, size_t words, uint8_t drq, uint8_t wait, unsigned int flags);
+// Bytes from src (a bus address) into a peripheral FIFO at dst, one per request of its DRQ; ends like a waveform
+int fagpio_dma_fifo_start(uint8_t ch, unsigned long src, unsigned long dst, size_t bytes, uint8_t drq);
+
+int fagpio_dma_wave_busy(uint8_t ch);
+int32_t fagpio_dma_wave_wait(uint8_t ch, uint32_t timeout_ticks);	//Ticks the playback took since its start, -1 on timeout
+void fagpio_dma_wave_stop(uint8_t ch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
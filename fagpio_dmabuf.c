@@ -0,0 +1,258 @@
+#include <errno.h>
+#include <pthread.h>
+#include "fagpio_priv.h"
+#include "fagpio_dmabuf.h"
+#include "fagpio_log.h"
+
+int fagpio_dmabuf_map(struct fagpio_dmabuf *buf, unsigned long phys, size_t size) {
+	memset(buf, 0, sizeof(*buf));
+	if (!size || (phys & 3) || !fagpio_banks())
+		return -1;
+	if (gpio.backend != FAGPIO_BACKEND_DEVMEM) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "DMA buffers need the /dev/mem backend\n");
+		return -1;
+	}
+
+	unsigned long page = sysconf(_SC_PAGESIZE);
+	unsigned long base = phys & ~(page - 1);
+	size_t map_size = (phys - base + size + page - 1) & ~(page - 1);
+	void *map = mmap(NULL, map_size, PROT_READ|PROT_WRITE, MAP_SHARED, gpio.mem_fd, base);
+
+	if (map == MAP_FAILED) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "DMA buffer at %08lX: mmap failed\n", phys);
+		return -1;
+	}
+
+	buf->virt = (volatile uint32_t *)((unsigned char *)map + (phys - base));
+	buf->phys = phys;
+	buf->size = size;
+	buf->map = map;
+	buf->map_size = map_size;
+	return 0;
+}
+
+void fagpio_dmabuf_unmap(struct fagpio_dmabuf *buf) {
+	if (buf->map)
+		munmap(buf->map, buf->map_size);
+	memset(buf, 0, sizeof(*buf));
+}
+
+struct pool_extent {
+	size_t off;
+	size_t size;
+};
+
+static struct {
+	void *map;
+	size_t map_size;
+	unsigned char *virt;			//Start of the usable range inside map
+	unsigned long phys;
+	size_t size;
+	int fd;							//u-dma-buf device, -1 for /dev/mem
+	unsigned int used;
+	struct pool_extent ext[FAGPIO_DMAPOOL_MAX];	//Allocated buffers sorted by offset
+} pool = { .fd = -1 };
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// First line of /sys/class/<class>/<name>/<attr> as a number
+static int udmabuf_attr(const char *name, const char *attr, unsigned long *value) {
+	static const char *classes[] = { "u-dma-buf", "udmabuf" };
+	char path[128];
+
+	for (unsigned int i = 0; i < sizeof(classes) / sizeof(classes[0]); i++) {
+		snprintf(path, sizeof(path), "/sys/class/%s/%s/%s", classes[i], name, attr);
+
+		int fd = open(path, O_RDONLY);
+
+		if (fd < 0)
+			continue;
+
+		char line[32], *end;
+		ssize_t n = read(fd, line, sizeof(line) - 1);
+
+		close(fd);
+		if (n <= 0)
+			return -1;
+		line[n] = '\0';
+		*value = strtoul(line, &end, 0);		//phys_addr is 0x-prefixed, size decimal
+		return end != line ? 0 : -1;
+	}
+	return -1;
+}
+
+static int pool_map_udmabuf(const char *name) {
+	unsigned long phys, size;
+	char path[64];
+
+	if (udmabuf_attr(name, "phys_addr", &phys) < 0 || udmabuf_attr(name, "size", &size) < 0) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "%s: no u-dma-buf device\n", name);
+		return -1;
+	}
+
+	snprintf(path, sizeof(path), "/dev/%s", name);
+
+	int fd = open(path, O_RDWR | O_SYNC);		//O_SYNC: uncached, like /dev/mem
+
+	if (fd < 0) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "%s: %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	void *map = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+
+	if (map == MAP_FAILED) {
+		close(fd);
+		return -1;
+	}
+	pool.map = pool.virt = map;
+	pool.map_size = pool.size = size;
+	pool.phys = phys;
+	pool.fd = fd;
+	return 0;
+}
+
+static int pool_map_reserved(unsigned long phys, size_t size) {
+	struct fagpio_dmabuf whole;
+
+	if (fagpio_dmabuf_map(&whole, phys, size) < 0)
+		return -1;
+	pool.map = whole.map;
+	pool.map_size = whole.map_size;
+	pool.virt = (unsigned char *)whole.virt;
+	pool.phys = phys;
+	pool.size = size;
+	return 0;
+}
+
+static int pool_open_locked(const char *spec) {
+	if (pool.map)
+		return 0;
+	if (!spec)
+		spec = getenv("FAGPIO_DMA_POOL");
+	if (!spec || !*spec) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "No DMA pool, set FAGPIO_DMA_POOL\n");
+		return -1;
+	}
+
+	if (spec[0] >= '0' && spec[0] <= '9') {
+		char *end;
+		unsigned long phys = strtoul(spec, &end, 0);
+		unsigned long size = (*end == ':') ? strtoul(end + 1, &end, 0) : 0;
+
+		if (*end || !size) {
+			FAGPIO_LOG(FAGPIO_LOG_ERR, "Bad DMA pool \"%s\", want phys:size\n", spec);
+			return -1;
+		}
+		if (pool_map_reserved(phys, size) < 0)
+			return -1;
+	} else if (pool_map_udmabuf(spec) < 0)
+		return -1;
+
+	pool.used = 0;
+	FAGPIO_LOG(FAGPIO_LOG_INFO, "DMA pool: %lu bytes at %08lX\n", (unsigned long)pool.size, pool.phys);
+	return 0;
+}
+
+int fagpio_dmapool_open(const char *spec) {
+	int ret;
+
+	pthread_mutex_lock(&pool_lock);
+	ret = pool_open_locked(spec);
+	pthread_mutex_unlock(&pool_lock);
+	return ret;
+}
+
+void fagpio_dmapool_close(void) {
+	pthread_mutex_lock(&pool_lock);
+	if (pool.map)
+		munmap(pool.map, pool.map_size);
+	if (pool.fd >= 0)
+		close(pool.fd);
+	memset(&pool, 0, sizeof(pool));
+	pool.fd = -1;
+	pthread_mutex_unlock(&pool_lock);
+}
+
+static size_t align_up(size_t x) {
+	return (x + FAGPIO_DMAPOOL_ALIGN - 1) & ~(size_t)(FAGPIO_DMAPOOL_ALIGN - 1);
+}
+
+// Start of the gap in front of extent i (i == used for the tail); the gap ends at ext[i].off
+static size_t gap_start(unsigned int i) {
+	return i ? align_up(pool.ext[i - 1].off + pool.ext[i - 1].size) : 0;
+}
+
+static size_t gap_end(unsigned int i) {
+	return i < pool.used ? pool.ext[i].off : pool.size & ~(size_t)(FAGPIO_DMAPOOL_ALIGN - 1);
+}
+
+size_t fagpio_dmapool_avail(void) {
+	size_t best = 0;
+
+	pthread_mutex_lock(&pool_lock);
+	if (pool.map && pool.used < FAGPIO_DMAPOOL_MAX) {
+		for (unsigned int i = 0; i <= pool.used; i++) {
+			size_t start = gap_start(i), end = gap_end(i);
+
+			if (end > start && end - start > best)
+				best = end - start;
+		}
+	}
+	pthread_mutex_unlock(&pool_lock);
+	return best;
+}
+
+// First fit; the carved buffer has the same uncached mapping as the pool
+int fagpio_dmabuf_alloc(struct fagpio_dmabuf *buf, size_t size) {
+	int ret = -1;
+
+	memset(buf, 0, sizeof(*buf));
+	if (!size)
+		return -1;
+
+	pthread_mutex_lock(&pool_lock);
+	if (pool_open_locked(NULL) == 0 && pool.used < FAGPIO_DMAPOOL_MAX) {
+		for (unsigned int i = 0; i <= pool.used; i++) {
+			size_t start = gap_start(i), end = gap_end(i);
+
+			if (end < start || end - start < size)
+				continue;
+			memmove(&pool.ext[i + 1], &pool.ext[i], (pool.used - i) * sizeof(pool.ext[0]));
+			pool.ext[i].off = start;
+			pool.ext[i].size = size;
+			pool.used++;
+			buf->virt = (volatile uint32_t *)(pool.virt + start);
+			buf->phys = pool.phys + start;
+			buf->size = size;
+			ret = 0;
+			break;
+		}
+		if (ret < 0)
+			FAGPIO_LOG(FAGPIO_LOG_ERR, "DMA pool: no room for %lu bytes\n", (unsigned long)size);
+	}
+	pthread_mutex_unlock(&pool_lock);
+	return ret;
+}
+
+void fagpio_dmabuf_free(struct fagpio_dmabuf *buf) {
+	if (buf->map) {
+		fagpio_dmabuf_unmap(buf);
+		return;
+	}
+
+	pthread_mutex_lock(&pool_lock);
+	if (pool.map && buf->virt) {
+		size_t off = (unsigned char *)buf->virt - pool.virt;
+
+		for (unsigned int i = 0; i < pool.used; i++) {
+			if (pool.ext[i].off != off)
+				continue;
+			pool.used--;
+			memmove(&pool.ext[i], &pool.ext[i + 1], (pool.used - i) * sizeof(pool.ext[0]));
+			break;
+		}
+	}
+	pthread_mutex_unlock(&pool_lock);
+	memset(buf, 0, sizeof(*buf));
+}
@@ -0,0 +1,48 @@
+#ifndef _FAGPIO_DMABUF_H
+#define _FAGPIO_DMABUF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * DMA buffers: physically contiguous memory the CPU reaches through virt
+ * and the DMA controller through phys. The memory must be kept away from
+ * the kernel (a reserved-memory node or mem= on the command line); it is
+ * mapped uncached through the /dev/mem fd of fagpio_setup(), so no cache
+ * maintenance is needed before a transfer.
+ *
+ * The pool maps one such range once and carves buffers out of it, so
+ * repeated uploads do not remap. Its backing comes from FAGPIO_DMA_POOL
+ * or fagpio_dmapool_open(): "0x83000000:0x100000" is a reserved range
+ * reached through /dev/mem, "udmabuf0" is a u-dma-buf device, which also
+ * works with the UIO backend.
+ */
+struct fagpio_dmabuf {
+	volatile uint32_t *virt;
+	unsigned long phys;			//Bus address of virt[0]
+	size_t size;				//Bytes
+	void *map;					//Page-aligned mapping behind virt, NULL for pool buffers
+	size_t map_size;
+};
+
+#define FAGPIO_DMAPOOL_MAX		32			//Buffers allocated at once
+#define FAGPIO_DMAPOOL_ALIGN	32			//Start of every pool buffer, one cache line
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fagpio_dmabuf_map(struct fagpio_dmabuf *buf, unsigned long phys, size_t size);
+void fagpio_dmabuf_unmap(struct fagpio_dmabuf *buf);
+
+int fagpio_dmapool_open(const char *spec);		//NULL reads FAGPIO_DMA_POOL
+void fagpio_dmapool_close(void);				//Buffers still allocated become invalid
+size_t fagpio_dmapool_avail(void);				//Largest buffer that can be allocated now
+int fagpio_dmabuf_alloc(struct fagpio_dmabuf *buf, size_t size);	//Opens the pool on first use
+void fagpio_dmabuf_free(struct fagpio_dmabuf *buf);	//Pool buffers and fagpio_dmabuf_map() ones alike
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
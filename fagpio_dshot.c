@@ -0,0 +1,82 @@
+#include <string.h>
+#include "fagpio.h"
+#include "fagpio_dshot.h"
+#include "fagpio_timer.h"
+#include "fagpio_transpose.h"
+
+int fagpio_dshot_init(struct fagpio_dshot *d, uint8_t first_pin, uint8_t motors, uint32_t kbit) {
+	uint8_t port = PIO_PIN_PORT(first_pin);
+
+	if (port >= PIO_NPORTS || !motors || motors > 8 || PIO_PIN_NUM(first_pin) + motors > 32 || !kbit)
+		return -1;
+	if (fagpio_setup() < 0)
+		return -1;
+
+	d->port = port;
+	d->shift = PIO_PIN_NUM(first_pin);
+	d->motors = motors;
+	d->mask = ((1u << motors) - 1) << d->shift;
+	d->kbit = kbit;
+	d->nops = 0;
+
+	digitalWritePort(port, d->mask, 0);
+	pinModeMask(port, d->mask, OUTPUT);
+	return 0;
+}
+
+// Tick of eighth n of the frame, rounded from absolute time; the frame starts one bit in
+static uint32_t eighth_tick(const struct fagpio_dshot *d, uint32_t n) {
+	return (uint32_t)(((uint64_t)(n + 8) * fagpio_tick_hz + d->kbit * 4000) / (d->kbit * 8000));
+}
+
+int fagpio_dshot_compile(struct fagpio_dshot *d, const uint16_t *values, uint32_t telemetry) {
+	struct fagpio_seq seq;
+	uint16_t frame[8];
+
+	for (unsigned int m = 0; m < d->motors; m++)
+		frame[m] = fagpio_dshot_frame(values[m], (telemetry >> m) & 1);
+	// High bytes give the first eight slots, low bytes the last eight
+	uint8_t hi[8] = { 0 }, lo[8] = { 0 };
+
+	for (unsigned int m = 0; m < d->motors; m++) {
+		hi[m] = frame[m] >> 8;
+		lo[m] = frame[m];
+	}
+	memset(d->slots, 0, sizeof(d->slots));
+	fagpio_transpose8_slots(hi, d->slots, d->shift);
+	fagpio_transpose8_slots(lo, d->slots + 8, d->shift);
+
+	fagpio_seq_init(&seq, d->ops, FAGPIO_DSHOT_OPS);
+	for (unsigned int i = 0; i < DSHOT_BITS; i++) {
+		if (fagpio_seq_add(&seq, d->port, d->mask, d->mask, eighth_tick(d, 8 * i) - seq.end) < 0 ||
+			fagpio_seq_add(&seq, d->port, d->mask, d->slots[i], eighth_tick(d, 8 * i + 3) - seq.end) < 0 ||
+			fagpio_seq_add(&seq, d->port, d->mask, 0, eighth_tick(d, 8 * i + 6) - seq.end) < 0)
+			return -1;
+	}
+	d->nops = seq.count;
+	return 0;
+}
+
+int fagpio_dshot_send(struct fagpio_dshot *d) {
+	return fagpio_seq_play_ops(d->ops, d->nops, fagpio_ticks());
+}
+
+size_t fagpio_dshot_dma_build(const struct fagpio_dshot *d, struct fagpio_dmabuf *buf, uint32_t words_per_eighth) {
+	size_t words = (size_t)DSHOT_BITS * 8 * words_per_eighth + 1, n = 0;
+
+	if (!buf->virt || !words_per_eighth || words * 4 > buf->size)
+		return 0;
+
+	uint32_t low = digitalReadPort(d->port) & ~d->mask;
+
+	for (unsigned int i = 0; i < DSHOT_BITS; i++) {
+		for (unsigned int e = 0; e < 8; e++) {
+			uint32_t word = e < 3 ? low | d->mask : e < 6 ? low | d->slots[i] : low;
+
+			for (uint32_t w = 0; w < words_per_eighth; w++)
+				buf->virt[n++] = word;
+		}
+	}
+	buf->virt[n++] = low;
+	return n;
+}
@@ -0,0 +1,67 @@
+#ifndef _FAGPIO_DSHOT_H
+#define _FAGPIO_DSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fagpio_dmabuf.h"
+#include "fagpio_seq.h"
+
+/*
+ * DShot ESC output for 1 to 8 motors on consecutive pins of one port,
+ * sent in parallel like the WS2812 strips (fagpio_ws2812.h): the 16-bit
+ * frames are transposed into one word per bit holding the motors that
+ * send a 1, so a bit is three whole-port stores for every motor at once,
+ * all high, 0-bit motors low at 37.5%, the rest low at 75%. Every motor
+ * updates in one frame time, 26.7 us at DShot600.
+ *
+ * fagpio_dshot_compile() builds both the slots and the sequencer ops
+ * (fagpio_seq.h) on absolute bit boundaries; fagpio_dshot_send() plays
+ * them, best from fagpio_rt_enter() (fagpio_rt.h). For no CPU timing at
+ * all, fagpio_dshot_dma_build() expands the slots into DAT words for a
+ * DMA channel running free (fagpio_dma.h), 8 * n words per bit with n
+ * from the channel's measured word rate, for fagpio_dma_wave_start().
+ */
+
+#define DSHOT150				150		//kbit/s
+#define DSHOT300				300
+#define DSHOT600				600
+
+#define DSHOT_BITS				16
+#define DSHOT_CMD_MAX			47		//Values 1-47 are commands, 48-2047 throttle
+#define FAGPIO_DSHOT_OPS		(3 * DSHOT_BITS + 1)
+
+struct fagpio_dshot {
+	uint8_t port;
+	uint8_t shift;				//Number of the first motor pin
+	uint8_t motors;
+	uint32_t mask;				//All motor pins
+	uint32_t kbit;
+	uint32_t slots[DSHOT_BITS];	//Motor pins sending a 1, MSB first
+	struct fagpio_seq_op ops[FAGPIO_DSHOT_OPS];
+	unsigned int nops;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fagpio_dshot_init(struct fagpio_dshot *d, uint8_t first_pin, uint8_t motors, uint32_t kbit);
+
+// 11-bit value, telemetry request bit and the 4-bit CRC
+static inline uint16_t fagpio_dshot_frame(uint16_t value, int telemetry) {
+	uint16_t v = (uint16_t)((value & 0x7FF) << 1 | (telemetry ? 1 : 0));
+
+	return (uint16_t)(v << 4 | ((v ^ v >> 4 ^ v >> 8) & 0xF));
+}
+
+// values[m] for motor m; bit m of telemetry requests telemetry from it
+int fagpio_dshot_compile(struct fagpio_dshot *d, const uint16_t *values, uint32_t telemetry);
+int fagpio_dshot_send(struct fagpio_dshot *d);		//Returns the number of late stores
+
+size_t fagpio_dshot_dma_build(const struct fagpio_dshot *d, struct fagpio_dmabuf *buf, uint32_t words_per_eighth);	//Words, 0 if buf is too small
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
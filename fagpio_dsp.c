@@ -0,0 +1,131 @@
+#include <string.h>
+#include "fagpio_priv.h"
+#include "fagpio_dsp.h"
+#include "fagpio_la.h"
+
+int fagpio_fir_init(struct fagpio_fir *f, const int16_t *coef, unsigned int taps, unsigned int decim) {
+	if (!coef || !taps || taps > FAGPIO_FIR_MAX_TAPS || !decim)
+		return -1;
+
+	memset(f, 0, sizeof(*f));
+	f->coef = coef;
+	f->taps = taps;
+	f->decim = decim;
+	return 0;
+}
+
+// One SMLABB per tap over the contiguous window; outputs only on the decimation phase
+FAGPIO_ARM_CODE size_t fagpio_fir_process(struct fagpio_fir *f, const int16_t *in, size_t n, int16_t *out) {
+	const int16_t *coef = f->coef;
+	unsigned int taps = f->taps, pos = f->pos, phase = f->phase;
+	size_t produced = 0;
+
+	for (size_t i = 0; i < n; i++) {
+		pos = pos ? pos - 1 : taps - 1;
+		f->hist[pos] = f->hist[pos + taps] = in[i];
+		if (++phase < f->decim)
+			continue;
+		phase = 0;
+
+		const int16_t *x = &f->hist[pos];
+		int32_t acc = 1 << 14;		//Rounds the Q15 result
+
+		for (unsigned int k = 0; k < taps; k++)
+			acc = fagpio_smlabb(coef[k], x[k], acc);
+		out[produced++] = fagpio_sat16(acc >> 15);
+	}
+	f->pos = pos;
+	f->phase = phase;
+	return produced;
+}
+
+int fagpio_cic_init(struct fagpio_cic *c, unsigned int order, uint32_t decim) {
+	uint64_t gain = 1;
+
+	if (!order || order > FAGPIO_CIC_MAX_ORDER || decim < 2)
+		return -1;
+	for (unsigned int i = 0; i < order; i++)
+		gain *= decim;
+	if (gain > (1u << 31))
+		return -1;
+
+	memset(c, 0, sizeof(*c));
+	c->order = order;
+	c->decim = decim;
+	return 0;
+}
+
+// Integrators on every input; on each decim-th the combs turn it into one output
+static inline int cic_step(struct fagpio_cic *c, uint32_t x, int32_t *out) {
+	for (unsigned int s = 0; s < c->order; s++)
+		x = c->integ[s] += x;
+	if (++c->phase < c->decim)
+		return 0;
+	c->phase = 0;
+	for (unsigned int s = 0; s < c->order; s++) {
+		uint32_t y = x - c->comb[s];
+
+		c->comb[s] = x;
+		x = y;
+	}
+	*out = (int32_t)x;
+	return 1;
+}
+
+FAGPIO_ARM_CODE size_t fagpio_cic_process(struct fagpio_cic *c, const int16_t *in, size_t n, int32_t *out) {
+	size_t produced = 0;
+
+	for (size_t i = 0; i < n; i++)
+		produced += cic_step(c, (uint32_t)(int32_t)in[i], &out[produced]);
+	return produced;
+}
+
+// Runs go through the integrators sample by sample but are never expanded in memory
+FAGPIO_ARM_CODE size_t fagpio_cic_runs(struct fagpio_cic *c, const struct fagpio_la_run *runs, size_t nruns, uint32_t mask, int32_t *out) {
+	size_t produced = 0;
+
+	for (size_t r = 0; r < nruns; r++) {
+		uint32_t bit = (runs[r].value & mask) != 0;
+
+		for (uint32_t i = 0; i < runs[r].count; i++)
+			produced += cic_step(c, bit, &out[produced]);
+	}
+	return produced;
+}
+
+void fagpio_biquad_init(struct fagpio_biquad *q, const int16_t coef[5]) {
+	memset(q, 0, sizeof(*q));
+	q->b0 = coef[0];
+	q->b1 = coef[1];
+	q->b2 = coef[2];
+	q->a1 = coef[3];
+	q->a2 = coef[4];
+}
+
+// Each product fits 31 bits; QADD keeps their sum from wrapping
+FAGPIO_ARM_CODE void fagpio_biquad_process(struct fagpio_biquad *q, const int16_t *in, int16_t *out, size_t n) {
+	int32_t b0 = q->b0, b1 = q->b1, b2 = q->b2, na1 = -q->a1, na2 = -q->a2;
+	int32_t x1 = q->x1, x2 = q->x2, y1 = q->y1, y2 = q->y2;
+
+	for (size_t i = 0; i < n; i++) {
+		int32_t x = in[i], acc = 1 << 13;
+
+		acc = fagpio_qadd(acc, fagpio_smulbb(b0, x));
+		acc = fagpio_qadd(acc, fagpio_smulbb(b1, x1));
+		acc = fagpio_qadd(acc, fagpio_smulbb(b2, x2));
+		acc = fagpio_qadd(acc, fagpio_smulbb(na1, y1));
+		acc = fagpio_qadd(acc, fagpio_smulbb(na2, y2));
+
+		int16_t y = fagpio_sat16(acc >> 14);
+
+		x2 = x1;
+		x1 = x;
+		y2 = y1;
+		y1 = y;
+		out[i] = y;
+	}
+	q->x1 = x1;
+	q->x2 = x2;
+	q->y1 = y1;
+	q->y2 = y2;
+}
@@ -0,0 +1,115 @@
+#ifndef _FAGPIO_DSP_H
+#define _FAGPIO_DSP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Fixed-point filters for decimating sampled data on the board: FIR (Q15
+ * taps, optionally decimating), CIC decimators over 16-bit samples or over
+ * one pin of a logic-analyzer run stream (fagpio_la.h) without expanding
+ * it, and IIR biquads (Q14 coefficients, direct form I).
+ *
+ * The ARM926EJ-S has the ARMv5TE DSP multiplies: SMULBB/SMLABB do a
+ * 16x16 multiply (and accumulate) in one instruction, QADD a saturating
+ * add. The primitives below use them through inline assembly when the
+ * compiler reports them (__ARM_FEATURE_DSP, ARM state) and fall back to C
+ * elsewhere: the Thumb build and the host library.
+ */
+
+#define FAGPIO_FIR_MAX_TAPS		64
+#define FAGPIO_CIC_MAX_ORDER	4
+
+#if defined(__ARM_FEATURE_DSP)
+static inline int32_t fagpio_smulbb(int32_t a, int32_t b) {
+	int32_t r;
+
+	__asm__("smulbb %0, %1, %2" : "=r"(r) : "r"(a), "r"(b));
+	return r;
+}
+
+static inline int32_t fagpio_smlabb(int32_t a, int32_t b, int32_t acc) {
+	int32_t r;
+
+	__asm__("smlabb %0, %1, %2, %3" : "=r"(r) : "r"(a), "r"(b), "r"(acc));
+	return r;
+}
+
+static inline int32_t fagpio_qadd(int32_t a, int32_t b) {
+	int32_t r;
+
+	__asm__("qadd %0, %1, %2" : "=r"(r) : "r"(a), "r"(b));
+	return r;
+}
+#else
+static inline int32_t fagpio_smulbb(int32_t a, int32_t b) {
+	return (int32_t)(int16_t)a * (int16_t)b;
+}
+
+static inline int32_t fagpio_smlabb(int32_t a, int32_t b, int32_t acc) {
+	return (int32_t)((uint32_t)acc + (uint32_t)((int32_t)(int16_t)a * (int16_t)b));		//Wraps like the instruction
+}
+
+static inline int32_t fagpio_qadd(int32_t a, int32_t b) {
+	int64_t r = (int64_t)a + b;
+
+	return r > INT32_MAX ? INT32_MAX : r < INT32_MIN ? INT32_MIN : (int32_t)r;
+}
+#endif
+
+static inline int16_t fagpio_sat16(int32_t v) {
+	return v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : (int16_t)v;
+}
+
+struct fagpio_fir {
+	const int16_t *coef;	//Q15, coef[0] applies to the newest sample
+	unsigned int taps;
+	unsigned int decim;		//Outputs every decim inputs
+	unsigned int phase;
+	unsigned int pos;
+	int16_t hist[2 * FAGPIO_FIR_MAX_TAPS];	//Delay line stored twice, so the window is contiguous
+};
+
+struct fagpio_cic {
+	unsigned int order;
+	uint32_t decim;
+	uint32_t phase;
+	uint32_t integ[FAGPIO_CIC_MAX_ORDER];	//Modular arithmetic: wraparound cancels in the combs
+	uint32_t comb[FAGPIO_CIC_MAX_ORDER];
+};
+
+struct fagpio_biquad {
+	int16_t b0, b1, b2;		//Q14
+	int16_t a1, a2;			//Q14 above -2.0, y = b.x - a.y
+	int16_t x1, x2, y1, y2;
+};
+
+struct fagpio_la_run;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// coef must stay valid; decim 1 for a plain filter
+int fagpio_fir_init(struct fagpio_fir *f, const int16_t *coef, unsigned int taps, unsigned int decim);
+size_t fagpio_fir_process(struct fagpio_fir *f, const int16_t *in, size_t n, int16_t *out);		//Returns the outputs
+
+/*
+ * Gain is decim^order: the outputs are raw. For 16-bit input decim^order
+ * may be up to 65536, for bit streams up to 2^31.
+ */
+int fagpio_cic_init(struct fagpio_cic *c, unsigned int order, uint32_t decim);
+size_t fagpio_cic_process(struct fagpio_cic *c, const int16_t *in, size_t n, int32_t *out);
+
+// One pin (mask) of logic-analyzer runs as a 0/1 stream; out needs samples / decim + 1 entries
+size_t fagpio_cic_runs(struct fagpio_cic *c, const struct fagpio_la_run *runs, size_t nruns, uint32_t mask, int32_t *out);
+
+// coef: b0, b1, b2, a1, a2 in Q14 (a0 = 1)
+void fagpio_biquad_init(struct fagpio_biquad *q, const int16_t coef[5]);
+void fagpio_biquad_process(struct fagpio_biquad *q, const int16_t *in, int16_t *out, size_t n);		//in may equal out
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
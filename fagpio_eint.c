@@ -0,0 +1,357 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "fagpio_priv.h"
+#include "fagpio_eint.h"
+#include "fagpio_log.h"
+#include "fagpio_ring.h"
+#include "fagpio_timer.h"
+#include "fagpio_soc.h"
+
+#define EINT_PORTS		FAGPIO_SOC_EINT_MAX
+
+static int eint_fd[EINT_PORTS] = { -1, -1, -1 };
+static uint32_t eint_last[EINT_PORTS];		//Port DAT at the previous ring event
+
+FAGPIO_CB_TABLE(eint_cbs, FAGPIO_EINT_CB_MAX);
+static uint8_t eint_edge[EINT_PORTS][32];
+
+// Moderation of one pin, see fagpio_eint_moderate()
+struct eint_mod {
+	uint32_t limit;			//Interrupts per window, 0 unmoderated
+	uint32_t hold_ticks;
+	uint32_t window_start, window_count;
+	uint32_t last_change;	//Ticks of the last polled edge
+	struct fagpio_eint_stats st;
+};
+
+static struct eint_mod eint_mod[EINT_PORTS][32];
+static uint32_t eint_polled[EINT_PORTS];		//Moderated pins of each port
+static uint32_t eint_level[EINT_PORTS];			//Their DAT at the last poll
+
+// EINT bank of the port and its index into the tables above, -1 if it has none
+static int eint_index(uint8_t port) {
+	return fagpio_soc_eint_bank(port);
+}
+
+static struct pio_eint *eint_bank(uint8_t port) {
+	struct pio_bank *banks = fagpio_banks();
+	int i = eint_index(port);
+
+	if (i < 0 || !banks)
+		return NULL;
+	return (struct pio_eint *)((uint8_t *)banks + rPIO_EINT_BASE) + i;
+}
+
+static int eint_open(uint8_t port) {
+	char name[32], path[32];
+	int *fd = &eint_fd[eint_index(port)];
+	uint32_t one = 1;
+
+	if (*fd >= 0)
+		return *fd;
+
+	snprintf(name, sizeof(name), FAGPIO_UIO_EINT_NAME "%c", 'a' + port);
+	int n = fagpio_uio_find(name);
+
+	if (n < 0) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "No UIO device named %s\n", name);
+		return -1;
+	}
+	snprintf(path, sizeof(path), "/dev/uio%d", n);
+	if ((*fd = open(path, O_RDWR|O_CLOEXEC)) < 0) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "%s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	if (write(*fd, &one, sizeof(one)) != sizeof(one))		//Unmask in uio_pdrv_genirq
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "%s: cannot enable the interrupt\n", path);
+	return *fd;
+}
+
+int attachInterrupt(uint8_t pin, uint8_t edge) {
+	uint8_t port = PIO_PIN_PORT(pin), n = PIO_PIN_NUM(pin);
+	struct pio_eint *eint = eint_bank(port);
+	int fd;
+
+	if (!eint || edge > CHANGE || n >= 32)
+		return -1;
+	if ((fd = eint_open(port)) < 0)
+		return -1;
+
+	unsigned int shift = (n & 7) * 4;
+
+	if (fagpio_pin_func(pin, PIO_EINT_FUNC) < 0)
+		return -1;
+	eint->cfg[n >> 3] = (eint->cfg[n >> 3] & ~(15u << shift)) | ((uint32_t)edge << shift);
+	eint->sta = 1u << n;
+	eint->ctl |= 1u << n;
+	eint_edge[eint_index(port)][n] = edge;
+	eint_last[eint_index(port)] = digitalReadPort(port);
+	return fd;
+}
+
+/*
+Sample periods are 2^n / 32768 s (30.5 us to 3.9 ms) or 2^n / 24 MHz
+(42 ns to 5.3 us). Both scales are tried and the nearest period kept.
+*/
+int fagpio_eint_debounce(uint8_t port, uint32_t debounce_us) {
+	static const uint32_t src_hz[2] = { 32768, 24000000 };
+	struct pio_eint *eint = eint_bank(port);
+	uint64_t want = (uint64_t)debounce_us * 1000, best_ns = 0, best_diff = UINT64_MAX;
+	uint32_t best = 0;
+
+	if (!eint)
+		return -1;
+	for (unsigned int src = 0; src < 2; src++) {
+		for (unsigned int n = 0; n < 8; n++) {
+			uint64_t ns = (1000000000ull << n) / src_hz[src];
+			uint64_t diff = ns > want ? ns - want : want - ns;
+
+			if (diff < best_diff) {
+				best_diff = diff;
+				best_ns = ns;
+				best = PIO_EINT_DEB_PRE(n) | (src ? PIO_EINT_DEB_HOSC : 0);
+			}
+		}
+	}
+	eint->deb = best;
+	FAGPIO_LOG(FAGPIO_LOG_DEBUG, "P%c EINT debounce %u ns for %u us\n", 'A' + port, (unsigned int)best_ns, debounce_us);
+	return (int)best_ns;
+}
+
+int attachInterruptDebounce(uint8_t pin, uint8_t edge, uint32_t debounce_us) {
+	if (fagpio_eint_debounce(PIO_PIN_PORT(pin), debounce_us) < 0)
+		return -1;
+	return attachInterrupt(pin, edge);
+}
+
+void detachInterrupt(uint8_t pin) {
+	uint8_t port = PIO_PIN_PORT(pin);
+	struct pio_eint *eint = eint_bank(port);
+
+	if (!eint)
+		return;
+	fagpio_eint_mask(pin);
+	fagpio_cb_clear(&eint_cbs, pin);
+	memset(&eint_mod[eint_index(port)][PIO_PIN_NUM(pin)], 0, sizeof(struct eint_mod));
+	if (!eint->ctl && eint_fd[eint_index(port)] >= 0) {
+		close(eint_fd[eint_index(port)]);
+		eint_fd[eint_index(port)] = -1;
+	}
+}
+
+void fagpio_eint_mask(uint8_t pin) {
+	struct pio_eint *eint = eint_bank(PIO_PIN_PORT(pin));
+
+	if (!eint)
+		return;
+	eint->ctl &= ~PIO_PIN_MASK(pin);
+	eint->sta = PIO_PIN_MASK(pin);
+	eint_polled[eint_index(PIO_PIN_PORT(pin))] &= ~PIO_PIN_MASK(pin);
+	eint_mod[eint_index(PIO_PIN_PORT(pin))][PIO_PIN_NUM(pin)].st.moderated = 0;
+}
+
+int fagpio_eint_moderate(uint8_t pin, uint32_t max_per_s, uint32_t hold_ms) {
+	int bank = eint_index(PIO_PIN_PORT(pin));
+	struct eint_mod *m;
+
+	if (bank < 0)
+		return -1;
+	m = &eint_mod[bank][PIO_PIN_NUM(pin)];
+	m->limit = max_per_s ? (uint64_t)max_per_s * FAGPIO_EINT_MOD_WINDOW_MS / 1000 : 0;
+	if (max_per_s && !m->limit)
+		m->limit = 1;
+	m->hold_ticks = (uint64_t)hold_ms * fagpio_tick_hz / 1000;
+	m->window_count = 0;
+	m->window_start = fagpio_ticks();
+	return 0;
+}
+
+int fagpio_eint_stats(uint8_t pin, struct fagpio_eint_stats *st) {
+	int bank = eint_index(PIO_PIN_PORT(pin));
+
+	if (bank < 0)
+		return -1;
+	*st = eint_mod[bank][PIO_PIN_NUM(pin)].st;
+	return 0;
+}
+
+// Counts the interrupts of each pin, and moves one past its rate to polling
+static void eint_count(uint8_t port, struct pio_eint *eint, uint32_t pending) {
+	int bank = eint_index(port);
+	uint32_t now = fagpio_ticks(), window = (uint64_t)FAGPIO_EINT_MOD_WINDOW_MS * fagpio_tick_hz / 1000;
+
+	while (pending) {
+		unsigned int n = 31 - __builtin_clz(pending);
+		struct eint_mod *m = &eint_mod[bank][n];
+
+		pending &= ~(1u << n);
+		m->st.events++;
+		if (!m->limit)
+			continue;
+		if (now - m->window_start > window) {
+			m->window_start = now;
+			m->window_count = 0;
+		}
+		if (++m->window_count <= m->limit)
+			continue;
+		eint->ctl &= ~(1u << n);
+		eint->sta = 1u << n;
+		fagpio_pin_func(PIO_PIN(port, n), 0);
+		eint_level[bank] = (eint_level[bank] & ~(1u << n)) | (digitalReadPort(port) & (1u << n));
+		eint_polled[bank] |= 1u << n;
+		m->last_change = now;
+		m->st.storms++;
+		m->st.moderated = 1;
+		FAGPIO_LOG(FAGPIO_LOG_DEBUG, "P%c%u: interrupt storm, polled\n", 'A' + port, n);
+	}
+}
+
+/*
+One snapshot of the moderated pins: edges matching their trigger are
+pending, and a pin quiet for its hold time gets its EINT back.
+*/
+static uint32_t eint_poll(uint8_t port, struct pio_eint *eint) {
+	int bank = eint_index(port);
+	uint32_t dat = digitalReadPort(port), now = fagpio_ticks(), pending = 0;
+	uint32_t polled = eint_polled[bank], changed = (dat ^ eint_level[bank]) & polled;
+
+	while (polled) {
+		unsigned int n = 31 - __builtin_clz(polled);
+		struct eint_mod *m = &eint_mod[bank][n];
+		uint32_t bit = 1u << n;
+		int hit;
+
+		polled &= ~bit;
+		switch (eint_edge[bank][n]) {
+		case RISING: hit = (changed & dat & bit) != 0; break;
+		case FALLING: hit = (changed & ~dat & bit) != 0; break;
+		case HIGH_LEVEL: hit = (dat & bit) != 0; break;
+		case LOW_LEVEL: hit = !(dat & bit); break;
+		default: hit = (changed & bit) != 0;
+		}
+		if (hit) {
+			pending |= bit;
+			m->st.events++;
+			m->st.polled++;
+		}
+		if (changed & bit) {
+			m->last_change = now;
+		} else if (now - m->last_change > m->hold_ticks) {
+			fagpio_pin_func(PIO_PIN(port, n), PIO_EINT_FUNC);
+			eint->sta = bit;
+			eint->ctl |= bit;
+			eint_polled[bank] &= ~bit;
+			m->window_count = 0;
+			m->window_start = now;
+			m->st.moderated = 0;
+		}
+	}
+	eint_level[bank] = dat;
+	return pending;
+}
+
+// Pending bits are cleared before the interrupt is unmasked, or it would fire again at once
+uint32_t fagpio_eint_ack(uint8_t port) {
+	struct pio_eint *eint = eint_bank(port);
+	uint32_t pending, one = 1;
+	int fd;
+
+	if (!eint)
+		return 0;
+	pending = eint->sta & eint->ctl;
+	eint->sta = pending;
+	eint_count(port, eint, pending);
+	fd = eint_fd[eint_index(port)];
+	if (fd >= 0 && write(fd, &one, sizeof(one)) != sizeof(one))
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "Cannot re-arm the P%c interrupt\n", 'A' + port);
+	return pending;
+}
+
+static long ms_since(const struct timespec *t0) {
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (t.tv_sec - t0->tv_sec) * 1000 + (t.tv_nsec - t0->tv_nsec) / 1000000;
+}
+
+// With moderated pins on the port the sleep is cut into FAGPIO_EINT_POLL_MS steps, each ending with a snapshot
+uint32_t fagpio_eint_wait(uint8_t port, int timeout_ms) {
+	struct pollfd pfd;
+	struct timespec t0;
+	uint32_t count, pending = 0;
+	int bank = eint_index(port);
+
+	FAGPIO_PROBE2(eint_wait, port, timeout_ms);
+	if (bank < 0 || eint_fd[bank] < 0)
+		return 0;
+	pfd.fd = eint_fd[bank];
+	pfd.events = POLLIN;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (;;) {
+		long left = timeout_ms < 0 ? -1 : timeout_ms - ms_since(&t0);
+		int step = eint_polled[bank] && (left < 0 || left > FAGPIO_EINT_POLL_MS);
+
+		if (timeout_ms >= 0 && left < 0)
+			left = 0;
+		if (poll(&pfd, 1, step ? FAGPIO_EINT_POLL_MS : left) > 0 && read(pfd.fd, &count, sizeof(count)) == sizeof(count))		//Consumes the UIO event count
+			pending = fagpio_eint_ack(port);
+		if (eint_polled[bank])
+			pending |= eint_poll(port, eint_bank(port));
+		if (pending || !step)
+			break;
+	}
+	FAGPIO_PROBE2(eint_done, port, pending);
+	return pending;
+}
+
+int fagpio_eint_attach_cb(uint8_t pin, uint8_t edge, fagpio_pin_cb cb, void *arg) {
+	int fd;
+
+	if (fagpio_cb_set(&eint_cbs, pin, cb, arg) < 0)
+		return -1;
+	if ((fd = attachInterrupt(pin, edge)) < 0)
+		fagpio_cb_clear(&eint_cbs, pin);
+	else
+		eint_edge[eint_index(PIO_PIN_PORT(pin))][PIO_PIN_NUM(pin)] = edge;
+	return fd;
+}
+
+/*
+DAT is not defined for a pin muxed to EINT, so the value passed is the
+level the trigger implies, and the DAT bit only for CHANGE.
+*/
+int fagpio_eint_dispatch(uint8_t port, int timeout_ms) {
+	uint32_t pending = fagpio_eint_wait(port, timeout_ms);
+	uint32_t dat = pending ? digitalReadPort(port) : 0;
+	int fired = 0, bank = eint_index(port);
+
+	while (pending) {
+		unsigned int n = 31 - __builtin_clz(pending);
+		uint8_t edge = eint_edge[bank][n], value;
+
+		pending &= ~(1u << n);
+		if (edge == CHANGE)
+			value = (dat >> n) & 1;
+		else
+			value = edge == RISING || edge == HIGH_LEVEL;
+		fired += fagpio_cb_call(&eint_cbs, PIO_PIN(port, n), value);
+	}
+	return fired;
+}
+
+uint32_t fagpio_eint_wait_ring(uint8_t port, int timeout_ms, struct fagpio_ring *ring) {
+	uint32_t pending = fagpio_eint_wait(port, timeout_ms);
+
+	if (pending) {
+		uint32_t now = digitalReadPort(port);
+
+		fagpio_ring_push(ring, fagpio_ticks(), port, eint_last[eint_index(port)], now);
+		eint_last[eint_index(port)] = now;
+	}
+	return pending;
+}
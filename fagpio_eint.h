@@ -0,0 +1,112 @@
+#ifndef _FAGPIO_EINT_H
+#define _FAGPIO_EINT_H
+
+#include <stdint.h>
+#include "fagpio_callback.h"
+
+/*
+ * Edge interrupts through the PIO EINT registers (PIO + 0x200, one 0x20
+ * bank per port) on the ports that have them: PD, PE and PF on the
+ * F1C100s, PB and PG on the V3s, PA and PG on the H3 (fagpio_soc.h). The
+ * interrupt itself is delivered by a generic-uio node per port, named
+ * "fagpio-eint-p" and the port letter, e.g. "fagpio-eint-pe":
+ *
+ *	fagpio-eint-pe {
+ *		compatible = "generic-uio";
+ *		interrupts = <39>;		//F1C100s: 38 PD, 39 PE, 40 PF
+ *	};
+ *
+ * attachInterrupt() returns that node's fd; poll() it for POLLIN, then
+ * fagpio_eint_ack() clears the pending bits and re-arms the interrupt.
+ * Waiting costs no CPU. fagpio_eint_attach_cb() adds a callback from a
+ * static table of FAGPIO_EINT_CB_MAX entries (fagpio_callback.h) that
+ * fagpio_eint_dispatch() runs for each pending pin.
+ *
+ * fagpio_eint_debounce() sets the bank's input filter: the pins are
+ * sampled at 32768 Hz or 24 MHz divided by 2^0..2^7, and a pulse shorter
+ * than one sample period raises no interrupt. The setting closest to the
+ * period asked for is taken, from 42 ns to 3.9 ms, and applies to every
+ * pin of the port. attachInterruptDebounce(), or attachInterrupt() with a
+ * third argument in C++, attaches and sets it in one call.
+ *
+ * fagpio_eint_moderate() caps a pin's interrupt rate against chattering
+ * inputs. Its interrupts are counted in windows of
+ * FAGPIO_EINT_MOD_WINDOW_MS; once a window holds more than the rate
+ * allows, the pin's EINT is masked and it goes back to an input, and
+ * fagpio_eint_wait() on the port then wakes every FAGPIO_EINT_POLL_MS to
+ * compare the pin in the DAT snapshot with its last level, reporting a
+ * matching edge as pending like the interrupt would. The EINT is re-armed
+ * once the pin has been quiet for the hold time. fagpio_eint_stats()
+ * counts every pin's events: each interrupt while armed, each change seen
+ * by a poll while moderated, so a polled storm counts at most one event
+ * per poll.
+ */
+
+#define rPIO_EINT_BASE		0x200			//Offset from GPIO_REG_BASE
+#define PIO_EINT_FUNC		6				//CFG function that routes a pin to EINT
+#define FAGPIO_UIO_EINT_NAME	"fagpio-eint-p"	//Followed by the port letter
+
+#ifndef FAGPIO_EINT_CB_MAX
+#define FAGPIO_EINT_CB_MAX		16		//Pins with a callback
+#endif
+
+#ifndef FAGPIO_EINT_MOD_WINDOW_MS
+#define FAGPIO_EINT_MOD_WINDOW_MS	10
+#endif
+#ifndef FAGPIO_EINT_POLL_MS
+#define FAGPIO_EINT_POLL_MS		1		//Snapshot period of moderated pins
+#endif
+
+#define PIO_EINT_DEB_HOSC	(1u << 0)		//DEB clock select: 24 MHz instead of 32768 Hz
+#define PIO_EINT_DEB_PRE(n)	((uint32_t)(n) << 4)	//Sample clock divided by 2^n, n 0..7
+
+#define HIGH_LEVEL			2	//EINT CFG trigger codes besides RISING, FALLING and CHANGE
+#define LOW_LEVEL			3
+
+struct pio_eint {
+	volatile uint32_t cfg[4];	//4 bits per pin
+	volatile uint32_t ctl;		//Enable per pin
+	volatile uint32_t sta;		//Pending per pin, write 1 to clear
+	volatile uint32_t deb;		//Debounce clock select and prescaler
+	uint32_t pad;
+};
+
+struct fagpio_eint_stats {
+	uint32_t events;		//Interrupts, plus edges polled while moderated
+	uint32_t polled;		//Of those, found by polling
+	uint32_t storms;		//Times the rate was exceeded and the EINT masked
+	uint8_t moderated;		//Polled right now
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int attachInterrupt(uint8_t pin, uint8_t edge);		//Pollable fd of the port, -1 on failure
+void detachInterrupt(uint8_t pin);
+int fagpio_eint_debounce(uint8_t port, uint32_t debounce_us);		//Period set in ns, -1 without EINT
+int attachInterruptDebounce(uint8_t pin, uint8_t edge, uint32_t debounce_us);
+void fagpio_eint_mask(uint8_t pin);						//Disables the pin's interrupt, keeps the port fd open
+uint32_t fagpio_eint_ack(uint8_t port);				//Pending pins, cleared and re-armed
+uint32_t fagpio_eint_wait(uint8_t port, int timeout_ms);	//0 on timeout
+
+// At most max_per_s interrupts, then polled until quiet for hold_ms; 0 turns it off
+int fagpio_eint_moderate(uint8_t pin, uint32_t max_per_s, uint32_t hold_ms);
+int fagpio_eint_stats(uint8_t pin, struct fagpio_eint_stats *st);
+
+int fagpio_eint_attach_cb(uint8_t pin, uint8_t edge, fagpio_pin_cb cb, void *arg);	//attachInterrupt() plus a callback
+int fagpio_eint_dispatch(uint8_t port, int timeout_ms);	//Waits once, returns the number of callbacks run
+
+// fagpio_eint_wait() that pushes (ticks, port, previous, current DAT) into an SPSC ring (fagpio_ring.h)
+struct fagpio_ring;
+uint32_t fagpio_eint_wait_ring(uint8_t port, int timeout_ms, struct fagpio_ring *ring);
+
+#ifdef __cplusplus
+}
+
+static inline int attachInterrupt(uint8_t pin, uint8_t edge, uint32_t debounce_us) {
+	return attachInterruptDebounce(pin, edge, debounce_us);
+}
+#endif
+
+#endif
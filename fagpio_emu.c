@@ -0,0 +1,185 @@
+#include <string.h>
+#include "fagpio_priv.h"
+#include "fagpio_emu.h"
+#include "fagpio_timer.h"
+
+static const uint8_t quad[4] = { 0, 1, 3, 2 };				//B A: A leads moving up
+static const uint8_t hall[6] = { 5, 4, 6, 2, 3, 1 };		//C B A, 120 degrees apart
+
+static int emu_init(struct fagpio_emu *e, struct fagpio_seq_op *ops, unsigned int capacity, int type, const uint8_t *pins, unsigned int npins) {
+	memset(e, 0, sizeof(*e));
+	if (fagpio_setup() < 0)
+		return -1;
+	for (unsigned int i = 0; i < npins; i++) {
+		if (pins[i] == FAGPIO_EMU_NO_PIN)
+			continue;
+		if (PIO_PIN_PORT(pins[i]) != PIO_PIN_PORT(pins[0]) || PIO_PIN_PORT(pins[i]) >= PIO_NPORTS)
+			return -1;
+		e->mask |= PIO_PIN_MASK(pins[i]);
+	}
+	e->type = type;
+	e->port = PIO_PIN_PORT(pins[0]);
+	e->dir = -1;
+	e->x = 0.5;		//Halfway through count 0
+	fagpio_seq_init(&e->seq, ops, capacity);
+	return 0;
+}
+
+// Port value at the current count; Z is high on the counts that are multiples of index
+static uint32_t emu_value(const struct fagpio_emu *e) {
+	int32_t s;
+
+	if (e->type == FAGPIO_EMU_STEPDIR)
+		return e->dir > 0 ? e->dir_mask : 0;
+	s = e->count % (int32_t)e->states;
+	return e->table[s < 0 ? s + e->states : s] | (e->z_mask && !(e->count % (int64_t)e->index) ? e->z_mask : 0);
+}
+
+static void emu_pins(struct fagpio_emu *e, const uint8_t *pins, unsigned int npins) {
+	for (unsigned int i = 0; i < npins; i++) {
+		if (pins[i] == FAGPIO_EMU_NO_PIN)
+			continue;
+		fagpio_digital_write(fagpio_default(), pins[i], (emu_value(e) & PIO_PIN_MASK(pins[i])) != 0);
+		pinMode(pins[i], OUTPUT);
+	}
+}
+
+int fagpio_emu_quadrature(struct fagpio_emu *e, struct fagpio_seq_op *ops, unsigned int capacity, uint8_t a, uint8_t b, uint8_t z, uint32_t index) {
+	uint8_t pins[3] = { a, b, index ? z : FAGPIO_EMU_NO_PIN };
+
+	if (emu_init(e, ops, capacity, FAGPIO_EMU_QUADRATURE, pins, 3) < 0)
+		return -1;
+	e->states = 4;
+	for (unsigned int s = 0; s < 4; s++)
+		e->table[s] = ((quad[s] & 1) ? PIO_PIN_MASK(a) : 0) | ((quad[s] & 2) ? PIO_PIN_MASK(b) : 0);
+	if (index && z != FAGPIO_EMU_NO_PIN) {
+		e->z_mask = PIO_PIN_MASK(z);
+		e->index = index;
+	}
+	emu_pins(e, pins, 3);
+	return 0;
+}
+
+int fagpio_emu_stepdir(struct fagpio_emu *e, struct fagpio_seq_op *ops, unsigned int capacity, uint8_t step, uint8_t dir, uint32_t pulse_ns) {
+	uint8_t pins[2] = { step, dir };
+
+	if (emu_init(e, ops, capacity, FAGPIO_EMU_STEPDIR, pins, 2) < 0)
+		return -1;
+	e->step_mask = PIO_PIN_MASK(step);
+	e->dir_mask = PIO_PIN_MASK(dir);
+	e->pulse = fagpio_ns_to_ticks(pulse_ns);
+	if (!e->pulse)
+		e->pulse = 1;
+	emu_pins(e, pins, 2);
+	return 0;
+}
+
+int fagpio_emu_hall(struct fagpio_emu *e, struct fagpio_seq_op *ops, unsigned int capacity, uint8_t ha, uint8_t hb, uint8_t hc) {
+	uint8_t pins[3] = { ha, hb, hc };
+
+	if (emu_init(e, ops, capacity, FAGPIO_EMU_HALL, pins, 3) < 0)
+		return -1;
+	e->states = 6;
+	for (unsigned int s = 0; s < 6; s++)
+		e->table[s] = ((hall[s] & 1) ? PIO_PIN_MASK(ha) : 0) | ((hall[s] & 2) ? PIO_PIN_MASK(hb) : 0) | ((hall[s] & 4) ? PIO_PIN_MASK(hc) : 0);
+	emu_pins(e, pins, 3);
+	return 0;
+}
+
+// One transition at tick at, moving up (dir 1) or down
+static int emu_edge(struct fagpio_emu *e, uint32_t at, int dir) {
+	struct fagpio_seq *seq = &e->seq;
+
+	e->count += dir ? 1 : -1;
+	if (e->type != FAGPIO_EMU_STEPDIR) {
+		if (seq->count && at <= seq->end)
+			return -1;		//Two states in one store
+		return fagpio_seq_add(seq, e->port, e->mask, emu_value(e), at - seq->end);
+	}
+	if (seq->count && at <= e->fall)
+		return -1;
+	if (dir != e->dir) {		//DIR goes with the previous falling edge
+		uint32_t t = seq->count ? e->fall : at;
+
+		if (fagpio_seq_add(seq, e->port, e->dir_mask, dir ? e->dir_mask : 0, t - seq->end) < 0)
+			return -1;
+		e->dir = dir;
+	}
+	e->fall = at + e->pulse;
+	if (fagpio_seq_add(seq, e->port, e->step_mask, e->step_mask, at - seq->end) < 0)
+		return -1;
+	return fagpio_seq_add(seq, e->port, e->step_mask, 0, e->fall - seq->end);
+}
+
+// Time in [lo, hi] where x0 + v t + a t^2 / 2 = n, x monotonic there: Newton kept inside by bisection
+static double solve(double x0, double v, double a, double n, double lo, double hi, int up) {
+	double t = lo;
+
+	for (int i = 0; i < 64 && hi - lo > 1e-12; i++) {
+		double f = x0 + v * t + a * t * t / 2 - n, d = v + a * t, next;
+
+		if ((f > 0) == up)
+			hi = t;
+		else
+			lo = t;
+		next = d ? t - f / d : (lo + hi) / 2;
+		t = next > lo && next < hi ? next : (lo + hi) / 2;
+	}
+	return t;
+}
+
+// The transitions of [t0, t1] of a segment, in which the velocity keeps its sign
+static int emu_run(struct fagpio_emu *e, double base, double x0, double v, double a, double t0, double t1, double hz) {
+	double xe = x0 + v * t1 + a * t1 * t1 / 2;
+	int up = v + a * (t0 + t1) / 2 > 0;
+
+	for (;;) {
+		double n = up ? e->count + 1 : e->count, t;
+
+		if (up ? xe <= n : xe >= n)
+			break;
+		t = solve(x0, v, a, n, t0, t1, up);
+		if (emu_edge(e, (uint32_t)(base + t * hz + 0.5), up) < 0)
+			return -1;
+		t0 = t;
+	}
+	return 0;
+}
+
+/*
+Time is in seconds from the segment start. The velocity is v + a t and
+changes sign at most once, at -v / a, where the segment is split.
+*/
+int fagpio_emu_ramp(struct fagpio_emu *e, int32_t from_hz, int32_t to_hz, uint32_t ms) {
+	double T = ms / 1000.0, v = from_hz, a = T > 0 ? (to_hz - from_hz) / T : 0, hz = fagpio_tick_hz;
+	double turn = a ? -v / a : -1, x0 = e->x;
+
+	if (!ms)
+		return 0;
+	if (e->at + T * hz > UINT32_MAX)
+		return -1;
+	if (!e->seq.count && fagpio_seq_add(&e->seq, e->port, e->mask, emu_value(e), 0) < 0)
+		return -1;		//The initial state
+	if (turn > 0 && turn < T) {
+		if (emu_run(e, e->at, x0, v, a, 0, turn, hz) < 0 || emu_run(e, e->at, x0, v, a, turn, T, hz) < 0)
+			return -1;
+	} else if (from_hz || to_hz) {
+		if (emu_run(e, e->at, x0, v, a, 0, T, hz) < 0)
+			return -1;
+	}
+	e->x = x0 + v * T + a * T * T / 2;
+	e->at += T * hz;
+	return 0;
+}
+
+int fagpio_emu_play(struct fagpio_emu *e) {
+	if (fagpio_seq_play(&e->seq) < 0)
+		return -1;
+	return e->seq.late;
+}
+
+void fagpio_emu_rewind(struct fagpio_emu *e) {
+	fagpio_seq_init(&e->seq, e->seq.ops, e->seq.capacity);
+	e->at = 0;
+	e->fall = 0;
+}
@@ -0,0 +1,72 @@
+#ifndef _FAGPIO_EMU_H
+#define _FAGPIO_EMU_H
+
+#include <stdint.h>
+#include "fagpio_seq.h"
+
+/*
+ * Signal generators for testing drives: quadrature A/B with an optional
+ * Z index, STEP/DIR trains and three-phase hall patterns, compiled into a
+ * sequencer timeline (fagpio_seq.h). A generator's pins share one port,
+ * and its states are a precomputed table of port values: every
+ * transition is one op, one DAT store at playback, A and B never change
+ * in the same store.
+ *
+ * The motion is a list of segments whose rate (counts per second,
+ * negative backwards) ramps linearly from one value to the next. The
+ * position is integrated exactly and each transition goes at the tick
+ * where it crosses the next count, so sweeps are smooth and a ramp
+ * through zero reverses cleanly. A count is a quadrature edge (four per
+ * line), a hall state (six per electrical turn) or a step.
+ *
+ * Compiling is floating point and done before playback; playback has
+ * the sequencer's timing, transitions on the order of a MHz. Transitions
+ * that would fall on the same tick, or steps closer than their pulse,
+ * fail the segment. A timeline is limited to 2^32 ticks, about three
+ * minutes at 24 MHz; fagpio_emu_rewind() starts a new one from the same
+ * position.
+ */
+
+#define FAGPIO_EMU_NO_PIN		0xFF
+
+#define FAGPIO_EMU_QUADRATURE	0
+#define FAGPIO_EMU_STEPDIR		1
+#define FAGPIO_EMU_HALL			2
+
+struct fagpio_emu {
+	struct fagpio_seq seq;
+	uint8_t type;
+	uint8_t port;
+	uint32_t mask;			//Pins of the generator
+	uint32_t table[6];		//Port value of each state
+	unsigned int states;
+	uint32_t z_mask;		//Quadrature index pin
+	uint32_t index;			//Counts per Z pulse
+	uint32_t step_mask, dir_mask;
+	uint32_t pulse;			//STEP high time, ticks
+	int32_t count;			//Position in counts
+	int8_t dir;				//STEP/DIR: DIR level on the timeline, -1 before the first step
+	uint32_t fall;			//Tick of the last STEP falling edge
+	double x;				//Exact position, count <= x < count + 1 moving up
+	double at;				//Timeline time of the segment end, ticks
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// index is counts per Z pulse (4 x lines per turn), 0 and z FAGPIO_EMU_NO_PIN for none
+int fagpio_emu_quadrature(struct fagpio_emu *e, struct fagpio_seq_op *ops, unsigned int capacity, uint8_t a, uint8_t b, uint8_t z, uint32_t index);
+int fagpio_emu_stepdir(struct fagpio_emu *e, struct fagpio_seq_op *ops, unsigned int capacity, uint8_t step, uint8_t dir, uint32_t pulse_ns);
+int fagpio_emu_hall(struct fagpio_emu *e, struct fagpio_seq_op *ops, unsigned int capacity, uint8_t ha, uint8_t hb, uint8_t hc);
+
+// Appends a segment ramping from from_hz to to_hz counts per second over ms; -1 if the ops run out or it is too fast
+int fagpio_emu_ramp(struct fagpio_emu *e, int32_t from_hz, int32_t to_hz, uint32_t ms);
+int fagpio_emu_play(struct fagpio_emu *e);		//Overdue ops, -1 on failure
+void fagpio_emu_rewind(struct fagpio_emu *e);	//Empties the timeline, keeps the position
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,52 @@
+#include <string.h>
+#include "fagpio_encoder.h"
+
+#define QUAD_ERR	2		//Both inputs changed at once
+
+// Indexed by old << 2 | new, each as A << 1 | B; 00 -> 01 -> 11 -> 10 counts up
+static const int8_t quad_table[16] = {
+	0, 1, -1, QUAD_ERR,
+	-1, 0, QUAD_ERR, 1,
+	1, QUAD_ERR, 0, -1,
+	QUAD_ERR, -1, 1, 0,
+};
+
+static inline uint8_t quad_state(uint32_t dat, uint8_t a, uint8_t b) {
+	return (((dat >> a) & 1) << 1) | ((dat >> b) & 1);
+}
+
+void fagpio_encoder_init(struct fagpio_encoder_set *set, uint8_t port) {
+	memset(set, 0, sizeof(*set));
+	set->port = port;
+}
+
+int fagpio_encoder_add(struct fagpio_encoder_set *set, uint8_t pin_a, uint8_t pin_b) {
+	unsigned int i = set->count;
+
+	if (i == FAGPIO_ENCODER_MAX || PIO_PIN_PORT(pin_a) != set->port || PIO_PIN_PORT(pin_b) != set->port || set->port >= PIO_NPORTS)
+		return -1;
+
+	pinMode(pin_a, 1);
+	pinMode(pin_b, 1);
+	set->a[i] = PIO_PIN_NUM(pin_a);
+	set->b[i] = PIO_PIN_NUM(pin_b);
+	set->state[i] = quad_state(digitalReadPort(set->port), set->a[i], set->b[i]);
+	set->pos[i] = 0;
+	set->count = i + 1;
+	return i;
+}
+
+void fagpio_encoder_poll(struct fagpio_encoder_set *set) {
+	uint32_t dat = digitalReadPort(set->port);
+
+	for (unsigned int i = 0; i < set->count; i++) {
+		uint8_t now = quad_state(dat, set->a[i], set->b[i]);
+		int8_t step = quad_table[(set->state[i] << 2) | now];
+
+		set->state[i] = now;
+		if (step == QUAD_ERR)
+			set->errors++;
+		else if (step)
+			set->pos[i] += step;
+	}
+}
@@ -0,0 +1,45 @@
+#ifndef _FAGPIO_ENCODER_H
+#define _FAGPIO_ENCODER_H
+
+#include <stdint.h>
+#include "fagpio.h"
+
+/*
+ * Quadrature decoding for several encoders on one port. Each
+ * fagpio_encoder_poll() takes a single digitalReadPort() snapshot and
+ * steps every encoder through a 16-entry table indexed by its previous
+ * and current (A, B) levels. Positions are aligned int32 values written
+ * with one store, so other threads read them without tearing. Polling
+ * must be faster than the encoder's edge rate; a transition that skipped
+ * a state is counted in errors instead of moving the position.
+ */
+
+#define FAGPIO_ENCODER_MAX	8
+
+struct fagpio_encoder_set {
+	uint8_t port;
+	uint8_t count;
+	uint8_t a[FAGPIO_ENCODER_MAX];		//Bit numbers in the port
+	uint8_t b[FAGPIO_ENCODER_MAX];
+	uint8_t state[FAGPIO_ENCODER_MAX];	//Previous A << 1 | B
+	volatile int32_t pos[FAGPIO_ENCODER_MAX];
+	volatile uint32_t errors;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void fagpio_encoder_init(struct fagpio_encoder_set *set, uint8_t port);
+int fagpio_encoder_add(struct fagpio_encoder_set *set, uint8_t pin_a, uint8_t pin_b);	//Encoder index, -1 on error
+void fagpio_encoder_poll(struct fagpio_encoder_set *set);
+
+static inline int32_t fagpio_encoder_read(const struct fagpio_encoder_set *set, unsigned int i) {
+	return set->pos[i];
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
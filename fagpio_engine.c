@@ -0,0 +1,247 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "fagpio_priv.h"
+#include "fagpio_atomic.h"
+#include "fagpio_engine.h"
+#include "fagpio_log.h"
+#include "fagpio_mem.h"
+#include "fagpio_timer.h"
+
+#define CMD_WRITE		0
+#define CMD_TOGGLE		1
+
+struct engine_cmd {
+	uint8_t op;
+	uint8_t port;
+	uint16_t pad;
+	uint32_t mask;
+	uint32_t value;
+	uint32_t at;
+};
+
+struct fagpio_engine {
+	struct fagpio_engine_config cfg;
+	pthread_t thread;
+	int cpu;
+	volatile int stop;
+	struct pio_bank *banks;
+	// Output: producer head and consumer tail each on a line of their own
+	volatile uint32_t head __attribute__((aligned(FAGPIO_CACHE_LINE)));
+	volatile uint32_t tail __attribute__((aligned(FAGPIO_CACHE_LINE)));
+	struct engine_cmd cmd[FAGPIO_ENGINE_CMDS] __attribute__((aligned(FAGPIO_CACHE_LINE)));
+	struct fagpio_ring events;		//Sampling
+};
+
+// Claimed with fagpio_cas() at start and released at stop, never touched while running
+static volatile uint32_t owned_ports;
+static volatile uint32_t owned_cpus;
+
+static int claim(volatile uint32_t *set, uint32_t bits) {
+	for (;;) {
+		uint32_t old = *set;
+
+		if (old & bits)
+			return -1;
+		if (fagpio_cas(set, old, old | bits))
+			return 0;
+	}
+}
+
+static void release(volatile uint32_t *set, uint32_t bits) {
+	for (;;) {
+		uint32_t old = *set;
+
+		if (fagpio_cas(set, old, old & ~bits))
+			return;
+	}
+}
+
+// Highest CPU of the affinity mask above 0 that no engine holds, claimed; -1 if none
+static int place(int want) {
+	cpu_set_t set;
+
+	if (want >= 0)
+		return want < 32 && claim(&owned_cpus, 1u << want) == 0 ? want : -1;
+	if (sched_getaffinity(0, sizeof(set), &set) < 0)
+		return -1;
+	for (int cpu = 31; cpu > 0; cpu--)
+		if (CPU_ISSET(cpu, &set) && claim(&owned_cpus, 1u << cpu) == 0)
+			return cpu;
+	return -1;
+}
+
+static void idle(const struct fagpio_engine *e) {
+	if (e->cfg.idle_us)
+		usleep(e->cfg.idle_us);
+}
+
+static void run_sample(struct fagpio_engine *e) {
+	uint32_t last[PIO_NPORTS], mask[PIO_NPORTS];
+	uint8_t port[PIO_NPORTS];
+	unsigned int n = 0;
+
+	for (unsigned int p = 0; p < PIO_NPORTS; p++) {
+		if (!(e->cfg.ports & (1u << p)))
+			continue;
+		port[n] = p;
+		mask[n] = e->cfg.mask[p] ? e->cfg.mask[p] : ~0u;
+		last[n] = e->banks[p].dat & mask[n];
+		n++;
+	}
+	while (!e->stop) {
+		for (unsigned int i = 0; i < n; i++) {
+			uint32_t v = e->banks[port[i]].dat & mask[i];
+
+			if (v != last[i]) {
+				fagpio_ring_push(&e->events, fagpio_ticks(), port[i], last[i], v);
+				last[i] = v;
+			}
+		}
+		idle(e);
+	}
+}
+
+static void run_output(struct fagpio_engine *e) {
+	uint32_t shadow[PIO_NPORTS];
+
+	for (unsigned int p = 0; p < PIO_NPORTS; p++)
+		if (e->cfg.ports & (1u << p))
+			shadow[p] = e->banks[p].dat;
+	while (!e->stop) {
+		uint32_t tail = e->tail;
+
+		if (tail == e->head) {
+			idle(e);
+			continue;
+		}
+		fagpio_barrier();
+
+		struct engine_cmd *c = &e->cmd[tail & (FAGPIO_ENGINE_CMDS - 1)];
+
+		if (c->at && (int32_t)(fagpio_ticks() - c->at) < 0)
+			continue;
+		if (c->op == CMD_TOGGLE)
+			shadow[c->port] ^= c->mask;
+		else
+			shadow[c->port] = (shadow[c->port] & ~c->mask) | (c->value & c->mask);
+		e->banks[c->port].dat = shadow[c->port];
+		fagpio_barrier();
+		e->tail = tail + 1;
+	}
+}
+
+static void *engine_main(void *arg) {
+	struct fagpio_engine *e = arg;
+
+	if (e->cfg.kind == FAGPIO_ENGINE_OUTPUT)
+		run_output(e);
+	else
+		run_sample(e);
+	return NULL;
+}
+
+struct fagpio_engine *fagpio_engine_start(const struct fagpio_engine_config *cfg) {
+	struct pio_bank *banks = fagpio_banks();
+	struct fagpio_engine *e;
+	pthread_attr_t attr;
+	int err;
+
+	if (!banks || !cfg->ports || cfg->ports >> PIO_NPORTS || cfg->kind > FAGPIO_ENGINE_OUTPUT)
+		return NULL;
+	if (claim(&owned_ports, cfg->ports) < 0) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "engine: ports 0x%x already owned\n", cfg->ports & owned_ports);
+		return NULL;
+	}
+	if (!(e = fagpio_mem_take(cfg->arena, sizeof(*e), FAGPIO_CACHE_LINE))) {
+		release(&owned_ports, cfg->ports);
+		return NULL;
+	}
+	memset(e, 0, sizeof(*e));
+	e->cfg = *cfg;
+	e->banks = banks;
+	fagpio_ring_init(&e->events);
+	e->cpu = place(cfg->cpu);
+	if (e->cpu < 0 && cfg->cpu != FAGPIO_ENGINE_ANY_CPU)
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "engine: CPU %d taken or invalid, running unpinned\n", cfg->cpu);
+
+	pthread_attr_init(&attr);
+	if (e->cpu >= 0) {
+		cpu_set_t set;
+
+		CPU_ZERO(&set);
+		CPU_SET(e->cpu, &set);
+		pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+	}
+	if (cfg->prio > 0) {
+		struct sched_param sp = { .sched_priority = cfg->prio };
+
+		pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+		pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+		pthread_attr_setschedparam(&attr, &sp);
+	}
+	err = pthread_create(&e->thread, &attr, engine_main, e);
+	pthread_attr_destroy(&attr);
+	if (err) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "engine: %s\n", strerror(err));
+		if (e->cpu >= 0)
+			release(&owned_cpus, 1u << e->cpu);
+		release(&owned_ports, cfg->ports);
+		fagpio_mem_give(cfg->arena, e);
+		return NULL;
+	}
+	return e;
+}
+
+void fagpio_engine_stop(struct fagpio_engine *e) {
+	if (!e)
+		return;
+	e->stop = 1;
+	pthread_join(e->thread, NULL);
+	if (e->cpu >= 0)
+		release(&owned_cpus, 1u << e->cpu);
+	release(&owned_ports, e->cfg.ports);
+	fagpio_mem_give(e->cfg.arena, e);
+}
+
+int fagpio_engine_cpu(const struct fagpio_engine *e) {
+	return e->cpu;
+}
+
+struct fagpio_ring *fagpio_engine_events(struct fagpio_engine *e) {
+	return e->cfg.kind == FAGPIO_ENGINE_SAMPLE ? &e->events : NULL;
+}
+
+static int queue(struct fagpio_engine *e, uint8_t op, uint8_t port, uint32_t mask, uint32_t value, uint32_t at) {
+	uint32_t head = e->head;
+
+	if (e->cfg.kind != FAGPIO_ENGINE_OUTPUT || port >= PIO_NPORTS || !(e->cfg.ports & (1u << port)) ||
+		head - e->tail == FAGPIO_ENGINE_CMDS)
+		return -1;
+
+	struct engine_cmd *c = &e->cmd[head & (FAGPIO_ENGINE_CMDS - 1)];
+
+	c->op = op;
+	c->port = port;
+	c->mask = mask;
+	c->value = value;
+	c->at = at;
+	fagpio_barrier();
+	e->head = head + 1;
+	return 0;
+}
+
+int fagpio_engine_write(struct fagpio_engine *e, uint8_t port, uint32_t mask, uint32_t value, uint32_t at) {
+	return queue(e, CMD_WRITE, port, mask, value, at);
+}
+
+int fagpio_engine_toggle(struct fagpio_engine *e, uint8_t port, uint32_t mask, uint32_t at) {
+	return queue(e, CMD_TOGGLE, port, mask, 0, at);
+}
+
+unsigned int fagpio_engine_pending(const struct fagpio_engine *e) {
+	return e->head - e->tail;
+}
@@ -0,0 +1,76 @@
+#ifndef _FAGPIO_ENGINE_H
+#define _FAGPIO_ENGINE_H
+
+#include <stdint.h>
+#include "fagpio.h"
+#include "fagpio_ring.h"
+#include "fagpio_mem.h"
+
+/*
+ * I/O engines: threads that each own whole ports and run on a core of
+ * their own, for the multi-core SoCs with the same PIO (the H3's four
+ * Cortex-A7s). A sampling engine reads the DAT of its ports in a loop and
+ * pushes every change into its event ring (fagpio_ring.h); an output
+ * engine applies the writes and toggles queued to it with
+ * fagpio_engine_write(), each at its due counter value, from a DAT copy
+ * it keeps for its ports. Engines share no lock and no handle state:
+ * a port belongs to one engine, which is the only one to store to it,
+ * and each ring has one producer and one consumer. Other writers to an
+ * engine's ports (digitalWrite(), drivers) would race its stores.
+ *
+ * cpu FAGPIO_ENGINE_ANY_CPU places the engine on the highest-numbered CPU
+ * of the process's affinity mask that no engine holds, leaving CPU 0 to
+ * the caller and the interrupts; with none left (a single core) the
+ * engine runs unpinned. idle_us makes an output engine sleep that long
+ * when its queue is empty and a sampling engine between sweeps; 0 spins,
+ * which only suits a core of its own. Build with -DFAGPIO_CACHE_LINE=64
+ * for the Cortex-A7 so ring heads and tails do not share a line.
+ */
+
+#define FAGPIO_ENGINE_SAMPLE	0
+#define FAGPIO_ENGINE_OUTPUT	1
+
+#define FAGPIO_ENGINE_ANY_CPU	-1
+#ifndef FAGPIO_ENGINE_CMDS
+#define FAGPIO_ENGINE_CMDS		256		//Queued writes per output engine, power of two
+#endif
+
+struct fagpio_engine_config {
+	int kind;					//FAGPIO_ENGINE_*
+	uint32_t ports;				//Bit n owns port n
+	uint32_t mask[PIO_NPORTS];	//Sampling: pins watched per port, 0 for all
+	int cpu;					//CPU number or FAGPIO_ENGINE_ANY_CPU
+	int prio;					//SCHED_FIFO priority, 0 for SCHED_OTHER
+	unsigned int idle_us;
+	struct fagpio_arena *arena;	//Holds the engine, NULL for fagpio_mem_alloc() (fagpio_mem.h)
+};
+
+struct fagpio_engine;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// NULL if a port is held by another engine or the thread could not start
+struct fagpio_engine *fagpio_engine_start(const struct fagpio_engine_config *cfg);
+void fagpio_engine_stop(struct fagpio_engine *e);
+int fagpio_engine_cpu(const struct fagpio_engine *e);		//-1 when unpinned
+
+// Sampling engines: the consumer side is the caller's (fagpio_ring_pop())
+struct fagpio_ring *fagpio_engine_events(struct fagpio_engine *e);
+
+/*
+ * Output engines, from one producer thread: DAT bits in mask of port become
+ * value (toggle: are inverted) once fagpio_ticks() reaches at, 0 for
+ * now; keep at non-decreasing. -1 if the port is not the engine's or
+ * the queue is full.
+ */
+int fagpio_engine_write(struct fagpio_engine *e, uint8_t port, uint32_t mask, uint32_t value, uint32_t at);
+int fagpio_engine_toggle(struct fagpio_engine *e, uint8_t port, uint32_t mask, uint32_t at);
+unsigned int fagpio_engine_pending(const struct fagpio_engine *e);	//Writes not yet applied
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,217 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "fagpio_priv.h"
+#include "fagpio_failsafe.h"
+#include "fagpio_log.h"
+#include "fagpio_soc.h"
+
+// Pre-merged per port: apply() only combines them with the saved bank
+struct failsafe_map {
+	volatile uint32_t armed;
+	uint32_t dat_mask[PIO_NPORTS], dat[PIO_NPORTS];
+	uint32_t cfg_mask[PIO_NPORTS][4], cfg[PIO_NPORTS][4];
+	uint32_t pull_mask[PIO_NPORTS][2], pull[PIO_NPORTS][2];
+};
+
+static const int fatal_signals[] = { SIGINT, SIGTERM, SIGHUP, SIGQUIT, SIGABRT, SIGSEGV, SIGBUS, SIGFPE, SIGILL };
+
+static struct failsafe_map *map;
+static struct sigaction old_action[sizeof(fatal_signals) / sizeof(fatal_signals[0])];
+static pid_t supervisor;
+static int supervisor_fd = -1;
+static int at_exit;
+
+// Shared so a forked supervisor sees later changes
+static struct failsafe_map *get_map(void) {
+	if (!map) {
+		void *p = mmap(NULL, sizeof(*map), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+		if (p == MAP_FAILED)
+			return NULL;
+		map = p;
+	}
+	return map;
+}
+
+int fagpio_failsafe_set(uint8_t pin, uint8_t mode, uint8_t value) {
+	struct failsafe_map *m = get_map();
+	uint8_t port = PIO_PIN_PORT(pin), n = PIO_PIN_NUM(pin);
+
+	if (!m || n >= fagpio_port_pins(port) || mode > DISABLE)
+		return -1;
+	if ((mode == OUTPUT && value > 1) || (mode == INPUT && value > PULL_DOWN))
+		return -1;
+
+	uint32_t fn = mode == OUTPUT ? 1 : mode == INPUT ? 0 : 7;
+	uint32_t cfg_field = 15u << ((n % 8) * 4), pull_field = 3u << ((n % 16) * 2);
+
+	// Half-updated entries are never applied: the pin is masked out first
+	m->dat_mask[port] &= ~PIO_PIN_MASK(pin);
+	m->cfg_mask[port][n / 8] &= ~cfg_field;
+	m->pull_mask[port][n / 16] &= ~pull_field;
+	__sync_synchronize();
+
+	m->cfg[port][n / 8] = (m->cfg[port][n / 8] & ~cfg_field) | (fn << ((n % 8) * 4));
+	if (mode == OUTPUT)
+		m->dat[port] = (m->dat[port] & ~PIO_PIN_MASK(pin)) | (value ? PIO_PIN_MASK(pin) : 0);
+	else if (mode == INPUT)
+		m->pull[port][n / 16] = (m->pull[port][n / 16] & ~pull_field) | ((uint32_t)value << ((n % 16) * 2));
+	__sync_synchronize();
+
+	m->cfg_mask[port][n / 8] |= cfg_field;
+	if (mode == OUTPUT)
+		m->dat_mask[port] |= PIO_PIN_MASK(pin);
+	else if (mode == INPUT)
+		m->pull_mask[port][n / 16] |= pull_field;
+	return 0;
+}
+
+void fagpio_failsafe_clear(uint8_t pin) {
+	uint8_t port = PIO_PIN_PORT(pin), n = PIO_PIN_NUM(pin);
+
+	if (!map || port >= PIO_NPORTS)
+		return;
+	map->dat_mask[port] &= ~PIO_PIN_MASK(pin);
+	map->cfg_mask[port][n / 8] &= ~(15u << ((n % 8) * 4));
+	map->pull_mask[port][n / 16] &= ~(3u << ((n % 16) * 2));
+}
+
+// Plain loads and stores only: safe in signal handlers and the supervisor
+int fagpio_failsafe_apply(void) {
+	fagpio_t *h = fagpio_default();
+	struct fagpio_bank_state st;
+	struct failsafe_map *m = map;
+
+	if (!m)
+		return 0;
+	for (uint8_t port = 0; port < PIO_NPORTS; port++) {
+		if (!(m->cfg_mask[port][0] | m->cfg_mask[port][1] | m->cfg_mask[port][2] | m->cfg_mask[port][3]))
+			continue;
+		if (fagpio_port_save(h, port, &st) < 0)
+			return -1;
+		st.dat = (st.dat & ~m->dat_mask[port]) | (m->dat[port] & m->dat_mask[port]);
+		for (unsigned int i = 0; i < 4; i++)
+			st.cfg[i] = (st.cfg[i] & ~m->cfg_mask[port][i]) | (m->cfg[port][i] & m->cfg_mask[port][i]);
+		for (unsigned int i = 0; i < 2; i++)
+			st.pull[i] = (st.pull[i] & ~m->pull_mask[port][i]) | (m->pull[port][i] & m->pull_mask[port][i]);
+		fagpio_port_restore(h, port, &st);
+	}
+	return 0;
+}
+
+static void on_fatal(int sig) {
+	if (map && map->armed)
+		fagpio_failsafe_apply();
+	for (unsigned int i = 0; i < sizeof(fatal_signals) / sizeof(fatal_signals[0]); i++) {
+		if (fatal_signals[i] == sig)
+			sigaction(sig, &old_action[i], NULL);
+	}
+	raise(sig);		//Delivered with the previous action once this handler returns
+}
+
+// Also called by fagpio_free() while the registers are still mapped
+void fagpio_failsafe_on_free(void) {
+	if (map && map->armed)
+		fagpio_failsafe_apply();
+}
+
+/*
+The supervisor holds the read end of a pipe whose write end only the
+process has: read() returns 0 once the process is gone, however it died.
+It ignores the terminal and service-manager signals sent to the whole
+group, so it outlives the process it watches.
+*/
+static void supervise(int fd) {
+	char c;
+
+	signal(SIGINT, SIG_IGN);
+	signal(SIGTERM, SIG_IGN);
+	signal(SIGHUP, SIG_IGN);
+	signal(SIGQUIT, SIG_IGN);
+	for (int i = 3; i < 1024; i++) {
+		if (i != fd)
+			close(i);
+	}
+	while (read(fd, &c, 1) < 0 && errno == EINTR)
+		;
+	if (map->armed)
+		fagpio_failsafe_apply();
+	_exit(0);
+}
+
+static int start_supervisor(void) {
+	int fds[2];
+
+	if (supervisor)
+		return 0;
+	if (pipe(fds) < 0)
+		return -1;
+	fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+
+	pid_t pid = fork();
+
+	if (pid < 0) {
+		close(fds[0]);
+		close(fds[1]);
+		return -1;
+	}
+	if (!pid) {
+		close(fds[1]);
+		supervise(fds[0]);
+	}
+	close(fds[0]);
+	supervisor = pid;
+	supervisor_fd = fds[1];
+	return 0;
+}
+
+int fagpio_failsafe_install(unsigned int flags) {
+	if (!fagpio_banks() || !get_map())
+		return -1;
+	map->armed = 1;
+	if (!at_exit && atexit(fagpio_failsafe_on_free) == 0)
+		at_exit = 1;
+
+	if (flags & FAGPIO_FAILSAFE_SIGNALS) {
+		struct sigaction sa;
+
+		memset(&sa, 0, sizeof(sa));
+		sa.sa_handler = on_fatal;
+		sigfillset(&sa.sa_mask);
+		for (unsigned int i = 0; i < sizeof(fatal_signals) / sizeof(fatal_signals[0]); i++) {
+			struct sigaction cur;
+
+			sigaction(fatal_signals[i], NULL, &cur);
+			if (cur.sa_handler != on_fatal) {
+				old_action[i] = cur;
+				sigaction(fatal_signals[i], &sa, NULL);
+			}
+		}
+	}
+	if ((flags & FAGPIO_FAILSAFE_SUPERVISOR) && start_supervisor() < 0) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "fail-safe supervisor: %s\n", strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+void fagpio_failsafe_disarm(void) {
+	if (map)
+		map->armed = 0;
+	if (supervisor_fd >= 0) {
+		close(supervisor_fd);		//Wakes the supervisor, which finds the map disarmed
+		waitpid(supervisor, NULL, 0);
+		supervisor_fd = -1;
+		supervisor = 0;
+	}
+}
+
+pid_t fagpio_failsafe_supervisor(void) {
+	return supervisor;
+}
@@ -0,0 +1,43 @@
+#ifndef _FAGPIO_FAILSAFE_H
+#define _FAGPIO_FAILSAFE_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ * Fail-safe outputs. Registered pins get a safe state (output level, or
+ * input with a pull, or disabled) that is merged into each port's CFG,
+ * DAT and PULL masks when it is set, so applying it is one bank save and
+ * one bank restore per port (fagpio_port_save/fagpio_port_restore): a
+ * few microseconds, and async-signal-safe.
+ *
+ * Armed with fagpio_failsafe_install(), the map is applied by fagpio_free()
+ * and at exit; FAGPIO_FAILSAFE_SIGNALS also applies it on fatal signals
+ * before they take their usual action. A process killed outright
+ * (SIGKILL, the OOM killer) runs no handler: FAGPIO_FAILSAFE_SUPERVISOR
+ * forks a small supervisor that sleeps on a pipe and applies the map when
+ * the process is gone, through the mapping it inherited. The map lives in
+ * a shared page, so pins set after the fork are seen by the supervisor.
+ */
+
+#define FAGPIO_FAILSAFE_SIGNALS		0x01
+#define FAGPIO_FAILSAFE_SUPERVISOR	0x02
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// mode OUTPUT drives value (0/1), INPUT applies the pull in value, DISABLE switches the pin off
+int fagpio_failsafe_set(uint8_t pin, uint8_t mode, uint8_t value);
+void fagpio_failsafe_clear(uint8_t pin);
+
+int fagpio_failsafe_install(unsigned int flags);
+void fagpio_failsafe_disarm(void);		//Clean shutdown: nothing is applied, the supervisor exits
+int fagpio_failsafe_apply(void);		//Applies the map now, -1 if the registers are not mapped
+pid_t fagpio_failsafe_supervisor(void);	//0 if none
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
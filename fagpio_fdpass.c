@@ -0,0 +1,88 @@
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "fagpio.h"
+#include "fagpio_fdpass.h"
+#include "fagpio_log.h"
+
+static int fd_socket_addr(const char *path, struct sockaddr_un *addr) {
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr->sun_path))
+		return -1;
+	strcpy(addr->sun_path, path);
+	return 0;
+}
+
+int fagpio_fd_recv(const char *path) {
+	struct sockaddr_un addr;
+	char byte;
+	char control[CMSG_SPACE(sizeof(int))];
+	struct iovec iov = {&byte, 1};
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	int sock, fd = -1;
+
+	if (fd_socket_addr(path, &addr) < 0)
+		return -1;
+	if ((sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0)
+		return -1;
+	if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		close(sock);
+		return -1;
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	if (recvmsg(sock, &msg, 0) == 1) {
+		cmsg = CMSG_FIRSTHDR(&msg);
+		if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+			memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+	}
+	close(sock);
+	return fd;
+}
+
+int fagpio_fd_serve(const char *path, int fd) {
+	struct sockaddr_un addr;
+	int sock;
+
+	if (fd_socket_addr(path, &addr) < 0)
+		return -1;
+	if ((sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0)
+		return -1;
+	unlink(path);
+	if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(sock, 16) < 0) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "%s: cannot listen\n", path);
+		close(sock);
+		return -1;
+	}
+
+	for (;;) {
+		char byte = 0;
+		char control[CMSG_SPACE(sizeof(int))];
+		struct iovec iov = {&byte, 1};
+		struct msghdr msg;
+		struct cmsghdr *cmsg;
+		int client = accept(sock, NULL, NULL);
+
+		if (client < 0)
+			continue;
+
+		memset(&msg, 0, sizeof(msg));
+		memset(control, 0, sizeof(control));
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+		memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+		sendmsg(client, &msg, MSG_NOSIGNAL);
+		close(client);
+	}
+}
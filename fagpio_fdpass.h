@@ -0,0 +1,28 @@
+#ifndef _FAGPIO_FDPASS_H
+#define _FAGPIO_FDPASS_H
+
+/*
+ * Hands an already opened /dev/mem fd to other processes over a Unix
+ * socket (SCM_RIGHTS). A long-running helper (tools/fdhelper) opens
+ * /dev/mem once; processes started with FAGPIO_FD_SOCKET=<path> receive
+ * that fd in fagpio_setup() instead of opening /dev/mem themselves, which
+ * also lets them run without root.
+ *
+ * The fd is /dev/mem itself, not a view of the GPIOs: whoever receives it
+ * can map and write any physical address, kernel memory included, which
+ * is the same as root. Only give the socket to users you would give root.
+ */
+#define FAGPIO_FD_SOCKET	"/run/fagpio.sock"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fagpio_fd_recv(const char *path);			//Returns the received fd or -1
+int fagpio_fd_serve(const char *path, int fd);	//Serves fd to every client, only returns on error
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,301 @@
+#include <string.h>
+#include "fagpio_priv.h"
+#include "fagpio_flash.h"
+#include "fagpio_spi.h"
+#include "fagpio_crc.h"
+#include "fagpio_timer.h"
+#include "fagpio_log.h"
+
+#define NOR_JEDEC_ID		0x9F
+#define NOR_FAST_READ		0x0B		//Address, one dummy byte, data
+#define NOR_FAST_READ4		0x0C		//Same with a 4-byte address
+#define SPI_MAX_BURST		0xFFFFFF	//fagpio_spi_transfer() limit
+
+#define SD_INIT_HZ			400000
+#define SD_INIT_MS			1000		//ACMD41 retries, the spec allows a card one second
+#define SD_TOKEN			0xFE		//Start of a data block
+#define SD_R1_IDLE			0x01
+#define SD_R1_ILLEGAL		0x04
+
+// MOSI stays high while an SD card sends; the received bytes go straight to the caller
+static const uint8_t ones[FAGPIO_SD_BLOCK] = { [0 ... FAGPIO_SD_BLOCK - 1] = 0xFF };
+
+static void chip_select(struct fagpio_flash *f, uint8_t active) {
+	if (f->bus == FAGPIO_FLASH_BB)
+		fagpio_digital_write(fagpio_default(), f->cs, !active);
+	else
+		fagpio_spi_select(f->bus, active);
+}
+
+static int xfer(struct fagpio_flash *f, const uint8_t *tx, uint8_t *rx, size_t len) {
+	if (f->bus == FAGPIO_FLASH_BB) {
+		fagpio_bbspi_transfer(&f->bb, tx, rx, len);
+		return 0;
+	}
+	while (len) {
+		size_t n = len < SPI_MAX_BURST ? len : SPI_MAX_BURST;
+
+		if (fagpio_spi_transfer(f->bus, tx, rx, n) < 0)
+			return -1;
+		if (tx)
+			tx += n;
+		if (rx)
+			rx += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static int set_rate(struct fagpio_flash *f, uint32_t hz) {
+	if (f->bus == FAGPIO_FLASH_BB)
+		return fagpio_bbspi_init(&f->bb, f->sck, f->mosi, f->miso, f->mode, hz);
+	if (fagpio_spi_open(f->bus, hz, f->mode) < 0)
+		return -1;
+	fagpio_spi_select(f->bus, 0);
+	return 0;
+}
+
+int fagpio_flash_open(struct fagpio_flash *f, uint8_t bus, uint32_t hz, uint8_t mode) {
+	memset(f, 0, sizeof(*f));
+	f->bus = bus;
+	f->hz = hz;
+	f->mode = mode;
+	if (bus > 1)
+		return -1;
+	return set_rate(f, hz);
+}
+
+int fagpio_flash_open_bb(struct fagpio_flash *f, uint8_t sck, uint8_t mosi, uint8_t miso, uint8_t cs, uint32_t hz, uint8_t mode) {
+	memset(f, 0, sizeof(*f));
+	f->bus = FAGPIO_FLASH_BB;
+	f->sck = sck;
+	f->mosi = mosi;
+	f->miso = miso;
+	f->cs = cs;
+	f->hz = hz;
+	f->mode = mode;
+	if (PIO_PIN_PORT(cs) >= PIO_NPORTS || set_rate(f, hz) < 0)
+		return -1;
+	fagpio_digital_write(fagpio_default(), cs, HIGH);
+	pinMode(cs, OUTPUT);
+	return 0;
+}
+
+int fagpio_flash_probe(struct fagpio_flash *f) {
+	uint8_t cmd[4] = { NOR_JEDEC_ID }, rx[4];
+	int ret;
+
+	chip_select(f, 1);
+	ret = xfer(f, cmd, rx, sizeof(cmd));
+	chip_select(f, 0);
+	if (ret < 0 || (rx[1] == 0xFF && rx[2] == 0xFF) || (!rx[1] && !rx[2]))
+		return -1;
+
+	memcpy(f->id, rx + 1, 3);
+	f->size = f->id[2] >= 0x10 && f->id[2] < 0x20 ? 1u << f->id[2] : 0;	//Capacity byte is log2 of the size on most parts
+	f->addr4 = f->size > (1u << 24);
+	FAGPIO_LOG(FAGPIO_LOG_INFO, "SPI flash %02x %02x %02x, %u KiB\n", f->id[0], f->id[1], f->id[2], f->size >> 10);
+	return 0;
+}
+
+// The command and the data are two transfers under one chip select
+int fagpio_flash_read(struct fagpio_flash *f, uint32_t addr, void *buf, size_t len) {
+	uint8_t cmd[6];
+	unsigned int n = 0;
+	int ret;
+
+	if (f->size && (addr >= f->size || len > f->size - addr))
+		return -1;
+	cmd[n++] = f->addr4 ? NOR_FAST_READ4 : NOR_FAST_READ;
+	if (f->addr4)
+		cmd[n++] = addr >> 24;
+	cmd[n++] = addr >> 16;
+	cmd[n++] = addr >> 8;
+	cmd[n++] = addr;
+	cmd[n++] = 0;		//Dummy byte
+	chip_select(f, 1);
+	ret = xfer(f, cmd, NULL, n);
+	if (!ret)
+		ret = xfer(f, NULL, buf, len);
+	chip_select(f, 0);
+	return ret;
+}
+
+void fagpio_flash_readahead(struct fagpio_flash *f, void *window, size_t size) {
+	f->ra = window;
+	f->ra_size = window ? size : 0;
+	f->ra_len = 0;
+}
+
+const uint8_t *fagpio_flash_map(struct fagpio_flash *f, uint32_t addr, size_t *len) {
+	size_t fill;
+
+	if (!f->ra || !f->ra_size)
+		return NULL;
+	if (addr - f->ra_addr < f->ra_len) {
+		*len = f->ra_len - (addr - f->ra_addr);
+		return f->ra + (addr - f->ra_addr);
+	}
+
+	fill = f->ra_size;
+	if (f->size) {
+		if (addr >= f->size)
+			return NULL;
+		if (fill > f->size - addr)
+			fill = f->size - addr;
+	}
+	f->ra_len = 0;
+	if (fagpio_flash_read(f, addr, f->ra, fill) < 0)
+		return NULL;
+	f->ra_addr = addr;
+	f->ra_len = fill;
+	*len = fill;
+	return f->ra;
+}
+
+static uint8_t sd_byte(struct fagpio_flash *f) {
+	uint8_t b = 0xFF;
+
+	xfer(f, ones, &b, 1);
+	return b;
+}
+
+// Until the card releases MISO (0xFF), or with token until it sends anything else
+static int sd_wait(struct fagpio_flash *f, uint8_t *got, int token) {
+	uint32_t limit = fagpio_tick_hz / 1000 * FAGPIO_SD_TIMEOUT_MS, start = fagpio_ticks();
+	uint8_t b;
+
+	do {
+		b = sd_byte(f);
+		if (token ? b != 0xFF : b == 0xFF) {
+			if (got)
+				*got = b;
+			return 0;
+		}
+	} while (fagpio_ticks() - start < limit);
+	return -1;
+}
+
+// R1, 0xFF if the card did not answer; chip select stays low for the response bytes after it
+static uint8_t sd_cmd(struct fagpio_flash *f, uint8_t cmd, uint32_t arg) {
+	uint8_t frame[6] = { 0x40 | cmd, arg >> 24, arg >> 16, arg >> 8, arg }, r1 = 0xFF;
+
+	frame[5] = fagpio_crc7(FAGPIO_CRC7_INIT, frame, 5) << 1 | 1;
+	chip_select(f, 1);
+	if (cmd && cmd != 12 && sd_wait(f, NULL, 0) < 0)		//STOP_TRANSMISSION interrupts a data block
+		return 0xFF;
+	xfer(f, frame, NULL, sizeof(frame));
+	if (cmd == 12)
+		sd_byte(f);		//Stuff byte after STOP_TRANSMISSION
+	for (int i = 0; i < 8 && (r1 & 0x80); i++)
+		r1 = sd_byte(f);
+	return r1;
+}
+
+static void sd_end(struct fagpio_flash *f) {
+	chip_select(f, 0);
+	sd_byte(f);		//Lets the card release MISO
+}
+
+/*
+Power-up clocks with CS high, GO_IDLE_STATE, then SEND_IF_COND tells a v2
+card from a v1 one; SD_SEND_OP_COND is repeated until the card leaves
+idle, and READ_OCR on a v2 card says whether it is block addressed.
+CRC_ON_OFF last makes the card check command CRCs and lets the reads
+check the CRC16 after each block.
+*/
+int fagpio_sd_init(struct fagpio_flash *f) {
+	uint32_t limit, start;
+	uint8_t r1, r7[4], v2;
+
+	if (set_rate(f, SD_INIT_HZ) < 0)
+		return -1;
+	chip_select(f, 0);
+	for (int i = 0; i < 10; i++)
+		sd_byte(f);
+
+	r1 = sd_cmd(f, 0, 0);
+	sd_end(f);
+	if (r1 != SD_R1_IDLE) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "SD: no card (CMD0 %02x)\n", r1);
+		return -1;
+	}
+
+	r1 = sd_cmd(f, 8, 0x1AA);
+	v2 = !(r1 & SD_R1_ILLEGAL);
+	if (v2)
+		xfer(f, ones, r7, sizeof(r7));
+	sd_end(f);
+	if (v2 && (r7[2] & 0x0F) != 0x01) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "SD: card refuses 3.3 V\n");
+		return -1;
+	}
+
+	limit = fagpio_tick_hz / 1000 * SD_INIT_MS;
+	start = fagpio_ticks();
+	do {
+		r1 = sd_cmd(f, 55, 0);
+		sd_end(f);
+		r1 = sd_cmd(f, 41, v2 ? 0x40000000 : 0);
+		sd_end(f);
+	} while (r1 == SD_R1_IDLE && fagpio_ticks() - start < limit);
+	if (r1) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "SD: card did not leave idle (ACMD41 %02x)\n", r1);
+		return -1;
+	}
+
+	f->sd_hc = 0;
+	if (v2 && !sd_cmd(f, 58, 0)) {
+		uint8_t ocr[4];
+
+		xfer(f, ones, ocr, sizeof(ocr));
+		f->sd_hc = (ocr[0] & 0x40) != 0;
+	}
+	sd_end(f);
+	if (!f->sd_hc) {
+		r1 = sd_cmd(f, 16, FAGPIO_SD_BLOCK);
+		sd_end(f);
+		if (r1)
+			return -1;
+	}
+	r1 = sd_cmd(f, 59, 1);
+	sd_end(f);
+	f->sd_crc = !r1;
+	FAGPIO_LOG(FAGPIO_LOG_INFO, "SD: %s card%s\n", f->sd_hc ? "block addressed" : "byte addressed", f->sd_crc ? "" : ", no CRC checks");
+	return set_rate(f, f->hz);
+}
+
+// READ_MULTIPLE_BLOCK for more than one block: a data token before each, STOP_TRANSMISSION after
+int fagpio_sd_read(struct fagpio_flash *f, uint32_t block, void *buf, uint32_t count) {
+	uint8_t *p = buf, token, crc[2];
+	int ret = 0;
+
+	if (!count)
+		return 0;
+	if (sd_cmd(f, count > 1 ? 18 : 17, f->sd_hc ? block : block * FAGPIO_SD_BLOCK)) {
+		sd_end(f);
+		return -1;
+	}
+	for (uint32_t i = 0; i < count; i++, p += FAGPIO_SD_BLOCK) {
+		if (sd_wait(f, &token, 1) < 0 || token != SD_TOKEN) {
+			FAGPIO_LOG(FAGPIO_LOG_ERR, "SD: no data for block %u\n", block + i);
+			ret = -1;
+			break;
+		}
+		if (xfer(f, ones, p, FAGPIO_SD_BLOCK) < 0 || xfer(f, ones, crc, sizeof(crc)) < 0) {
+			ret = -1;
+			break;
+		}
+		if (f->sd_crc && fagpio_crc16_ccitt(FAGPIO_CRC16_CCITT_INIT, p, FAGPIO_SD_BLOCK) != (crc[0] << 8 | crc[1])) {
+			FAGPIO_LOG(FAGPIO_LOG_ERR, "SD: CRC error in block %u\n", block + i);
+			ret = -1;
+			break;
+		}
+	}
+	if (count > 1) {
+		sd_cmd(f, 12, 0);
+		sd_wait(f, NULL, 0);
+	}
+	sd_end(f);
+	return ret;
+}
@@ -0,0 +1,75 @@
+#ifndef _FAGPIO_FLASH_H
+#define _FAGPIO_FLASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fagpio_bbspi.h"
+
+/*
+ * Reading SPI NOR flash and SD cards in SPI mode, on a hardware SPI
+ * controller (fagpio_spi.h, SS held by the driver) or on bit-banged SPI
+ * with a chip select pin. Data goes straight from the bus into the
+ * caller's buffer, which may be an mmap()ed file or a DMA buffer: the
+ * command is one transfer and the data another, with chip select held
+ * between them, so nothing is staged.
+ *
+ * NOR reads are one FAST_READ (0x0B, 0x0C with 4-byte addresses above
+ * 16 MB) of any length. SD reads of several blocks are one CMD18 with a
+ * CMD12 at the end; block addresses are in 512-byte blocks on every card.
+ * Commands carry their CRC7 and each block's CRC16 is checked
+ * (fagpio_crc.h).
+ *
+ * With a read-ahead window (caller storage, a mmap()ed area works too)
+ * fagpio_flash_map() returns a pointer into the window and refills it
+ * with one FAST_READ of the whole window when the address leaves it, so
+ * a sequential dump is a few long bursts however small its steps.
+ */
+
+#define FAGPIO_FLASH_BB			0xFF		//bus of a bit-banged flash
+#define FAGPIO_SD_BLOCK			512
+
+#ifndef FAGPIO_SD_TIMEOUT_MS
+#define FAGPIO_SD_TIMEOUT_MS	250			//Card busy or data token wait
+#endif
+
+struct fagpio_flash {
+	uint8_t bus;			//0, 1 or FAGPIO_FLASH_BB
+	uint8_t sck, mosi, miso;	//Pins of FAGPIO_FLASH_BB
+	uint8_t cs;				//Its chip select, active low
+	uint8_t mode;
+	uint8_t addr4;			//4-byte addresses
+	uint8_t sd_hc;			//SD addressed in blocks (SDHC/SDXC)
+	uint8_t sd_crc;			//SD CRCs on, read blocks are checked
+	uint32_t hz;
+	uint32_t size;			//Bytes from the JEDEC ID, 0 if unknown
+	uint8_t id[3];			//JEDEC manufacturer, type, capacity
+	struct fagpio_bbspi bb;
+	uint8_t *ra;			//Read-ahead window, NULL without
+	size_t ra_size;
+	size_t ra_len;			//Valid bytes in the window
+	uint32_t ra_addr;		//Flash address of ra[0]
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fagpio_flash_open(struct fagpio_flash *f, uint8_t bus, uint32_t hz, uint8_t mode);
+int fagpio_flash_open_bb(struct fagpio_flash *f, uint8_t sck, uint8_t mosi, uint8_t miso, uint8_t cs, uint32_t hz, uint8_t mode);
+
+// NOR: reads the JEDEC ID and sizes the flash, 0 if it answered
+int fagpio_flash_probe(struct fagpio_flash *f);
+int fagpio_flash_read(struct fagpio_flash *f, uint32_t addr, void *buf, size_t len);
+
+void fagpio_flash_readahead(struct fagpio_flash *f, void *window, size_t size);	//window NULL turns it off
+const uint8_t *fagpio_flash_map(struct fagpio_flash *f, uint32_t addr, size_t *len);	//*len bytes at addr, NULL on error
+
+// SD, opened in mode 0: init runs at 400 kHz, then switches to the open rate
+int fagpio_sd_init(struct fagpio_flash *f);
+int fagpio_sd_read(struct fagpio_flash *f, uint32_t block, void *buf, uint32_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
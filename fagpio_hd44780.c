@@ -0,0 +1,218 @@
+#include <string.h>
+#include <unistd.h>
+#include "fagpio_priv.h"
+#include "fagpio_hd44780.h"
+#include "fagpio_timer.h"
+
+#define E_PULSE_NS		450		//PWEH, also covers tDDR before a read
+#define E_CYCLE_NS		1000	//tcycE
+
+static inline void hold(uint32_t ticks) {
+	if (ticks)
+		fagpio_delay_cycles(ticks);
+}
+
+// Data is latched on the falling edge of E, so it can go out with the rising one
+static inline void strobe(struct fagpio_hd44780 *lcd, uint32_t word) {
+	*lcd->dat = word | lcd->e;
+	hold(lcd->pulse);
+	*lcd->dat = word;
+	hold(lcd->cycle);
+}
+
+static void data_dir(struct fagpio_hd44780 *lcd, int out) {
+	for (unsigned int w = lcd->cfg_lo; w <= lcd->cfg_hi; w++)
+		lcd->cfg[w] = (lcd->cfg[w] & ~lcd->field[w]) | (out ? lcd->out[w] : 0);
+}
+
+/*
+The data pins turn to inputs before RW goes high and back to outputs
+after it is low again, so the two sides never drive together. In 4-bit
+mode the second nibble (the low bits of the address counter) is clocked
+out and dropped.
+*/
+static int wait_ready(struct fagpio_hd44780 *lcd) {
+	uint32_t base, start, v;
+
+	if (!lcd->rw)
+		return 0;
+	base = (*lcd->dat & ~lcd->mask) | lcd->rw;
+	data_dir(lcd, 0);
+	*lcd->dat = base;
+	start = fagpio_ticks();
+	do {
+		*lcd->dat = base | lcd->e;
+		hold(lcd->pulse);
+		v = *lcd->dat;
+		*lcd->dat = base;
+		hold(lcd->cycle);
+		if (lcd->bits == 4)
+			strobe(lcd, base);
+	} while ((v & lcd->busy) && fagpio_ticks() - start <= lcd->busy_ticks);
+	*lcd->dat = base & ~lcd->rw;
+	data_dir(lcd, 1);
+	return v & lcd->busy ? -1 : 0;
+}
+
+static int write_byte(struct fagpio_hd44780 *lcd, uint32_t rs, uint8_t b) {
+	uint32_t base;
+
+	if (wait_ready(lcd) < 0)
+		return -1;
+	base = (*lcd->dat & ~lcd->mask) | rs;
+	if (lcd->bits == 8) {
+		strobe(lcd, base | (uint32_t)b << lcd->shift);
+	} else {
+		strobe(lcd, base | (uint32_t)(b >> 4) << lcd->shift);
+		strobe(lcd, base | (uint32_t)(b & 15) << lcd->shift);
+	}
+	if (!lcd->rw) {
+		if (!rs && b < FAGPIO_HD44780_ENTRY)
+			usleep(FAGPIO_HD44780_HOME_US);
+		else
+			fagpio_delay_ns(FAGPIO_HD44780_EXEC_US * 1000);
+	}
+	return 0;
+}
+
+static int command(struct fagpio_hd44780 *lcd, uint8_t cmd) {
+	int ret = write_byte(lcd, 0, cmd);
+
+	fagpio_shadow_sync(lcd->port);
+	return ret;
+}
+
+// Row 2 continues row 0 in DDRAM and row 3 row 1, as on 16x4 and 20x4 modules
+static uint8_t ddram_addr(const struct fagpio_hd44780 *lcd, unsigned int col, unsigned int row) {
+	return (row & 1) * 0x40 + (row >> 1) * lcd->cols + col;
+}
+
+int fagpio_hd44780_init(struct fagpio_hd44780 *lcd, uint8_t d0, uint8_t bits, uint8_t rs, uint8_t rw, uint8_t e,
+		uint8_t cols, uint8_t rows) {
+	struct pio_bank *banks = fagpio_banks();
+	uint8_t port = PIO_PIN_PORT(d0), function = FAGPIO_HD44780_FUNCTION | (rows > 1 ? 8 : 0);
+	uint32_t base;
+
+	memset(lcd, 0, sizeof(*lcd));
+	if (!banks || (bits != 4 && bits != 8) || port >= PIO_NPORTS || PIO_PIN_NUM(d0) + bits > 32)
+		return -1;
+	if (!cols || !rows || rows > 4 || cols * rows > FAGPIO_HD44780_MAX)
+		return -1;
+	if (PIO_PIN_PORT(rs) != port || PIO_PIN_PORT(e) != port || (rw != FAGPIO_HD44780_NO_PIN && PIO_PIN_PORT(rw) != port))
+		return -1;
+
+	lcd->port = port;
+	lcd->dat = &banks[port].dat;
+	lcd->cfg = banks[port].cfg;
+	lcd->shift = PIO_PIN_NUM(d0);
+	lcd->bits = bits;
+	lcd->cols = cols;
+	lcd->rows = rows;
+	lcd->rs = PIO_PIN_MASK(rs);
+	lcd->e = PIO_PIN_MASK(e);
+	lcd->rw = rw != FAGPIO_HD44780_NO_PIN ? PIO_PIN_MASK(rw) : 0;
+	lcd->data = ((1u << bits) - 1) << lcd->shift;
+	lcd->busy = 1u << (lcd->shift + bits - 1);
+	if ((lcd->data & (lcd->rs | lcd->e | lcd->rw)) || lcd->rs == lcd->e || (lcd->rw & (lcd->rs | lcd->e)))
+		return -1;
+	lcd->mask = lcd->data | lcd->rs | lcd->rw | lcd->e;
+	lcd->cfg_lo = lcd->shift >> 3;
+	lcd->cfg_hi = (lcd->shift + bits - 1) >> 3;
+	for (unsigned int n = lcd->shift; n < lcd->shift + bits; n++) {
+		lcd->field[n >> 3] |= 15u << (n & 7) * 4;
+		lcd->out[n >> 3] |= 1u << (n & 7) * 4;
+	}
+	lcd->pulse = fagpio_ns_to_ticks(E_PULSE_NS);
+	lcd->cycle = fagpio_ns_to_ticks(E_CYCLE_NS - E_PULSE_NS);
+	lcd->busy_ticks = (uint64_t)FAGPIO_HD44780_BUSY_US * fagpio_tick_hz / 1000000;
+	lcd->addr = 0xFF;
+
+	digitalWritePort(port, lcd->mask, 0);
+	pinModeMask(port, lcd->mask, OUTPUT);
+
+	/*
+	Initialisation by instruction: three 8-bit function sets whatever mode
+	the controller powered up or was left in, then the switch to 4 bits.
+	The busy flag cannot be checked before the last of them.
+	*/
+	usleep(50000);
+	base = *lcd->dat & ~lcd->mask;
+	for (unsigned int i = 0; i < 3; i++) {
+		strobe(lcd, base | (bits == 8 ? 0x30u : 0x3u) << lcd->shift);
+		usleep(i ? 150 : 4500);
+	}
+	if (bits == 4) {
+		strobe(lcd, base | 0x2u << lcd->shift);
+		usleep(150);
+	} else {
+		function |= 0x10;
+	}
+	fagpio_shadow_sync(port);
+	if (command(lcd, function) < 0 || command(lcd, FAGPIO_HD44780_DISPLAY) < 0)
+		return -1;
+	if (fagpio_hd44780_clear(lcd) < 0 || command(lcd, FAGPIO_HD44780_ENTRY | 2) < 0)
+		return -1;
+	return command(lcd, FAGPIO_HD44780_DISPLAY | 4);
+}
+
+int fagpio_hd44780_command(struct fagpio_hd44780 *lcd, uint8_t cmd) {
+	lcd->addr = 0xFF;		//It may move the address counter
+	return command(lcd, cmd);
+}
+
+int fagpio_hd44780_clear(struct fagpio_hd44780 *lcd) {
+	memset(lcd->text, ' ', sizeof(lcd->text));
+	memset(lcd->shown, ' ', sizeof(lcd->shown));
+	if (command(lcd, FAGPIO_HD44780_CLEAR) < 0) {
+		lcd->addr = 0xFF;
+		return -1;
+	}
+	lcd->addr = 0;
+	return 0;
+}
+
+// Characters showing the code change with it, nothing is resent
+int fagpio_hd44780_define(struct fagpio_hd44780 *lcd, uint8_t code, const uint8_t rows[8]) {
+	int ret = code > 7 ? -1 : write_byte(lcd, 0, FAGPIO_HD44780_CGRAM | code << 3);
+
+	lcd->addr = 0xFF;		//Left in CGRAM
+	for (unsigned int i = 0; i < 8 && !ret; i++)
+		ret = write_byte(lcd, lcd->rs, rows[i] & 0x1F);
+	fagpio_shadow_sync(lcd->port);
+	return ret;
+}
+
+void fagpio_hd44780_print(struct fagpio_hd44780 *lcd, uint8_t col, uint8_t row, const char *s) {
+	if (row >= lcd->rows)
+		return;
+	for (char *p = &lcd->text[row * lcd->cols]; col < lcd->cols && *s; col++)
+		p[col] = *s++;
+}
+
+int fagpio_hd44780_update(struct fagpio_hd44780 *lcd) {
+	int sent = 0;
+
+	for (unsigned int row = 0; row < lcd->rows; row++) {
+		for (unsigned int col = 0; col < lcd->cols; col++) {
+			unsigned int i = row * lcd->cols + col;
+			uint8_t addr = ddram_addr(lcd, col, row);
+
+			if (lcd->text[i] == lcd->shown[i])
+				continue;
+			if (addr != lcd->addr && write_byte(lcd, 0, FAGPIO_HD44780_DDRAM | addr) < 0)
+				goto fail;
+			if (write_byte(lcd, lcd->rs, lcd->text[i]) < 0)
+				goto fail;
+			lcd->shown[i] = lcd->text[i];
+			lcd->addr = addr + 1;
+			sent++;
+		}
+	}
+	fagpio_shadow_sync(lcd->port);
+	return sent;
+
+fail:
+	lcd->addr = 0xFF;
+	fagpio_shadow_sync(lcd->port);
+	return -1;
+}
@@ -0,0 +1,80 @@
+#ifndef _FAGPIO_HD44780_H
+#define _FAGPIO_HD44780_H
+
+#include <stdint.h>
+
+/*
+ * HD44780 character LCDs on 4 or 8 consecutive data pins, with RS, E and
+ * RW on the same port. Each nibble (or byte) is two port stores: data,
+ * RS and E high, then the same word with E low. With RW connected, the
+ * busy flag is polled before the next access instead of waiting the
+ * worst-case 37 us or 1.52 ms: the data pins turn into inputs by
+ * read-modify-writes of their CFG words, precomputed at init, and back.
+ * RW tied low (FAGPIO_HD44780_NO_PIN) falls back to those delays. A 5 V
+ * module drives the data lines while RW is high: use a 3.3 V one or
+ * level shifters when reading.
+ *
+ * fagpio_hd44780_print() only writes into lcd->text; fagpio_hd44780_update()
+ * compares it with lcd->shown, what the display holds, and sends the
+ * characters that differ, setting the DDRAM address only where the
+ * address counter is not already there.
+ */
+
+#define FAGPIO_HD44780_NO_PIN	0xFF
+#define FAGPIO_HD44780_MAX		80		//Characters of the DDRAM
+
+#ifndef FAGPIO_HD44780_BUSY_US
+#define FAGPIO_HD44780_BUSY_US	5000	//Busy flag timeout
+#endif
+#define FAGPIO_HD44780_EXEC_US	50		//Instruction time without the busy flag
+#define FAGPIO_HD44780_HOME_US	2000	//Clear and home
+
+// Instructions
+#define FAGPIO_HD44780_CLEAR	0x01
+#define FAGPIO_HD44780_HOME		0x02
+#define FAGPIO_HD44780_ENTRY	0x04	//| 2 increment, | 1 shift
+#define FAGPIO_HD44780_DISPLAY	0x08	//| 4 display on, | 2 cursor, | 1 blink
+#define FAGPIO_HD44780_FUNCTION	0x20	//| 0x10 8-bit, | 8 two lines, | 4 5x10 font
+#define FAGPIO_HD44780_CGRAM	0x40
+#define FAGPIO_HD44780_DDRAM	0x80
+
+struct fagpio_hd44780 {
+	volatile uint32_t *dat;
+	volatile uint32_t *cfg;		//CFG words of the port
+	uint8_t shift;				//Pin number of the first data pin
+	uint8_t bits;				//4 or 8
+	uint8_t cols, rows;
+	uint8_t cfg_lo, cfg_hi;		//CFG words holding the data pins
+	uint8_t addr;				//Address counter, 0xFF when unknown
+	uint8_t port;
+	uint32_t rs, rw, e;			//Pin masks, rw 0 when tied low
+	uint32_t data, mask;		//Data pins, and with RS, RW and E
+	uint32_t busy;				//D7
+	uint32_t field[4];			//CFG fields of the data pins
+	uint32_t out[4];			//Output function in those fields
+	uint32_t pulse, cycle;		//E high and E low ticks
+	uint32_t busy_ticks;
+	char text[FAGPIO_HD44780_MAX];	//Wanted contents, row after row
+	char shown[FAGPIO_HD44780_MAX];
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// d0 is D4 with 4 bits, D0 with 8; clears the display
+int fagpio_hd44780_init(struct fagpio_hd44780 *lcd, uint8_t d0, uint8_t bits, uint8_t rs, uint8_t rw, uint8_t e,
+	uint8_t cols, uint8_t rows);
+
+int fagpio_hd44780_command(struct fagpio_hd44780 *lcd, uint8_t cmd);		//-1 if the busy flag stayed set
+int fagpio_hd44780_clear(struct fagpio_hd44780 *lcd);
+int fagpio_hd44780_define(struct fagpio_hd44780 *lcd, uint8_t code, const uint8_t rows[8]);	//Custom character 0-7
+
+void fagpio_hd44780_print(struct fagpio_hd44780 *lcd, uint8_t col, uint8_t row, const char *s);	//Clipped to the row
+int fagpio_hd44780_update(struct fagpio_hd44780 *lcd);		//Characters sent, -1 on a busy timeout
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
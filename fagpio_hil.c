@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <string.h>
+#include "fagpio_priv.h"
+#include "fagpio_hil.h"
+#include "fagpio_timer.h"
+
+int fagpio_hil_init(struct fagpio_hil *h, uint8_t port, uint32_t mask, uint32_t window_ns, uint32_t bin_ns, uint32_t *lat, unsigned int lat_cap) {
+	memset(h, 0, sizeof(*h));
+	if (port >= PIO_NPORTS || !mask)
+		return -1;
+	h->port = port;
+	h->mask = mask;
+	h->window = fagpio_ns_to_ticks(window_ns);
+	h->bin = fagpio_ns_to_ticks(bin_ns);
+	if (!h->bin)
+		h->bin = 1;
+	h->lat = lat;
+	h->lat_cap = lat ? lat_cap : 0;
+	fagpio_hil_reset(h);
+	return 0;
+}
+
+void fagpio_hil_reset(struct fagpio_hil *h) {
+	h->trials = h->responses = h->missed = 0;
+	h->min = UINT32_MAX;
+	h->max = 0;
+	h->sum = 0;
+	h->resolution = 0;
+	memset(h->hist, 0, sizeof(h->hist));
+}
+
+static void trial_end(struct fagpio_hil *h, uint32_t lat) {
+	if (h->trials - 1 < h->lat_cap)
+		h->lat[h->trials - 1] = lat;
+	if (lat == FAGPIO_HIL_MISSED) {
+		h->missed++;
+		return;
+	}
+	h->responses++;
+	h->sum += lat;
+	if (lat < h->min)
+		h->min = lat;
+	if (lat > h->max)
+		h->max = lat;
+	h->hist[lat / h->bin < FAGPIO_HIL_BINS ? lat / h->bin : FAGPIO_HIL_BINS - 1]++;
+}
+
+/*
+One pass: counter, response sample, then the op if it is due. The sample
+taken in the pass of a store is the reference level of that trial, and
+the counter value read before the store its start.
+*/
+FAGPIO_ARM_CODE static void hil_loop(struct fagpio_hil *h, struct pio_bank *banks, const struct fagpio_seq_op *ops, unsigned int count, uint32_t used) {
+	volatile uint32_t *counter = fagpio_counter;
+	volatile uint32_t *in = &banks[h->port].dat;
+	uint32_t cur[PIO_NPORTS], mask = h->mask, window = h->window, gap = 0;
+	uint32_t start, now, last, next, ref = 0, stim = 0;
+	unsigned int i = 0;
+	int armed = 0;
+
+	for (unsigned int port = 0; port < PIO_NPORTS; port++) {
+		if (used & (1u << port))
+			cur[port] = banks[port].dat;
+	}
+	start = last = counter ? *counter : fagpio_ticks_slow();
+	next = start + ops[0].at;
+	for (;;) {
+		uint32_t v;
+
+		now = counter ? *counter : fagpio_ticks_slow();
+		v = *in & mask;
+		if (now - last > gap)
+			gap = now - last;
+		last = now;
+		if (armed && v != ref) {
+			trial_end(h, now - stim);
+			armed = 0;
+		}
+		if (i < count && (int32_t)(now - next) >= 0) {
+			const struct fagpio_seq_op *op = &ops[i];
+
+			if (armed)
+				trial_end(h, FAGPIO_HIL_MISSED);
+			cur[op->port] = (cur[op->port] & ~op->mask) | op->value;
+			banks[op->port].dat = cur[op->port];
+			stim = now;
+			ref = v;
+			armed = 1;
+			h->trials++;
+			if (++i < count)
+				next = start + ops[i].at;
+		} else if (armed && now - stim > window) {
+			trial_end(h, FAGPIO_HIL_MISSED);
+			armed = 0;
+		} else if (i == count && !armed) {
+			break;
+		}
+	}
+	if (gap > h->resolution)
+		h->resolution = gap;
+}
+
+int fagpio_hil_run(struct fagpio_hil *h, const struct fagpio_seq_op *ops, unsigned int count) {
+	struct pio_bank *banks = fagpio_banks();
+	unsigned int before = h->responses;
+	uint32_t used = 0;
+
+	if (!banks)
+		return -1;
+	if (!count)
+		return 0;
+	for (unsigned int i = 0; i < count; i++)
+		used |= 1u << ops[i].port;
+	hil_loop(h, banks, ops, count, used);
+	for (unsigned int port = 0; port < PIO_NPORTS; port++) {
+		if (used & (1u << port))
+			fagpio_shadow_sync(port);
+	}
+	return h->responses - before;
+}
+
+uint32_t fagpio_hil_percentile(const struct fagpio_hil *h, unsigned int pct) {
+	uint64_t want = ((uint64_t)h->responses * pct + 99) / 100, seen = 0;
+
+	if (!h->responses)
+		return 0;
+	for (unsigned int b = 0; b < FAGPIO_HIL_BINS - 1; b++) {
+		if ((seen += h->hist[b]) >= want)
+			return (b + 1) * h->bin;
+	}
+	return h->max;
+}
+
+void fagpio_hil_report(const struct fagpio_hil *h, int fd) {
+	dprintf(fd, "%u trials, %u responses, %u missed\n", h->trials, h->responses, h->missed);
+	if (!h->responses)
+		return;
+	dprintf(fd, "latency ns: min %u mean %u max %u, p50 %u p90 %u p99 %u, resolution %u\n",
+		fagpio_ticks_to_ns(h->min), fagpio_ticks_to_ns(h->sum / h->responses), fagpio_ticks_to_ns(h->max),
+		fagpio_ticks_to_ns(fagpio_hil_percentile(h, 50)), fagpio_ticks_to_ns(fagpio_hil_percentile(h, 90)),
+		fagpio_ticks_to_ns(fagpio_hil_percentile(h, 99)), fagpio_ticks_to_ns(h->resolution));
+	for (unsigned int b = 0; b < FAGPIO_HIL_BINS; b++) {
+		if (h->hist[b])
+			dprintf(fd, "%9u%s ns %u\n", fagpio_ticks_to_ns(b * h->bin), b == FAGPIO_HIL_BINS - 1 ? "+" : " ", h->hist[b]);
+	}
+}
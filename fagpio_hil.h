@@ -0,0 +1,59 @@
+#ifndef _FAGPIO_HIL_H
+#define _FAGPIO_HIL_H
+
+#include <stdint.h>
+#include "fagpio_seq.h"
+
+/*
+ * Stimulus/response latency of a device under test. fagpio_hil_run()
+ * plays a sequencer timeline (fagpio_seq.h) and samples the response
+ * pins in the same loop, so both times come from one AVS counter read
+ * each and no second thread or capture is involved. Each pass reads the
+ * counter and the response port's DAT, and stores the next op when its
+ * tick has come.
+ *
+ * Every op is a trial: the response is the first sample in which the
+ * response pins differ from their level just before the op's store,
+ * within window ticks and before the next op. Its latency goes into a
+ * linear histogram of FAGPIO_HIL_BINS bins of bin ticks, into min, max
+ * and mean, and into the caller's array when one was given. A latency is
+ * exact to one pass of the loop, at most resolution ticks late; on the
+ * F1C100s a pass is a few counter ticks. Run it from fagpio_rt_enter()
+ * so a preemption does not land inside a trial.
+ */
+
+#define FAGPIO_HIL_BINS		64			//The last one also counts longer latencies
+#define FAGPIO_HIL_MISSED	UINT32_MAX	//Latency of a trial without a response
+
+struct fagpio_hil {
+	uint8_t port;			//Response pins
+	uint32_t mask;
+	uint32_t window;		//Ticks a response may take
+	uint32_t bin;			//Histogram bin width in ticks
+	uint32_t *lat;			//Latency of each trial, NULL for none
+	unsigned int lat_cap;
+	unsigned int trials, responses, missed;
+	uint32_t min, max;		//Ticks
+	uint64_t sum;
+	uint32_t resolution;	//Longest pass of the loop in ticks
+	uint32_t hist[FAGPIO_HIL_BINS];
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fagpio_hil_init(struct fagpio_hil *h, uint8_t port, uint32_t mask, uint32_t window_ns, uint32_t bin_ns, uint32_t *lat, unsigned int lat_cap);
+void fagpio_hil_reset(struct fagpio_hil *h);		//Clears the results, keeps the setup
+
+// Plays the timeline from now; results add up over runs. Responses seen, -1 without the mapping
+int fagpio_hil_run(struct fagpio_hil *h, const struct fagpio_seq_op *ops, unsigned int count);
+
+uint32_t fagpio_hil_percentile(const struct fagpio_hil *h, unsigned int pct);	//Ticks, upper edge of the bin
+void fagpio_hil_report(const struct fagpio_hil *h, int fd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,206 @@
+#include <sched.h>
+#include <string.h>
+#include "fagpio_priv.h"
+#include "fagpio_hub75.h"
+#include "fagpio_dma.h"
+#include "fagpio_timer.h"
+#include "fagpio_transpose.h"
+
+#define HUB75_PORT		PIO_PORT_E
+
+int fagpio_hub75_init(struct fagpio_hub75 *h, unsigned int width, unsigned int height, unsigned int planes, uint32_t lsb_ns) {
+	memset(h, 0, sizeof(*h));
+	if (!width || width > FAGPIO_HUB75_MAX_WIDTH || !height || height % 2 || height / 2 > FAGPIO_HUB75_MAX_SCAN)
+		return -1;
+	if (!planes || planes > FAGPIO_HUB75_MAX_PLANES || fagpio_setup() < 0)
+		return -1;
+	h->width = width;
+	h->scan = height / 2;
+	h->planes = planes;
+	if (!(h->lsb = fagpio_ns_to_ticks(lsb_ns)))
+		h->lsb = 1;
+
+	digitalWritePort(HUB75_PORT, FAGPIO_HUB75_MASK, FAGPIO_HUB75_OE);
+	pinModeMask(HUB75_PORT, FAGPIO_HUB75_MASK, OUTPUT);
+	return 0;
+}
+
+// Rows 0..scan-1 drive R1 G1 B1, the lower half R2 G2 B2
+void fagpio_hub75_pixel(struct fagpio_hub75 *h, unsigned int x, unsigned int y, uint8_t r, uint8_t g, uint8_t b) {
+	struct fagpio_hub75_frame *f = &h->frames[h->active ^ 1];
+	unsigned int row = y % h->scan, shift = y < h->scan ? 0 : 3;
+
+	if (x >= h->width || y >= 2u * h->scan)
+		return;
+	// rgb[7 - bit] has bit `bit` of r, g and b in bits 0-2
+	uint8_t lane[8] = { r, g, b }, rgb[8];
+
+	fagpio_transpose8(lane, rgb);
+	for (unsigned int p = 0; p < h->planes; p++) {
+		uint8_t *c = &f->col[row][p][x];
+
+		*c = (*c & ~(7u << shift)) | rgb[h->planes - 1 - p] << shift;
+	}
+}
+
+void fagpio_hub75_clear(struct fagpio_hub75 *h) {
+	memset(&h->frames[h->active ^ 1], 0, sizeof(struct fagpio_hub75_frame));
+}
+
+void fagpio_hub75_show(struct fagpio_hub75 *h) {
+	uint32_t next = h->active ^ 1;
+
+	__sync_synchronize();
+	h->active = next;
+	while (h->running && h->playing != next)
+		sched_yield();
+	h->frames[next ^ 1] = h->frames[next];
+}
+
+static void spin_until(uint32_t target) {
+	while ((int32_t)(fagpio_ticks() - target) < 0)
+		;
+}
+
+/*
+hold is the upper part of every store: the other pins of the port, OE
+and the address of the row being shown. A plane lit for longer than the
+last shift took keeps lighting while the next one is shifted in; a
+shorter one is finished and blanked first.
+*/
+FAGPIO_ARM_CODE void fagpio_hub75_run(struct fagpio_hub75 *h) {
+	struct pio_bank *banks = fagpio_banks();
+	uint32_t hold = FAGPIO_HUB75_OE, lit_end = 0, shift = 0;
+	int lit = 0;
+
+	if (!banks)
+		return;
+
+	volatile uint32_t *dat = &banks[HUB75_PORT].dat;
+
+	h->running = 1;
+	while (!h->stop) {
+		uint32_t idx = h->active;
+
+		h->playing = idx;
+		__sync_synchronize();
+
+		const struct fagpio_hub75_frame *f = &h->frames[idx];
+		uint32_t rest = *dat & ~FAGPIO_HUB75_MASK;
+
+		hold = rest | (hold & FAGPIO_HUB75_MASK);
+		for (unsigned int r = 0; r < h->scan; r++) {
+			for (unsigned int p = 0; p < h->planes; p++) {
+				const uint8_t *col = f->col[r][p];
+
+				if (lit && (int32_t)(lit_end - fagpio_ticks()) < (int32_t)shift) {
+					spin_until(lit_end);
+					hold |= FAGPIO_HUB75_OE;
+					*dat = hold;
+					lit = 0;
+				}
+
+				uint32_t t0 = fagpio_ticks();
+
+				for (unsigned int x = 0; x < h->width; x++) {
+					*dat = hold | col[x];
+					*dat = hold | col[x] | FAGPIO_HUB75_CLK;
+				}
+				shift = fagpio_ticks() - t0;
+				if (lit)
+					spin_until(lit_end);
+
+				hold = rest | FAGPIO_HUB75_OE | FAGPIO_HUB75_ADDR(r);
+				*dat = hold | FAGPIO_HUB75_LAT;
+				*dat = hold;
+				hold &= ~FAGPIO_HUB75_OE;
+				*dat = hold;
+				lit_end = fagpio_ticks() + (h->lsb << p);
+				lit = 1;
+			}
+		}
+	}
+	if (lit)
+		spin_until(lit_end);
+	*dat = hold | FAGPIO_HUB75_OE;
+	fagpio_shadow_sync(HUB75_PORT);
+	h->running = 0;
+}
+
+static void *hub75_thread(void *arg) {
+	fagpio_hub75_run(arg);
+	return NULL;
+}
+
+int fagpio_hub75_start(struct fagpio_hub75 *h) {
+	h->stop = 0;
+	h->running = 1;
+	if (pthread_create(&h->thread, NULL, hub75_thread, h)) {
+		h->running = 0;
+		return -1;
+	}
+	return 0;
+}
+
+void fagpio_hub75_stop(struct fagpio_hub75 *h) {
+	h->stop = 1;
+	if (h->thread) {
+		pthread_join(h->thread, NULL);
+		h->thread = 0;
+	}
+}
+
+struct dma_out {
+	volatile uint32_t *virt;
+	size_t words, cap;
+};
+
+static void emit(struct dma_out *o, uint32_t word, size_t n) {
+	for (; n; n--) {
+		if (o->words < o->cap)
+			o->virt[o->words] = word;
+		o->words++;
+	}
+}
+
+// The thread's schedule in DMA words: shifts take 2 * width words, so the weights are exact
+size_t fagpio_hub75_dma_build(const struct fagpio_hub75 *h, struct fagpio_dmabuf *buf, uint32_t lsb_words) {
+	const struct fagpio_hub75_frame *f = &h->frames[h->active];
+	struct dma_out o = { buf->virt, 0, buf->size / 4 };
+	uint32_t rest = digitalReadPort(HUB75_PORT) & ~FAGPIO_HUB75_MASK;
+	uint32_t hold = rest | FAGPIO_HUB75_OE, shift = 2u * h->width;
+	size_t lit = 0;
+
+	if (!buf->virt || !lsb_words)
+		return 0;
+	for (unsigned int r = 0; r < h->scan; r++) {
+		for (unsigned int p = 0; p < h->planes; p++) {
+			const uint8_t *col = f->col[r][p];
+
+			if (lit && lit < shift) {
+				emit(&o, hold, lit);
+				hold |= FAGPIO_HUB75_OE;
+				lit = 0;
+			}
+			for (unsigned int x = 0; x < h->width; x++) {
+				emit(&o, hold | col[x], 1);
+				emit(&o, hold | col[x] | FAGPIO_HUB75_CLK, 1);
+			}
+			if (lit)
+				emit(&o, hold, lit - shift);
+
+			hold = rest | FAGPIO_HUB75_OE | FAGPIO_HUB75_ADDR(r);
+			emit(&o, hold | FAGPIO_HUB75_LAT, 1);
+			emit(&o, hold, 1);
+			hold &= ~FAGPIO_HUB75_OE;
+			lit = (size_t)lsb_words << p;
+		}
+	}
+	emit(&o, hold, lit);
+	emit(&o, hold | FAGPIO_HUB75_OE, 1);
+	return o.words <= o.cap && o.words <= FAGPIO_DMA_MAX_WORDS ? o.words : 0;
+}
+
+int fagpio_hub75_dma_start(uint8_t ch, const struct fagpio_dmabuf *buf, size_t words, uint8_t wait) {
+	return fagpio_dma_wave_start(ch, HUB75_PORT, buf, words, FAGPIO_DMA_DRQ_SDRAM, wait, FAGPIO_DMA_LOOP);
+}
@@ -0,0 +1,83 @@
+#ifndef _FAGPIO_HUB75_H
+#define _FAGPIO_HUB75_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "fagpio.h"
+#include "fagpio_dmabuf.h"
+
+/*
+ * HUB75 RGB LED panels on port E, every store a whole DAT word:
+ *  - PE0-PE5 R1 G1 B1 R2 G2 B2, PE6 CLK, PE7 LAT
+ *  - PE8 OE (low lights the row), PE9-PE12 row address A-D
+ * A frame holds, for each scanned row pair and colour bit plane, one
+ * byte per column that is the low byte of the DAT word shifting it, so a
+ * column costs two stores (data with CLK low, then CLK high) and no
+ * arithmetic beyond an OR.
+ *
+ * Colour depth is binary code modulation: plane p of a row stays lit for
+ * lsb << p, and the next plane is shifted in while it is lit whenever it
+ * lasts longer than a shift, dark otherwise. The rows are played from a
+ * thread (fagpio_hub75_start(), at a real-time priority) paced by the AVS
+ * counter, or compiled with fagpio_hub75_dma_build() into one DMA buffer
+ * that fagpio_hub75_dma_start() loops with no CPU time (fagpio_dma.h);
+ * there lsb counts DMA words and the rebuild after each frame change is
+ * the caller's.
+ *
+ * Pixels are drawn into the back frame and published by
+ * fagpio_hub75_show(), which flips an index the thread reads at each
+ * frame start, as in fagpio_mux.h.
+ */
+
+#define FAGPIO_HUB75_MAX_WIDTH		128
+#define FAGPIO_HUB75_MAX_SCAN		16			//Row pairs, addressed by A-D
+#define FAGPIO_HUB75_MAX_PLANES		8
+
+#define FAGPIO_HUB75_CLK			(1u << 6)
+#define FAGPIO_HUB75_LAT			(1u << 7)
+#define FAGPIO_HUB75_OE				(1u << 8)
+#define FAGPIO_HUB75_ADDR(row)		((uint32_t)(row) << 9)
+#define FAGPIO_HUB75_MASK			0x1fffu		//PE0-PE12
+
+struct fagpio_hub75_frame {
+	uint8_t col[FAGPIO_HUB75_MAX_SCAN][FAGPIO_HUB75_MAX_PLANES][FAGPIO_HUB75_MAX_WIDTH];
+};
+
+struct fagpio_hub75 {
+	uint16_t width;
+	uint8_t scan;						//Height / 2
+	uint8_t planes;
+	uint32_t lsb;						//Ticks plane 0 stays lit
+	struct fagpio_hub75_frame frames[2];
+	volatile uint32_t active;			//Frame the player takes at the next frame start
+	volatile uint32_t playing;
+	volatile uint8_t running;
+	volatile uint8_t stop;
+	pthread_t thread;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// height is 2 * scan rows; planes 1-8 bits per colour; lsb_ns is plane 0's lit time for the thread
+int fagpio_hub75_init(struct fagpio_hub75 *h, unsigned int width, unsigned int height, unsigned int planes, uint32_t lsb_ns);
+
+void fagpio_hub75_pixel(struct fagpio_hub75 *h, unsigned int x, unsigned int y, uint8_t r, uint8_t g, uint8_t b);	//8 bits each, top planes bits used
+void fagpio_hub75_clear(struct fagpio_hub75 *h);
+void fagpio_hub75_show(struct fagpio_hub75 *h);
+
+void fagpio_hub75_run(struct fagpio_hub75 *h);		//Refreshes until fagpio_hub75_stop()
+int fagpio_hub75_start(struct fagpio_hub75 *h);
+void fagpio_hub75_stop(struct fagpio_hub75 *h);		//Leaves the panel dark
+
+// The shown frame as DAT words for port E, plane 0 lit for lsb_words words; 0 if buf is too small
+size_t fagpio_hub75_dma_build(const struct fagpio_hub75 *h, struct fagpio_dmabuf *buf, uint32_t lsb_words);
+int fagpio_hub75_dma_start(uint8_t ch, const struct fagpio_dmabuf *buf, size_t words, uint8_t wait);	//Loops it
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,78 @@
+#include "fagpio_priv.h"
+#include "fagpio_hx711.h"
+#include "fagpio_timer.h"
+
+#define HX711_PHASE_NS		1000	//T3/T4 are 0.2 us minimum, DOUT valid 0.1 us after the rising edge
+
+int fagpio_hx711_init(struct fagpio_hx711 *hx, uint8_t sck, uint8_t dout, uint8_t gain) {
+	if (!fagpio_banks() || PIO_PIN_PORT(sck) >= PIO_NPORTS || PIO_PIN_PORT(dout) >= PIO_NPORTS)
+		return -1;
+	if (gain != HX711_GAIN_A128 && gain != HX711_GAIN_B32 && gain != HX711_GAIN_A64)
+		return -1;
+
+	hx->sck = sck;
+	hx->dout = dout;
+	hx->pulses = gain;
+	hx->rejected = 0;
+
+	fagpio_digital_write(fagpio_default(), sck, LOW);
+	pinMode(sck, 0);
+	pinMode(dout, 1);
+	return 0;
+}
+
+static int wait_ready(struct fagpio_hx711 *hx, unsigned int timeout_ms) {
+	for (unsigned int ms = 0; !fagpio_hx711_ready(hx); ms++) {
+		if (ms >= timeout_ms)
+			return -1;
+		usleep(1000);		//10 or 80 samples per second, no need to spin
+	}
+	return 0;
+}
+
+/*
+Clocks one word, recording the counter before each rising edge and after
+each falling edge: the difference bounds the high phase from above.
+*/
+FAGPIO_ARM_CODE static int read_once(struct fagpio_hx711 *hx, int32_t *value) {
+	uint32_t stamps[HX711_GAIN_A64 * 2];
+	uint32_t word = 0, limit = fagpio_ns_to_ticks(HX711_HIGH_MAX_US * 1000);
+
+	for (unsigned int i = 0; i < hx->pulses; i++) {
+		stamps[2 * i] = fagpio_ticks();
+		fagpio_digital_write(fagpio_default(), hx->sck, HIGH);
+		fagpio_delay_ns(HX711_PHASE_NS);
+		if (i < 24)
+			word = (word << 1) | fagpio_digital_read(fagpio_default(), hx->dout);
+		fagpio_digital_write(fagpio_default(), hx->sck, LOW);
+		stamps[2 * i + 1] = fagpio_ticks();
+		fagpio_delay_ns(HX711_PHASE_NS);
+	}
+
+	for (unsigned int i = 0; i < hx->pulses; i++)
+		if (stamps[2 * i + 1] - stamps[2 * i] > limit)
+			return -1;
+
+	*value = (int32_t)(word << 8) >> 8;		//Sign-extend the 24-bit two's complement
+	return 0;
+}
+
+int fagpio_hx711_read(struct fagpio_hx711 *hx, int32_t *value, unsigned int attempts, unsigned int timeout_ms) {
+	for (unsigned int i = 0; i < attempts; i++) {
+		if (wait_ready(hx, timeout_ms) < 0)
+			return -1;
+		if (read_once(hx, value) == 0)
+			return 0;
+		hx->rejected++;
+	}
+	return -1;
+}
+
+void fagpio_hx711_power_down(struct fagpio_hx711 *hx) {
+	fagpio_digital_write(fagpio_default(), hx->sck, HIGH);
+	usleep(HX711_POWERDOWN_US * 2);
+}
+
+void fagpio_hx711_power_up(struct fagpio_hx711 *hx) {
+	fagpio_digital_write(fagpio_default(), hx->sck, LOW);		//Back to gain A128 until the next read selects another
+}
@@ -0,0 +1,50 @@
+#ifndef _FAGPIO_HX711_H
+#define _FAGPIO_HX711_H
+
+#include <stdint.h>
+#include "fagpio.h"
+
+/*
+ * HX711 load cell ADC. PD_SCK is driven by us, so there is nothing to
+ * capture on the data side; instead every clock pulse is bracketed with
+ * AVS counter reads and the bits are only accepted afterwards, when no
+ * high phase came near HX711_POWERDOWN_US. A longer one (a preemption
+ * with SCK high) powers the chip down mid-word and shifts garbage, so
+ * fagpio_hx711_read() waits for the next conversion and tries again.
+ */
+
+#define HX711_POWERDOWN_US		60		//SCK high this long resets the chip
+#define HX711_HIGH_MAX_US		40		//Longest high phase accepted
+
+#define HX711_GAIN_A128			25		//Clock pulses per read, selecting the next conversion
+#define HX711_GAIN_B32			26
+#define HX711_GAIN_A64			27
+
+struct fagpio_hx711 {
+	uint8_t sck;
+	uint8_t dout;
+	uint8_t pulses;			//HX711_GAIN_*
+	unsigned int rejected;	//Reads thrown away, including each retried one
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fagpio_hx711_init(struct fagpio_hx711 *hx, uint8_t sck, uint8_t dout, uint8_t gain);
+
+static inline int fagpio_hx711_ready(const struct fagpio_hx711 *hx) {
+	return digitalRead(hx->dout) == LOW;
+}
+
+// Signed 24-bit conversion result; timeout_ms applies to each attempt's wait for DOUT low
+int fagpio_hx711_read(struct fagpio_hx711 *hx, int32_t *value, unsigned int attempts, unsigned int timeout_ms);
+
+void fagpio_hx711_power_down(struct fagpio_hx711 *hx);
+void fagpio_hx711_power_up(struct fagpio_hx711 *hx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
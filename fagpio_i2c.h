@@ -0,0 +1,30 @@
+#ifndef _FAGPIO_I2C_H
+#define _FAGPIO_I2C_H
+
+#include <stdint.h>
+
+/*
+ * I2C transaction list shared by the bit-banged master (fagpio_bbi2c.h)
+ * and the TWI driver (fagpio_twi.h). The messages of one transfer are
+ * joined by repeated starts and end with a single stop, like i2c_msg in
+ * the kernel's I2C_RDWR.
+ */
+
+#define FAGPIO_I2C_READ		0x01
+
+struct fagpio_i2c_msg {
+	uint8_t addr;		//7-bit address
+	uint8_t flags;
+	uint16_t len;
+	uint8_t *buf;
+};
+
+// One register read: write reg to addr, repeated start, read len bytes
+struct fagpio_i2c_reg {
+	uint8_t addr;
+	uint8_t reg;
+	uint16_t len;
+	uint8_t *buf;
+};
+
+#endif
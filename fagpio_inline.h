@@ -0,0 +1,71 @@
+#ifndef _FAGPIO_INLINE_H
+#define _FAGPIO_INLINE_H
+
+/*
+ * static inline fast paths for tight loops. They skip the PLT call into
+ * libfagpio.so and the GOT load of the global gpio mapping: fetch the bank
+ * array once with fagpio_banks() after fagpio_setup(), keep it in a local
+ * and pass it to every call.
+ *
+ *	struct pio_bank *banks = fagpio_banks();
+ *	digitalWriteFast(banks, PIO_PIN(PIO_PORT_E, 3), HIGH);
+ *
+ * No pin validation and no shadow registers: DAT is always read back.
+ */
+
+#include "fagpio.h"
+
+static inline void digitalWriteFast(struct pio_bank *banks, uint8_t pin, uint8_t value) {
+	volatile uint32_t *dat = &banks[PIO_PIN_PORT(pin)].dat;
+
+	if (value)
+		*dat |= PIO_PIN_MASK(pin);
+	else
+		*dat &= ~PIO_PIN_MASK(pin);
+}
+
+// Bit 0 of value, merged into DAT arithmetically so shift-out loops do not branch on data
+static inline void digitalWriteBitFast(struct pio_bank *banks, uint8_t pin, uint32_t value) {
+	volatile uint32_t *dat = &banks[PIO_PIN_PORT(pin)].dat;
+
+	*dat = (*dat & ~PIO_PIN_MASK(pin)) | ((value & 1) << PIO_PIN_NUM(pin));
+}
+
+static inline void digitalSetFast(struct pio_bank *banks, uint8_t pin) {
+	banks[PIO_PIN_PORT(pin)].dat |= PIO_PIN_MASK(pin);
+}
+
+static inline void digitalClearFast(struct pio_bank *banks, uint8_t pin) {
+	banks[PIO_PIN_PORT(pin)].dat &= ~PIO_PIN_MASK(pin);
+}
+
+static inline uint8_t digitalReadFast(struct pio_bank *banks, uint8_t pin) {
+	return (banks[PIO_PIN_PORT(pin)].dat >> PIO_PIN_NUM(pin)) & 0x1;
+}
+
+static inline void digitalWritePortFast(struct pio_bank *banks, uint8_t port, uint32_t mask, uint32_t value) {
+	volatile uint32_t *dat = &banks[port].dat;
+
+	*dat = (*dat & ~mask) | (value & mask);
+}
+
+static inline uint32_t digitalReadPortFast(struct pio_bank *banks, uint8_t port) {
+	return banks[port].dat;
+}
+
+/*
+ * Returns once every earlier PIO store has reached the block. User mode
+ * cannot issue the CP15 drain-write-buffer operation on ARMv5, so this
+ * reads a PIO register back: the read queues behind the stores on the
+ * bus, and consuming its value stalls until it completes. Stores between
+ * barriers stay free to sit in the write buffer.
+ */
+static inline void fagpio_io_barrier_fast(struct pio_bank *banks) {
+	uint32_t v;
+
+	__asm__ __volatile__("" ::: "memory");
+	v = banks[0].dat;
+	__asm__ __volatile__("" :: "r"(v) : "memory");
+}
+
+#endif
@@ -0,0 +1,264 @@
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "fagpio_ir.h"
+#include "fagpio_eint.h"
+#include "fagpio_pwm.h"
+#include "fagpio_timer.h"
+
+enum { NEC_IDLE, NEC_LEAD, NEC_MARK, NEC_SPACE, NEC_REPEAT };
+
+int fagpio_ir_rx_init(struct fagpio_ir_rx *rx, uint8_t pin, uint8_t protocols) {
+	memset(rx, 0, sizeof(*rx));
+	rx->pin = pin;
+	rx->protocols = protocols;
+	fagpio_ring_init(&rx->ring);
+	pinMode(pin, INPUT);
+	rx->level = fagpio_digital_read(fagpio_default(), pin);
+	rx->last = fagpio_ticks();
+	return attachInterrupt(pin, CHANGE) < 0 ? -1 : 0;
+}
+
+static int near(uint32_t us, uint32_t ref) {
+	return us * 10 >= ref * 7 && us * 10 <= ref * 13;
+}
+
+// Returns 1 with a frame in rx->code
+static int nec_interval(struct fagpio_ir_rx *rx, int mark, uint32_t us) {
+	switch (rx->nec_state) {
+	case NEC_LEAD:
+		if (!mark && near(us, NEC_LEAD_SPACE_US)) {
+			rx->nec_state = NEC_MARK;
+			rx->nec_bits = 0;
+			rx->nec_data = 0;
+			return 0;
+		}
+		if (!mark && near(us, NEC_REPEAT_SPACE_US)) {
+			rx->nec_state = NEC_REPEAT;
+			return 0;
+		}
+		break;
+	case NEC_MARK:
+		if (mark && near(us, NEC_UNIT_US)) {
+			if (rx->nec_bits < 32) {
+				rx->nec_state = NEC_SPACE;
+				return 0;
+			}
+
+			uint8_t a = rx->nec_data, na = rx->nec_data >> 8, c = rx->nec_data >> 16, nc = rx->nec_data >> 24;
+
+			rx->nec_state = NEC_IDLE;
+			if ((uint8_t)~c != nc)
+				return 0;
+			rx->code.protocol = FAGPIO_IR_NEC;
+			rx->code.repeat = 0;
+			rx->code.toggle = 0;
+			rx->code.command = c;
+			rx->code.address = (uint8_t)~a == na ? a : (uint16_t)(a | na << 8);
+			return 1;
+		}
+		break;
+	case NEC_SPACE:
+		if (!mark && (near(us, NEC_UNIT_US) || near(us, NEC_ONE_SPACE_US))) {
+			if (us > (NEC_UNIT_US + NEC_ONE_SPACE_US) / 2)
+				rx->nec_data |= 1u << rx->nec_bits;		//LSB first
+			rx->nec_bits++;
+			rx->nec_state = NEC_MARK;
+			return 0;
+		}
+		break;
+	case NEC_REPEAT:
+		if (mark && near(us, NEC_UNIT_US)) {
+			rx->nec_state = NEC_IDLE;
+			if (rx->code.protocol != FAGPIO_IR_NEC)
+				return 0;
+			rx->code.repeat = 1;
+			return 1;
+		}
+		break;
+	}
+	rx->nec_state = mark && near(us, NEC_LEAD_MARK_US) ? NEC_LEAD : NEC_IDLE;
+	return 0;
+}
+
+/*
+RC5 is Manchester coded, a 1 being a space then a mark half bit. The
+decoder rebuilds the 28 half bits from the interval lengths; the first
+half of the first start bit is idle space, and the last half is space
+for a final 0, which no edge ends, so 27 halves ending on a mark
+complete a frame too.
+*/
+static int rc5_interval(struct fagpio_ir_rx *rx, int mark, uint32_t us) {
+	unsigned int units = us >= RC5_HALF_US / 2 && us < RC5_HALF_US * 3 / 2 ? 1 :
+		us >= RC5_HALF_US * 3 / 2 && us < RC5_HALF_US * 5 / 2 ? 2 : 0;
+
+	if (!rx->rc5_halves) {
+		if (!mark || !units)
+			return 0;
+		rx->rc5_halves = 1;		//The idle first half of S1
+		rx->rc5_data = 0;
+	}
+	if (!units) {
+		rx->rc5_halves = 0;
+		return 0;
+	}
+	for (unsigned int i = 0; i < units; i++)
+		rx->rc5_data = rx->rc5_data << 1 | (mark ? 1 : 0);
+	rx->rc5_halves += units;
+	if (rx->rc5_halves < 27 || (rx->rc5_halves == 27 && !mark))
+		return 0;		//27 halves ending on a space still wait for the last mark
+	if (rx->rc5_halves == 27)
+		rx->rc5_data <<= 1;
+	else if (rx->rc5_halves > 28) {
+		rx->rc5_halves = 0;
+		return 0;
+	}
+	rx->rc5_halves = 0;
+
+	uint32_t bits = 0;
+
+	for (int i = 13; i >= 0; i--) {
+		uint32_t pair = (rx->rc5_data >> (2 * i)) & 3;
+
+		if (pair != 1 && pair != 2)
+			return 0;
+		bits = bits << 1 | (pair == 1);
+	}
+	rx->code.protocol = FAGPIO_IR_RC5;
+	rx->code.repeat = 0;
+	rx->code.toggle = (bits >> 11) & 1;
+	rx->code.address = (bits >> 6) & 0x1f;
+	rx->code.command = (bits & 0x3f) | (((bits >> 12) & 1) ? 0 : 0x40);		//Inverted S2 is command bit 6
+	return 1;
+}
+
+// level is the line after the edge; the interval before it had the other level
+int fagpio_ir_feed(struct fagpio_ir_rx *rx, uint32_t ticks, uint8_t level) {
+	uint32_t d = ticks - rx->last, us;
+	int mark = rx->level == LOW, done = 0;
+
+	if (level == rx->level)
+		return 0;		//Edges were lost in between
+	rx->level = level;
+	rx->last = ticks;
+	us = d >= fagpio_ns_to_ticks(100000000) ? 100000 : fagpio_ticks_to_ns(d) / 1000;
+	if (rx->protocols & FAGPIO_IR_NEC)
+		done |= nec_interval(rx, mark, us);
+	if (rx->protocols & FAGPIO_IR_RC5)
+		done |= rc5_interval(rx, mark, us);
+	return done;
+}
+
+static long ms_since(const struct timespec *t0) {
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (t.tv_sec - t0->tv_sec) * 1000 + (t.tv_nsec - t0->tv_nsec) / 1000000;
+}
+
+// A negative timeout_ms waits forever
+int fagpio_ir_receive(struct fagpio_ir_rx *rx, int timeout_ms) {
+	uint8_t port = PIO_PIN_PORT(rx->pin);
+	uint32_t bit = PIO_PIN_MASK(rx->pin);
+	struct fagpio_event ev[16];
+	struct timespec t0;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (;;) {
+		long left = timeout_ms < 0 ? -1 : timeout_ms - ms_since(&t0);
+		unsigned int n;
+
+		if (timeout_ms >= 0 && left <= 0)
+			return 0;
+		fagpio_eint_wait_ring(port, left, &rx->ring);
+		while ((n = fagpio_ring_pop(&rx->ring, ev, 16))) {
+			for (unsigned int i = 0; i < n; i++) {
+				if ((ev[i].old ^ ev[i].cur) & bit && fagpio_ir_feed(rx, ev[i].ticks, (ev[i].cur & bit) != 0))
+					return 1;
+			}
+		}
+	}
+}
+
+int fagpio_ir_tx_init(struct fagpio_ir_tx *tx, uint8_t channel, uint32_t carrier_hz) {
+	memset(tx, 0, sizeof(*tx));
+	tx->channel = channel;
+	tx->range = 3;
+	if (pwmSetup(channel, carrier_hz ? carrier_hz : FAGPIO_IR_CARRIER_HZ, tx->range) < 0)
+		return -1;
+	pwmWrite(channel, 0);
+	return 0;
+}
+
+static void wait_until(uint32_t target) {
+	int32_t idle = target - fagpio_ticks() - fagpio_ns_to_ticks(FAGPIO_IR_WAKE_US * 1000);
+
+	if (idle > 0)
+		usleep(fagpio_ticks_to_ns(idle) / 1000);
+	while ((int32_t)(fagpio_ticks() - target) < 0)
+		;
+}
+
+// Boundaries on absolute ticks, so a late wakeup shortens the next interval instead of shifting the rest
+int fagpio_ir_send_raw(struct fagpio_ir_tx *tx, const uint16_t *us, unsigned int n) {
+	uint32_t t = fagpio_ticks();
+
+	for (unsigned int i = 0; i < n; i++) {
+		pwmWrite(tx->channel, i % 2 ? 0 : 1);
+		t += fagpio_ns_to_ticks(us[i] * 1000u);
+		wait_until(t);
+	}
+	pwmWrite(tx->channel, 0);
+	return 0;
+}
+
+int fagpio_ir_send_nec(struct fagpio_ir_tx *tx, uint16_t address, uint8_t command) {
+	uint16_t raw[FAGPIO_IR_RAW_MAX];
+	uint32_t data = (address > 0xff ? address : (uint32_t)(address | (uint8_t)~address << 8)) |
+		(uint32_t)command << 16 | (uint32_t)(uint8_t)~command << 24;
+	unsigned int n = 0;
+
+	raw[n++] = NEC_LEAD_MARK_US;
+	raw[n++] = NEC_LEAD_SPACE_US;
+	for (unsigned int i = 0; i < 32; i++) {
+		raw[n++] = NEC_UNIT_US;
+		raw[n++] = (data >> i) & 1 ? NEC_ONE_SPACE_US : NEC_UNIT_US;
+	}
+	raw[n++] = NEC_UNIT_US;
+	return fagpio_ir_send_raw(tx, raw, n);
+}
+
+int fagpio_ir_send_nec_repeat(struct fagpio_ir_tx *tx) {
+	static const uint16_t raw[] = { NEC_LEAD_MARK_US, NEC_REPEAT_SPACE_US, NEC_UNIT_US };
+
+	return fagpio_ir_send_raw(tx, raw, 3);
+}
+
+// Half bits merged into runs: leading and trailing space are idle line
+int fagpio_ir_send_rc5(struct fagpio_ir_tx *tx, uint8_t address, uint8_t command) {
+	uint32_t bits = 1u << 13 | (command & 0x40 ? 0 : 1u << 12) | (uint32_t)tx->rc5_toggle << 11 |
+		(uint32_t)(address & 0x1f) << 6 | (command & 0x3f);
+	uint16_t raw[FAGPIO_IR_RAW_MAX];
+	unsigned int n = 0;
+	int level = 0;		//Current run, mark = 1
+
+	tx->rc5_toggle ^= 1;
+	for (int i = 13; i >= 0; i--) {
+		int one = (bits >> i) & 1;
+
+		for (int half = 0; half < 2; half++) {
+			int mark = half ? one : !one;
+
+			if (!n && !mark)
+				continue;
+			if (n && mark == level)
+				raw[n - 1] += RC5_HALF_US;
+			else
+				raw[n++] = RC5_HALF_US;
+			level = mark;
+		}
+	}
+	if (!level)
+		n--;
+	return fagpio_ir_send_raw(tx, raw, n);
+}
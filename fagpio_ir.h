@@ -0,0 +1,86 @@
+#ifndef _FAGPIO_IR_H
+#define _FAGPIO_IR_H
+
+#include <stdint.h>
+#include "fagpio.h"
+#include "fagpio_ring.h"
+
+/*
+ * Infrared remotes, NEC and RC5, on demodulating receivers (TSOP and the
+ * like) whose output is low while the carrier is on.
+ *
+ * Receiving classifies timestamped edges after the fact: the decoder is
+ * fed (ticks, level after the edge) pairs and measures each mark and
+ * space between them, so it works on any edge source.
+ * fagpio_ir_receive() takes them from the EINT ring (fagpio_eint.h),
+ * sleeping in poll() between edges; those timestamps are taken at wakeup,
+ * so the width windows are wide (NEC +-30%, RC5 half bits of 0.5-1.5 and
+ * 1.5-2.5 units). fagpio_capture_ring() gives exact ones while spinning.
+ *
+ * Sending gates a carrier from the hardware PWM block (fagpio_pwm.h):
+ * a mark is a 1/3 duty, a space duty 0, so only the mark and space
+ * boundaries need the CPU. The thread sleeps through each interval and
+ * spins the last FAGPIO_IR_WAKE_US of it on the AVS counter.
+ */
+
+#define FAGPIO_IR_NEC			0x01
+#define FAGPIO_IR_RC5			0x02
+
+#define FAGPIO_IR_CARRIER_HZ	38000	//NEC; RC5 remotes use 36 kHz
+#define FAGPIO_IR_WAKE_US		100
+#define FAGPIO_IR_RAW_MAX		72		//Marks and spaces of one frame
+
+#define NEC_LEAD_MARK_US		9000
+#define NEC_LEAD_SPACE_US		4500
+#define NEC_REPEAT_SPACE_US		2250
+#define NEC_UNIT_US				562
+#define NEC_ONE_SPACE_US		1687
+#define RC5_HALF_US				889
+
+struct fagpio_ir_code {
+	uint8_t protocol;		//FAGPIO_IR_NEC or FAGPIO_IR_RC5
+	uint8_t repeat;			//NEC repeat frame: address and command are the last frame's
+	uint8_t toggle;			//RC5 toggle bit
+	uint8_t command;
+	uint16_t address;		//8 bits, or 16 for extended NEC; 5 bits for RC5
+};
+
+struct fagpio_ir_rx {
+	uint8_t protocols;		//FAGPIO_IR_* to decode
+	uint8_t pin;
+	uint8_t level;			//Line level since the last edge
+	uint32_t last;			//Ticks of the last edge
+	uint8_t nec_state;
+	uint8_t nec_bits;
+	uint32_t nec_data;
+	uint8_t rc5_halves;
+	uint32_t rc5_data;		//Half-bit levels, mark = 1, oldest highest
+	struct fagpio_ir_code code;		//Last frame decoded
+	struct fagpio_ring ring;		//EINT events for fagpio_ir_receive()
+};
+
+struct fagpio_ir_tx {
+	uint8_t channel;		//PWM channel, PWM0_PIN or PWM1_PIN
+	uint32_t range;
+	uint8_t rc5_toggle;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fagpio_ir_rx_init(struct fagpio_ir_rx *rx, uint8_t pin, uint8_t protocols);		//Attaches a CHANGE interrupt to pin
+int fagpio_ir_feed(struct fagpio_ir_rx *rx, uint32_t ticks, uint8_t level);	//1 when rx->code holds a new frame
+int fagpio_ir_receive(struct fagpio_ir_rx *rx, int timeout_ms);				//Through EINT; 1 with a frame, 0 on timeout, -1 on error
+
+int fagpio_ir_tx_init(struct fagpio_ir_tx *tx, uint8_t channel, uint32_t carrier_hz);
+int fagpio_ir_send_raw(struct fagpio_ir_tx *tx, const uint16_t *us, unsigned int n);	//Mark, space, mark... in microseconds
+int fagpio_ir_send_nec(struct fagpio_ir_tx *tx, uint16_t address, uint8_t command);		//Addresses above 255 go extended
+int fagpio_ir_send_nec_repeat(struct fagpio_ir_tx *tx);
+int fagpio_ir_send_rc5(struct fagpio_ir_tx *tx, uint8_t address, uint8_t command);		//Flips the toggle bit every call
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
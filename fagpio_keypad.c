@@ -0,0 +1,93 @@
+#include <string.h>
+#include "fagpio_keypad.h"
+#include "fagpio_timer.h"
+
+int fagpio_keypad_init(struct fagpio_keypad *kp, const uint8_t *rows, unsigned int nrows,
+		const uint8_t *cols, unsigned int ncols) {
+	uint32_t col_mask = 0;
+
+	memset(kp, 0, sizeof(*kp));
+	if (!nrows || nrows > FAGPIO_KEYPAD_ROWS || !ncols || ncols > 32 || fagpio_setup() < 0)
+		return -1;
+	kp->row_port = PIO_PIN_PORT(rows[0]);
+	kp->col_port = PIO_PIN_PORT(cols[0]);
+	for (unsigned int r = 0; r < nrows; r++) {
+		if (PIO_PIN_PORT(rows[r]) != kp->row_port)
+			return -1;
+		kp->row_bit[r] = PIO_PIN_MASK(rows[r]);
+		kp->row_mask |= kp->row_bit[r];
+	}
+	for (unsigned int c = 0; c < ncols; c++) {
+		if (PIO_PIN_PORT(cols[c]) != kp->col_port)
+			return -1;
+		kp->col_pin[c] = cols[c];
+		col_mask |= PIO_PIN_MASK(cols[c]);
+	}
+	kp->nrows = nrows;
+	kp->ncols = ncols;
+	kp->settle = fagpio_ns_to_ticks(FAGPIO_KEYPAD_SETTLE_NS);
+	for (unsigned int r = 0; r < nrows; r++)
+		kp->row[r].mask = col_mask;
+
+	pinPullMask(kp->col_port, col_mask, PULL_UP);
+	pinModeMask(kp->col_port, col_mask, INPUT);
+	digitalWritePort(kp->row_port, kp->row_mask, kp->row_mask);
+	pinModeMask(kp->row_port, kp->row_mask, OUTPUT);
+	return 0;
+}
+
+// Two rows sharing two or more pressed columns: x & (x - 1) is non-zero with two bits set
+static uint32_t ghost_rows(const uint32_t *down, unsigned int nrows) {
+	uint32_t rows = 0;
+
+	for (unsigned int i = 0; i < nrows; i++) {
+		if (!(down[i] & (down[i] - 1)))
+			continue;		//A row with one key cannot be a rectangle's side
+		for (unsigned int j = i + 1; j < nrows; j++) {
+			uint32_t shared = down[i] & down[j];
+
+			if (shared & (shared - 1))
+				rows |= (1u << i) | (1u << j);
+		}
+	}
+	return rows;
+}
+
+uint32_t fagpio_keypad_scan(struct fagpio_keypad *kp, uint32_t changed[FAGPIO_KEYPAD_ROWS]) {
+	uint32_t down[FAGPIO_KEYPAD_ROWS], rows = 0;
+
+	for (unsigned int r = 0; r < kp->nrows; r++) {
+		digitalWritePort(kp->row_port, kp->row_mask, kp->row_mask & ~kp->row_bit[r]);
+		if (kp->settle)
+			fagpio_delay_cycles(kp->settle);
+		down[r] = ~digitalReadPort(kp->col_port) & kp->row[r].mask;
+		changed[r] = 0;
+	}
+	if ((kp->ghost_rows = ghost_rows(down, kp->nrows))) {
+		kp->ghosts++;
+		return 0;
+	}
+	for (unsigned int r = 0; r < kp->nrows; r++) {
+		if ((changed[r] = fagpio_debounce_step(&kp->row[r], down[r])))
+			rows |= 1u << r;
+	}
+	return rows;
+}
+
+int fagpio_keypad_next(struct fagpio_keypad *kp, uint32_t changed[FAGPIO_KEYPAD_ROWS], int *pressed) {
+	for (unsigned int r = 0; r < kp->nrows; r++) {
+		if (!changed[r])
+			continue;
+		for (unsigned int c = 0; c < kp->ncols; c++) {
+			uint32_t bit = PIO_PIN_MASK(kp->col_pin[c]);
+
+			if (changed[r] & bit) {
+				changed[r] &= ~bit;
+				if (pressed)
+					*pressed = (kp->row[r].state & bit) != 0;
+				return r * kp->ncols + c;
+			}
+		}
+	}
+	return -1;
+}
@@ -0,0 +1,71 @@
+#ifndef _FAGPIO_KEYPAD_H
+#define _FAGPIO_KEYPAD_H
+
+#include <stdint.h>
+#include "fagpio.h"
+#include "fagpio_debounce.h"
+
+/*
+ * Key matrix scanner. Rows are outputs on one port, driven low one at a
+ * time with a single digitalWritePort() while the others stay high (the
+ * last one stays low until the next pass); columns are inputs with
+ * pull-ups on one port, all read with a single digitalReadPort(). A pass
+ * over an 8x8 matrix is 8 stores and 8 loads with the DAT shadow on
+ * (fagpio_shadow_enable()), 24 accesses without, against 64 or more for
+ * per-key digitalRead(). Without row diodes, two keys pressed in one
+ * column short a high row to the low one: use series resistors or diodes
+ * on the rows.
+ *
+ * Every row's column word goes through the vertical counter of
+ * fagpio_debounce.h, so all keys debounce in a few ALU ops per row.
+ *
+ * Without diodes, three keys on the corners of a rectangle make the
+ * fourth look pressed. A pass where two rows share two or more pressed
+ * columns is ambiguous; it is counted in ghosts and not debounced, so the
+ * keys keep their last state until it clears.
+ */
+
+#define FAGPIO_KEYPAD_ROWS		16
+#define FAGPIO_KEYPAD_SETTLE_NS	1000	//After a row store, before the column read
+
+struct fagpio_keypad {
+	uint8_t row_port;
+	uint8_t col_port;
+	uint8_t nrows;
+	uint8_t ncols;
+	uint32_t row_mask;
+	uint32_t row_bit[FAGPIO_KEYPAD_ROWS];
+	uint8_t col_pin[32];
+	uint32_t settle;		//Ticks
+	uint32_t ghost_rows;	//Rows of the last ambiguous pass, 0 if it was clean
+	unsigned int ghosts;	//Ambiguous passes so far
+	struct fagpio_debounce_port row[FAGPIO_KEYPAD_ROWS];	//Column bits set for pressed keys
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// rows all on one port, cols all on one port; key numbers run row by row, cols[] order
+int fagpio_keypad_init(struct fagpio_keypad *kp, const uint8_t *rows, unsigned int nrows,
+	const uint8_t *cols, unsigned int ncols);
+
+/*
+ * One pass over the matrix, to be called every few milliseconds.
+ * changed[row] receives the column bits (of the column port) whose key
+ * flipped; the return value has a bit set for every row with a change.
+ */
+uint32_t fagpio_keypad_scan(struct fagpio_keypad *kp, uint32_t changed[FAGPIO_KEYPAD_ROWS]);
+
+// Next key that changed in changed[] after fagpio_keypad_scan(), cleared from it; -1 when none is left
+int fagpio_keypad_next(struct fagpio_keypad *kp, uint32_t changed[FAGPIO_KEYPAD_ROWS], int *pressed);
+
+static inline int fagpio_keypad_pressed(const struct fagpio_keypad *kp, unsigned int key) {
+	return (kp->row[key / kp->ncols].state & PIO_PIN_MASK(kp->col_pin[key % kp->ncols])) != 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef _FAGPIO_KSEQ_H
+#define _FAGPIO_KSEQ_H
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+/*
+ * Interface of the optional kernel helper in kmod/ (fagpio_kseq.ko). On a
+ * single core a userspace loop can always be interrupted, which a DShot
+ * frame or a soft-UART byte does not survive. When /dev/fagpio-seq exists,
+ * fagpio_seq_play_ops() hands the compiled ops to it; the module plays
+ * them with the same loop on the same AVS counter, with local interrupts
+ * off. Timelines longer than the module's bound (FAGPIO_KSEQ_MAX_OPS ops,
+ * max_us of interrupts off, a module parameter) are refused and played
+ * in userspace as before, so the API does not change.
+ * FAGPIO_KSEQ=0 in the environment keeps playback in userspace.
+ *
+ * This header is shared with the module, hence the kernel types.
+ */
+
+#define FAGPIO_KSEQ_DEV		"/dev/fagpio-seq"
+#define FAGPIO_KSEQ_MAX_OPS	1024
+
+// Same layout as struct fagpio_seq_op
+struct fagpio_kseq_op {
+	__u32 at;			//Ticks after start
+	__u32 mask;
+	__u32 value;
+	__u8 port;
+	__u8 pad[3];
+};
+
+struct fagpio_kseq_play {
+	__u64 ops;			//User pointer to count struct fagpio_kseq_op
+	__u32 count;
+	__u32 start;		//AVS counter value op.at is relative to
+	__u32 late;			//Out: ops that were already overdue
+	__u32 pad;
+};
+
+#define FAGPIO_KSEQ_PLAY	_IOWR('F', 0x51, struct fagpio_kseq_play)
+
+#endif
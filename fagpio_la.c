@@ -0,0 +1,551 @@
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "fagpio_priv.h"
+#include "fagpio_la.h"
+#include "fagpio_log.h"
+#include "fagpio_mem.h"
+#include "fagpio_sink.h"
+#include "fagpio_timer.h"
+
+#define LA_CHECK		256		//Samples between stop and duration checks
+
+struct la_buf {
+	struct fagpio_la_block hdr;
+	struct fagpio_la_run runs[FAGPIO_LA_RUNS];
+};
+
+// Stream output, the writer thread's only once capture started
+struct la_out {
+	int fd;
+	int error;
+	unsigned int format;
+	uint8_t port;
+	uint32_t mask;
+	// VCD state
+	int started;
+	uint32_t last_value;
+	uint32_t last_first;	//first_ticks of the previous block
+	uint64_t block_ns;		//Its time since the first block, unwrapped
+	uint64_t last_ns;
+	char text[16384];
+};
+
+struct la_stream {
+	struct la_out out;
+	struct la_buf buf[2];
+	sem_t full;			//Blocks handed to the writer
+	sem_t free;			//Blocks handed back to the sampler
+};
+
+// Pipeline rings: each has one producer and one consumer, walked in order
+struct la_raw {
+	uint32_t first_ticks, last_ticks;
+	uint32_t samples;		//0 ends the stream
+	uint32_t gap;
+	uint32_t v[FAGPIO_LA_RAW_SAMPLES];
+};
+
+struct la_ring {
+	sem_t full;
+	sem_t free;
+};
+
+struct la_pipe {
+	struct la_out out;
+	uint32_t mask;
+	struct la_raw *raw;		//FAGPIO_LA_RAW_POOL
+	struct la_buf *run;		//FAGPIO_LA_RUN_POOL
+	struct la_ring raw_ring, run_ring;
+};
+
+static int write_all(int fd, const void *data, size_t len) {
+	struct iovec iov = { (void *)data, len };
+
+	return fagpio_sink_writev(fd, &iov, 1);
+}
+
+static char vcd_id(unsigned int bit) {
+	return '!' + bit;
+}
+
+static int vcd_header(struct la_out *s) {
+	int n = snprintf(s->text, sizeof(s->text), "$comment fagpio_la P%c mask 0x%08x $end\n$timescale 1ns $end\n$scope module fagpio $end\n",
+		'A' + s->port, s->mask);
+
+	for (uint32_t m = s->mask; m; m &= m - 1)
+		n += snprintf(s->text + n, sizeof(s->text) - n, "$var wire 1 %c P%c%d $end\n", vcd_id(__builtin_ctz(m)), 'A' + s->port, __builtin_ctz(m));
+	n += snprintf(s->text + n, sizeof(s->text) - n, "$upscope $end\n$enddefinitions $end\n");
+	return write_all(s->fd, s->text, n);
+}
+
+/*
+One timestamp and the changed bits per run, straight from the block: a
+run costs its changed bits in text however long it lasts. Run starts are
+interpolated between the block's first and last sample; the blocks' 32-bit
+counters are unwrapped from one block to the next.
+*/
+static int vcd_block(struct la_out *s, const struct la_buf *b) {
+	uint32_t span = b->hdr.last_ticks - b->hdr.first_ticks, steps = b->hdr.samples > 1 ? b->hdr.samples - 1 : 1;
+	uint64_t at = 0;
+	size_t n = 0;
+
+	if (s->started)
+		s->block_ns += (uint64_t)(uint32_t)(b->hdr.first_ticks - s->last_first) * 1000000000ull / fagpio_tick_hz;
+	s->last_first = b->hdr.first_ticks;
+	if (b->hdr.gap)
+		n += snprintf(s->text, sizeof(s->text), "$comment sampling stalled $end\n");
+
+	for (uint32_t r = 0; r < b->hdr.runs; r++) {
+		uint32_t v = b->runs[r].value;
+		uint32_t changed = s->started ? v ^ s->last_value : s->mask;
+		uint64_t ns = s->block_ns + at * span / steps * 1000000000ull / fagpio_tick_hz;
+
+		at += b->runs[r].count;
+		if (!changed)
+			continue;		//Same value across a block boundary
+		if (sizeof(s->text) - n < 32 * 3 + 32) {
+			if (write_all(s->fd, s->text, n) < 0)
+				return -1;
+			n = 0;
+		}
+		if (ns < s->last_ns)
+			ns = s->last_ns;
+		n += snprintf(s->text + n, sizeof(s->text) - n, s->started ? "#%llu\n" : "#%llu\n$dumpvars\n", (unsigned long long)ns);
+		for (; changed; changed &= changed - 1) {
+			unsigned int bit = __builtin_ctz(changed);
+
+			s->text[n++] = (v >> bit) & 1 ? '1' : '0';
+			s->text[n++] = vcd_id(bit);
+			s->text[n++] = '\n';
+		}
+		if (!s->started) {
+			n += snprintf(s->text + n, sizeof(s->text) - n, "$end\n");
+			s->started = 1;
+		}
+		s->last_value = v;
+		s->last_ns = ns;
+	}
+	return n ? write_all(s->fd, s->text, n) : 0;
+}
+
+static int write_block(struct la_out *s, const struct la_buf *b) {
+	if (s->format == FAGPIO_LA_VCD)
+		return vcd_block(s, b);
+	return write_all(s->fd, b, sizeof(b->hdr) + b->hdr.runs * sizeof(b->runs[0]));
+}
+
+// Resets the output state and writes the stream header
+static int out_start(struct la_out *s, uint8_t port, uint32_t mask, int fd, unsigned int format) {
+	struct fagpio_la_header hdr = { FAGPIO_LA_MAGIC, port, mask, fagpio_tick_hz };
+
+	s->fd = fd;
+	s->error = 0;
+	s->format = format;
+	s->port = port;
+	s->mask = mask;
+	s->started = 0;
+	s->block_ns = s->last_ns = 0;
+	return format == FAGPIO_LA_VCD ? vcd_header(s) : write_all(fd, &hdr, sizeof(hdr));
+}
+
+// Writes blocks in order until it gets one with hdr.runs == 0
+static void *la_writer(void *arg) {
+	struct la_stream *s = arg;
+
+	for (unsigned int i = 0;; i ^= 1) {
+		struct la_buf *b = &s->buf[i];
+
+		while (sem_wait(&s->full) < 0)
+			;
+		if (!b->hdr.runs)
+			break;
+		if (!s->out.error && write_block(&s->out, b) < 0)
+			s->out.error = errno;
+		sem_post(&s->free);
+	}
+	return NULL;
+}
+
+int64_t fagpio_la_capture(uint8_t port, uint32_t mask, int fd, uint32_t duration_ticks, volatile int *stop) {
+	return fagpio_la_capture_format(port, mask, fd, duration_ticks, stop, FAGPIO_LA_RAW);
+}
+
+int64_t fagpio_la_capture_format(uint8_t port, uint32_t mask, int fd, uint32_t duration_ticks, volatile int *stop, unsigned int format) {
+	return fagpio_la_capture_arena(port, mask, fd, duration_ticks, stop, format, NULL);
+}
+
+static void la_give(struct fagpio_arena *arena, size_t mark, void *p) {
+	fagpio_mem_give(arena, p);
+	if (arena)
+		fagpio_arena_release(arena, mark);
+}
+
+int64_t fagpio_la_capture_arena(uint8_t port, uint32_t mask, int fd, uint32_t duration_ticks, volatile int *stop, unsigned int format, struct fagpio_arena *arena) {
+	struct pio_bank *banks = fagpio_banks();
+	size_t mark = arena ? fagpio_arena_mark(arena) : 0;
+	struct la_stream *s;		//80 KB, allocated rather than on the stack
+	pthread_t writer;
+
+	if (!banks || port >= PIO_NPORTS || format > FAGPIO_LA_VCD || !(s = fagpio_mem_take(arena, sizeof(*s), 0)))
+		return -1;
+
+	if (out_start(&s->out, port, mask, fd, format) < 0) {
+		la_give(arena, mark, s);
+		return -1;
+	}
+	sem_init(&s->full, 0, 0);
+	sem_init(&s->free, 0, 1);		//The sampler owns buffer 0, buffer 1 is free
+	if (pthread_create(&writer, NULL, la_writer, s)) {
+		sem_destroy(&s->full);
+		sem_destroy(&s->free);
+		la_give(arena, mark, s);
+		return -1;
+	}
+
+	volatile uint32_t *dat = &banks[port].dat;
+	struct la_buf *b = &s->buf[0];
+	unsigned int cur = 0, n = 0, gap = 0;
+	uint32_t start = fagpio_ticks(), now = start;
+	uint32_t value = *dat & mask, count = 1;
+	int64_t total = 0;
+	int done = 0;
+
+	b->hdr.first_ticks = start;
+	while (!done) {
+		for (unsigned int i = 0; i < LA_CHECK; i++) {
+			uint32_t v = *dat & mask;
+
+			if (v == value) {
+				count++;
+				continue;
+			}
+			b->runs[n].value = value;
+			b->runs[n].count = count;
+			value = v;
+			count = 1;
+			if (++n == FAGPIO_LA_RUNS)
+				break;
+		}
+		now = fagpio_ticks();
+		done = (stop && *stop) || (duration_ticks && now - start >= duration_ticks);
+		if (done) {
+			b->runs[n].value = value;
+			b->runs[n++].count = count;
+		}
+		if (n < FAGPIO_LA_RUNS && !done)
+			continue;
+
+		uint32_t samples = 0;
+
+		for (unsigned int i = 0; i < n; i++)
+			samples += b->runs[i].count;
+		b->hdr.runs = n;
+		b->hdr.samples = samples;
+		b->hdr.last_ticks = now;
+		b->hdr.gap = gap;
+		total += samples;
+		sem_post(&s->full);
+
+		// The other buffer is free unless the writer fell behind
+		gap = sem_trywait(&s->free) < 0;
+		if (gap) {
+			FAGPIO_LOG(FAGPIO_LOG_DEBUG, "LA: writer behind, sampling stalls\n");
+			while (sem_wait(&s->free) < 0)
+				;
+		}
+		cur ^= 1;
+		b = &s->buf[cur];
+		n = 0;
+		b->hdr.first_ticks = fagpio_ticks();
+	}
+
+	// The buffer we switched to is next in the writer's order: an empty one ends the stream
+	s->buf[cur].hdr.runs = 0;
+	sem_post(&s->full);
+	pthread_join(writer, NULL);
+	sem_destroy(&s->full);
+	sem_destroy(&s->free);
+
+	int error = s->out.error;
+
+	la_give(arena, mark, s);
+	if (error) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "LA: %s\n", strerror(error));
+		return -1;
+	}
+	return total;
+}
+
+static void ring_take(sem_t *sem) {
+	while (sem_wait(sem) < 0)
+		;
+}
+
+static int ring_init(struct la_ring *r, unsigned int size) {
+	if (sem_init(&r->full, 0, 0) < 0)
+		return -1;
+	if (sem_init(&r->free, 0, size) < 0) {
+		sem_destroy(&r->full);
+		return -1;
+	}
+	return 0;
+}
+
+static void ring_destroy(struct la_ring *r) {
+	sem_destroy(&r->full);
+	sem_destroy(&r->free);
+}
+
+/*
+Raw blocks that are ready together go out in one fagpio_sink_writev(),
+straight from the ring: a header and its runs are one iovec entry.
+*/
+static void *la_pipe_writer(void *arg) {
+	struct la_pipe *p = arg;
+	struct iovec iov[FAGPIO_SINK_IOV];
+	unsigned int i = 0;
+	int end = 0;
+
+	while (!end) {
+		int n = 0;
+
+		ring_take(&p->run_ring.full);
+		do {
+			struct la_buf *b = &p->run[(i + n) % FAGPIO_LA_RUN_POOL];
+
+			if (!b->hdr.runs) {
+				end = 1;
+				break;
+			}
+			iov[n].iov_base = b;
+			iov[n++].iov_len = sizeof(b->hdr) + b->hdr.runs * sizeof(b->runs[0]);
+		} while (p->out.format == FAGPIO_LA_RAW && n < FAGPIO_SINK_IOV && sem_trywait(&p->run_ring.full) == 0);
+
+		if (!p->out.error) {
+			if (p->out.format == FAGPIO_LA_RAW) {
+				if (n && fagpio_sink_writev(p->out.fd, iov, n) < 0)
+					p->out.error = errno;
+			} else if (n && write_block(&p->out, &p->run[i]) < 0) {
+				p->out.error = errno;
+			}
+		}
+		for (; n; n--) {
+			sem_post(&p->run_ring.free);
+			i = (i + 1) % FAGPIO_LA_RUN_POOL;
+		}
+	}
+	return NULL;
+}
+
+/*
+Masks and run-length encodes raw blocks, appending as many as fit to one
+encoded block; a run carries over from one raw block to the next. A raw
+block after a gap starts a new encoded block, so the gap stays where the
+VCD writer interpolates from.
+*/
+static void *la_pipe_compressor(void *arg) {
+	struct la_pipe *p = arg;
+	struct la_buf *b = NULL;
+	unsigned int ri = 0, bi = 0;
+
+	for (;; ri = (ri + 1) % FAGPIO_LA_RAW_POOL) {
+		struct la_raw *r = &p->raw[ri];
+
+		ring_take(&p->raw_ring.full);
+		if (b && (!r->samples || r->gap || b->hdr.runs + FAGPIO_LA_RAW_SAMPLES + 1 > FAGPIO_LA_RUNS)) {
+			sem_post(&p->run_ring.full);
+			bi = (bi + 1) % FAGPIO_LA_RUN_POOL;
+			b = NULL;
+		}
+		if (!r->samples)
+			break;
+		if (!b) {
+			ring_take(&p->run_ring.free);
+			b = &p->run[bi];
+			b->hdr.runs = 0;
+			b->hdr.samples = 0;
+			b->hdr.first_ticks = r->first_ticks;
+			b->hdr.gap = r->gap;
+		}
+
+		struct fagpio_la_run *run = &b->runs[b->hdr.runs];
+		uint32_t mask = p->mask, value, count;
+		unsigned int i = 0;
+
+		if (b->hdr.runs) {
+			run--;
+			value = run->value;
+			count = run->count;
+		} else {
+			value = r->v[i++] & mask;
+			count = 1;
+		}
+		for (; i < r->samples; i++) {
+			uint32_t v = r->v[i] & mask;
+
+			if (v == value) {
+				count++;
+				continue;
+			}
+			run->value = value;
+			run->count = count;
+			run++;
+			value = v;
+			count = 1;
+		}
+		run->value = value;
+		run->count = count;
+		b->hdr.runs = run - b->runs + 1;
+		b->hdr.samples += r->samples;
+		b->hdr.last_ticks = r->last_ticks;
+		sem_post(&p->raw_ring.free);
+	}
+
+	// Empty block ends the writer
+	ring_take(&p->run_ring.free);
+	p->run[bi].hdr.runs = 0;
+	sem_post(&p->run_ring.full);
+	return NULL;
+}
+
+static int start_thread(pthread_t *t, void *(*fn)(void *), void *arg) {
+	struct sched_param sp = { .sched_priority = 0 };
+	pthread_attr_t attr;
+	int ret;
+
+	// Not the sampler's SCHED_FIFO, which a new thread would inherit
+	pthread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+	pthread_attr_setschedparam(&attr, &sp);
+	ret = pthread_create(t, &attr, fn, arg);
+	pthread_attr_destroy(&attr);
+	return ret ? -1 : 0;
+}
+
+int64_t fagpio_la_pipeline(uint8_t port, uint32_t mask, int fd, uint32_t duration_ticks, volatile int *stop, unsigned int format, int prio, uint32_t *stalls) {
+	return fagpio_la_pipeline_arena(port, mask, fd, duration_ticks, stop, format, prio, stalls, NULL);
+}
+
+int64_t fagpio_la_pipeline_arena(uint8_t port, uint32_t mask, int fd, uint32_t duration_ticks, volatile int *stop, unsigned int format, int prio, uint32_t *stalls, struct fagpio_arena *arena) {
+	struct pio_bank *banks = fagpio_banks();
+	size_t mark = arena ? fagpio_arena_mark(arena) : 0;
+	struct la_pipe *p;
+	pthread_t compressor, writer;
+	struct sched_param old_sp;
+	int old_policy;
+
+	if (stalls)
+		*stalls = 0;
+	if (!banks || port >= PIO_NPORTS || format > FAGPIO_LA_VCD || !(p = fagpio_mem_take(arena, sizeof(*p), 0)))
+		return -1;
+
+	p->mask = mask;
+	p->raw = fagpio_mem_take(arena, FAGPIO_LA_RAW_POOL * sizeof(*p->raw), 0);
+	p->run = fagpio_mem_take(arena, FAGPIO_LA_RUN_POOL * sizeof(*p->run), 0);
+	if (!p->raw || !p->run)
+		goto err_mem;
+	memset(p->raw, 0, FAGPIO_LA_RAW_POOL * sizeof(*p->raw));		//Prefault
+	memset(p->run, 0, FAGPIO_LA_RUN_POOL * sizeof(*p->run));
+	if (out_start(&p->out, port, mask, fd, format) < 0)
+		goto err_mem;
+	if (ring_init(&p->raw_ring, FAGPIO_LA_RAW_POOL) < 0)
+		goto err_mem;
+	if (ring_init(&p->run_ring, FAGPIO_LA_RUN_POOL) < 0)
+		goto err_raw;
+	if (start_thread(&writer, la_pipe_writer, p) < 0)
+		goto err_run;
+	if (start_thread(&compressor, la_pipe_compressor, p) < 0) {
+		// An empty block ends the writer
+		ring_take(&p->run_ring.free);
+		p->run[0].hdr.runs = 0;
+		sem_post(&p->run_ring.full);
+		pthread_join(writer, NULL);
+		goto err_run;
+	}
+
+	pthread_getschedparam(pthread_self(), &old_policy, &old_sp);
+	if (prio) {
+		struct sched_param sp = { .sched_priority = prio };
+
+		if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp))
+			FAGPIO_LOG(FAGPIO_LOG_ERR, "LA: SCHED_FIFO %d refused\n", prio);
+	}
+
+	volatile uint32_t *dat = &banks[port].dat;
+	uint32_t start = fagpio_ticks(), now;
+	unsigned int ri = 0, credit = 0;
+	int64_t total = 0;
+	uint32_t gap = 0;
+	int done = 0;
+
+	// Blocks are taken from the ring in credits: after a stall, half of it at once
+	while (!done) {
+		if (!credit) {
+			if (sem_trywait(&p->raw_ring.free) == 0) {
+				credit = 1;
+			} else {
+				FAGPIO_LOG(FAGPIO_LOG_DEBUG, "LA: compressor behind, sampling stalls\n");
+				for (; credit < FAGPIO_LA_RAW_POOL / 2 || !credit; credit++)
+					ring_take(&p->raw_ring.free);
+				gap = 1;
+				if (stalls)
+					(*stalls)++;
+			}
+		}
+
+		struct la_raw *r = &p->raw[ri];
+		uint32_t *v = r->v;
+
+		r->first_ticks = fagpio_ticks();
+		for (unsigned int i = 0; i < FAGPIO_LA_RAW_SAMPLES; i++)
+			v[i] = *dat;
+		now = fagpio_ticks();
+		r->last_ticks = now;
+		r->samples = FAGPIO_LA_RAW_SAMPLES;
+		r->gap = gap;
+		gap = 0;
+		total += FAGPIO_LA_RAW_SAMPLES;
+		sem_post(&p->raw_ring.full);
+		credit--;
+		ri = (ri + 1) % FAGPIO_LA_RAW_POOL;
+		done = (stop && *stop) || (duration_ticks && now - start >= duration_ticks);
+	}
+
+	// An empty raw block ends the compressor, which ends the writer
+	if (!credit)
+		ring_take(&p->raw_ring.free);
+	p->raw[ri].samples = 0;
+	sem_post(&p->raw_ring.full);
+	pthread_setschedparam(pthread_self(), old_policy, &old_sp);
+	pthread_join(compressor, NULL);
+	pthread_join(writer, NULL);
+	ring_destroy(&p->run_ring);
+	ring_destroy(&p->raw_ring);
+	fagpio_mem_give(arena, p->run);
+	fagpio_mem_give(arena, p->raw);
+
+	int error = p->out.error;
+
+	la_give(arena, mark, p);
+	if (error) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "LA: %s\n", strerror(error));
+		return -1;
+	}
+	return total;
+
+err_run:
+	ring_destroy(&p->run_ring);
+err_raw:
+	ring_destroy(&p->raw_ring);
+err_mem:
+	fagpio_mem_give(arena, p->run);
+	fagpio_mem_give(arena, p->raw);
+	la_give(arena, mark, p);
+	return -1;
+}
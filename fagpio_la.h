@@ -0,0 +1,95 @@
+#ifndef _FAGPIO_LA_H
+#define _FAGPIO_LA_H
+
+#include <stdint.h>
+#include "fagpio_mem.h"
+
+/*
+ * Streaming logic-analyzer capture. The calling thread samples one port's
+ * DAT in a tight loop and run-length encodes it straight into one of two
+ * blocks; a full block is handed to a writer thread that streams it to a
+ * file or socket while sampling goes on in the other block. Slow-changing
+ * buses cost 8 bytes per change instead of 4 bytes per sample.
+ *
+ * Stream: one struct fagpio_la_header, then blocks of a struct
+ * fagpio_la_block followed by its runs. Sample times are interpolated
+ * between a block's first_ticks and last_ticks.
+ *
+ * FAGPIO_LA_VCD writes a Value Change Dump instead, which sigrok-cli
+ * (-I vcd) and PulseView import: the writer turns each run into one
+ * timestamp and its changed bits, so the file stays as small as the runs
+ * and the sampling loop is the same.
+ *
+ * fagpio_la_pipeline() splits the same work over three stages: the
+ * calling thread, raised to SCHED_FIFO, only stores raw DAT words into
+ * fixed blocks; a compressor thread run-length encodes them into the
+ * blocks above, several raw blocks to one; a writer thread does the I/O.
+ * Blocks come from two rings allocated and prefaulted before the first
+ * sample, each with one producer and one consumer, so nothing is
+ * allocated while sampling and a stage only blocks on its own ring. The
+ * sampler never waits for the writer: when no raw block is free it waits
+ * until the compressor returned half the ring and the next block is
+ * marked as a gap. On a single core those waits are where the other
+ * stages run, so a capture is bursts of FAGPIO_LA_RAW_POOL / 2 blocks.
+ */
+
+#define FAGPIO_LA_RAW		0
+#define FAGPIO_LA_VCD		1
+
+#define FAGPIO_LA_MAGIC		0x414C4746		//"FGLA"
+#define FAGPIO_LA_RUNS		4096			//Runs per block
+
+#ifndef FAGPIO_LA_RAW_SAMPLES
+#define FAGPIO_LA_RAW_SAMPLES	1024		//Samples per pipeline raw block
+#endif
+#ifndef FAGPIO_LA_RAW_POOL
+#define FAGPIO_LA_RAW_POOL		64			//Raw blocks in the ring
+#endif
+#ifndef FAGPIO_LA_RUN_POOL
+#define FAGPIO_LA_RUN_POOL		8			//Encoded blocks in the ring
+#endif
+
+struct fagpio_la_header {
+	uint32_t magic;
+	uint32_t port;
+	uint32_t mask;
+	uint32_t tick_hz;
+};
+
+struct fagpio_la_block {
+	uint32_t runs;
+	uint32_t samples;
+	uint32_t first_ticks;	//Counter at the first and last sample of the block
+	uint32_t last_ticks;
+	uint32_t gap;			//Non-zero if sampling stalled on the writer before this block
+};
+
+struct fagpio_la_run {
+	uint32_t value;			//DAT & mask
+	uint32_t count;			//Consecutive samples with that value
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Samples until duration_ticks pass (0: no limit) or *stop becomes
+ * non-zero, writing the stream to fd. Returns the number of samples, -1 on
+ * error.
+ */
+int64_t fagpio_la_capture(uint8_t port, uint32_t mask, int fd, uint32_t duration_ticks, volatile int *stop);
+int64_t fagpio_la_capture_format(uint8_t port, uint32_t mask, int fd, uint32_t duration_ticks, volatile int *stop, unsigned int format);
+
+// Same stream through the three-stage pipeline; prio 0 keeps the caller's policy, *stalls (may be NULL) counts gaps
+int64_t fagpio_la_pipeline(uint8_t port, uint32_t mask, int fd, uint32_t duration_ticks, volatile int *stop, unsigned int format, int prio, uint32_t *stalls);
+
+// Both with their buffers from arena (fagpio_mem.h), released again on return
+int64_t fagpio_la_capture_arena(uint8_t port, uint32_t mask, int fd, uint32_t duration_ticks, volatile int *stop, unsigned int format, struct fagpio_arena *arena);
+int64_t fagpio_la_pipeline_arena(uint8_t port, uint32_t mask, int fd, uint32_t duration_ticks, volatile int *stop, unsigned int format, int prio, uint32_t *stalls, struct fagpio_arena *arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,156 @@
+#include "fagpio_priv.h"
+#include "fagpio_lcd.h"
+#include "fagpio_timer.h"
+
+int fagpio_lcd_init(struct fagpio_lcd *lcd, uint8_t d0, uint8_t dc, uint8_t strobe, uint8_t cs, uint8_t bus, uint32_t min_cycle_ns) {
+	struct pio_bank *banks = fagpio_banks();
+	uint8_t port = PIO_PIN_PORT(d0);
+	uint32_t data;
+
+	if (!banks || bus > FAGPIO_LCD_6800 || port >= PIO_NPORTS || PIO_PIN_NUM(d0) > 24)
+		return -1;
+	if (PIO_PIN_PORT(dc) != port || PIO_PIN_PORT(strobe) != port || dc == strobe)
+		return -1;
+	if (cs != FAGPIO_LCD_NO_PIN && PIO_PIN_PORT(cs) >= PIO_NPORTS)
+		return -1;
+
+	data = 0xFFu << PIO_PIN_NUM(d0);
+	if (data & (PIO_PIN_MASK(dc) | PIO_PIN_MASK(strobe)))
+		return -1;
+
+	lcd->port = port;
+	lcd->shift = PIO_PIN_NUM(d0);
+	lcd->bus = bus;
+	lcd->cs = cs;
+	lcd->dc = PIO_PIN_MASK(dc);
+	lcd->mask = data | lcd->dc | PIO_PIN_MASK(strobe);
+	lcd->strobe_on = bus == FAGPIO_LCD_8080 ? 0 : PIO_PIN_MASK(strobe);
+	lcd->strobe_off = bus == FAGPIO_LCD_8080 ? PIO_PIN_MASK(strobe) : 0;
+	lcd->dat = &banks[port].dat;
+	lcd->hold_ticks = min_cycle_ns ? fagpio_ns_to_ticks((min_cycle_ns + 1) / 2) : 0;
+
+	digitalWritePort(port, lcd->mask, lcd->strobe_off | lcd->dc);	//Strobe released
+	for (unsigned int i = 0; i < 8; i++)
+		pinMode(d0 + i, 0);
+	pinMode(dc, 0);
+	pinMode(strobe, 0);
+	if (cs != FAGPIO_LCD_NO_PIN) {
+		fagpio_digital_write(fagpio_default(), cs, HIGH);
+		pinMode(cs, 0);
+	}
+	return 0;
+}
+
+static inline void hold(uint32_t ticks) {
+	if (ticks)
+		fagpio_delay_cycles(ticks);
+}
+
+// One byte is two stores: data with the strobe active, then released
+#define LCD_BYTE(b) do { \
+		uint32_t w = base | ((uint32_t)(b) << shift); \
+		*dat = w | on; \
+		hold(ticks); \
+		*dat = w | off; \
+		hold(ticks); \
+	} while (0)
+
+#define LCD_LOCALS(lcd, dc_level) \
+	volatile uint32_t *dat = (lcd)->dat; \
+	uint32_t base = (*dat & ~(lcd)->mask) | ((dc_level) ? (lcd)->dc : 0); \
+	uint32_t on = (lcd)->strobe_on, off = (lcd)->strobe_off; \
+	uint32_t ticks = (lcd)->hold_ticks; \
+	unsigned int shift = (lcd)->shift
+
+static inline void chip_select(struct fagpio_lcd *lcd, uint8_t level) {
+	if (lcd->cs != FAGPIO_LCD_NO_PIN)
+		fagpio_digital_write(fagpio_default(), lcd->cs, level);
+}
+
+static void write_command(struct fagpio_lcd *lcd, uint8_t cmd) {
+	LCD_LOCALS(lcd, 0);
+
+	LCD_BYTE(cmd);
+	*dat = base | lcd->dc | off;	//DC back to data
+}
+
+static void write_data(struct fagpio_lcd *lcd, const uint8_t *buf, size_t len) {
+	LCD_LOCALS(lcd, 1);
+	size_t i = 0;
+
+	for (; i + 4 <= len; i += 4) {
+		LCD_BYTE(buf[i]);
+		LCD_BYTE(buf[i + 1]);
+		LCD_BYTE(buf[i + 2]);
+		LCD_BYTE(buf[i + 3]);
+	}
+	for (; i < len; i++)
+		LCD_BYTE(buf[i]);
+}
+
+void fagpio_lcd_command(struct fagpio_lcd *lcd, uint8_t cmd) {
+	chip_select(lcd, LOW);
+	write_command(lcd, cmd);
+	chip_select(lcd, HIGH);
+	fagpio_shadow_sync(lcd->port);
+}
+
+void fagpio_lcd_data(struct fagpio_lcd *lcd, const uint8_t *buf, size_t len) {
+	chip_select(lcd, LOW);
+	write_data(lcd, buf, len);
+	chip_select(lcd, HIGH);
+	fagpio_shadow_sync(lcd->port);
+}
+
+void fagpio_lcd_command_data(struct fagpio_lcd *lcd, uint8_t cmd, const uint8_t *buf, size_t len) {
+	chip_select(lcd, LOW);
+	write_command(lcd, cmd);
+	write_data(lcd, buf, len);
+	chip_select(lcd, HIGH);
+	fagpio_shadow_sync(lcd->port);
+}
+
+void fagpio_lcd_write_buffer(struct fagpio_lcd *lcd, const uint16_t *pixels, size_t count) {
+	chip_select(lcd, LOW);
+	{
+		LCD_LOCALS(lcd, 1);
+		size_t i = 0;
+
+		for (; i + 2 <= count; i += 2) {
+			uint16_t p0 = pixels[i], p1 = pixels[i + 1];
+
+			LCD_BYTE(p0 >> 8);
+			LCD_BYTE(p0 & 0xFF);
+			LCD_BYTE(p1 >> 8);
+			LCD_BYTE(p1 & 0xFF);
+		}
+		if (i < count) {
+			LCD_BYTE(pixels[i] >> 8);
+			LCD_BYTE(pixels[i] & 0xFF);
+		}
+	}
+	chip_select(lcd, HIGH);
+	fagpio_shadow_sync(lcd->port);
+}
+
+void fagpio_lcd_fill(struct fagpio_lcd *lcd, uint16_t color, size_t count) {
+	chip_select(lcd, LOW);
+	{
+		LCD_LOCALS(lcd, 1);
+		uint32_t hi = base | ((uint32_t)(color >> 8) << shift);
+		uint32_t lo = base | ((uint32_t)(color & 0xFF) << shift);
+
+		for (size_t i = 0; i < count; i++) {
+			*dat = hi | on;
+			hold(ticks);
+			*dat = hi | off;
+			hold(ticks);
+			*dat = lo | on;
+			hold(ticks);
+			*dat = lo | off;
+			hold(ticks);
+		}
+	}
+	chip_select(lcd, HIGH);
+	fagpio_shadow_sync(lcd->port);
+}
@@ -0,0 +1,58 @@
+#ifndef _FAGPIO_LCD_H
+#define _FAGPIO_LCD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * 8-bit 8080/6800 parallel LCD bus, e.g. an ILI9341 on PE0-PE7. The data
+ * lines are 8 consecutive pins of one port, and DC and the strobe (WR for
+ * 8080, E for 6800) sit on the same port, so every byte is two whole-port
+ * stores: data, DC and the active strobe, then the same word with the
+ * strobe released. Other pins of the port keep the level they had when
+ * the transfer started. CS may be on any port and is asserted once per
+ * call.
+ */
+
+#define FAGPIO_LCD_8080			0	//WR active low, latched on the rising edge
+#define FAGPIO_LCD_6800			1	//E active high, latched on the falling edge, R/W tied low
+
+#define FAGPIO_LCD_NO_PIN		0xFF
+
+struct fagpio_lcd {
+	uint8_t port;
+	uint8_t shift;			//Number of the first data pin
+	uint8_t bus;
+	uint8_t cs;				//FAGPIO_LCD_NO_PIN when CS is tied low
+	uint32_t mask;			//Data, DC and strobe pins
+	uint32_t dc;			//Pin masks
+	uint32_t strobe_on;		//Strobe bits while active and released
+	uint32_t strobe_off;
+	volatile uint32_t *dat;
+	uint32_t hold_ticks;	//Counter ticks per strobe phase, 0 for full speed
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// strobe is WR or E, cs may be FAGPIO_LCD_NO_PIN; min_cycle_ns 0 runs as fast as the stores go
+int fagpio_lcd_init(struct fagpio_lcd *lcd, uint8_t d0, uint8_t dc, uint8_t strobe, uint8_t cs, uint8_t bus, uint32_t min_cycle_ns);
+
+void fagpio_lcd_command(struct fagpio_lcd *lcd, uint8_t cmd);
+void fagpio_lcd_data(struct fagpio_lcd *lcd, const uint8_t *buf, size_t len);
+
+// Command followed by its parameter bytes in one CS cycle
+void fagpio_lcd_command_data(struct fagpio_lcd *lcd, uint8_t cmd, const uint8_t *buf, size_t len);
+
+// RGB565 pixels as data, high byte first, e.g. after a RAMWR (0x2C) command
+void fagpio_lcd_write_buffer(struct fagpio_lcd *lcd, const uint16_t *pixels, size_t count);
+
+// count copies of one pixel, for clears and solid rectangles
+void fagpio_lcd_fill(struct fagpio_lcd *lcd, uint16_t color, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,171 @@
+#include <string.h>
+#include "fagpio.h"
+#include "fagpio_linecode.h"
+#include "fagpio_timer.h"
+
+int fagpio_linecode_init(struct fagpio_linecode *lc, uint8_t code, uint8_t tx, uint8_t rx, uint32_t half_ns, unsigned int flags) {
+	if (code > FAGPIO_LC_DALI || !half_ns || fagpio_setup() < 0)
+		return -1;
+	if ((tx != FAGPIO_LC_NO_PIN && PIO_PIN_PORT(tx) >= PIO_NPORTS) || (rx != FAGPIO_LC_NO_PIN && PIO_PIN_PORT(rx) >= PIO_NPORTS))
+		return -1;
+
+	memset(lc, 0, sizeof(*lc));
+	lc->code = code;
+	lc->flags = flags;
+	lc->idle = code == FAGPIO_LC_DALI || (flags & FAGPIO_LC_IDLE_HIGH);
+	lc->stop_halves = code == FAGPIO_LC_DALI ? 4 : 2;
+	lc->half_ns = half_ns;
+	lc->half = fagpio_ns_to_ticks(half_ns);
+	if (tx != FAGPIO_LC_NO_PIN) {
+		lc->tx_port = PIO_PIN_PORT(tx);
+		lc->tx_mask = PIO_PIN_MASK(tx);
+		digitalWritePort(lc->tx_port, lc->tx_mask, (lc->idle ^ (flags & FAGPIO_LC_INVERT)) ? lc->tx_mask : 0);
+		pinMode(tx, OUTPUT);
+	}
+	if (rx != FAGPIO_LC_NO_PIN && rx != tx) {
+		lc->rx_port = PIO_PIN_PORT(rx);
+		lc->rx_mask = PIO_PIN_MASK(rx);
+		pinMode(rx, INPUT);
+	} else if (rx == tx) {
+		lc->rx_port = lc->tx_port;
+		lc->rx_mask = lc->tx_mask;
+	}
+	return 0;
+}
+
+int fagpio_dali_init(struct fagpio_linecode *lc, uint8_t tx, uint8_t rx, unsigned int flags) {
+	return fagpio_linecode_init(lc, FAGPIO_LC_DALI, tx, rx, FAGPIO_DALI_HALF_NS, flags & FAGPIO_LC_INVERT);
+}
+
+// Line levels of the two halves of a data bit; prev is the level just before it
+static void bit_halves(const struct fagpio_linecode *lc, unsigned int bit, uint8_t prev, uint8_t h[2]) {
+	if (lc->code == FAGPIO_LC_DIFF_MANCHESTER)
+		h[0] = bit ? prev : !prev;		//A 0 has a transition at the start of the bit
+	else
+		h[0] = !bit ^ !!(lc->flags & FAGPIO_LC_THOMAS);		//IEEE: a 1 is low then high
+	h[1] = !h[0];
+}
+
+static int emit(const struct fagpio_linecode *lc, struct fagpio_seq *seq, uint32_t at, uint8_t level) {
+	uint32_t pin = (level ^ (lc->flags & FAGPIO_LC_INVERT)) ? lc->tx_mask : 0;
+
+	return fagpio_seq_add(seq, lc->tx_port, lc->tx_mask, pin, at - seq->end);
+}
+
+int fagpio_linecode_encode(const struct fagpio_linecode *lc, struct fagpio_seq *seq, const uint8_t *data, unsigned int bits, uint32_t delta) {
+	unsigned int halves = 2 * (bits + 1);
+	uint32_t base = seq->end + delta;
+	uint8_t level = lc->idle, h[2];
+
+	if (!lc->tx_mask || (uint64_t)(halves + lc->stop_halves) * lc->half_ns > UINT32_MAX)
+		return -1;
+
+	for (unsigned int b = 0; b <= bits; b++) {
+		if (!b) {
+			h[0] = !lc->idle;		//Start bit
+			h[1] = lc->idle;
+		} else {
+			bit_halves(lc, (data[(b - 1) / 8] >> (7 - (b - 1) % 8)) & 1, h[1], h);
+		}
+		for (unsigned int i = 0; i < 2; i++) {
+			if (h[i] != level && emit(lc, seq, base + fagpio_ns_to_ticks((2 * b + i) * lc->half_ns), h[i]) < 0)
+				return -1;
+			level = h[i];
+		}
+	}
+	if (level != lc->idle && emit(lc, seq, base + fagpio_ns_to_ticks(halves * lc->half_ns), lc->idle) < 0)
+		return -1;
+	// A store of the idle level at the end keeps the stop bits in the timeline
+	return emit(lc, seq, base + fagpio_ns_to_ticks((halves + lc->stop_halves) * lc->half_ns), lc->idle);
+}
+
+int fagpio_dali_forward(const struct fagpio_linecode *lc, struct fagpio_seq *seq, uint8_t addr, uint8_t data) {
+	uint8_t frame[2] = { addr, data };
+
+	return fagpio_linecode_encode(lc, seq, frame, 16, 0);
+}
+
+int fagpio_dali_backward(const struct fagpio_linecode *lc, struct fagpio_seq *seq, uint8_t data) {
+	return fagpio_linecode_encode(lc, seq, &data, 8, 0);
+}
+
+struct decoder {
+	const struct fagpio_linecode *lc;
+	uint8_t *out;
+	unsigned int max_bits;
+	int bits;			//-1 until the start bit has been seen
+	uint8_t first;		//First half of the pair being built
+	uint8_t have_first;
+	uint8_t prev;		//Second half of the last bit
+};
+
+// Takes one half bit; -1 on a violation
+static int feed_half(struct decoder *d, uint8_t level) {
+	if (!d->have_first) {
+		d->first = level;
+		d->have_first = 1;
+		return 0;
+	}
+	d->have_first = 0;
+	if (d->first == level)
+		return -1;		//No mid-bit transition
+	if (d->bits < 0) {
+		d->bits = 0;
+		d->prev = level;
+		return 0;
+	}
+
+	unsigned int bit;
+
+	if (d->lc->code == FAGPIO_LC_DIFF_MANCHESTER)
+		bit = d->first == d->prev;
+	else
+		bit = level ^ !!(d->lc->flags & FAGPIO_LC_THOMAS);
+	d->prev = level;
+	if ((unsigned int)d->bits >= d->max_bits)
+		return -1;
+
+	uint8_t *byte = &d->out[d->bits / 8], m = 0x80 >> (d->bits % 8);
+
+	*byte = bit ? *byte | m : *byte & ~m;
+	d->bits++;
+	return 0;
+}
+
+int fagpio_linecode_decode(const struct fagpio_linecode *lc, const struct fagpio_sample *edges, unsigned int count, uint8_t *out, unsigned int max_bits) {
+	struct decoder d = { lc, out, max_bits, -1, 0, 0, 0 };
+	uint8_t inv = lc->flags & FAGPIO_LC_INVERT;
+	uint32_t tol = lc->half / FAGPIO_LC_TOLERANCE;
+	unsigned int i = 1;
+
+	if (!lc->rx_mask || !lc->half)
+		return -1;
+	// The frame starts at the first edge leaving the idle level
+	while (i < count && (((edges[i].value & lc->rx_mask) != 0) ^ inv) == lc->idle)
+		i++;
+	for (; i < count; i++) {
+		uint8_t level = ((edges[i].value & lc->rx_mask) != 0) ^ inv;
+
+		if (i + 1 == count) {
+			if (level != lc->idle)
+				return -1;		//Still mid-frame when the capture ended
+			break;
+		}
+
+		uint32_t dt = edges[i + 1].ticks - edges[i].ticks;
+		uint32_t n = (dt + lc->half / 2) / lc->half;
+
+		if (n > 2 && level == lc->idle)
+			break;				//Stop bits
+		if (!n || n > 2 || (dt > n * lc->half ? dt - n * lc->half : n * lc->half - dt) > tol)
+			return -1;
+		while (n--) {
+			if (feed_half(&d, level) < 0)
+				return -1;
+		}
+	}
+	// The last bit may end in idle, merged with the stop bits
+	if (d.have_first && feed_half(&d, lc->idle) < 0)
+		return -1;
+	return d.bits;
+}
@@ -0,0 +1,72 @@
+#ifndef _FAGPIO_LINECODE_H
+#define _FAGPIO_LINECODE_H
+
+#include <stdint.h>
+#include "fagpio_seq.h"
+#include "fagpio_capture.h"
+
+/*
+ * Bi-phase line codes: Manchester (IEEE 802.3, or G.E. Thomas with
+ * FAGPIO_LC_THOMAS), differential Manchester, and DALI forward and
+ * backward frames. Every frame is a start bit whose first half leaves the
+ * idle level, the data MSB first, and stop_halves half bits of idle.
+ *
+ * fagpio_linecode_encode() appends a frame to a sequencer timeline
+ * (fagpio_seq.h), one op per level change at absolute half-bit offsets, so
+ * fagpio_seq_play() sends it with counter-paced stores and no drift.
+ * fagpio_linecode_decode() works on a fagpio_capture_edges() buffer of the
+ * receive pin: intervals are rounded to one or two half bits (within
+ * FAGPIO_LC_TOLERANCE), and a missing mid-bit transition or an interval
+ * off the grid fails the frame.
+ */
+
+#define FAGPIO_LC_MANCHESTER		0
+#define FAGPIO_LC_DIFF_MANCHESTER	1
+#define FAGPIO_LC_DALI				2		//Manchester at 1200 bit/s, bus idle high, 2 stop bits
+
+#define FAGPIO_LC_INVERT			0x01	//Pins are inverted from the line (optocoupled DALI interfaces)
+#define FAGPIO_LC_THOMAS			0x02	//Manchester 1 is high then low
+#define FAGPIO_LC_IDLE_HIGH			0x04	//Manchester and differential: line idles high
+
+#define FAGPIO_LC_NO_PIN			0xFF
+#define FAGPIO_LC_TOLERANCE			4		//Intervals may be off by half/4
+#define FAGPIO_DALI_HALF_NS			416667
+
+struct fagpio_linecode {
+	uint8_t code;
+	uint8_t flags;
+	uint8_t idle;			//Line level between frames
+	uint8_t stop_halves;
+	uint8_t tx_port, rx_port;
+	uint32_t tx_mask, rx_mask;
+	uint32_t half_ns;
+	uint32_t half;			//Ticks per half bit
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// tx or rx may be FAGPIO_LC_NO_PIN; half_ns is half a bit period
+int fagpio_linecode_init(struct fagpio_linecode *lc, uint8_t code, uint8_t tx, uint8_t rx, uint32_t half_ns, unsigned int flags);
+int fagpio_dali_init(struct fagpio_linecode *lc, uint8_t tx, uint8_t rx, unsigned int flags);
+
+// Appends bits of data, MSB first, starting delta ticks after the last op of seq
+int fagpio_linecode_encode(const struct fagpio_linecode *lc, struct fagpio_seq *seq, const uint8_t *data, unsigned int bits, uint32_t delta);
+
+/*
+ * Decodes the first frame in edges (edges[0] the initial state, as
+ * fagpio_capture_edges() fills it) into out, MSB first. Returns the
+ * number of data bits, -1 on a coding violation or a truncated frame.
+ */
+int fagpio_linecode_decode(const struct fagpio_linecode *lc, const struct fagpio_sample *edges, unsigned int count, uint8_t *out, unsigned int max_bits);
+
+// DALI forward frame (address, then opcode or level) and the 8-bit backward frame
+int fagpio_dali_forward(const struct fagpio_linecode *lc, struct fagpio_seq *seq, uint8_t addr, uint8_t data);
+int fagpio_dali_backward(const struct fagpio_linecode *lc, struct fagpio_seq *seq, uint8_t data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,44 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include "fagpio_log.h"
+
+int fagpio_log_level = FAGPIO_LOG_ERR;
+
+// Straight to fd 2: no stdio stream, so stderr's buffer is never set up
+static void log_stderr(int level, const char *msg) {
+	(void)level;
+	if (write(STDERR_FILENO, msg, strlen(msg)) < 0)
+		return;
+}
+
+static fagpio_log_fn log_handler = log_stderr;
+
+void fagpio_log_set_handler(fagpio_log_fn fn) {
+	log_handler = fn ? fn : log_stderr;
+}
+
+void fagpio_log_set_level(int level) {
+	fagpio_log_level = level;
+}
+
+// Picks up FAGPIO_LOG from the environment, called from fagpio_setup()
+void fagpio_log_init(void) {
+	const char *env = getenv("FAGPIO_LOG");
+
+	if (env)
+		fagpio_log_level = atoi(env);
+}
+
+void fagpio_log_printf(int level, const char *fmt, ...) {
+	char msg[128];
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(msg, sizeof(msg), fmt, ap);
+	va_end(ap);
+
+	log_handler(level, msg);
+}
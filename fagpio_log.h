@@ -0,0 +1,42 @@
+#ifndef _FAGPIO_LOG_H
+#define _FAGPIO_LOG_H
+
+#define FAGPIO_LOG_NONE		0
+#define FAGPIO_LOG_ERR		1
+#define FAGPIO_LOG_INFO		2
+#define FAGPIO_LOG_DEBUG	3
+
+/*
+ * Messages above FAGPIO_LOG_MAX are removed at compile time; build with
+ * -DFAGPIO_LOG_MAX=FAGPIO_LOG_DEBUG to keep the pinMode register dumps.
+ * What is compiled in is then filtered at runtime by the level taken from
+ * the FAGPIO_LOG environment variable (0-3, default FAGPIO_LOG_ERR).
+ */
+#ifndef FAGPIO_LOG_MAX
+#define FAGPIO_LOG_MAX		FAGPIO_LOG_ERR
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*fagpio_log_fn)(int level, const char *msg);
+
+void fagpio_log_set_handler(fagpio_log_fn fn);	//NULL restores the stderr handler
+void fagpio_log_set_level(int level);
+
+extern int fagpio_log_level;
+void fagpio_log_init(void);
+void fagpio_log_printf(int level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+#define FAGPIO_LOG(level, ...)												\
+	do {																	\
+		if ((level) <= FAGPIO_LOG_MAX && (level) <= fagpio_log_level)		\
+			fagpio_log_printf((level), __VA_ARGS__);						\
+	} while (0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,112 @@
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include "fagpio_loop.h"
+
+#define HEADER_TAIL		74		//Longest header line after the name: the text and four 10-digit numbers
+
+struct fagpio_loop_hist fagpio_loop;
+
+static struct {
+	struct fagpio_loop_hist *hist;
+	const char *name;
+} registry[FAGPIO_LOOP_MAX] = {
+	{ &fagpio_loop, "loop" },
+};
+
+void fagpio_loop_reset(struct fagpio_loop_hist *h) {
+	memset(h, 0, sizeof(*h));
+}
+
+int fagpio_loop_register(struct fagpio_loop_hist *h, const char *name) {
+	for (int i = 0; i < FAGPIO_LOOP_MAX; i++) {
+		if (!registry[i].hist) {
+			registry[i].name = name;
+			registry[i].hist = h;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+// printf is not async-signal-safe, so the dump formats decimals by hand
+static char *put_str(char *p, const char *s) {
+	while (*s)
+		*p++ = *s++;
+	return p;
+}
+
+// At most n bytes of s, for strings the caller chose
+static char *put_strn(char *p, const char *s, size_t n) {
+	while (n-- && *s)
+		*p++ = *s++;
+	return p;
+}
+
+static char *put_u32(char *p, uint32_t v) {
+	char tmp[10];
+	int n = 0;
+
+	do {
+		tmp[n++] = '0' + v % 10;
+		v /= 10;
+	} while (v);
+	while (n)
+		*p++ = tmp[--n];
+	return p;
+}
+
+/*
+One header line per histogram, then one line per non-empty bin:
+	loop: periods 1000 min 23990 max 24410 ticks at 24000000 Hz
+	  2^14 1000
+*/
+void fagpio_loop_dump(int fd) {
+	char line[128], *p;
+
+	for (int i = 0; i < FAGPIO_LOOP_MAX; i++) {
+		const struct fagpio_loop_hist *h = registry[i].hist;
+
+		if (!h)
+			continue;
+		p = put_strn(line, registry[i].name, sizeof(line) - HEADER_TAIL);
+		p = put_str(p, ": periods ");
+		p = put_u32(p, h->count);
+		p = put_str(p, " min ");
+		p = put_u32(p, h->min);
+		p = put_str(p, " max ");
+		p = put_u32(p, h->max);
+		p = put_str(p, " ticks at ");
+		p = put_u32(p, fagpio_tick_hz);
+		p = put_str(p, " Hz\n");
+		if (write(fd, line, p - line) < 0)
+			return;
+
+		for (int b = 0; b < FAGPIO_LOOP_BINS; b++) {
+			if (!h->bins[b])
+				continue;
+			p = put_str(line, "  2^");
+			p = put_u32(p, b);
+			p = put_str(p, " ");
+			p = put_u32(p, h->bins[b]);
+			p = put_str(p, "\n");
+			if (write(fd, line, p - line) < 0)
+				return;
+		}
+	}
+}
+
+static void dump_handler(int signo) {
+	(void)signo;
+	fagpio_loop_dump(STDERR_FILENO);
+}
+
+int fagpio_loop_dump_on_signal(int signo) {
+	struct sigaction sa;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = dump_handler;
+	sa.sa_flags = SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+	return sigaction(signo, &sa, NULL);
+}
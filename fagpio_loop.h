@@ -0,0 +1,63 @@
+#ifndef _FAGPIO_LOOP_H
+#define _FAGPIO_LOOP_H
+
+#include <stdint.h>
+#include "fagpio_timer.h"
+
+/*
+ * Loop-period histogram. Call fagpio_loop_tick() once per iteration of a
+ * control loop: the AVS counter delta since the previous call goes into
+ * bin floor(log2(delta)), so bin k counts periods of [2^k, 2^(k+1)) ticks.
+ * Cost is a counter read, a CLZ and a few stores; nothing is allocated.
+ * fagpio_loop_dump_on_signal(SIGUSR1) dumps every registered histogram to
+ * stderr when the signal arrives.
+ */
+
+#define FAGPIO_LOOP_BINS	32
+#define FAGPIO_LOOP_MAX		8		//Histograms that can be registered for dumping
+
+struct fagpio_loop_hist {
+	uint32_t last;			//Counter at the previous tick
+	uint32_t started;		//Set by the first tick, which only starts a period
+	uint32_t count;			//Periods recorded
+	uint32_t min;
+	uint32_t max;
+	uint32_t bins[FAGPIO_LOOP_BINS];
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern struct fagpio_loop_hist fagpio_loop;		//Used by fagpio_loop_tick(), registered as "loop"
+
+static inline void fagpio_loop_tick_hist(struct fagpio_loop_hist *h) {
+	uint32_t now = fagpio_ticks();
+	uint32_t delta = now - h->last;
+
+	h->last = now;
+	if (!h->started) {
+		h->started = 1;
+		return;
+	}
+	h->bins[31 - __builtin_clz(delta | 1)]++;
+	if (!h->count++ || delta < h->min)
+		h->min = delta;
+	if (delta > h->max)
+		h->max = delta;
+}
+
+static inline void fagpio_loop_tick(void) {
+	fagpio_loop_tick_hist(&fagpio_loop);
+}
+
+void fagpio_loop_reset(struct fagpio_loop_hist *h);
+int fagpio_loop_register(struct fagpio_loop_hist *h, const char *name);
+void fagpio_loop_dump(int fd);					//Async-signal-safe
+int fagpio_loop_dump_on_signal(int signo);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
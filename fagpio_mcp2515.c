@@ -0,0 +1,256 @@
+#include <string.h>
+#include "fagpio_priv.h"
+#include "fagpio_mcp2515.h"
+#include "fagpio_eint.h"
+#include "fagpio_spi.h"
+#include "fagpio_timer.h"
+#include "fagpio_log.h"
+
+#define MCP_RESET			0xC0
+#define MCP_READ			0x03
+#define MCP_WRITE			0x02
+#define MCP_READ_RX(n)		(0x90 | ((n) << 2))		//From RXBnSIDH
+#define MCP_LOAD_TX(n)		(0x40 | ((n) << 1))		//From TXBnSIDH
+#define MCP_RTS(n)			(0x80 | (1u << (n)))
+#define MCP_READ_STATUS		0xA0
+
+#define MCP_CANSTAT			0x0E
+#define MCP_CANCTRL			0x0F
+#define MCP_CNF3			0x28
+#define MCP_CNF2			0x29
+#define MCP_CNF1			0x2A
+#define MCP_CANINTE			0x2B
+#define MCP_CANINTF			0x2C
+#define MCP_RXB0CTRL		0x60
+#define MCP_RXB1CTRL		0x70
+
+#define MCP_MODE_MASK		0xE0
+#define MCP_MODE_NORMAL		0x00
+#define MCP_MODE_CONFIG		0x80
+#define MCP_RXM_ANY			0x60		//RXBnCTRL: filters off
+#define MCP_BUKT			0x04		//RXB0CTRL: roll over into RXB1
+#define MCP_RXIE			0x03		//RX0IE, RX1IE
+
+// READ STATUS bits
+#define MCP_ST_RX0IF		0x01
+#define MCP_ST_RX1IF		0x02
+#define MCP_ST_TXREQ(n)		(0x04 << (2 * (n)))
+
+#define MCP_FRAME_BYTES		13			//SIDH, SIDL, EID8, EID0, DLC, 8 data
+#define MCP_RESET_NS		20000		//Oscillator start-up after RESET
+
+static int mcp_xfer(struct fagpio_mcp2515 *c, const uint8_t *tx, uint8_t *rx, size_t len) {
+	if (c->bus != FAGPIO_MCP2515_BB)
+		return fagpio_spi_transfer(c->bus, tx, rx, len);		//The controller frames it with SS
+	fagpio_digital_write(fagpio_default(), c->cs, LOW);
+	fagpio_bbspi_transfer(&c->bb, tx, rx, len);
+	fagpio_digital_write(fagpio_default(), c->cs, HIGH);
+	return 0;
+}
+
+static int mcp_write(struct fagpio_mcp2515 *c, uint8_t reg, uint8_t value) {
+	uint8_t tx[3] = { MCP_WRITE, reg, value };
+
+	return mcp_xfer(c, tx, NULL, sizeof(tx));
+}
+
+static int mcp_read(struct fagpio_mcp2515 *c, uint8_t reg) {
+	uint8_t tx[3] = { MCP_READ, reg, 0 }, rx[3];
+
+	if (mcp_xfer(c, tx, rx, sizeof(tx)) < 0)
+		return -1;
+	return rx[2];
+}
+
+int fagpio_mcp2515_open(struct fagpio_mcp2515 *c, uint8_t bus, uint32_t spi_hz) {
+	memset(c, 0, sizeof(*c));
+	c->bus = bus;
+	c->fd = -1;
+	if (bus > 1)
+		return -1;
+	return fagpio_spi_open(bus, spi_hz, 0);
+}
+
+int fagpio_mcp2515_open_bb(struct fagpio_mcp2515 *c, uint8_t sck, uint8_t mosi, uint8_t miso, uint8_t cs, uint32_t spi_hz) {
+	memset(c, 0, sizeof(*c));
+	c->bus = FAGPIO_MCP2515_BB;
+	c->cs = cs;
+	c->fd = -1;
+	if (PIO_PIN_PORT(cs) >= PIO_NPORTS || fagpio_bbspi_init(&c->bb, sck, mosi, miso, 0, spi_hz) < 0)
+		return -1;
+	fagpio_digital_write(fagpio_default(), cs, HIGH);
+	pinMode(cs, OUTPUT);
+	return 0;
+}
+
+/*
+A bit is 1 sync quantum, PropSeg, PS1 and PS2. The longest bit of 8 to 25
+quanta that the baud rate prescaler (1-64) divides exactly is taken, with
+the sample point near 75%: PS2 a quarter of the bit, PS1 up to 8 quanta
+and PropSeg the rest.
+*/
+static int bit_timing(uint32_t osc_hz, uint32_t bitrate, uint8_t cnf[3]) {
+	for (unsigned int tq = 25; tq >= 8; tq--) {
+		uint32_t div = 2 * tq * bitrate;
+		unsigned int brp, ps2, ps1, prop;
+
+		if (!div || osc_hz % div || (brp = osc_hz / div) < 1 || brp > 64)
+			continue;
+		ps2 = (tq + 2) / 4;
+		if (ps2 < 2)
+			ps2 = 2;
+		ps1 = (tq - 1 - ps2 + 1) / 2;
+		if (ps1 > 8)
+			ps1 = 8;
+		prop = tq - 1 - ps2 - ps1;
+		if (prop < 1 || prop > 8 || prop + ps1 < ps2)
+			continue;
+		cnf[0] = brp - 1;						//CNF1: SJW of 1 quantum
+		cnf[1] = 0x80 | ((ps1 - 1) << 3) | (prop - 1);		//CNF2: BTLMODE, PS2 from CNF3
+		cnf[2] = ps2 - 1;
+		return 0;
+	}
+	return -1;
+}
+
+int fagpio_mcp2515_begin(struct fagpio_mcp2515 *c, uint32_t osc_hz, uint32_t bitrate, uint8_t int_pin, struct fagpio_can_ring *ring) {
+	uint8_t reset = MCP_RESET, cnf[3];
+
+	if (!ring || bit_timing(osc_hz, bitrate, cnf) < 0)
+		return -1;
+	c->ring = ring;
+	fagpio_can_ring_init(ring);
+
+	mcp_xfer(c, &reset, NULL, 1);
+	fagpio_delay_ns(MCP_RESET_NS);
+	if ((mcp_read(c, MCP_CANSTAT) & MCP_MODE_MASK) != MCP_MODE_CONFIG) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "MCP2515: no answer after reset\n");
+		return -1;
+	}
+
+	uint8_t timing[5] = { MCP_WRITE, MCP_CNF3, cnf[2], cnf[1], cnf[0] };	//CNF3, CNF2, CNF1 are consecutive
+
+	mcp_xfer(c, timing, NULL, sizeof(timing));
+	mcp_write(c, MCP_RXB0CTRL, MCP_RXM_ANY | MCP_BUKT);
+	mcp_write(c, MCP_RXB1CTRL, MCP_RXM_ANY);
+	mcp_write(c, MCP_CANINTF, 0);
+	mcp_write(c, MCP_CANINTE, MCP_RXIE);
+	mcp_write(c, MCP_CANCTRL, MCP_MODE_NORMAL);
+	if ((mcp_read(c, MCP_CANSTAT) & MCP_MODE_MASK) != MCP_MODE_NORMAL) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "MCP2515: cannot enter normal mode\n");
+		return -1;
+	}
+
+	c->int_pin = int_pin;
+	c->fd = -1;
+	if (int_pin != FAGPIO_BBSPI_NO_PIN) {
+		pinPull(int_pin, PULL_UP);
+		if ((c->fd = attachInterrupt(int_pin, FALLING)) < 0)
+			FAGPIO_LOG(FAGPIO_LOG_ERR, "MCP2515: no EINT on the INT pin, polling only\n");
+	}
+	FAGPIO_LOG(FAGPIO_LOG_INFO, "MCP2515 at %u bit/s, CNF %02x %02x %02x\n", bitrate, cnf[0], cnf[1], cnf[2]);
+	return 0;
+}
+
+static void encode(const struct fagpio_can_frame *f, uint8_t *b) {
+	uint32_t id = f->id;
+
+	if (f->flags & FAGPIO_CAN_EXT) {
+		b[0] = id >> 21;
+		b[1] = ((id >> 13) & 0xE0) | 0x08 | ((id >> 16) & 3);		//EXIDE
+		b[2] = id >> 8;
+		b[3] = id;
+	} else {
+		b[0] = id >> 3;
+		b[1] = (id & 7) << 5;
+		b[2] = b[3] = 0;
+	}
+	b[4] = (f->dlc > 8 ? 8 : f->dlc) | ((f->flags & FAGPIO_CAN_RTR) ? 0x40 : 0);
+	memcpy(b + 5, f->data, 8);
+}
+
+static void decode(const uint8_t *b, struct fagpio_can_frame *f) {
+	if (b[1] & 0x08) {
+		f->id = ((uint32_t)b[0] << 21) | ((uint32_t)(b[1] & 0xE0) << 13) | ((uint32_t)(b[1] & 3) << 16) | (b[2] << 8) | b[3];
+		f->flags = FAGPIO_CAN_EXT | ((b[4] & 0x40) ? FAGPIO_CAN_RTR : 0);
+	} else {
+		f->id = (b[0] << 3) | (b[1] >> 5);
+		f->flags = (b[1] & 0x10) ? FAGPIO_CAN_RTR : 0;		//SRR
+	}
+	f->dlc = b[4] & 0x0F;
+	if (f->dlc > 8)
+		f->dlc = 8;
+	memcpy(f->data, b + 5, 8);
+}
+
+static int read_status(struct fagpio_mcp2515 *c) {
+	uint8_t tx[2] = { MCP_READ_STATUS, 0 }, rx[2];
+
+	if (mcp_xfer(c, tx, rx, sizeof(tx)) < 0)
+		return -1;
+	return rx[1];
+}
+
+int fagpio_mcp2515_send(struct fagpio_mcp2515 *c, const struct fagpio_can_frame *f) {
+	uint8_t tx[1 + MCP_FRAME_BYTES], rts;
+	int status = read_status(c);
+
+	if (status < 0)
+		return -1;
+	for (unsigned int n = 0; n < 3; n++) {
+		if (status & MCP_ST_TXREQ(n))
+			continue;
+		tx[0] = MCP_LOAD_TX(n);
+		encode(f, tx + 1);
+		rts = MCP_RTS(n);
+		if (mcp_xfer(c, tx, NULL, sizeof(tx)) < 0 || mcp_xfer(c, &rts, NULL, 1) < 0)
+			return -1;
+		return n;
+	}
+	return -1;
+}
+
+// One READ STATUS, then one READ RX BUFFER per full buffer; each clears its flag
+int fagpio_mcp2515_poll(struct fagpio_mcp2515 *c) {
+	struct fagpio_can_ring *r = c->ring;
+	int status = read_status(c), got = 0;
+
+	if (status < 0)
+		return -1;
+	for (unsigned int n = 0; n < 2; n++) {
+		uint8_t tx[1 + MCP_FRAME_BYTES] = { MCP_READ_RX(n) }, rx[1 + MCP_FRAME_BYTES];
+
+		if (!(status & (n ? MCP_ST_RX1IF : MCP_ST_RX0IF)))
+			continue;
+		if (mcp_xfer(c, tx, rx, sizeof(tx)) < 0)
+			return -1;
+		if (r->head - r->tail == FAGPIO_CAN_RING_SIZE) {
+			r->dropped++;
+			continue;
+		}
+
+		struct fagpio_can_frame *f = &r->frame[r->head & (FAGPIO_CAN_RING_SIZE - 1)];
+
+		f->ticks = fagpio_ticks();
+		decode(rx + 1, f);
+		fagpio_barrier();
+		r->head++;
+		got++;
+	}
+	return got;
+}
+
+/*
+INT stays low while a receive flag is set, so the buffers are emptied
+before sleeping: an edge that came before the EINT was re-armed is not
+lost.
+*/
+int fagpio_mcp2515_wait(struct fagpio_mcp2515 *c, int timeout_ms) {
+	int got = fagpio_mcp2515_poll(c);
+
+	if (got || c->fd < 0)
+		return got;
+	if (!fagpio_eint_wait(PIO_PIN_PORT(c->int_pin), timeout_ms))
+		return 0;
+	return fagpio_mcp2515_poll(c);
+}
@@ -0,0 +1,94 @@
+#ifndef _FAGPIO_MCP2515_H
+#define _FAGPIO_MCP2515_H
+
+#include <stdint.h>
+#include "fagpio_ring.h"
+#include "fagpio_bbspi.h"
+
+/*
+ * MCP2515 CAN controller on hardware SPI (fagpio_spi.h, one burst per
+ * chip select) or bit-banged SPI with a chip select pin. A frame is one
+ * burst each way: READ RX BUFFER returns the 13 bytes of id, DLC and
+ * data and clears the buffer's interrupt flag when chip select rises,
+ * and LOAD TX BUFFER writes them, followed by a one-byte RTS. Polling for
+ * frames is one READ STATUS burst.
+ *
+ * The INT pin, active low, goes to an EINT pin (fagpio_eint.h):
+ * fagpio_mcp2515_wait() sleeps on its fd and moves every received frame
+ * into an SPSC ring laid out like fagpio_ring.h, for a consumer thread.
+ * Both receive buffers are used, rolling over from 0 to 1.
+ */
+
+#define FAGPIO_CAN_EXT			(1u << 0)	//29-bit id
+#define FAGPIO_CAN_RTR			(1u << 1)	//Remote request, no data
+#define FAGPIO_CAN_RING_SIZE	64			//Power of two
+
+struct fagpio_can_frame {
+	uint32_t ticks;			//fagpio_ticks() when read from the controller
+	uint32_t id;
+	uint8_t flags;			//FAGPIO_CAN_*
+	uint8_t dlc;			//Data bytes, 0-8
+	uint8_t pad[2];
+	uint8_t data[8];
+};
+
+struct fagpio_can_ring {
+	volatile uint32_t head __attribute__((aligned(FAGPIO_CACHE_LINE)));	//Producer side
+	uint32_t dropped;
+	volatile uint32_t tail __attribute__((aligned(FAGPIO_CACHE_LINE)));	//Consumer side
+	struct fagpio_can_frame frame[FAGPIO_CAN_RING_SIZE] __attribute__((aligned(FAGPIO_CACHE_LINE)));
+};
+
+struct fagpio_mcp2515 {
+	uint8_t bus;			//0, 1 or FAGPIO_MCP2515_BB
+	uint8_t cs;				//Chip select of FAGPIO_MCP2515_BB
+	uint8_t int_pin;
+	int fd;					//EINT fd of int_pin, -1 without
+	struct fagpio_bbspi bb;
+	struct fagpio_can_ring *ring;
+};
+
+#define FAGPIO_MCP2515_BB		0xFF
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fagpio_mcp2515_open(struct fagpio_mcp2515 *c, uint8_t bus, uint32_t spi_hz);		//SPI0/1, up to 10 MHz
+int fagpio_mcp2515_open_bb(struct fagpio_mcp2515 *c, uint8_t sck, uint8_t mosi, uint8_t miso, uint8_t cs, uint32_t spi_hz);
+
+/*
+ * Resets the controller, sets the bit timing for bitrate from its crystal
+ * (osc_hz, usually 8 or 16 MHz) and enters normal mode with every
+ * message accepted. int_pin may be FAGPIO_BBSPI_NO_PIN for polling only.
+ */
+int fagpio_mcp2515_begin(struct fagpio_mcp2515 *c, uint32_t osc_hz, uint32_t bitrate, uint8_t int_pin, struct fagpio_can_ring *ring);
+
+int fagpio_mcp2515_send(struct fagpio_mcp2515 *c, const struct fagpio_can_frame *f);	//TX buffer used, -1 if all busy
+int fagpio_mcp2515_poll(struct fagpio_mcp2515 *c);					//Frames moved into the ring
+int fagpio_mcp2515_wait(struct fagpio_mcp2515 *c, int timeout_ms);	//Same after waiting for INT
+
+static inline void fagpio_can_ring_init(struct fagpio_can_ring *r) {
+	r->head = r->tail = r->dropped = 0;
+}
+
+// Consumer only; copies up to max frames into out and returns how many
+static inline unsigned int fagpio_can_ring_pop(struct fagpio_can_ring *r, struct fagpio_can_frame *out, unsigned int max) {
+	uint32_t tail = r->tail;
+	uint32_t n = r->head - tail;
+
+	if (n > max)
+		n = max;
+	fagpio_barrier();
+	for (uint32_t i = 0; i < n; i++)
+		out[i] = r->frame[(tail + i) & (FAGPIO_CAN_RING_SIZE - 1)];
+	fagpio_barrier();
+	r->tail = tail + n;
+	return n;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
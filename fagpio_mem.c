@@ -0,0 +1,261 @@
+#define _GNU_SOURCE		//dl_iterate_phdr() of <link.h>
+#include <errno.h>
+#include <link.h>
+#include <pthread.h>
+#include "fagpio_priv.h"
+#include "fagpio_mem.h"
+#include "fagpio_log.h"
+
+/*
+Pool blocks are laid end to end, each headed by its size and whether it
+is taken. Every allocation, pool or malloc, carries a mem_hdr right
+below the pointer handed out, so fagpio_mem_free() finds the start of
+the block behind any alignment and the bytes to take off the counts.
+*/
+struct pool_blk {
+	size_t size;				//Header included, a multiple of POOL_UNIT
+	size_t used;
+};
+
+struct mem_hdr {
+	void *raw;
+	size_t size;
+};
+
+#define POOL_UNIT		sizeof(struct pool_blk)
+#define ALIGN_UP(x, a)	(((x) + (a) - 1) & ~((uintptr_t)(a) - 1))
+
+static pthread_mutex_t mem_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned char *pool_base, *pool_end;
+static size_t pool_used, pool_peak, heap_used;
+
+int fagpio_lowmem(void) {
+	static int mode = -1;
+
+	if (mode < 0) {
+		const char *env = getenv("FAGPIO_LOWMEM");
+
+		mode = env && *env ? atoi(env) != 0 : FAGPIO_LOWMEM;
+	}
+	return mode;
+}
+
+int fagpio_mem_pool(void *buf, size_t size) {
+	int ret = 0;
+
+	pthread_mutex_lock(&mem_lock);
+	if (pool_used) {
+		ret = -1;
+	} else if (!buf) {
+		pool_base = pool_end = NULL;
+	} else {
+		unsigned char *base = (unsigned char *)ALIGN_UP((uintptr_t)buf, POOL_UNIT);
+		unsigned char *end = (unsigned char *)((uintptr_t)((unsigned char *)buf + size) & ~((uintptr_t)POOL_UNIT - 1));
+
+		if (end <= base || (size_t)(end - base) < 4 * POOL_UNIT) {
+			ret = -1;
+		} else {
+			pool_base = base;
+			pool_end = end;
+			*(struct pool_blk *)base = (struct pool_blk){ end - base, 0 };
+			pool_peak = 0;
+		}
+	}
+	pthread_mutex_unlock(&mem_lock);
+	return ret;
+}
+
+// First fit, merging each free block with the free ones after it on the way
+static void *pool_take(size_t need) {
+	size_t n = ALIGN_UP(need + sizeof(struct pool_blk), POOL_UNIT);
+
+	for (unsigned char *p = pool_base; p < pool_end; p += ((struct pool_blk *)p)->size) {
+		struct pool_blk *b = (struct pool_blk *)p;
+
+		if (b->used)
+			continue;
+		while (p + b->size < pool_end && !((struct pool_blk *)(p + b->size))->used)
+			b->size += ((struct pool_blk *)(p + b->size))->size;
+		if (b->size < n)
+			continue;
+		if (b->size - n >= 2 * POOL_UNIT) {
+			*(struct pool_blk *)(p + n) = (struct pool_blk){ b->size - n, 0 };
+			b->size = n;
+		}
+		b->used = 1;
+		pool_used += b->size;
+		if (pool_used > pool_peak)
+			pool_peak = pool_used;
+		return b + 1;
+	}
+	return NULL;
+}
+
+void *fagpio_mem_alloc(size_t size, size_t align) {
+	if (align < FAGPIO_MEM_ALIGN)
+		align = FAGPIO_MEM_ALIGN;
+
+	size_t need = sizeof(struct mem_hdr) + size + align;
+	void *raw;
+
+	pthread_mutex_lock(&mem_lock);
+	if (pool_base) {
+		raw = pool_take(need);
+	} else if ((raw = malloc(need))) {
+		heap_used += need;
+	}
+	pthread_mutex_unlock(&mem_lock);
+	if (!raw)
+		return NULL;
+
+	memset(raw, 0, need);
+
+	unsigned char *p = (unsigned char *)ALIGN_UP((uintptr_t)raw + sizeof(struct mem_hdr), align);
+
+	*((struct mem_hdr *)p - 1) = (struct mem_hdr){ raw, need };
+	return p;
+}
+
+// A block from malloc is still freed there after a pool came in
+void fagpio_mem_free(void *p) {
+	if (!p)
+		return;
+
+	struct mem_hdr *h = (struct mem_hdr *)p - 1;
+	unsigned char *raw = h->raw;
+
+	pthread_mutex_lock(&mem_lock);
+	if (raw >= pool_base && raw < pool_end) {
+		struct pool_blk *b = (struct pool_blk *)raw - 1;
+
+		b->used = 0;
+		pool_used -= b->size;
+	} else {
+		heap_used -= h->size;
+		free(raw);
+	}
+	pthread_mutex_unlock(&mem_lock);
+}
+
+int fagpio_mem_lock(void *buf, size_t size) {
+	unsigned long page = sysconf(_SC_PAGESIZE);
+	int ret = mlock(buf, size) < 0 ? -1 : 0;
+
+	if (ret < 0)
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "mlock: %s\n", strerror(errno));
+	for (size_t off = 0; off < size; off += page) {
+		volatile unsigned char *p = (unsigned char *)buf + off;
+
+		*p = *p;		//A write, so copy-on-write and zero pages get their own frame now
+	}
+	return ret;
+}
+
+void fagpio_arena_init(struct fagpio_arena *a, void *buf, size_t size) {
+	a->base = a->top = buf;
+	a->end = a->base + size;
+	a->peak = 0;
+	a->failed = 0;
+}
+
+void *fagpio_arena_alloc(struct fagpio_arena *a, size_t size, size_t align) {
+	if (align < FAGPIO_MEM_ALIGN)
+		align = FAGPIO_MEM_ALIGN;
+
+	unsigned char *p = (unsigned char *)ALIGN_UP((uintptr_t)a->top, align);
+
+	if (p > a->end || size > (size_t)(a->end - p)) {
+		a->failed++;
+		return NULL;
+	}
+	a->top = p + size;
+	if ((size_t)(a->top - a->base) > a->peak)
+		a->peak = a->top - a->base;
+	memset(p, 0, size);
+	return p;
+}
+
+void fagpio_arena_reset(struct fagpio_arena *a) {
+	a->top = a->base;
+}
+
+size_t fagpio_arena_mark(const struct fagpio_arena *a) {
+	return a->top - a->base;
+}
+
+void fagpio_arena_release(struct fagpio_arena *a, size_t mark) {
+	if (mark <= (size_t)(a->top - a->base))
+		a->top = a->base + mark;
+}
+
+int fagpio_arena_lock(struct fagpio_arena *a) {
+	return fagpio_mem_lock(a->base, a->end - a->base);
+}
+
+void *fagpio_mem_take(struct fagpio_arena *a, size_t size, size_t align) {
+	return a ? fagpio_arena_alloc(a, size, align) : fagpio_mem_alloc(size, align);
+}
+
+void fagpio_mem_give(struct fagpio_arena *a, void *p) {
+	if (!a)
+		fagpio_mem_free(p);
+}
+
+struct seg_find {
+	uintptr_t addr;
+	unsigned long data, bss;
+};
+
+// The object holding addr (libfagpio.so, or the program it was linked into)
+static int seg_sum(struct dl_phdr_info *info, size_t size, void *arg) {
+	struct seg_find *s = arg;
+	int mine = 0;
+
+	(void)size;
+	for (int i = 0; i < info->dlpi_phnum; i++) {
+		const ElfW(Phdr) *ph = &info->dlpi_phdr[i];
+		uintptr_t start = info->dlpi_addr + ph->p_vaddr;
+
+		if (ph->p_type == PT_LOAD && s->addr >= start && s->addr < start + ph->p_memsz)
+			mine = 1;
+	}
+	if (!mine)
+		return 0;
+	for (int i = 0; i < info->dlpi_phnum; i++) {
+		const ElfW(Phdr) *ph = &info->dlpi_phdr[i];
+
+		if (ph->p_type == PT_LOAD && (ph->p_flags & PF_W)) {
+			s->data += ph->p_filesz;
+			s->bss += ph->p_memsz - ph->p_filesz;
+		}
+	}
+	return 1;
+}
+
+int fagpio_footprint(struct fagpio_footprint *f) {
+	struct seg_find s = { (uintptr_t)&fagpio_footprint, 0, 0 };
+
+	memset(f, 0, sizeof(*f));
+	if (dl_iterate_phdr(seg_sum, &s) <= 0)
+		return -1;
+	f->data = s.data;
+	f->bss = s.bss;
+	f->mapped = (gpio.addr ? gpio.size : 0) + fagpio_region_mapped();
+
+	pthread_mutex_lock(&mem_lock);
+	f->pool_size = pool_end - pool_base;
+	f->pool_used = pool_used;
+	f->pool_peak = pool_peak;
+	f->heap = heap_used;
+	pthread_mutex_unlock(&mem_lock);
+	return 0;
+}
+
+void fagpio_footprint_dump(int fd) {
+	struct fagpio_footprint f;
+
+	if (fagpio_footprint(&f) < 0)
+		return;
+	dprintf(fd, "%s mode: mapped %lu, data %lu, bss %lu, pool %zu used %zu peak %zu, heap %zu bytes\n",
+		fagpio_lowmem() ? "low-memory" : "default", f.mapped, f.data, f.bss, f.pool_size, f.pool_used, f.pool_peak, f.heap);
+}
@@ -0,0 +1,96 @@
+#ifndef _FAGPIO_MEM_H
+#define _FAGPIO_MEM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Low-RSS operation for boards that run in the 32 MB of the F1C100s
+ * without swap. In low-memory mode (built with -DFAGPIO_LOWMEM=1, make
+ * lowmem, or FAGPIO_LOWMEM=1 in the environment) fagpio_setup() maps only
+ * the page holding the PIO block instead of the whole window, and the
+ * other register blocks are mapped a page at a time by fagpio_region()
+ * when a driver first touches them. The UIO backend still maps all of
+ * map0: a UIO mapping cannot start inside its map, so the blocks past the
+ * PIO page would be out of reach otherwise.
+ *
+ * Every buffer the library allocates for itself (handles, engines, the
+ * trace ring and replay chunk, the logic analyser pools, audio PCM) goes
+ * through fagpio_mem_alloc(): from the caller's pool once fagpio_mem_pool()
+ * was given one, from malloc otherwise. The pool is first fit with its
+ * free blocks merged as they are walked, so engines started and stopped
+ * in a loop do not creep, and it never falls back to malloc. The library
+ * itself uses no stdio streams: logs go to fd 2 with write(), and files
+ * are read and written through fds.
+ *
+ * An arena (struct fagpio_arena) is a bump allocator over caller storage
+ * for one engine: the engines that allocate take one in their _arena
+ * initializer (or the arena field of fagpio_engine_config), and then
+ * allocate nothing else. Put it in memory locked and prefaulted with
+ * fagpio_arena_lock() and the real-time path neither allocates nor
+ * faults. Buffers an engine needs only while it runs (the replay chunk,
+ * the logic analyser rings) are released to the mark they were taken at
+ * when it returns, and the rest stay until the caller resets the arena.
+ * An arena is not locked against threads: give each engine its own, or
+ * one to engines started in turn from one thread.
+ *
+ * fagpio_footprint() reports what the library holds: the bytes mapped,
+ * the writable segments of the library object, the pool and what came
+ * from malloc. make footprint checks the segments of libfagpio.so against
+ * fagpio.footprint.
+ */
+
+#ifndef FAGPIO_LOWMEM
+#define FAGPIO_LOWMEM		0		//Default mode, FAGPIO_LOWMEM overrides at runtime
+#endif
+
+#define FAGPIO_MEM_ALIGN	8		//Smallest alignment of fagpio_mem_alloc()
+
+struct fagpio_footprint {
+	unsigned long mapped;		//Register bytes: the window and separately mapped regions
+	unsigned long data, bss;	//Writable segments of the library
+	size_t pool_size;			//0 without a pool
+	size_t pool_used, pool_peak;
+	size_t heap;				//Bytes now held from malloc
+};
+
+struct fagpio_arena {
+	unsigned char *base, *top, *end;
+	size_t peak;				//Most bytes taken at once
+	uint32_t failed;			//Allocations it could not hold
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fagpio_lowmem(void);		//1 in low-memory mode
+
+// Before the first allocation; NULL, 0 goes back to malloc. -1 while blocks are out
+int fagpio_mem_pool(void *buf, size_t size);
+
+void *fagpio_mem_alloc(size_t size, size_t align);	//Zeroed, NULL when out of memory
+void fagpio_mem_free(void *p);						//NULL is ignored
+
+// mlock()s and touches every page of buf, keeping its contents; -1 if it could not be locked
+int fagpio_mem_lock(void *buf, size_t size);
+
+void fagpio_arena_init(struct fagpio_arena *a, void *buf, size_t size);
+void *fagpio_arena_alloc(struct fagpio_arena *a, size_t size, size_t align);	//Zeroed, NULL when full
+void fagpio_arena_reset(struct fagpio_arena *a);								//Everything taken is free again
+size_t fagpio_arena_mark(const struct fagpio_arena *a);
+void fagpio_arena_release(struct fagpio_arena *a, size_t mark);				//Frees what was taken after the mark
+int fagpio_arena_lock(struct fagpio_arena *a);
+
+static inline size_t fagpio_arena_used(const struct fagpio_arena *a) {
+	return a->top - a->base;
+}
+
+int fagpio_footprint(struct fagpio_footprint *f);
+void fagpio_footprint_dump(int fd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
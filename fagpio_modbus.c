@@ -0,0 +1,273 @@
+#include <string.h>
+#include "fagpio_modbus.h"
+#include "fagpio_crc.h"
+#include "fagpio_uart.h"
+#include "fagpio_timer.h"
+#include "fagpio_log.h"
+
+#define FN_READ_HOLDING		3
+#define FN_READ_INPUT		4
+#define FN_WRITE_SINGLE		6
+#define FN_WRITE_MULTIPLE	16
+#define FN_EXCEPTION		0x80
+
+#define GAP_FIXED_US		1750		//t3.5 above 19200 baud
+#define REQUEST_BYTES		8			//Function 3 request, CRC included
+#define ANSWER_OVERHEAD		5			//Slave, function, count and CRC around the registers
+
+uint16_t fagpio_modbus_crc(const uint8_t *data, size_t len) {
+	return fagpio_crc16_modbus(FAGPIO_CRC16_MODBUS_INIT, data, len);
+}
+
+static inline void put16(uint8_t *p, uint16_t v) {
+	p[0] = v >> 8;
+	p[1] = v;
+}
+
+static inline uint16_t get16(const uint8_t *p) {
+	return (p[0] << 8) | p[1];
+}
+
+int fagpio_modbus_open(struct fagpio_modbus *m, uint8_t uart, uint32_t baud, uint8_t dir_pin, uint8_t lcr) {
+	// Start, 8 data, parity and one or two stop bits
+	unsigned int bits = 10 + ((lcr & 0x08) ? 1 : 0) + ((lcr & 0x04) ? 1 : 0);
+
+	memset(m, 0, sizeof(*m));
+	if (!baud || fagpio_uart_open_format(uart, baud, dir_pin, lcr) < 0)
+		return -1;
+	m->uart = uart;
+	m->char_ticks = (uint64_t)bits * fagpio_tick_hz / baud;
+	m->gap_ticks = baud > 19200 ? (uint64_t)GAP_FIXED_US * fagpio_tick_hz / 1000000 : m->char_ticks * 7 / 2;
+	m->timeout_ticks = (uint64_t)FAGPIO_MODBUS_TIMEOUT_MS * fagpio_tick_hz / 1000;
+	m->last_ticks = fagpio_ticks();
+	return 0;
+}
+
+void fagpio_modbus_close(struct fagpio_modbus *m) {
+	fagpio_uart_close(m->uart);
+}
+
+unsigned int fagpio_modbus_hole(const struct fagpio_modbus *m) {
+	return (REQUEST_BYTES * m->char_ticks + ANSWER_OVERHEAD * m->char_ticks + 2 * m->gap_ticks) / (2 * m->char_ticks);
+}
+
+// Appends the CRC, waits out the silence since the last frame and sends
+static int send_frame(struct fagpio_modbus *m, size_t len) {
+	uint16_t crc = fagpio_modbus_crc(m->frame, len);
+
+	m->frame[len++] = crc;
+	m->frame[len++] = crc >> 8;
+	while (fagpio_ticks() - m->last_ticks < m->gap_ticks)
+		;
+	// Whatever came in meanwhile is not the answer
+	fagpio_uart_read_frame(m->uart, NULL, 0, 0, 0);
+	if (fagpio_uart_write(m->uart, m->frame, len) != (int)len)
+		return FAGPIO_MODBUS_EIO;
+	m->last_ticks = fagpio_ticks();
+	return 0;
+}
+
+// A frame with a good CRC into m->frame; its length without the CRC
+static int recv_frame(struct fagpio_modbus *m, uint32_t first_ticks) {
+	int n = fagpio_uart_read_frame(m->uart, m->frame, sizeof(m->frame), first_ticks, m->gap_ticks);
+
+	m->last_ticks = fagpio_ticks();
+	if (n < 0)
+		return FAGPIO_MODBUS_EIO;
+	if (!n)
+		return FAGPIO_MODBUS_ETIMEOUT;
+	if (n < 4 || n > (int)sizeof(m->frame))
+		return FAGPIO_MODBUS_EFRAME;
+	if (fagpio_modbus_crc(m->frame, n - 2) != (m->frame[n - 2] | (m->frame[n - 1] << 8))) {
+		m->crc_errors++;
+		return FAGPIO_MODBUS_ECRC;
+	}
+	return n - 2;
+}
+
+// Sends the request in m->frame and checks the answer's address and function; its length
+static int transact(struct fagpio_modbus *m, size_t len) {
+	uint8_t slave = m->frame[0], fn = m->frame[1];
+	int n, err;
+
+	m->requests++;
+	if ((err = send_frame(m, len)) < 0)
+		return err;
+	if (slave == FAGPIO_MODBUS_BROADCAST)
+		return 0;
+	if ((n = recv_frame(m, m->timeout_ticks)) == FAGPIO_MODBUS_ETIMEOUT)
+		m->timeouts++;
+	if (n < 0)
+		return n;
+	if (m->frame[0] != slave || (m->frame[1] & ~FN_EXCEPTION) != fn)
+		return FAGPIO_MODBUS_EFRAME;
+	if (m->frame[1] & FN_EXCEPTION)
+		return n >= 3 && m->frame[2] ? m->frame[2] : FAGPIO_MODBUS_EFRAME;
+	return n;
+}
+
+static int read_registers(struct fagpio_modbus *m, uint8_t fn, uint8_t slave, uint16_t addr, uint16_t count, uint16_t *out) {
+	int n;
+
+	if (!count || count > FAGPIO_MODBUS_MAX_READ || slave == FAGPIO_MODBUS_BROADCAST)
+		return FAGPIO_MODBUS_EARG;
+	m->frame[0] = slave;
+	m->frame[1] = fn;
+	put16(&m->frame[2], addr);
+	put16(&m->frame[4], count);
+	if ((n = transact(m, 6)) <= 0 || n < 3)
+		return n;
+	if (m->frame[2] != count * 2 || n != 3 + count * 2)
+		return FAGPIO_MODBUS_EFRAME;
+	for (unsigned int i = 0; i < count; i++)
+		out[i] = get16(&m->frame[3 + 2 * i]);
+	return 0;
+}
+
+int fagpio_modbus_read_holding(struct fagpio_modbus *m, uint8_t slave, uint16_t addr, uint16_t count, uint16_t *out) {
+	return read_registers(m, FN_READ_HOLDING, slave, addr, count, out);
+}
+
+int fagpio_modbus_read_input(struct fagpio_modbus *m, uint8_t slave, uint16_t addr, uint16_t count, uint16_t *out) {
+	return read_registers(m, FN_READ_INPUT, slave, addr, count, out);
+}
+
+int fagpio_modbus_write_single(struct fagpio_modbus *m, uint8_t slave, uint16_t addr, uint16_t value) {
+	int n;
+
+	m->frame[0] = slave;
+	m->frame[1] = FN_WRITE_SINGLE;
+	put16(&m->frame[2], addr);
+	put16(&m->frame[4], value);
+	if ((n = transact(m, 6)) <= 0 || n < 3)
+		return n;
+	return n == 6 && get16(&m->frame[2]) == addr && get16(&m->frame[4]) == value ? 0 : FAGPIO_MODBUS_EFRAME;
+}
+
+int fagpio_modbus_write_multiple(struct fagpio_modbus *m, uint8_t slave, uint16_t addr, uint16_t count, const uint16_t *values) {
+	int n;
+
+	if (!count || count > FAGPIO_MODBUS_MAX_WRITE)
+		return FAGPIO_MODBUS_EARG;
+	m->frame[0] = slave;
+	m->frame[1] = FN_WRITE_MULTIPLE;
+	put16(&m->frame[2], addr);
+	put16(&m->frame[4], count);
+	m->frame[6] = count * 2;
+	for (unsigned int i = 0; i < count; i++)
+		put16(&m->frame[7 + 2 * i], values[i]);
+	if ((n = transact(m, 7 + count * 2)) <= 0 || n < 3)
+		return n;
+	return n == 6 && get16(&m->frame[2]) == addr && get16(&m->frame[4]) == count ? 0 : FAGPIO_MODBUS_EFRAME;
+}
+
+int fagpio_modbus_read_list(struct fagpio_modbus *m, uint8_t slave, const uint16_t *addrs, size_t n, uint16_t *out, unsigned int hole) {
+	uint16_t order[FAGPIO_MODBUS_LIST_MAX], regs[FAGPIO_MODBUS_MAX_READ];
+
+	if (n > FAGPIO_MODBUS_LIST_MAX)
+		return FAGPIO_MODBUS_EARG;
+	// Insertion sort of the indices by address: n is small and often sorted already
+	for (size_t i = 0; i < n; i++) {
+		size_t j = i;
+
+		for (; j && addrs[order[j - 1]] > addrs[i]; j--)
+			order[j] = order[j - 1];
+		order[j] = i;
+	}
+
+	for (size_t i = 0; i < n;) {
+		uint16_t first = addrs[order[i]], last = first;
+		size_t j = i + 1;
+		int err;
+
+		for (; j < n; j++) {
+			uint16_t a = addrs[order[j]];
+
+			if (a - last > hole + 1 || a - first >= FAGPIO_MODBUS_MAX_READ)
+				break;
+			last = a;
+		}
+		if ((err = read_registers(m, FN_READ_HOLDING, slave, first, last - first + 1, regs)))
+			return err;
+		for (; i < j; i++)
+			out[order[i]] = regs[addrs[order[i]] - first];
+	}
+	return 0;
+}
+
+static int exception(struct fagpio_modbus *m, uint8_t code) {
+	m->frame[1] |= FN_EXCEPTION;
+	m->frame[2] = code;
+	return 3;
+}
+
+// Answers the request of length n in m->frame in place; the answer's length
+static int handle(struct fagpio_modbus *m, int n, const struct fagpio_modbus_regs *regs) {
+	uint8_t *f = m->frame;
+	uint16_t addr = get16(&f[2]), count = get16(&f[4]);
+
+	switch (f[1]) {
+	case FN_READ_HOLDING:
+	case FN_READ_INPUT: {
+		const uint16_t *table = f[1] == FN_READ_HOLDING ? regs->holding : regs->input;
+		uint16_t size = f[1] == FN_READ_HOLDING ? regs->holding_count : regs->input_count;
+
+		if (n != 6)
+			return -1;
+		if (!table)
+			return exception(m, FAGPIO_MODBUS_ILLEGAL_FUNCTION);
+		if (!count || count > FAGPIO_MODBUS_MAX_READ)
+			return exception(m, FAGPIO_MODBUS_ILLEGAL_VALUE);
+		if ((uint32_t)addr + count > size)
+			return exception(m, FAGPIO_MODBUS_ILLEGAL_ADDRESS);
+		f[2] = count * 2;
+		for (unsigned int i = 0; i < count; i++)
+			put16(&f[3 + 2 * i], table[addr + i]);
+		return 3 + count * 2;
+	}
+	case FN_WRITE_SINGLE:
+		if (n != 6)
+			return -1;
+		if (!regs->holding)
+			return exception(m, FAGPIO_MODBUS_ILLEGAL_FUNCTION);
+		if (addr >= regs->holding_count)
+			return exception(m, FAGPIO_MODBUS_ILLEGAL_ADDRESS);
+		regs->holding[addr] = count;
+		if (regs->written)
+			regs->written(addr, 1, regs->arg);
+		return 6;		//Echo
+	case FN_WRITE_MULTIPLE:
+		if (n < 7 || n != 7 + f[6])
+			return -1;
+		if (!regs->holding)
+			return exception(m, FAGPIO_MODBUS_ILLEGAL_FUNCTION);
+		if (!count || count > FAGPIO_MODBUS_MAX_WRITE || f[6] != count * 2)
+			return exception(m, FAGPIO_MODBUS_ILLEGAL_VALUE);
+		if ((uint32_t)addr + count > regs->holding_count)
+			return exception(m, FAGPIO_MODBUS_ILLEGAL_ADDRESS);
+		for (unsigned int i = 0; i < count; i++)
+			regs->holding[addr + i] = get16(&f[7 + 2 * i]);
+		if (regs->written)
+			regs->written(addr, count, regs->arg);
+		return 6;		//Address and count
+	}
+	return exception(m, FAGPIO_MODBUS_ILLEGAL_FUNCTION);
+}
+
+int fagpio_modbus_serve(struct fagpio_modbus *m, uint8_t address, const struct fagpio_modbus_regs *regs, int timeout_ms) {
+	uint32_t first = timeout_ms < 0 ? UINT32_MAX : (uint64_t)timeout_ms * fagpio_tick_hz / 1000;
+	int n = recv_frame(m, first), len;
+	uint8_t to = m->frame[0];
+
+	if (n == FAGPIO_MODBUS_ETIMEOUT)
+		return 0;
+	if (n < 0)
+		return n;
+	if (to != address && to != FAGPIO_MODBUS_BROADCAST)
+		return 0;
+	if ((len = handle(m, n, regs)) < 0)
+		return FAGPIO_MODBUS_EFRAME;
+	if (to == FAGPIO_MODBUS_BROADCAST)
+		return 1;
+	return send_frame(m, len) < 0 ? FAGPIO_MODBUS_EIO : 1;
+}
@@ -0,0 +1,95 @@
+#ifndef _FAGPIO_MODBUS_H
+#define _FAGPIO_MODBUS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Modbus RTU master and slave on the polled UART driver (fagpio_uart.h),
+ * for RS-485 with a direction pin. Frame ends are found by the AVS
+ * counter (fagpio_timer.h): a frame is over once 3.5 characters pass
+ * with no byte in the RX FIFO (1.75 ms above 19200 baud, as the spec
+ * says), and a request is only sent after that much silence since the
+ * last frame on the bus. The direction pin is raised before the first
+ * byte and dropped by the loop that sees the transmitter empty, so the
+ * slave's answer is never cut off.
+ *
+ * fagpio_modbus_read_list() reads scattered holding registers with as
+ * few function 3 requests as it can: the addresses are sorted and a run
+ * is extended over a hole of up to hole registers, at most 125 per
+ * request. fagpio_modbus_hole() is the hole worth two bytes per register
+ * less than a new round trip at this baud rate; a slave whose register
+ * map has gaps that it refuses (exception 2) needs hole 0.
+ *
+ * Results are 0 or a negative FAGPIO_MODBUS_E*, a positive value being
+ * the exception code the slave answered with.
+ */
+
+#define FAGPIO_MODBUS_MAX_FRAME		256
+#define FAGPIO_MODBUS_MAX_READ		125		//Registers per function 3 or 4 request
+#define FAGPIO_MODBUS_MAX_WRITE		123		//Registers per function 16 request
+#define FAGPIO_MODBUS_LIST_MAX		256		//Addresses per fagpio_modbus_read_list()
+#ifndef FAGPIO_MODBUS_TIMEOUT_MS
+#define FAGPIO_MODBUS_TIMEOUT_MS	100		//Master: first byte of the answer
+#endif
+#define FAGPIO_MODBUS_BROADCAST		0
+
+#define FAGPIO_MODBUS_ETIMEOUT		-1
+#define FAGPIO_MODBUS_ECRC			-2
+#define FAGPIO_MODBUS_EFRAME		-3		//Wrong slave, function, length or size
+#define FAGPIO_MODBUS_EARG			-4
+#define FAGPIO_MODBUS_EIO			-5
+
+// Exception codes
+#define FAGPIO_MODBUS_ILLEGAL_FUNCTION	1
+#define FAGPIO_MODBUS_ILLEGAL_ADDRESS	2
+#define FAGPIO_MODBUS_ILLEGAL_VALUE		3
+
+struct fagpio_modbus {
+	uint8_t uart;
+	uint32_t char_ticks;		//One character on the wire
+	uint32_t gap_ticks;			//3.5 characters or 1.75 ms
+	uint32_t timeout_ticks;		//Master: answer timeout
+	uint32_t last_ticks;		//End of the last frame seen or sent
+	uint32_t timeouts, crc_errors, requests;
+	uint8_t frame[FAGPIO_MODBUS_MAX_FRAME];
+};
+
+// Register tables of a slave; a NULL table answers exception 1
+struct fagpio_modbus_regs {
+	uint16_t *holding;
+	uint16_t holding_count;
+	const uint16_t *input;
+	uint16_t input_count;
+	void (*written)(uint16_t addr, uint16_t count, void *arg);	//After either write function, may be NULL
+	void *arg;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// lcr UART_LCR_8E1 for the spec's format, UART_LCR_8N1 for most devices that do not follow it
+int fagpio_modbus_open(struct fagpio_modbus *m, uint8_t uart, uint32_t baud, uint8_t dir_pin, uint8_t lcr);
+void fagpio_modbus_close(struct fagpio_modbus *m);
+
+uint16_t fagpio_modbus_crc(const uint8_t *data, size_t len);
+
+// Master; a broadcast (slave 0) write returns 0 once sent
+int fagpio_modbus_read_holding(struct fagpio_modbus *m, uint8_t slave, uint16_t addr, uint16_t count, uint16_t *out);
+int fagpio_modbus_read_input(struct fagpio_modbus *m, uint8_t slave, uint16_t addr, uint16_t count, uint16_t *out);
+int fagpio_modbus_write_single(struct fagpio_modbus *m, uint8_t slave, uint16_t addr, uint16_t value);
+int fagpio_modbus_write_multiple(struct fagpio_modbus *m, uint8_t slave, uint16_t addr, uint16_t count, const uint16_t *values);
+
+// out[i] = register addrs[i]; m->requests counts the requests it took
+int fagpio_modbus_read_list(struct fagpio_modbus *m, uint8_t slave, const uint16_t *addrs, size_t n, uint16_t *out, unsigned int hole);
+unsigned int fagpio_modbus_hole(const struct fagpio_modbus *m);
+
+// Slave: serves one request within timeout_ms (-1 forever); 1 answered, 0 nothing for us, negative on error
+int fagpio_modbus_serve(struct fagpio_modbus *m, uint8_t address, const struct fagpio_modbus_regs *regs, int timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
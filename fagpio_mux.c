@@ -0,0 +1,159 @@
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+#include "fagpio_priv.h"
+#include "fagpio_mux.h"
+#include "fagpio_timer.h"
+
+int fagpio_mux_init(struct fagpio_mux *m, const uint8_t *rows, unsigned int nrows, uint8_t row_active,
+		const uint8_t *segs, unsigned int nsegs, uint8_t seg_active, unsigned int refresh_hz) {
+	memset(m, 0, sizeof(*m));
+	if (!nrows || nrows > FAGPIO_MUX_ROWS || !nsegs || nsegs > 32 || !refresh_hz || fagpio_setup() < 0)
+		return -1;
+	m->row_port = PIO_PIN_PORT(rows[0]);
+	m->seg_port = PIO_PIN_PORT(segs[0]);
+	for (unsigned int r = 0; r < nrows; r++) {
+		if (PIO_PIN_PORT(rows[r]) != m->row_port)
+			return -1;
+		m->row_mask |= PIO_PIN_MASK(rows[r]);
+	}
+	for (unsigned int n = 0; n < nsegs; n++) {
+		if (PIO_PIN_PORT(segs[n]) != m->seg_port)
+			return -1;
+		m->seg_bit[n] = PIO_PIN_MASK(segs[n]);
+		m->seg_mask |= m->seg_bit[n];
+	}
+	if (m->row_port == m->seg_port && (m->row_mask & m->seg_mask))
+		return -1;
+	m->row_off = row_active ? 0 : m->row_mask;
+	for (unsigned int r = 0; r < nrows; r++)
+		m->row_word[r] = m->row_off ^ PIO_PIN_MASK(rows[r]);
+	m->seg_on = seg_active ? m->seg_mask : 0;
+	m->nrows = nrows;
+	m->nsegs = nsegs;
+	if (!(m->row_ticks = fagpio_ns_to_ticks(1000000000u / refresh_hz / nrows)))
+		return -1;
+	m->wake = fagpio_ns_to_ticks(FAGPIO_MUX_WAKE_NS);
+	fagpio_mux_clear(m);
+	m->frames[0] = m->frames[1];
+
+	digitalWritePort(m->row_port, m->row_mask, m->row_off);
+	digitalWritePort(m->seg_port, m->seg_mask, m->frames[0].seg[0]);
+	pinModeMask(m->row_port, m->row_mask, OUTPUT);
+	pinModeMask(m->seg_port, m->seg_mask, OUTPUT);
+	return 0;
+}
+
+void fagpio_mux_draw(struct fagpio_mux *m, unsigned int row, uint32_t bits) {
+	uint32_t word = 0;
+
+	if (row >= m->nrows)
+		return;
+	for (unsigned int n = 0; n < m->nsegs; n++) {
+		if (bits & (1u << n))
+			word |= m->seg_bit[n];
+	}
+	m->frames[m->active ^ 1].seg[row] = (word & m->seg_on) | (~word & m->seg_mask & ~m->seg_on);
+}
+
+void fagpio_mux_clear(struct fagpio_mux *m) {
+	struct fagpio_mux_frame *f = &m->frames[m->active ^ 1];
+
+	for (unsigned int r = 0; r < FAGPIO_MUX_ROWS; r++)
+		f->seg[r] = m->seg_mask & ~m->seg_on;
+}
+
+void fagpio_mux_show(struct fagpio_mux *m) {
+	uint32_t next = m->active ^ 1;
+
+	__sync_synchronize();
+	m->active = next;
+	while (m->running && m->playing != next)
+		sched_yield();		//The player is still on the frame about to become the back one
+	m->frames[next ^ 1] = m->frames[next];
+}
+
+static void mux_wait(const struct fagpio_mux *m, uint32_t target) {
+	int32_t idle = target - fagpio_ticks() - m->wake;
+
+	if (idle > 0)
+		usleep(fagpio_ticks_to_ns(idle) / 1000);
+	while ((int32_t)(fagpio_ticks() - target) < 0)
+		;
+}
+
+// Plain stores on copies of DAT taken at the frame start, like fagpio_seq_play_ops()
+FAGPIO_ARM_CODE void fagpio_mux_run(struct fagpio_mux *m) {
+	struct pio_bank *banks = fagpio_banks();
+	uint32_t at = fagpio_ticks();
+
+	if (!banks)
+		return;
+	m->running = 1;
+	while (!m->stop) {
+		uint32_t idx = m->active;
+
+		m->playing = idx;
+		__sync_synchronize();
+
+		const struct fagpio_mux_frame *f = &m->frames[idx];
+		volatile uint32_t *row_dat = &banks[m->row_port].dat, *seg_dat = &banks[m->seg_port].dat;
+		uint32_t row_cur = *row_dat & ~m->row_mask, seg_cur = *seg_dat & ~m->seg_mask;
+
+		for (unsigned int r = 0; r < m->nrows && !m->stop; r++) {
+			if ((int32_t)(fagpio_ticks() - at) > 0)
+				m->late++;
+			else
+				mux_wait(m, at);
+			if (row_dat == seg_dat) {
+				*row_dat = row_cur | m->row_word[r] | f->seg[r];
+			} else {
+				*seg_dat = seg_cur | f->seg[r];
+				*row_dat = row_cur | m->row_word[r];
+			}
+			at += m->row_ticks;
+		}
+	}
+	fagpio_shadow_sync(m->row_port);
+	fagpio_shadow_sync(m->seg_port);
+	digitalWritePort(m->row_port, m->row_mask, m->row_off);
+	m->running = 0;
+}
+
+static void *mux_thread(void *arg) {
+	fagpio_mux_run(arg);
+	return NULL;
+}
+
+int fagpio_mux_start(struct fagpio_mux *m) {
+	m->stop = 0;
+	m->running = 1;		//fagpio_mux_show() must wait for the player from here on
+	if (pthread_create(&m->thread, NULL, mux_thread, m)) {
+		m->running = 0;
+		return -1;
+	}
+	return 0;
+}
+
+void fagpio_mux_stop(struct fagpio_mux *m) {
+	m->stop = 1;
+	if (m->thread) {
+		pthread_join(m->thread, NULL);
+		m->thread = 0;
+	}
+}
+
+static const uint8_t seg7_digits[16] = {
+	0x3f, 0x06, 0x5b, 0x4f, 0x66, 0x6d, 0x7d, 0x07,
+	0x7f, 0x6f, 0x77, 0x7c, 0x39, 0x5e, 0x79, 0x71,
+};
+
+uint8_t fagpio_mux_seg7(char c) {
+	if (c >= '0' && c <= '9')
+		return seg7_digits[c - '0'];
+	if (c >= 'a' && c <= 'f')
+		return seg7_digits[c - 'a' + 10];
+	if (c >= 'A' && c <= 'F')
+		return seg7_digits[c - 'A' + 10];
+	return c == '-' ? 0x40 : 0;
+}
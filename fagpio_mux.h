@@ -0,0 +1,86 @@
+#ifndef _FAGPIO_MUX_H
+#define _FAGPIO_MUX_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include "fagpio.h"
+
+/*
+ * Multiplexed displays (7-segment digits, LED matrices) refreshed from a
+ * background thread. Row selects sit on one port and segments (columns)
+ * on one port; every row of a frame is kept as its segment port word, so
+ * showing a row is two stores, segments then select, or one when both
+ * share a port. Rows start on absolute AVS counter ticks, the thread
+ * sleeping until FAGPIO_MUX_WAKE_NS before each, so a busy application
+ * does not stretch the rows into flicker; run the thread at a real-time
+ * priority (fagpio_rt.h).
+ *
+ * DAT of the two ports is read once per frame and only stored during it:
+ * a write to their other pins from elsewhere can be undone for up to a
+ * frame. Give the display its own ports, or keep to the rest at startup.
+ *
+ * fagpio_mux_draw() and fagpio_mux_clear() edit the back frame;
+ * fagpio_mux_show() publishes it by flipping an index the player reads at
+ * each frame start, then refills the back frame from it once the player
+ * has moved over. No lock is shared with the player; there is one editor.
+ */
+
+#define FAGPIO_MUX_ROWS			16
+#define FAGPIO_MUX_WAKE_NS		100000
+
+// Segment bits of fagpio_mux_seg7(): bit 0 is a, bit 6 g, bit 7 the decimal point
+#define FAGPIO_SEG7_DP			0x80
+
+struct fagpio_mux_frame {
+	uint32_t seg[FAGPIO_MUX_ROWS];		//Segment port word per row, polarity applied
+};
+
+struct fagpio_mux {
+	uint8_t row_port;
+	uint8_t seg_port;
+	uint8_t nrows;
+	uint8_t nsegs;
+	uint32_t row_mask;
+	uint32_t seg_mask;
+	uint32_t row_word[FAGPIO_MUX_ROWS];	//Row port word selecting each row
+	uint32_t row_off;					//Row port word with every row off
+	uint32_t seg_bit[32];				//Port bit of each logical segment
+	uint32_t seg_on;					//Segment port levels that light, within seg_mask
+	uint32_t row_ticks;
+	uint32_t wake;						//Ticks
+	struct fagpio_mux_frame frames[2];
+	volatile uint32_t active;			//Frame the player takes at the next frame start
+	volatile uint32_t playing;			//Frame the player is on
+	volatile uint8_t running;
+	volatile uint8_t stop;
+	unsigned int late;					//Rows started late
+	pthread_t thread;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * rows all on one port, segs all on one port; *_active is the level that
+ * selects a row or lights a segment (HIGH or LOW). refresh_hz is whole
+ * frames per second.
+ */
+int fagpio_mux_init(struct fagpio_mux *m, const uint8_t *rows, unsigned int nrows, uint8_t row_active,
+	const uint8_t *segs, unsigned int nsegs, uint8_t seg_active, unsigned int refresh_hz);
+
+void fagpio_mux_draw(struct fagpio_mux *m, unsigned int row, uint32_t bits);	//Bit n lights segs[n]
+void fagpio_mux_clear(struct fagpio_mux *m);
+void fagpio_mux_show(struct fagpio_mux *m);		//Waits up to a frame for the player to move over
+
+void fagpio_mux_run(struct fagpio_mux *m);		//Refreshes until fagpio_mux_stop()
+int fagpio_mux_start(struct fagpio_mux *m);		//fagpio_mux_run() on a new thread
+void fagpio_mux_stop(struct fagpio_mux *m);		//Leaves every row off
+
+uint8_t fagpio_mux_seg7(char c);		//0-9, A-F either case, '-' and ' '; 0 for the rest
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,202 @@
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "fagpio_priv.h"
+#include "fagpio_net.h"
+#include "fagpio_log.h"
+
+#define NET_POLL_MS		1000		//Wait for a datagram when nobody is subscribed
+#define NET_CHANGE_MS	10			//Subscribed ports are checked for changes this often
+
+struct subscriber {
+	struct sockaddr_in addr;		//sin_port 0 if free
+	uint32_t ports;
+	uint32_t period_ms;
+	uint64_t due_ms;
+	uint32_t last[PIO_NPORTS];
+};
+
+static struct subscriber subs[FAGPIO_NET_SUBSCRIBERS];
+static uint32_t push_seq;
+
+static uint64_t now_ms(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int same_addr(const struct sockaddr_in *a, const struct sockaddr_in *b) {
+	return a->sin_addr.s_addr == b->sin_addr.s_addr && a->sin_port == b->sin_port;
+}
+
+static void subscribe(const struct sockaddr_in *from, uint32_t ports, uint32_t period_ms) {
+	struct subscriber *free_sub = NULL;
+
+	for (unsigned int i = 0; i < FAGPIO_NET_SUBSCRIBERS; i++) {
+		struct subscriber *s = &subs[i];
+
+		if (s->addr.sin_port && same_addr(&s->addr, from)) {
+			if (!period_ms || !ports)
+				s->addr.sin_port = 0;
+			else {
+				s->ports = ports;
+				s->period_ms = period_ms;
+			}
+			return;
+		}
+		if (!s->addr.sin_port && !free_sub)
+			free_sub = s;
+	}
+	if (!period_ms || !ports)
+		return;
+	if (!free_sub) {
+		FAGPIO_LOG(FAGPIO_LOG_INFO, "fagpio_net: no subscriber slot left\n");
+		return;
+	}
+	memset(free_sub, 0, sizeof(*free_sub));
+	free_sub->addr = *from;
+	free_sub->ports = ports;
+	free_sub->period_ms = period_ms;
+	free_sub->due_ms = now_ms();		//First snapshot right away
+}
+
+// Runs the ops of one request, appending read results to reply
+static void run_frame(const struct fagpio_net_frame *f, const struct sockaddr_in *from, struct fagpio_net_frame *reply) {
+	struct fagpio_coalesce p[PIO_NPORTS] = { { 0 } };
+
+	pthread_mutex_lock(&fagpio_server_lock);
+	for (unsigned int i = 0; i < f->hdr.count; i++) {
+		const struct fagpio_net_op *o = &f->op[i];
+
+		if (o->op != FAGPIO_NET_SUBSCRIBE && o->port >= PIO_NPORTS)
+			continue;
+		switch (o->op) {
+		case FAGPIO_NET_WRITE:
+			fagpio_coalesce_write(&p[o->port], o->mask, o->value);
+			break;
+		case FAGPIO_NET_TOGGLE:
+			fagpio_coalesce_toggle(&p[o->port], o->mask);
+			break;
+		case FAGPIO_NET_MODE:
+			fagpio_coalesce_flush(&p[o->port], o->port);
+			pinModeMask(o->port, o->mask, o->arg);
+			break;
+		case FAGPIO_NET_PULL:
+			fagpio_coalesce_flush(&p[o->port], o->port);
+			pinPullMask(o->port, o->mask, o->arg);
+			break;
+		case FAGPIO_NET_READ:
+			fagpio_coalesce_flush(&p[o->port], o->port);
+			fagpio_net_add(reply, FAGPIO_NET_READ, o->port, 0, ~0u, digitalReadPort(o->port));
+			break;
+		case FAGPIO_NET_SUBSCRIBE:
+			subscribe(from, o->mask, o->value);
+			break;
+		}
+	}
+	for (uint8_t port = 0; port < PIO_NPORTS; port++)
+		fagpio_coalesce_flush(&p[port], port);
+	pthread_mutex_unlock(&fagpio_server_lock);
+}
+
+static void serve_request(int fd, const struct fagpio_net_frame *f, ssize_t len, const struct sockaddr_in *from) {
+	struct fagpio_net_frame reply;
+	int bad = len < (ssize_t)sizeof(f->hdr) || f->hdr.magic != FAGPIO_NET_MAGIC ||
+		f->hdr.version != FAGPIO_NET_VERSION || f->hdr.count > FAGPIO_NET_MAX_OPS ||
+		len < (ssize_t)FAGPIO_NET_FRAME_LEN(f->hdr.count);
+
+	if (len < (ssize_t)sizeof(f->hdr))
+		return;
+	fagpio_net_init(&reply, f->hdr.seq, bad ? FAGPIO_NET_ERROR : 0);
+	if (!bad)
+		run_frame(f, from, &reply);
+	if (!bad && (f->hdr.flags & FAGPIO_NET_NOACK))
+		return;
+	sendto(fd, &reply, FAGPIO_NET_FRAME_LEN(reply.hdr.count), 0, (const struct sockaddr *)from, sizeof(*from));
+}
+
+/*
+A subscriber gets a snapshot when its period is up, or earlier when one of
+its ports changed since the last one; returns the ms until the next one.
+*/
+static int push_all(int fd) {
+	uint64_t now = now_ms();
+	int wait = NET_POLL_MS;
+
+	for (unsigned int i = 0; i < FAGPIO_NET_SUBSCRIBERS; i++) {
+		struct subscriber *s = &subs[i];
+		struct fagpio_net_frame f;
+		int changed = 0;
+
+		if (!s->addr.sin_port)
+			continue;
+		fagpio_net_init(&f, 0, FAGPIO_NET_PUSH);
+		for (uint8_t port = 0; port < PIO_NPORTS; port++) {
+			if (!(s->ports & (1u << port)))
+				continue;
+
+			uint32_t dat = digitalReadPort(port);
+
+			changed |= dat != s->last[port];
+			s->last[port] = dat;
+			fagpio_net_add(&f, FAGPIO_NET_READ, port, 0, ~0u, dat);
+		}
+		if (changed || now >= s->due_ms) {
+			f.hdr.seq = push_seq++;
+			sendto(fd, &f, FAGPIO_NET_FRAME_LEN(f.hdr.count), 0, (const struct sockaddr *)&s->addr, sizeof(s->addr));
+			s->due_ms = now + s->period_ms;
+		}
+		if ((int64_t)(s->due_ms - now) < wait)
+			wait = s->due_ms - now;
+		if (wait > NET_CHANGE_MS)
+			wait = NET_CHANGE_MS;
+	}
+	return wait;
+}
+
+int fagpio_net_serve(uint16_t udp_port, volatile int *stop) {
+	if (!fagpio_banks()) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "fagpio_net: cannot map the PIO registers\n");
+		return -1;
+	}
+
+	int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	struct sockaddr_in addr = { 0 };
+
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(udp_port ? udp_port : FAGPIO_NET_PORT);
+	if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "fagpio_net: udp port %u: %s\n", ntohs(addr.sin_port), strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+	memset(subs, 0, sizeof(subs));
+
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	int wait = NET_POLL_MS;
+
+	while (!*stop) {
+		if (poll(&pfd, 1, wait) > 0) {
+			struct fagpio_net_frame f;
+			struct sockaddr_in from;
+			socklen_t from_len = sizeof(from);
+			ssize_t len;
+
+			//Drain everything queued before looking at the subscribers
+			while ((len = recvfrom(fd, &f, sizeof(f), MSG_DONTWAIT, (struct sockaddr *)&from, &from_len)) >= 0) {
+				serve_request(fd, &f, len, &from);
+				from_len = sizeof(from);
+			}
+		}
+		wait = push_all(fd);
+	}
+	close(fd);
+	return 0;
+}
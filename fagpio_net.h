@@ -0,0 +1,111 @@
+#ifndef _FAGPIO_NET_H
+#define _FAGPIO_NET_H
+
+#include <stdint.h>
+
+/*
+ * Remote GPIO over UDP, served by fagpiod next to its shared-memory rings.
+ * One datagram carries a header and a batch of fixed-size ops, all fields
+ * little-endian (the byte order of the F1C100s). Writes and toggles of one
+ * batch fold into a single DAT store per port, as in fagpiod; a mode, pull
+ * or read op first flushes what is pending for its port.
+ *
+ * Every request is answered with the same seq, unless FAGPIO_NET_NOACK is
+ * set: the reply holds one FAGPIO_NET_READ op per read, with the port's
+ * DAT in value. A client that sees no reply for a seq resends it; writes
+ * are idempotent, toggles are not.
+ *
+ * FAGPIO_NET_SUBSCRIBE has the sender pushed a snapshot of the ports in
+ * mask (bit n = port n) every value ms, and whenever one of them
+ * changed at the next poll; value 0 unsubscribes. Pushes carry
+ * FAGPIO_NET_PUSH and a seq of their own.
+ *
+ * This header has no other dependency, so host programs can include it
+ * to build their frames.
+ */
+
+#define FAGPIO_NET_PORT		4242
+#define FAGPIO_NET_MAGIC	0x4746			//"FG"
+#define FAGPIO_NET_VERSION	1
+#define FAGPIO_NET_MAX_OPS	120				//Keeps a datagram within one Ethernet frame
+#define FAGPIO_NET_SUBSCRIBERS	4
+
+// Header flags
+#define FAGPIO_NET_NOACK	0x01			//Request: no reply wanted
+#define FAGPIO_NET_PUSH		0x02			//Server: periodic snapshot
+#define FAGPIO_NET_ERROR	0x80			//Server: bad frame, ops not run
+
+enum {
+	FAGPIO_NET_WRITE,		//DAT bits in mask := value
+	FAGPIO_NET_TOGGLE,		//DAT bits in mask inverted
+	FAGPIO_NET_MODE,		//pinModeMask(port, mask, arg)
+	FAGPIO_NET_PULL,		//pinPullMask(port, mask, arg)
+	FAGPIO_NET_READ,		//DAT of port, returned in the reply
+	FAGPIO_NET_SUBSCRIBE,	//Push the ports in mask every value ms, 0 stops
+};
+
+struct fagpio_net_hdr {
+	uint16_t magic;
+	uint8_t version;
+	uint8_t flags;
+	uint32_t seq;
+	uint16_t count;			//Ops that follow
+	uint16_t pad;
+} __attribute__((packed));
+
+struct fagpio_net_op {
+	uint8_t op;
+	uint8_t port;
+	uint8_t arg;
+	uint8_t pad;
+	uint32_t mask;
+	uint32_t value;
+} __attribute__((packed));
+
+struct fagpio_net_frame {
+	struct fagpio_net_hdr hdr;
+	struct fagpio_net_op op[FAGPIO_NET_MAX_OPS];
+} __attribute__((packed));
+
+#define FAGPIO_NET_FRAME_LEN(n)	(sizeof(struct fagpio_net_hdr) + (n) * sizeof(struct fagpio_net_op))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static inline void fagpio_net_init(struct fagpio_net_frame *f, uint32_t seq, uint8_t flags) {
+	f->hdr.magic = FAGPIO_NET_MAGIC;
+	f->hdr.version = FAGPIO_NET_VERSION;
+	f->hdr.flags = flags;
+	f->hdr.seq = seq;
+	f->hdr.count = 0;
+	f->hdr.pad = 0;
+}
+
+// Appends an op; -1 when the frame is full
+static inline int fagpio_net_add(struct fagpio_net_frame *f, uint8_t op, uint8_t port, uint8_t arg, uint32_t mask, uint32_t value) {
+	if (f->hdr.count >= FAGPIO_NET_MAX_OPS)
+		return -1;
+
+	struct fagpio_net_op *o = &f->op[f->hdr.count++];
+
+	o->op = op;
+	o->port = port;
+	o->arg = arg;
+	o->pad = 0;
+	o->mask = mask;
+	o->value = value;
+	return 0;
+}
+
+/*
+ * Server side (libfagpio): serves udp_port (0 for FAGPIO_NET_PORT) until
+ * *stop is set; -1 if the socket cannot be bound.
+ */
+int fagpio_net_serve(uint16_t udp_port, volatile int *stop);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
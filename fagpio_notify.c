@@ -0,0 +1,93 @@
+#include <errno.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include "fagpio_notify.h"
+#include "fagpio_eint.h"
+#include "fagpio_log.h"
+
+static int epoll_fd = -1;
+static int event_fd = -1;
+
+int fagpio_notify_fd(void) {
+	struct epoll_event ev = { .events = EPOLLIN };
+
+	if (epoll_fd >= 0)
+		return epoll_fd;
+	if ((epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0 ||
+			(event_fd = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC)) < 0) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "notify: %s\n", strerror(errno));
+		fagpio_notify_close();
+		return -1;
+	}
+	ev.data.u32 = PIO_NPORTS;		//Ports index the UIO fds, PIO_NPORTS the eventfd
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, event_fd, &ev) < 0) {
+		fagpio_notify_close();
+		return -1;
+	}
+	return epoll_fd;
+}
+
+int fagpio_notify_watch(uint8_t pin, uint8_t edge) {
+	uint8_t port = PIO_PIN_PORT(pin);
+	int fd;
+
+	if (fagpio_notify_fd() < 0 || (fd = attachInterrupt(pin, edge)) < 0)
+		return -1;
+	struct epoll_event ev = { .events = EPOLLIN, .data.u32 = port };
+
+	// One fd per port; EEXIST once another pin of the port is watched
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0 && errno != EEXIST)
+		return -1;
+	return 0;
+}
+
+int fagpio_notify_add(int fd) {
+	struct epoll_event ev = { .events = EPOLLIN, .data.u32 = PIO_NPORTS + 1 };
+
+	if (fd < 0 || fagpio_notify_fd() < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0)
+		return -1;
+	return 0;
+}
+
+void fagpio_notify_post(void) {
+	uint64_t one = 1;
+
+	if (event_fd >= 0 && write(event_fd, &one, sizeof(one)) < 0)
+		return;		//Counter saturated, a wakeup is pending anyway
+}
+
+uint32_t fagpio_notify_read(uint32_t changed[PIO_NPORTS]) {
+	struct epoll_event evs[PIO_NPORTS + 2];
+	uint32_t ports = 0;
+	int n;
+
+	memset(changed, 0, PIO_NPORTS * sizeof(changed[0]));
+	if (epoll_fd < 0 || (n = epoll_wait(epoll_fd, evs, PIO_NPORTS + 2, 0)) <= 0)
+		return 0;
+
+	for (int i = 0; i < n; i++) {
+		uint32_t port = evs[i].data.u32;
+
+		if (port == PIO_NPORTS + 1) {
+			ports |= FAGPIO_NOTIFY_FD;
+		} else if (port == PIO_NPORTS) {
+			uint64_t count;
+
+			if (read(event_fd, &count, sizeof(count)) == sizeof(count))
+				ports |= FAGPIO_NOTIFY_POSTED;
+		} else if ((changed[port] = fagpio_eint_wait(port, 0))) {
+			ports |= 1u << port;
+		}
+	}
+	return ports;
+}
+
+void fagpio_notify_close(void) {
+	if (event_fd >= 0)
+		close(event_fd);
+	if (epoll_fd >= 0)
+		close(epoll_fd);
+	event_fd = epoll_fd = -1;
+}
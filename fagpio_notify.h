@@ -0,0 +1,41 @@
+#ifndef _FAGPIO_NOTIFY_H
+#define _FAGPIO_NOTIFY_H
+
+#include <stdint.h>
+#include "fagpio.h"
+
+/*
+ * One fd for an application's event loop. fagpio_notify_fd() is an epoll
+ * fd that itself becomes readable (add it to your own epoll or poll set)
+ * when a watched EINT pin fired or another thread called
+ * fagpio_notify_post(), which writes an internal eventfd. Any burst of
+ * events before the loop runs turns into one wakeup; fagpio_notify_read()
+ * then collects and re-arms everything without blocking.
+ *
+ * Pins on EINT ports are watched through attachInterrupt() (fagpio_eint.h);
+ * for other pins a sampling thread can post instead. Other fds, such as
+ * fagpio_async_fd(), join the set with fagpio_notify_add(); their owner
+ * drains them.
+ */
+
+#define FAGPIO_NOTIFY_POSTED	(1u << 31)	//fagpio_notify_read(): fagpio_notify_post() was called
+#define FAGPIO_NOTIFY_FD		(1u << 30)	//An fd of fagpio_notify_add() is readable
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fagpio_notify_fd(void);
+int fagpio_notify_watch(uint8_t pin, uint8_t edge);
+int fagpio_notify_add(int fd);		//Level-triggered, left unread
+void fagpio_notify_post(void);		//Async-signal-safe
+
+// Fills changed[port] with the pins that fired; returns a bit per port plus FAGPIO_NOTIFY_POSTED
+uint32_t fagpio_notify_read(uint32_t changed[PIO_NPORTS]);
+void fagpio_notify_close(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
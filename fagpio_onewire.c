@@ -0,0 +1,179 @@
+#include "fagpio_priv.h"
+#include "fagpio_onewire.h"
+#include "fagpio_crc.h"
+#include "fagpio_timer.h"
+
+#define OW_SKIP_ROM		0xCC
+#define OW_MATCH_ROM	0x55
+#define OW_SEARCH_ROM	0xF0
+#define DS_CONVERT_T	0x44
+#define DS_READ_SCRATCH	0xBE
+
+static inline void ow_low(struct fagpio_onewire *ow) {
+	*ow->cfg = (*ow->cfg & ~(15u << ow->shift)) | (1u << ow->shift);
+}
+
+static inline void ow_release(struct fagpio_onewire *ow) {
+	*ow->cfg &= ~(15u << ow->shift);
+}
+
+static inline int ow_sense(struct fagpio_onewire *ow) {
+	return (*ow->dat & ow->mask) != 0;
+}
+
+static inline void delay_us(uint32_t us) {
+	fagpio_delay_ns(us * 1000);
+}
+
+int fagpio_onewire_init(struct fagpio_onewire *ow, uint8_t pin) {
+	struct pio_bank *banks = fagpio_banks();
+
+	if (!banks || PIO_PIN_PORT(pin) >= PIO_NPORTS)
+		return -1;
+
+	struct pio_bank *bank = &banks[PIO_PIN_PORT(pin)];
+
+	ow->cfg = &bank->cfg[PIO_PIN_NUM(pin) >> 3];
+	ow->dat = &bank->dat;
+	ow->mask = PIO_PIN_MASK(pin);
+	ow->shift = (PIO_PIN_NUM(pin) & 7) * 4;
+
+	pinMode(pin, 1);
+	pinPull(pin, PULL_NONE);
+	digitalWritePort(PIO_PIN_PORT(pin), ow->mask, 0);
+	return 0;
+}
+
+int fagpio_onewire_reset(struct fagpio_onewire *ow) {
+	int presence;
+
+	ow_low(ow);
+	delay_us(480);
+	ow_release(ow);
+	delay_us(70);
+	presence = !ow_sense(ow);
+	delay_us(410);
+	return presence;
+}
+
+static void ow_write_bit(struct fagpio_onewire *ow, int bit) {
+	ow_low(ow);
+	delay_us(bit ? 6 : 60);
+	ow_release(ow);
+	delay_us(bit ? 64 : 10);
+}
+
+static int ow_read_bit(struct fagpio_onewire *ow) {
+	int bit;
+
+	ow_low(ow);
+	delay_us(6);
+	ow_release(ow);
+	delay_us(9);
+	bit = ow_sense(ow);
+	delay_us(55);
+	return bit;
+}
+
+void fagpio_onewire_write(struct fagpio_onewire *ow, uint8_t v) {
+	for (int i = 0; i < 8; i++)
+		ow_write_bit(ow, (v >> i) & 1);		//LSB first
+}
+
+uint8_t fagpio_onewire_read(struct fagpio_onewire *ow) {
+	uint8_t v = 0;
+
+	for (int i = 0; i < 8; i++)
+		v |= ow_read_bit(ow) << i;
+	return v;
+}
+
+void fagpio_onewire_select(struct fagpio_onewire *ow, uint64_t rom) {
+	if (!rom) {
+		fagpio_onewire_write(ow, OW_SKIP_ROM);
+		return;
+	}
+	fagpio_onewire_write(ow, OW_MATCH_ROM);
+	for (int i = 0; i < 8; i++)
+		fagpio_onewire_write(ow, rom >> (8 * i));
+}
+
+uint8_t fagpio_onewire_crc8(const uint8_t *data, unsigned int len) {
+	return fagpio_crc8_maxim(FAGPIO_CRC8_MAXIM_INIT, data, len);
+}
+
+// ROM search: each pass follows the last discrepancy of the previous one down the 0 branch
+int fagpio_onewire_search(struct fagpio_onewire *ow, uint64_t *roms, int max) {
+	uint64_t rom = 0;
+	int last_fork = -1, found = 0;
+
+	while (found < max) {
+		int fork = -1;
+
+		if (!fagpio_onewire_reset(ow))
+			break;
+		fagpio_onewire_write(ow, OW_SEARCH_ROM);
+
+		for (int i = 0; i < 64; i++) {
+			int bit = ow_read_bit(ow), cmp = ow_read_bit(ow), dir;
+
+			if (bit && cmp)
+				return found;			//No device answered
+			if (bit != cmp) {
+				dir = bit;
+			} else {
+				dir = i < last_fork ? (int)((rom >> i) & 1) : i == last_fork;
+				if (!dir)
+					fork = i;
+			}
+			rom = (rom & ~(1ull << i)) | ((uint64_t)dir << i);
+			ow_write_bit(ow, dir);
+		}
+
+		uint8_t bytes[8];
+
+		for (int i = 0; i < 8; i++)
+			bytes[i] = rom >> (8 * i);
+		if (fagpio_onewire_crc8(bytes, 8) == 0)
+			roms[found++] = rom;
+		if ((last_fork = fork) < 0)
+			break;
+	}
+	return found;
+}
+
+int fagpio_ds18b20_measure_all(struct fagpio_ds18b20 *sensors, unsigned int count) {
+	int read = 0;
+
+	// One conversion command per bus, however many sensors share it
+	for (unsigned int i = 0; i < count; i++) {
+		unsigned int j;
+
+		for (j = 0; j < i && sensors[j].bus != sensors[i].bus; j++)
+			;
+		if (j == i && fagpio_onewire_reset(sensors[i].bus)) {
+			fagpio_onewire_write(sensors[i].bus, OW_SKIP_ROM);
+			fagpio_onewire_write(sensors[i].bus, DS_CONVERT_T);
+		}
+	}
+	usleep(DS18B20_CONVERT_MS * 1000);
+
+	for (unsigned int i = 0; i < count; i++) {
+		struct fagpio_ds18b20 *s = &sensors[i];
+		uint8_t sp[9];
+
+		s->ok = 0;
+		if (!fagpio_onewire_reset(s->bus))
+			continue;
+		fagpio_onewire_select(s->bus, s->rom);
+		fagpio_onewire_write(s->bus, DS_READ_SCRATCH);
+		for (int b = 0; b < 9; b++)
+			sp[b] = fagpio_onewire_read(s->bus);
+		if (fagpio_onewire_crc8(sp, 9) != 0)
+			continue;
+		s->millicelsius = (int16_t)(sp[0] | sp[1] << 8) * 1000 / 16;
+		s->ok = 1;
+		read++;
+	}
+	return read;
+}
@@ -0,0 +1,52 @@
+#ifndef _FAGPIO_ONEWIRE_H
+#define _FAGPIO_ONEWIRE_H
+
+#include <stdint.h>
+
+/*
+ * 1-Wire master on any pin, standard speed. The line is open drain like in
+ * fagpio_bbi2c.h (DAT held at 0, CFG switched between output and input)
+ * and every slot is timed with fagpio_delay_ns() on the AVS counter; run
+ * from fagpio_rt_enter() so that a read slot is not preempted. An
+ * external 4.7k pull-up is required.
+ *
+ * fagpio_ds18b20_measure_all() starts the conversion on every bus with one
+ * SKIP ROM, waits one conversion time for all of them and then reads each
+ * sensor, instead of 750 ms per sensor.
+ */
+
+#define DS18B20_CONVERT_MS	750		//12-bit resolution
+
+struct fagpio_onewire {
+	volatile uint32_t *cfg;
+	volatile uint32_t *dat;
+	uint32_t mask;
+	uint8_t shift;
+};
+
+struct fagpio_ds18b20 {
+	struct fagpio_onewire *bus;
+	uint64_t rom;			//From fagpio_onewire_search(), 0 for the only device on the bus
+	int32_t millicelsius;
+	int ok;					//Set by fagpio_ds18b20_measure_all() on a good CRC
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fagpio_onewire_init(struct fagpio_onewire *ow, uint8_t pin);
+int fagpio_onewire_reset(struct fagpio_onewire *ow);		//1 if a device answered
+void fagpio_onewire_write(struct fagpio_onewire *ow, uint8_t v);
+uint8_t fagpio_onewire_read(struct fagpio_onewire *ow);
+void fagpio_onewire_select(struct fagpio_onewire *ow, uint64_t rom);	//MATCH ROM, or SKIP ROM for 0
+int fagpio_onewire_search(struct fagpio_onewire *ow, uint64_t *roms, int max);	//ROMs found
+uint8_t fagpio_onewire_crc8(const uint8_t *data, unsigned int len);
+
+int fagpio_ds18b20_measure_all(struct fagpio_ds18b20 *sensors, unsigned int count);	//Sensors read
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
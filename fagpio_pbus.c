@@ -0,0 +1,109 @@
+#include <string.h>
+#include "fagpio_priv.h"
+#include "fagpio_pbus.h"
+#include "fagpio_timer.h"
+
+int fagpio_pbus_init(struct fagpio_pbus *b, const uint8_t *pins, uint8_t width, uint8_t strobe, unsigned int flags, uint32_t hold_ns) {
+	struct pio_bank *banks = fagpio_banks();
+	uint8_t port, lo = 31, hi = 0;
+	uint32_t mask = 0;
+
+	if (!banks || !pins || !width || width > FAGPIO_PBUS_MAX_WIDTH || PIO_PIN_PORT(strobe) >= PIO_NPORTS)
+		return -1;
+	port = PIO_PIN_PORT(pins[0]);
+	for (unsigned int i = 0; i < width; i++) {
+		uint8_t n = PIO_PIN_NUM(pins[i]);
+
+		if (PIO_PIN_PORT(pins[i]) != port || port >= PIO_NPORTS || (mask & (1u << n)) || pins[i] == strobe)
+			return -1;
+		mask |= 1u << n;
+		lo = n < lo ? n : lo;
+		hi = n > hi ? n : hi;
+	}
+	if (hi - lo >= 8 * FAGPIO_PBUS_LUTS)
+		return -1;
+
+	memset(b->lut, 0, sizeof(b->lut));
+	b->lut_shift = lo;
+	for (unsigned int i = 0; i < width; i++) {
+		unsigned int at = PIO_PIN_NUM(pins[i]) - lo;
+		uint16_t (*t)[256] = &b->lut[at / 8];
+
+		for (unsigned int v = 0; v < 256; v++) {
+			if (v & (1u << (at % 8)))
+				(*t)[v] |= 1u << i;
+		}
+	}
+
+	b->data = &banks[port].dat;
+	b->strobe_port = PIO_PIN_PORT(strobe);
+	b->strobe = &banks[b->strobe_port].dat;
+	b->strobe_mask = PIO_PIN_MASK(strobe);
+	b->width = width;
+	b->flags = flags;
+	b->hold_ns = hold_ns;
+	b->costs_gen = fagpio_costs_gen;
+	b->hold = fagpio_pad_ticks(hold_ns, 0, 1);
+
+	pinModeMask(port, mask, INPUT);
+	digitalWritePort(b->strobe_port, b->strobe_mask, (flags & FAGPIO_PBUS_ACTIVE_LOW) ? b->strobe_mask : 0);
+	pinMode(strobe, OUTPUT);
+	return 0;
+}
+
+/*
+Read while asserted: strobe, hold, sample, release. Read after: strobe,
+hold, release, sample. The remap happens between the release and the next
+strobe, where the device needs its recovery time anyway.
+*/
+#define PBUS_DURING(i) do { \
+		*strobe = on; \
+		if (hold) \
+			fagpio_delay_cycles(hold); \
+		uint32_t v = *data; \
+		*strobe = off; \
+		out[i] = fagpio_pbus_map(b, v); \
+	} while (0)
+
+#define PBUS_AFTER(i) do { \
+		*strobe = on; \
+		if (hold) \
+			fagpio_delay_cycles(hold); \
+		*strobe = off; \
+		out[i] = fagpio_pbus_map(b, *data); \
+	} while (0)
+
+FAGPIO_ARM_CODE uint32_t fagpio_pbus_burst(struct fagpio_pbus *b, uint16_t *out, size_t count) {
+	if (fagpio_costs_update(&b->costs_gen))
+		b->hold = fagpio_pad_ticks(b->hold_ns, 0, 1);
+
+	volatile uint32_t *data = b->data, *strobe = b->strobe;
+	uint32_t hold = b->hold;
+	uint32_t idle = *strobe & ~b->strobe_mask;
+	uint32_t on = (b->flags & FAGPIO_PBUS_ACTIVE_LOW) ? idle : idle | b->strobe_mask;
+	uint32_t off = on ^ b->strobe_mask;
+	uint32_t start = fagpio_ticks();
+	size_t i = 0;
+
+	if (b->flags & FAGPIO_PBUS_READ_AFTER) {
+		for (; i + 4 <= count; i += 4, out += 4) {
+			PBUS_AFTER(0);
+			PBUS_AFTER(1);
+			PBUS_AFTER(2);
+			PBUS_AFTER(3);
+		}
+		for (; i < count; i++, out++)
+			PBUS_AFTER(0);
+	} else {
+		for (; i + 4 <= count; i += 4, out += 4) {
+			PBUS_DURING(0);
+			PBUS_DURING(1);
+			PBUS_DURING(2);
+			PBUS_DURING(3);
+		}
+		for (; i < count; i++, out++)
+			PBUS_DURING(0);
+	}
+	fagpio_shadow_sync(b->strobe_port);
+	return fagpio_ticks() - start;
+}
@@ -0,0 +1,65 @@
+#ifndef _FAGPIO_PBUS_H
+#define _FAGPIO_PBUS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Burst reads from parallel-output devices: AD7606-style ADCs clocked by
+ * RD, or any bus of up to 16 data pins on one port latched by a strobe
+ * the host drives. Each word is a strobe store, one DAT load of the data
+ * port and the release store, in a loop unrolled by four. The data pins
+ * may sit anywhere on their port and in any order: the DAT snapshot is
+ * remapped with three 256-entry tables, one per byte of the port the pins
+ * span, built at init, so a word costs three loads and two ORs whatever
+ * the wiring.
+ *
+ * By default the data is sampled while the strobe is asserted (RD-style);
+ * FAGPIO_PBUS_READ_AFTER samples after it is released. Conversion starts
+ * (CONVST) and BUSY waits are left to the caller.
+ */
+
+#define FAGPIO_PBUS_MAX_WIDTH		16
+#define FAGPIO_PBUS_LUTS			3		//Port bytes 16 pins can span
+
+#define FAGPIO_PBUS_ACTIVE_LOW		0x01	//Strobe idles high
+#define FAGPIO_PBUS_READ_AFTER		0x02
+
+struct fagpio_pbus {
+	volatile uint32_t *data;		//DAT of the data port
+	volatile uint32_t *strobe;		//DAT of the strobe port
+	uint8_t strobe_port;
+	uint8_t width;
+	uint8_t flags;
+	uint8_t lut_shift;				//Bit of the port the first table covers
+	uint32_t strobe_mask;
+	uint32_t hold;					//Ticks between the strobe store and the sample
+	uint32_t hold_ns;				//hold is recomputed from it when the access costs change
+	uint32_t costs_gen;
+	uint16_t lut[FAGPIO_PBUS_LUTS][256];
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * pins[i] is the pin carrying data bit i (all on one port), width 1 to
+ * 16. hold_ns is the strobe-to-data time of the device, 0 for none.
+ */
+int fagpio_pbus_init(struct fagpio_pbus *b, const uint8_t *pins, uint8_t width, uint8_t strobe, unsigned int flags, uint32_t hold_ns);
+
+// Reads count words; returns the ticks the burst took
+uint32_t fagpio_pbus_burst(struct fagpio_pbus *b, uint16_t *out, size_t count);
+
+// Remaps one DAT snapshot of the data port
+static inline uint16_t fagpio_pbus_map(const struct fagpio_pbus *b, uint32_t dat) {
+	dat >>= b->lut_shift;
+	return b->lut[0][dat & 0xFF] | b->lut[1][(dat >> 8) & 0xFF] | b->lut[2][(dat >> 16) & 0xFF];
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,53 @@
+#include <string.h>
+#include <time.h>
+#include "fagpio_periodic.h"
+
+int fagpio_periodic_begin(struct fagpio_periodic *p, uint32_t period_ns, uint32_t spin_ns, fagpio_periodic_cb on_miss, void *arg) {
+	uint32_t period = fagpio_ns_to_ticks(period_ns);
+
+	if (!period || period > 0x7FFFFFFF)
+		return -1;
+	memset(p, 0, sizeof(*p));
+	p->period = period;
+	p->spin = fagpio_ns_to_ticks(spin_ns);
+	p->on_miss = on_miss;
+	p->arg = arg;
+	p->deadline = fagpio_ticks() + period;
+	return 0;
+}
+
+/*
+The sleep is recomputed from the counter after every wake-up, so an
+early return from nanosleep() (a signal) only costs another sleep, and
+the counter, not CLOCK_MONOTONIC, decides when the deadline is.
+*/
+uint32_t fagpio_periodic_next(struct fagpio_periodic *p) {
+	uint32_t now = fagpio_ticks();
+	int32_t left = p->deadline - now;
+	uint32_t missed = 0, late;
+
+	p->count++;
+	if (left < 0) {
+		late = -left;
+		missed = 1 + late / p->period;
+		p->deadline += missed * p->period;
+		p->missed += missed;
+	} else {
+		while (left > (int32_t)p->spin) {
+			uint32_t ns = fagpio_ticks_to_ns(left - p->spin);
+			struct timespec ts = { ns / 1000000000, ns % 1000000000 };
+
+			nanosleep(&ts, NULL);
+			left = p->deadline - fagpio_ticks();
+		}
+		while ((int32_t)(p->deadline - (now = fagpio_ticks())) > 0)
+			;
+		late = now - p->deadline;
+		p->deadline += p->period;
+	}
+	if (late > p->worst)
+		p->worst = late;
+	if (missed && p->on_miss)
+		p->on_miss(p, late, p->arg);
+	return missed;
+}
@@ -0,0 +1,49 @@
+#ifndef _FAGPIO_PERIODIC_H
+#define _FAGPIO_PERIODIC_H
+
+#include <stdint.h>
+#include "fagpio_timer.h"
+
+/*
+ * Periodic loops on absolute deadlines. fagpio_periodic_begin() sets the
+ * first deadline one period after the call; each fagpio_periodic_next()
+ * waits for the current deadline and moves it on by exactly one period,
+ * so the time the loop body takes does not add up as it does with a
+ * usleep() per iteration. The wait sleeps until spin_ns before the
+ * deadline and spins on the counter for the rest.
+ *
+ * A deadline that has already passed when next() is called is a miss:
+ * next() returns at once, and deadlines the overrun went past are skipped
+ * and counted as missed too, so the loop stays on its grid instead of
+ * running a burst of iterations to catch up. on_miss, if set, is called
+ * from next() with the lateness in ticks. worst is the largest lateness
+ * of any release, misses and oversleeps alike.
+ */
+
+struct fagpio_periodic;
+
+typedef void (*fagpio_periodic_cb)(struct fagpio_periodic *p, uint32_t late, void *arg);
+
+struct fagpio_periodic {
+	uint32_t period;		//Ticks
+	uint32_t spin;			//Ticks spun instead of slept before each deadline
+	uint32_t deadline;		//Counter at the next release
+	uint32_t count;			//Calls to next()
+	uint32_t missed;		//Deadlines missed
+	uint32_t worst;			//Ticks, largest lateness of a release
+	fagpio_periodic_cb on_miss;
+	void *arg;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fagpio_periodic_begin(struct fagpio_periodic *p, uint32_t period_ns, uint32_t spin_ns, fagpio_periodic_cb on_miss, void *arg);
+uint32_t fagpio_periodic_next(struct fagpio_periodic *p);		//Deadlines missed before this release, 0 if on time
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
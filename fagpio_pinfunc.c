@@ -0,0 +1,119 @@
+#include "fagpio_priv.h"
+#include "fagpio_pinfunc.h"
+#include "fagpio_soc.h"
+
+#define FUNC_NAME		10		//Longest name and its NUL
+#define F(f2, f3, f4, f5, f6)	{ f2, f3, f4, f5, f6 }
+
+/*
+Functions 2-6 of each pin, "" where reserved, port after port from
+func_first[]: arrays rather than pointers, so that the table needs no
+relocation and stays in the shared read-only pages of the library.
+*/
+static const char func_names[][5][FUNC_NAME] = {
+	// PA
+	F("rtp_x1",		"",			"i2s_bclk",	"uart1_rts",	"spi1_cs"),
+	F("rtp_x2",		"",			"i2s_lrck",	"uart1_cts",	"spi1_mosi"),
+	F("rtp_y1",		"pwm0",		"i2s_in",	"uart1_rx",		"spi1_clk"),
+	F("rtp_y2",		"",			"i2s_out",	"uart1_tx",		"spi1_miso"),
+	// PB
+	F("",			"",			"",			"",				""),
+	F("",			"",			"",			"",				""),
+	F("",			"",			"",			"",				""),
+	F("ddr_ref",	"ir_rx",	"",			"",				""),
+	// PC
+	F("spi0_clk",	"mmc1_clk",	"",			"",				""),
+	F("spi0_cs",	"mmc1_cmd",	"",			"",				""),
+	F("spi0_miso",	"mmc1_d0",	"",			"",				""),
+	F("spi0_mosi",	"uart0_tx",	"",			"",				""),
+	// PD
+	F("lcd_d2",		"twi0_sda",	"rsb_sda",	"",				"eint"),
+	F("lcd_d3",		"uart1_rts",	"",		"",				"eint"),
+	F("lcd_d4",		"uart1_cts",	"",		"",				"eint"),
+	F("lcd_d5",		"uart1_rx",	"",			"",				"eint"),
+	F("lcd_d6",		"uart1_tx",	"",			"",				"eint"),
+	F("lcd_d7",		"twi1_sck",	"",			"",				"eint"),
+	F("lcd_d10",	"twi1_sda",	"",			"",				"eint"),
+	F("lcd_d11",	"i2s_mclk",	"",			"",				"eint"),
+	F("lcd_d12",	"i2s_bclk",	"",			"",				"eint"),
+	F("lcd_d13",	"i2s_lrck",	"",			"",				"eint"),
+	F("lcd_d14",	"i2s_in",	"",			"",				"eint"),
+	F("lcd_d15",	"i2s_out",	"",			"",				"eint"),
+	F("lcd_d18",	"twi0_sck",	"rsb_sck",	"",				"eint"),
+	F("lcd_d19",	"uart2_tx",	"",			"",				"eint"),
+	F("lcd_d20",	"uart2_rx",	"",			"",				"eint"),
+	F("lcd_d21",	"uart2_rts",	"twi2_sck",	"",			"eint"),
+	F("lcd_d22",	"uart2_cts",	"twi2_sda",	"",			"eint"),
+	F("lcd_d23",	"owa_out",	"",			"",				"eint"),
+	F("lcd_clk",	"spi0_cs",	"",			"",				"eint"),
+	F("lcd_de",		"spi0_mosi",	"",		"",				"eint"),
+	F("lcd_hsync",	"spi0_clk",	"",			"",				"eint"),
+	F("lcd_vsync",	"spi0_miso",	"",		"",				"eint"),
+	// PE
+	F("csi_hsync",	"lcd_d0",	"twi2_sck",	"uart0_rx",		"eint"),
+	F("csi_vsync",	"lcd_d1",	"twi2_sda",	"uart0_tx",		"eint"),
+	F("csi_pclk",	"lcd_d8",	"clk_out",	"",				"eint"),
+	F("csi_d0",		"lcd_d9",	"i2s_bclk",	"rsb_sck",		"eint"),
+	F("csi_d1",		"lcd_d16",	"i2s_lrck",	"rsb_sda",		"eint"),
+	F("csi_d2",		"lcd_d17",	"i2s_in",	"",				"eint"),
+	F("csi_d3",		"pwm1",		"i2s_out",	"owa_out",		"eint"),
+	F("csi_d4",		"uart2_tx",	"spi1_cs",	"",				"eint"),
+	F("csi_d5",		"uart2_rx",	"spi1_mosi",	"",			"eint"),
+	F("csi_d6",		"uart2_rts",	"spi1_clk",	"",			"eint"),
+	F("csi_d7",		"uart2_cts",	"spi1_miso",	"",			"eint"),
+	F("clk_out",	"twi0_sck",	"ir_rx",	"",				"eint"),
+	F("i2s_mclk",	"twi0_sda",	"pwm0",		"",				"eint"),
+	// PF
+	F("mmc0_d1",	"jtag_ms",	"",			"",				"eint"),
+	F("mmc0_d0",	"jtag_di",	"",			"",				"eint"),
+	F("mmc0_clk",	"uart0_rx",	"",			"",				"eint"),
+	F("mmc0_cmd",	"jtag_do",	"",			"",				"eint"),
+	F("mmc0_d3",	"uart0_tx",	"",			"",				"eint"),
+	F("mmc0_d2",	"jtag_ck",	"pwm1",		"",				"eint"),
+};
+
+static const uint8_t func_first[PIO_NPORTS] = { 0, 4, 8, 12, 34, 47 };
+
+_Static_assert(sizeof(func_names) / sizeof(func_names[0]) == 47 + 6, "func_first[] and the table disagree");
+
+// SoCs without name tables: every function of an implemented pin, by number
+static const char func_number[5][6] = { "func2", "func3", "func4", "func5", "func6" };
+
+const char *fagpio_pin_func_name(uint8_t pin, uint8_t func) {
+	uint8_t port = PIO_PIN_PORT(pin), n = PIO_PIN_NUM(pin);
+
+	if (n >= fagpio_port_pins(port) || func >= FAGPIO_PIN_FUNCS)
+		return NULL;
+	switch (func) {
+	case 0:		return "gpio_in";
+	case 1:		return "gpio_out";
+	case 7:		return "disabled";
+	default:	return !fagpio_soc()->func_names ? func_number[func - 2] :
+			*func_names[func_first[port] + n][func - 2] ? func_names[func_first[port] + n][func - 2] : NULL;
+	}
+}
+
+int fagpio_pin_func_find(uint8_t pin, const char *name) {
+	for (uint8_t func = 0; func < FAGPIO_PIN_FUNCS; func++) {
+		const char *f = fagpio_pin_func_name(pin, func);
+
+		if (f && !strcmp(f, name))
+			return func;
+	}
+	return -1;
+}
+
+int fagpio_pin_func_get(uint8_t pin) {
+	struct pio_bank *banks = fagpio_banks();
+	uint8_t port = PIO_PIN_PORT(pin), n = PIO_PIN_NUM(pin);
+
+	if (!banks || n >= fagpio_port_pins(port))
+		return -1;
+	return (banks[port].cfg[n >> 3] >> ((n & 7) * 4)) & 7;
+}
+
+int pinFunction(uint8_t pin, uint8_t fn) {
+	if (!fagpio_pin_func_name(pin, fn))
+		return -1;
+	return fagpio_pin_func(pin, fn);
+}
@@ -0,0 +1,31 @@
+#ifndef _FAGPIO_PINFUNC_H
+#define _FAGPIO_PINFUNC_H
+
+#include <stdint.h>
+#include "fagpio.h"
+
+/*
+ * F1C100s pin multiplexing: for every implemented pin, the peripheral
+ * signal behind CFG functions 2 to 6 (0 input, 1 output, 7 disabled), as
+ * in the datasheet's pin multiplexing table. Names are "block_signal" in
+ * lower case, such as "uart0_tx" or "spi1_clk"; function 6 on ports D, E
+ * and F is "eint". pinFunction() refuses a function the pin does not have.
+ * On other SoCs (fagpio_soc.h) functions 2 to 6 of every implemented pin
+ * are only numbered, "func2" to "func6", and none is refused.
+ */
+
+#define FAGPIO_PIN_FUNCS	8
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+const char *fagpio_pin_func_name(uint8_t pin, uint8_t func);	//"gpio_in", "gpio_out", "disabled" or the signal, NULL if none
+int fagpio_pin_func_find(uint8_t pin, const char *name);		//Function number of name on pin, -1 if absent
+int fagpio_pin_func_get(uint8_t pin);							//Current CFG function, -1 if not mapped
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
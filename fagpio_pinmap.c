@@ -0,0 +1,160 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "fagpio_priv.h"
+#include "fagpio_pinmap.h"
+#include "fagpio_log.h"
+#include "fagpio_soc.h"
+
+static inline uint32_t merge(uint32_t old, uint32_t value, uint32_t mask) {
+	return (old & ~mask) | (value & mask);
+}
+
+// 0 if the whole blob is a pin map for ports this SoC has, checked before anything is stored
+static int pinmap_check(const void *blob, size_t size) {
+	const struct fagpio_pinmap_header *hdr = blob;
+	const struct fagpio_pinmap_port *rec = (const void *)(hdr + 1);
+
+	if (size < sizeof(*hdr) || hdr->magic != FAGPIO_PINMAP_MAGIC || hdr->version != FAGPIO_PINMAP_VERSION)
+		return -1;
+	if (size < sizeof(*hdr) + hdr->nports * sizeof(*rec))
+		return -1;
+	for (unsigned int i = 0; i < hdr->nports; i++) {
+		if (!fagpio_port_pins(rec[i].port))
+			return -1;
+	}
+	return 0;
+}
+
+int fagpio_pinmap_apply(const void *blob, size_t size) {
+	const struct fagpio_pinmap_header *hdr = blob;
+	const struct fagpio_pinmap_port *rec = (const void *)(hdr + 1);
+	struct fagpio_bank_state state;
+
+	if (pinmap_check(blob, size) < 0)
+		return -1;
+
+	for (unsigned int i = 0; i < hdr->nports; i++, rec++) {
+		if (fagpio_bank_save(rec->port, &state) < 0)
+			return -1;
+		for (unsigned int w = 0; w < 4; w++)
+			state.cfg[w] = merge(state.cfg[w], rec->cfg[w], rec->cfg_mask[w]);
+		for (unsigned int w = 0; w < 2; w++) {
+			state.drv[w] = merge(state.drv[w], rec->drv[w], rec->drv_mask[w]);
+			state.pull[w] = merge(state.pull[w], rec->pull[w], rec->pull_mask[w]);
+		}
+		state.dat = merge(state.dat, rec->dat, rec->dat_mask);
+		fagpio_bank_restore(rec->port, &state);
+	}
+	return hdr->nports;
+}
+
+// Bit n set for every non-zero nibble n of x
+static uint32_t nibble_bits(uint32_t x) {
+	x = (x | (x >> 1) | (x >> 2) | (x >> 3)) & 0x11111111;
+	x = (x | (x >> 3)) & 0x03030303;
+	x = (x | (x >> 6)) & 0x000F000F;
+	return (x | (x >> 12)) & 0xFF;
+}
+
+/*
+Reload: the record is merged into a bank snapshot as above, but only the
+words that differ are stored, DAT, DRV and PULL before CFG. Untouched
+pins keep their bits in every word, so they see no glitch. DAT is only
+taken from the map for pins whose function changes: outputs that keep
+their role also keep the level they are driving.
+*/
+static int reload_port(struct pio_bank *bank, const struct fagpio_pinmap_port *rec) {
+	struct fagpio_bank_state old, new;
+	uint32_t changed = 0;
+	int stores = 0;
+
+	if (fagpio_bank_save(rec->port, &old) < 0)
+		return -1;
+	new = old;
+	for (unsigned int w = 0; w < 4; w++) {
+		new.cfg[w] = merge(old.cfg[w], rec->cfg[w], rec->cfg_mask[w]);
+		changed |= nibble_bits(new.cfg[w] ^ old.cfg[w]) << (w * 8);
+	}
+	for (unsigned int w = 0; w < 2; w++) {
+		new.drv[w] = merge(old.drv[w], rec->drv[w], rec->drv_mask[w]);
+		new.pull[w] = merge(old.pull[w], rec->pull[w], rec->pull_mask[w]);
+	}
+	new.dat = merge(old.dat, rec->dat, rec->dat_mask & changed);
+
+	if (new.dat != old.dat) {
+		bank->dat = new.dat;
+		fagpio_shadow_sync(rec->port);
+		stores++;
+	}
+	for (unsigned int w = 0; w < 2; w++) {
+		if (new.drv[w] != old.drv[w]) {
+			bank->drv[w] = new.drv[w];
+			stores++;
+		}
+		if (new.pull[w] != old.pull[w]) {
+			bank->pull[w] = new.pull[w];
+			stores++;
+		}
+	}
+	for (unsigned int w = 0; w < 4; w++) {
+		if (new.cfg[w] != old.cfg[w]) {
+			bank->cfg[w] = new.cfg[w];
+			stores++;
+		}
+	}
+	return stores;
+}
+
+int fagpio_pinmap_reload(const void *blob, size_t size) {
+	const struct fagpio_pinmap_header *hdr = blob;
+	const struct fagpio_pinmap_port *rec = (const void *)(hdr + 1);
+	struct pio_bank *banks = fagpio_banks();
+	int stores = 0;
+
+	if (!banks || pinmap_check(blob, size) < 0)
+		return -1;
+
+	for (unsigned int i = 0; i < hdr->nports; i++, rec++) {
+		int n = reload_port(&banks[rec->port], rec);
+
+		if (n < 0)
+			return -1;
+		stores += n;
+	}
+	return stores;
+}
+
+static int map_file(const char *path, int (*fn)(const void *, size_t)) {
+	struct stat st;
+	void *blob;
+	int fd, ret;
+
+	if ((fd = open(path, O_RDONLY|O_CLOEXEC)) < 0 || fstat(fd, &st) < 0) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "%s: %s\n", path, strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+	blob = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (blob == MAP_FAILED) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "%s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	if ((ret = fn(blob, st.st_size)) < 0)
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "%s: not a fagpio pin map\n", path);
+	munmap(blob, st.st_size);
+	return ret;
+}
+
+int fagpio_pinmap_load(const char *path) {
+	return map_file(path, fagpio_pinmap_apply);
+}
+
+int fagpio_pinmap_reload_file(const char *path) {
+	return map_file(path, fagpio_pinmap_reload);
+}
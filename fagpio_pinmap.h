@@ -0,0 +1,64 @@
+#ifndef _FAGPIO_PINMAP_H
+#define _FAGPIO_PINMAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Compiled board pin map. tools/pinmap turns a text description, one pin
+ * per line,
+ *
+ *	# pin	mode	options
+ *	PE3		output	drive=3 value=1
+ *	PE4		input	pull=up
+ *	PE12	func5	# raw CFG function, here PWM0
+ *
+ * into one record per port that holds every register word already merged
+ * with the mask of bits it owns. fagpio_pinmap_apply() then only merges
+ * the record into a bank snapshot and writes it back with
+ * fagpio_bank_restore() (DAT, DRV and PULL before CFG): one pass, no
+ * parsing. With FAGPIO_PINMAP=<file> in the environment, fagpio_setup()
+ * maps the file and applies it. The blob is little endian, like the SoC.
+ */
+
+#define FAGPIO_PINMAP_MAGIC		0x4D504746		//"FGPM"
+#define FAGPIO_PINMAP_VERSION	1
+
+struct fagpio_pinmap_header {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t nports;		//Records that follow
+};
+
+struct fagpio_pinmap_port {
+	uint8_t port;
+	uint8_t pad[3];
+	uint32_t cfg[4], cfg_mask[4];
+	uint32_t drv[2], drv_mask[2];
+	uint32_t pull[2], pull_mask[2];
+	uint32_t dat, dat_mask;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fagpio_pinmap_apply(const void *blob, size_t size);	//Ports configured, -1 for a bad blob
+int fagpio_pinmap_load(const char *path);					//mmap()s path and applies it
+
+/*
+ * Reconfiguration of a running system: the map is diffed against the live
+ * banks and only the CFG, DRV, PULL and DAT words that change are stored,
+ * one store per word, DAT/DRV/PULL before CFG. Pins the map leaves alone
+ * keep their bits, and DAT values only apply to pins whose function
+ * changes. Returns the number of register stores, -1 for a bad blob
+ * (nothing written).
+ */
+int fagpio_pinmap_reload(const void *blob, size_t size);
+int fagpio_pinmap_reload_file(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,24 @@
+#include <string.h>
+#include "fagpio_pinname.h"
+#include "fagpio_soc.h"
+
+int fagpio_pin_parse(const char *name) {
+	int pin = name ? fagpio_pin_parse_n(name, strlen(name)) : -1;
+
+	return pin >= 0 && PIO_PIN_NUM(pin) < fagpio_port_pins(PIO_PIN_PORT(pin)) ? pin : -1;
+}
+
+const char *fagpio_pin_name(uint8_t pin, char buf[5]) {
+	unsigned int port = PIO_PIN_PORT(pin), num = PIO_PIN_NUM(pin);
+	char *p = buf;
+
+	if (num >= fagpio_port_pins(port))
+		return NULL;
+	*p++ = 'P';
+	*p++ = 'A' + port;
+	if (num >= 10)
+		*p++ = '0' + num / 10;
+	*p++ = '0' + num % 10;
+	*p = '\0';
+	return buf;
+}
@@ -0,0 +1,64 @@
+#ifndef _FAGPIO_PINNAME_H
+#define _FAGPIO_PINNAME_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fagpio.h"
+
+/*
+ * Pin names as in the datasheet and in configs: "PE3", "PD12", also
+ * "pe3", "E3" and "PE03". The name itself is the key: port letter * 32 +
+ * number is collision free and equals the PIO_PIN() numbering, so parsing
+ * is a few compares and one check against PIO_PORT_MAXPINS(), with no table
+ * to search. That accepts the pins of any supported SoC; fagpio_pin_parse()
+ * and fagpio_pin_name() also check the detected one (fagpio_soc.h).
+ * fagpio_pin_parse_n() is constexpr under C++, where fagpio::operator""_pin
+ * (fagpio.hpp) turns literals into pin numbers at compile time; parse
+ * config strings once at startup and keep the number.
+ */
+
+#define FAGPIO_NO_PIN		0xFF
+
+#ifdef __cplusplus
+#define FAGPIO_PIN_CONSTEXPR	constexpr
+#else
+#define FAGPIO_PIN_CONSTEXPR
+#endif
+
+// Pin number of the first len characters of name, -1 unless they are exactly one implemented pin
+static inline FAGPIO_PIN_CONSTEXPR int fagpio_pin_parse_n(const char *name, size_t len) {
+	size_t i = 0;
+	unsigned int port = 0, num = 0, digits = 0;
+
+	if (i < len && (name[i] == 'P' || name[i] == 'p') && len > 2)
+		i++;
+	if (i == len)
+		return -1;
+	if (name[i] >= 'A' && name[i] <= 'Z')
+		port = name[i] - 'A';
+	else if (name[i] >= 'a' && name[i] <= 'z')
+		port = name[i] - 'a';
+	else
+		return -1;
+	for (i++; i < len; i++, digits++) {
+		if (name[i] < '0' || name[i] > '9' || digits == 2)
+			return -1;
+		num = num * 10 + (name[i] - '0');
+	}
+	if (!digits || port >= PIO_NPORTS || num >= PIO_PORT_MAXPINS(port))
+		return -1;
+	return PIO_PIN(port, num);
+}
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fagpio_pin_parse(const char *name);		//NUL-terminated, see fagpio_pin_parse_n()
+const char *fagpio_pin_name(uint8_t pin, char buf[5]);	//"PE3" into buf, NULL for no such pin
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef _FAGPIO_PRIV_H
+#define _FAGPIO_PRIV_H
+
+/*
+ * Internal glue between the library's source files, not installed with
+ * fagpio.h.
+ */
+
+#include <pthread.h>
+#include "fagpio.h"
+#include "fagpio_trace.h"
+#include "fagpio_stats.h"
+#include "fagpio_probe.h"
+
+// Redirects the per-port DAT shadows, already seeded, e.g. into shared memory, and turns shadow mode on; NULL restores the private ones
+void fagpio_shadow_bind(volatile uint32_t *shadows);
+
+// Selects CFG function func (0-7, 7 disables the pin); -1 for an unimplemented pin
+int fagpio_pin_func(uint8_t pin, uint8_t func);
+
+// Number N of the /dev/uioN whose sysfs name matches, -1 if none
+int fagpio_uio_find(const char *name);
+
+// Port-level calls of a backend without a register mapping (chip, daemon)
+struct fagpio_ops {
+	int (*open)(void);
+	int (*pin_mode)(uint8_t port, uint32_t mask, int output);
+	int (*write_port)(uint8_t port, uint32_t mask, uint32_t value);
+	uint32_t (*read_port)(uint8_t port);
+	void (*close)(void);
+};
+
+// FAGPIO_BACKEND=daemon, fagpio_daemon.c
+int fagpio_daemon_open(void);
+int fagpio_daemon_pin_mode(uint8_t port, uint32_t mask, int output);
+int fagpio_daemon_write_port(uint8_t port, uint32_t mask, uint32_t value);
+uint32_t fagpio_daemon_read_port(uint8_t port);
+void fagpio_daemon_close(void);
+
+// FAGPIO_BACKEND=sim window, fagpio_sim.c
+int fagpio_sim_map(struct cpu_peripheral *p);
+void fagpio_sim_unmap(struct cpu_peripheral *p);
+
+// Bytes fagpio_region() mapped outside the window, fagpio_region.c
+unsigned long fagpio_region_mapped(void);
+
+/*
+ * An engine's buffers: from its arena when it was given one, from
+ * fagpio_mem_alloc() otherwise (fagpio_mem.c). Giving back an arena block
+ * does nothing; the arena is released to a mark or reset as a whole.
+ */
+struct fagpio_arena;
+void *fagpio_mem_take(struct fagpio_arena *a, size_t size, size_t align);
+void fagpio_mem_give(struct fagpio_arena *a, void *p);
+
+/*
+ * Pending updates of one port, folded so that a batch of writes and toggles
+ * costs one store: ((DAT & ~mask) | value) ^ toggle, touching only the bits
+ * in mask | toggle. Used by the command servers (fagpiod, UDP), which hold
+ * fagpio_server_lock around each batch so they may run side by side.
+ */
+extern pthread_mutex_t fagpio_server_lock;
+
+struct fagpio_coalesce {
+	uint32_t mask;
+	uint32_t value;
+	uint32_t toggle;
+};
+
+static inline void fagpio_coalesce_write(struct fagpio_coalesce *q, uint32_t mask, uint32_t value) {
+	q->value = (q->value & ~mask) | (value & mask);
+	q->mask |= mask;
+	q->toggle &= ~mask;
+}
+
+static inline void fagpio_coalesce_toggle(struct fagpio_coalesce *q, uint32_t mask) {
+	q->toggle ^= mask;
+}
+
+// 1 if a store was issued
+static inline int fagpio_coalesce_flush(struct fagpio_coalesce *q, uint8_t port) {
+	uint32_t bits = q->mask | q->toggle;
+
+	if (!bits)
+		return 0;
+	digitalWritePort(port, bits, ((digitalReadPort(port) & ~q->mask) | q->value) ^ q->toggle);
+	q->mask = q->value = q->toggle = 0;
+	return 1;
+}
+
+// Applies an armed fail-safe map (fagpio_failsafe.h) before the registers are unmapped
+void fagpio_failsafe_on_free(void);
+
+// Counter hooks of the Arduino-style calls, see fagpio_stats.h
+enum { FAGPIO_STAT_WRITE, FAGPIO_STAT_READ, FAGPIO_STAT_MODE };
+
+extern struct fagpio_stats *fagpio_stats_page;
+void fagpio_stat_pin(uint32_t start, uint8_t pin, int kind);
+void fagpio_stat_port(uint32_t start, uint8_t port, uint32_t mask, int kind);
+
+#define FAGPIO_STATS_ON		(FAGPIO_STATS && fagpio_stats_page)
+#define FAGPIO_STAT_START()	(FAGPIO_STATS_ON ? fagpio_ticks() : 0)
+#define FAGPIO_STAT_PIN(start, pin, kind)	do { \
+		if (FAGPIO_STATS_ON) \
+			fagpio_stat_pin(start, pin, kind); \
+	} while (0)
+#define FAGPIO_STAT_PORT(start, port, mask, kind)	do { \
+		if (FAGPIO_STATS_ON) \
+			fagpio_stat_port(start, port, mask, kind); \
+	} while (0)
+
+// Trace hooks of the entry points, see fagpio_trace.h
+extern volatile uint8_t fagpio_tracing;
+void fagpio_trace_record(uint8_t op, uint8_t pin, uint16_t value);
+void fagpio_trace_port(uint8_t op, uint8_t port, uint32_t changed, uint32_t dat, uint32_t ticks);
+
+#define FAGPIO_TRACE_OP(op, pin, value)	do { \
+		if (FAGPIO_TRACE && fagpio_tracing) \
+			fagpio_trace_record(op, pin, value); \
+	} while (0)
+
+// One record per pin in changed, with its level in dat, all stamped ticks
+#define FAGPIO_TRACE_PORT(op, port, changed, dat, ticks)	do { \
+		if (FAGPIO_TRACE && fagpio_tracing && (changed)) \
+			fagpio_trace_port(op, port, changed, dat, ticks); \
+	} while (0)
+
+/*
+Bit-bang kernels whose loops need more live values than Thumb-1's eight
+low registers stay in ARM state in the Thumb build (make thumb); in the
+ARM build this is empty.
+*/
+#if defined(__arm__) && defined(__thumb__)
+#define FAGPIO_ARM_CODE		__attribute__((target("arm")))
+#else
+#define FAGPIO_ARM_CODE
+#endif
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef _FAGPIO_PROBE_H
+#define _FAGPIO_PROBE_H
+
+/*
+ * USDT (user-level statically defined tracing) probes, the format of
+ * SystemTap's <sys/sdt.h>: each probe is a single NOP in the code and an
+ * ELF note (.note.stapsdt) naming it and saying where its arguments are.
+ * Nothing runs until a tracer puts a breakpoint on the NOP, so the probes
+ * stay in release builds. The toolchain ships no <sys/sdt.h>, so the note
+ * is emitted here; perf, bpftrace and SystemTap read it as theirs:
+ *
+ *	perf buildid-cache --add libfagpio.so
+ *	perf probe sdt_fagpio:port_write && perf record -e sdt_fagpio:port_write
+ *	bpftrace -e 'usdt:./libfagpio.so:fagpio:pin_mode { printf("%d %d\n", arg0, arg1); }'
+ *
+ * Provider "fagpio":
+ *	setup_start, setup_done(ret)
+ *	pin_mode(pin, mode), port_mode(port, mask, mode)
+ *	pin_write(pin, value), port_write(port, mask, value), port_toggle(port, mask)
+ *	eint_wait(port, timeout_ms), eint_done(port, pending)
+ *	spi_start(bus, len), spi_done(bus, ret)			(fagpio_spi.h)
+ *	twi_start(bus, count), twi_done(bus, done)		(fagpio_twi.h)
+ *	bbspi_start(spi, len), bbspi_done(spi)			(fagpio_bbspi.h)
+ *	bbi2c_start(bus, count), bbi2c_done(bus, done)	(fagpio_bbi2c.h)
+ * Arguments are passed as longs. Build the library with -DFAGPIO_USDT=0
+ * to leave the probes out; they are only emitted for GCC-compatible ELF
+ * targets.
+ */
+
+#ifndef FAGPIO_USDT
+#if defined(__GNUC__) && defined(__ELF__)
+#define FAGPIO_USDT		1
+#else
+#define FAGPIO_USDT		0
+#endif
+#endif
+
+#if FAGPIO_USDT
+
+#define FAGPIO_SDT_S(x)		#x
+#define FAGPIO_SDT_STR(x)	FAGPIO_SDT_S(x)
+#define FAGPIO_SDT_ADDR		"." FAGPIO_SDT_STR(__SIZEOF_POINTER__) "byte "
+#define FAGPIO_SDT_ARG(n)	"-" FAGPIO_SDT_STR(__SIZEOF_LONG__) "@%" #n
+
+// The NOP, its note, and the .stapsdt.base anchor tracers use to relocate pc
+#define FAGPIO_SDT_NOTE(name, args) \
+	"990:	nop\n" \
+	"	.pushsection .note.stapsdt,\"?\",\"note\"\n" \
+	"	.balign 4\n" \
+	"	.4byte 992f-991f, 994f-993f, 3\n" \
+	"991:	.asciz \"stapsdt\"\n" \
+	"992:	.balign 4\n" \
+	"993:	" FAGPIO_SDT_ADDR "990b\n" \
+	"	" FAGPIO_SDT_ADDR "_.stapsdt.base\n" \
+	"	" FAGPIO_SDT_ADDR "0\n" \
+	"	.asciz \"fagpio\"\n" \
+	"	.asciz \"" #name "\"\n" \
+	"	.asciz \"" args "\"\n" \
+	"994:	.balign 4\n" \
+	"	.popsection\n" \
+	"	.ifndef _.stapsdt.base\n" \
+	"	.pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n" \
+	"	.weak _.stapsdt.base\n" \
+	"	.hidden _.stapsdt.base\n" \
+	"_.stapsdt.base:	.space 1\n" \
+	"	.size _.stapsdt.base, 1\n" \
+	"	.popsection\n" \
+	"	.endif\n"
+
+#define FAGPIO_PROBE0(name) \
+	__asm__ __volatile__(FAGPIO_SDT_NOTE(name, ""))
+#define FAGPIO_PROBE1(name, a) \
+	__asm__ __volatile__(FAGPIO_SDT_NOTE(name, FAGPIO_SDT_ARG(0)) \
+		:: "nor"((long)(a)))
+#define FAGPIO_PROBE2(name, a, b) \
+	__asm__ __volatile__(FAGPIO_SDT_NOTE(name, FAGPIO_SDT_ARG(0) " " FAGPIO_SDT_ARG(1)) \
+		:: "nor"((long)(a)), "nor"((long)(b)))
+#define FAGPIO_PROBE3(name, a, b, c) \
+	__asm__ __volatile__(FAGPIO_SDT_NOTE(name, FAGPIO_SDT_ARG(0) " " FAGPIO_SDT_ARG(1) " " FAGPIO_SDT_ARG(2)) \
+		:: "nor"((long)(a)), "nor"((long)(b)), "nor"((long)(c)))
+
+#else
+
+#define FAGPIO_PROBE0(name)				do { } while (0)
+#define FAGPIO_PROBE1(name, a)			do { (void)(a); } while (0)
+#define FAGPIO_PROBE2(name, a, b)		do { (void)(a); (void)(b); } while (0)
+#define FAGPIO_PROBE3(name, a, b, c)	do { (void)(a); (void)(b); (void)(c); } while (0)
+
+#endif
+
+#endif
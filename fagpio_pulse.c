@@ -0,0 +1,141 @@
+#include <poll.h>
+#include <string.h>
+#include "fagpio_pulse.h"
+#include "fagpio_notify.h"
+#include "fagpio_timer.h"
+#include "fagpio_soc.h"
+
+static uint32_t us_to_ticks(unsigned long us) {
+	uint64_t ticks = (uint64_t)us * fagpio_tick_hz / 1000000;
+
+	return ticks < 0x7FFFFFFF ? (uint32_t)ticks : 0x7FFFFFFF;
+}
+
+unsigned long pulseIn(uint8_t pin, uint8_t level, unsigned long timeout_us) {
+	struct pio_bank *banks = fagpio_banks();
+	uint8_t port = PIO_PIN_PORT(pin);
+	uint32_t mask = PIO_PIN_MASK(pin), want = level ? mask : 0;
+
+	if (!banks || port >= PIO_NPORTS)
+		return 0;
+
+	volatile uint32_t *dat = &banks[port].dat;
+	uint32_t timeout = us_to_ticks(timeout_us ? timeout_us : 1000000);
+	uint32_t start = fagpio_ticks(), t0, t1;
+
+	while ((*dat & mask) == want)		//Let a pulse already in progress pass
+		if (fagpio_ticks() - start > timeout)
+			return 0;
+	while ((*dat & mask) != want)
+		if (fagpio_ticks() - start > timeout)
+			return 0;
+	t0 = fagpio_ticks();
+	while ((*dat & mask) == want)
+		if ((t1 = fagpio_ticks()) - start > timeout)
+			return 0;
+	t1 = fagpio_ticks();
+
+	return fagpio_ticks_to_ns(t1 - t0) / 1000;
+}
+
+void fagpio_freq_init(struct fagpio_freq *f) {
+	memset(f, 0, sizeof(*f));
+}
+
+int fagpio_freq_add(struct fagpio_freq *f, uint8_t pin) {
+	if (f->count == FAGPIO_FREQ_MAX || PIO_PIN_PORT(pin) >= PIO_NPORTS)
+		return -1;
+	pinMode(pin, 1);
+	f->pins[f->count] = pin;
+	return f->count++;
+}
+
+static void freq_edge(struct fagpio_freq *f, unsigned int ch, uint32_t now) {
+	if (!f->edges[ch]++)
+		f->first[ch] = now;
+	f->last[ch] = now;
+}
+
+static int freq_eint(struct fagpio_freq *f, unsigned int gate_ms) {
+	struct pollfd pfd = { .fd = fagpio_notify_fd(), .events = POLLIN };
+	uint32_t changed[PIO_NPORTS];
+
+	if (pfd.fd < 0)
+		return -1;
+	for (unsigned int ch = 0; ch < f->count; ch++) {
+		if (fagpio_notify_watch(f->pins[ch], RISING) < 0)
+			return -1;
+	}
+	fagpio_notify_read(changed);		//Drop edges from before the window
+
+	uint32_t start = fagpio_ticks(), gate = us_to_ticks(gate_ms * 1000ul);
+
+	for (;;) {
+		uint32_t elapsed = fagpio_ticks() - start;
+
+		if (elapsed >= gate)
+			break;
+		if (poll(&pfd, 1, (fagpio_ticks_to_ns(gate - elapsed) + 999999) / 1000000) <= 0)
+			continue;
+
+		uint32_t now = fagpio_ticks();
+
+		fagpio_notify_read(changed);
+		for (unsigned int ch = 0; ch < f->count; ch++) {
+			if (changed[PIO_PIN_PORT(f->pins[ch])] & PIO_PIN_MASK(f->pins[ch]))
+				freq_edge(f, ch, now);
+		}
+	}
+	return 0;
+}
+
+static void freq_poll(struct fagpio_freq *f, unsigned int gate_ms) {
+	uint32_t mask[PIO_NPORTS] = { 0 }, prev[PIO_NPORTS];
+	uint32_t start = fagpio_ticks(), gate = us_to_ticks(gate_ms * 1000ul), now;
+
+	for (unsigned int ch = 0; ch < f->count; ch++)
+		mask[PIO_PIN_PORT(f->pins[ch])] |= PIO_PIN_MASK(f->pins[ch]);
+	for (uint8_t port = 0; port < PIO_NPORTS; port++)
+		prev[port] = mask[port] ? digitalReadPort(port) : 0;
+
+	while ((now = fagpio_ticks()) - start < gate) {
+		for (uint8_t port = 0; port < PIO_NPORTS; port++) {
+			if (!mask[port])
+				continue;
+
+			uint32_t v = digitalReadPort(port);
+			uint32_t rise = v & ~prev[port] & mask[port];
+
+			prev[port] = v;
+			for (unsigned int ch = 0; rise && ch < f->count; ch++) {
+				if (PIO_PIN_PORT(f->pins[ch]) == port && (rise & PIO_PIN_MASK(f->pins[ch])))
+					freq_edge(f, ch, now);
+			}
+		}
+	}
+}
+
+int fagpio_freq_measure(struct fagpio_freq *f, unsigned int gate_ms) {
+	int eint = f->count > 0;
+
+	if (!f->count || !gate_ms)
+		return -1;
+	memset(f->edges, 0, sizeof(f->edges));
+	for (unsigned int ch = 0; ch < f->count; ch++) {
+		if (fagpio_soc_eint_bank(PIO_PIN_PORT(f->pins[ch])) < 0)
+			eint = 0;
+	}
+
+	f->eint = eint && freq_eint(f, gate_ms) == 0;
+	if (!f->eint) {
+		memset(f->edges, 0, sizeof(f->edges));
+		freq_poll(f, gate_ms);
+	}
+	return 0;
+}
+
+double fagpio_freq_hz(const struct fagpio_freq *f, unsigned int ch) {
+	if (ch >= f->count || f->edges[ch] < 2 || f->last[ch] == f->first[ch])
+		return 0;
+	return (double)(f->edges[ch] - 1) * fagpio_tick_hz / (uint32_t)(f->last[ch] - f->first[ch]);
+}
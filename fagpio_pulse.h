@@ -0,0 +1,49 @@
+#ifndef _FAGPIO_PULSE_H
+#define _FAGPIO_PULSE_H
+
+#include <stdint.h>
+#include "fagpio.h"
+
+/*
+ * Pulse width and frequency measurement on the AVS counter.
+ *
+ * pulseIn() polls the pin's DAT register and timestamps both edges with
+ * the counter, which resolves ~42 ns at 24 MHz; an interrupt wake-up
+ * would add tens of microseconds of latency to each edge.
+ *
+ * The frequency counter measures many pins in one gate window. When every
+ * pin is on an EINT port (PD/PE/PF on the F1C100s) with a UIO interrupt
+ * node, the window is spent in a single wait on fagpio_notify_fd() and
+ * costs no CPU. Edges closer than
+ * the wake-up latency then merge, so this suits inputs up to a few kHz.
+ * Otherwise the used ports are polled for the whole window.
+ */
+
+#define FAGPIO_FREQ_MAX		16
+
+struct fagpio_freq {
+	unsigned int count;
+	uint8_t pins[FAGPIO_FREQ_MAX];
+	uint32_t edges[FAGPIO_FREQ_MAX];	//Rising edges in the last window
+	uint32_t first[FAGPIO_FREQ_MAX];	//Counter at the first and last of them
+	uint32_t last[FAGPIO_FREQ_MAX];
+	uint8_t eint;						//Last window used interrupts
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Length in us of the next pulse at level, 0 on timeout (0 selects one second)
+unsigned long pulseIn(uint8_t pin, uint8_t level, unsigned long timeout_us);
+
+void fagpio_freq_init(struct fagpio_freq *f);
+int fagpio_freq_add(struct fagpio_freq *f, uint8_t pin);		//Channel index
+int fagpio_freq_measure(struct fagpio_freq *f, unsigned int gate_ms);
+double fagpio_freq_hz(const struct fagpio_freq *f, unsigned int ch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
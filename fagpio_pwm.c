@@ -0,0 +1,164 @@
+#include "fagpio_priv.h"
+#include "fagpio_pwm.h"
+#include "fagpio_region.h"
+#include "fagpio_timer.h"
+#include "fagpio_log.h"
+
+// Per-channel fields of PWM_CTRL start at bit 15 * channel
+#define PWM_PRESCAL_MASK	0xFu
+#define PWM_EN				(1u << 4)
+#define PWM_ACT_HIGH		(1u << 5)
+#define PWM_CLK_GATING		(1u << 6)
+#define PWM_MODE_PULSE		(1u << 7)
+#define PWM_PUL_START		(1u << 8)		//Cleared by the block when the pulse ends
+#define PWM_CH_SHIFT(ch)	((ch) * 15)
+#define PWM_PERIOD_RDY(ch)	(1u << (28 + (ch)))
+
+// PRESCAL encodings in increasing divider order
+static const struct {
+	uint8_t code;
+	uint32_t div;
+} prescalers[] = {
+	{ 15, 1 }, { 0, 120 }, { 1, 180 }, { 2, 240 }, { 3, 360 }, { 4, 480 },
+	{ 8, 12000 }, { 9, 24000 }, { 10, 36000 }, { 11, 48000 }, { 12, 72000 },
+};
+
+static struct {
+	uint32_t cycles;	//Entire cycles of one period
+	uint32_t range;
+	uint8_t pulse;		//Pulse mode, see pwmPulseSetup()
+} channels[PWM_CHANNELS];
+
+static void pwm_set_period(volatile uint32_t *pwm, uint8_t channel, uint32_t active) {
+	for (int i = 0; i < 100000 && (pwm[rPWM_CTRL / 4] & PWM_PERIOD_RDY(channel)); i++)
+		;		//The register is busy until the previous value is latched
+	pwm[rPWM_CH_PERIOD(channel) / 4] = ((channels[channel].cycles - 1) << 16) | active;
+}
+
+int pwmSetup(uint8_t channel, uint32_t freq_hz, uint32_t range) {
+	struct pio_bank *banks = fagpio_banks();		//Sets up on demand, before the region lookup
+	volatile uint32_t *pwm = fagpio_region(FAGPIO_REGION_PWM);
+	unsigned int i;
+
+	if (channel >= PWM_CHANNELS || !freq_hz || !range || !pwm || !banks)
+		return -1;
+
+	for (i = 0; i < sizeof(prescalers) / sizeof(prescalers[0]); i++) {
+		if (PWM_CLOCK_HZ / prescalers[i].div / freq_hz <= 0x10000)
+			break;
+	}
+	if (i == sizeof(prescalers) / sizeof(prescalers[0])) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "PWM%u: %u Hz is too slow\n", channel, freq_hz);
+		return -1;
+	}
+
+	uint32_t cycles = PWM_CLOCK_HZ / prescalers[i].div / freq_hz;
+
+	if (cycles < 2) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "PWM%u: %u Hz is too fast\n", channel, freq_hz);
+		return -1;
+	}
+	channels[channel].cycles = cycles;
+	channels[channel].range = range;
+	channels[channel].pulse = 0;
+
+	fagpio_pin_func(channel ? PWM1_PIN : PWM0_PIN, channel ? PWM1_PIN_FUNC : PWM0_PIN_FUNC);
+
+	uint32_t ctrl = pwm[rPWM_CTRL / 4] & ~(0x7FFFu << PWM_CH_SHIFT(channel));
+
+	pwm[rPWM_CTRL / 4] = ctrl | ((prescalers[i].code | PWM_ACT_HIGH) << PWM_CH_SHIFT(channel));
+	pwm_set_period(pwm, channel, 0);
+	pwm[rPWM_CTRL / 4] |= (PWM_EN | PWM_CLK_GATING) << PWM_CH_SHIFT(channel);
+	FAGPIO_LOG(FAGPIO_LOG_INFO, "PWM%u: prescaler %u, %u cycles\n", channel, prescalers[i].div, cycles);
+	return 0;
+}
+
+void pwmWrite(uint8_t channel, uint32_t value) {
+	volatile uint32_t *pwm = fagpio_region(FAGPIO_REGION_PWM);
+
+	if (channel >= PWM_CHANNELS || !pwm || !channels[channel].range || channels[channel].pulse)
+		return;
+	if (value > channels[channel].range)
+		value = channels[channel].range;
+	pwm_set_period(pwm, channel, (uint32_t)((uint64_t)value * channels[channel].cycles / channels[channel].range));
+}
+
+void pwmStop(uint8_t channel) {
+	volatile uint32_t *pwm = fagpio_region(FAGPIO_REGION_PWM);
+
+	if (channel >= PWM_CHANNELS || !pwm)
+		return;
+	pwm[rPWM_CTRL / 4] &= ~((PWM_EN | PWM_CLK_GATING) << PWM_CH_SHIFT(channel));
+	channels[channel].range = 0;
+	channels[channel].pulse = 0;
+}
+
+int pwmPulseSetup(uint8_t channel, uint32_t width_ns) {
+	struct pio_bank *banks = fagpio_banks();
+	volatile uint32_t *pwm = fagpio_region(FAGPIO_REGION_PWM);
+	uint64_t width = (uint64_t)width_ns * (PWM_CLOCK_HZ / 1000000);	//24 MHz cycles * 1000
+	unsigned int i;
+
+	if (channel >= PWM_CHANNELS || !width_ns || !pwm || !banks)
+		return -1;
+
+	// Finest prescaler that fits the width, one cycle short of the 16-bit period
+	for (i = 0; i < sizeof(prescalers) / sizeof(prescalers[0]); i++) {
+		if (width / 1000 / prescalers[i].div < 0xFFFF)
+			break;
+	}
+	if (i == sizeof(prescalers) / sizeof(prescalers[0]))
+		return -1;
+
+	uint32_t active = (width / prescalers[i].div + 500) / 1000;
+
+	if (!active)
+		active = 1;
+	channels[channel].cycles = active + 1;
+	channels[channel].range = 0;
+	channels[channel].pulse = 1;
+
+	fagpio_pin_func(channel ? PWM1_PIN : PWM0_PIN, channel ? PWM1_PIN_FUNC : PWM0_PIN_FUNC);
+
+	uint32_t ctrl = pwm[rPWM_CTRL / 4] & ~(0x7FFFu << PWM_CH_SHIFT(channel));
+
+	pwm[rPWM_CTRL / 4] = ctrl | ((prescalers[i].code | PWM_ACT_HIGH | PWM_MODE_PULSE) << PWM_CH_SHIFT(channel));
+	pwm_set_period(pwm, channel, active);
+	pwm[rPWM_CTRL / 4] |= (PWM_EN | PWM_CLK_GATING) << PWM_CH_SHIFT(channel);
+	FAGPIO_LOG(FAGPIO_LOG_INFO, "PWM%u: %u ns pulses, prescaler %u, %u cycles\n", channel, width_ns, prescalers[i].div, active);
+	return 0;
+}
+
+int pwmPulseBusy(uint8_t channel) {
+	volatile uint32_t *pwm = fagpio_region(FAGPIO_REGION_PWM);
+
+	if (channel >= PWM_CHANNELS || !pwm)
+		return 0;
+	return (pwm[rPWM_CTRL / 4] & (PWM_PUL_START << PWM_CH_SHIFT(channel))) ? 1 : 0;
+}
+
+int pwmPulse(uint8_t channel) {
+	volatile uint32_t *pwm = fagpio_region(FAGPIO_REGION_PWM);
+
+	if (channel >= PWM_CHANNELS || !pwm || !channels[channel].pulse)
+		return -1;
+
+	uint32_t ctrl = pwm[rPWM_CTRL / 4];
+	uint32_t start = PWM_PUL_START << PWM_CH_SHIFT(channel);
+
+	if (ctrl & start)
+		return 1;
+	// A START bit read as set may clear before the store: writing it back would fire that channel again
+	for (uint8_t ch = 0; ch < PWM_CHANNELS; ch++)
+		ctrl &= ~(PWM_PUL_START << PWM_CH_SHIFT(ch));
+	pwm[rPWM_CTRL / 4] = ctrl | start;
+	return 0;
+}
+
+int pwmPulseAt(uint8_t channel, uint32_t ticks) {
+	if (channel >= PWM_CHANNELS || !channels[channel].pulse)
+		return -1;
+	while ((int32_t)(fagpio_ticks() - ticks) < 0)
+		;
+	return pwmPulse(channel);
+}
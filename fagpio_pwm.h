@@ -0,0 +1,50 @@
+#ifndef _FAGPIO_PWM_H
+#define _FAGPIO_PWM_H
+
+#include <stdint.h>
+#include "fagpio.h"
+
+/*
+ * Hardware PWM on the two channels of the PWM block (0x01C21000, inside
+ * the window mapped by fagpio_setup()). pwmSetup() muxes the channel's pin,
+ * picks the smallest 24 MHz prescaler that fits the period into 16 bits
+ * and starts the channel; pwmWrite() then only rewrites the period
+ * register. The waveform runs without any CPU time.
+ *
+ * In pulse mode a channel idles low and emits one high pulse of the set
+ * width each time pwmPulse() arms it. The width is counted by the PWM
+ * clock (42 ns steps up to 2.7 ms), so an interrupt landing on the CPU
+ * cannot stretch it; arming returns at once, and pwmPulseAt() spins only
+ * until the start tick.
+ */
+
+#define rPWM_CTRL			0x00
+#define rPWM_CH_PERIOD(ch)	(0x04 + (ch) * 4)
+
+#define PWM_CHANNELS		2
+#define PWM_CLOCK_HZ		24000000
+
+#define PWM0_PIN			PIO_PIN(PIO_PORT_E, 12)
+#define PWM1_PIN			PIO_PIN(PIO_PORT_E, 6)
+#define PWM0_PIN_FUNC		4		//CFG function of PWM0 on PE12
+#define PWM1_PIN_FUNC		3		//and of PWM1 on PE6
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 0 on success; duty values for pwmWrite() run from 0 to range
+int pwmSetup(uint8_t channel, uint32_t freq_hz, uint32_t range);
+void pwmWrite(uint8_t channel, uint32_t value);
+void pwmStop(uint8_t channel);
+
+int pwmPulseSetup(uint8_t channel, uint32_t width_ns);	//Switches the channel to pulse mode
+int pwmPulse(uint8_t channel);							//0 armed, 1 if the previous pulse is still running
+int pwmPulseBusy(uint8_t channel);
+int pwmPulseAt(uint8_t channel, uint32_t ticks);		//Arms when fagpio_ticks() reaches ticks
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,147 @@
+#include <string.h>
+#include "fagpio_rc.h"
+#include "fagpio_atomic.h"
+#include "fagpio_eint.h"
+#include "fagpio_uart.h"
+#include "fagpio_timer.h"
+
+void fagpio_rc_publish(struct fagpio_rc_out *o, const struct fagpio_rc_frame *f) {
+	o->seq++;
+	fagpio_barrier();
+	memcpy(&o->frame, f, sizeof(*f));
+	fagpio_barrier();
+	o->seq++;
+	o->frames++;
+}
+
+int fagpio_rc_read(const struct fagpio_rc_out *o, struct fagpio_rc_frame *f) {
+	uint32_t seq;
+
+	do {
+		while ((seq = o->seq) & 1)
+			;		//A frame copy is a few dozen stores
+		fagpio_barrier();
+		memcpy(f, &o->frame, sizeof(*f));
+		fagpio_barrier();
+	} while (o->seq != seq);
+	return seq ? 0 : -1;
+}
+
+int fagpio_rc_ppm_init(struct fagpio_rc_ppm *p, uint8_t pin) {
+	memset(p, 0, sizeof(*p));
+	p->pin = pin;
+	p->n = 0xFF;
+	fagpio_ring_init(&p->ring);
+	pinMode(pin, INPUT);
+	return attachInterrupt(pin, RISING) < 0 ? -1 : 0;
+}
+
+int fagpio_rc_ppm_feed(struct fagpio_rc_ppm *p, uint32_t ticks) {
+	uint32_t d = ticks - p->last;
+	uint32_t us = d >= fagpio_ns_to_ticks(100000000) ? 100000 : fagpio_ticks_to_ns(d) / 1000;
+	int done = 0;
+
+	p->last = ticks;
+	if (us > FAGPIO_PPM_SYNC_US) {
+		if (p->n != 0xFF && p->n >= 4) {
+			struct fagpio_rc_frame f;
+
+			memset(&f, 0, sizeof(f));
+			memcpy(f.ch, p->ch, p->n * sizeof(p->ch[0]));
+			f.count = p->n;
+			f.ticks = ticks;
+			fagpio_rc_publish(&p->out, &f);
+			done = 1;
+		}
+		p->n = 0;
+	} else if (p->n != 0xFF) {
+		if (us < FAGPIO_PPM_MIN_US || us > FAGPIO_PPM_MAX_US || p->n == FAGPIO_RC_CHANNELS)
+			p->n = 0xFF;		//Lost an edge: wait for the next sync
+		else
+			p->ch[p->n++] = us;
+	}
+	return done;
+}
+
+// A negative timeout_ms waits forever
+int fagpio_rc_ppm_poll(struct fagpio_rc_ppm *p, int timeout_ms) {
+	struct fagpio_event ev[16];
+	unsigned int n;
+	int frames = 0;
+
+	fagpio_eint_wait_ring(PIO_PIN_PORT(p->pin), timeout_ms, &p->ring);
+	while ((n = fagpio_ring_pop(&p->ring, ev, 16))) {
+		for (unsigned int i = 0; i < n; i++)
+			frames += fagpio_rc_ppm_feed(p, ev[i].ticks);
+	}
+	return frames;
+}
+
+void fagpio_rc_sbus_init(struct fagpio_rc_sbus *s) {
+	memset(s, 0, sizeof(*s));
+}
+
+// 16 channels of 11 bits packed LSB first; 172..1811 map to 988..2012 us
+static void sbus_publish(struct fagpio_rc_sbus *s) {
+	struct fagpio_rc_frame f;
+	uint32_t acc = 0;
+	unsigned int bits = 0, c = 0;
+
+	memset(&f, 0, sizeof(f));
+	for (unsigned int i = 1; i < 23; i++) {
+		acc |= (uint32_t)s->buf[i] << bits;
+		bits += 8;
+		if (bits >= 11) {
+			f.ch[c++] = ((acc & 0x7FF) * 5 / 8) + 880;
+			acc >>= 11;
+			bits -= 11;
+		}
+	}
+	f.ch[16] = s->buf[23] & 0x01 ? 2012 : 988;
+	f.ch[17] = s->buf[23] & 0x02 ? 2012 : 988;
+	f.count = FAGPIO_RC_CHANNELS;
+	f.flags = s->buf[23] & (FAGPIO_RC_FRAME_LOST | FAGPIO_RC_FAILSAFE);
+	f.ticks = fagpio_ticks();
+	fagpio_rc_publish(&s->out, &f);
+}
+
+// Resynchronises on the header; SBUS2 receivers vary the high nibble of the end byte
+int fagpio_rc_sbus_feed(struct fagpio_rc_sbus *s, const uint8_t *buf, size_t len) {
+	int frames = 0;
+
+	for (size_t i = 0; i < len; i++) {
+		uint8_t b = buf[i];
+
+		if (!s->pos && b != SBUS_HEADER)
+			continue;
+		s->buf[s->pos++] = b;
+		if (s->pos < SBUS_FRAME)
+			continue;
+		s->pos = 0;
+		if ((b & 0x0F) == 0x00 || (b & 0x0F) == 0x04) {
+			sbus_publish(s);
+			frames++;
+		} else {
+			s->errors++;
+		}
+	}
+	return frames;
+}
+
+int fagpio_rc_sbus_uart(struct fagpio_rc_sbus *s, uint8_t uart) {
+	uint8_t buf[UART_FIFO_DEPTH];
+	int n = fagpio_uart_read(uart, buf, sizeof(buf), 0);
+
+	return n < 0 ? -1 : fagpio_rc_sbus_feed(s, buf, n);
+}
+
+int fagpio_rc_sbus_capture(struct fagpio_rc_sbus *s, struct fagpio_suart *u, uint32_t timeout_us,
+		struct fagpio_sample *samples, unsigned int nsamples) {
+	uint8_t buf[4 * SBUS_FRAME];
+
+	u->rx_format = FAGPIO_SUART_INVERT | FAGPIO_SUART_EVEN | FAGPIO_SUART_2STOP;
+
+	int n = fagpio_suart_read(u, buf, sizeof(buf), timeout_us, samples, nsamples);
+
+	return n < 0 ? -1 : fagpio_rc_sbus_feed(s, buf, n);
+}
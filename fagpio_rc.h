@@ -0,0 +1,95 @@
+#ifndef _FAGPIO_RC_H
+#define _FAGPIO_RC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fagpio.h"
+#include "fagpio_capture.h"
+#include "fagpio_ring.h"
+#include "fagpio_suart.h"
+
+/*
+ * RC receiver inputs. Decoded channels are published in a seqlock
+ * (struct fagpio_rc_out): the decoder bumps seq to odd, writes the
+ * frame, bumps it to even; fagpio_rc_read() copies the frame and retries
+ * only if seq moved meanwhile, so a control loop never waits on the
+ * decoder and never sees half a frame. Channel values are microseconds.
+ *
+ * PPM: one pin, a rising edge per channel and a gap of more than
+ * FAGPIO_PPM_SYNC_US between frames. fagpio_rc_ppm_poll() sleeps on the
+ * EINT ring (fagpio_eint.h) and measures the edges from its timestamps,
+ * which are taken at wakeup: expect the interrupt latency as jitter.
+ *
+ * SBUS: 25-byte frames of 16 11-bit channels at 100000 baud, inverted
+ * 8E2. fagpio_rc_sbus_feed() parses bytes from any source. The hardware
+ * UART (fagpio_uart_open_format() with UART_LCR_8E2) has no RX
+ * inversion and needs a transistor inverter in front;
+ * fagpio_rc_sbus_capture() decodes the raw line with the software UART
+ * instead, spinning for the capture.
+ */
+
+#define FAGPIO_RC_CHANNELS		18
+#define FAGPIO_PPM_SYNC_US		3000
+#define FAGPIO_PPM_MIN_US		500
+#define FAGPIO_PPM_MAX_US		2500
+
+#define SBUS_BAUD				100000
+#define SBUS_FRAME				25
+#define SBUS_HEADER				0x0F
+
+#define FAGPIO_RC_FRAME_LOST	0x04	//flags, as in the SBUS flag byte
+#define FAGPIO_RC_FAILSAFE		0x08
+
+struct fagpio_rc_frame {
+	uint16_t ch[FAGPIO_RC_CHANNELS];
+	uint8_t count;			//Channels in the frame
+	uint8_t flags;			//FAGPIO_RC_*
+	uint32_t ticks;			//fagpio_ticks() when it completed
+};
+
+struct fagpio_rc_out {
+	volatile uint32_t seq;	//Odd while a frame is being written
+	struct fagpio_rc_frame frame;
+	uint32_t frames;		//Published so far
+};
+
+struct fagpio_rc_ppm {
+	uint8_t pin;
+	uint8_t n;				//Channels of the frame being measured, 0xFF before the first sync
+	uint32_t last;			//Ticks of the previous rising edge
+	uint16_t ch[FAGPIO_RC_CHANNELS];
+	struct fagpio_rc_out out;
+	struct fagpio_ring ring;
+};
+
+struct fagpio_rc_sbus {
+	uint8_t pos;			//Bytes of the frame so far
+	uint8_t buf[SBUS_FRAME];
+	unsigned int errors;	//Frames dropped on a bad end byte
+	struct fagpio_rc_out out;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void fagpio_rc_publish(struct fagpio_rc_out *o, const struct fagpio_rc_frame *f);	//Writer side
+int fagpio_rc_read(const struct fagpio_rc_out *o, struct fagpio_rc_frame *f);		//0, or -1 if nothing was published yet
+
+int fagpio_rc_ppm_init(struct fagpio_rc_ppm *p, uint8_t pin);		//Attaches a RISING interrupt
+int fagpio_rc_ppm_feed(struct fagpio_rc_ppm *p, uint32_t ticks);	//One rising edge; 1 when a frame was published
+int fagpio_rc_ppm_poll(struct fagpio_rc_ppm *p, int timeout_ms);	//Frames published while waiting once
+
+void fagpio_rc_sbus_init(struct fagpio_rc_sbus *s);
+int fagpio_rc_sbus_feed(struct fagpio_rc_sbus *s, const uint8_t *buf, size_t len);	//Frames published
+int fagpio_rc_sbus_uart(struct fagpio_rc_sbus *s, uint8_t uart);		//Drains the RX FIFO without waiting
+
+// Captures the inverted line on u->rx_pin for up to timeout_us and decodes it; u set up by fagpio_suart_init() at SBUS_BAUD
+int fagpio_rc_sbus_capture(struct fagpio_rc_sbus *s, struct fagpio_suart *u, uint32_t timeout_us,
+	struct fagpio_sample *samples, unsigned int nsamples);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
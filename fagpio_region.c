@@ -0,0 +1,116 @@
+#include "fagpio_priv.h"
+#include "fagpio_region.h"
+#include "fagpio_soc.h"
+#include "fagpio_log.h"
+
+// Addresses and sizes come from the SoC descriptor
+static const char region_name[FAGPIO_NREGIONS][8] = {		//Arrays, not pointers: no relocations
+	[FAGPIO_REGION_CCU]		= "ccu",
+	[FAGPIO_REGION_INTC]	= "intc",
+	[FAGPIO_REGION_PIO]		= "pio",
+	[FAGPIO_REGION_TIMER]	= "timer",
+	[FAGPIO_REGION_PWM]		= "pwm",
+	[FAGPIO_REGION_KEYADC]	= "keyadc",
+	[FAGPIO_REGION_TPADC]	= "tpadc",
+	[FAGPIO_REGION_DMA]		= "dma",
+	[FAGPIO_REGION_SPI0]	= "spi0",
+	[FAGPIO_REGION_SPI1]	= "spi1",
+	[FAGPIO_REGION_UART0]	= "uart0",
+	[FAGPIO_REGION_UART1]	= "uart1",
+	[FAGPIO_REGION_UART2]	= "uart2",
+	[FAGPIO_REGION_TWI0]	= "twi0",
+	[FAGPIO_REGION_TWI1]	= "twi1",
+	[FAGPIO_REGION_TWI2]	= "twi2",
+};
+
+struct region_map {
+	void *map;					//Own mapping, NULL if inside the gpio window
+	unsigned long map_size;
+	volatile uint32_t *regs;
+};
+
+static struct region_map region_map[FAGPIO_NREGIONS];
+
+volatile uint32_t *fagpio_region(enum fagpio_region_id id) {
+	if ((unsigned int)id >= FAGPIO_NREGIONS)
+		return NULL;
+
+	struct region_map *r = &region_map[id];
+	const struct fagpio_soc_region *d = &fagpio_soc()->region[id];
+	const char *name = region_name[id];
+
+	if (r->regs)
+		return r->regs;
+
+	if (!gpio.addr) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "%s: fagpio_setup() has not mapped /dev/mem\n", name);
+		return NULL;
+	}
+	if (!d->size) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "%s: not on the %s\n", name, fagpio_soc()->name);
+		return NULL;
+	}
+
+	if (d->phys >= gpio.addr_p && d->phys + d->size <= gpio.addr_p + gpio.size) {
+		r->regs = (volatile uint32_t *)((unsigned char *)gpio.addr + (d->phys - gpio.addr_p));
+		return r->regs;
+	}
+
+	if (gpio.backend != FAGPIO_BACKEND_DEVMEM) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "%s: outside the UIO window, needs /dev/mem\n", name);
+		return NULL;
+	}
+
+	unsigned long page = sysconf(_SC_PAGESIZE);
+	unsigned long base = d->phys & ~(page - 1);
+	unsigned long size = (d->phys - base + d->size + page - 1) & ~(page - 1);
+	void *map = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, gpio.mem_fd, base);
+
+	if (map == MAP_FAILED) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "%s: mmap failed\n", name);
+		return NULL;
+	}
+
+	r->map = map;
+	r->map_size = size;
+	r->regs = (volatile uint32_t *)((unsigned char *)map + (d->phys - base));
+	return r->regs;
+}
+
+int fagpio_region_map(uint32_t set) {
+	for (unsigned int id = 0; id < FAGPIO_NREGIONS; id++) {
+		if ((set & FAGPIO_REGION_BIT(id)) && !fagpio_region(id))
+			return -1;
+	}
+	return 0;
+}
+
+int fagpio_region_find(const char *name) {
+	for (unsigned int id = 0; id < FAGPIO_NREGIONS; id++) {
+		if (!strcmp(region_name[id], name))
+			return id;
+	}
+	return -1;
+}
+
+unsigned long fagpio_region_phys(enum fagpio_region_id id) {
+	return (unsigned int)id < FAGPIO_NREGIONS ? fagpio_soc()->region[id].phys : 0;
+}
+
+unsigned long fagpio_region_mapped(void) {
+	unsigned long size = 0;
+
+	for (unsigned int id = 0; id < FAGPIO_NREGIONS; id++)
+		size += region_map[id].map_size;
+	return size;
+}
+
+void fagpio_region_unmap_all(void) {
+	for (unsigned int id = 0; id < FAGPIO_NREGIONS; id++) {
+		struct region_map *r = &region_map[id];
+
+		if (r->map)
+			munmap(r->map, r->map_size);
+		memset(r, 0, sizeof(*r));
+	}
+}
@@ -0,0 +1,51 @@
+#ifndef _FAGPIO_REGION_H
+#define _FAGPIO_REGION_H
+
+#include <stdint.h>
+
+/*
+ * Named peripheral register blocks, at the addresses of the detected SoC
+ * (fagpio_soc.h); fagpio_region() is NULL for a block the SoC lacks.
+ * Every region is mapped through the /dev/mem fd opened by fagpio_setup(),
+ * sized to its real register span. Regions inside the 16 KB window
+ * already mapped for the PIO block (CCU, INTC, PIO, timer, PWM, KEYADC on
+ * the F1C100s) reuse that mapping; in low-memory mode (fagpio_mem.h) the
+ * window is only the PIO page, and the others get pages of their own.
+ */
+enum fagpio_region_id {
+	FAGPIO_REGION_CCU,
+	FAGPIO_REGION_INTC,
+	FAGPIO_REGION_PIO,
+	FAGPIO_REGION_TIMER,
+	FAGPIO_REGION_PWM,
+	FAGPIO_REGION_KEYADC,
+	FAGPIO_REGION_TPADC,
+	FAGPIO_REGION_DMA,
+	FAGPIO_REGION_SPI0,
+	FAGPIO_REGION_SPI1,
+	FAGPIO_REGION_UART0,
+	FAGPIO_REGION_UART1,
+	FAGPIO_REGION_UART2,
+	FAGPIO_REGION_TWI0,
+	FAGPIO_REGION_TWI1,
+	FAGPIO_REGION_TWI2,
+	FAGPIO_NREGIONS
+};
+
+#define FAGPIO_REGION_BIT(id)	(1u << (id))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+volatile uint32_t *fagpio_region(enum fagpio_region_id id);	//Maps on first use, NULL on failure
+int fagpio_region_map(uint32_t set);						//Maps every FAGPIO_REGION_BIT() in set up front
+int fagpio_region_find(const char *name);					//"spi0" -> FAGPIO_REGION_SPI0, -1 if unknown
+unsigned long fagpio_region_phys(enum fagpio_region_id id);
+void fagpio_region_unmap_all(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
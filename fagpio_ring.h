@@ -0,0 +1,75 @@
+#ifndef _FAGPIO_RING_H
+#define _FAGPIO_RING_H
+
+#include <stdint.h>
+#include "fagpio_atomic.h"
+
+/*
+ * Single-producer/single-consumer ring of GPIO events. The producer only
+ * writes head and the consumer only writes tail, each on its own cache
+ * line, so a push never waits: a full ring drops the event and counts it.
+ * The slot is written before head is published and read before tail is
+ * released, ordered by fagpio_barrier() (fagpio_atomic.h), which is
+ * correct on ARMv5 without DMB.
+ */
+
+#ifndef FAGPIO_CACHE_LINE
+#define FAGPIO_CACHE_LINE	32		//ARM926EJ-S; build with 64 for the Cortex-A7 of the H3
+#endif
+#define FAGPIO_RING_SIZE	256		//Power of two
+
+struct fagpio_event {
+	uint32_t ticks;		//fagpio_ticks() when seen
+	uint8_t port;
+	uint8_t pad[3];
+	uint32_t old;		//Port value before
+	uint32_t cur;		//and after the change
+};
+
+struct fagpio_ring {
+	volatile uint32_t head __attribute__((aligned(FAGPIO_CACHE_LINE)));	//Producer side
+	uint32_t dropped;
+	volatile uint32_t tail __attribute__((aligned(FAGPIO_CACHE_LINE)));	//Consumer side
+	struct fagpio_event ev[FAGPIO_RING_SIZE] __attribute__((aligned(FAGPIO_CACHE_LINE)));
+};
+
+static inline void fagpio_ring_init(struct fagpio_ring *r) {
+	r->head = r->tail = r->dropped = 0;
+}
+
+// Producer only; 0 on success, -1 if the ring was full and the event dropped
+static inline int fagpio_ring_push(struct fagpio_ring *r, uint32_t ticks, uint8_t port, uint32_t old, uint32_t cur) {
+	uint32_t head = r->head;
+
+	if (head - r->tail == FAGPIO_RING_SIZE) {
+		r->dropped++;
+		return -1;
+	}
+
+	struct fagpio_event *e = &r->ev[head & (FAGPIO_RING_SIZE - 1)];
+
+	e->ticks = ticks;
+	e->port = port;
+	e->old = old;
+	e->cur = cur;
+	fagpio_barrier();
+	r->head = head + 1;
+	return 0;
+}
+
+// Consumer only; copies up to max events into out and returns how many
+static inline unsigned int fagpio_ring_pop(struct fagpio_ring *r, struct fagpio_event *out, unsigned int max) {
+	uint32_t tail = r->tail;
+	uint32_t n = r->head - tail;
+
+	if (n > max)
+		n = max;
+	fagpio_barrier();
+	for (uint32_t i = 0; i < n; i++)
+		out[i] = r->ev[(tail + i) & (FAGPIO_RING_SIZE - 1)];
+	fagpio_barrier();
+	r->tail = tail + n;
+	return n;
+}
+
+#endif
@@ -0,0 +1,54 @@
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "fagpio.h"
+#include "fagpio_log.h"
+#include "fagpio_rt.h"
+
+// Kept out of line so the frame really is allocated and written
+static void __attribute__((noinline)) prefault_stack(void) {
+	volatile unsigned char stack[FAGPIO_RT_STACK];
+	unsigned long page = sysconf(_SC_PAGESIZE);
+
+	for (unsigned long i = 0; i < sizeof(stack); i += page)
+		stack[i] = 0;
+}
+
+int fagpio_rt_enter(int prio) {
+	int ret = 0;
+
+	if (fagpio_setup() < 0)
+		return -1;
+
+	if (mlockall(MCL_CURRENT|MCL_FUTURE) < 0) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "mlockall: %s\n", strerror(errno));
+		ret = -1;
+	}
+	mallopt(M_TRIM_THRESHOLD, -1);
+	mallopt(M_MMAP_MAX, 0);
+	prefault_stack();
+
+	// The mapping is populated at mmap time; reading each page also loads the TLB and page-table walk
+	if (gpio.addr) {
+		unsigned long page = sysconf(_SC_PAGESIZE);
+
+		for (unsigned long off = 0; off < gpio.size; off += page)
+			(void)gpio.addr[off / sizeof(*gpio.addr)];
+	}
+
+	if (prio > 0) {
+		struct sched_param sp = { .sched_priority = prio };
+		int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp);
+
+		if (err) {
+			FAGPIO_LOG(FAGPIO_LOG_ERR, "SCHED_FIFO %d: %s\n", prio, strerror(err));
+			ret = -1;
+		}
+	}
+
+	return ret;
+}
@@ -0,0 +1,25 @@
+#ifndef _FAGPIO_RT_H
+#define _FAGPIO_RT_H
+
+/*
+ * fagpio_rt_enter() replaces the usual real-time boilerplate: it maps the
+ * registers if needed, locks all current and future pages, stops malloc
+ * from trimming or mmapping, prefaults FAGPIO_RT_STACK bytes of stack,
+ * touches every page of the register window and switches the calling
+ * thread to SCHED_FIFO at prio (0 keeps the current policy). Every step
+ * is attempted; the return value is -1 if any of them failed.
+ */
+
+#define FAGPIO_RT_STACK		(64 * 1024)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fagpio_rt_enter(int prio);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,127 @@
+#include <errno.h>
+#include <poll.h>
+#include "fagpio_priv.h"
+#include "fagpio_sampler.h"
+#include "fagpio_region.h"
+#include "fagpio_timer.h"
+#include "fagpio_ccu.h"
+#include "fagpio_rt.h"
+#include "fagpio_log.h"
+
+#define TMR_CTRL_EN			(1u << 0)
+#define TMR_CTRL_RELOAD		(1u << 1)		//Loads INTV, self-clearing
+#define TMR_CTRL_OSC24M		(1u << 2)
+#define TMR_POLL_MS			100				//Stop latency of the thread
+
+static volatile uint32_t *timer_regs(void) {
+	if (!fagpio_banks())
+		return NULL;
+	return fagpio_region(FAGPIO_REGION_TIMER);
+}
+
+static void *sampler_thread(void *arg) {
+	struct fagpio_sampler *s = arg;
+	volatile uint32_t *tmr = timer_regs();
+	struct pollfd pfd = { .fd = s->fd, .events = POLLIN };
+	uint32_t count, one = 1;
+
+	if (s->prio)
+		fagpio_rt_enter(s->prio);
+	while (!s->stop) {
+		if (poll(&pfd, 1, TMR_POLL_MS) <= 0)
+			continue;
+		if (read(s->fd, &count, sizeof(count)) != sizeof(count))
+			continue;
+
+		uint32_t now = fagpio_ticks();
+
+		// Sample first: acknowledging and re-arming can wait until the ports are read
+		for (uint8_t port = 0; port < PIO_NPORTS; port++) {
+			if (!(s->ports & (1u << port)))
+				continue;
+
+			uint32_t v = digitalReadPort(port);
+
+			fagpio_ring_push(s->ring, now, port, s->last[port], v);
+			FAGPIO_TRACE_PORT(FAGPIO_TRACE_INPUT, port, s->last[port] ^ v, v, now);
+			s->last[port] = v;
+		}
+		s->samples++;
+		if (s->events && count - s->events > 1)
+			s->missed += count - s->events - 1;
+		s->events = count;
+
+		tmr[rTMR_IRQ_STA / 4] = 1u << s->timer;
+		if (write(s->fd, &one, sizeof(one)) != sizeof(one))
+			FAGPIO_LOG(FAGPIO_LOG_ERR, "Cannot re-arm the timer %u interrupt\n", s->timer);
+	}
+	return NULL;
+}
+
+int fagpio_sampler_start(struct fagpio_sampler *s, uint8_t timer, uint32_t hz, uint8_t ports, struct fagpio_ring *ring) {
+	volatile uint32_t *tmr = timer_regs();
+	char name[32], path[32];
+	uint32_t one = 1;
+	int n;
+
+	if (!tmr || timer >= FAGPIO_TIMERS || !hz || hz > FAGPIO_OSC_HZ || !ports || !ring)
+		return -1;
+
+	snprintf(name, sizeof(name), FAGPIO_UIO_TIMER_NAME "%u", timer);
+	if ((n = fagpio_uio_find(name)) < 0) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "No UIO device named %s\n", name);
+		return -1;
+	}
+	snprintf(path, sizeof(path), "/dev/uio%d", n);
+
+	int prio = s->prio;
+
+	memset(s, 0, sizeof(*s));
+	s->prio = prio;
+	s->timer = timer;
+	s->ports = ports;
+	s->ring = ring;
+	if ((s->fd = open(path, O_RDWR|O_CLOEXEC)) < 0) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "%s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	for (uint8_t port = 0; port < PIO_NPORTS; port++)
+		s->last[port] = digitalReadPort(port);
+
+	tmr[rTMR_CTRL(timer) / 4] = 0;
+	tmr[rTMR_INTV(timer) / 4] = FAGPIO_OSC_HZ / hz;
+	tmr[rTMR_CTRL(timer) / 4] = TMR_CTRL_OSC24M | TMR_CTRL_RELOAD;
+	for (int i = 0; i < 1000 && (tmr[rTMR_CTRL(timer) / 4] & TMR_CTRL_RELOAD); i++)
+		;
+	tmr[rTMR_IRQ_STA / 4] = 1u << timer;
+	tmr[rTMR_IRQ_EN / 4] |= 1u << timer;
+	if (write(s->fd, &one, sizeof(one)) != sizeof(one))		//Unmask in uio_pdrv_genirq
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "%s: cannot enable the interrupt\n", path);
+	tmr[rTMR_CTRL(timer) / 4] = TMR_CTRL_OSC24M | TMR_CTRL_EN;
+
+	if (pthread_create(&s->thread, NULL, sampler_thread, s)) {
+		fagpio_sampler_stop(s);
+		return -1;
+	}
+	FAGPIO_LOG(FAGPIO_LOG_INFO, "Timer %u samples at %u Hz\n", timer, FAGPIO_OSC_HZ / (FAGPIO_OSC_HZ / hz));
+	return 0;
+}
+
+void fagpio_sampler_stop(struct fagpio_sampler *s) {
+	volatile uint32_t *tmr = timer_regs();
+
+	s->stop = 1;
+	if (s->thread) {
+		pthread_join(s->thread, NULL);
+		s->thread = 0;
+	}
+	if (tmr) {
+		tmr[rTMR_CTRL(s->timer) / 4] = 0;
+		tmr[rTMR_IRQ_EN / 4] &= ~(1u << s->timer);
+		tmr[rTMR_IRQ_STA / 4] = 1u << s->timer;
+	}
+	if (s->fd >= 0) {
+		close(s->fd);
+		s->fd = -1;
+	}
+}
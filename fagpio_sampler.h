@@ -0,0 +1,62 @@
+#ifndef _FAGPIO_SAMPLER_H
+#define _FAGPIO_SAMPLER_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include "fagpio.h"
+#include "fagpio_ring.h"
+
+/*
+ * Periodic port sampling paced by a hardware timer of the timer block
+ * (0x01C20C00, inside the window mapped by fagpio_setup()). The timer
+ * reloads itself from the 24 MHz oscillator, so the rate does not drift
+ * however late a wake-up is. Its interrupt is delivered by a generic-uio
+ * node named "fagpio-timer" followed by the timer number:
+ *
+ *	fagpio-timer2 {
+ *		compatible = "generic-uio";
+ *		interrupts = <15>;		//13 timer 0, 14 timer 1, 15 timer 2
+ *	};
+ *
+ * On every tick the sampling thread reads each port in ports and pushes
+ * one event per port (previous and current DAT) into the SPSC ring. Ticks
+ * the thread slept through are counted in missed, from the UIO event
+ * count. The kernel's sun4i timer driver owns timers 0 and 1.
+ */
+
+#define rTMR_IRQ_EN			0x00	//Timer block offsets
+#define rTMR_IRQ_STA		0x04
+#define rTMR_CTRL(n)		(0x10 + (n) * 0x10)
+#define rTMR_INTV(n)		(0x14 + (n) * 0x10)
+#define rTMR_CUR(n)			(0x18 + (n) * 0x10)
+
+#define FAGPIO_TIMERS			3
+#define FAGPIO_SAMPLER_TIMER	2
+#define FAGPIO_UIO_TIMER_NAME	"fagpio-timer"
+
+struct fagpio_sampler {
+	uint8_t timer;
+	uint8_t ports;						//Bit n samples port n
+	int prio;							//SCHED_FIFO priority of the thread, 0 to keep the policy
+	struct fagpio_ring *ring;
+	uint32_t last[PIO_NPORTS];
+	uint32_t events;					//Last UIO event count
+	uint32_t missed;
+	uint32_t samples;
+	int fd;
+	volatile uint8_t stop;
+	pthread_t thread;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fagpio_sampler_start(struct fagpio_sampler *s, uint8_t timer, uint32_t hz, uint8_t ports, struct fagpio_ring *ring);
+void fagpio_sampler_stop(struct fagpio_sampler *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
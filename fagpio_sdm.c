@@ -0,0 +1,106 @@
+#include <string.h>
+#include "fagpio.h"
+#include "fagpio_sdm.h"
+#include "fagpio_dma.h"
+#include "fagpio_dmabuf.h"
+
+#define SDM_HALF		(FAGPIO_SDM_FULL / 2)
+#define SDM_CLAMP		(1 << 24)		//Integrator limit, against windup near the rails
+
+int fagpio_sdm_init(struct fagpio_sdm *s, uint8_t port, uint32_t bit_ns) {
+	if (port >= PIO_NPORTS || !bit_ns || fagpio_setup() < 0)
+		return -1;
+
+	memset(s, 0, sizeof(*s));
+	s->port = port;
+	s->period = fagpio_ns_to_ticks(bit_ns);
+	s->pos = FAGPIO_SDM_BLOCK;
+	return 0;
+}
+
+int fagpio_sdm_add(struct fagpio_sdm *s, uint8_t pin, unsigned int order) {
+	if (s->count == FAGPIO_SDM_MAX || PIO_PIN_PORT(pin) != s->port || (s->mask & PIO_PIN_MASK(pin)) || order < 1 || order > 2)
+		return -1;
+
+	struct fagpio_sdm_channel *c = &s->ch[s->count];
+
+	memset(c, 0, sizeof(*c));
+	c->mask = PIO_PIN_MASK(pin);
+	c->order = order;
+	s->mask |= c->mask;
+	digitalWritePort(s->port, c->mask, 0);
+	pinMode(pin, OUTPUT);
+	return s->count++;
+}
+
+void fagpio_sdm_set(struct fagpio_sdm *s, unsigned int ch, uint32_t level) {
+	if (ch < s->count)
+		s->ch[ch].level = level > FAGPIO_SDM_FULL ? FAGPIO_SDM_FULL : level;
+}
+
+static inline int32_t clamp(int32_t v) {
+	return v > SDM_CLAMP ? SDM_CLAMP : v < -SDM_CLAMP ? -SDM_CLAMP : v;
+}
+
+// Channel by channel, so each modulator's state stays in registers for the block
+void fagpio_sdm_generate(struct fagpio_sdm *s, uint32_t *words, size_t n, uint32_t base) {
+	for (size_t i = 0; i < n; i++)
+		words[i] = base;
+	for (unsigned int c = 0; c < s->count; c++) {
+		struct fagpio_sdm_channel *ch = &s->ch[c];
+		uint32_t mask = ch->mask;
+		int32_t i1 = ch->i1, i2 = ch->i2;
+
+		if (ch->order == 1) {
+			uint32_t acc = (uint32_t)i1, level = ch->level;
+
+			for (size_t i = 0; i < n; i++) {
+				acc += level;
+				if (acc >= FAGPIO_SDM_FULL) {
+					acc -= FAGPIO_SDM_FULL;
+					words[i] |= mask;
+				}
+			}
+			i1 = acc;
+		} else {
+			int32_t u = (int32_t)ch->level - SDM_HALF;
+
+			for (size_t i = 0; i < n; i++) {
+				int32_t v = i2 >= 0 ? SDM_HALF : -SDM_HALF;
+
+				if (i2 >= 0)
+					words[i] |= mask;
+				i1 = clamp(i1 + u - v);
+				i2 = clamp(i2 + i1 - v);
+			}
+		}
+		ch->i1 = i1;
+		ch->i2 = i2;
+	}
+}
+
+int fagpio_sdm_task(struct fagpio_task *t) {
+	struct fagpio_sdm *s = t->arg;
+
+	FAGPIO_TASK_BEGIN(t);
+	for (;;) {
+		if (s->pos == FAGPIO_SDM_BLOCK) {
+			fagpio_sdm_generate(s, s->block, FAGPIO_SDM_BLOCK, 0);
+			s->pos = 0;
+		}
+		digitalWritePort(s->port, s->mask, s->block[s->pos++]);
+		FAGPIO_TASK_DELAY(t, s->period);
+	}
+	FAGPIO_TASK_END(t);
+}
+
+size_t fagpio_sdm_dma_build(struct fagpio_sdm *s, struct fagpio_dmabuf *buf, size_t words) {
+	if (!buf->virt || !words || words > FAGPIO_DMA_MAX_WORDS || words * 4 > buf->size)
+		return 0;
+	fagpio_sdm_generate(s, (uint32_t *)buf->virt, words, digitalReadPort(s->port) & ~s->mask);		//Uncached: written once, not read back
+	return words;
+}
+
+int fagpio_sdm_dma_start(struct fagpio_sdm *s, uint8_t ch, const struct fagpio_dmabuf *buf, size_t words, uint8_t wait) {
+	return fagpio_dma_wave_start(ch, s->port, buf, words, FAGPIO_DMA_DRQ_SDRAM, wait, FAGPIO_DMA_LOOP);
+}
@@ -0,0 +1,71 @@
+#ifndef _FAGPIO_SDM_H
+#define _FAGPIO_SDM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fagpio_task.h"
+
+/*
+ * Sigma-delta DACs on GPIO pins: behind an RC low-pass each pin gives an
+ * analog level, for bias voltages or tones. Up to 32 channels on one port
+ * share a bit clock; the modulators run in Q16 fixed point over blocks of
+ * port words, a bit per channel, so every tick is one store for all
+ * channels.
+ *
+ * First order is an accumulator and its carry. Second order (two
+ * integrators, CIFB with unity gains) pushes the quantisation noise
+ * further up, for audio; its integrators are clamped, so levels at the
+ * rails do not wind it up.
+ *
+ * Output is either fagpio_sdm_task() on the cooperative scheduler, one
+ * store per period, or a looping DMA buffer from fagpio_sdm_dma_build():
+ * no CPU at all, and a fixed level repeats exactly to within 1/words.
+ */
+
+#define FAGPIO_SDM_MAX			32
+#define FAGPIO_SDM_BLOCK		64		//Words per block of fagpio_sdm_task()
+#define FAGPIO_SDM_FULL			65536	//Q16 level of the rail
+
+struct fagpio_sdm_channel {
+	uint32_t mask;
+	uint8_t order;
+	uint32_t level;			//Q16, 0 to FAGPIO_SDM_FULL
+	int32_t i1, i2;			//Integrators
+};
+
+struct fagpio_sdm {
+	uint8_t port;
+	unsigned int count;
+	uint32_t mask;			//All channel pins
+	uint32_t period;		//Ticks per bit for the task
+	unsigned int pos;		//Next word of block
+	uint32_t block[FAGPIO_SDM_BLOCK];
+	struct fagpio_sdm_channel ch[FAGPIO_SDM_MAX];
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fagpio_sdm_init(struct fagpio_sdm *s, uint8_t port, uint32_t bit_ns);
+
+// order 1 or 2; returns the channel number
+int fagpio_sdm_add(struct fagpio_sdm *s, uint8_t pin, unsigned int order);
+void fagpio_sdm_set(struct fagpio_sdm *s, unsigned int ch, uint32_t level);
+
+// Runs every modulator for n bits: words[i] = base | channel pins high in bit i
+void fagpio_sdm_generate(struct fagpio_sdm *s, uint32_t *words, size_t n, uint32_t base);
+
+// Scheduler task with arg = the fagpio_sdm: one masked port store per period
+int fagpio_sdm_task(struct fagpio_task *t);
+
+// Fills buf with DAT words for fagpio_dma_wave_start(); returns the words, 0 if it does not fit
+struct fagpio_dmabuf;
+size_t fagpio_sdm_dma_build(struct fagpio_sdm *s, struct fagpio_dmabuf *buf, size_t words);
+int fagpio_sdm_dma_start(struct fagpio_sdm *s, uint8_t ch, const struct fagpio_dmabuf *buf, size_t words, uint8_t wait);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
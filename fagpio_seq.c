@@ -0,0 +1,134 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include "fagpio_priv.h"
+#include "fagpio_seq.h"
+#include "fagpio_timer.h"
+#include "fagpio_kseq.h"
+#include "fagpio_log.h"
+
+_Static_assert(sizeof(struct fagpio_kseq_op) == sizeof(struct fagpio_seq_op), "fagpio_kseq.h op layout");
+
+static int kseq_fd = -2;		//-2 until the first playback looks for the module
+
+void fagpio_seq_init(struct fagpio_seq *seq, struct fagpio_seq_op *ops, unsigned int capacity) {
+	seq->ops = ops;
+	seq->count = 0;
+	seq->capacity = capacity;
+	seq->end = 0;
+	seq->late = 0;
+}
+
+// A zero-delta step on the same port as the previous op merges into it
+int fagpio_seq_add(struct fagpio_seq *seq, uint8_t port, uint32_t mask, uint32_t value, uint32_t delta) {
+	if (port >= PIO_NPORTS)
+		return -1;
+
+	seq->end += delta;
+	if (seq->count && !delta && seq->ops[seq->count - 1].port == port) {
+		struct fagpio_seq_op *op = &seq->ops[seq->count - 1];
+
+		op->value = (op->value & ~mask) | (value & mask);
+		op->mask |= mask;
+		return 0;
+	}
+	if (seq->count == seq->capacity)
+		return -1;
+
+	struct fagpio_seq_op *op = &seq->ops[seq->count++];
+
+	op->at = seq->end;
+	op->mask = mask;
+	op->value = value & mask;
+	op->port = port;
+	return 0;
+}
+
+int fagpio_seq_compile(struct fagpio_seq *seq, const struct fagpio_seq_step *steps, unsigned int count) {
+	for (unsigned int i = 0; i < count; i++) {
+		if (fagpio_seq_add(seq, steps[i].port, steps[i].mask, steps[i].value, steps[i].delta) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+/*
+Playback through fagpio_kseq.ko when it is loaded (fagpio_kseq.h): -1 when
+the module is missing or refuses the timeline, which then plays here.
+Only the PIO mapped through devmem or UIO is the one the module drives.
+*/
+static int kseq_play(const struct fagpio_seq_op *ops, unsigned int count, uint32_t start) {
+	struct fagpio_kseq_play req = { (uintptr_t)ops, count, start, 0, 0 };
+
+	if (kseq_fd == -2) {
+		const char *env = getenv("FAGPIO_KSEQ");
+
+		kseq_fd = -1;
+		if ((!env || strcmp(env, "0")) && fagpio_handle_backend(fagpio_default()) != FAGPIO_BACKEND_SIM)
+			kseq_fd = open(FAGPIO_KSEQ_DEV, O_RDWR | O_CLOEXEC);
+	}
+	if (kseq_fd < 0 || count > FAGPIO_KSEQ_MAX_OPS)
+		return -1;
+	if (ioctl(kseq_fd, FAGPIO_KSEQ_PLAY, &req) < 0) {
+		if (errno != E2BIG)
+			FAGPIO_LOG(FAGPIO_LOG_DEBUG, FAGPIO_KSEQ_DEV ": %s\n", strerror(errno));
+		return -1;
+	}
+	return req.late;
+}
+
+FAGPIO_ARM_CODE static int play_here(struct pio_bank *banks, const struct fagpio_seq_op *ops, unsigned int count, uint32_t start, uint32_t used) {
+	volatile uint32_t *counter = fagpio_counter;
+	uint32_t cur[PIO_NPORTS];
+	int late = 0;
+
+	for (unsigned int port = 0; port < PIO_NPORTS; port++) {
+		if (used & (1u << port))
+			cur[port] = banks[port].dat;
+	}
+
+	for (unsigned int i = 0; i < count; i++) {
+		const struct fagpio_seq_op *op = &ops[i];
+		uint32_t target = start + op->at;
+
+		if ((int32_t)((counter ? *counter : fagpio_ticks_slow()) - target) > 0)
+			late++;
+		else while ((int32_t)((counter ? *counter : fagpio_ticks_slow()) - target) < 0)
+			;
+
+		cur[op->port] = (cur[op->port] & ~op->mask) | op->value;
+		banks[op->port].dat = cur[op->port];
+	}
+	return late;
+}
+
+int fagpio_seq_play_ops(const struct fagpio_seq_op *ops, unsigned int count, uint32_t start) {
+	struct pio_bank *banks = fagpio_banks();
+	uint32_t used = 0;
+	int late;
+
+	if (!banks)
+		return -1;
+
+	for (unsigned int i = 0; i < count; i++)
+		used |= 1u << ops[i].port;
+	if ((late = kseq_play(ops, count, start)) < 0)
+		late = play_here(banks, ops, count, start, used);
+
+	for (unsigned int port = 0; port < PIO_NPORTS; port++) {
+		if (used & (1u << port))
+			fagpio_shadow_sync(port);
+	}
+	return late;
+}
+
+int fagpio_seq_play(struct fagpio_seq *seq) {
+	int late = fagpio_seq_play_ops(seq->ops, seq->count, fagpio_ticks());
+
+	if (late < 0)
+		return -1;
+	seq->late = late;
+	return 0;
+}
@@ -0,0 +1,54 @@
+#ifndef _FAGPIO_SEQ_H
+#define _FAGPIO_SEQ_H
+
+#include <stdint.h>
+
+/*
+ * Waveform sequencer. A timeline of (port, mask, value, delta) steps is
+ * compiled into ops carrying absolute tick offsets, then played back in a
+ * tight loop paced by the AVS counter (fagpio_timer.h): wait for the op's
+ * tick, one DAT store, next op. Port values are kept in registers during
+ * playback, so no DAT read happens between stores, and absolute offsets
+ * keep late ops from accumulating drift. Storage is caller provided.
+ */
+
+struct fagpio_seq_step {
+	uint8_t port;
+	uint32_t mask;
+	uint32_t value;
+	uint32_t delta;		//Ticks after the previous step
+};
+
+struct fagpio_seq_op {
+	uint32_t at;		//Ticks after the start of playback
+	uint32_t mask;
+	uint32_t value;
+	uint8_t port;
+	uint8_t pad[3];
+};
+
+struct fagpio_seq {
+	struct fagpio_seq_op *ops;
+	unsigned int count;
+	unsigned int capacity;
+	uint32_t end;		//Tick offset of the last step added
+	unsigned int late;	//Ops that were already overdue in the last playback
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void fagpio_seq_init(struct fagpio_seq *seq, struct fagpio_seq_op *ops, unsigned int capacity);
+int fagpio_seq_add(struct fagpio_seq *seq, uint8_t port, uint32_t mask, uint32_t value, uint32_t delta);
+int fagpio_seq_compile(struct fagpio_seq *seq, const struct fagpio_seq_step *steps, unsigned int count);
+int fagpio_seq_play(struct fagpio_seq *seq);
+
+// Plays raw ops from tick start; returns the number of overdue ops or -1
+int fagpio_seq_play_ops(const struct fagpio_seq_op *ops, unsigned int count, uint32_t start);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
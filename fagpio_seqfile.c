@@ -0,0 +1,152 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "fagpio_priv.h"
+#include "fagpio_seqfile.h"
+#include "fagpio_timer.h"
+#include "fagpio_log.h"
+
+#define SEQF_WINDOW		(256 << 10)		//Bytes read ahead of and kept behind the playback position
+
+int fagpio_seqfile_open(struct fagpio_seqfile *f, const char *path) {
+	struct stat st;
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+	memset(f, 0, sizeof(*f));
+	if (fd < 0 || fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(struct fagpio_seqf_hdr)) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "%s: %s\n", path, fd < 0 ? strerror(errno) : "too short");
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+	close(fd);
+	if (map == MAP_FAILED) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "%s: %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	const struct fagpio_seqf_hdr *hdr = map;
+
+	if (hdr->magic != FAGPIO_SEQF_MAGIC || hdr->version != FAGPIO_SEQF_VERSION ||
+		hdr->size < sizeof(*hdr) || hdr->size % 4 || hdr->size > (uint64_t)st.st_size ||
+		(st.st_size - hdr->size) / sizeof(struct fagpio_seqf_rec) < hdr->count) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "%s: not a version %u sequence file\n", path, FAGPIO_SEQF_VERSION);
+		munmap(map, st.st_size);
+		return -1;
+	}
+
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+	madvise(map, st.st_size < SEQF_WINDOW ? st.st_size : SEQF_WINDOW, MADV_WILLNEED);
+	f->hdr = hdr;
+	f->rec = (const struct fagpio_seqf_rec *)((const char *)map + hdr->size);
+	f->count = hdr->count;
+	f->map = map;
+	f->map_size = st.st_size;
+	return 0;
+}
+
+void fagpio_seqfile_close(struct fagpio_seqfile *f) {
+	if (f->map)
+		munmap(f->map, f->map_size);
+	memset(f, 0, sizeof(*f));
+}
+
+/*
+Once per window: start reading the next one in, and drop what lies more
+than a window behind. Dropping waits until no repeat body can jump back.
+*/
+static void seqf_window(const struct fagpio_seqfile *f, const struct fagpio_seqf_rec *r, int drop) {
+	uintptr_t page = sysconf(_SC_PAGESIZE);
+	uintptr_t base = (uintptr_t)f->map, end = base + f->map_size;
+	uintptr_t pos = (uintptr_t)r & ~(page - 1);
+
+	if (pos + SEQF_WINDOW < end)
+		madvise((void *)(pos + SEQF_WINDOW), end - pos - SEQF_WINDOW < SEQF_WINDOW ? end - pos - SEQF_WINDOW : SEQF_WINDOW, MADV_WILLNEED);
+	if (drop && pos >= base + SEQF_WINDOW)
+		madvise((void *)base, pos - SEQF_WINDOW - base, MADV_DONTNEED);
+}
+
+int fagpio_seqfile_play(struct fagpio_seqfile *f) {
+	struct pio_bank *banks = fagpio_banks();
+	volatile uint32_t *counter = fagpio_counter;
+	uint32_t tick_hz = f->hdr ? f->hdr->tick_hz : 0;
+	int scale = tick_hz && tick_hz != fagpio_tick_hz;
+	struct {
+		const struct fagpio_seqf_rec *body, *stop;
+		uint32_t left;
+	} stack[FAGPIO_SEQF_DEPTH];
+	int sp = 0, ret = 0;
+	uint32_t cur[PIO_NPORTS];
+	unsigned int late = 0;
+
+	if (!banks || !f->map)
+		return -1;
+
+	const struct fagpio_seqf_rec *r = f->rec, *end = f->rec + f->count;
+	const struct fagpio_seqf_rec *next_window = r + SEQF_WINDOW / sizeof(*r);
+
+	for (unsigned int port = 0; port < PIO_NPORTS; port++)
+		cur[port] = banks[port].dat;
+
+	uint32_t target = counter ? *counter : fagpio_ticks_slow();
+
+	while (r < end || sp) {
+		if (sp && r == stack[sp - 1].stop) {
+			if (--stack[sp - 1].left)
+				r = stack[sp - 1].body;
+			else
+				sp--;
+			continue;
+		}
+		target += scale ? (uint32_t)((uint64_t)r->delta * fagpio_tick_hz / tick_hz) : r->delta;
+
+		if (r->op == FAGPIO_SEQF_REPEAT) {
+			const struct fagpio_seqf_rec *limit = sp ? stack[sp - 1].stop : end;
+
+			if (sp == FAGPIO_SEQF_DEPTH || !r->mask || r->mask > (uint32_t)(limit - r - 1)) {
+				ret = -1;
+				break;
+			}
+			if (r->value) {
+				stack[sp].body = r + 1;
+				stack[sp].stop = r + 1 + r->mask;
+				stack[sp].left = r->value;
+				sp++;
+				r++;
+			} else {
+				r += 1 + r->mask;		//Zero passes: skip the body
+			}
+			continue;
+		}
+		if (r->op != FAGPIO_SEQF_STEP || r->port >= PIO_NPORTS) {
+			ret = -1;
+			break;
+		}
+
+		if ((int32_t)((counter ? *counter : fagpio_ticks_slow()) - target) > 0)
+			late++;
+		else while ((int32_t)((counter ? *counter : fagpio_ticks_slow()) - target) < 0)
+			;
+
+		cur[r->port] = (cur[r->port] & ~r->mask) | (r->value & r->mask);
+		banks[r->port].dat = cur[r->port];
+
+		if (++r >= next_window) {
+			seqf_window(f, r, !sp);
+			next_window = r + SEQF_WINDOW / sizeof(*r);
+		}
+	}
+	if (ret < 0)
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "sequence file: bad record %u\n", (unsigned int)(r - f->rec));
+
+	for (unsigned int port = 0; port < PIO_NPORTS; port++)
+		fagpio_shadow_sync(port);
+	f->late = late;
+	return ret;
+}
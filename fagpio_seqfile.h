@@ -0,0 +1,76 @@
+#ifndef _FAGPIO_SEQFILE_H
+#define _FAGPIO_SEQFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Sequence files: a header and fixed-size little-endian records, played
+ * in place from a read-only mmap like the ops of fagpio_seq.h. Nothing is
+ * parsed or copied; pages are read ahead and dropped behind during
+ * playback, so a file may be larger than the free RAM. Each record waits
+ * its delta after the previous one (timing is absolute, no drift), then
+ * stores value to the bits in mask of port.
+ *
+ * A FAGPIO_SEQF_REPEAT record plays the body of the next mask records
+ * value times, nested up to FAGPIO_SEQF_DEPTH deep; its delta comes
+ * before the first pass. Deltas count ticks of tick_hz, rescaled when
+ * that differs from the measured counter rate (0 means the counter's).
+ *
+ * Hosts write the files with these structs only. Playback of the first
+ * pages waits on the disk unless they are cached; fagpio_seqfile_open()
+ * starts reading them in. fagpio_rt_enter() locks every mapping, this one
+ * included: files beyond the free RAM need a real-time setup without
+ * mlockall().
+ */
+
+#define FAGPIO_SEQF_MAGIC		0x51455346		//"FSEQ"
+#define FAGPIO_SEQF_VERSION		1
+#define FAGPIO_SEQF_DEPTH		8
+
+enum {
+	FAGPIO_SEQF_STEP,		//DAT bits in mask of port := value
+	FAGPIO_SEQF_REPEAT,		//Next mask records, value times
+};
+
+struct fagpio_seqf_hdr {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t size;			//Header bytes, records start there
+	uint32_t tick_hz;
+	uint32_t count;			//Records
+};
+
+struct fagpio_seqf_rec {
+	uint32_t delta;
+	uint8_t op;
+	uint8_t port;
+	uint16_t pad;
+	uint32_t mask;
+	uint32_t value;
+};
+
+struct fagpio_seqfile {
+	const struct fagpio_seqf_hdr *hdr;
+	const struct fagpio_seqf_rec *rec;
+	uint32_t count;
+	void *map;
+	size_t map_size;
+	unsigned int late;		//Steps that were already overdue in the last playback
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fagpio_seqfile_open(struct fagpio_seqfile *f, const char *path);
+void fagpio_seqfile_close(struct fagpio_seqfile *f);
+
+// Plays the whole file; 0, or -1 for a bad record (the steps before it have run)
+int fagpio_seqfile_play(struct fagpio_seqfile *f);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,159 @@
+#include <string.h>
+#include <time.h>
+#include "fagpio_priv.h"
+#include "fagpio_seqstream.h"
+#include "fagpio_atomic.h"
+#include "fagpio_timer.h"
+
+int fagpio_seqstream_init(struct fagpio_seqstream *s, struct fagpio_seq_op *ops, unsigned int capacity,
+		fagpio_seqstream_fill fill, void *arg) {
+	memset(s, 0, sizeof(*s));
+	if (!capacity || !fill)
+		return -1;
+	fagpio_seq_init(&s->block[0], ops, capacity);
+	fagpio_seq_init(&s->block[1], ops + capacity, capacity);
+	s->fill = fill;
+	s->arg = arg;
+	return 0;
+}
+
+void fagpio_seqstream_stop(struct fagpio_seqstream *s) {
+	s->stop = 1;
+}
+
+static void poll_sleep(void) {
+	struct timespec ts = { 0, FAGPIO_SEQSTREAM_POLL_US * 1000 };
+
+	nanosleep(&ts, NULL);
+}
+
+/*
+The generator only writes filled, end and error, and the blocks it owns:
+those between played and played + 2 not yet handed over.
+*/
+static void *generator(void *arg) {
+	struct fagpio_seqstream *s = arg;
+
+	while (!s->stop) {
+		if (s->filled - s->played == 2) {
+			poll_sleep();
+			continue;
+		}
+		fagpio_barrier();
+
+		struct fagpio_seq *b = &s->block[s->filled & 1];
+		int ret;
+
+		fagpio_seq_init(b, b->ops, b->capacity);
+		if ((ret = s->fill(b, s->arg)) < 0) {
+			s->error = 1;
+			break;
+		}
+		fagpio_barrier();
+		s->filled++;
+		if (!ret)
+			break;
+	}
+	fagpio_barrier();
+	s->end = 1;
+	return NULL;
+}
+
+static void wait_until(uint32_t target, uint32_t spin) {
+	int32_t left = target - fagpio_ticks();
+
+	while (left > (int32_t)spin) {
+		uint32_t ns = fagpio_ticks_to_ns(left - spin);
+		struct timespec ts = { ns / 1000000000, ns % 1000000000 };
+
+		nanosleep(&ts, NULL);
+		left = target - fagpio_ticks();
+	}
+	while ((int32_t)(fagpio_ticks() - target) < 0)
+		;
+}
+
+FAGPIO_ARM_CODE static void play_block(struct fagpio_seqstream *s, struct pio_bank *banks, const struct fagpio_seq *b,
+		uint32_t start, uint32_t spin) {
+	for (unsigned int i = 0; i < b->count && !s->stop; i++) {
+		const struct fagpio_seq_op *op = &b->ops[i];
+		uint32_t target = start + op->at;
+
+		if ((int32_t)(fagpio_ticks() - target) > 0)
+			s->late++;
+		else
+			wait_until(target, spin);
+
+		if (!(s->used & (1u << op->port))) {
+			s->cur[op->port] = banks[op->port].dat;
+			s->used |= 1u << op->port;
+		}
+		s->cur[op->port] = (s->cur[op->port] & ~op->mask) | op->value;
+		banks[op->port].dat = s->cur[op->port];
+	}
+}
+
+// Waits for the next block: 1 when there is one, 0 at the end
+static int next_block(struct fagpio_seqstream *s) {
+	while (s->filled == s->played) {
+		if (s->end) {
+			fagpio_barrier();
+			if (s->filled == s->played)
+				return 0;
+			break;
+		}
+		if (s->stop)
+			return 0;
+		poll_sleep();
+	}
+	fagpio_barrier();
+	return 1;
+}
+
+int fagpio_seqstream_play(struct fagpio_seqstream *s) {
+	struct pio_bank *banks = fagpio_banks();
+	uint32_t spin = fagpio_ns_to_ticks(FAGPIO_SEQSTREAM_SPIN_US * 1000);
+	uint32_t start = 0, expected = 0;
+
+	if (!banks)
+		return -1;
+	s->filled = s->played = 0;
+	s->end = s->error = s->stop = 0;
+	s->used = s->blocks = s->late = s->underruns = s->slip = 0;
+	if (pthread_create(&s->thread, NULL, generator, s))
+		return -1;
+
+	while (1) {
+		int ready = s->filled != s->played;
+
+		if (s->stop || !next_block(s))
+			break;
+		if (!s->blocks) {
+			start = fagpio_ticks();
+		} else if (!ready) {
+			uint32_t now = fagpio_ticks();
+
+			s->underruns++;
+			if ((int32_t)(now - expected) > 0) {
+				s->slip += now - expected;
+				start += now - expected;
+			}
+		}
+
+		const struct fagpio_seq *b = &s->block[s->played & 1];
+
+		play_block(s, banks, b, start, spin);
+		start += b->end;
+		expected = start;
+		s->blocks++;
+		fagpio_barrier();
+		s->played++;
+	}
+	pthread_join(s->thread, NULL);
+
+	for (unsigned int port = 0; port < PIO_NPORTS; port++) {
+		if (s->used & (1u << port))
+			fagpio_shadow_sync(port);
+	}
+	return s->error ? -1 : 0;
+}
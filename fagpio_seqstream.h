@@ -0,0 +1,74 @@
+#ifndef _FAGPIO_SEQSTREAM_H
+#define _FAGPIO_SEQSTREAM_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include "fagpio.h"
+#include "fagpio_seq.h"
+
+/*
+ * Streaming sequencer: timelines of any length played from two blocks of
+ * ops (fagpio_seq.h). A generator thread calls fill() for the free block
+ * while the other plays; fill() adds steps with fagpio_seq_add() and the
+ * first delta of a block counts from the last step of the one before, so
+ * the blocks join into one drift-free timeline. The hand-off is a pair of
+ * counters, one per side, ordered by fagpio_barrier() as in
+ * fagpio_ring.h: no lock is taken on either side.
+ *
+ * fill() returns 1 for more blocks to come, 0 for the last one (played,
+ * and may be empty) or -1 to abort, which drops that block.
+ *
+ * The player runs in the caller's thread, which may be SCHED_FIFO
+ * (fagpio_rt.h). It sleeps up to FAGPIO_SEQSTREAM_SPIN_US before each op
+ * and spins the rest, so on the single-core F1C100s the generator gets
+ * the CPU between steps. A block played through while the next is not
+ * ready is an underrun: the player waits for it and the timeline resumes
+ * at once, shifted by the wait, which goes into slip.
+ */
+
+#ifndef FAGPIO_SEQSTREAM_SPIN_US
+#define FAGPIO_SEQSTREAM_SPIN_US	200		//Spun rather than slept before an op
+#endif
+#ifndef FAGPIO_SEQSTREAM_POLL_US
+#define FAGPIO_SEQSTREAM_POLL_US	100		//Sleep of a side waiting for the other
+#endif
+
+struct fagpio_seqstream;
+
+typedef int (*fagpio_seqstream_fill)(struct fagpio_seq *block, void *arg);
+
+struct fagpio_seqstream {
+	struct fagpio_seq block[2];
+	fagpio_seqstream_fill fill;
+	void *arg;
+	pthread_t thread;
+	volatile uint32_t filled;		//Blocks handed over, generator side
+	volatile uint32_t played;		//Blocks given back, player side
+	volatile int end;				//No block after the filled ones
+	volatile int error;				//fill() aborted
+	volatile int stop;
+	uint32_t cur[PIO_NPORTS];	//Port values kept across blocks
+	uint32_t used;					//Ports of cur[] loaded
+	uint32_t blocks;				//Blocks played
+	uint32_t late;					//Ops already overdue
+	uint32_t underruns;
+	uint32_t slip;					//Ticks the timeline was shifted by underruns
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ops holds 2 * capacity ops, capacity per block
+int fagpio_seqstream_init(struct fagpio_seqstream *s, struct fagpio_seq_op *ops, unsigned int capacity,
+	fagpio_seqstream_fill fill, void *arg);
+
+// Plays until the last block or fagpio_seqstream_stop(); 0, or -1 if fill() aborted
+int fagpio_seqstream_play(struct fagpio_seqstream *s);
+void fagpio_seqstream_stop(struct fagpio_seqstream *s);		//From another thread or a signal handler
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
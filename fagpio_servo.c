@@ -0,0 +1,67 @@
+#include <string.h>
+#include "fagpio_servo.h"
+
+int fagpio_servo_init(struct fagpio_servo *s) {
+	memset(s, 0, sizeof(*s));
+	if (fagpio_spwm_init(&s->pwm, FAGPIO_SERVO_PERIOD_US * 1000) < 0)
+		return -1;
+	fagpio_spwm_sleep(&s->pwm, FAGPIO_SERVO_WAKE_US * 1000);
+	return 0;
+}
+
+// 0 for min_us or max_us takes FAGPIO_SERVO_MIN_US or FAGPIO_SERVO_MAX_US
+int fagpio_servo_attach(struct fagpio_servo *s, uint8_t pin, uint16_t min_us, uint16_t max_us) {
+	if (!min_us)
+		min_us = FAGPIO_SERVO_MIN_US;
+	if (!max_us)
+		max_us = FAGPIO_SERVO_MAX_US;
+	if (min_us > max_us || max_us >= FAGPIO_SERVO_PERIOD_US)
+		return -1;
+
+	int ch = fagpio_spwm_add(&s->pwm, pin);
+
+	if (ch < 0)
+		return -1;
+	s->min_us[ch] = min_us;
+	s->max_us[ch] = max_us;
+	if (fagpio_servo_write_us(s, ch, (min_us + max_us) / 2) < 0)
+		return -1;
+	return ch;
+}
+
+int fagpio_servo_write_us(struct fagpio_servo *s, unsigned int channel, unsigned int us) {
+	if (channel >= s->pwm.nchannels)
+		return -1;
+	if (us < s->min_us[channel])
+		us = s->min_us[channel];
+	if (us > s->max_us[channel])
+		us = s->max_us[channel];
+	if (fagpio_spwm_set(&s->pwm, channel, us * 1000) < 0)
+		return -1;
+	s->width_us[channel] = us;
+	return 0;
+}
+
+int fagpio_servo_write(struct fagpio_servo *s, unsigned int channel, unsigned int degrees) {
+	if (channel >= s->pwm.nchannels)
+		return -1;
+	if (degrees > 180)
+		degrees = 180;
+	return fagpio_servo_write_us(s, channel,
+		s->min_us[channel] + (s->max_us[channel] - s->min_us[channel]) * degrees / 180);
+}
+
+int fagpio_servo_detach(struct fagpio_servo *s, unsigned int channel) {
+	if (channel >= s->pwm.nchannels || fagpio_spwm_set(&s->pwm, channel, 0) < 0)
+		return -1;
+	s->width_us[channel] = 0;
+	return 0;
+}
+
+int fagpio_servo_start(struct fagpio_servo *s) {
+	return fagpio_spwm_start(&s->pwm);
+}
+
+void fagpio_servo_stop(struct fagpio_servo *s) {
+	fagpio_spwm_stop(&s->pwm);
+}
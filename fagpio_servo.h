@@ -0,0 +1,50 @@
+#ifndef _FAGPIO_SERVO_H
+#define _FAGPIO_SERVO_H
+
+#include <stdint.h>
+#include "fagpio_spwm.h"
+
+/*
+ * Hobby servos on the software PWM engine (fagpio_spwm.h): one 50 Hz
+ * period for all of them, every pulse rising in one store per port and
+ * the falls following sorted by width, on the AVS counter (42 ns at
+ * 24 MHz). The player sleeps through the gaps, waking
+ * FAGPIO_SERVO_WAKE_US ahead of the rise and of each cluster of falls, so
+ * a dozen servos cost a few percent of the CPU; give it a real-time
+ * priority (fagpio_rt.h) to keep the wakeups on time.
+ *
+ * A pulse width is clamped to the channel's min_us..max_us. Attached
+ * servos start centred; a detached channel sends no pulses and most
+ * servos go limp.
+ */
+
+#define FAGPIO_SERVO_MAX			FAGPIO_SPWM_MAX
+#define FAGPIO_SERVO_PERIOD_US		20000
+#define FAGPIO_SERVO_MIN_US			1000
+#define FAGPIO_SERVO_MAX_US			2000
+#define FAGPIO_SERVO_WAKE_US		200		//Player wakeup ahead of each edge burst
+
+struct fagpio_servo {
+	struct fagpio_spwm pwm;
+	uint16_t min_us[FAGPIO_SERVO_MAX];
+	uint16_t max_us[FAGPIO_SERVO_MAX];
+	uint16_t width_us[FAGPIO_SERVO_MAX];	//Last width set, 0 when detached
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fagpio_servo_init(struct fagpio_servo *s);
+int fagpio_servo_attach(struct fagpio_servo *s, uint8_t pin, uint16_t min_us, uint16_t max_us);	//Returns the channel
+int fagpio_servo_write_us(struct fagpio_servo *s, unsigned int channel, unsigned int us);
+int fagpio_servo_write(struct fagpio_servo *s, unsigned int channel, unsigned int degrees);		//0..180
+int fagpio_servo_detach(struct fagpio_servo *s, unsigned int channel);
+int fagpio_servo_start(struct fagpio_servo *s);		//Plays on a new thread
+void fagpio_servo_stop(struct fagpio_servo *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,86 @@
+#include "fagpio_priv.h"
+#include "fagpio_shiftreg.h"
+
+int fagpio_sr595_init(struct fagpio_sr595 *sr, uint8_t ser, uint8_t srclk, uint8_t rclk, unsigned int nbytes, uint8_t *storage, uint32_t hz) {
+	if (!nbytes || !storage || PIO_PIN_PORT(rclk) >= PIO_NPORTS)
+		return -1;
+	if (fagpio_bbspi_init(&sr->spi, srclk, ser, FAGPIO_BBSPI_NO_PIN, 0, hz) < 0)		//Shifts on the rising edge
+		return -1;
+
+	sr->latch = rclk;
+	sr->nbytes = nbytes;
+	sr->image = storage;
+	sr->sent = storage + nbytes;
+	memset(sr->image, 0, nbytes);
+
+	fagpio_digital_write(fagpio_default(), rclk, LOW);
+	pinMode(rclk, 0);
+	fagpio_sr595_commit(sr);
+	return 0;
+}
+
+// Chip 0 is shifted out last
+static inline uint8_t *image_byte(uint8_t *image, unsigned int nbytes, unsigned int chip) {
+	return &image[nbytes - 1 - chip];
+}
+
+void fagpio_sr595_set(struct fagpio_sr595 *sr, unsigned int bit, uint8_t value) {
+	uint8_t *b;
+
+	if (bit >= sr->nbytes * 8)
+		return;
+	b = image_byte(sr->image, sr->nbytes, bit >> 3);
+	if (value)
+		*b |= 1u << (bit & 7);
+	else
+		*b &= ~(1u << (bit & 7));
+}
+
+uint8_t fagpio_sr595_get(const struct fagpio_sr595 *sr, unsigned int bit) {
+	if (bit >= sr->nbytes * 8)
+		return 0;
+	return (*image_byte(sr->image, sr->nbytes, bit >> 3) >> (bit & 7)) & 1;
+}
+
+void fagpio_sr595_set_byte(struct fagpio_sr595 *sr, unsigned int chip, uint8_t value) {
+	if (chip < sr->nbytes)
+		*image_byte(sr->image, sr->nbytes, chip) = value;
+}
+
+void fagpio_sr595_commit(struct fagpio_sr595 *sr) {
+	fagpio_bbspi_transfer(&sr->spi, sr->image, NULL, sr->nbytes);
+	fagpio_digital_write(fagpio_default(), sr->latch, HIGH);		//Storage registers take the shift registers
+	fagpio_digital_write(fagpio_default(), sr->latch, LOW);
+	memcpy(sr->sent, sr->image, sr->nbytes);
+}
+
+int fagpio_sr595_commit_changed(struct fagpio_sr595 *sr) {
+	if (!memcmp(sr->sent, sr->image, sr->nbytes))
+		return 0;
+	fagpio_sr595_commit(sr);
+	return 1;
+}
+
+int fagpio_sr165_init(struct fagpio_sr165 *sr, uint8_t clk, uint8_t qh, uint8_t load, unsigned int nbytes, uint32_t hz) {
+	if (!nbytes || PIO_PIN_PORT(load) >= PIO_NPORTS)
+		return -1;
+	/*
+	Mode 2: CLK idles high and QH is read after the falling edge, so the
+	first bit (H of chip 0, present as soon as SH/LD returns high) is
+	taken before the first rising edge shifts the chain.
+	*/
+	if (fagpio_bbspi_init(&sr->spi, clk, FAGPIO_BBSPI_NO_PIN, qh, 2, hz) < 0)
+		return -1;
+
+	sr->load = load;
+	sr->nbytes = nbytes;
+	fagpio_digital_write(fagpio_default(), load, HIGH);
+	pinMode(load, 0);
+	return 0;
+}
+
+void fagpio_sr165_read(struct fagpio_sr165 *sr, uint8_t *bits) {
+	fagpio_digital_write(fagpio_default(), sr->load, LOW);		//Parallel load
+	fagpio_digital_write(fagpio_default(), sr->load, HIGH);
+	fagpio_bbspi_transfer(&sr->spi, NULL, bits, sr->nbytes);	//MSB first puts input H at bit 7
+}
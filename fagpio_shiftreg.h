@@ -0,0 +1,59 @@
+#ifndef _FAGPIO_SHIFTREG_H
+#define _FAGPIO_SHIFTREG_H
+
+#include <stdint.h>
+#include "fagpio_bbspi.h"
+
+/*
+ * Daisy-chained 74HC595 outputs and 74HC165 inputs on the bit-banged SPI
+ * path (fagpio_bbspi.h), so SER/SRCLK (or CLK/QH) must share a port.
+ * Bit i of a chain is output or input i % 8 of chip i / 8, chip 0 being
+ * the one wired to the processor.
+ *
+ * The 595 chain keeps an image of all outputs in caller storage, together
+ * with a copy of what was last latched: fagpio_sr595_commit_changed() skips
+ * the transfer and the RCLK pulse when the two are equal.
+ */
+
+struct fagpio_sr595 {
+	struct fagpio_bbspi spi;
+	uint8_t latch;			//RCLK
+	unsigned int nbytes;	//Chips in the chain
+	uint8_t *image;			//Wire order, the last chip first
+	uint8_t *sent;			//Image as last latched
+};
+
+struct fagpio_sr165 {
+	struct fagpio_bbspi spi;
+	uint8_t load;			//SH/LD, active low
+	unsigned int nbytes;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// storage holds 2 * nbytes bytes; the chain starts with every output low
+int fagpio_sr595_init(struct fagpio_sr595 *sr, uint8_t ser, uint8_t srclk, uint8_t rclk, unsigned int nbytes, uint8_t *storage, uint32_t hz);
+
+void fagpio_sr595_set(struct fagpio_sr595 *sr, unsigned int bit, uint8_t value);
+uint8_t fagpio_sr595_get(const struct fagpio_sr595 *sr, unsigned int bit);
+void fagpio_sr595_set_byte(struct fagpio_sr595 *sr, unsigned int chip, uint8_t value);
+
+void fagpio_sr595_commit(struct fagpio_sr595 *sr);
+int fagpio_sr595_commit_changed(struct fagpio_sr595 *sr);		//1 if shifted out, 0 if nothing changed
+
+int fagpio_sr165_init(struct fagpio_sr165 *sr, uint8_t clk, uint8_t qh, uint8_t load, unsigned int nbytes, uint32_t hz);
+
+// Latches all inputs and reads the chain into bits, nbytes bytes
+void fagpio_sr165_read(struct fagpio_sr165 *sr, uint8_t *bits);
+
+static inline uint8_t fagpio_sr_bit(const uint8_t *bits, unsigned int bit) {
+	return (bits[bit >> 3] >> (bit & 7)) & 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,186 @@
+#include <errno.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include "fagpio_priv.h"
+#include "fagpio_shm.h"
+#include "fagpio_atomic.h"
+#include "fagpio_log.h"
+
+#define SHM_MAGIC			0x46414733		//"FAG3", written once the shadows are seeded
+
+struct fagpio_shm {
+	volatile uint32_t magic;
+	volatile uint32_t dat[PIO_NPORTS];		//Shared DAT shadows
+	volatile uint32_t owned[PIO_NPORTS];	//Pins claimed by some process
+	volatile uint32_t owner[PIO_NPORTS][32];	//Pid per claimed pin, 0 while the claim is being published
+};
+
+static struct fagpio_shm *shm;
+static uint32_t mine[PIO_NPORTS];			//Pins this process holds, checked without touching the segment
+
+int fagpio_shm_attach(const char *name) {
+	int created = 1;
+	int fd;
+
+	if (shm)
+		return 0;
+	if (!name)
+		name = FAGPIO_SHM_NAME;
+
+	if ((fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0660)) < 0) {
+		struct stat st;
+
+		created = 0;
+		if ((fd = shm_open(name, O_RDWR, 0)) < 0) {
+			FAGPIO_LOG(FAGPIO_LOG_ERR, "shm_open %s: %s\n", name, strerror(errno));
+			return -1;
+		}
+		// Mapping it before the creator's ftruncate() would fault on the first access
+		for (int i = 0; i < 1000 && fstat(fd, &st) == 0 && st.st_size < (off_t)sizeof(struct fagpio_shm); i++)
+			usleep(100);
+		if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(struct fagpio_shm)) {
+			FAGPIO_LOG(FAGPIO_LOG_ERR, "%s is not a fagpio segment\n", name);
+			close(fd);
+			return -1;
+		}
+	} else if (ftruncate(fd, sizeof(struct fagpio_shm)) < 0) {
+		close(fd);
+		shm_unlink(name);
+		return -1;
+	}
+
+	struct fagpio_shm *s = mmap(NULL, sizeof(*s), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+	close(fd);
+	if (s == MAP_FAILED)
+		return -1;
+
+	if (created) {
+		struct pio_bank *banks = fagpio_banks();
+
+		for (unsigned int port = 0; port < PIO_NPORTS; port++)
+			s->dat[port] = banks ? banks[port].dat : 0;
+		__sync_synchronize();
+		s->magic = SHM_MAGIC;
+	} else {
+		// The creator may still be seeding the shadows
+		for (int i = 0; i < 1000 && s->magic != SHM_MAGIC; i++)
+			usleep(100);
+		if (s->magic != SHM_MAGIC) {
+			FAGPIO_LOG(FAGPIO_LOG_ERR, "%s is not a fagpio segment\n", name);
+			munmap(s, sizeof(*s));
+			return -1;
+		}
+	}
+
+	shm = s;
+	fagpio_shadow_bind(shm->dat);		//Seeded by the creator: no resync over the other processes' updates
+	return 0;
+}
+
+void fagpio_shm_detach(void) {
+	if (!shm)
+		return;
+	for (uint8_t port = 0; port < PIO_NPORTS; port++) {
+		if (mine[port])
+			fagpio_port_unreserve(port, mine[port]);
+	}
+	fagpio_shadow_bind(NULL);
+	munmap(shm, sizeof(*shm));
+	shm = NULL;
+}
+
+/*
+Frees the pins in mask whose owner has exited; 1 if any was freed. Only
+runs on a conflict, so the common case makes no syscall.
+*/
+static int reclaim_dead(uint8_t port, uint32_t mask) {
+	int freed = 0;
+
+	for (unsigned int n = 0; n < 32; n++) {
+		uint32_t pid = shm->owner[port][n];
+		uint32_t old;
+
+		if (!(mask & (1u << n)) || !pid || kill(pid, 0) == 0 || errno != ESRCH)
+			continue;
+		if (!fagpio_cas(&shm->owner[port][n], pid, 0))
+			continue;		//Someone else reclaimed it first
+		do {
+			old = shm->owned[port];
+		} while (!fagpio_cas(&shm->owned[port], old, old & ~(1u << n)));
+		FAGPIO_LOG(FAGPIO_LOG_INFO, "P%c%u: freed from exited pid %u\n", 'A' + port, n, pid);
+		freed = 1;
+	}
+	return freed;
+}
+
+/*
+All-or-nothing claim of the pins in mask with one compare-and-swap on the
+port's ownership word. Pins this process already holds pass without
+touching the segment; 0 when no segment is attached.
+*/
+int fagpio_port_reserve(uint8_t port, uint32_t mask) {
+	if (!shm || port >= PIO_NPORTS)
+		return 0;
+	if (!(mask &= ~mine[port]))
+		return 0;
+
+	volatile uint32_t *owned = &shm->owned[port];
+	uint32_t old;
+
+	for (;;) {
+		old = *owned;
+		if (old & mask) {
+			if (reclaim_dead(port, old & mask))
+				continue;
+
+			unsigned int n = __builtin_ctz(old & mask);
+
+			FAGPIO_LOG(FAGPIO_LOG_ERR, "P%c%u is owned by pid %u\n", 'A' + port, n, shm->owner[port][n]);
+			errno = EBUSY;
+			return -1;
+		}
+		if (fagpio_cas(owned, old, old | mask))
+			break;
+	}
+
+	uint32_t pid = getpid();
+
+	for (uint32_t m = mask; m; m &= m - 1)
+		shm->owner[port][__builtin_ctz(m)] = pid;
+	mine[port] |= mask;
+	return 0;
+}
+
+void fagpio_port_unreserve(uint8_t port, uint32_t mask) {
+	if (!shm || port >= PIO_NPORTS)
+		return;
+	if (!(mask &= mine[port]))
+		return;
+
+	volatile uint32_t *owned = &shm->owned[port];
+	uint32_t old;
+
+	for (uint32_t m = mask; m; m &= m - 1)
+		shm->owner[port][__builtin_ctz(m)] = 0;
+	mine[port] &= ~mask;
+	do {
+		old = *owned;
+	} while (!fagpio_cas(owned, old, old & ~mask));
+}
+
+int fagpio_pin_claim(uint8_t pin) {
+	return fagpio_port_reserve(PIO_PIN_PORT(pin), PIO_PIN_MASK(pin));
+}
+
+void fagpio_pin_release(uint8_t pin) {
+	fagpio_port_unreserve(PIO_PIN_PORT(pin), PIO_PIN_MASK(pin));
+}
+
+uint32_t fagpio_pin_owner(uint8_t pin) {
+	uint8_t port = PIO_PIN_PORT(pin);
+
+	if (!shm || port >= PIO_NPORTS || !(shm->owned[port] & PIO_PIN_MASK(pin)))
+		return 0;
+	return shm->owner[port][PIO_PIN_NUM(pin)];
+}
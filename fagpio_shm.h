@@ -0,0 +1,41 @@
+#ifndef _FAGPIO_SHM_H
+#define _FAGPIO_SHM_H
+
+#include <stdint.h>
+
+/*
+ * Port shadows shared between processes through a /dev/shm segment. Every
+ * attached process updates a port with one compare-and-swap on the shared
+ * shadow and one DAT store, so daemons driving different pins of the same
+ * port no longer clobber each other. Attaching turns shadow mode on.
+ * fagpio_setup() attaches by itself when FAGPIO_SHM is set (empty value
+ * means FAGPIO_SHM_NAME).
+ */
+#define FAGPIO_SHM_NAME		"/fagpio"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fagpio_shm_attach(const char *name);		//NULL attaches FAGPIO_SHM_NAME
+void fagpio_shm_detach(void);
+
+/*
+ * Pin ownership bitmap in the segment, one word per port updated with the
+ * kuser compare-and-swap. pinMode(), pinModeMask() and the peripheral
+ * drivers claim the pins they configure: a pin held by another live
+ * process is left untouched and logged, with errno EBUSY (pinFunction()
+ * and the claims return -1). Pins of exited processes are taken over.
+ * Claims stay until released, DISABLE or detach.
+ */
+int fagpio_pin_claim(uint8_t pin);
+void fagpio_pin_release(uint8_t pin);
+int fagpio_port_reserve(uint8_t port, uint32_t mask);
+void fagpio_port_unreserve(uint8_t port, uint32_t mask);
+uint32_t fagpio_pin_owner(uint8_t pin);			//Pid holding the pin, 0 if free
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,349 @@
+#define _GNU_SOURCE		//REG_ERR and REG_EFL of <sys/ucontext.h>
+#include <errno.h>
+#include <signal.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include "fagpio_priv.h"
+#include "fagpio_sim.h"
+#include "fagpio_eint.h"
+#include "fagpio_log.h"
+
+#if defined(__linux__) && (defined(__x86_64__) || defined(__i386__))
+#define SIM_TRAP		1
+#define TRAP_FLAG		0x100		//EFLAGS.TF: trap after the next instruction
+#define PF_WRITE		0x2			//Page fault error code: the access was a store
+#else
+#define SIM_TRAP		0
+#endif
+
+#define PIO_OFF			GPIO_BASE_OFFSET
+#define EINT_OFF		(GPIO_BASE_OFFSET + rPIO_EINT_BASE)
+#define EINT_PORTS		3		//PD, PE, PF
+#define SIM_LOG			(SIM_TRAP ? FAGPIO_SIM_LOG : 1)		//Untrapped builds log nothing
+
+static unsigned char *window;
+static unsigned long trapped;			//Bytes kept inaccessible from the start of window
+static unsigned int users;
+static uint32_t latch[PIO_NPORTS];		//DAT as last stored
+static uint32_t driven[PIO_NPORTS], level[PIO_NPORTS];
+
+static struct fagpio_sim_access access_log[SIM_LOG];
+static uint32_t log_head;
+static struct fagpio_sim_counts access_counts;
+
+static struct pio_bank *sim_bank(uint8_t port) {
+	return (struct pio_bank *)(window + PIO_OFF) + port;
+}
+
+static struct pio_eint *sim_eint(uint8_t port) {
+	return (struct pio_eint *)(window + EINT_OFF) + (port - PIO_PORT_D);
+}
+
+static void window_open(void) {
+	if (SIM_TRAP)
+		mprotect(window, trapped, PROT_READ | PROT_WRITE);
+}
+
+static void window_close(void) {
+	if (SIM_TRAP)
+		mprotect(window, trapped, PROT_NONE);
+}
+
+// DAT as the PIO returns it: latch for outputs, pin level for inputs and EINT pins
+static uint32_t dat_visible(uint8_t port) {
+	struct pio_bank *b = sim_bank(port);
+	uint32_t v = 0;
+
+	for (unsigned int n = 0; n < PIO_PORT_NPINS(port); n++) {
+		uint32_t fn = (b->cfg[n / 8] >> ((n % 8) * 4)) & 7, bit = 1u << n;
+
+		if (fn == 1) {
+			v |= latch[port] & bit;
+		} else if (fn == 0 || fn == PIO_EINT_FUNC) {
+			uint32_t pull = (b->pull[n / 16] >> ((n % 16) * 2)) & 3;
+
+			if (driven[port] & bit ? level[port] & bit : pull == PULL_UP)
+				v |= bit;
+		}
+	}
+	return v;
+}
+
+#if SIM_TRAP
+static volatile uint32_t *sim_word(uint32_t off) {
+	return (volatile uint32_t *)(window + off);
+}
+
+// Port of a DAT word at off, -1 for any other register
+static int dat_port(uint32_t off) {
+	uint32_t rel = off - PIO_OFF;
+
+	if (off < PIO_OFF || rel >= PIO_NPORTS * PIO_BANK_SIZE || rel % PIO_BANK_SIZE != 0x10)
+		return -1;
+	return rel / PIO_BANK_SIZE;
+}
+
+static int cfg_word(uint32_t off) {
+	uint32_t rel = off - PIO_OFF;
+
+	return off >= PIO_OFF && rel < PIO_NPORTS * PIO_BANK_SIZE && rel % PIO_BANK_SIZE < 0x10;
+}
+
+static int eint_sta(uint32_t off) {
+	uint32_t rel = off - EINT_OFF;
+
+	return off >= EINT_OFF && rel < EINT_PORTS * sizeof(struct pio_eint) && rel % sizeof(struct pio_eint) == offsetof(struct pio_eint, sta);
+}
+
+static void log_access(uint32_t off, int write, uint32_t value) {
+	struct fagpio_sim_access *a = &access_log[log_head++ % SIM_LOG];
+
+	a->value = value;
+	a->offset = off;
+	a->write = write;
+	if (write)
+		access_counts.writes++;
+	else
+		access_counts.reads++;
+}
+
+static void before_read(uint32_t off) {
+	int port = dat_port(off);
+
+	if (port >= 0)
+		*sim_word(off) = dat_visible(port);
+}
+
+// Applies the register semantics to what the stepped store left in the window
+static void after_write(uint32_t off, uint32_t old) {
+	volatile uint32_t *w = sim_word(off);
+	uint32_t stored = *w;
+	int port = dat_port(off);
+
+	if (port >= 0)
+		latch[port] = stored;
+	else if (cfg_word(off))
+		*w = stored & 0x77777777;
+	else if (eint_sta(off))
+		*w = old & ~stored;
+	log_access(off, 1, stored);
+}
+
+/*
+A fault on the window opens the page, prepares the register and sets the
+trap flag; the access then runs for real, and the SIGTRAP after it
+applies the store semantics, logs it and closes the page again.
+*/
+static struct sigaction old_segv, old_trap;
+
+static struct {
+	int active;
+	uint32_t off;
+	uint32_t old;
+	uint8_t write;
+} step;
+
+static void on_segv(int sig, siginfo_t *si, void *ctx) {
+	ucontext_t *uc = ctx;
+	uintptr_t off = (uintptr_t)si->si_addr - (uintptr_t)window;
+
+	if (!window || off >= trapped || step.active) {
+		sigaction(SIGSEGV, &old_segv, NULL);		//Not ours: the fault repeats under the previous action
+		return;
+	}
+	step.off = off & ~3u;
+	step.write = (uc->uc_mcontext.gregs[REG_ERR] & PF_WRITE) != 0;
+	window_open();
+	if (step.write)
+		step.old = *sim_word(step.off);
+	else
+		before_read(step.off);
+	step.active = 1;
+	uc->uc_mcontext.gregs[REG_EFL] |= TRAP_FLAG;
+}
+
+static void on_trap(int sig, siginfo_t *si, void *ctx) {
+	ucontext_t *uc = ctx;
+
+	if (!step.active) {
+		sigaction(SIGTRAP, &old_trap, NULL);
+		raise(SIGTRAP);
+		return;
+	}
+	if (step.write)
+		after_write(step.off, step.old);
+	else
+		log_access(step.off, 0, *sim_word(step.off));
+	window_close();
+	step.active = 0;
+	uc->uc_mcontext.gregs[REG_EFL] &= ~TRAP_FLAG;
+}
+
+static int traps_install(void) {
+	struct sigaction sa;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_flags = SA_SIGINFO;
+	sigfillset(&sa.sa_mask);
+	sa.sa_sigaction = on_segv;
+	if (sigaction(SIGSEGV, &sa, &old_segv) < 0)
+		return -1;
+	sa.sa_sigaction = on_trap;
+	if (sigaction(SIGTRAP, &sa, &old_trap) < 0) {
+		sigaction(SIGSEGV, &old_segv, NULL);
+		return -1;
+	}
+	return 0;
+}
+
+static void traps_remove(void) {
+	sigaction(SIGSEGV, &old_segv, NULL);
+	sigaction(SIGTRAP, &old_trap, NULL);
+}
+#else
+static int traps_install(void) {
+	return 0;
+}
+
+static void traps_remove(void) {
+}
+#endif
+
+// Backend of FAGPIO_BACKEND=sim, called by handle_map() in fagpio.c
+int fagpio_sim_map(struct cpu_peripheral *p) {
+	if (!window) {
+		void *m = mmap(NULL, BLOCK_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+		unsigned long page = sysconf(_SC_PAGESIZE);
+
+		if (m == MAP_FAILED)
+			return -1;
+		if (traps_install() < 0) {
+			munmap(m, BLOCK_SIZE);
+			return -1;
+		}
+		window = m;
+		trapped = page < BLOCK_SIZE ? page : BLOCK_SIZE;
+		memset(latch, 0, sizeof(latch));
+		memset(driven, 0, sizeof(driven));
+		fagpio_sim_log_reset();
+		window_close();
+	}
+	users++;
+	p->map = window;
+	p->addr_p = GPIO_PAGE_OFFSET;		//An F1C100s window, whatever fagpio_soc() says
+	p->addr = (volatile unsigned int *)window;
+	p->size = BLOCK_SIZE;
+	p->mem_fd = -1;
+	p->backend = FAGPIO_BACKEND_SIM;
+	FAGPIO_LOG(FAGPIO_LOG_INFO, "Using the simulated PIO%s\n", SIM_TRAP ? "" : " (untrapped)");
+	return 0;
+}
+
+void fagpio_sim_unmap(struct cpu_peripheral *p) {
+	if (!window || --users)
+		return;
+	traps_remove();
+	munmap(window, BLOCK_SIZE);
+	window = NULL;
+}
+
+int fagpio_sim_trapping(void) {
+	return window && SIM_TRAP;
+}
+
+// Drives the pins from outside and raises EINT status for their triggers
+int fagpio_sim_input(uint8_t port, uint32_t mask, uint32_t value) {
+	if (!window || port >= PIO_NPORTS)
+		return -1;
+	window_open();
+
+	struct pio_bank *b = sim_bank(port);
+
+	if (!SIM_TRAP)
+		latch[port] = b->dat;
+
+	uint32_t before = dat_visible(port);
+
+	driven[port] |= mask;
+	level[port] = (level[port] & ~mask) | (value & mask);
+
+	uint32_t after = dat_visible(port);
+
+	if (port >= PIO_PORT_D) {
+		struct pio_eint *e = sim_eint(port);
+		uint32_t hit = 0;
+
+		for (unsigned int n = 0; n < PIO_PORT_NPINS(port); n++) {
+			uint32_t bit = 1u << n, was = before & bit, now = after & bit;
+
+			if (((b->cfg[n / 8] >> ((n % 8) * 4)) & 7) != PIO_EINT_FUNC)
+				continue;
+			switch ((e->cfg[n / 8] >> ((n % 8) * 4)) & 15) {
+			case RISING:		hit |= !was && now ? bit : 0; break;
+			case FALLING:		hit |= was && !now ? bit : 0; break;
+			case HIGH_LEVEL:	hit |= now; break;
+			case LOW_LEVEL:		hit |= now ? 0 : bit; break;
+			case CHANGE:		hit |= was ^ now; break;
+			}
+		}
+		e->sta |= hit;
+	}
+	if (!SIM_TRAP)
+		b->dat = after;
+	window_close();
+	return 0;
+}
+
+int fagpio_sim_float(uint8_t port, uint32_t mask) {
+	if (!window || port >= PIO_NPORTS)
+		return -1;
+	driven[port] &= ~mask;
+	if (!SIM_TRAP) {
+		struct pio_bank *b = sim_bank(port);
+
+		latch[port] = b->dat;
+		b->dat = dat_visible(port);
+	}
+	return 0;
+}
+
+uint32_t fagpio_sim_output(uint8_t port) {
+	uint32_t out = 0;
+
+	if (!window || port >= PIO_NPORTS)
+		return 0;
+	window_open();
+
+	struct pio_bank *b = sim_bank(port);
+
+	if (!SIM_TRAP)
+		latch[port] = b->dat;
+	for (unsigned int n = 0; n < PIO_PORT_NPINS(port); n++) {
+		if (((b->cfg[n / 8] >> ((n % 8) * 4)) & 7) == 1)
+			out |= latch[port] & (1u << n);
+	}
+	window_close();
+	return out;
+}
+
+void fagpio_sim_counts(struct fagpio_sim_counts *counts) {
+	*counts = access_counts;
+}
+
+unsigned int fagpio_sim_log(struct fagpio_sim_access *out, unsigned int max) {
+	uint32_t n = log_head < SIM_LOG ? log_head : SIM_LOG;
+
+	if (max > n)
+		max = n;
+	for (unsigned int i = 0; i < max; i++)
+		out[i] = access_log[(log_head - n + i) % SIM_LOG];
+	return max;
+}
+
+void fagpio_sim_log_reset(void) {
+	log_head = 0;
+	memset(&access_counts, 0, sizeof(access_counts));
+}
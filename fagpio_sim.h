@@ -0,0 +1,62 @@
+#ifndef _FAGPIO_SIM_H
+#define _FAGPIO_SIM_H
+
+#include <stdint.h>
+
+/*
+ * Simulated PIO for running the library on the build machine.
+ * FAGPIO_BACKEND=sim (or fagpio_open("sim")) maps an anonymous
+ * BLOCK_SIZE window in place of /dev/mem; handles opened on "sim" share
+ * it. Build the host library with `make sim` (libfagpio_sim.so). The
+ * simulated PIO is an F1C100s one, whatever FAGPIO_SOC says.
+ *
+ * On x86 Linux the first page of the window (CCU, INTC, PIO with its EINT
+ * banks, timer) is kept inaccessible. Every load and store faults, is
+ * logged, and is single-stepped with the page open, so the registers
+ * behave like the PIO's:
+ *  - reserved bit 3 of each CFG field reads 0
+ *  - DAT reads the latch for output pins, the level of input and EINT
+ *    pins (driven by fagpio_sim_input(), otherwise their pull), 0 for
+ *    other functions; writes set the latch
+ *  - EINT STA is write-1-to-clear and is set by input edges and levels
+ *    on pins in the EINT function
+ * Every access costs a few microseconds. The accounting is exact for one
+ * thread at a time; a thread touching the page while another's access
+ * is being stepped is not seen. Debuggers using the trap flag conflict.
+ *
+ * Elsewhere the window is plain memory: nothing is logged, and
+ * fagpio_sim_input() writes the input levels into DAT.
+ */
+
+#define FAGPIO_SIM_LOG		4096	//Accesses kept, oldest dropped first
+
+struct fagpio_sim_access {
+	uint32_t value;			//Value read, or value stored
+	uint16_t offset;		//From the start of the window (PIO is at GPIO_BASE_OFFSET)
+	uint8_t write;
+	uint8_t pad;
+};
+
+struct fagpio_sim_counts {
+	uint32_t reads;
+	uint32_t writes;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fagpio_sim_trapping(void);		//Non-zero if accesses are trapped and logged
+int fagpio_sim_input(uint8_t port, uint32_t mask, uint32_t level);	//Drives input pins from outside
+int fagpio_sim_float(uint8_t port, uint32_t mask);					//Releases them to their pulls
+uint32_t fagpio_sim_output(uint8_t port);		//Levels of the pins in output mode
+
+void fagpio_sim_counts(struct fagpio_sim_counts *counts);		//Since the last fagpio_sim_log_reset()
+unsigned int fagpio_sim_log(struct fagpio_sim_access *out, unsigned int max);	//Oldest first
+void fagpio_sim_log_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
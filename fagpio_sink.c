@@ -0,0 +1,84 @@
+#include <errno.h>
+#include <netdb.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include "fagpio_sink.h"
+#include "fagpio_log.h"
+
+// Blocks go out as they fill, so Nagle would only add latency to the last one
+static void sink_tune(int fd) {
+	int size = FAGPIO_SINK_SNDBUF, one = 1;
+
+	setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+int fagpio_sink_connect(const char *host, uint16_t port) {
+	struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM }, *res;
+	int fd, err;
+
+	if ((err = getaddrinfo(host, NULL, &hints, &res))) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "%s: %s\n", host, gai_strerror(err));
+		return -1;
+	}
+	((struct sockaddr_in *)res->ai_addr)->sin_port = htons(port);
+	if ((fd = socket(AF_INET, SOCK_STREAM, 0)) >= 0 && connect(fd, res->ai_addr, res->ai_addrlen) < 0) {
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(res);
+	if (fd < 0) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "%s:%u: %s\n", host, port, strerror(errno));
+		return -1;
+	}
+	sink_tune(fd);
+	return fd;
+}
+
+int fagpio_sink_listen(uint16_t port) {
+	struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = htonl(INADDR_ANY) };
+	int sock, fd, one = 1;
+
+	if ((sock = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+		return -1;
+	if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0 ||
+		bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(sock, 1) < 0) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "port %u: %s\n", port, strerror(errno));
+		close(sock);
+		return -1;
+	}
+	while ((fd = accept(sock, NULL, NULL)) < 0 && errno == EINTR)
+		;
+	close(sock);
+	if (fd >= 0)
+		sink_tune(fd);
+	return fd;
+}
+
+int fagpio_sink_writev(int fd, struct iovec *iov, int count) {
+	int sock = 1;
+
+	while (count) {
+		struct msghdr msg = { .msg_iov = iov, .msg_iovlen = count };
+		ssize_t n = sock ? sendmsg(fd, &msg, MSG_NOSIGNAL) : writev(fd, iov, count);
+
+		if (n < 0 && sock && errno == ENOTSOCK) {
+			sock = 0;
+			continue;
+		}
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -1;
+		for (; count && (size_t)n >= iov->iov_len; iov++, count--)
+			n -= iov->iov_len;
+		if (count) {
+			iov->iov_base = (char *)iov->iov_base + n;
+			iov->iov_len -= n;
+		}
+	}
+	return 0;
+}
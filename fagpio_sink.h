@@ -0,0 +1,39 @@
+#ifndef _FAGPIO_SINK_H
+#define _FAGPIO_SINK_H
+
+#include <stdint.h>
+#include <sys/uio.h>
+
+/*
+ * Network sink for capture streams. fagpio_sink_connect() opens a TCP
+ * connection with a large send buffer and fagpio_sink_listen() waits for
+ * one client; either fd can be given to fagpio_la_capture() and friends
+ * or to fagpio_trace_send().
+ *
+ * fagpio_sink_writev() sends blocks where they lie: the iovec is handed to
+ * sendmsg() (writev() for files and pipes) and advanced over partial
+ * sends, so no block is copied into a staging buffer on the way. The
+ * kernel still copies each byte once into the socket buffer. A closed
+ * peer is an error, not a SIGPIPE.
+ */
+
+#ifndef FAGPIO_SINK_SNDBUF
+#define FAGPIO_SINK_SNDBUF	(256 * 1024)
+#endif
+#define FAGPIO_SINK_IOV		16		//Largest iovec the capture writers build
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fagpio_sink_connect(const char *host, uint16_t port);		//IPv4 address or name, -1 on error
+int fagpio_sink_listen(uint16_t port);		//Blocks until a client connects, -1 on error
+
+// Sends all of iov, whose entries it modifies; 0 or -1 with errno set
+int fagpio_sink_writev(int fd, struct iovec *iov, int count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,338 @@
+#include <string.h>
+#include "fagpio_priv.h"
+#include "fagpio_slave.h"
+#include "fagpio_eint.h"
+#include "fagpio_soc.h"
+#include "fagpio_timer.h"
+#include "fagpio_log.h"
+
+#define IDLE_CHECK		256			//Unchanged snapshots between counter reads
+
+enum { I2C_IDLE, I2C_ADDR, I2C_WRITE, I2C_READ, I2C_IGNORE };
+
+static struct fagpio_slave_xfer scratch;	//Written when the ring is full
+
+// The ring's next slot, or scratch if it is full
+static struct fagpio_slave_xfer *xfer_begin(struct fagpio_slave_ring *r, uint8_t addr, uint8_t flags) {
+	struct fagpio_slave_xfer *x = r->head - r->tail == FAGPIO_SLAVE_RING_SIZE ? &scratch : &r->xfer[r->head & (FAGPIO_SLAVE_RING_SIZE - 1)];
+
+	x->len = 0;
+	x->addr = addr;
+	x->flags = flags;
+	return x;
+}
+
+static inline void xfer_byte(struct fagpio_slave_xfer *x, uint8_t b) {
+	if (x->len < FAGPIO_SLAVE_DATA)
+		x->data[x->len] = b;
+	else
+		x->flags |= FAGPIO_SLAVE_TRUNCATED;
+	if (x->len < UINT16_MAX)
+		x->len++;
+}
+
+static void xfer_end(struct fagpio_slave_ring *r, struct fagpio_slave_xfer *x, uint8_t flags) {
+	x->ticks = fagpio_ticks();
+	x->flags |= flags;
+	if (x == &scratch) {
+		r->dropped++;
+		return;
+	}
+	fagpio_barrier();
+	r->head++;
+}
+
+static int same_eint_port(uint8_t a, uint8_t b) {
+	return PIO_PIN_PORT(a) == PIO_PIN_PORT(b) && PIO_PIN_PORT(a) < PIO_NPORTS;
+}
+
+int fagpio_spislave_open(struct fagpio_spislave *s, uint8_t cs, uint8_t sck, uint8_t mosi, uint8_t miso, uint8_t mode, struct fagpio_slave_ring *ring) {
+	memset(s, 0, sizeof(*s));
+	if (!ring || mode > 3 || !same_eint_port(cs, sck) || !same_eint_port(cs, mosi) ||
+		(miso != FAGPIO_SLAVE_NO_PIN && !same_eint_port(cs, miso)) || fagpio_soc_eint_bank(PIO_PIN_PORT(cs)) < 0) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "SPI slave: the pins must share a port with EINT\n");
+		return -1;
+	}
+	s->port = PIO_PIN_PORT(cs);
+	s->cs = cs;
+	s->miso = miso;
+	s->cs_mask = PIO_PIN_MASK(cs);
+	s->sck_mask = PIO_PIN_MASK(sck);
+	s->mosi_mask = PIO_PIN_MASK(mosi);
+	s->miso_mask = miso != FAGPIO_SLAVE_NO_PIN ? PIO_PIN_MASK(miso) : 0;
+	s->cpha = mode & 1;
+	s->sample_rising = (mode >> 1) == (mode & 1);
+	s->ring = ring;
+	fagpio_slave_ring_init(ring);
+
+	pinMode(sck, INPUT);
+	pinMode(mosi, INPUT);
+	if (miso != FAGPIO_SLAVE_NO_PIN)
+		pinMode(miso, INPUT);
+	return attachInterrupt(cs, FALLING) < 0 ? -1 : 0;
+}
+
+void fagpio_spislave_reply(struct fagpio_spislave *s, const uint8_t *buf, size_t len) {
+	s->reply = buf;
+	s->reply_len = len;
+}
+
+static inline uint32_t miso_bit(const struct fagpio_spislave *s, uint32_t n) {
+	uint8_t b = n / 8 < s->reply_len ? s->reply[n / 8] : 0xFF;
+
+	return (b >> (7 - (n & 7))) & 1 ? s->miso_mask : 0;
+}
+
+/*
+One frame, chip select low: each snapshot is compared with the last for
+a clock edge. The sampling edge shifts MOSI in; the other one puts the
+next MISO bit out, and with CPHA 0 the first bit goes out before the
+first edge.
+*/
+static void spi_frame(struct fagpio_spislave *s, volatile uint32_t *dat) {
+	struct fagpio_slave_xfer *x = xfer_begin(s->ring, 0, 0);
+	uint32_t frame_ticks = (uint64_t)FAGPIO_SLAVE_FRAME_MS * fagpio_tick_hz / 1000;
+	uint32_t prev = *dat, last = fagpio_ticks(), out = 0;
+	unsigned int bits = 0, idle = 0;
+	uint8_t byte = 0, flags = 0;
+
+	if (s->miso_mask) {
+		*dat = (prev & ~s->miso_mask) | (s->cpha ? 0 : miso_bit(s, out++));
+		pinMode(s->miso, OUTPUT);
+	}
+	for (;;) {
+		uint32_t v = *dat;
+
+		if (v & s->cs_mask)
+			break;
+		if (!((v ^ prev) & s->sck_mask)) {
+			if (++idle % IDLE_CHECK == 0 && fagpio_ticks() - last > frame_ticks) {
+				flags |= FAGPIO_SLAVE_PARTIAL;
+				break;
+			}
+			continue;
+		}
+		idle = 0;
+		prev = v;
+		if (((v & s->sck_mask) != 0) == s->sample_rising) {
+			byte = (byte << 1) | ((v & s->mosi_mask) != 0);
+			if (++bits == 8) {
+				xfer_byte(x, byte);
+				bits = 0;
+			}
+		} else if (s->miso_mask) {
+			*dat = (v & ~s->miso_mask) | miso_bit(s, out++);
+		}
+		last = fagpio_ticks();
+	}
+	if (s->miso_mask)
+		pinMode(s->miso, INPUT);
+	xfer_end(s->ring, x, flags | (bits ? FAGPIO_SLAVE_PARTIAL : 0));
+}
+
+int fagpio_spislave_wait(struct fagpio_spislave *s, int timeout_ms) {
+	struct pio_bank *banks = fagpio_banks();
+
+	if (!banks || !s->ring)
+		return -1;
+
+	volatile uint32_t *dat = &banks[s->port].dat;
+
+	// Chip select may have fallen before we slept
+	if ((*dat & s->cs_mask) && !fagpio_eint_wait(s->port, timeout_ms))
+		return 0;
+	if (*dat & s->cs_mask) {
+		fagpio_eint_ack(s->port);
+		return 0;		//Frame over before we woke
+	}
+	spi_frame(s, dat);
+	fagpio_eint_ack(s->port);
+	return 1;
+}
+
+void fagpio_spislave_close(struct fagpio_spislave *s) {
+	if (s->ring)
+		detachInterrupt(s->cs);
+	s->ring = NULL;
+}
+
+int fagpio_i2cslave_open(struct fagpio_i2cslave *s, uint8_t scl, uint8_t sda, uint8_t address, struct fagpio_slave_ring *ring) {
+	struct pio_bank *banks = fagpio_banks();
+	unsigned int shift = (PIO_PIN_NUM(sda) & 7) * 4;
+
+	memset(s, 0, sizeof(*s));
+	if (!banks || !ring || address > 0x7F || !same_eint_port(scl, sda) || fagpio_soc_eint_bank(PIO_PIN_PORT(sda)) < 0) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "I2C slave: SCL and SDA must share a port with EINT\n");
+		return -1;
+	}
+	s->port = PIO_PIN_PORT(sda);
+	s->address = address;
+	s->sda = sda;
+	s->scl_mask = PIO_PIN_MASK(scl);
+	s->sda_mask = PIO_PIN_MASK(sda);
+	s->sda_cfg = &banks[s->port].cfg[PIO_PIN_NUM(sda) >> 3];
+	s->sda_field = 15u << shift;
+	s->sda_release = (uint32_t)PIO_EINT_FUNC << shift;
+	s->sda_drive = 1u << shift;
+	s->ring = ring;
+	fagpio_slave_ring_init(ring);
+
+	pinMode(scl, INPUT);
+	digitalWrite(sda, LOW);		//Level of SDA whenever it is an output
+	return attachInterrupt(sda, FALLING) < 0 ? -1 : 0;
+}
+
+void fagpio_i2cslave_reply(struct fagpio_i2cslave *s, const uint8_t *buf, size_t len) {
+	s->reply = buf;
+	s->reply_len = len;
+}
+
+void fagpio_i2cslave_reply_cb(struct fagpio_i2cslave *s, fagpio_slave_reply_cb cb, void *arg) {
+	s->cb = cb;
+	s->arg = arg;
+}
+
+static inline void sda_low(const struct fagpio_i2cslave *s) {
+	*s->sda_cfg = (*s->sda_cfg & ~s->sda_field) | s->sda_drive;
+}
+
+static inline void sda_release(const struct fagpio_i2cslave *s) {
+	*s->sda_cfg = (*s->sda_cfg & ~s->sda_field) | s->sda_release;
+}
+
+static inline void sda_bit(const struct fagpio_i2cslave *s, int bit) {
+	if (bit)
+		sda_release(s);
+	else
+		sda_low(s);
+}
+
+/*
+Edges of SCL and SDA from consecutive snapshots: SDA changing while SCL
+is high is a START or STOP, SCL rising samples a bit (clk counts them, the
+ninth is the acknowledge) and SCL falling is when SDA may change, so the
+slave drives its ACK and read data there.
+*/
+int fagpio_i2cslave_wait(struct fagpio_i2cslave *s, int timeout_ms) {
+	struct pio_bank *banks = fagpio_banks();
+
+	if (!banks || !s->ring)
+		return -1;
+	if (!fagpio_eint_wait(s->port, timeout_ms))
+		return 0;
+
+	volatile uint32_t *dat = &banks[s->port].dat;
+	uint32_t idle_ticks = (uint64_t)FAGPIO_SLAVE_IDLE_US * fagpio_tick_hz / 1000000;
+	uint32_t prev = *dat, last = fagpio_ticks();
+	struct fagpio_slave_xfer *x = NULL;
+	uint8_t written[FAGPIO_SLAVE_DATA];
+	const uint8_t *tx = NULL;
+	size_t nwritten = 0, tx_len = 0, tx_pos = 0;
+	unsigned int clk = 0, idle = 0, state = I2C_IDLE;
+	int got = 0, nack = 0, first = 0;
+	uint8_t byte = 0, out = 0;
+
+	for (;;) {
+		uint32_t v = *dat;
+
+		if (v == prev) {
+			if (++idle % IDLE_CHECK == 0 && fagpio_ticks() - last > idle_ticks)
+				break;
+			continue;
+		}
+		idle = 0;
+
+		uint32_t scl = v & s->scl_mask, pscl = prev & s->scl_mask;
+		uint32_t sda = v & s->sda_mask;
+
+		prev = v;
+		if (scl && pscl) {
+			if (x) {
+				xfer_end(s->ring, x, 0);
+				x = NULL;
+				got++;
+			}
+			sda_release(s);
+			if (!sda) {			//START, or repeated START
+				state = I2C_ADDR;
+				clk = 0;
+				byte = 0;
+			} else {			//STOP
+				state = I2C_IDLE;
+				nwritten = 0;
+			}
+		} else if (scl) {
+			if (++clk <= 8)
+				byte = (byte << 1) | (sda != 0);
+			else if (state == I2C_READ)
+				nack = sda != 0;
+		} else if (pscl) {
+			if (clk == 8) {
+				switch (state) {
+				case I2C_ADDR:
+					if ((byte >> 1) != s->address) {
+						state = I2C_IGNORE;
+						break;
+					}
+					sda_low(s);
+					x = xfer_begin(s->ring, s->address, (byte & 1) ? FAGPIO_SLAVE_READ : 0);
+					if (byte & 1) {
+						tx = s->cb ? s->cb(written, nwritten, &tx_len, s->arg) : s->reply;
+						if (!s->cb)
+							tx_len = s->reply_len;
+						tx_pos = 0;
+						first = 1;
+						state = I2C_READ;
+					} else {
+						state = I2C_WRITE;
+					}
+					break;
+				case I2C_WRITE:
+					xfer_byte(x, byte);
+					if (nwritten < sizeof(written))
+						written[nwritten++] = byte;
+					sda_low(s);
+					break;
+				case I2C_READ:
+					sda_release(s);		//The master acknowledges
+					break;
+				}
+			} else if (clk == 9) {
+				if (state == I2C_WRITE) {
+					sda_release(s);
+				} else if (state == I2C_READ) {
+					if (first || !nack) {
+						out = tx_pos < tx_len ? tx[tx_pos] : 0xFF;
+						tx_pos++;
+						xfer_byte(x, out);
+						sda_bit(s, out & 0x80);
+						first = 0;
+					} else {
+						sda_release(s);
+						state = I2C_IGNORE;
+					}
+				}
+				clk = 0;
+				byte = 0;
+			} else if (state == I2C_READ) {
+				sda_bit(s, out & (0x80 >> clk));
+			}
+		}
+		last = fagpio_ticks();
+	}
+	sda_release(s);
+	if (x) {
+		xfer_end(s->ring, x, FAGPIO_SLAVE_PARTIAL);
+		got++;
+	}
+	fagpio_eint_ack(s->port);
+	return got;
+}
+
+void fagpio_i2cslave_close(struct fagpio_i2cslave *s) {
+	if (s->ring) {
+		sda_release(s);
+		detachInterrupt(s->sda);
+	}
+	s->ring = NULL;
+}
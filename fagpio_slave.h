@@ -0,0 +1,132 @@
+#ifndef _FAGPIO_SLAVE_H
+#define _FAGPIO_SLAVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fagpio_ring.h"
+
+/*
+ * SPI and I2C slaves emulated on GPIO pins. The pins share one port with
+ * an EINT bank (fagpio_eint.h); the slave sleeps on the chip select's or
+ * SDA's interrupt and, once woken, samples the whole port in a loop, one
+ * DAT read per step, decoding clock edges from the snapshots until the
+ * frame ends. No CPU is used between frames. Completed transfers go into
+ * an SPSC ring laid out like fagpio_ring.h, for a consumer thread.
+ *
+ * The waking takes the interrupt's latency, tens of microseconds:
+ * - SPI: the master must leave that long between chip select and the
+ *   first clock. The clock rate is limited by the loop, a few hundred
+ *   kHz on the F1C100s. MISO is driven only while chip select is low,
+ *   from the buffer given with fagpio_spislave_reply(), then 0xFF.
+ * - I2C: the transaction that wakes the slave is missed and not
+ *   acknowledged. The slave then keeps sampling until the bus has been
+ *   idle for FAGPIO_SLAVE_IDLE_US, so a master that retries a NACK is
+ *   answered. SDA and SCL are open drain with external pull-ups; SDA is
+ *   pulled low by switching the pin to output with DAT 0. Standard mode
+ *   (100 kHz) is within reach of the loop; the slave does not stretch
+ *   SCL.
+ *
+ * A read's data comes from the reply callback, called with what the
+ * master wrote earlier in the same transaction (the register address
+ * before a repeated start), or from the fagpio_i2cslave_reply() buffer.
+ */
+
+#define FAGPIO_SLAVE_NO_PIN		0xFF
+#define FAGPIO_SLAVE_DATA		56			//Bytes kept per transfer
+#define FAGPIO_SLAVE_RING_SIZE	64			//Power of two
+#ifndef FAGPIO_SLAVE_IDLE_US
+#define FAGPIO_SLAVE_IDLE_US	20000
+#endif
+#ifndef FAGPIO_SLAVE_FRAME_MS
+#define FAGPIO_SLAVE_FRAME_MS	100			//SPI: chip select held this long without a clock ends the frame
+#endif
+
+// Transfer flags
+#define FAGPIO_SLAVE_READ		(1u << 0)	//I2C: master read, data is what was sent
+#define FAGPIO_SLAVE_TRUNCATED	(1u << 1)	//More than FAGPIO_SLAVE_DATA bytes; len counts them all
+#define FAGPIO_SLAVE_PARTIAL	(1u << 2)	//Ended without chip select rising or a STOP, or bits left over
+
+struct fagpio_slave_xfer {
+	uint32_t ticks;			//fagpio_ticks() at the end
+	uint16_t len;			//Bytes
+	uint8_t addr;			//I2C: 7-bit address, 0 for SPI
+	uint8_t flags;			//FAGPIO_SLAVE_*
+	uint8_t data[FAGPIO_SLAVE_DATA];	//SPI: MOSI; I2C: written or read bytes
+};
+
+struct fagpio_slave_ring {
+	volatile uint32_t head __attribute__((aligned(FAGPIO_CACHE_LINE)));	//Producer side
+	uint32_t dropped;
+	volatile uint32_t tail __attribute__((aligned(FAGPIO_CACHE_LINE)));	//Consumer side
+	struct fagpio_slave_xfer xfer[FAGPIO_SLAVE_RING_SIZE] __attribute__((aligned(FAGPIO_CACHE_LINE)));
+};
+
+// Returns the bytes to send for a read and their count in *len
+typedef const uint8_t *(*fagpio_slave_reply_cb)(const uint8_t *written, size_t n, size_t *len, void *arg);
+
+struct fagpio_spislave {
+	uint8_t port;
+	uint8_t cs, miso;			//Pins; miso may be FAGPIO_SLAVE_NO_PIN
+	uint32_t cs_mask, sck_mask, mosi_mask, miso_mask;
+	uint8_t sample_rising;		//Mode: CPOL == CPHA samples on the rising edge
+	uint8_t cpha;
+	const uint8_t *reply;
+	size_t reply_len;
+	struct fagpio_slave_ring *ring;
+};
+
+struct fagpio_i2cslave {
+	uint8_t port;
+	uint8_t address;			//7 bits
+	uint8_t sda;
+	uint32_t scl_mask, sda_mask;
+	volatile uint32_t *sda_cfg;	//CFG word of SDA
+	uint32_t sda_field;			//SDA's bits in it
+	uint32_t sda_release, sda_drive;	//Those bits for the EINT and the output function
+	fagpio_slave_reply_cb cb;
+	void *arg;
+	const uint8_t *reply;
+	size_t reply_len;
+	struct fagpio_slave_ring *ring;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// mode 0-3; the pins on one EINT port
+int fagpio_spislave_open(struct fagpio_spislave *s, uint8_t cs, uint8_t sck, uint8_t mosi, uint8_t miso, uint8_t mode, struct fagpio_slave_ring *ring);
+void fagpio_spislave_reply(struct fagpio_spislave *s, const uint8_t *buf, size_t len);	//Sent in the next frames until changed
+int fagpio_spislave_wait(struct fagpio_spislave *s, int timeout_ms);	//Frames received, 0 on timeout, -1 on error
+void fagpio_spislave_close(struct fagpio_spislave *s);
+
+int fagpio_i2cslave_open(struct fagpio_i2cslave *s, uint8_t scl, uint8_t sda, uint8_t address, struct fagpio_slave_ring *ring);
+void fagpio_i2cslave_reply(struct fagpio_i2cslave *s, const uint8_t *buf, size_t len);
+void fagpio_i2cslave_reply_cb(struct fagpio_i2cslave *s, fagpio_slave_reply_cb cb, void *arg);	//Takes precedence over the buffer
+int fagpio_i2cslave_wait(struct fagpio_i2cslave *s, int timeout_ms);	//Transactions addressed to us, 0 on timeout, -1 on error
+void fagpio_i2cslave_close(struct fagpio_i2cslave *s);
+
+static inline void fagpio_slave_ring_init(struct fagpio_slave_ring *r) {
+	r->head = r->tail = r->dropped = 0;
+}
+
+// Consumer only; copies up to max transfers into out and returns how many
+static inline unsigned int fagpio_slave_ring_pop(struct fagpio_slave_ring *r, struct fagpio_slave_xfer *out, unsigned int max) {
+	uint32_t tail = r->tail;
+	uint32_t n = r->head - tail;
+
+	if (n > max)
+		n = max;
+	fagpio_barrier();
+	for (uint32_t i = 0; i < n; i++)
+		out[i] = r->xfer[(tail + i) & (FAGPIO_SLAVE_RING_SIZE - 1)];
+	fagpio_barrier();
+	r->tail = tail + n;
+	return n;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
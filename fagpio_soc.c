@@ -0,0 +1,148 @@
+#include <string.h>
+#include "fagpio_soc.h"
+#include "fagpio_log.h"
+
+#define WINDOW			0x01C20000		//CCU, INTC, PIO and timer, the same on all of them
+
+// Same die: the F1C200s only adds DRAM in the package
+#define SUNIV(name, compatible)	\
+	{ \
+		name, compatible, WINDOW, BLOCK_SIZE, 0x01C20800, \
+		6, { 4, 4, 4, 22, 13, 6, 0 }, \
+		3, { PIO_PORT_D, PIO_PORT_E, PIO_PORT_F }, 1, \
+		{ \
+			[FAGPIO_REGION_CCU]		= { 0x01C20000, 0x400 }, \
+			[FAGPIO_REGION_INTC]	= { 0x01C20400, 0x400 }, \
+			[FAGPIO_REGION_PIO]		= { 0x01C20800, 0x400 }, \
+			[FAGPIO_REGION_TIMER]	= { 0x01C20C00, 0x400 }, \
+			[FAGPIO_REGION_PWM]		= { 0x01C21000, 0x400 }, \
+			[FAGPIO_REGION_KEYADC]	= { 0x01C23400, 0x400 }, \
+			[FAGPIO_REGION_TPADC]	= { 0x01C24800, 0x400 }, \
+			[FAGPIO_REGION_DMA]		= { 0x01C02000, 0x1000 }, \
+			[FAGPIO_REGION_SPI0]	= { 0x01C05000, 0x1000 }, \
+			[FAGPIO_REGION_SPI1]	= { 0x01C06000, 0x1000 }, \
+			[FAGPIO_REGION_UART0]	= { 0x01C25000, 0x400 }, \
+			[FAGPIO_REGION_UART1]	= { 0x01C25400, 0x400 }, \
+			[FAGPIO_REGION_UART2]	= { 0x01C25800, 0x400 }, \
+			[FAGPIO_REGION_TWI0]	= { 0x01C27000, 0x400 }, \
+			[FAGPIO_REGION_TWI1]	= { 0x01C27400, 0x400 }, \
+			[FAGPIO_REGION_TWI2]	= { 0x01C27800, 0x400 }, \
+		}, \
+	}
+
+static const struct fagpio_soc socs[] = {
+	SUNIV("f1c100s", "allwinner,suniv-f1c100s"),
+	SUNIV("f1c200s", "allwinner,suniv-f1c200s"),
+	// PB, PC, PE, PF, PG; interrupts go through the GIC, so no INTC block
+	{
+		"v3s", "allwinner,sun8i-v3s", WINDOW, BLOCK_SIZE, 0x01C20800,
+		7, { 0, 10, 4, 0, 25, 7, 6 },
+		2, { PIO_PORT_B, PIO_PORT_G }, 0,
+		{
+			[FAGPIO_REGION_CCU]		= { 0x01C20000, 0x400 },
+			[FAGPIO_REGION_PIO]		= { 0x01C20800, 0x400 },
+			[FAGPIO_REGION_TIMER]	= { 0x01C20C00, 0x400 },
+			[FAGPIO_REGION_PWM]		= { 0x01C21400, 0x400 },
+			[FAGPIO_REGION_KEYADC]	= { 0x01C22800, 0x400 },
+			[FAGPIO_REGION_DMA]		= { 0x01C02000, 0x1000 },
+			[FAGPIO_REGION_SPI0]	= { 0x01C68000, 0x1000 },
+			[FAGPIO_REGION_UART0]	= { 0x01C28000, 0x400 },
+			[FAGPIO_REGION_UART1]	= { 0x01C28400, 0x400 },
+			[FAGPIO_REGION_UART2]	= { 0x01C28800, 0x400 },
+			[FAGPIO_REGION_TWI0]	= { 0x01C2AC00, 0x400 },
+			[FAGPIO_REGION_TWI1]	= { 0x01C2B000, 0x400 },
+		},
+	},
+	// PA, PC-PG (PL is on the separate R_PIO)
+	{
+		"h3", "allwinner,sun8i-h3", WINDOW, BLOCK_SIZE, 0x01C20800,
+		7, { 22, 0, 19, 18, 16, 7, 14 },
+		2, { PIO_PORT_A, PIO_PORT_G }, 0,
+		{
+			[FAGPIO_REGION_CCU]		= { 0x01C20000, 0x400 },
+			[FAGPIO_REGION_PIO]		= { 0x01C20800, 0x400 },
+			[FAGPIO_REGION_TIMER]	= { 0x01C20C00, 0x400 },
+			[FAGPIO_REGION_PWM]		= { 0x01C21400, 0x400 },
+			[FAGPIO_REGION_KEYADC]	= { 0x01C21800, 0x400 },
+			[FAGPIO_REGION_DMA]		= { 0x01C02000, 0x1000 },
+			[FAGPIO_REGION_SPI0]	= { 0x01C68000, 0x1000 },
+			[FAGPIO_REGION_SPI1]	= { 0x01C69000, 0x1000 },
+			[FAGPIO_REGION_UART0]	= { 0x01C28000, 0x400 },
+			[FAGPIO_REGION_UART1]	= { 0x01C28400, 0x400 },
+			[FAGPIO_REGION_UART2]	= { 0x01C28800, 0x400 },
+			[FAGPIO_REGION_TWI0]	= { 0x01C2AC00, 0x400 },
+			[FAGPIO_REGION_TWI1]	= { 0x01C2B000, 0x400 },
+			[FAGPIO_REGION_TWI2]	= { 0x01C2B400, 0x400 },
+		},
+	},
+};
+
+#define NSOCS			(sizeof(socs) / sizeof(socs[0]))
+
+static const struct fagpio_soc *current;
+
+const struct fagpio_soc *fagpio_soc_find(const char *name) {
+	for (unsigned int i = 0; name && i < NSOCS; i++) {
+		if (!strcmp(name, socs[i].name) || !strcmp(name, socs[i].compatible))
+			return &socs[i];
+	}
+	return NULL;
+}
+
+/*
+The compatible property is a list of NUL-terminated strings, most specific
+first ("licheepi,nano\0allwinner,suniv-f1c100s\0"): the first one that
+names a known SoC wins.
+*/
+static const struct fagpio_soc *detect(void) {
+	const char *want = getenv("FAGPIO_SOC");
+	const struct fagpio_soc *soc = NULL;
+	char buf[256];
+
+	if (want && *want) {
+		if ((soc = fagpio_soc_find(want)))
+			return soc;
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "FAGPIO_SOC=%s is unknown\n", want);
+	}
+
+	int fd = open("/proc/device-tree/compatible", O_RDONLY);
+	ssize_t n = fd < 0 ? -1 : read(fd, buf, sizeof(buf) - 1);
+
+	if (fd >= 0)
+		close(fd);
+	if (n > 0) {
+		buf[n] = '\0';
+		for (char *s = buf; s < buf + n && !soc; s += strlen(s) + 1)
+			soc = fagpio_soc_find(s);
+	}
+	if (!soc) {
+		soc = &socs[0];
+		FAGPIO_LOG(FAGPIO_LOG_INFO, "SoC not recognised, assuming the %s\n", soc->name);
+	}
+	return soc;
+}
+
+const struct fagpio_soc *fagpio_soc(void) {
+	if (!current)
+		current = detect();
+	return current;
+}
+
+int fagpio_soc_select(const char *name) {
+	const struct fagpio_soc *soc = fagpio_soc_find(name);
+
+	if (!soc)
+		return -1;
+	current = soc;
+	return 0;
+}
+
+int fagpio_soc_eint_bank(uint8_t port) {
+	const struct fagpio_soc *soc = fagpio_soc();
+
+	for (unsigned int i = 0; i < soc->eint_banks; i++) {
+		if (soc->eint_port[i] == port)
+			return i;
+	}
+	return -1;
+}
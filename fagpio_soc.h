@@ -0,0 +1,63 @@
+#ifndef _FAGPIO_SOC_H
+#define _FAGPIO_SOC_H
+
+#include <stdint.h>
+#include "fagpio.h"
+#include "fagpio_region.h"
+
+/*
+ * SoC descriptors. The Allwinner PIO bank layout (struct pio_bank, EINT
+ * banks at PIO + 0x200) is the same on the F1C100s/F1C200s, V3s and H3;
+ * what differs is which ports exist, how many pins each has, which ports
+ * have an EINT bank and where the other register blocks live. The
+ * descriptor is picked once, from the first /proc/device-tree/compatible
+ * string that matches, and fagpio_setup() maps the window, builds the pin
+ * table and resolves fagpio_region() from it, so one build runs on every
+ * board. FAGPIO_SOC=<name> overrides the detection; without a match the
+ * F1C100s is assumed.
+ *
+ * Only the addresses and geometry come from here. Drivers that program
+ * CCU clock gates or decode the clock tree (fagpio_ccu.h, SPI, TWI, DMA)
+ * use F1C100s bit positions, fagpio_pinfunc.h only names the F1C100s pin
+ * functions, and the H3's R_PIO port L is not covered.
+ */
+
+#define FAGPIO_SOC_EINT_MAX		3		//EINT banks at PIO + 0x200
+
+struct fagpio_soc_region {
+	unsigned long phys;
+	unsigned long size;			//0 if the SoC has no such block
+};
+
+struct fagpio_soc {
+	char name[8];							//"f1c100s", "f1c200s", "v3s", "h3"
+	char compatible[24];					//Device tree compatible string
+	unsigned long window_phys;				//Block mapped by fagpio_setup(), from the CCU up
+	unsigned long window_size;
+	unsigned long pio_phys;
+	uint8_t nports;							//Last port present + 1
+	uint8_t port_pins[PIO_NPORTS];			//Implemented pins, 0 for a missing port
+	uint8_t eint_banks;
+	uint8_t eint_port[FAGPIO_SOC_EINT_MAX];	//Port served by each EINT bank
+	uint8_t func_names;						//The fagpio_pinfunc.h tables describe its pins
+	struct fagpio_soc_region region[FAGPIO_NREGIONS];
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+const struct fagpio_soc *fagpio_soc(void);					//Detected on first use
+const struct fagpio_soc *fagpio_soc_find(const char *name);	//By name or compatible, NULL if unknown
+int fagpio_soc_select(const char *name);					//Before fagpio_setup(), -1 if unknown
+int fagpio_soc_eint_bank(uint8_t port);						//EINT bank of the port, -1 if none
+
+static inline unsigned int fagpio_port_pins(uint8_t port) {
+	return port < PIO_NPORTS ? fagpio_soc()->port_pins[port] : 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef _FAGPIO_SOFTSPI_HPP
+#define _FAGPIO_SOFTSPI_HPP
+
+/*
+ * Header-only C++17 bit-banged SPI with everything but the data fixed at
+ * compile time: SoftSpi<"PE3"_pin, "PE4"_pin, "PE5"_pin, 0> has its pins,
+ * mode, bit order and word width as template parameters, so a word is
+ * Bits fully unrolled steps of two stores of DAT words built from
+ * immediate masks, with no mode test, order shift or MISO check left in
+ * the loop. Same wiring rules and edges as fagpio_bbspi.h: SCK and MOSI
+ * share a port, MISO may be anywhere, chip select is left to the caller.
+ *
+ * begin() sets the pins up through fagpio_bbspi_init() and takes its
+ * half-clock delay for Hz (0 runs as fast as the stores go); call it
+ * again after the access costs were measured again (fagpio_timer.h).
+ */
+
+#include <stddef.h>
+#include <utility>
+#include "fagpio.h"
+#include "fagpio_bbspi.h"
+#include "fagpio_timer.h"
+
+namespace fagpio {
+
+template <uint8_t Sck, uint8_t Mosi, uint8_t Miso, uint8_t Mode = 0, bool MsbFirst = true, unsigned Bits = 8, uint32_t Hz = 0>
+struct SoftSpi {
+	static_assert(Mode < 4, "SPI modes are 0-3");
+	static_assert(Bits >= 1 && Bits <= 32, "word width out of range");
+	static_assert(PIO_PIN_PORT(Sck) < PIO_NPORTS, "no such port");
+	static_assert(Mosi == FAGPIO_BBSPI_NO_PIN || PIO_PIN_PORT(Mosi) == PIO_PIN_PORT(Sck), "SCK and MOSI must share a port");
+	static_assert(Miso == FAGPIO_BBSPI_NO_PIN || PIO_PIN_PORT(Miso) < PIO_NPORTS, "no such port");
+
+	static constexpr uint8_t port = PIO_PIN_PORT(Sck);
+	static constexpr uint32_t sck = PIO_PIN_MASK(Sck);
+	static constexpr uint32_t mosi = Mosi != FAGPIO_BBSPI_NO_PIN ? PIO_PIN_MASK(Mosi) : 0;
+	static constexpr bool has_miso = Miso != FAGPIO_BBSPI_NO_PIN;
+	static constexpr unsigned idle = (Mode >> 1) & 1;
+	static constexpr bool lead_first = (Mode & 1) ? !idle : idle;	//SCK in the first store of a bit
+	static inline uint32_t half_ticks;
+
+	static int begin() {
+		struct fagpio_bbspi spi;
+
+		if (fagpio_bbspi_init(&spi, Sck, Mosi, Miso, Mode, Hz) < 0)
+			return -1;
+		half_ticks = spi.half_ticks;
+		return 0;
+	}
+
+	// One word, Bits wide in the low bits of out and of the result
+	static uint32_t transfer(uint32_t out) {
+		struct pio_bank *banks = fagpio_banks();
+		volatile uint32_t &dat = banks[port].dat;
+		uint32_t base = dat & ~(sck | mosi);
+		uint32_t in = word(banks, dat, base, out, std::make_index_sequence<Bits>());
+
+		dat = base | (idle ? sck : 0);
+		fagpio_shadow_sync(port);
+		return in;
+	}
+
+	// Bytes, for Bits == 8; tx NULL sends zeros, rx NULL discards what is read
+	static void transfer(const uint8_t *tx, uint8_t *rx, size_t len) {
+		static_assert(Bits == 8, "byte transfers need 8-bit words");
+
+		struct pio_bank *banks = fagpio_banks();
+		volatile uint32_t &dat = banks[port].dat;
+		uint32_t base = dat & ~(sck | mosi);
+
+		for (size_t i = 0; i < len; i++) {
+			uint32_t in = word(banks, dat, base, tx ? tx[i] : 0, std::make_index_sequence<Bits>());
+
+			if (rx)
+				rx[i] = in;
+		}
+		dat = base | (idle ? sck : 0);
+		fagpio_shadow_sync(port);
+	}
+
+private:
+	static void half_clock() {
+		if constexpr (Hz != 0)
+			fagpio_delay_cycles(half_ticks);
+	}
+
+	// Step I sends bit N of out and puts what MISO had after the sampling edge in bit N
+	template <unsigned I>
+	static uint32_t step(struct pio_bank *banks, volatile uint32_t &dat, uint32_t base, uint32_t out) {
+		constexpr unsigned n = MsbFirst ? Bits - 1 - I : I;
+		uint32_t level = base | (-((out >> n) & 1) & mosi);
+
+		dat = level | (lead_first ? sck : 0);
+		half_clock();
+		dat = level | (lead_first ? 0 : sck);
+		uint32_t in = 0;
+		if constexpr (has_miso)
+			in = ((banks[PIO_PIN_PORT(Miso)].dat >> PIO_PIN_NUM(Miso)) & 1) << n;
+		half_clock();
+		return in;
+	}
+
+	template <size_t... I>
+	static uint32_t word(struct pio_bank *banks, volatile uint32_t &dat, uint32_t base, uint32_t out, std::index_sequence<I...>) {
+		uint32_t in = 0;
+
+		((in |= step<I>(banks, dat, base, out)), ...);		//Left to right: bit order is step order
+		return in;
+	}
+};
+
+}
+
+#endif
@@ -0,0 +1,76 @@
+#include <string.h>
+#include "fagpio.h"
+#include "fagpio_sonar.h"
+#include "fagpio_timer.h"
+
+int fagpio_sonar_init(struct fagpio_sonar *s, const uint8_t *trig, const uint8_t *echo, uint8_t count, uint32_t max_mm) {
+	if (!count || count > FAGPIO_SONAR_MAX || !max_mm || max_mm > 10000 || fagpio_setup() < 0)
+		return -1;
+
+	memset(s, 0, sizeof(*s));
+	s->trig_port = PIO_PIN_PORT(trig[0]);
+	s->echo_port = PIO_PIN_PORT(echo[0]);
+	if (s->trig_port >= PIO_NPORTS || s->echo_port >= PIO_NPORTS)
+		return -1;
+	for (unsigned int i = 0; i < count; i++) {
+		if (PIO_PIN_PORT(trig[i]) != s->trig_port || PIO_PIN_PORT(echo[i]) != s->echo_port)
+			return -1;
+		if (s->echo_mask & PIO_PIN_MASK(echo[i]))
+			return -1;		//Echoes cannot be told apart on a shared pin
+		s->trig_mask |= PIO_PIN_MASK(trig[i]);
+		s->echo_mask |= PIO_PIN_MASK(echo[i]);
+		s->echo[i] = PIO_PIN_NUM(echo[i]);
+	}
+	if (s->trig_port == s->echo_port && (s->trig_mask & s->echo_mask))
+		return -1;
+	s->count = count;
+	s->timeout = fagpio_ns_to_ticks(FAGPIO_SONAR_LEAD_NS + (uint32_t)((uint64_t)max_mm * 2000000 / 343));
+
+	digitalWritePort(s->trig_port, s->trig_mask, 0);
+	pinModeMask(s->trig_port, s->trig_mask, OUTPUT);
+	pinModeMask(s->echo_port, s->echo_mask, INPUT);
+	return 0;
+}
+
+/*
+Each captured entry is the echo port after a change, so a sensor's echo
+starts at the first entry with its bit set and ends at the next one
+without. An echo still high from an earlier measurement only shows its
+fall, which is skipped.
+*/
+int fagpio_sonar_measure(struct fagpio_sonar *s, uint32_t *mm) {
+	uint32_t rise[FAGPIO_SONAR_MAX], seen = 0, done = 0;
+	int n, answered = 0;
+
+	digitalWritePort(s->trig_port, s->trig_mask, s->trig_mask);
+	fagpio_delay_ns(FAGPIO_SONAR_TRIG_NS);
+	digitalWritePort(s->trig_port, s->trig_mask, 0);
+
+	n = fagpio_capture_edges(s->echo_port, s->echo_mask, s->edges, 2 * s->count + 1, s->timeout);
+	if (n < 1)
+		return -1;
+	for (int e = 1; e < n; e++) {
+		uint32_t v = s->edges[e].value, prev = s->edges[e - 1].value;
+
+		for (unsigned int i = 0; i < s->count; i++) {
+			uint32_t bit = 1u << s->echo[i];
+
+			if (!(prev & bit) && (v & bit) && !(seen & bit)) {
+				rise[i] = s->edges[e].ticks;
+				seen |= bit;
+			} else if ((prev & bit) && !(v & bit) && (seen & bit) && !(done & bit)) {
+				mm[i] = fagpio_sonar_mm(fagpio_ticks_to_ns(s->edges[e].ticks - rise[i]));
+				done |= bit;
+			}
+		}
+	}
+	for (unsigned int i = 0; i < s->count; i++) {
+		uint32_t bit = 1u << s->echo[i];
+
+		if (!(done & bit))
+			mm[i] = FAGPIO_SONAR_NONE;
+		else
+			answered++;
+	}
+	return answered;
+}
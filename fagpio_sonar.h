@@ -0,0 +1,54 @@
+#ifndef _FAGPIO_SONAR_H
+#define _FAGPIO_SONAR_H
+
+#include <stdint.h>
+#include "fagpio_capture.h"
+
+/*
+ * HC-SR04 style ultrasonic ranging for many sensors at once. The trigger
+ * pins (one shared pin, or several on one port) are pulsed with a single
+ * port write, then one fagpio_capture_edges() pass on the echo port
+ * timestamps every echo edge, so all sensors are read in the time of the
+ * longest echo instead of one after another. Echo pins share one port.
+ *
+ * Triggering together means every sensor can hear the others' bursts:
+ * sensors facing the same way should be split into groups measured in
+ * turn, one fagpio_sonar per group.
+ */
+
+#define FAGPIO_SONAR_MAX		16
+#define FAGPIO_SONAR_TRIG_NS	10000
+#define FAGPIO_SONAR_LEAD_NS	1000000		//Trigger to echo rise, with margin
+#define FAGPIO_SONAR_NONE		0			//Distance of a sensor that did not answer
+
+struct fagpio_sonar {
+	uint8_t trig_port;
+	uint8_t echo_port;
+	uint8_t count;
+	uint8_t echo[FAGPIO_SONAR_MAX];		//Pin number of each sensor's echo
+	uint32_t trig_mask;
+	uint32_t echo_mask;
+	uint32_t timeout;					//Ticks from the trigger to the last echo at max range
+	struct fagpio_sample edges[2 * FAGPIO_SONAR_MAX + 1];
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// trig[i] and echo[i] of sensor i; trigger pins may repeat
+int fagpio_sonar_init(struct fagpio_sonar *s, const uint8_t *trig, const uint8_t *echo, uint8_t count, uint32_t max_mm);
+
+// Ranges every sensor: mm[i] in millimetres, FAGPIO_SONAR_NONE without an echo; returns the sensors answered
+int fagpio_sonar_measure(struct fagpio_sonar *s, uint32_t *mm);
+
+// Round-trip echo time to distance at 343 m/s
+static inline uint32_t fagpio_sonar_mm(uint32_t echo_ns) {
+	return (uint32_t)((uint64_t)echo_ns * 343 / 2000000);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
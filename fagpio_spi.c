@@ -0,0 +1,183 @@
+#include "fagpio_priv.h"
+#include "fagpio_spi.h"
+#include "fagpio_region.h"
+#include "fagpio_dma.h"
+#include "fagpio_log.h"
+
+#define SPI_GCR_EN			(1u << 0)
+#define SPI_GCR_MASTER		(1u << 1)
+#define SPI_GCR_TP_EN		(1u << 7)		//Stop when the RX FIFO is full instead of overrunning
+#define SPI_GCR_SRST		(1u << 31)
+#define SPI_TCR_SPOL		(1u << 2)		//SS active low
+#define SPI_TCR_SS_OWNER	(1u << 6)		//SS level from SS_LEVEL instead of the burst
+#define SPI_TCR_SS_LEVEL	(1u << 7)
+#define SPI_TCR_XCH			(1u << 31)
+#define SPI_ISR_TC			(1u << 12)
+#define SPI_FCR_RF_RST		(1u << 15)
+#define SPI_FCR_TX_LEVEL(n)	((uint32_t)(n) << 16)	//TX DRQ while the FIFO holds at most n bytes
+#define SPI_FCR_TF_DRQ_EN	(1u << 24)
+#define SPI_FCR_TF_RST		(1u << 31)
+#define SPI_CCR_DRS			(1u << 12)		//SPI_CLK = AHB / (2 * (CDR2 + 1))
+#define SPI_TIMEOUT			10000000		//FIFO polls before a transfer gives up
+
+static volatile uint32_t *spi_regs(uint8_t bus) {
+	if (bus > 1 || !fagpio_banks())
+		return NULL;
+	return fagpio_region(bus ? FAGPIO_REGION_SPI1 : FAGPIO_REGION_SPI0);
+}
+
+int fagpio_spi_open(uint8_t bus, uint32_t hz, uint8_t mode) {
+	volatile uint32_t *spi = spi_regs(bus);
+	volatile uint32_t *ccu = fagpio_region(FAGPIO_REGION_CCU);
+	static const uint8_t pins[2][4] = { SPI0_PINS, SPI1_PINS };
+	uint32_t bit = 1u << (20 + bus);
+
+	if (!spi || !ccu || mode > 3 || !hz)
+		return -1;
+
+	ccu[rCCU_BUS_RST0 / 4] |= bit;
+	ccu[rCCU_BUS_GATING0 / 4] |= bit;
+	for (int i = 0; i < 4; i++)
+		fagpio_pin_func(pins[bus][i], bus ? SPI1_PIN_FUNC : SPI0_PIN_FUNC);
+
+	spi[rSPI_GCR / 4] = SPI_GCR_SRST;
+	for (int i = 0; i < 1000 && (spi[rSPI_GCR / 4] & SPI_GCR_SRST); i++)
+		;
+	spi[rSPI_GCR / 4] = SPI_GCR_EN | SPI_GCR_MASTER | SPI_GCR_TP_EN;
+	spi[rSPI_TCR / 4] = SPI_TCR_SPOL | mode;		//CPHA bit 0, CPOL bit 1, like the mode number
+
+	uint32_t div = SPI_AHB_HZ / (2 * hz);
+
+	if (div)
+		div--;
+	if (div > 255)
+		div = 255;
+	spi[rSPI_CCR / 4] = SPI_CCR_DRS | div;
+	FAGPIO_LOG(FAGPIO_LOG_INFO, "SPI%u at %u Hz\n", bus, SPI_AHB_HZ / (2 * (div + 1)));
+	return 0;
+}
+
+int fagpio_spi_transfer(uint8_t bus, const uint8_t *tx, uint8_t *rx, size_t len) {
+	volatile uint32_t *spi = spi_regs(bus);
+
+	if (!spi || len > 0xFFFFFF)
+		return -1;
+	if (!len)
+		return 0;
+
+	volatile uint8_t *txd = (volatile uint8_t *)&spi[rSPI_TXD / 4];
+	volatile uint8_t *rxd = (volatile uint8_t *)&spi[rSPI_RXD / 4];
+	size_t sent = 0, got = 0;
+	unsigned int idle = 0;
+
+	FAGPIO_PROBE2(spi_start, bus, len);
+	spi[rSPI_FCR / 4] |= SPI_FCR_RF_RST | SPI_FCR_TF_RST;
+	spi[rSPI_MBC / 4] = len;
+	spi[rSPI_MTC / 4] = len;
+	spi[rSPI_BCC / 4] = len;
+	spi[rSPI_ISR / 4] = ~0u;
+
+	// Pre-fill the FIFO so the clock never waits for the first bytes
+	for (; sent < len && sent < SPI_FIFO_DEPTH; sent++)
+		*txd = tx ? tx[sent] : 0;
+	spi[rSPI_TCR / 4] |= SPI_TCR_XCH;
+
+	while (got < len) {
+		uint32_t fsr = spi[rSPI_FSR / 4];
+		uint32_t rf = fsr & 0xFF, tf = (fsr >> 16) & 0xFF;
+
+		for (; rf; rf--, got++) {
+			uint8_t v = *rxd;
+
+			if (rx)
+				rx[got] = v;
+		}
+		for (; sent < len && tf < SPI_FIFO_DEPTH; tf++, sent++)
+			*txd = tx ? tx[sent] : 0;
+		if (fsr & 0xFF)
+			idle = 0;
+		else if (++idle > SPI_TIMEOUT) {
+			FAGPIO_LOG(FAGPIO_LOG_ERR, "SPI%u: transfer stalled at %u of %u bytes\n", bus, (unsigned)got, (unsigned)len);
+			FAGPIO_PROBE2(spi_done, bus, -1);
+			return -1;
+		}
+	}
+
+	for (unsigned int i = 0; i < SPI_TIMEOUT && !(spi[rSPI_ISR / 4] & SPI_ISR_TC); i++)
+		;
+	spi[rSPI_ISR / 4] = SPI_ISR_TC;
+	FAGPIO_PROBE2(spi_done, bus, 0);
+	return 0;
+}
+
+void fagpio_spi_select(uint8_t bus, uint8_t active) {
+	volatile uint32_t *spi = spi_regs(bus);
+
+	if (!spi)
+		return;
+	if (active)
+		spi[rSPI_TCR / 4] = (spi[rSPI_TCR / 4] | SPI_TCR_SS_OWNER) & ~SPI_TCR_SS_LEVEL;
+	else
+		spi[rSPI_TCR / 4] |= SPI_TCR_SS_OWNER | SPI_TCR_SS_LEVEL;
+}
+
+void fagpio_spi_close(uint8_t bus) {
+	volatile uint32_t *spi = spi_regs(bus);
+	volatile uint32_t *ccu = fagpio_region(FAGPIO_REGION_CCU);
+
+	if (!spi || !ccu)
+		return;
+	spi[rSPI_GCR / 4] &= ~SPI_GCR_EN;
+	ccu[rCCU_BUS_GATING0 / 4] &= ~(1u << (20 + bus));
+}
+
+/*
+Nothing drains the RX FIFO during a DMA burst, so TP_EN is off for its
+length and the FIFO just overflows; wait puts it back.
+*/
+int fagpio_spi_write_dma(uint8_t bus, uint8_t ch, const struct fagpio_dmabuf *buf, size_t offset, size_t len) {
+	volatile uint32_t *spi = spi_regs(bus);
+
+	if (!spi || !len || len > FAGPIO_DMA_MAX_WORDS * 4 || offset > buf->size || len > buf->size - offset)
+		return -1;
+
+	FAGPIO_PROBE2(spi_start, bus, len);
+	spi[rSPI_GCR / 4] &= ~SPI_GCR_TP_EN;
+	spi[rSPI_FCR / 4] = SPI_FCR_RF_RST | SPI_FCR_TF_RST | SPI_FCR_TX_LEVEL(SPI_FIFO_DEPTH / 2) | SPI_FCR_TF_DRQ_EN;
+	spi[rSPI_MBC / 4] = len;
+	spi[rSPI_MTC / 4] = len;
+	spi[rSPI_BCC / 4] = len;
+	spi[rSPI_ISR / 4] = ~0u;
+	if (fagpio_dma_fifo_start(ch, buf->phys + offset, fagpio_region_phys(bus ? FAGPIO_REGION_SPI1 : FAGPIO_REGION_SPI0) + rSPI_TXD, len, SPI_NDMA_DRQ(bus)) < 0) {
+		spi[rSPI_FCR / 4] = SPI_FCR_RF_RST | SPI_FCR_TF_RST;
+		spi[rSPI_GCR / 4] |= SPI_GCR_TP_EN;
+		return -1;
+	}
+	spi[rSPI_TCR / 4] |= SPI_TCR_XCH;
+	return 0;
+}
+
+int fagpio_spi_dma_done(uint8_t bus) {
+	volatile uint32_t *spi = spi_regs(bus);
+
+	return !spi || (spi[rSPI_ISR / 4] & SPI_ISR_TC) != 0;
+}
+
+int fagpio_spi_dma_wait(uint8_t bus, uint8_t ch) {
+	volatile uint32_t *spi = spi_regs(bus);
+	unsigned int i = 0;
+
+	if (!spi)
+		return -1;
+	while (i < SPI_TIMEOUT && !(spi[rSPI_ISR / 4] & SPI_ISR_TC))
+		i++;
+	if (i == SPI_TIMEOUT) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "SPI%u: DMA burst stalled\n", bus);
+		fagpio_dma_wave_stop(ch);
+	}
+	spi[rSPI_ISR / 4] = SPI_ISR_TC;
+	spi[rSPI_FCR / 4] = SPI_FCR_RF_RST | SPI_FCR_TF_RST;
+	spi[rSPI_GCR / 4] |= SPI_GCR_TP_EN;
+	FAGPIO_PROBE2(spi_done, bus, i == SPI_TIMEOUT ? -1 : 0);
+	return i == SPI_TIMEOUT ? -1 : 0;
+}
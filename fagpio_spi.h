@@ -0,0 +1,65 @@
+#ifndef _FAGPIO_SPI_H
+#define _FAGPIO_SPI_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fagpio_dmabuf.h"
+
+/*
+ * Userspace driver for the SPI0/SPI1 controllers (0x01C05000, 0x01C06000),
+ * mapped with fagpio_region(). A transfer is one master burst: the driver
+ * keeps the 64-byte TX FIFO topped up and drains the RX FIFO as it fills,
+ * with no syscall. The controller drives SS0 itself (active low) for the
+ * length of each transfer; after fagpio_spi_select() the driver holds it
+ * instead, so a command and its data can be separate transfers into
+ * separate buffers. Do not use a bus the kernel spi driver owns.
+ */
+
+#define rSPI_GCR			0x04
+#define rSPI_TCR			0x08
+#define rSPI_ISR			0x14
+#define rSPI_FCR			0x18
+#define rSPI_FSR			0x1C
+#define rSPI_CCR			0x24
+#define rSPI_MBC			0x30
+#define rSPI_MTC			0x34
+#define rSPI_BCC			0x38
+#define rSPI_TXD			0x200
+#define rSPI_RXD			0x300
+
+#define rCCU_BUS_GATING0	0x060	//SPI0 bit 20, SPI1 bit 21
+#define rCCU_BUS_RST0		0x2C0
+
+#define SPI_FIFO_DEPTH		64
+#define SPI_NDMA_DRQ(bus)	(4 + (bus))	//Normal DMA DRQ of SPI0/SPI1
+#define SPI_AHB_HZ			200000000	//Module clock, the AHB rate set by the bootloader
+
+// SS, SCK, MOSI, MISO and their CFG function
+#define SPI0_PINS			{ PIO_PIN(PIO_PORT_C, 1), PIO_PIN(PIO_PORT_C, 0), PIO_PIN(PIO_PORT_C, 3), PIO_PIN(PIO_PORT_C, 2) }
+#define SPI0_PIN_FUNC		2
+#define SPI1_PINS			{ PIO_PIN(PIO_PORT_E, 7), PIO_PIN(PIO_PORT_E, 8), PIO_PIN(PIO_PORT_E, 9), PIO_PIN(PIO_PORT_E, 10) }
+#define SPI1_PIN_FUNC		4
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fagpio_spi_open(uint8_t bus, uint32_t hz, uint8_t mode);	//Bus 0 or 1, mode 0-3
+int fagpio_spi_transfer(uint8_t bus, const uint8_t *tx, uint8_t *rx, size_t len);	//tx NULL sends zeros, rx NULL discards
+void fagpio_spi_select(uint8_t bus, uint8_t active);	//SS low (1) or high (0) until fagpio_spi_open()
+void fagpio_spi_close(uint8_t bus);
+
+/*
+ * Transmit-only burst fed by normal DMA channel ch (fagpio_dma.h) from a
+ * DMA buffer, so the CPU is free until fagpio_spi_dma_wait(); up to 128 KB
+ * per burst. What the bus receives meanwhile is dropped.
+ */
+int fagpio_spi_write_dma(uint8_t bus, uint8_t ch, const struct fagpio_dmabuf *buf, size_t offset, size_t len);
+int fagpio_spi_dma_wait(uint8_t bus, uint8_t ch);		//0 once the last byte is out
+int fagpio_spi_dma_done(uint8_t bus);		//1 once the burst has ended, fagpio_spi_dma_wait() then returns at once
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,325 @@
+#include <string.h>
+#include <unistd.h>
+#include "fagpio_priv.h"
+#include "fagpio_spilcd.h"
+#include "fagpio_spi.h"
+#include "fagpio_log.h"
+
+#define LCD_SWRESET			0x01
+#define LCD_SLPOUT			0x11
+#define LCD_NORON			0x13
+#define LCD_INVON			0x21
+#define LCD_DISPON			0x29
+#define LCD_CASET			0x2A
+#define LCD_RASET			0x2B
+#define LCD_RAMWR			0x2C
+#define LCD_MADCTL			0x36
+#define LCD_COLMOD			0x3A
+#define LCD_COLMOD_565		0x55
+
+#define LCD_RESET_US		10000
+#define LCD_SWRESET_US		150000
+#define LCD_SLPOUT_US		120000
+
+typedef uint32_t __attribute__((may_alias)) pixel_pair;
+
+struct rect {
+	uint16_t x0, y0, x1, y1;	//Inclusive
+};
+
+static inline uint32_t area(const struct rect *r) {
+	return (uint32_t)(r->x1 - r->x0 + 1) * (r->y1 - r->y0 + 1);
+}
+
+static void spans_clear(struct fagpio_spilcd *lcd) {
+	for (unsigned int y = 0; y < lcd->height; y++) {
+		lcd->span_x0[y] = 1;
+		lcd->span_x1[y] = 0;
+	}
+}
+
+static void window_forget(struct fagpio_spilcd *lcd) {
+	lcd->win[0] = lcd->win[2] = 1;
+	lcd->win[1] = lcd->win[3] = 0;
+}
+
+int fagpio_spilcd_open(struct fagpio_spilcd *lcd, uint8_t bus, uint32_t hz, uint8_t dc, uint8_t rst, uint8_t dma_ch) {
+	memset(lcd, 0, sizeof(*lcd));
+	lcd->bus = bus;
+	lcd->dc = dc;
+	lcd->rst = rst;
+	lcd->dma_ch = dma_ch;
+	if (bus > 1 || PIO_PIN_PORT(dc) >= PIO_NPORTS || (rst != FAGPIO_SPILCD_NO_PIN && PIO_PIN_PORT(rst) >= PIO_NPORTS))
+		return -1;
+	if (fagpio_spi_open(bus, hz, 0) < 0)
+		return -1;
+	fagpio_spi_select(bus, 0);
+
+	fagpio_digital_write(fagpio_default(), dc, HIGH);
+	pinMode(dc, OUTPUT);
+	if (rst != FAGPIO_SPILCD_NO_PIN) {
+		fagpio_digital_write(fagpio_default(), rst, HIGH);
+		pinMode(rst, OUTPUT);
+	}
+	if (dma_ch != FAGPIO_SPILCD_NO_DMA && fagpio_dmabuf_alloc(&lcd->dma, FAGPIO_SPILCD_DMA_BYTES) < 0) {
+		FAGPIO_LOG(FAGPIO_LOG_INFO, "SPI LCD: no DMA buffer, pixels go through the FIFO\n");
+		memset(&lcd->dma, 0, sizeof(lcd->dma));
+	}
+	return 0;
+}
+
+void fagpio_spilcd_end(struct fagpio_spilcd *lcd) {
+	if (lcd->dma.size)
+		fagpio_dmabuf_free(&lcd->dma);
+	memset(&lcd->dma, 0, sizeof(lcd->dma));
+}
+
+// Command byte with DC low, then its parameters; chip select is the caller's
+static int send(struct fagpio_spilcd *lcd, uint8_t cmd, const uint8_t *params, size_t len) {
+	int ret;
+
+	fagpio_digital_write(fagpio_default(), lcd->dc, LOW);
+	ret = fagpio_spi_transfer(lcd->bus, &cmd, NULL, 1);
+	fagpio_digital_write(fagpio_default(), lcd->dc, HIGH);
+	if (!ret && len)
+		ret = fagpio_spi_transfer(lcd->bus, params, NULL, len);
+	return ret;
+}
+
+int fagpio_spilcd_command(struct fagpio_spilcd *lcd, uint8_t cmd, const uint8_t *params, size_t len) {
+	int ret;
+
+	fagpio_spi_select(lcd->bus, 1);
+	ret = send(lcd, cmd, params, len);
+	fagpio_spi_select(lcd->bus, 0);
+	if (cmd != LCD_RAMWR)
+		window_forget(lcd);		//It may have been CASET, RASET or a reset
+	return ret;
+}
+
+int fagpio_spilcd_begin(struct fagpio_spilcd *lcd, uint8_t ctrl, uint16_t width, uint16_t height, uint8_t madctl, uint16_t *fb) {
+	uint8_t colmod = LCD_COLMOD_565;
+
+	if (ctrl > FAGPIO_SPILCD_ILI9341 || !fb || !width || !height || height > FAGPIO_SPILCD_MAX_H)
+		return -1;
+	lcd->ctrl = ctrl;
+	lcd->width = width;
+	lcd->height = height;
+	lcd->fb = fb;
+
+	if (lcd->rst != FAGPIO_SPILCD_NO_PIN) {
+		fagpio_digital_write(fagpio_default(), lcd->rst, LOW);
+		usleep(LCD_RESET_US);
+		fagpio_digital_write(fagpio_default(), lcd->rst, HIGH);
+		usleep(LCD_RESET_US);
+	}
+	if (fagpio_spilcd_command(lcd, LCD_SWRESET, NULL, 0) < 0)
+		return -1;
+	usleep(LCD_SWRESET_US);
+	fagpio_spilcd_command(lcd, LCD_SLPOUT, NULL, 0);
+	usleep(LCD_SLPOUT_US);
+	fagpio_spilcd_command(lcd, LCD_COLMOD, &colmod, 1);
+	fagpio_spilcd_command(lcd, LCD_MADCTL, &madctl, 1);
+	if (ctrl == FAGPIO_SPILCD_ST7789)
+		fagpio_spilcd_command(lcd, LCD_INVON, NULL, 0);		//ST7789 modules are built for inverted data
+	fagpio_spilcd_command(lcd, LCD_NORON, NULL, 0);
+	fagpio_spilcd_command(lcd, LCD_DISPON, NULL, 0);
+
+	memset(fb, 0, (size_t)width * height * sizeof(*fb));
+	spans_clear(lcd);
+	fagpio_spilcd_mark(lcd, 0, 0, width, height);
+	FAGPIO_LOG(FAGPIO_LOG_INFO, "SPI LCD %ux%u on SPI%u%s\n", width, height, lcd->bus, lcd->dma.size ? " with DMA" : "");
+	return fagpio_spilcd_flush(lcd) < 0 ? -1 : 0;
+}
+
+void fagpio_spilcd_mark(struct fagpio_spilcd *lcd, uint16_t x, uint16_t y, uint16_t w, uint16_t h) {
+	if (x >= lcd->width || y >= lcd->height || !w || !h)
+		return;
+	if (w > lcd->width - x)
+		w = lcd->width - x;
+	if (h > lcd->height - y)
+		h = lcd->height - y;
+	for (unsigned int row = y; row < (unsigned int)y + h; row++) {
+		if (lcd->span_x0[row] > lcd->span_x1[row]) {
+			lcd->span_x0[row] = x;
+			lcd->span_x1[row] = x + w - 1;
+			continue;
+		}
+		if (x < lcd->span_x0[row])
+			lcd->span_x0[row] = x;
+		if (x + w - 1 > lcd->span_x1[row])
+			lcd->span_x1[row] = x + w - 1;
+	}
+}
+
+// Only the ranges that differ from the last window are sent again
+static int set_window(struct fagpio_spilcd *lcd, const struct rect *r) {
+	uint16_t range[4] = { r->x0 + lcd->x_off, r->x1 + lcd->x_off, r->y0 + lcd->y_off, r->y1 + lcd->y_off };
+
+	for (unsigned int i = 0; i < 4; i += 2) {
+		uint8_t p[4] = { range[i] >> 8, range[i], range[i + 1] >> 8, range[i + 1] };
+
+		if (range[i] == lcd->win[i] && range[i + 1] == lcd->win[i + 1])
+			continue;
+		if (send(lcd, i ? LCD_RASET : LCD_CASET, p, sizeof(p)) < 0)
+			return -1;
+		lcd->win[i] = range[i];
+		lcd->win[i + 1] = range[i + 1];
+	}
+	return send(lcd, LCD_RAMWR, NULL, 0);
+}
+
+/*
+Up to max pixels (even) of r from pixel *pos on, high byte first, packed
+two to a word so uncached DMA memory takes word stores. Returns bytes.
+*/
+static size_t stage_px(const struct fagpio_spilcd *lcd, const struct rect *r, uint32_t *pos, uint32_t *dst, size_t max) {
+	uint32_t w = r->x1 - r->x0 + 1, total = area(r), half = 0;
+	size_t n = 0;
+	unsigned int odd = 0;
+
+	while (n < max && *pos < total) {
+		uint32_t row = *pos / w, col = *pos - row * w;
+		const uint16_t *src = lcd->fb + (size_t)(r->y0 + row) * lcd->width + r->x0 + col;
+		size_t run = w - col;
+
+		if (run > max - n)
+			run = max - n;
+		for (size_t i = 0; i < run; i++) {
+			uint32_t p = src[i];
+
+			p = ((p & 0xFF) << 8) | (p >> 8);
+			if (odd)
+				*dst++ = half | (p << 16);
+			else
+				half = p;
+			odd ^= 1;
+		}
+		n += run;
+		*pos += run;
+	}
+	if (odd)
+		*dst = half;
+	return n * 2;
+}
+
+static int push_fifo(struct fagpio_spilcd *lcd, const struct rect *r) {
+	uint32_t pos = 0, total = area(r);
+
+	while (pos < total) {
+		size_t bytes = stage_px(lcd, r, &pos, lcd->stage, sizeof(lcd->stage) / 2);
+
+		if (fagpio_spi_transfer(lcd->bus, (const uint8_t *)lcd->stage, NULL, bytes) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+// One half of the DMA buffer is on the bus while the next part is staged into the other
+static int push_dma(struct fagpio_spilcd *lcd, const struct rect *r) {
+	size_t half = (lcd->dma.size / 2) & ~(size_t)3;
+	uint32_t pos = 0, total = area(r);
+	unsigned int h = 0, busy = 0;
+
+	while (pos < total) {
+		uint32_t *dst = (uint32_t *)((uint8_t *)lcd->dma.virt + h * half);
+		size_t bytes = stage_px(lcd, r, &pos, dst, half / 2);
+
+		if (busy && fagpio_spi_dma_wait(lcd->bus, lcd->dma_ch) < 0)
+			return -1;
+		if (fagpio_spi_write_dma(lcd->bus, lcd->dma_ch, &lcd->dma, h * half, bytes) < 0)
+			return -1;
+		busy = 1;
+		h ^= 1;
+	}
+	return busy ? fagpio_spi_dma_wait(lcd->bus, lcd->dma_ch) : 0;
+}
+
+static int push(struct fagpio_spilcd *lcd, const struct rect *r) {
+	lcd->windows++;
+	if (set_window(lcd, r) < 0)
+		return -1;
+	if (lcd->dma.size && area(r) * 2 > sizeof(lcd->stage))	//Short runs are quicker through the FIFO
+		return push_dma(lcd, r);
+	return push_fifo(lcd, r);
+}
+
+/*
+Rows are taken top to bottom. A changed row joins the rectangle above it
+(across unchanged rows too) when the union costs fewer pixels than the
+rectangle and the row sent apart, counting FAGPIO_SPILCD_WINDOW_PX for
+the extra window; otherwise the rectangle is sent and the row starts the
+next one.
+*/
+int fagpio_spilcd_flush(struct fagpio_spilcd *lcd) {
+	struct rect r = { 0 };
+	int sent = 0, have = 0;
+
+	lcd->windows = 0;
+	fagpio_spi_select(lcd->bus, 1);
+	for (unsigned int y = 0; y < lcd->height; y++) {
+		uint16_t x0 = lcd->span_x0[y], x1 = lcd->span_x1[y];
+
+		if (x0 > x1)
+			continue;
+		if (have) {
+			struct rect u = { x0 < r.x0 ? x0 : r.x0, r.y0, x1 > r.x1 ? x1 : r.x1, y };
+
+			if (area(&u) <= area(&r) + (x1 - x0 + 1) + FAGPIO_SPILCD_WINDOW_PX) {
+				r = u;
+				continue;
+			}
+			if (push(lcd, &r) < 0)
+				goto fail;
+			sent += area(&r);
+		}
+		r = (struct rect){ x0, y, x1, y };
+		have = 1;
+	}
+	if (have) {
+		if (push(lcd, &r) < 0)
+			goto fail;
+		sent += area(&r);
+	}
+	fagpio_spi_select(lcd->bus, 0);
+	spans_clear(lcd);
+	return sent;
+
+fail:
+	fagpio_spi_select(lcd->bus, 0);
+	window_forget(lcd);
+	fagpio_spilcd_mark(lcd, 0, 0, lcd->width, lcd->height);	//Whatever the panel got, the next flush redraws it
+	return -1;
+}
+
+// Changed columns [*x0, *x1] of a row, 0 if it is unchanged; whole words while they match
+static int row_span(const uint16_t *fb, const uint16_t *src, unsigned int w, unsigned int *x0, unsigned int *x1) {
+	unsigned int l = 0, r = w;
+
+	if (!(((uintptr_t)fb | (uintptr_t)src) & 3)) {
+		while (l + 2 <= w && *(const pixel_pair *)(fb + l) == *(const pixel_pair *)(src + l))
+			l += 2;
+	}
+	while (l < w && fb[l] == src[l])
+		l++;
+	if (l == w)
+		return 0;
+	while (r > l + 1 && fb[r - 1] == src[r - 1])
+		r--;
+	*x0 = l;
+	*x1 = r - 1;
+	return 1;
+}
+
+int fagpio_spilcd_present(struct fagpio_spilcd *lcd, const uint16_t *frame) {
+	for (unsigned int y = 0; y < lcd->height; y++) {
+		size_t row = (size_t)y * lcd->width;
+		unsigned int x0, x1;
+
+		if (!row_span(lcd->fb + row, frame + row, lcd->width, &x0, &x1))
+			continue;
+		memcpy(lcd->fb + row + x0, frame + row + x0, (x1 - x0 + 1) * sizeof(*frame));
+		fagpio_spilcd_mark(lcd, x0, y, x1 - x0 + 1, 1);
+	}
+	return fagpio_spilcd_flush(lcd);
+}
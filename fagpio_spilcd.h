@@ -0,0 +1,96 @@
+#ifndef _FAGPIO_SPILCD_H
+#define _FAGPIO_SPILCD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fagpio_dmabuf.h"
+
+/*
+ * ST7789 and ILI9341 RGB565 panels on hardware SPI (fagpio_spi.h) with a
+ * DC pin. The driver keeps its own framebuffer of what the panel shows
+ * and only sends what changed:
+ *
+ * - fagpio_spilcd_present(lcd, frame) takes a whole redrawn frame,
+ *   compares it with the framebuffer a word at a time and records the
+ *   changed span of every row;
+ * - or draw into lcd->fb and call fagpio_spilcd_mark() for the areas
+ *   touched.
+ *
+ * fagpio_spilcd_flush() then turns the row spans into rectangles,
+ * merging a row into the rectangle above it whenever the extra pixels
+ * cost less than a new window would (FAGPIO_SPILCD_WINDOW_PX), and a
+ * CASET or RASET is only sent when its range differs from the last one.
+ *
+ * Pixels go out through a DMA channel when one was given and a DMA
+ * buffer could be allocated (fagpio_dmabuf.h): the buffer is split in
+ * two, and the next part of a rectangle is byte-swapped into one half
+ * while the other is on the bus. Without DMA they go through the FIFO
+ * loop of fagpio_spi_transfer().
+ */
+
+#define FAGPIO_SPILCD_ST7789	0
+#define FAGPIO_SPILCD_ILI9341	1
+
+#define FAGPIO_SPILCD_NO_PIN	0xFF
+#define FAGPIO_SPILCD_NO_DMA	0xFF
+#define FAGPIO_SPILCD_MAX_H		320		//Rows of the span table
+
+#ifndef FAGPIO_SPILCD_WINDOW_PX
+#define FAGPIO_SPILCD_WINDOW_PX	32		//Bus time of CASET, RASET and RAMWR in pixels
+#endif
+#ifndef FAGPIO_SPILCD_DMA_BYTES
+#define FAGPIO_SPILCD_DMA_BYTES	(32 * 1024)
+#endif
+#define FAGPIO_SPILCD_STAGE		1024	//Bytes staged per transfer without DMA
+
+// MADCTL orientations (MY, MX, MV); OR in FAGPIO_SPILCD_BGR for BGR panels
+#define FAGPIO_SPILCD_ROT0		0x00
+#define FAGPIO_SPILCD_ROT90		0x60
+#define FAGPIO_SPILCD_ROT180	0xC0
+#define FAGPIO_SPILCD_ROT270	0xA0
+#define FAGPIO_SPILCD_BGR		0x08
+
+struct fagpio_spilcd {
+	uint8_t bus;
+	uint8_t dc, rst;		//rst may be FAGPIO_SPILCD_NO_PIN
+	uint8_t dma_ch;			//FAGPIO_SPILCD_NO_DMA for none
+	uint8_t ctrl;			//FAGPIO_SPILCD_*
+	uint16_t width, height;
+	uint16_t x_off, y_off;	//Panel RAM offset of pixel (0, 0), e.g. 240x240 ST7789 modules
+	uint16_t *fb;			//width * height pixels, caller storage
+	struct fagpio_dmabuf dma;	//Zero size without DMA
+	uint16_t win[4];		//Last CASET and RASET ranges, win[0] > win[1] if unknown
+	uint16_t span_x0[FAGPIO_SPILCD_MAX_H];	//Changed columns of each row, x0 > x1 if none
+	uint16_t span_x1[FAGPIO_SPILCD_MAX_H];
+	uint32_t windows;		//Rectangles sent by the last flush
+	uint32_t stage[FAGPIO_SPILCD_STAGE / 4];
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// SPI bus 0 or 1 (mode 0); dma_ch 0-3 or FAGPIO_SPILCD_NO_DMA
+int fagpio_spilcd_open(struct fagpio_spilcd *lcd, uint8_t bus, uint32_t hz, uint8_t dc, uint8_t rst, uint8_t dma_ch);
+
+/*
+ * Resets and initialises the controller for 16-bit pixels in the given
+ * MADCTL orientation, then clears the panel and fb (width * height
+ * pixels of caller storage) to black.
+ */
+int fagpio_spilcd_begin(struct fagpio_spilcd *lcd, uint8_t ctrl, uint16_t width, uint16_t height, uint8_t madctl, uint16_t *fb);
+void fagpio_spilcd_end(struct fagpio_spilcd *lcd);		//Frees the DMA buffer
+
+int fagpio_spilcd_command(struct fagpio_spilcd *lcd, uint8_t cmd, const uint8_t *params, size_t len);
+
+void fagpio_spilcd_mark(struct fagpio_spilcd *lcd, uint16_t x, uint16_t y, uint16_t w, uint16_t h);
+int fagpio_spilcd_flush(struct fagpio_spilcd *lcd);		//Pixels sent, -1 on a bus error
+
+// Copies the changed pixels of frame (width * height) into fb, then flushes
+int fagpio_spilcd_present(struct fagpio_spilcd *lcd, const uint16_t *frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
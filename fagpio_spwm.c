@@ -0,0 +1,173 @@
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+#include "fagpio_spwm.h"
+#include "fagpio_timer.h"
+
+int fagpio_spwm_init(struct fagpio_spwm *e, uint32_t period_ns) {
+	memset(e, 0, sizeof(*e));
+	if (fagpio_setup() < 0 || !(e->period = fagpio_ns_to_ticks(period_ns)))
+		return -1;
+	pthread_mutex_init(&e->lock, NULL);
+	return 0;
+}
+
+// Writes the rising edges at tick 0 and the falling edges sorted by (tick, port)
+static void spwm_compile(const struct fagpio_spwm *e, struct fagpio_spwm_table *t) {
+	uint8_t order[FAGPIO_SPWM_MAX];
+	uint32_t rise_mask[PIO_NPORTS] = { 0 }, rise[PIO_NPORTS] = { 0 };
+	unsigned int nfall = 0;
+	struct fagpio_seq seq;
+
+	for (unsigned int ch = 0; ch < e->nchannels; ch++) {
+		uint8_t port = PIO_PIN_PORT(e->pins[ch]);
+		uint32_t mask = PIO_PIN_MASK(e->pins[ch]);
+
+		rise_mask[port] |= mask;
+		if (e->duty[ch])
+			rise[port] |= mask;
+		if (e->duty[ch] && e->duty[ch] < e->period) {
+			unsigned int i = nfall++;
+
+			for (; i && (e->duty[order[i - 1]] > e->duty[ch] ||
+					(e->duty[order[i - 1]] == e->duty[ch] && e->pins[order[i - 1]] > e->pins[ch])); i--)
+				order[i] = order[i - 1];
+			order[i] = ch;
+		}
+	}
+
+	fagpio_seq_init(&seq, t->ops, FAGPIO_SPWM_OPS);
+	for (uint8_t port = 0; port < PIO_NPORTS; port++) {
+		if (rise_mask[port])
+			fagpio_seq_add(&seq, port, rise_mask[port], rise[port], 0);
+	}
+	for (unsigned int i = 0; i < nfall; i++) {
+		uint8_t ch = order[i];
+
+		fagpio_seq_add(&seq, PIO_PIN_PORT(e->pins[ch]), PIO_PIN_MASK(e->pins[ch]), 0, e->duty[ch] - seq.end);
+	}
+	t->count = seq.count;
+}
+
+// Caller holds e->lock
+static void spwm_publish(struct fagpio_spwm *e) {
+	uint32_t next = e->active ^ 1;
+
+	while (e->running && e->playing != e->active)
+		sched_yield();		//The player is still on the table we are about to rewrite
+	spwm_compile(e, &e->tables[next]);
+	__sync_synchronize();
+	e->active = next;
+}
+
+int fagpio_spwm_add(struct fagpio_spwm *e, uint8_t pin) {
+	int ch;
+
+	if (PIO_PIN_PORT(pin) >= PIO_NPORTS)
+		return -1;
+	pthread_mutex_lock(&e->lock);
+	if ((ch = e->nchannels) == FAGPIO_SPWM_MAX) {
+		pthread_mutex_unlock(&e->lock);
+		return -1;
+	}
+	pinMode(pin, 0);
+	e->pins[ch] = pin;
+	e->duty[ch] = 0;
+	e->nchannels++;
+	spwm_publish(e);
+	pthread_mutex_unlock(&e->lock);
+	return ch;
+}
+
+int fagpio_spwm_set(struct fagpio_spwm *e, unsigned int channel, uint32_t duty_ns) {
+	uint32_t duty = fagpio_ns_to_ticks(duty_ns);
+
+	pthread_mutex_lock(&e->lock);
+	if (channel >= e->nchannels) {
+		pthread_mutex_unlock(&e->lock);
+		return -1;
+	}
+	e->duty[channel] = duty < e->period ? duty : e->period;
+	spwm_publish(e);
+	pthread_mutex_unlock(&e->lock);
+	return 0;
+}
+
+void fagpio_spwm_sleep(struct fagpio_spwm *e, uint32_t wake_ns) {
+	e->wake = wake_ns ? fagpio_ns_to_ticks(wake_ns) : 0;
+}
+
+static void spwm_idle(const struct fagpio_spwm *e, uint32_t until) {
+	int32_t idle = until - fagpio_ticks() - e->wake;
+
+	if (idle > 0)
+		usleep(fagpio_ticks_to_ns(idle) / 1000);
+}
+
+// With a wake margin the table is played in bursts, sleeping across gaps of more than two margins
+static int spwm_play(const struct fagpio_spwm *e, const struct fagpio_spwm_table *t, uint32_t start) {
+	int late = 0;
+
+	if (!e->wake)
+		return fagpio_seq_play_ops(t->ops, t->count, start);
+	for (unsigned int i = 0, n; i < t->count; i += n) {
+		int r;
+
+		for (n = 1; i + n < t->count && t->ops[i + n].at - t->ops[i + n - 1].at <= 2 * e->wake; n++)
+			;
+		spwm_idle(e, start + t->ops[i].at);
+		if ((r = fagpio_seq_play_ops(t->ops + i, n, start)) < 0)
+			return r;
+		late += r;
+	}
+	return late;
+}
+
+void fagpio_spwm_run(struct fagpio_spwm *e) {
+	uint32_t start = fagpio_ticks();
+
+	e->running = 1;
+	while (!e->stop) {
+		uint32_t idx = e->active;
+
+		e->playing = idx;
+		__sync_synchronize();
+
+		const struct fagpio_spwm_table *t = &e->tables[idx];
+		int late = spwm_play(e, t, start);
+
+		if (late > 0)
+			e->late += late;
+		start += e->period;
+		if (!t->count) {
+			if (e->wake)
+				spwm_idle(e, start);
+			while ((int32_t)(fagpio_ticks() - start) < 0)
+				;		//No channels yet, keep the period grid anyway
+		}
+	}
+	e->running = 0;
+}
+
+static void *spwm_thread(void *arg) {
+	fagpio_spwm_run(arg);
+	return NULL;
+}
+
+int fagpio_spwm_start(struct fagpio_spwm *e) {
+	e->stop = 0;
+	e->running = 1;		//Editors must wait for the player from here on
+	if (pthread_create(&e->thread, NULL, spwm_thread, e)) {
+		e->running = 0;
+		return -1;
+	}
+	return 0;
+}
+
+void fagpio_spwm_stop(struct fagpio_spwm *e) {
+	e->stop = 1;
+	if (e->thread) {
+		pthread_join(e->thread, NULL);
+		e->thread = 0;
+	}
+}
@@ -0,0 +1,68 @@
+#ifndef _FAGPIO_SPWM_H
+#define _FAGPIO_SPWM_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include "fagpio.h"
+#include "fagpio_seq.h"
+
+/*
+ * Software PWM for pins the PWM block cannot reach, any number of channels
+ * on one thread. Each period is compiled into sequencer ops
+ * (fagpio_seq.h): one masked write per port raises every channel, then
+ * the falling edges follow sorted by time, and channels falling at the
+ * same tick on the same port share one write. Playback is paced by the AVS
+ * counter with periods back to back on absolute ticks.
+ *
+ * Duty edits never stall playback: fagpio_spwm_set() compiles into the
+ * table not being played and publishes it by flipping an index, which the
+ * player picks up at the next period start.
+ *
+ * The player spins through each period by default. With
+ * fagpio_spwm_sleep() it sleeps across every gap between edges longer
+ * than twice wake_ns, waking wake_ns ahead of the next edge: for short
+ * pulses in long periods (servos). wake_ns covers the scheduler's wakeup
+ * latency; an edge it misses is counted in late.
+ */
+
+#define FAGPIO_SPWM_MAX		32
+#define FAGPIO_SPWM_OPS		(FAGPIO_SPWM_MAX + PIO_NPORTS)
+
+struct fagpio_spwm_table {
+	unsigned int count;
+	struct fagpio_seq_op ops[FAGPIO_SPWM_OPS];
+};
+
+struct fagpio_spwm {
+	uint32_t period;					//Ticks
+	unsigned int nchannels;
+	uint8_t pins[FAGPIO_SPWM_MAX];
+	uint32_t duty[FAGPIO_SPWM_MAX];		//High time in ticks
+	struct fagpio_spwm_table tables[2];
+	volatile uint32_t active;			//Table the player takes at the next period
+	volatile uint32_t playing;			//Table the player is on
+	volatile uint8_t running;
+	volatile uint8_t stop;
+	uint32_t wake;						//Ticks before a period the player stops sleeping, 0 never sleeps
+	unsigned int late;					//Overdue edges so far
+	pthread_mutex_t lock;				//Serialises editors, never taken by the player
+	pthread_t thread;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fagpio_spwm_init(struct fagpio_spwm *e, uint32_t period_ns);
+int fagpio_spwm_add(struct fagpio_spwm *e, uint8_t pin);				//Returns the channel number
+int fagpio_spwm_set(struct fagpio_spwm *e, unsigned int channel, uint32_t duty_ns);
+void fagpio_spwm_sleep(struct fagpio_spwm *e, uint32_t wake_ns);		//0 spins through the gaps
+void fagpio_spwm_run(struct fagpio_spwm *e);							//Plays until fagpio_spwm_stop()
+int fagpio_spwm_start(struct fagpio_spwm *e);							//fagpio_spwm_run() on a new thread
+void fagpio_spwm_stop(struct fagpio_spwm *e);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,150 @@
+#include "fagpio_priv.h"
+#include "fagpio_ssi.h"
+#include "fagpio_timer.h"
+#include "fagpio_transpose.h"
+
+int fagpio_ssi_init(struct fagpio_ssi *s, uint8_t clk, uint8_t first_data, uint8_t lanes, uint8_t protocol,
+		uint8_t bits, uint32_t hz, uint8_t flags) {
+	struct pio_bank *banks = fagpio_banks();
+	uint8_t port = PIO_PIN_PORT(first_data);
+	unsigned int clocks = protocol == FAGPIO_BISS ? bits + 10 + FAGPIO_SSI_BISS_LATENCY : bits;
+
+	if (!banks || protocol > FAGPIO_BISS || !bits || bits > 32 || clocks > FAGPIO_SSI_CLOCKS)
+		return -1;
+	if (!lanes || lanes > FAGPIO_SSI_MAX || port >= PIO_NPORTS || PIO_PIN_NUM(first_data) + lanes > 32)
+		return -1;
+	if (PIO_PIN_PORT(clk) >= PIO_NPORTS || (PIO_PIN_PORT(clk) == port &&
+			(unsigned int)(PIO_PIN_NUM(clk) - PIO_PIN_NUM(first_data)) < lanes))
+		return -1;
+
+	s->protocol = protocol;
+	s->lanes = lanes;
+	s->shift = PIO_PIN_NUM(first_data);
+	s->bits = bits;
+	s->flags = flags;
+	s->clocks = clocks;
+	s->clk_port = PIO_PIN_PORT(clk);
+	s->clk = PIO_PIN_MASK(clk);
+	s->clk_dat = &banks[s->clk_port].dat;
+	s->data_dat = &banks[port].dat;
+	s->half_ns = hz ? 1000000000 / (2 * hz) : 0;
+	s->costs_gen = fagpio_costs_gen;
+	s->half_ticks = hz ? fagpio_pad_ticks(s->half_ns, 0, 1) : 0;	//Each half clock is one store
+	s->pause_ticks = (uint64_t)FAGPIO_SSI_PAUSE_US * fagpio_tick_hz / 1000000;
+	s->last = fagpio_ticks() - s->pause_ticks;
+
+	digitalWritePort(s->clk_port, s->clk, s->clk);
+	pinMode(clk, OUTPUT);
+	pinModeMask(port, ((1u << lanes) - 1) << s->shift, INPUT);
+	pinPullMask(port, ((1u << lanes) - 1) << s->shift, PULL_UP);
+	return 0;
+}
+
+static inline void half_clock(uint32_t ticks) {
+	if (ticks)
+		fagpio_delay_cycles(ticks);
+}
+
+static inline uint32_t gray_decode(uint32_t g) {
+	g ^= g >> 16;
+	g ^= g >> 8;
+	g ^= g >> 4;
+	g ^= g >> 2;
+	return g ^ (g >> 1);
+}
+
+// CRC6 of the top n bits of w, sent inverted
+static unsigned int biss_crc6(uint64_t w, unsigned int n) {
+	unsigned int crc = 0;
+
+	for (unsigned int i = 0; i < n; i++, w <<= 1) {
+		unsigned int fb = (crc >> 5) ^ (unsigned int)(w >> 63);
+
+		crc = (crc << 1) & 0x3F;
+		if (fb & 1)
+			crc ^= 0x03;
+	}
+	return ~crc & 0x3F;
+}
+
+/*
+w holds the line from the first cycle down: ones while idle, the
+acknowledge zeros, start, CDS, the position, nE, nW and the CRC6.
+*/
+static void biss_decode(const struct fagpio_ssi *s, uint64_t w, struct fagpio_ssi_pos *pos) {
+	unsigned int n = s->bits, t;
+
+	pos->value = 0;
+	if (!~w || (t = __builtin_clzll(~w)) >= FAGPIO_SSI_BISS_LATENCY || !(w << t)) {
+		pos->status = FAGPIO_SSI_NO_START;
+		return;
+	}
+	t += __builtin_clzll(w << t);
+	if (t + n + 10 > s->clocks) {
+		pos->status = FAGPIO_SSI_NO_START;
+		return;
+	}
+	w <<= t + 2;		//Past start and CDS
+	pos->value = (uint32_t)(w >> (64 - n));
+	pos->status = 0;
+	if (!((w << n) >> 63))
+		pos->status |= FAGPIO_SSI_ERROR;
+	if (!((w << (n + 1)) >> 63))
+		pos->status |= FAGPIO_SSI_WARNING;
+	if (biss_crc6(w, n + 2) != (unsigned int)((w << (n + 2)) >> 58))
+		pos->status |= FAGPIO_SSI_CRC;
+}
+
+FAGPIO_ARM_CODE int fagpio_ssi_read(struct fagpio_ssi *s, struct fagpio_ssi_pos *pos) {
+	volatile uint32_t *dat = s->clk_dat, *data = s->data_dat;
+	uint32_t hi, lo, half, idle;
+	unsigned int shift = s->shift, clocks = s->clocks, good = 0;
+	uint8_t snap[FAGPIO_SSI_CLOCKS] = { 0 };
+	uint64_t word[8] = { 0 };
+
+	if (fagpio_costs_update(&s->costs_gen))
+		s->half_ticks = s->half_ns ? fagpio_pad_ticks(s->half_ns, 0, 1) : 0;
+	half = s->half_ticks;
+	while (fagpio_ticks() - s->last < s->pause_ticks)
+		;
+
+	hi = *dat | s->clk;
+	lo = hi & ~s->clk;
+	idle = *data >> shift;
+	*dat = lo;		//Latches the position
+	half_clock(half);
+	for (unsigned int k = 0; k < clocks; k++) {
+		*dat = hi;
+		half_clock(half);
+		snap[k] = *data >> shift;
+		*dat = lo;
+		half_clock(half);
+	}
+	*dat = hi;
+	s->last = fagpio_ticks();
+	fagpio_shadow_sync(s->clk_port);
+
+	// Snapshot 8g + i into bit 7 - i of byte g of every encoder
+	for (unsigned int g = 0; g < (clocks + 7) / 8; g++) {
+		uint8_t in[8], out[8];
+
+		for (unsigned int i = 0; i < 8; i++)
+			in[7 - i] = snap[8 * g + i];
+		fagpio_transpose8(in, out);
+		for (unsigned int l = 0; l < s->lanes; l++)
+			word[l] |= (uint64_t)out[7 - l] << (56 - 8 * g);
+	}
+
+	for (unsigned int l = 0; l < s->lanes; l++) {
+		if (s->protocol == FAGPIO_BISS) {
+			biss_decode(s, word[l], &pos[l]);
+		} else {
+			pos[l].value = (uint32_t)(word[l] >> (64 - s->bits));
+			if (s->flags & FAGPIO_SSI_GRAY)
+				pos[l].value = gray_decode(pos[l].value);
+			pos[l].status = (idle >> l) & 1 ? 0 : FAGPIO_SSI_LINE;
+		}
+		good += !pos[l].status;
+	}
+	return good;
+}
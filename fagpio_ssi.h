@@ -0,0 +1,84 @@
+#ifndef _FAGPIO_SSI_H
+#define _FAGPIO_SSI_H
+
+#include <stdint.h>
+
+/*
+ * SSI and BiSS-C absolute encoders, up to 8 of them on one shared clock
+ * with their data lines on consecutive pins of one port, read in the time
+ * of one as in the wide mode of fagpio_bbspi.h. The clock (idle high) is
+ * one store of a precomputed word per edge; each cycle takes a DAT
+ * snapshot of all the data lines at the end of its high half, and the
+ * snapshots are only decoded after the last edge: eight at a time through
+ * fagpio_transpose8(), giving every encoder its bits as one 64-bit word,
+ * first bit highest.
+ *
+ * SSI: the first falling edge latches the position, which comes MSB first
+ * from the first rising edge; FAGPIO_SSI_GRAY decodes Gray code. BiSS-C:
+ * a fixed number of extra cycles covers the acknowledge and the line
+ * delay, and the start bit is found per encoder in its word, so each one
+ * may have its own cable length; CDS is ignored, nE and nW are reported
+ * and the inverted CRC6 (x^6 + x + 1) is checked. Between two reads the
+ * clock stays high for FAGPIO_SSI_PAUSE_US, the SSI monoflop time or the
+ * BiSS timeout.
+ */
+
+#define FAGPIO_SSI			0
+#define FAGPIO_BISS			1
+
+#define FAGPIO_SSI_MAX		8		//Encoders on one clock
+#define FAGPIO_SSI_CLOCKS	64		//Clock cycles of a read at most
+#define FAGPIO_SSI_GRAY		0x01	//init flags
+
+#ifndef FAGPIO_SSI_PAUSE_US
+#define FAGPIO_SSI_PAUSE_US		25
+#endif
+#ifndef FAGPIO_SSI_BISS_LATENCY
+#define FAGPIO_SSI_BISS_LATENCY	16	//Cycles allowed before a BiSS start bit
+#endif
+
+// Read status bits, 0 for a good position
+#define FAGPIO_SSI_LINE		0x01	//Data low while idle: no encoder, or still in its pause
+#define FAGPIO_SSI_NO_START	0x02	//BiSS acknowledge or start bit missing
+#define FAGPIO_SSI_CRC		0x04
+#define FAGPIO_SSI_ERROR	0x08	//BiSS nE
+#define FAGPIO_SSI_WARNING	0x10	//BiSS nW
+
+struct fagpio_ssi_pos {
+	uint32_t value;
+	uint8_t status;
+};
+
+struct fagpio_ssi {
+	uint8_t protocol;
+	uint8_t lanes;
+	uint8_t shift;			//Pin number of the first data line
+	uint8_t bits;			//Position bits
+	uint8_t flags;
+	uint8_t clk_port;
+	uint8_t clocks;			//Cycles of a read
+	uint32_t clk;			//Pin mask
+	volatile uint32_t *clk_dat, *data_dat;
+	uint32_t half_ticks;	//0 for full speed
+	uint32_t half_ns;
+	uint32_t costs_gen;
+	uint32_t pause_ticks;
+	uint32_t last;			//Counter at the end of the last read
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Data line of encoder i is first_data + i; hz 0 clocks as fast as the stores go
+int fagpio_ssi_init(struct fagpio_ssi *s, uint8_t clk, uint8_t first_data, uint8_t lanes, uint8_t protocol,
+	uint8_t bits, uint32_t hz, uint8_t flags);
+
+// pos[i] for encoder i; returns the number of good positions
+int fagpio_ssi_read(struct fagpio_ssi *s, struct fagpio_ssi_pos *pos);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
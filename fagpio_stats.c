@@ -0,0 +1,123 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "fagpio_priv.h"
+#include "fagpio_stats.h"
+#include "fagpio_timer.h"
+#include "fagpio_log.h"
+
+struct fagpio_stats *fagpio_stats_page;
+
+static char page_name[32];
+
+int fagpio_stats_enable(void) {
+	if (fagpio_stats_page)
+		return 0;
+
+	snprintf(page_name, sizeof(page_name), FAGPIO_STATS_PREFIX "%d", (int)getpid());
+
+	int fd = shm_open(page_name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+	if (fd < 0 || ftruncate(fd, sizeof(struct fagpio_stats)) < 0) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "%s: %s\n", page_name, strerror(errno));
+		if (fd >= 0) {
+			close(fd);
+			shm_unlink(page_name);
+		}
+		return -1;
+	}
+
+	struct fagpio_stats *s = mmap(NULL, sizeof(*s), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+	close(fd);
+	if (s == MAP_FAILED) {
+		shm_unlink(page_name);
+		return -1;
+	}
+	s->pid = getpid();
+	s->tick_hz = fagpio_tick_hz;
+	__sync_synchronize();
+	s->magic = FAGPIO_STATS_MAGIC;
+	fagpio_stats_page = s;
+	return 0;
+}
+
+void fagpio_stats_disable(void) {
+	struct fagpio_stats *s = fagpio_stats_page;
+
+	if (!s)
+		return;
+	fagpio_stats_page = NULL;
+	munmap(s, sizeof(*s));
+	shm_unlink(page_name);
+}
+
+void fagpio_stats_reset(void) {
+	struct fagpio_stats *s = fagpio_stats_page;
+
+	if (s) {
+		memset(s->port, 0, sizeof(s->port));
+		memset(s->pin, 0, sizeof(s->pin));
+	}
+}
+
+// Out of line so the disabled case stays a load and a branch in the callers
+void fagpio_stat_pin(uint32_t start, uint8_t pin, int kind) {
+	struct fagpio_stats *s = fagpio_stats_page;
+	uint32_t ticks = fagpio_ticks() - start;
+
+	if (!s || pin >= FAGPIO_STATS_NPORTS * 32)
+		return;
+
+	struct fagpio_stats_port *p = &s->port[PIO_PIN_PORT(pin)];
+	struct fagpio_stats_pin *q = &s->pin[pin];
+
+	p->ticks += ticks;
+	switch (kind) {
+	case FAGPIO_STAT_WRITE:
+		p->writes++;
+		q->writes++;
+		break;
+	case FAGPIO_STAT_READ:
+		p->reads++;
+		q->reads++;
+		break;
+	case FAGPIO_STAT_MODE:
+		p->modes++;
+		q->modes++;
+		break;
+	}
+}
+
+// Port calls count once per port and once for every pin in mask
+void fagpio_stat_port(uint32_t start, uint8_t port, uint32_t mask, int kind) {
+	struct fagpio_stats *s = fagpio_stats_page;
+	uint32_t ticks = fagpio_ticks() - start;
+
+	if (!s || port >= PIO_NPORTS)
+		return;
+
+	struct fagpio_stats_port *p = &s->port[port];
+	struct fagpio_stats_pin *q = &s->pin[PIO_PIN(port, 0)];
+
+	p->ticks += ticks;
+	if (kind == FAGPIO_STAT_WRITE)
+		p->writes++;
+	else if (kind == FAGPIO_STAT_READ)
+		p->reads++;
+	else
+		p->modes++;
+	for (; mask; mask &= mask - 1) {
+		struct fagpio_stats_pin *n = &q[__builtin_ctz(mask)];
+
+		if (kind == FAGPIO_STAT_WRITE)
+			n->writes++;
+		else if (kind == FAGPIO_STAT_READ)
+			n->reads++;
+		else
+			n->modes++;
+	}
+}
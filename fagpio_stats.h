@@ -0,0 +1,62 @@
+#ifndef _FAGPIO_STATS_H
+#define _FAGPIO_STATS_H
+
+#include <stdint.h>
+
+/*
+ * Operation counters. While enabled, the Arduino-style calls count per
+ * pin writes, reads and mode changes, and per port the calls and the
+ * counter ticks spent inside them, in a /dev/shm page of the process
+ * (FAGPIO_STATS_PREFIX + pid) that tools/fagpiostat reads while it runs.
+ * Disabled, a call pays one load and a branch. The page is written with
+ * plain stores: concurrent threads may lose counts, and a reader may see
+ * a 64-bit total torn. Handles of fagpio_open() and the inline fast
+ * paths (fagpio_inline.h) are not counted. fagpio_setup() enables the
+ * counters when FAGPIO_STATS is set; build the library with
+ * -DFAGPIO_STATS=0 to compile the hooks out.
+ */
+
+#ifndef FAGPIO_STATS
+#define FAGPIO_STATS		1
+#endif
+
+#define FAGPIO_STATS_PREFIX	"/fagpio-stats."
+#define FAGPIO_STATS_MAGIC	0x32534746		//"FGS2", seven ports
+#define FAGPIO_STATS_NPORTS	7				//PIO_NPORTS, for readers without fagpio.h
+
+struct fagpio_stats_pin {
+	uint32_t writes;
+	uint32_t reads;
+	uint32_t modes;
+};
+
+struct fagpio_stats_port {
+	uint32_t writes;		//Port and pin writes and toggles
+	uint32_t reads;
+	uint32_t modes;
+	uint32_t pad;
+	uint64_t ticks;			//Counter ticks spent in the calls
+};
+
+struct fagpio_stats {
+	uint32_t magic;
+	uint32_t pid;
+	uint32_t tick_hz;
+	uint32_t pad;
+	struct fagpio_stats_port port[FAGPIO_STATS_NPORTS];
+	struct fagpio_stats_pin pin[FAGPIO_STATS_NPORTS * 32];
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fagpio_stats_enable(void);		//Creates the page; 0 if it already exists
+void fagpio_stats_disable(void);	//Stops counting and removes the page
+void fagpio_stats_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
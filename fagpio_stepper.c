@@ -0,0 +1,406 @@
+#include <string.h>
+#include "fagpio_priv.h"
+#include "fagpio_stepper.h"
+#include "fagpio_timer.h"
+
+/*
+Both ramps are one normalised curve over x = t / Tr, where Tr is the time
+to max_sps: position P(x) in units of max_sps * Tr and velocity P'(x) in
+units of max_sps. P(1) is 1/2 for both, so a full ramp takes
+max_sps * Tr / 2 steps.
+*/
+static double ramp_pos(int shape, double x) {
+	return shape == FAGPIO_RAMP_SCURVE ? x * x * x - x * x * x * x / 2 : x * x / 2;
+}
+
+static double ramp_vel(int shape, double x) {
+	return shape == FAGPIO_RAMP_SCURVE ? 3 * x * x - 2 * x * x * x : x;
+}
+
+// x in [0, xmax] where the ramp reaches position p: Newton from x, kept inside by bisection
+static double ramp_solve(int shape, double p, double x, double xmax) {
+	double lo = 0, hi = xmax;
+
+	for (int i = 0; i < 64 && hi - lo > 1e-12; i++) {
+		double f = ramp_pos(shape, x) - p, d = ramp_vel(shape, x), next;
+
+		if (f > 0)
+			hi = x;
+		else
+			lo = x;
+		next = d > 0 ? x - f / d : (lo + hi) / 2;
+		x = next > lo && next < hi ? next : (lo + hi) / 2;
+	}
+	return x;
+}
+
+// Absolute times are rounded to ticks before taking deltas, so the table does not drift
+int fagpio_ramp_table(uint32_t *delta, uint32_t steps, uint32_t max_sps, uint32_t accel, int shape) {
+	double hz = fagpio_tick_hz, v = max_sps;
+
+	if (!max_sps || !accel || !fagpio_tick_hz)
+		return -1;
+
+	double tr = (shape == FAGPIO_RAMP_SCURVE ? 1.5 : 1.0) * v / accel;
+	double scale = v * tr, nr = scale / 2, xr = 1;
+
+	if (nr > steps / 2.0) {
+		nr = steps / 2.0;
+		xr = ramp_solve(shape, nr / scale, 1, 1);
+	}
+
+	double vr = v * ramp_vel(shape, xr), tup = tr * xr;
+	double total = 2 * tup + (steps - 2 * nr) / vr, x = 0;
+	uint64_t prev = 0;
+
+	for (uint32_t k = 1; k <= steps; k++) {
+		double t;
+
+		if (k <= nr) {
+			x = ramp_solve(shape, k / scale, x, xr);
+			t = tr * x;
+		} else if (k < steps - nr) {
+			t = tup + (k - nr) / vr;
+		} else {
+			x = ramp_solve(shape, (steps - k) / scale, x, xr);
+			t = total - tr * x;
+		}
+
+		uint64_t at = (uint64_t)(t * hz + 0.5);
+
+		delta[k - 1] = at - prev;
+		prev = at;
+	}
+	return 0;
+}
+
+int fagpio_stepper_init(struct fagpio_stepper *s, struct fagpio_seq_op *ops, unsigned int capacity,
+		uint32_t pulse_ns, uint32_t dir_setup_ns) {
+	memset(s, 0, sizeof(*s));
+	if (fagpio_setup() < 0)
+		return -1;
+	fagpio_seq_init(&s->seq, ops, capacity);
+	s->pulse = fagpio_ns_to_ticks(pulse_ns);
+	if (!s->pulse)
+		s->pulse = 1;
+	s->dir_setup = fagpio_ns_to_ticks(dir_setup_ns);
+	return 0;
+}
+
+int fagpio_stepper_add(struct fagpio_stepper *s, uint8_t step_pin, uint8_t dir_pin) {
+	if (s->naxes == FAGPIO_STEPPER_AXES)
+		return -1;
+
+	struct fagpio_stepper_axis *a = &s->axis[s->naxes];
+
+	memset(a, 0, sizeof(*a));
+	a->step_pin = step_pin;
+	a->dir_pin = dir_pin;
+	fagpio_digital_write(fagpio_default(), step_pin, LOW);
+	fagpio_digital_write(fagpio_default(), dir_pin, LOW);
+	pinMode(step_pin, OUTPUT);
+	pinMode(dir_pin, OUTPUT);
+	return s->naxes++;
+}
+
+// DIR is high for positive steps
+int fagpio_stepper_move(struct fagpio_stepper *s, unsigned int axis, int32_t steps, const uint32_t *delta) {
+	if (axis >= s->naxes || (steps && !delta))
+		return -1;
+
+	struct fagpio_stepper_axis *a = &s->axis[axis];
+
+	a->dir = steps >= 0;
+	a->steps = steps < 0 ? -(uint32_t)steps : (uint32_t)steps;
+	a->delta = delta;
+	return 0;
+}
+
+static int add_edge(struct fagpio_stepper *s, uint8_t pin, int high, uint32_t at) {
+	return fagpio_seq_add(&s->seq, PIO_PIN_PORT(pin), PIO_PIN_MASK(pin), high ? PIO_PIN_MASK(pin) : 0, at - s->seq.end);
+}
+
+/*
+A merge of the axes' event streams by time. Each axis has at most two
+events pending, its next rising edge and the falling edge of the step
+before; at equal ticks falling edges go first, so a fall and another
+axis' rise on the same port become one store.
+*/
+int fagpio_stepper_compile(struct fagpio_stepper *s) {
+	uint32_t rise[FAGPIO_STEPPER_AXES], fall[FAGPIO_STEPPER_AXES], done[FAGPIO_STEPPER_AXES] = { 0 };
+	uint8_t falling[FAGPIO_STEPPER_AXES] = { 0 };
+
+	fagpio_seq_init(&s->seq, s->seq.ops, s->seq.capacity);
+	for (unsigned int i = 0; i < s->naxes; i++) {
+		struct fagpio_stepper_axis *a = &s->axis[i];
+
+		a->pending = a->dir ? (int32_t)a->steps : -(int32_t)a->steps;
+		if (!a->steps)
+			continue;
+		if (add_edge(s, a->dir_pin, a->dir, 0) < 0)
+			return -1;
+		rise[i] = s->dir_setup + a->delta[0];
+	}
+
+	for (;;) {
+		int next = -1, is_fall = 0;
+		uint32_t at = 0;
+
+		for (unsigned int i = 0; i < s->naxes; i++) {
+			if (falling[i] && (next < 0 || fall[i] < at || (fall[i] == at && !is_fall))) {
+				next = i;
+				at = fall[i];
+				is_fall = 1;
+			}
+			if (done[i] < s->axis[i].steps && (next < 0 || rise[i] < at)) {
+				next = i;
+				at = rise[i];
+				is_fall = 0;
+			}
+		}
+		if (next < 0)
+			return 0;
+
+		struct fagpio_stepper_axis *a = &s->axis[next];
+
+		if (is_fall) {
+			falling[next] = 0;
+			if (add_edge(s, a->step_pin, 0, at) < 0)
+				return -1;
+			continue;
+		}
+		if (falling[next] || add_edge(s, a->step_pin, 1, at) < 0)		//Previous pulse still high: delta <= pulse
+			return -1;
+		falling[next] = 1;
+		fall[next] = at + s->pulse;
+		if (++done[next] < a->steps)
+			rise[next] = at + a->delta[done[next]];
+	}
+}
+
+int fagpio_stepper_run(struct fagpio_stepper *s) {
+	if (fagpio_seq_play(&s->seq) < 0)
+		return -1;
+	for (unsigned int i = 0; i < s->naxes; i++) {
+		struct fagpio_stepper_axis *a = &s->axis[i];
+
+		a->position += a->pending;
+		a->pending = 0;
+		a->steps = 0;
+	}
+	return s->seq.late;
+}
+
+void fagpio_stepper_begin(struct fagpio_stepper *s) {
+	fagpio_seq_init(&s->seq, s->seq.ops, s->seq.capacity);
+	for (unsigned int i = 0; i < s->naxes; i++) {
+		s->axis[i].pending = 0;
+		s->axis[i].steps = 0;
+	}
+	s->path_at = s->dir_setup;
+	s->path_free = 0;
+	s->path_known = 0;
+}
+
+/*
+One path event delta ticks after the last: move holds -1, 0 or 1 per
+axis, dir the directions to have set by then (move itself, or a whole
+line's so its DIR edges all go before its first step). DIR edges that
+change go dir_setup before the rise, which must
+leave the previous pulse's fall at or before them; then the STEP pins of
+all moving axes rise in one store per port and fall pulse later.
+*/
+static int path_event(struct fagpio_stepper *s, const int8_t *move, const int8_t *dir_of, uint32_t delta) {
+	uint32_t step[PIO_NPORTS] = { 0 }, dir[PIO_NPORTS] = { 0 }, level[PIO_NPORTS] = { 0 };
+	uint32_t at = s->path_at + delta;
+	int dirs = 0;
+
+	if (delta <= s->pulse)
+		return -1;
+	for (unsigned int i = 0; i < s->naxes; i++) {
+		struct fagpio_stepper_axis *a = &s->axis[i];
+		uint8_t d = dir_of[i] > 0;
+
+		if (!dir_of[i])
+			continue;
+		if (!(s->path_known & (1u << i)) || a->path_dir != d) {
+			dir[PIO_PIN_PORT(a->dir_pin)] |= PIO_PIN_MASK(a->dir_pin);
+			level[PIO_PIN_PORT(a->dir_pin)] |= d ? PIO_PIN_MASK(a->dir_pin) : 0;
+			a->path_dir = d;
+			s->path_known |= 1u << i;
+			dirs = 1;
+		}
+		if (!move[i])
+			continue;
+		step[PIO_PIN_PORT(a->step_pin)] |= PIO_PIN_MASK(a->step_pin);
+		a->pending += move[i];
+	}
+	if (dirs) {
+		uint32_t t = at - s->dir_setup;
+
+		if (at - s->path_free < s->dir_setup)
+			return -1;
+		for (uint8_t port = 0; port < PIO_NPORTS; port++) {
+			if (dir[port] && fagpio_seq_add(&s->seq, port, dir[port], level[port], t - s->seq.end) < 0)
+				return -1;
+		}
+	}
+	for (uint8_t port = 0; port < PIO_NPORTS; port++) {
+		if (step[port] && fagpio_seq_add(&s->seq, port, step[port], step[port], at - s->seq.end) < 0)
+			return -1;
+	}
+	for (uint8_t port = 0; port < PIO_NPORTS; port++) {
+		if (step[port] && fagpio_seq_add(&s->seq, port, step[port], 0, at + s->pulse - s->seq.end) < 0)
+			return -1;
+	}
+	s->path_at = at;
+	s->path_free = at + s->pulse;
+	return 0;
+}
+
+static uint32_t abs32(int32_t v) {
+	return v < 0 ? -(uint32_t)v : (uint32_t)v;
+}
+
+// Bresenham over the longest axis, the others step when their error crosses half of it
+int fagpio_stepper_line(struct fagpio_stepper *s, const int32_t *steps, const uint32_t *delta) {
+	uint32_t major = 0, err[FAGPIO_STEPPER_AXES];
+	int8_t move[FAGPIO_STEPPER_AXES], dir[FAGPIO_STEPPER_AXES];
+
+	for (unsigned int i = 0; i < s->naxes; i++) {
+		if (abs32(steps[i]) > major)
+			major = abs32(steps[i]);
+		dir[i] = (steps[i] > 0) - (steps[i] < 0);
+	}
+	if (major && !delta)
+		return -1;
+	for (unsigned int i = 0; i < s->naxes; i++)
+		err[i] = major / 2;
+	for (uint32_t k = 0; k < major; k++) {
+		for (unsigned int i = 0; i < s->naxes; i++) {
+			err[i] += abs32(steps[i]);
+			move[i] = 0;
+			if (err[i] >= major) {
+				err[i] -= major;
+				move[i] = steps[i] < 0 ? -1 : 1;
+			}
+		}
+		if (path_event(s, move, k ? move : dir, delta[k]) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+/*
+The arc walk keeps x, y relative to the centre and r2 its squared
+radius. Each event moves along the tangent: one axis, the other, or
+both, whichever lands nearest the circle. The walk ends once it has left
+the end point's neighbourhood and come back to it, with a last move onto
+the end if it is not on the rasterised circle itself, or once it steps
+onto the end exactly.
+*/
+struct arc_walk {
+	int64_t r2;
+	int32_t x, y, ex, ey;
+	uint32_t limit;
+	int ccw, left, moved, done;
+};
+
+static int arc_init(struct arc_walk *w, int32_t i, int32_t j, int32_t x, int32_t y, int ccw) {
+	w->x = -i;
+	w->y = -j;
+	w->ex = x - i;
+	w->ey = y - j;
+	w->r2 = (int64_t)i * i + (int64_t)j * j;
+	w->ccw = ccw;
+	w->left = 0;
+	w->moved = w->done = 0;
+
+	int64_t e2 = (int64_t)w->ex * w->ex + (int64_t)w->ey * w->ey;
+	uint32_t r = abs32(i) + abs32(j);
+
+	if (!w->r2 || r > 1u << 30)
+		return -1;
+	if (e2 > w->r2 + 2 * (int64_t)r + 2 || e2 + 2 * (int64_t)r < w->r2 + 2)		//More than a step off the circle
+		return -1;
+	w->limit = 8 * r + 8;		//A full turn takes at most 4 r events for r = |i| + |j|
+	return 0;
+}
+
+static int near_end(const struct arc_walk *w) {
+	return abs32(w->x - w->ex) <= 1 && abs32(w->y - w->ey) <= 1;
+}
+
+static int64_t off_circle(const struct arc_walk *w, int dx, int dy) {
+	int64_t x = w->x + dx, y = w->y + dy, d = x * x + y * y - w->r2;
+
+	return d < 0 ? -d : d;
+}
+
+// Next move into dx, dy: 1 while the walk goes on, 0 at the end, -1 if it never gets there
+static int arc_next(struct arc_walk *w, int *dx, int *dy) {
+	if (w->done)
+		return 0;
+	if ((w->left && near_end(w)) || (w->moved && w->x == w->ex && w->y == w->ey)) {
+		*dx = w->ex - w->x;
+		*dy = w->ey - w->y;
+		w->x = w->ex;
+		w->y = w->ey;
+		w->done = 1;
+		return *dx || *dy;
+	}
+	if (!w->limit--)
+		return -1;
+
+	int tx = w->ccw ? -w->y : w->y, ty = w->ccw ? w->x : -w->x;		//Tangent
+	int sx = (tx > 0) - (tx < 0), sy = (ty > 0) - (ty < 0);
+	int best_x = sx, best_y = sy;
+	int64_t best = off_circle(w, sx, sy);
+
+	if (sx && off_circle(w, sx, 0) < best) {
+		best = off_circle(w, sx, 0);
+		best_x = sx;
+		best_y = 0;
+	}
+	if (sy && off_circle(w, 0, sy) < best) {
+		best_x = 0;
+		best_y = sy;
+	}
+	*dx = best_x;
+	*dy = best_y;
+	w->x += best_x;
+	w->y += best_y;
+	w->moved = 1;
+	if (!near_end(w))
+		w->left = 1;
+	return 1;
+}
+
+int fagpio_arc_events(int32_t i, int32_t j, int32_t x, int32_t y, int ccw) {
+	struct arc_walk w;
+	int dx, dy, r, n = 0;
+
+	if (arc_init(&w, i, j, x, y, ccw) < 0)
+		return -1;
+	while ((r = arc_next(&w, &dx, &dy)) > 0)
+		n++;
+	return r < 0 ? -1 : n;
+}
+
+int fagpio_stepper_arc(struct fagpio_stepper *s, unsigned int ax, unsigned int ay,
+	int32_t i, int32_t j, int32_t x, int32_t y, int ccw, const uint32_t *delta) {
+	int8_t move[FAGPIO_STEPPER_AXES] = { 0 };
+	struct arc_walk w;
+	int dx, dy, r;
+
+	if (ax >= s->naxes || ay >= s->naxes || ax == ay || !delta || fagpio_arc_events(i, j, x, y, ccw) < 0)
+		return -1;
+	arc_init(&w, i, j, x, y, ccw);
+	for (uint32_t k = 0; (r = arc_next(&w, &dx, &dy)) > 0; k++) {
+		move[ax] = dx;
+		move[ay] = dy;
+		if (path_event(s, move, move, delta[k]) < 0)
+			return -1;
+	}
+	return 0;
+}
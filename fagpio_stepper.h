@@ -0,0 +1,98 @@
+#ifndef _FAGPIO_STEPPER_H
+#define _FAGPIO_STEPPER_H
+
+#include <stdint.h>
+#include "fagpio_seq.h"
+
+/*
+ * STEP/DIR stepper drivers on the waveform sequencer (fagpio_seq.h).
+ * fagpio_ramp_table() precomputes a move's acceleration profile as tick
+ * deltas between steps, once and outside any loop. fagpio_stepper_compile()
+ * merges the queued moves of every axis into one timeline: DIR first,
+ * then each STEP rising edge and, pulse ticks later, its falling edge, one
+ * op per event, and events on one port at the same tick share a store.
+ * fagpio_stepper_run() plays it on the AVS counter, so step timing has
+ * the sequencer's jitter, not usleep()'s, and all axes stay in lockstep.
+ *
+ * A trapezoidal ramp accelerates at accel steps/s^2 up to max_sps. A
+ * S-curve ramp follows a smoothstep velocity with accel as its peak
+ * acceleration (the ramp takes 1.5 times as long), so the acceleration
+ * itself has no steps. Moves too short to reach max_sps turn at halfway.
+ * A timeline is limited to 2^32 ticks, about three minutes at 24 MHz.
+ *
+ * Coordinated paths go on the same timeline: after fagpio_stepper_begin(),
+ * fagpio_stepper_line() and fagpio_stepper_arc() append moves whose axes
+ * step in lockstep. A line is Bresenham over the axis with the most steps,
+ * an arc walks the rasterised circle in 8-connected steps; either way each
+ * event is one rising and one falling store per port for every axis that
+ * steps in it, DIR stores before it when a direction changes. Every
+ * segment runs its own ramp from rest, one delta per event; there is no
+ * look-ahead between segments. A line sets all its DIR pins before its
+ * first step; an arc changes them where it crosses an axis, so its deltas
+ * must leave dir_setup after each pulse. On -1 the timeline holds part of
+ * the segment: start again with fagpio_stepper_begin().
+ */
+
+#define FAGPIO_STEPPER_AXES		4
+
+#define FAGPIO_RAMP_TRAPEZOID	0
+#define FAGPIO_RAMP_SCURVE		1
+
+struct fagpio_stepper_axis {
+	uint8_t step_pin;
+	uint8_t dir_pin;
+	uint8_t dir;				//Level of DIR for the queued move
+	const uint32_t *delta;		//Ticks before each step of the queued move
+	uint32_t steps;
+	int32_t position;			//Steps after the moves played so far
+	int32_t pending;			//Steps on the timeline, added to position by fagpio_stepper_run()
+	uint8_t path_dir;			//DIR level last put on the path timeline
+};
+
+struct fagpio_stepper {
+	struct fagpio_seq seq;
+	uint32_t pulse;				//STEP high time, ticks
+	uint32_t dir_setup;			//DIR to first STEP, ticks
+	unsigned int naxes;
+	struct fagpio_stepper_axis axis[FAGPIO_STEPPER_AXES];
+	uint32_t path_at;			//Tick of the last path event
+	uint32_t path_free;			//First tick after its falling edge
+	uint8_t path_known;			//Axes whose DIR level is on the path timeline
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Ticks before each of steps steps of a move from rest to rest; -1 if the rates are 0
+int fagpio_ramp_table(uint32_t *delta, uint32_t steps, uint32_t max_sps, uint32_t accel, int shape);
+
+int fagpio_stepper_init(struct fagpio_stepper *s, struct fagpio_seq_op *ops, unsigned int capacity,
+	uint32_t pulse_ns, uint32_t dir_setup_ns);
+int fagpio_stepper_add(struct fagpio_stepper *s, uint8_t step_pin, uint8_t dir_pin);		//Axis number, -1 if full
+
+// Queues a move of |steps| steps, negative steps reverse; delta needs |steps| entries and outlives the compile
+int fagpio_stepper_move(struct fagpio_stepper *s, unsigned int axis, int32_t steps, const uint32_t *delta);
+int fagpio_stepper_compile(struct fagpio_stepper *s);	//-1 if the ops run out or a delta is not above pulse
+int fagpio_stepper_run(struct fagpio_stepper *s);		//Plays the compiled moves, returns the overdue ops
+
+void fagpio_stepper_begin(struct fagpio_stepper *s);		//Empties the timeline for lines and arcs
+
+// steps has one signed count per axis, delta one entry per step of the longest axis
+int fagpio_stepper_line(struct fagpio_stepper *s, const int32_t *steps, const uint32_t *delta);
+
+/*
+ * Arc in the plane of axes ax and ay, like G2/G3: i, j is the centre and
+ * x, y the end, both relative to the current position. The end must lie
+ * within one step of the circle. fagpio_arc_events() gives the number of
+ * events, the size of its ramp table; -1 if the walk misses the end.
+ */
+int fagpio_arc_events(int32_t i, int32_t j, int32_t x, int32_t y, int ccw);
+int fagpio_stepper_arc(struct fagpio_stepper *s, unsigned int ax, unsigned int ay,
+	int32_t i, int32_t j, int32_t x, int32_t y, int ccw, const uint32_t *delta);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
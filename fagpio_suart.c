@@ -0,0 +1,106 @@
+#include "fagpio.h"
+#include "fagpio_suart.h"
+#include "fagpio_timer.h"
+
+int fagpio_suart_init(struct fagpio_suart *u, uint8_t tx_pin, uint8_t rx_pin, uint32_t baud, struct fagpio_seq_op *ops, unsigned int nops) {
+	if (!baud || PIO_PIN_PORT(tx_pin) >= PIO_NPORTS || PIO_PIN_PORT(rx_pin) >= PIO_NPORTS || nops < 10)
+		return -1;
+
+	u->tx_pin = tx_pin;
+	u->rx_pin = rx_pin;
+	u->baud = baud;
+	u->ops = ops;
+	u->nops = nops;
+	u->rx_format = 0;
+	u->framing_errors = 0;
+
+	fagpio_digital_write(fagpio_default(), tx_pin, HIGH);		//Idle
+	pinMode(tx_pin, 0);
+	pinMode(rx_pin, 1);
+	return 0;
+}
+
+// Tick of bit boundary n, rounded from absolute time so errors never add up
+static inline uint32_t bit_tick(const struct fagpio_suart *u, uint32_t n) {
+	return (uint32_t)(((uint64_t)n * fagpio_tick_hz + u->baud / 2) / u->baud);
+}
+
+int fagpio_suart_write(struct fagpio_suart *u, const uint8_t *buf, size_t len) {
+	uint8_t port = PIO_PIN_PORT(u->tx_pin);
+	uint32_t mask = PIO_PIN_MASK(u->tx_pin);
+	size_t done = 0;
+
+	while (done < len) {
+		struct fagpio_seq seq;
+		uint32_t n = 0;
+		int level = 1;
+
+		fagpio_seq_init(&seq, u->ops, u->nops);
+		for (; done < len && seq.count + 10 <= u->nops; done++, n += 10) {
+			uint16_t frame = (uint16_t)(buf[done] << 1) | 0x200;		//Start 0, data LSB first, stop 1
+
+			for (int i = 0; i < 10; i++) {
+				int bit = (frame >> i) & 1;
+
+				if (bit != level) {
+					fagpio_seq_add(&seq, port, mask, bit ? mask : 0, bit_tick(u, n + i) - seq.end);
+					level = bit;
+				}
+			}
+		}
+		fagpio_seq_add(&seq, port, mask, mask, bit_tick(u, n) - seq.end);	//End of the last stop bit
+		if (fagpio_seq_play(&seq) < 0)
+			return done ? (int)done : -1;
+	}
+	return done;
+}
+
+int fagpio_suart_decode(struct fagpio_suart *u, const struct fagpio_sample *samples, int count, uint8_t *buf, size_t max) {
+	int inv = (u->rx_format & FAGPIO_SUART_INVERT) != 0, par = (u->rx_format & FAGPIO_SUART_EVEN) != 0;
+	int bits = 9 + par + ((u->rx_format & FAGPIO_SUART_2STOP) != 0);		//After the start bit
+	size_t n = 0;
+	int e = 1;			//Next edge to look at
+
+	if (count < 1)
+		return 0;
+
+	while (n < max) {
+		// A start bit is an edge to logical low
+		while (e < count && (samples[e].value != 0) != inv)
+			e++;
+		if (e >= count)
+			break;
+
+		uint32_t start = samples[e].ticks;
+		uint32_t v = 0;
+		int k = e, ok = 1;		//k: last edge at or before the sampling point
+
+		for (int i = 1; i <= bits; i++) {
+			uint32_t at = start + bit_tick(u, 2 * i + 1) / 2;		//Middle of bit i
+			int bit;
+
+			while (k + 1 < count && (int32_t)(samples[k + 1].ticks - at) <= 0)
+				k++;
+			bit = (samples[k].value != 0) != inv;
+			if (i <= 8 + par)
+				v |= (uint32_t)bit << (i - 1);
+			else
+				ok &= bit;		//Stop bits
+		}
+		if (par && __builtin_parity(v))
+			ok = 0;
+		if (ok)
+			buf[n++] = v;
+		else
+			u->framing_errors++;
+		e = k + 1;
+	}
+	return n;
+}
+
+int fagpio_suart_read(struct fagpio_suart *u, uint8_t *buf, size_t max, uint32_t timeout_us, struct fagpio_sample *samples, unsigned int nsamples) {
+	uint32_t timeout = (uint32_t)((uint64_t)timeout_us * fagpio_tick_hz / 1000000);
+	int count = fagpio_capture_edges(PIO_PIN_PORT(u->rx_pin), PIO_PIN_MASK(u->rx_pin), samples, nsamples, timeout ? timeout : 1);
+
+	return count < 0 ? -1 : fagpio_suart_decode(u, samples, count, buf, max);
+}
@@ -0,0 +1,54 @@
+#ifndef _FAGPIO_SUART_H
+#define _FAGPIO_SUART_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fagpio_capture.h"
+#include "fagpio_seq.h"
+
+/*
+ * Software UART, 8N1. TX compiles a whole buffer into sequencer ops
+ * (fagpio_seq.h) in one pass, one op per level change at bit boundaries
+ * rounded from absolute time, so there is no per-bit work during playback
+ * and no drift at 115200 baud. RX records the line with
+ * fagpio_capture_edges() and decodes frames from the timestamps
+ * afterwards, sampling each bit at its middle relative to the start edge.
+ * rx_format selects another RX frame, such as SBUS's inverted 8E2; TX
+ * stays 8N1.
+ */
+
+#define FAGPIO_SUART_INVERT		0x01	//Idle low, start bit high
+#define FAGPIO_SUART_EVEN		0x02	//Even parity bit after the data
+#define FAGPIO_SUART_2STOP		0x04
+
+struct fagpio_suart {
+	uint8_t tx_pin;
+	uint8_t rx_pin;
+	uint32_t baud;
+	struct fagpio_seq_op *ops;		//Caller storage for TX, up to 10 ops per byte
+	unsigned int nops;
+	uint8_t rx_format;				//FAGPIO_SUART_*, 0 after init: 8N1
+	unsigned int framing_errors;	//Including parity errors
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fagpio_suart_init(struct fagpio_suart *u, uint8_t tx_pin, uint8_t rx_pin, uint32_t baud, struct fagpio_seq_op *ops, unsigned int nops);
+int fagpio_suart_write(struct fagpio_suart *u, const uint8_t *buf, size_t len);	//Bytes sent
+
+/*
+ * Captures RX into samples for up to timeout_us (or until nsamples edges)
+ * and decodes it; returns the number of bytes stored in buf.
+ */
+int fagpio_suart_read(struct fagpio_suart *u, uint8_t *buf, size_t max, uint32_t timeout_us, struct fagpio_sample *samples, unsigned int nsamples);
+
+// Decoder of fagpio_suart_read(), for captures taken elsewhere
+int fagpio_suart_decode(struct fagpio_suart *u, const struct fagpio_sample *samples, int count, uint8_t *buf, size_t max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
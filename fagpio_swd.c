@@ -0,0 +1,315 @@
+#include "fagpio_priv.h"
+#include "fagpio_swd.h"
+#include "fagpio_timer.h"
+#include "fagpio_log.h"
+
+#define DP_IDCODE			0x0			//Read
+#define DP_ABORT			0x0			//Write
+#define DP_CTRL_STAT		0x4
+#define DP_SELECT			0x8
+#define DP_RDBUFF			0xC
+
+#define AP_CSW				0x00
+#define AP_TAR				0x04
+#define AP_DRW				0x0C
+
+#define ABORT_CLEAR			0x1E		//STKCMPCLR, STKERRCLR, WDERRCLR, ORUNERRCLR
+#define CTRL_PWRUP_REQ		0x50000000	//CSYSPWRUPREQ, CDBGPWRUPREQ
+#define CTRL_PWRUP_ACK		0xA0000000
+#define CSW_WORD_INC		0x23000012	//32-bit, single auto-increment, privileged data master
+#define TAR_WRAP			0x400		//Auto-increment is only guaranteed within 1 KB
+
+#define DHCSR				0xE000EDF0
+#define DHCSR_HALT			0xA05F0003	//DBGKEY, C_HALT, C_DEBUGEN
+#define DHCSR_S_HALT		(1u << 17)
+
+#define JTAG_TO_SWD			0xE79E
+#define SWD_TIMEOUT_MS		100		//Power-up and halt acknowledges
+
+int fagpio_swd_init(struct fagpio_swd *s, uint8_t swclk, uint8_t swdio, uint32_t hz) {
+	struct pio_bank *banks = fagpio_banks();
+
+	if (!banks || PIO_PIN_PORT(swclk) >= PIO_NPORTS || PIO_PIN_PORT(swdio) != PIO_PIN_PORT(swclk))
+		return -1;
+
+	s->port = PIO_PIN_PORT(swclk);
+	s->dio_bit = PIO_PIN_NUM(swdio);
+	s->dio_shift = (PIO_PIN_NUM(swdio) & 7) * 4;
+	s->ap = 0;
+	s->clk = PIO_PIN_MASK(swclk);
+	s->dio = PIO_PIN_MASK(swdio);
+	s->dat = &banks[s->port].dat;
+	s->dio_cfg = &banks[s->port].cfg[PIO_PIN_NUM(swdio) >> 3];
+	s->half_ns = hz ? 1000000000 / (2 * hz) : 0;
+	s->costs_gen = fagpio_costs_gen;
+	s->half_ticks = hz ? fagpio_pad_ticks(s->half_ns, 0, 1) : 0;	//Each half clock is one store
+	s->retries = FAGPIO_SWD_RETRIES;
+	s->idle = 0;
+	s->select = ~0u;
+	s->idcode = 0;
+
+	digitalWritePort(s->port, s->clk | s->dio, s->dio);
+	pinMode(swclk, 0);
+	pinMode(swdio, 0);
+	pinPull(swdio, PULL_UP);		//Holds SWDIO through the turnarounds
+	return 0;
+}
+
+static inline void half_clock(uint32_t ticks) {
+	if (ticks)
+		fagpio_delay_cycles(ticks);
+}
+
+static void __attribute__((noinline)) retime_slow(struct fagpio_swd *s) {
+	if (fagpio_costs_update(&s->costs_gen))
+		s->half_ticks = s->half_ns ? fagpio_pad_ticks(s->half_ns, 0, 1) : 0;
+}
+
+static inline void retime(struct fagpio_swd *s) {
+	if (s->costs_gen != fagpio_costs_gen)
+		retime_slow(s);
+}
+
+static inline void dio_output(struct fagpio_swd *s) {
+	*s->dio_cfg = (*s->dio_cfg & ~(15u << s->dio_shift)) | (1u << s->dio_shift);
+}
+
+static inline void dio_input(struct fagpio_swd *s) {
+	*s->dio_cfg &= ~(15u << s->dio_shift);
+}
+
+// n bits of data, LSB first: SWDIO changes while SWCLK is low, the target samples the rising edge
+static FAGPIO_ARM_CODE void write_bits(struct fagpio_swd *s, uint32_t base, uint32_t data, unsigned int n) {
+	volatile uint32_t *dat = s->dat;
+	uint32_t half = s->half_ticks, clk = s->clk, dio = s->dio;
+
+	for (; n; n--, data >>= 1) {
+		uint32_t w = base | (-(data & 1) & dio);
+
+		*dat = w;
+		half_clock(half);
+		*dat = w | clk;
+		half_clock(half);
+	}
+}
+
+// The target drives SWDIO after a rising edge; it is sampled before the next one
+static FAGPIO_ARM_CODE uint32_t read_bits(struct fagpio_swd *s, uint32_t base, unsigned int n) {
+	volatile uint32_t *dat = s->dat;
+	uint32_t half = s->half_ticks, clk = s->clk, in = 0;
+	uint8_t bit = s->dio_bit;
+
+	for (unsigned int i = 0; i < n; i++) {
+		*dat = base;
+		half_clock(half);
+		in |= ((*dat >> bit) & 1) << i;
+		*dat = base | clk;
+		half_clock(half);
+	}
+	return in;
+}
+
+/*
+Start, APnDP, RnW, A2, A3, parity, stop, park; then a turnaround, the
+three ACK bits and, on OK, the data phase. A WAIT or FAULT has no data
+phase with overrun detection off and is only followed by a turnaround;
+anything else may be a target still driving a data phase, so 33 more
+clocks are read before turning around.
+*/
+int fagpio_swd_transfer(struct fagpio_swd *s, uint8_t req, uint32_t *data) {
+	uint32_t base, packet, value, parity;
+	int ack;
+
+	retime(s);
+	base = *s->dat & ~(s->clk | s->dio);
+	req &= 0x0F;
+	packet = 0x81 | (req << 1) | ((uint32_t)__builtin_parity(req) << 5);
+
+	for (uint32_t tries = 0; ; tries++) {
+		write_bits(s, base, packet, 8);
+		dio_input(s);
+		ack = read_bits(s, base, 4) >> 1;		//Turnaround, then ACK
+		if (ack == FAGPIO_SWD_OK) {
+			if (req & FAGPIO_SWD_READ) {
+				value = read_bits(s, base, 32);
+				parity = read_bits(s, base, 2) & 1;		//Parity, turnaround
+				dio_output(s);
+				if (parity != (uint32_t)__builtin_parity(value))
+					ack = FAGPIO_SWD_PARITY;
+				else if (data)
+					*data = value;
+			} else {
+				read_bits(s, base, 1);
+				dio_output(s);
+				write_bits(s, base, *data, 32);
+				write_bits(s, base, __builtin_parity(*data), 1);
+			}
+			break;
+		}
+		if (ack != FAGPIO_SWD_WAIT && ack != FAGPIO_SWD_FAULT)
+			read_bits(s, base, 33);
+		read_bits(s, base, 1);
+		dio_output(s);
+		if (ack != FAGPIO_SWD_WAIT || tries >= s->retries)
+			break;
+	}
+
+	write_bits(s, base, 0, s->idle);
+	fagpio_shadow_sync(s->port);
+	return ack;
+}
+
+// 0 on OK; a FAULT clears the sticky errors so the next transaction can run
+static int check(struct fagpio_swd *s, int ack) {
+	uint32_t clear = ABORT_CLEAR;
+
+	if (ack == FAGPIO_SWD_OK)
+		return 0;
+	if (ack == FAGPIO_SWD_FAULT)
+		fagpio_swd_transfer(s, DP_ABORT, &clear);
+	return -1;
+}
+
+int fagpio_swd_dp_read(struct fagpio_swd *s, uint8_t addr, uint32_t *value) {
+	return check(s, fagpio_swd_transfer(s, FAGPIO_SWD_READ | (addr & 0xC), value));
+}
+
+int fagpio_swd_dp_write(struct fagpio_swd *s, uint8_t addr, uint32_t value) {
+	int ret = check(s, fagpio_swd_transfer(s, addr & 0xC, &value));
+
+	if ((addr & 0xC) == DP_SELECT)
+		s->select = ret ? ~0u : value;
+	return ret;
+}
+
+static int select_bank(struct fagpio_swd *s, uint8_t addr) {
+	uint32_t select = ((uint32_t)s->ap << 24) | (addr & 0xF0);
+
+	if (select == s->select)
+		return 0;
+	return fagpio_swd_dp_write(s, DP_SELECT, select);
+}
+
+// AP reads are posted: the value arrives with the next read, here RDBUFF
+int fagpio_swd_ap_read(struct fagpio_swd *s, uint8_t addr, uint32_t *value) {
+	if (select_bank(s, addr) < 0 || check(s, fagpio_swd_transfer(s, FAGPIO_SWD_AP | FAGPIO_SWD_READ | (addr & 0xC), NULL)) < 0)
+		return -1;
+	return fagpio_swd_dp_read(s, DP_RDBUFF, value);
+}
+
+int fagpio_swd_ap_write(struct fagpio_swd *s, uint8_t addr, uint32_t value) {
+	if (select_bank(s, addr) < 0)
+		return -1;
+	return check(s, fagpio_swd_transfer(s, FAGPIO_SWD_AP | (addr & 0xC), &value));
+}
+
+static void line_reset(struct fagpio_swd *s) {
+	uint32_t base;
+
+	retime(s);
+	base = *s->dat & ~(s->clk | s->dio);
+	write_bits(s, base, ~0u, 32);
+	write_bits(s, base, ~0u, 24);			//More than 50 ones
+	write_bits(s, base, 0, 2);
+	fagpio_shadow_sync(s->port);
+}
+
+int fagpio_swd_connect(struct fagpio_swd *s) {
+	uint32_t ctrl = 0, limit = fagpio_tick_hz / 1000 * SWD_TIMEOUT_MS, start;
+
+	line_reset(s);
+	write_bits(s, *s->dat & ~(s->clk | s->dio), JTAG_TO_SWD, 16);
+	line_reset(s);
+	s->select = ~0u;
+	if (fagpio_swd_dp_read(s, DP_IDCODE, &s->idcode) < 0) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "SWD: no answer to IDCODE\n");
+		return -1;
+	}
+	if (fagpio_swd_dp_write(s, DP_ABORT, ABORT_CLEAR) < 0 || fagpio_swd_dp_write(s, DP_CTRL_STAT, CTRL_PWRUP_REQ) < 0)
+		return -1;
+
+	start = fagpio_ticks();
+	do {
+		if (fagpio_swd_dp_read(s, DP_CTRL_STAT, &ctrl) < 0)
+			return -1;
+	} while ((ctrl & CTRL_PWRUP_ACK) != CTRL_PWRUP_ACK && fagpio_ticks() - start < limit);
+	if ((ctrl & CTRL_PWRUP_ACK) != CTRL_PWRUP_ACK) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "SWD: debug power-up not acknowledged (CTRL/STAT %08x)\n", ctrl);
+		return -1;
+	}
+	FAGPIO_LOG(FAGPIO_LOG_INFO, "SWD: IDCODE %08x\n", s->idcode);
+	return 0;
+}
+
+// Words up to the next 1 KB boundary, where TAR has to be written again
+static size_t tar_run(uint32_t addr, size_t count) {
+	size_t n = (TAR_WRAP - (addr & (TAR_WRAP - 1))) / 4;
+
+	return n < count ? n : count;
+}
+
+/*
+Each DRW read returns the word of the read before it, so a run is one
+TAR write, n DRW reads and the RDBUFF read that collects the last word.
+*/
+int fagpio_swd_mem_read(struct fagpio_swd *s, uint32_t addr, uint32_t *buf, size_t count) {
+	if (addr & 3)
+		return -1;
+	if (count && fagpio_swd_ap_write(s, AP_CSW, CSW_WORD_INC) < 0)
+		return -1;
+	while (count) {
+		size_t n = tar_run(addr, count);
+
+		if (fagpio_swd_ap_write(s, AP_TAR, addr) < 0)
+			return -1;
+		for (size_t i = 0; i < n; i++) {
+			if (check(s, fagpio_swd_transfer(s, FAGPIO_SWD_AP | FAGPIO_SWD_READ | AP_DRW, i ? &buf[i - 1] : NULL)) < 0)
+				return -1;
+		}
+		if (fagpio_swd_dp_read(s, DP_RDBUFF, &buf[n - 1]) < 0)
+			return -1;
+		addr += n * 4;
+		buf += n;
+		count -= n;
+	}
+	return 0;
+}
+
+// RDBUFF at the end stalls until the last posted write has completed and reports its fault
+int fagpio_swd_mem_write(struct fagpio_swd *s, uint32_t addr, const uint32_t *buf, size_t count) {
+	uint32_t dummy;
+
+	if (addr & 3)
+		return -1;
+	if (count && fagpio_swd_ap_write(s, AP_CSW, CSW_WORD_INC) < 0)
+		return -1;
+	while (count) {
+		size_t n = tar_run(addr, count);
+
+		if (fagpio_swd_ap_write(s, AP_TAR, addr) < 0)
+			return -1;
+		for (size_t i = 0; i < n; i++) {
+			uint32_t w = buf[i];
+
+			if (check(s, fagpio_swd_transfer(s, FAGPIO_SWD_AP | AP_DRW, &w)) < 0)
+				return -1;
+		}
+		addr += n * 4;
+		buf += n;
+		count -= n;
+	}
+	return fagpio_swd_dp_read(s, DP_RDBUFF, &dummy);
+}
+
+int fagpio_swd_halt(struct fagpio_swd *s) {
+	uint32_t halt = DHCSR_HALT, dhcsr = 0, limit = fagpio_tick_hz / 1000 * SWD_TIMEOUT_MS, start;
+
+	if (fagpio_swd_mem_write(s, DHCSR, &halt, 1) < 0)
+		return -1;
+	start = fagpio_ticks();
+	do {
+		if (fagpio_swd_mem_read(s, DHCSR, &dhcsr, 1) < 0)
+			return -1;
+	} while (!(dhcsr & DHCSR_S_HALT) && fagpio_ticks() - start < limit);
+	return (dhcsr & DHCSR_S_HALT) ? 0 : -1;
+}
@@ -0,0 +1,89 @@
+#ifndef _FAGPIO_SWD_H
+#define _FAGPIO_SWD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Bit-banged Serial Wire Debug host for flashing and debugging attached
+ * Cortex-M parts (ADIv5 DP and MEM-AP). SWCLK and SWDIO must share a
+ * port: every bit is two stores of a DAT word built once per transaction,
+ * and the packet, ACK, data and parity phases are each one packed shift
+ * of up to 32 bits, so a DAP transaction is a handful of loops with no
+ * per-bit calls. SWDIO turns around through its CFG nibble directly.
+ *
+ * WAIT answers are retried in place; a FAULT clears the sticky errors
+ * through ABORT. Memory is accessed in words with auto-increment, TAR
+ * written again at every 1 KB boundary, and AP reads are pipelined: a
+ * block of n words costs n + 2 transactions.
+ *
+ * For JTAG, or for OpenOCD's flash drivers over SWD, tools/remote_bitbang
+ * serves these pins to OpenOCD over TCP.
+ */
+
+// fagpio_swd_transfer() request bits; A[3:2] of the register address go in as they are
+#define FAGPIO_SWD_AP			(1u << 0)	//Access port, else debug port
+#define FAGPIO_SWD_READ			(1u << 1)
+
+// ACKs, plus what the host detects
+#define FAGPIO_SWD_OK			1
+#define FAGPIO_SWD_WAIT			2
+#define FAGPIO_SWD_FAULT		4
+#define FAGPIO_SWD_NO_ACK		7			//Nothing drove SWDIO
+#define FAGPIO_SWD_PARITY		8			//Read data failed its parity
+
+#ifndef FAGPIO_SWD_RETRIES
+#define FAGPIO_SWD_RETRIES		100			//WAIT answers before giving up
+#endif
+
+struct fagpio_swd {
+	uint8_t port;			//Port of SWCLK and SWDIO
+	uint8_t dio_bit;
+	uint8_t dio_shift;		//CFG nibble of SWDIO
+	uint8_t ap;				//APSEL of the AP and MEM-AP calls
+	uint32_t clk, dio;		//Pin masks
+	volatile uint32_t *dat;
+	volatile uint32_t *dio_cfg;
+	uint32_t half_ticks;	//Counter ticks per half clock, 0 for full speed
+	uint32_t half_ns;
+	uint32_t costs_gen;		//fagpio_costs_gen half_ticks was computed at
+	uint32_t retries;		//FAGPIO_SWD_RETRIES after init
+	uint32_t idle;			//Idle cycles after each transaction, 0 after init
+	uint32_t select;		//DP SELECT last written, ~0 if unknown
+	uint32_t idcode;		//DP IDCODE read by fagpio_swd_connect()
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// hz 0 runs as fast as the stores go; SWDIO gets the internal pull-up
+int fagpio_swd_init(struct fagpio_swd *s, uint8_t swclk, uint8_t swdio, uint32_t hz);
+
+/*
+ * Line reset, the JTAG-to-SWD switch sequence and another line reset,
+ * then reads IDCODE, clears the sticky errors and powers the debug and
+ * system domains up. 0 once both power-up requests are acknowledged.
+ */
+int fagpio_swd_connect(struct fagpio_swd *s);
+
+// One transaction; data is read into (may be NULL) or written from. Returns the ACK
+int fagpio_swd_transfer(struct fagpio_swd *s, uint8_t req, uint32_t *data);
+
+// Registers by address: DP 0x0-0xC; AP 0x00-0xFC of AP s->ap, SELECT written only when it changes
+int fagpio_swd_dp_read(struct fagpio_swd *s, uint8_t addr, uint32_t *value);
+int fagpio_swd_dp_write(struct fagpio_swd *s, uint8_t addr, uint32_t value);
+int fagpio_swd_ap_read(struct fagpio_swd *s, uint8_t addr, uint32_t *value);
+int fagpio_swd_ap_write(struct fagpio_swd *s, uint8_t addr, uint32_t value);
+
+// Words through the MEM-AP; addr must be word aligned
+int fagpio_swd_mem_read(struct fagpio_swd *s, uint32_t addr, uint32_t *buf, size_t count);
+int fagpio_swd_mem_write(struct fagpio_swd *s, uint32_t addr, const uint32_t *buf, size_t count);
+
+int fagpio_swd_halt(struct fagpio_swd *s);		//Halts the core through DHCSR, 0 once it reports halted
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
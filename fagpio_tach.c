@@ -0,0 +1,112 @@
+#include <string.h>
+#include "fagpio_tach.h"
+#include "fagpio_atomic.h"
+#include "fagpio_timer.h"
+
+void fagpio_tach_init(struct fagpio_tach_set *set, uint8_t port) {
+	memset(set, 0, sizeof(*set));
+	set->port = port;
+}
+
+int fagpio_tach_add(struct fagpio_tach_set *set, uint8_t pin) {
+	unsigned int i = set->count;
+	uint8_t n = PIO_PIN_NUM(pin);
+
+	if (i == FAGPIO_TACH_MAX || PIO_PIN_PORT(pin) != set->port || set->port >= PIO_NPORTS || (set->mask & (1u << n)))
+		return -1;
+
+	pinMode(pin, INPUT);
+	pinPull(pin, PULL_UP);		//Tach outputs are open collector
+	set->bit[i] = n;
+	set->index[n] = i;
+	set->dat = (set->dat & ~(1u << n)) | (digitalReadPort(set->port) & (1u << n));
+	set->mask |= 1u << n;
+	set->count = i + 1;
+	return i;
+}
+
+void fagpio_tach_count(struct fagpio_tach_set *set, uint32_t fell, uint32_t ticks) {
+	fell &= set->mask;
+	if (!fell)
+		return;
+	set->seq++;
+	fagpio_barrier();
+	while (fell) {
+		unsigned int i = set->index[__builtin_ctz(fell)];
+
+		fell &= fell - 1;
+		if (set->edges[i])
+			set->period[i] = ticks - set->last[i];
+		set->last[i] = ticks;
+		set->edges[i]++;
+	}
+	fagpio_barrier();
+	set->seq++;
+}
+
+void fagpio_tach_poll(struct fagpio_tach_set *set) {
+	uint32_t dat = digitalReadPort(set->port);
+	uint32_t fell = set->dat & ~dat;
+
+	set->dat = dat;
+	if (fell & set->mask)
+		fagpio_tach_count(set, fell, fagpio_ticks());
+}
+
+// One fan's counting fields, consistent with each other
+static void tach_read(const struct fagpio_tach_set *set, unsigned int i, uint32_t *edges, uint32_t *last, uint32_t *period) {
+	uint32_t seq;
+
+	do {
+		while ((seq = set->seq) & 1)
+			;
+		fagpio_barrier();
+		*edges = set->edges[i];
+		*last = set->last[i];
+		*period = set->period[i];
+		fagpio_barrier();
+	} while (seq != set->seq);
+}
+
+uint32_t fagpio_tach_edges(const struct fagpio_tach_set *set, unsigned int i) {
+	return i < set->count ? set->edges[i] : 0;
+}
+
+uint32_t fagpio_tach_period_ns(const struct fagpio_tach_set *set, unsigned int i) {
+	uint32_t edges, last, period;
+
+	if (i >= set->count)
+		return 0;
+	tach_read(set, i, &edges, &last, &period);
+	return fagpio_ticks_to_ns(period);
+}
+
+/*
+The average over every edge since the previous call is what a fan's
+uneven magnet spacing wants; it needs a reference edge, so the first
+call after fagpio_tach_add() falls back on the last interval.
+*/
+uint32_t fagpio_tach_rpm(struct fagpio_tach_set *set, unsigned int i, unsigned int pulses_per_rev) {
+	uint32_t edges, last, period, n, dt;
+
+	if (i >= set->count || !pulses_per_rev)
+		return 0;
+	tach_read(set, i, &edges, &last, &period);
+	n = edges - set->q_edges[i];
+	if (!n) {
+		if (!edges || fagpio_ticks() - last > (uint64_t)fagpio_tick_hz * FAGPIO_TACH_STALL_MS / 1000)
+			set->q_rpm[i] = 0;
+		return set->q_rpm[i];
+	}
+	if (set->q_edges[i]) {
+		dt = last - set->q_last[i];
+	} else {
+		dt = period;
+		n = 1;
+	}
+	set->q_edges[i] = edges;
+	set->q_last[i] = last;
+	if (dt)
+		set->q_rpm[i] = (uint32_t)((uint64_t)fagpio_tick_hz * 60 * n / ((uint64_t)dt * pulses_per_rev));
+	return set->q_rpm[i];
+}
@@ -0,0 +1,61 @@
+#ifndef _FAGPIO_TACH_H
+#define _FAGPIO_TACH_H
+
+#include <stdint.h>
+#include "fagpio.h"
+
+/*
+ * Fan tachometers on one port. fagpio_tach_poll() takes a single
+ * digitalReadPort() snapshot and counts the falling edges of every fan
+ * in it, storing the edge's AVS counter value (fagpio_timer.h) and the
+ * interval since the previous edge; a poll without edges is one read and
+ * a compare. With the pins on EINT instead (fagpio_eint.h, FALLING), pass
+ * what fagpio_eint_wait() returned to fagpio_tach_count().
+ *
+ * The counting side only stores counts and ticks, under a sequence
+ * counter so another thread reads them whole. fagpio_tach_rpm() does the
+ * division when asked: edges since its previous call over the time they
+ * took, or the last interval on the first call. A fan without an
+ * edge for FAGPIO_TACH_STALL_MS reads 0.
+ */
+
+#define FAGPIO_TACH_MAX		16
+
+#ifndef FAGPIO_TACH_STALL_MS
+#define FAGPIO_TACH_STALL_MS	1000
+#endif
+
+struct fagpio_tach_set {
+	uint8_t port;
+	uint8_t count;
+	uint8_t bit[FAGPIO_TACH_MAX];		//Bit numbers in the port
+	uint8_t index[32];					//Fan of each bit
+	uint32_t mask;
+	uint32_t dat;						//Previous snapshot
+	volatile uint32_t seq;				//Odd while the fields below change
+	volatile uint32_t edges[FAGPIO_TACH_MAX];
+	volatile uint32_t last[FAGPIO_TACH_MAX];		//Ticks at the last edge
+	volatile uint32_t period[FAGPIO_TACH_MAX];		//Ticks between the last two, 0 before
+	uint32_t q_edges[FAGPIO_TACH_MAX];	//fagpio_tach_rpm() state, reader side
+	uint32_t q_last[FAGPIO_TACH_MAX];
+	uint32_t q_rpm[FAGPIO_TACH_MAX];
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void fagpio_tach_init(struct fagpio_tach_set *set, uint8_t port);
+int fagpio_tach_add(struct fagpio_tach_set *set, uint8_t pin);		//Fan index, -1 on error
+void fagpio_tach_poll(struct fagpio_tach_set *set);
+void fagpio_tach_count(struct fagpio_tach_set *set, uint32_t fell, uint32_t ticks);	//Bits that fell at ticks
+
+uint32_t fagpio_tach_edges(const struct fagpio_tach_set *set, unsigned int i);
+uint32_t fagpio_tach_period_ns(const struct fagpio_tach_set *set, unsigned int i);	//Last interval, 0 before two edges
+uint32_t fagpio_tach_rpm(struct fagpio_tach_set *set, unsigned int i, unsigned int pulses_per_rev);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,198 @@
+#include <string.h>
+#include <time.h>
+#include "fagpio_task.h"
+
+#define SLOT_MASK		(FAGPIO_SCHED_SLOTS - 1)
+
+static inline uint32_t span(const struct fagpio_sched *s) {
+	return (uint32_t)FAGPIO_SCHED_SLOTS << s->shift;
+}
+
+static inline int before(uint32_t a, uint32_t b) {
+	return (int32_t)(a - b) < 0;
+}
+
+void fagpio_sched_init(struct fagpio_sched *s, unsigned int shift) {
+	memset(s, 0, sizeof(*s));
+	s->shift = shift ? shift : FAGPIO_SCHED_SHIFT;
+	s->base = fagpio_ticks() & ~((1u << s->shift) - 1);
+	s->cursor = (s->base >> s->shift) & SLOT_MASK;
+}
+
+/*
+Late tasks go into the cursor slot, which is processed next; deadlines
+inside the current turn of the wheel into their own slot; the rest on far.
+*/
+static void insert(struct fagpio_sched *s, struct fagpio_task *t) {
+	unsigned int slot;
+
+	if (before(t->deadline, s->base)) {
+		slot = s->cursor;
+	} else if (t->deadline - s->base < span(s)) {
+		slot = (t->deadline >> s->shift) & SLOT_MASK;
+	} else {
+		if (!s->far || before(t->deadline, s->far_min))
+			s->far_min = t->deadline;
+		t->next = s->far;
+		s->far = t;
+		return;
+	}
+	t->next = s->slots[slot];
+	s->slots[slot] = t;
+	s->busy[slot >> 5] |= 1u << (slot & 31);
+}
+
+void fagpio_task_start(struct fagpio_sched *s, struct fagpio_task *t, fagpio_task_fn fn, void *arg, uint32_t delay_ticks) {
+	t->fn = fn;
+	t->arg = arg;
+	t->lc = 0;
+	t->deadline = fagpio_ticks() + delay_ticks;
+	insert(s, t);
+	s->ntasks++;
+}
+
+static int unlink_from(struct fagpio_task **list, struct fagpio_task *t) {
+	for (; *list; list = &(*list)->next) {
+		if (*list == t) {
+			*list = t->next;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+int fagpio_task_cancel(struct fagpio_sched *s, struct fagpio_task *t) {
+	for (unsigned int i = 0; i < FAGPIO_SCHED_SLOTS; i++) {
+		if (s->slots[i] && unlink_from(&s->slots[i], t) == 0) {
+			if (!s->slots[i])
+				s->busy[i >> 5] &= ~(1u << (i & 31));
+			s->ntasks--;
+			return 0;
+		}
+	}
+	if (unlink_from(&s->far, t) == 0) {
+		s->ntasks--;
+		return 0;		//far_min may now be early, which only costs a spare migration pass
+	}
+	return -1;
+}
+
+// Slots from the cursor to the next busy one, FAGPIO_SCHED_SLOTS if the wheel is empty
+static unsigned int next_busy(const struct fagpio_sched *s) {
+	unsigned int c = s->cursor;
+
+	for (unsigned int n = 0; n < FAGPIO_SCHED_SLOTS; ) {
+		unsigned int i = (c + n) & SLOT_MASK;
+		uint32_t word = s->busy[i >> 5] >> (i & 31);
+
+		if (word)
+			return n + __builtin_ctz(word);
+		n += 32 - (i & 31);
+	}
+	return FAGPIO_SCHED_SLOTS;
+}
+
+static void advance(struct fagpio_sched *s, unsigned int slots) {
+	s->cursor = (s->cursor + slots) & SLOT_MASK;
+	s->base += slots << s->shift;
+}
+
+// Moves far tasks that now fall inside the wheel's turn into their slots
+static void migrate(struct fagpio_sched *s) {
+	struct fagpio_task *list = s->far;
+
+	if (!list || !before(s->far_min, s->base + span(s)))
+		return;
+	s->far = NULL;
+	while (list) {
+		struct fagpio_task *t = list;
+
+		list = t->next;
+		insert(s, t);
+	}
+}
+
+// Runs the due tasks of the cursor slot; the others stay for a later pass
+static void run_slot(struct fagpio_sched *s, uint32_t now) {
+	unsigned int slot = s->cursor;
+	struct fagpio_task *list = s->slots[slot];
+
+	s->slots[slot] = NULL;
+	s->busy[slot >> 5] &= ~(1u << (slot & 31));
+	while (list) {
+		struct fagpio_task *t = list;
+
+		list = t->next;
+		if (before(now, t->deadline)) {
+			insert(s, t);
+		} else if (t->fn(t) == FAGPIO_TASK_DONE) {
+			s->ntasks--;
+		} else {
+			insert(s, t);
+		}
+	}
+}
+
+unsigned int fagpio_sched_step(struct fagpio_sched *s, uint32_t *next) {
+	uint32_t now = fagpio_ticks();
+
+	for (;;) {
+		unsigned int d;
+
+		migrate(s);
+		d = next_busy(s);
+		if (d == FAGPIO_SCHED_SLOTS || before(now, s->base + (d << s->shift))) {
+			// Nothing due: bring the cursor up to now, or to the next busy slot
+			uint32_t behind = (now - s->base) >> s->shift;
+
+			if (before(now, s->base))
+				behind = 0;
+			advance(s, behind < d ? behind : d);
+			break;
+		}
+		advance(s, d);
+		run_slot(s, now);
+		if (s->slots[s->cursor])
+			break;		//Late or not yet due: the cursor stays until they have run
+		advance(s, 1);
+	}
+
+	if (next) {
+		unsigned int d = next_busy(s);
+		uint32_t wake = s->base + (d << s->shift);
+
+		if (d == FAGPIO_SCHED_SLOTS)
+			wake = s->base + span(s);
+		if (s->far && before(s->far_min, wake))
+			wake = s->far_min;
+		*next = wake;
+	}
+	return s->ntasks;
+}
+
+void fagpio_sched_run(struct fagpio_sched *s) {
+	uint32_t sleep_ticks = fagpio_ns_to_ticks(FAGPIO_SCHED_SLEEP_US * 1000);
+
+	s->stop = 0;
+	while (!s->stop) {
+		uint32_t next, now;
+
+		if (!fagpio_sched_step(s, &next))
+			break;
+		now = fagpio_ticks();
+		if (!before(now, next))
+			continue;
+		if (next - now > sleep_ticks) {
+			uint32_t ns = fagpio_ticks_to_ns(next - now - sleep_ticks / 2);
+			struct timespec ts = { ns / 1000000000u, ns % 1000000000u };
+
+			nanosleep(&ts, NULL);
+		}
+		while (before(fagpio_ticks(), next))
+			;
+	}
+}
+
+void fagpio_sched_stop(struct fagpio_sched *s) {
+	s->stop = 1;
+}
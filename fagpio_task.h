@@ -0,0 +1,108 @@
+#ifndef _FAGPIO_TASK_H
+#define _FAGPIO_TASK_H
+
+#include <stdint.h>
+#include "fagpio_timer.h"
+
+/*
+ * Cooperative scheduler for many slow timed jobs on one thread. Tasks are
+ * stackless (protothread style): the task function is re-entered from the
+ * top and FAGPIO_TASK_BEGIN() jumps back to the line of the last
+ * FAGPIO_TASK_DELAY(), so locals do not survive a delay; keep state in
+ * the task's arg.
+ *
+ * Deadlines are absolute AVS counter ticks. Tasks due within one turn of
+ * the timing wheel sit in the slot of their deadline, those further out
+ * on a list that is moved into the wheel as it turns. A bitmap of busy
+ * slots gives the next deadline without visiting empty ones, and
+ * fagpio_sched_run() sleeps until shortly before it, then spins.
+ *
+ *	static int blink(struct fagpio_task *t) {
+ *		FAGPIO_TASK_BEGIN(t);
+ *		for (;;) {
+ *			digitalToggle((uintptr_t)t->arg);
+ *			FAGPIO_TASK_DELAY(t, half_period_ticks);
+ *		}
+ *		FAGPIO_TASK_END(t);
+ *	}
+ */
+
+#define FAGPIO_SCHED_SLOTS		256				//Power of two
+#define FAGPIO_SCHED_SHIFT		5				//Default slot width, 2^5 ticks (1.3 us at 24 MHz)
+#define FAGPIO_SCHED_SLEEP_US	200				//Sleep instead of spinning when the next deadline is further
+
+#define FAGPIO_TASK_WAITING		0
+#define FAGPIO_TASK_DONE		1
+
+struct fagpio_task;
+typedef int (*fagpio_task_fn)(struct fagpio_task *t);
+
+struct fagpio_task {
+	struct fagpio_task *next;
+	uint32_t deadline;		//Counter ticks
+	uint32_t lc;			//Resume point, 0 at the start
+	fagpio_task_fn fn;
+	void *arg;
+};
+
+struct fagpio_sched {
+	struct fagpio_task *slots[FAGPIO_SCHED_SLOTS];
+	uint32_t busy[FAGPIO_SCHED_SLOTS / 32];
+	struct fagpio_task *far;	//Beyond the wheel, unsorted
+	uint32_t far_min;			//Earliest deadline on far
+	uint32_t base;				//Start of the cursor slot
+	unsigned int shift;
+	unsigned int cursor;
+	unsigned int ntasks;
+	volatile int stop;
+};
+
+// A delay advances the previous deadline, so periodic tasks do not drift
+#define FAGPIO_TASK_BEGIN(t)		switch ((t)->lc) { case 0:
+#define FAGPIO_TASK_DELAY(t, ticks)	do { \
+		(t)->deadline += (ticks); \
+		(t)->lc = __LINE__; \
+		return FAGPIO_TASK_WAITING; \
+		case __LINE__:; \
+	} while (0)
+// Restarts the timebase at the current time, after other due tasks had their turn
+#define FAGPIO_TASK_YIELD(t)		do { \
+		(t)->deadline = fagpio_ticks(); \
+		(t)->lc = __LINE__; \
+		return FAGPIO_TASK_WAITING; \
+		case __LINE__:; \
+	} while (0)
+#define FAGPIO_TASK_WAIT_UNTIL(t, cond, poll_ticks)	do { \
+		(t)->deadline = fagpio_ticks(); \
+		(t)->lc = __LINE__; \
+		case __LINE__: \
+		if (!(cond)) { \
+			(t)->deadline += (poll_ticks); \
+			return FAGPIO_TASK_WAITING; \
+		} \
+	} while (0)
+#define FAGPIO_TASK_END(t)			} (t)->lc = 0; return FAGPIO_TASK_DONE
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// shift is the log2 slot width in ticks, 0 for FAGPIO_SCHED_SHIFT
+void fagpio_sched_init(struct fagpio_sched *s, unsigned int shift);
+
+// First run delay_ticks from now; t stays owned by the scheduler until its function returns DONE
+void fagpio_task_start(struct fagpio_sched *s, struct fagpio_task *t, fagpio_task_fn fn, void *arg, uint32_t delay_ticks);
+int fagpio_task_cancel(struct fagpio_sched *s, struct fagpio_task *t);		//-1 if not scheduled
+
+// Runs every due task once; returns the tasks left and sets *next to the next deadline
+unsigned int fagpio_sched_step(struct fagpio_sched *s, uint32_t *next);
+
+// Steps and waits until fagpio_sched_stop() or no task is left
+void fagpio_sched_run(struct fagpio_sched *s);
+void fagpio_sched_stop(struct fagpio_sched *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,152 @@
+#include "fagpio_priv.h"
+#include "fagpio_timer.h"
+#include "fagpio_region.h"
+#include "fagpio_log.h"
+
+#define CALIBRATE_NS		2000000		//Length of the calibration window
+#define COST_ACCESSES		1024		//Per measurement, 8 per loop iteration
+#define COST_RUNS			3			//The fastest run counts, the others may have been preempted
+
+volatile uint32_t *fagpio_counter;
+uint32_t fagpio_tick_hz = 1000000000;
+struct fagpio_costs fagpio_costs;
+volatile uint32_t fagpio_costs_gen;
+volatile uint8_t fagpio_costs_stale;
+
+static uint64_t ns_to_ticks_mult = 1ull << 32;		//32.32 fixed point ticks per ns
+static uint64_t ticks_to_ns_mult = 1ull << 32;		//32.32 fixed point ns per tick
+
+static uint64_t monotonic_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+uint32_t fagpio_ticks_slow(void) {
+	return (uint32_t)monotonic_ns();
+}
+
+static void timer_set_rate(uint32_t hz) {
+	fagpio_tick_hz = hz;
+	ns_to_ticks_mult = ((uint64_t)hz << 32) / 1000000000;
+	ticks_to_ns_mult = (1000000000ull << 32) / hz;
+}
+
+int fagpio_timer_init(void) {
+	volatile uint32_t *timer = fagpio_region(FAGPIO_REGION_TIMER);
+	volatile uint32_t *ccu = fagpio_region(FAGPIO_REGION_CCU);
+
+	fagpio_counter = NULL;
+	timer_set_rate(1000000000);
+	if (!timer || !ccu)
+		return -1;
+
+	volatile uint32_t *ctl = timer + rAVS_CNT_CTL / 4;
+	volatile uint32_t *cnt = timer + rAVS_CNT0 / 4;
+	volatile uint32_t *div = timer + rAVS_CNT_DIV / 4;
+
+	ccu[rCCU_AVS_CLK / 4] |= 1u << 31;
+	*div &= ~0xFFFu;				//Counter 0 at the full AVS clock
+	*ctl |= 1u << 0;				//Enable counter 0
+
+	uint64_t t0 = monotonic_ns(), t1;
+	uint32_t c0 = *cnt;
+
+	while ((t1 = monotonic_ns()) - t0 < CALIBRATE_NS)
+		;
+
+	uint32_t ticks = *cnt - c0;
+
+	if (!ticks) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "AVS counter is not running, delays use CLOCK_MONOTONIC\n");
+		return -1;
+	}
+
+	timer_set_rate((uint32_t)((uint64_t)ticks * 1000000000 / (t1 - t0)));
+	fagpio_counter = cnt;
+	FAGPIO_LOG(FAGPIO_LOG_INFO, "AVS counter at %u Hz\n", fagpio_tick_hz);
+	return 0;
+}
+
+uint32_t fagpio_ns_to_ticks(uint32_t ns) {
+	return (uint32_t)((ns * ns_to_ticks_mult) >> 32);
+}
+
+// Integer and fraction parts multiplied separately, ticks * mult would overflow
+uint32_t fagpio_ticks_to_ns(uint32_t ticks) {
+	uint64_t ns = (uint64_t)ticks * (uint32_t)(ticks_to_ns_mult >> 32);
+
+	ns += ((uint64_t)ticks * (uint32_t)ticks_to_ns_mult) >> 32;
+	return (uint32_t)ns;
+}
+
+void fagpio_delay_cycles(uint32_t ticks) {
+	uint32_t start = fagpio_ticks();
+
+	while (fagpio_ticks() - start < ticks)
+		;
+}
+
+void fagpio_delay_ns(uint32_t ns) {
+	fagpio_delay_cycles(fagpio_ns_to_ticks(ns));
+}
+
+#define X8(op)	op; op; op; op; op; op; op; op
+
+// Fastest of COST_RUNS runs of COST_ACCESSES accesses, in ns per access
+static uint32_t cost_run(volatile uint32_t *dat, int kind) {
+	uint32_t best = ~0u, v = 0;
+
+	for (int run = 0; run < COST_RUNS; run++) {
+		uint32_t start = fagpio_ticks();
+
+		for (int i = 0; i < COST_ACCESSES / 8; i++) {
+			if (kind == 0) {
+				X8(v = *dat);
+			} else if (kind == 1) {
+				X8(*dat = v);
+			} else {
+				X8(*dat = *dat | 0);
+			}
+		}
+
+		uint32_t ticks = fagpio_ticks() - start;
+
+		if (ticks < best)
+			best = ticks;
+	}
+	return fagpio_ticks_to_ns(best) / COST_ACCESSES;
+}
+
+int fagpio_costs_measure(void) {
+	struct pio_bank *banks = fagpio_banks();
+
+	fagpio_costs_stale = 0;
+	if (!banks || !fagpio_counter)
+		return -1;
+
+	/*
+	Reads time PA DAT. Stores go to the DAT slot of bank PIO_NPORTS, a
+	port no supported SoC has: the same PIO block and bus, but nothing
+	behind it, so a pin another thread or process drives meanwhile is not
+	overwritten and the DAT shadows stay right. This also runs at runtime
+	from fagpio_costs_update().
+	*/
+	volatile uint32_t *dat = &banks[PIO_PORT_A].dat;
+	volatile uint32_t *spare = &banks[PIO_NPORTS].dat;
+
+	fagpio_costs.read_ns = cost_run(dat, 0);
+	fagpio_costs.write_ns = cost_run(spare, 1);
+	fagpio_costs.rmw_ns = cost_run(spare, 2);
+	fagpio_costs_gen++;
+	FAGPIO_LOG(FAGPIO_LOG_INFO, "PIO access: read %u ns, write %u ns, read-modify-write %u ns\n",
+		fagpio_costs.read_ns, fagpio_costs.write_ns, fagpio_costs.rmw_ns);
+	return 0;
+}
+
+uint32_t fagpio_pad_ticks(uint32_t ns, uint32_t reads, uint32_t writes) {
+	uint64_t cost = (uint64_t)reads * fagpio_costs.read_ns + (uint64_t)writes * fagpio_costs.write_ns;
+
+	return cost < ns ? fagpio_ns_to_ticks(ns - (uint32_t)cost) : 0;
+}
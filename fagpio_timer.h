@@ -0,0 +1,82 @@
+#ifndef _FAGPIO_TIMER_H
+#define _FAGPIO_TIMER_H
+
+#include <stdint.h>
+
+/*
+ * Free-running hardware counter and busy-wait delays. The AVS counter 0 of
+ * the timer block (0x01C20C00, inside the window mapped by fagpio_setup())
+ * is started and calibrated against CLOCK_MONOTONIC during setup, so a
+ * delay is spinning on one uncached register read with no syscall.
+ * Without a mapping (gpiochip backend) the counter falls back to
+ * CLOCK_MONOTONIC nanoseconds.
+ */
+
+#define rAVS_CNT_CTL		0x80	//Timer block offsets
+#define rAVS_CNT0			0x84
+#define rAVS_CNT1			0x88
+#define rAVS_CNT_DIV		0x8C
+#define rCCU_AVS_CLK		0x144	//CCU offset, bit 31 gates the 24 MHz AVS clock
+
+/*
+ * Measured cost of one uncached PIO access, the DAT register of port A
+ * read or stored back 1024 times. It follows the APB clock, so
+ * fagpio_setup() measures it after the counter and the CCU setters
+ * (fagpio_ccu.h) measure it again. Bit-bang drivers take it off their
+ * delays with fagpio_pad_ticks(), so a bus runs at the requested rate or,
+ * when the accesses alone are slower, as fast as the hardware allows.
+ *
+ * Every measurement bumps fagpio_costs_gen. The drivers keep the gen
+ * their delays were computed at and recompute them at the next transfer
+ * when it moved, through fagpio_costs_update(), which first re-measures
+ * costs that a clock change marked stale (fagpio_cpufreq.h); marking them
+ * stale bumps the gen too, so a transfer only compares the gen. The delays
+ * themselves count AVS ticks, whose 24 MHz does not follow the CPU clock.
+ */
+struct fagpio_costs {
+	uint32_t read_ns;
+	uint32_t write_ns;
+	uint32_t rmw_ns;			//Read, modify and store, like digitalWriteFast()
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern volatile uint32_t *fagpio_counter;		//AVS_CNT0, NULL when not mapped
+extern uint32_t fagpio_tick_hz;					//Counter rate measured at setup
+
+int fagpio_timer_init(void);					//Called by fagpio_setup()
+uint32_t fagpio_ticks_slow(void);
+
+static inline uint32_t fagpio_ticks(void) {
+	return fagpio_counter ? *fagpio_counter : fagpio_ticks_slow();
+}
+
+uint32_t fagpio_ns_to_ticks(uint32_t ns);
+uint32_t fagpio_ticks_to_ns(uint32_t ticks);
+
+void fagpio_delay_cycles(uint32_t ticks);		//Spins for a number of counter ticks
+void fagpio_delay_ns(uint32_t ns);
+
+extern struct fagpio_costs fagpio_costs;
+extern volatile uint32_t fagpio_costs_gen;
+extern volatile uint8_t fagpio_costs_stale;		//Set when a clock changed, cleared by fagpio_costs_measure()
+int fagpio_costs_measure(void);
+
+// Non-zero if the costs changed since *gen, which is brought up to date
+static inline int fagpio_costs_update(uint32_t *gen) {
+	if (fagpio_costs_stale)
+		fagpio_costs_measure();
+	if (*gen == fagpio_costs_gen)
+		return 0;
+	*gen = fagpio_costs_gen;
+	return 1;
+}
+uint32_t fagpio_pad_ticks(uint32_t ns, uint32_t reads, uint32_t writes);	//Ticks of ns left after the accesses, 0 if none
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
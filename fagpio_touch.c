@@ -0,0 +1,94 @@
+#include <string.h>
+#include "fagpio_priv.h"
+#include "fagpio_touch.h"
+#include "fagpio_timer.h"
+
+#define TIMEOUT_CHECK		8		//DAT polls between counter reads when nothing rose
+
+int fagpio_touch_init(struct fagpio_touch *t, uint8_t port, uint32_t mask, uint8_t samples, uint32_t threshold_pct, unsigned int flags) {
+	if (port >= PIO_NPORTS || !mask || !samples || !threshold_pct || !fagpio_banks())
+		return -1;
+
+	memset(t, 0, sizeof(*t));
+	t->port = port;
+	t->mask = mask;
+	t->samples = samples;
+	t->threshold = threshold_pct * 256 / 100;
+	t->timeout = fagpio_ns_to_ticks(FAGPIO_TOUCH_TIMEOUT_NS);
+
+	digitalWritePort(port, mask, 0);
+	pinPullMask(port, mask, (flags & FAGPIO_TOUCH_EXTERNAL) ? PULL_NONE : PULL_UP);
+	pinModeMask(port, mask, INPUT);
+	return 0;
+}
+
+// One charge pass: adds each pin's ticks to raw, returns the pins still low at the timeout
+FAGPIO_ARM_CODE static uint32_t charge_pass(struct fagpio_touch *t) {
+	volatile uint32_t *dat = &fagpio_banks()[t->port].dat;
+	uint32_t pending = t->mask, start;
+
+	pinModeMask(t->port, t->mask, OUTPUT);		//DAT holds 0: discharge
+	fagpio_delay_ns(FAGPIO_TOUCH_DISCHARGE_NS);
+	start = fagpio_ticks();
+	pinModeMask(t->port, t->mask, INPUT);
+
+	while (pending) {
+		uint32_t rose = 0;
+
+		for (unsigned int i = 0; i < TIMEOUT_CHECK && !rose; i++)
+			rose = *dat & pending;
+
+		uint32_t now = fagpio_ticks() - start;
+
+		for (pending &= ~rose; rose; rose &= rose - 1)
+			t->raw[__builtin_ctz(rose)] += now;
+		if (now >= t->timeout)
+			break;
+	}
+	return pending;
+}
+
+uint32_t fagpio_touch_measure(struct fagpio_touch *t) {
+	uint32_t stuck = 0;
+
+	for (uint32_t m = t->mask; m; m &= m - 1)
+		t->raw[__builtin_ctz(m)] = 0;
+	for (unsigned int s = 0; s < t->samples; s++)
+		stuck |= charge_pass(t);
+	return stuck;
+}
+
+int fagpio_touch_calibrate(struct fagpio_touch *t, unsigned int rounds) {
+	uint64_t sum[32] = { 0 };
+
+	if (!rounds)
+		return -1;
+	for (unsigned int r = 0; r < rounds; r++) {
+		if (fagpio_touch_measure(t))
+			return -1;
+		for (uint32_t m = t->mask; m; m &= m - 1)
+			sum[__builtin_ctz(m)] += t->raw[__builtin_ctz(m)];
+	}
+	for (uint32_t m = t->mask; m; m &= m - 1)
+		t->baseline[__builtin_ctz(m)] = sum[__builtin_ctz(m)] / rounds;
+	t->touched = 0;
+	return 0;
+}
+
+uint32_t fagpio_touch_read(struct fagpio_touch *t, uint32_t *changed) {
+	uint32_t stuck = fagpio_touch_measure(t), now = 0;
+
+	for (uint32_t m = t->mask & ~stuck; m; m &= m - 1) {
+		unsigned int n = __builtin_ctz(m);
+		uint32_t base = t->baseline[n], raw = t->raw[n];
+
+		if (raw > base + (uint32_t)((uint64_t)base * t->threshold >> 8))
+			now |= 1u << n;
+		else
+			t->baseline[n] = base + ((int32_t)(raw - base) >> FAGPIO_TOUCH_DRIFT_SHIFT);
+	}
+	if (changed)
+		*changed = now ^ t->touched;
+	t->touched = now;
+	return now;
+}
@@ -0,0 +1,57 @@
+#ifndef _FAGPIO_TOUCH_H
+#define _FAGPIO_TOUCH_H
+
+#include <stdint.h>
+
+/*
+ * Capacitive touch on up to 32 electrodes of one port, measured together
+ * by charge time. A pass drives every sense pin low with one port write,
+ * switches them all to input with pinModeMask() so they charge through
+ * their pull-ups (the PIO's own, or external resistors of a few hundred
+ * kilohms for more sensitivity), and polls DAT, stamping each pin with the
+ * counter when its bit reads high. A finger adds capacitance and lengthens
+ * the time.
+ *
+ * One pass costs one DAT load per poll however many keys there are; its
+ * resolution is the poll period, a few counter ticks, so samples passes
+ * are summed. The baseline follows slow drift on untouched keys.
+ */
+
+#define FAGPIO_TOUCH_EXTERNAL		0x01	//External pull-ups: leave the PIO pulls off
+
+#define FAGPIO_TOUCH_DISCHARGE_NS	2000
+#define FAGPIO_TOUCH_TIMEOUT_NS		200000	//Per pass; a pin not high by then is reported stuck
+#define FAGPIO_TOUCH_DRIFT_SHIFT	4		//Baseline moves 1/16 of the way per untouched read
+
+struct fagpio_touch {
+	uint8_t port;
+	uint8_t samples;			//Passes summed per measurement
+	uint32_t mask;				//Sense pins
+	uint32_t timeout;			//Ticks per pass
+	uint32_t threshold;			//Rise over the baseline that counts as a touch, in 1/256
+	uint32_t touched;
+	uint32_t raw[32];			//Last summed charge ticks, by pin number
+	uint32_t baseline[32];
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// threshold_pct: 10 is a touch when a key takes 10% longer than its baseline
+int fagpio_touch_init(struct fagpio_touch *t, uint8_t port, uint32_t mask, uint8_t samples, uint32_t threshold_pct, unsigned int flags);
+
+// One measurement into t->raw; returns the pins that never charged
+uint32_t fagpio_touch_measure(struct fagpio_touch *t);
+
+// Sets the baselines from rounds measurements, hands off the keys
+int fagpio_touch_calibrate(struct fagpio_touch *t, unsigned int rounds);
+
+// Measures and returns the touched pins; changed receives those that flipped, may be NULL
+uint32_t fagpio_touch_read(struct fagpio_touch *t, uint32_t *changed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,259 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "fagpio_priv.h"
+#include "fagpio_atomic.h"
+#include "fagpio_log.h"
+#include "fagpio_mem.h"
+#include "fagpio_timer.h"
+#include "fagpio_trace.h"
+#include "fagpio_seq.h"
+#include "fagpio_sink.h"
+
+#define REPLAY_OPS		4096			//Sequencer ops per replay chunk
+#define REPLAY_SPAN		(1u << 30)		//Ticks per chunk, within the sequencer's signed compare
+#define REPLAY_READ		128				//Records per read() of the dump
+
+volatile uint8_t fagpio_tracing;
+
+static struct fagpio_trace_rec *ring;
+static struct fagpio_arena *ring_arena;
+static uint32_t ring_mask;
+static volatile uint32_t head;		//Records ever claimed
+
+int fagpio_trace_start(unsigned int records) {
+	return fagpio_trace_start_arena(records, NULL);
+}
+
+int fagpio_trace_start_arena(unsigned int records, struct fagpio_arena *arena) {
+	uint32_t size = 1;
+
+	if (!records || records > (1u << 24))
+		return -1;
+	while (size < records)
+		size <<= 1;
+
+	fagpio_tracing = 0;
+	if (ring_mask + 1 != size || !ring || ring_arena != arena) {
+		fagpio_mem_give(ring_arena, ring);
+		ring_arena = arena;
+		if (!(ring = fagpio_mem_take(arena, size * sizeof(*ring), 0)))
+			return -1;
+		ring_mask = size - 1;
+	}
+	head = 0;
+	fagpio_tracing = 1;
+	return 0;
+}
+
+void fagpio_trace_stop(void) {
+	fagpio_tracing = 0;
+}
+
+void fagpio_trace_free(void) {
+	fagpio_tracing = 0;
+	fagpio_mem_give(ring_arena, ring);
+	ring = NULL;
+	ring_arena = NULL;
+	ring_mask = 0;
+	head = 0;
+}
+
+void fagpio_trace_record(uint8_t op, uint8_t pin, uint16_t value) {
+	uint32_t slot;
+
+	do {
+		slot = head;
+	} while (!fagpio_cas(&head, slot, slot + 1));
+
+	struct fagpio_trace_rec *r = &ring[slot & ring_mask];
+
+	r->ticks = fagpio_ticks();
+	r->op = op;
+	r->pin = pin;
+	r->value = value;
+}
+
+// Claims one slot per pin in changed with a single compare-and-swap
+void fagpio_trace_port(uint8_t op, uint8_t port, uint32_t changed, uint32_t dat, uint32_t ticks) {
+	uint32_t n = __builtin_popcount(changed), slot;
+
+	do {
+		slot = head;
+	} while (!fagpio_cas(&head, slot, slot + n));
+
+	for (; changed; changed &= changed - 1, slot++) {
+		struct fagpio_trace_rec *r = &ring[slot & ring_mask];
+		unsigned int bit = __builtin_ctz(changed);
+
+		r->ticks = ticks;
+		r->op = op;
+		r->pin = PIO_PIN(port, bit);
+		r->value = (dat >> bit) & 1;
+	}
+}
+
+// The header and at most two slices of the ring, the second from its wrap
+int fagpio_trace_send(int fd) {
+	uint32_t end = head, size = ring_mask + 1;
+	struct fagpio_trace_file hdr = {
+		.magic = FAGPIO_TRACE_MAGIC,
+		.tick_hz = fagpio_tick_hz,
+		.count = end < size ? end : size,
+		.dropped = end < size ? 0 : end - size,
+	};
+	struct iovec iov[3] = { { &hdr, sizeof(hdr) } };
+	uint32_t first = (end - hdr.count) & ring_mask, tail = size - first;
+	int n = 1;
+
+	if (!ring)
+		return -1;
+	if (tail > hdr.count)
+		tail = hdr.count;
+	iov[n].iov_base = &ring[first];
+	iov[n++].iov_len = tail * sizeof(*ring);
+	if (hdr.count > tail) {
+		iov[n].iov_base = ring;
+		iov[n++].iov_len = (hdr.count - tail) * sizeof(*ring);
+	}
+	return fagpio_sink_writev(fd, iov, n);
+}
+
+int fagpio_trace_dump(const char *path) {
+	int fd, ret;
+
+	if (!ring)
+		return -1;
+	if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "%s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	ret = fagpio_trace_send(fd);
+	if (close(fd) < 0)
+		ret = -1;
+	return ret;
+}
+
+/*
+Replay reads the dump in a stream and feeds the sequencer chunk by chunk,
+so a long trace needs no more memory than one chunk of ops. Each chunk
+starts where the previous one ended on the counter; its first steps are
+late when the previous gap was shorter than building the chunk.
+*/
+struct replay_file {
+	int fd;
+	unsigned int n, i;		//Records in buf, next one
+	struct fagpio_trace_rec buf[REPLAY_READ];
+};
+
+static int replay_open(struct replay_file *f, const char *path, struct fagpio_trace_file *hdr) {
+	if ((f->fd = open(path, O_RDONLY)) < 0) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "%s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	if (read(f->fd, hdr, sizeof(*hdr)) != sizeof(*hdr) || hdr->magic != FAGPIO_TRACE_MAGIC || !hdr->tick_hz) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "%s: not a fagpio trace\n", path);
+		close(f->fd);
+		return -1;
+	}
+	f->n = f->i = 0;
+	return 0;
+}
+
+// 0 at the end of the file; a torn last record counts as the end
+static int replay_next(struct replay_file *f, struct fagpio_trace_rec *r) {
+	if (f->i == f->n) {
+		ssize_t n = read(f->fd, f->buf, sizeof(f->buf));
+
+		f->n = n > 0 ? n / sizeof(*r) : 0;
+		f->i = 0;
+		if (!f->n)
+			return 0;
+	}
+	*r = f->buf[f->i++];
+	return 1;
+}
+
+// Pins the trace switches to OUTPUT are made outputs before the first step
+static void replay_modes(struct replay_file *f, const struct fagpio_trace_file *hdr) {
+	struct fagpio_trace_rec r;
+
+	for (uint32_t i = 0; i < hdr->count && replay_next(f, &r); i++) {
+		if (r.op == FAGPIO_TRACE_MODE && r.value == OUTPUT)
+			pinMode(r.pin, OUTPUT);
+	}
+	lseek(f->fd, sizeof(*hdr), SEEK_SET);
+	f->n = f->i = 0;
+}
+
+// Sleeps through a gap of at least a whole chunk span
+static uint32_t replay_gap(uint32_t start, uint32_t *carry) {
+	while (*carry >= REPLAY_SPAN) {
+		start += REPLAY_SPAN;
+		*carry -= REPLAY_SPAN;
+		while ((int32_t)(fagpio_ticks() - start) < 0)
+			usleep(1000);
+	}
+	return start;
+}
+
+int fagpio_trace_replay(const char *path, unsigned int flags) {
+	return fagpio_trace_replay_arena(path, flags, NULL);
+}
+
+// The chunk of ops is released from the arena again on return
+int fagpio_trace_replay_arena(const char *path, unsigned int flags, struct fagpio_arena *arena) {
+	struct fagpio_trace_file hdr;
+	struct fagpio_trace_rec r;
+	struct fagpio_seq seq;
+	struct fagpio_seq_op *ops;
+	struct replay_file f;
+	int late = 0, ret = 0;
+	size_t mark = arena ? fagpio_arena_mark(arena) : 0;
+
+	if (!fagpio_banks() || !fagpio_tick_hz || replay_open(&f, path, &hdr) < 0)
+		return -1;
+	if (!(ops = fagpio_mem_take(arena, REPLAY_OPS * sizeof(*ops), 0))) {
+		close(f.fd);
+		return -1;
+	}
+	if (flags & FAGPIO_REPLAY_MODES)
+		replay_modes(&f, &hdr);
+
+	uint32_t start = fagpio_ticks(), prev = 0, carry = 0;
+	int first = 1;
+
+	fagpio_seq_init(&seq, ops, REPLAY_OPS);
+	for (uint32_t i = 0; i < hdr.count && ret >= 0 && replay_next(&f, &r); i++) {
+		uint8_t port = PIO_PIN_PORT(r.pin);
+
+		if (r.op != FAGPIO_TRACE_WRITE || r.value > 1 || port >= PIO_NPORTS)
+			continue;
+		if (!first)
+			carry += (uint64_t)(r.ticks - prev) * fagpio_tick_hz / hdr.tick_hz;
+		first = 0;
+		prev = r.ticks;
+
+		if (seq.count == REPLAY_OPS || seq.end + carry >= REPLAY_SPAN) {
+			if ((ret = fagpio_seq_play_ops(seq.ops, seq.count, start)) < 0)
+				break;
+			late += ret;
+			start += seq.end;
+			fagpio_seq_init(&seq, ops, REPLAY_OPS);
+			start = replay_gap(start, &carry);
+		}
+		fagpio_seq_add(&seq, port, PIO_PIN_MASK(r.pin), r.value ? PIO_PIN_MASK(r.pin) : 0, carry);
+		carry = 0;
+	}
+	if (ret >= 0 && seq.count && (ret = fagpio_seq_play_ops(seq.ops, seq.count, start)) >= 0)
+		late += ret;
+
+	fagpio_mem_give(arena, ops);
+	if (arena)
+		fagpio_arena_release(arena, mark);
+	close(f.fd);
+	return ret < 0 ? -1 : late;
+}
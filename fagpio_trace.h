@@ -0,0 +1,72 @@
+#ifndef _FAGPIO_TRACE_H
+#define _FAGPIO_TRACE_H
+
+#include <stdint.h>
+#include "fagpio_mem.h"
+
+/*
+ * Op trace. While tracing is on, digitalWrite, digitalRead and pinMode
+ * append one record to a preallocated ring: a slot is claimed with a
+ * compare-and-swap on the head index and filled with plain stores, so
+ * tracing takes no lock and makes no syscall. Port writes and toggles add
+ * a WRITE record per pin they change, and a running sampler
+ * (fagpio_sampler.h) an INPUT record per input change, stamped with its
+ * sample time. The ring keeps the newest records. fagpio_trace_dump()
+ * writes a header and the records oldest first, fagpio_trace_send() the
+ * same to an open fd such as a fagpio_sink.h socket; tools/trace2vcd
+ * turns that stream into a VCD for a waveform viewer, tools/trace2json
+ * into Chrome trace events for Perfetto.
+ *
+ * fagpio_trace_replay() plays the WRITE records of a dump again through
+ * the sequencer with their original spacing, rescaled to the counter
+ * rate of this board. It returns the number of steps that were late.
+ * Build the library with -DFAGPIO_TRACE=0 to compile the hooks out.
+ */
+
+#ifndef FAGPIO_TRACE
+#define FAGPIO_TRACE		1
+#endif
+
+#define FAGPIO_TRACE_MAGIC	0x52544746		//"FGTR"
+
+enum fagpio_trace_op {
+	FAGPIO_TRACE_WRITE = 1,
+	FAGPIO_TRACE_READ,
+	FAGPIO_TRACE_MODE,
+	FAGPIO_TRACE_INPUT,		//Level change seen by the sampler
+};
+
+#define FAGPIO_REPLAY_MODES	0x01	//Make the pins the trace set to OUTPUT outputs first
+
+struct fagpio_trace_rec {
+	uint32_t ticks;		//fagpio_ticks() at the call
+	uint8_t op;
+	uint8_t pin;
+	uint16_t value;		//Level written or read, or the mode
+};
+
+struct fagpio_trace_file {
+	uint32_t magic;
+	uint32_t tick_hz;
+	uint32_t count;		//Records following the header
+	uint32_t dropped;	//Older records overwritten by the ring
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fagpio_trace_start(unsigned int records);	//Rounded up to a power of two
+int fagpio_trace_start_arena(unsigned int records, struct fagpio_arena *arena);	//The ring from arena (fagpio_mem.h)
+void fagpio_trace_stop(void);					//Stops recording, keeps the ring for dumping
+int fagpio_trace_dump(const char *path);
+int fagpio_trace_send(int fd);					//The same stream to a socket or file, from the ring without copying
+int fagpio_trace_replay(const char *path, unsigned int flags);
+int fagpio_trace_replay_arena(const char *path, unsigned int flags, struct fagpio_arena *arena);
+void fagpio_trace_free(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
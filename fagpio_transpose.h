@@ -0,0 +1,54 @@
+#ifndef _FAGPIO_TRANSPOSE_H
+#define _FAGPIO_TRANSPOSE_H
+
+#include <stdint.h>
+
+/*
+ * 8x8 bit transpose for parallel outputs. Eight lanes (strips, motors,
+ * colour channels) each hold a byte; a parallel driver wants, for every
+ * bit position, one word with a bit per lane. The loop that extracts and
+ * shifts each of the 64 bits costs about 200 instructions on the ARM926;
+ * this is the shift-and-mask transpose of Hacker's Delight (7.3) on the
+ * matrix held in two 32-bit registers: three exchange rounds, about 25
+ * ALU ops, no tables and no branches.
+ *
+ * out[k] holds bit 7-k of every lane, MSB first as the lines send it,
+ * with lane i in bit i. Missing lanes are passed as 0.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static inline void fagpio_transpose8(const uint8_t in[8], uint8_t out[8]) {
+	// Row r of the matrix is lane 7-r, so lane i lands in bit i of each column
+	uint32_t x = in[4] | (uint32_t)in[5] << 8 | (uint32_t)in[6] << 16 | (uint32_t)in[7] << 24;
+	uint32_t y = in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16 | (uint32_t)in[3] << 24;
+	uint32_t t;
+
+	t = (x ^ (x >> 7)) & 0x00AA00AA;	x ^= t ^ (t << 7);
+	t = (y ^ (y >> 7)) & 0x00AA00AA;	y ^= t ^ (t << 7);
+	t = (x ^ (x >> 14)) & 0x0000CCCC;	x ^= t ^ (t << 14);
+	t = (y ^ (y >> 14)) & 0x0000CCCC;	y ^= t ^ (t << 14);
+	t = (x & 0xF0F0F0F0) | ((y >> 4) & 0x0F0F0F0F);
+	y = ((x << 4) & 0xF0F0F0F0) | (y & 0x0F0F0F0F);
+	x = t;
+
+	out[0] = x >> 24;	out[1] = x >> 16;	out[2] = x >> 8;	out[3] = x;
+	out[4] = y >> 24;	out[5] = y >> 16;	out[6] = y >> 8;	out[7] = y;
+}
+
+// As fagpio_transpose8(), with each column ORed into slot[k] at shift
+static inline void fagpio_transpose8_slots(const uint8_t in[8], uint32_t slot[8], unsigned int shift) {
+	uint8_t col[8];
+
+	fagpio_transpose8(in, col);
+	for (unsigned int k = 0; k < 8; k++)
+		slot[k] |= (uint32_t)col[k] << shift;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <unistd.h>
+#include "fagpio_priv.h"
+#include "fagpio_twi.h"
+#include "fagpio_region.h"
+#include "fagpio_log.h"
+
+#define TWI_CNTR_BUS_EN		(1u << 6)
+#define TWI_CNTR_M_STA		(1u << 5)
+#define TWI_CNTR_M_STP		(1u << 4)
+#define TWI_CNTR_INT_FLAG	(1u << 3)		//Write 1 to clear and run the next step
+#define TWI_CNTR_A_ACK		(1u << 2)
+#define TWI_TIMEOUT			1000000			//Polls per bus step
+
+// STAT codes of the steps we wait for
+#define TWI_START			0x08
+#define TWI_RSTART			0x10
+#define TWI_ADDR_W_ACK		0x18
+#define TWI_DATA_W_ACK		0x28
+#define TWI_ADDR_R_ACK		0x40
+#define TWI_DATA_R_ACK		0x50
+#define TWI_DATA_R_NACK		0x58
+
+static struct {
+	uint8_t scl, sda, func;
+} twi_pins[TWI_BUSES] = {
+	{ PIO_PIN(PIO_PORT_E, 11), PIO_PIN(PIO_PORT_E, 12), 3 },
+	{ TWI_NO_PIN, TWI_NO_PIN, 0 },
+	{ TWI_NO_PIN, TWI_NO_PIN, 0 },
+};
+
+static volatile uint32_t *twi_regs(uint8_t bus) {
+	if (bus >= TWI_BUSES || !fagpio_banks())
+		return NULL;
+	return fagpio_region(FAGPIO_REGION_TWI0 + bus);
+}
+
+// Clears INT_FLAG with the given extra bits and waits for the step to finish; STAT or -1
+static int twi_step(volatile uint32_t *twi, uint32_t bits) {
+	twi[rTWI_CNTR / 4] = TWI_CNTR_BUS_EN | TWI_CNTR_INT_FLAG | bits;
+	for (int i = 0; i < TWI_TIMEOUT; i++) {
+		if (twi[rTWI_CNTR / 4] & TWI_CNTR_INT_FLAG)
+			return twi[rTWI_STAT / 4] & 0xFF;
+	}
+	return -1;
+}
+
+static void twi_stop(volatile uint32_t *twi) {
+	twi[rTWI_CNTR / 4] = TWI_CNTR_BUS_EN | TWI_CNTR_INT_FLAG | TWI_CNTR_M_STP;
+	for (int i = 0; i < TWI_TIMEOUT && (twi[rTWI_CNTR / 4] & TWI_CNTR_M_STP); i++)
+		;
+}
+
+void fagpio_twi_set_pins(uint8_t bus, uint8_t scl, uint8_t sda, uint8_t func) {
+	if (bus >= TWI_BUSES)
+		return;
+	twi_pins[bus].scl = scl;
+	twi_pins[bus].sda = sda;
+	twi_pins[bus].func = func;
+}
+
+int fagpio_twi_open(uint8_t bus, uint32_t hz) {
+	volatile uint32_t *twi = twi_regs(bus);
+	volatile uint32_t *ccu = fagpio_region(FAGPIO_REGION_CCU);
+	char path[64];
+
+	if (!twi || !ccu || !hz)
+		return -1;
+
+	snprintf(path, sizeof(path), "/sys/bus/platform/devices/%x.i2c/driver", (unsigned int)fagpio_region_phys(FAGPIO_REGION_TWI0 + bus));
+	if (access(path, F_OK) == 0) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "TWI%u is owned by the kernel i2c driver\n", bus);
+		return -1;
+	}
+
+	ccu[rCCU_BUS_RST2 / 4] |= 1u << (16 + bus);
+	ccu[rCCU_BUS_GATING2 / 4] |= 1u << (16 + bus);
+	if (twi_pins[bus].scl != TWI_NO_PIN) {
+		fagpio_pin_func(twi_pins[bus].scl, twi_pins[bus].func);
+		fagpio_pin_func(twi_pins[bus].sda, twi_pins[bus].func);
+	}
+
+	// SCL = APB / (2^N * (M + 1) * 10), the fastest setting not above hz
+	uint32_t best = 0, ccr = 0x7F;
+
+	for (uint32_t n = 0; n < 8; n++) {
+		for (uint32_t m = 0; m < 16; m++) {
+			uint32_t f = TWI_APB_HZ / ((1u << n) * (m + 1) * 10);
+
+			if (f <= hz && f > best) {
+				best = f;
+				ccr = (m << 3) | n;
+			}
+		}
+	}
+
+	twi[rTWI_SRST / 4] = 1;
+	for (int i = 0; i < 1000 && (twi[rTWI_SRST / 4] & 1); i++)
+		;
+	twi[rTWI_CCR / 4] = ccr;
+	twi[rTWI_EFR / 4] = 0;
+	twi[rTWI_CNTR / 4] = TWI_CNTR_BUS_EN;
+	FAGPIO_LOG(FAGPIO_LOG_INFO, "TWI%u at %u Hz\n", bus, best);
+	return 0;
+}
+
+// Start (repeated after the first message), address and data of one message, no stop
+static int twi_msg(volatile uint32_t *twi, const struct fagpio_i2c_msg *m) {
+	int rd = m->flags & FAGPIO_I2C_READ;
+	int st = twi_step(twi, TWI_CNTR_M_STA);
+
+	if (st != TWI_START && st != TWI_RSTART)
+		return -1;
+	twi[rTWI_DATA / 4] = (m->addr << 1) | rd;
+	if (twi_step(twi, 0) != (rd ? TWI_ADDR_R_ACK : TWI_ADDR_W_ACK))
+		return -1;
+
+	for (uint16_t i = 0; i < m->len; i++) {
+		if (rd) {
+			int last = i + 1 == m->len;
+
+			if (twi_step(twi, last ? 0 : TWI_CNTR_A_ACK) != (last ? TWI_DATA_R_NACK : TWI_DATA_R_ACK))
+				return -1;
+			m->buf[i] = twi[rTWI_DATA / 4];
+		} else {
+			twi[rTWI_DATA / 4] = m->buf[i];
+			if (twi_step(twi, 0) != TWI_DATA_W_ACK)
+				return -1;
+		}
+	}
+	return 0;
+}
+
+int fagpio_twi_transfer(uint8_t bus, const struct fagpio_i2c_msg *msgs, unsigned int count) {
+	volatile uint32_t *twi = twi_regs(bus);
+	unsigned int done;
+
+	if (!twi)
+		return -1;
+	FAGPIO_PROBE2(twi_start, bus, count);
+	for (done = 0; done < count && twi_msg(twi, &msgs[done]) == 0; done++)
+		;
+	twi_stop(twi);
+	FAGPIO_PROBE2(twi_done, bus, done);
+	return done;
+}
+
+int fagpio_twi_read_regs(uint8_t bus, const struct fagpio_i2c_reg *regs, unsigned int count) {
+	volatile uint32_t *twi = twi_regs(bus);
+	unsigned int done;
+
+	if (!twi)
+		return -1;
+	for (done = 0; done < count; done++) {
+		uint8_t reg = regs[done].reg;
+		struct fagpio_i2c_msg w = { regs[done].addr, 0, 1, &reg };
+		struct fagpio_i2c_msg r = { regs[done].addr, FAGPIO_I2C_READ, regs[done].len, regs[done].buf };
+
+		if (twi_msg(twi, &w) < 0 || twi_msg(twi, &r) < 0)
+			break;
+	}
+	twi_stop(twi);
+	return done;
+}
+
+void fagpio_twi_close(uint8_t bus) {
+	volatile uint32_t *twi = twi_regs(bus);
+	volatile uint32_t *ccu = fagpio_region(FAGPIO_REGION_CCU);
+
+	if (!twi || !ccu)
+		return;
+	twi[rTWI_CNTR / 4] = 0;
+	ccu[rCCU_BUS_GATING2 / 4] &= ~(1u << (16 + bus));
+}
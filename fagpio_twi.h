@@ -0,0 +1,46 @@
+#ifndef _FAGPIO_TWI_H
+#define _FAGPIO_TWI_H
+
+#include <stdint.h>
+#include "fagpio_i2c.h"
+
+/*
+ * Polled userspace driver for the TWI0-2 controllers (0x01C27000 +
+ * 0x400 * bus), mapped with fagpio_region(). Every bus step is started by
+ * a CNTR write and finished when INT_FLAG rises; the STAT code then
+ * decides the next step, with interrupts left disabled. A transfer or a
+ * register-read list is one back-to-back sequence with repeated starts
+ * and a single stop. fagpio_twi_open() refuses a bus the kernel's
+ * mv64xxx driver is bound to; disable that node in the device tree first.
+ */
+
+#define rTWI_DATA			0x08
+#define rTWI_CNTR			0x0C
+#define rTWI_STAT			0x10
+#define rTWI_CCR			0x14
+#define rTWI_SRST			0x18
+#define rTWI_EFR			0x1C
+
+#define rCCU_BUS_GATING2	0x068	//TWI0-2 bits 16-18
+#define rCCU_BUS_RST2		0x2D0
+
+#define TWI_APB_HZ			100000000	//Module clock, the APB rate set by the bootloader
+#define TWI_BUSES			3
+#define TWI_NO_PIN			0xFF
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Overrides the pins fagpio_twi_open() muxes; TWI0 defaults to SCK PE11, SDA PE12, function 3
+void fagpio_twi_set_pins(uint8_t bus, uint8_t scl, uint8_t sda, uint8_t func);
+int fagpio_twi_open(uint8_t bus, uint32_t hz);
+int fagpio_twi_transfer(uint8_t bus, const struct fagpio_i2c_msg *msgs, unsigned int count);	//Messages completed
+int fagpio_twi_read_regs(uint8_t bus, const struct fagpio_i2c_reg *regs, unsigned int count);	//Reads completed
+void fagpio_twi_close(uint8_t bus);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
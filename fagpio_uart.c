@@ -0,0 +1,181 @@
+#include <stdio.h>
+#include <unistd.h>
+#include "fagpio_priv.h"
+#include "fagpio_uart.h"
+#include "fagpio_inline.h"
+#include "fagpio_region.h"
+#include "fagpio_ccu.h"
+#include "fagpio_timer.h"
+#include "fagpio_log.h"
+
+#define UART_LCR_DLAB		(1u << 7)
+#define UART_FCR_FIFO		0x07			//Enable, reset both FIFOs
+#define UART_LSR_TEMT		(1u << 6)		//FIFO and shift register empty
+#define UART_USR_BUSY		(1u << 0)
+#define UART_TIMEOUT		10000000		//Polls before a write gives up
+
+static struct {
+	uint8_t tx, rx, func;
+} uart_pins[UART_PORTS] = {
+	{ PIO_PIN(PIO_PORT_E, 1), PIO_PIN(PIO_PORT_E, 0), 5 },
+	{ PIO_PIN(PIO_PORT_A, 3), PIO_PIN(PIO_PORT_A, 2), 5 },
+	{ PIO_PIN(PIO_PORT_E, 7), PIO_PIN(PIO_PORT_E, 8), 3 },
+};
+
+static uint8_t uart_dir[UART_PORTS] = { UART_NO_PIN, UART_NO_PIN, UART_NO_PIN };
+
+static volatile uint32_t *uart_regs(uint8_t uart) {
+	if (uart >= UART_PORTS || !fagpio_banks())
+		return NULL;
+	return fagpio_region(FAGPIO_REGION_UART0 + uart);
+}
+
+void fagpio_uart_set_pins(uint8_t uart, uint8_t tx, uint8_t rx, uint8_t func) {
+	if (uart >= UART_PORTS)
+		return;
+	uart_pins[uart].tx = tx;
+	uart_pins[uart].rx = rx;
+	uart_pins[uart].func = func;
+}
+
+int fagpio_uart_open(uint8_t uart, uint32_t baud, uint8_t dir_pin) {
+	return fagpio_uart_open_format(uart, baud, dir_pin, UART_LCR_8N1);
+}
+
+int fagpio_uart_open_format(uint8_t uart, uint32_t baud, uint8_t dir_pin, uint8_t lcr) {
+	volatile uint32_t *u = uart_regs(uart);
+	uint32_t apb = fagpio_ccu_pio_hz();
+	char path[64];
+
+	if (!u || !apb || !baud || (dir_pin != UART_NO_PIN && PIO_PIN_PORT(dir_pin) >= PIO_NPORTS))
+		return -1;
+
+	snprintf(path, sizeof(path), "/sys/bus/platform/devices/%x.serial/driver", (unsigned int)fagpio_region_phys(FAGPIO_REGION_UART0 + uart));
+	if (access(path, F_OK) == 0) {
+		FAGPIO_LOG(FAGPIO_LOG_ERR, "UART%u is owned by the kernel serial driver\n", uart);
+		return -1;
+	}
+
+	fagpio_ccu_reset(FAGPIO_GATE_UART(uart), 0);
+	fagpio_ccu_gate(FAGPIO_GATE_UART(uart), 1);
+	if (uart_pins[uart].tx != UART_NO_PIN) {
+		fagpio_pin_func(uart_pins[uart].tx, uart_pins[uart].func);
+		fagpio_pin_func(uart_pins[uart].rx, uart_pins[uart].func);
+	}
+	uart_dir[uart] = dir_pin;
+	if (dir_pin != UART_NO_PIN) {
+		fagpio_digital_write(fagpio_default(), dir_pin, 0);
+		pinMode(dir_pin, 0);
+	}
+
+	uint32_t div = (apb + 8 * baud) / (16 * baud);
+
+	if (!div || div > 0xFFFF)
+		return -1;
+
+	// LCR only takes a write while the receiver is idle
+	for (int i = 0; i < UART_TIMEOUT && (u[rUART_USR / 4] & UART_USR_BUSY); i++)
+		(void)u[rUART_RBR / 4];
+	u[rUART_DLH / 4] = 0;				//IER: polled
+	u[rUART_FCR / 4] = UART_FCR_FIFO;
+	u[rUART_MCR / 4] = 0;
+	u[rUART_LCR / 4] = UART_LCR_DLAB | lcr;
+	u[rUART_RBR / 4] = div & 0xFF;
+	u[rUART_DLH / 4] = div >> 8;
+	u[rUART_LCR / 4] = lcr & ~UART_LCR_DLAB;
+	FAGPIO_LOG(FAGPIO_LOG_INFO, "UART%u at %u baud\n", uart, apb / (16 * div));
+	return 0;
+}
+
+int fagpio_uart_write(uint8_t uart, const uint8_t *buf, size_t len) {
+	volatile uint32_t *u = uart_regs(uart);
+	struct pio_bank *banks = fagpio_banks();
+	uint8_t dir = uart < UART_PORTS ? uart_dir[uart] : UART_NO_PIN;
+	size_t sent = 0;
+	unsigned int idle = 0;
+
+	if (!u)
+		return -1;
+	if (dir != UART_NO_PIN)
+		digitalSetFast(banks, dir);
+
+	while (sent < len) {
+		uint32_t room = UART_FIFO_DEPTH - (u[rUART_TFL / 4] & 0x7F);
+
+		if (!room) {
+			if (++idle > UART_TIMEOUT)
+				break;
+			continue;
+		}
+		idle = 0;
+		for (; room && sent < len; room--)
+			u[rUART_RBR / 4] = buf[sent++];
+	}
+
+	for (unsigned int i = 0; i < UART_TIMEOUT && !(u[rUART_LSR / 4] & UART_LSR_TEMT); i++)
+		;
+	if (dir != UART_NO_PIN)
+		digitalClearFast(banks, dir);
+	return sent;
+}
+
+int fagpio_uart_read(uint8_t uart, uint8_t *buf, size_t max, uint32_t timeout_ticks) {
+	volatile uint32_t *u = uart_regs(uart);
+	uint32_t last = fagpio_ticks();
+	size_t got = 0;
+
+	if (!u)
+		return -1;
+
+	while (got < max) {
+		uint32_t n = u[rUART_RFL / 4] & 0x7F;
+
+		if (!n) {
+			if (fagpio_ticks() - last > timeout_ticks)
+				break;
+			continue;
+		}
+		for (; n && got < max; n--)
+			buf[got++] = u[rUART_RBR / 4];
+		last = fagpio_ticks();
+	}
+	return got;
+}
+
+int fagpio_uart_read_frame(uint8_t uart, uint8_t *buf, size_t max, uint32_t first_ticks, uint32_t gap_ticks) {
+	volatile uint32_t *u = uart_regs(uart);
+	uint32_t start = fagpio_ticks(), last = start;
+	size_t got = 0;
+
+	if (!u)
+		return -1;
+
+	for (;;) {
+		uint32_t n = u[rUART_RFL / 4] & 0x7F;
+
+		if (!n) {
+			uint32_t now = fagpio_ticks();
+
+			if (got ? now - last > gap_ticks : now - start > first_ticks)
+				break;
+			continue;
+		}
+		for (; n; n--, got++) {
+			uint8_t b = u[rUART_RBR / 4];
+
+			if (got < max)
+				buf[got] = b;
+		}
+		last = fagpio_ticks();
+	}
+	return got;
+}
+
+void fagpio_uart_close(uint8_t uart) {
+	if (!uart_regs(uart))
+		return;
+	fagpio_ccu_gate(FAGPIO_GATE_UART(uart), 0);
+	if (uart_dir[uart] != UART_NO_PIN)
+		pinMode(uart_dir[uart], 1);
+	uart_dir[uart] = UART_NO_PIN;
+}
@@ -0,0 +1,54 @@
+#ifndef _FAGPIO_UART_H
+#define _FAGPIO_UART_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Polled userspace driver for the 16550-style UART0-2 controllers
+ * (0x01C25000 + 0x400 * n), mapped with fagpio_region(). Writes fill the
+ * 64-byte TX FIFO in batches from its level register, with no syscall.
+ * For RS-485 a direction pin is driven high before the first byte and
+ * dropped in the same loop that sees the transmitter empty, so the bus is
+ * released within a few register reads of the last stop bit.
+ * fagpio_uart_open() refuses a port the kernel's serial driver is bound
+ * to, such as the console on UART0.
+ */
+
+#define rUART_RBR			0x00	//Also THR, and DLL with LCR.DLAB
+#define rUART_DLH			0x04	//Also IER
+#define rUART_FCR			0x08
+#define rUART_LCR			0x0C
+#define rUART_MCR			0x10
+#define rUART_LSR			0x14
+#define rUART_USR			0x7C
+#define rUART_TFL			0x80
+#define rUART_RFL			0x84
+
+#define UART_PORTS			3
+#define UART_FIFO_DEPTH		64
+#define UART_NO_PIN			0xFF
+
+#define UART_LCR_8N1		0x03		//LCR line formats for fagpio_uart_open_format()
+#define UART_LCR_8E1		0x1B		//8 bits, even parity, 1 stop bit (Modbus RTU)
+#define UART_LCR_8E2		0x1F		//8 bits, even parity, 2 stop bits (SBUS)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Overrides the pins fagpio_uart_open() muxes; defaults: UART0 PE1/PE0 and UART1 PA3/PA2 function 5, UART2 PE7/PE8 function 3
+void fagpio_uart_set_pins(uint8_t uart, uint8_t tx, uint8_t rx, uint8_t func);
+int fagpio_uart_open(uint8_t uart, uint32_t baud, uint8_t dir_pin);		//8N1; dir_pin UART_NO_PIN for none
+int fagpio_uart_open_format(uint8_t uart, uint32_t baud, uint8_t dir_pin, uint8_t lcr);	//UART_LCR_*
+int fagpio_uart_write(uint8_t uart, const uint8_t *buf, size_t len);	//Bytes sent, returns once they are on the wire
+int fagpio_uart_read(uint8_t uart, uint8_t *buf, size_t max, uint32_t timeout_ticks);	//Stops timeout_ticks after the last byte
+// Waits up to first_ticks for a byte, then reads until gap_ticks pass without one; bytes past max are counted, not stored
+int fagpio_uart_read_frame(uint8_t uart, uint8_t *buf, size_t max, uint32_t first_ticks, uint32_t gap_ticks);
+void fagpio_uart_close(uint8_t uart);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
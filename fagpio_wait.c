@@ -0,0 +1,84 @@
+#include <poll.h>
+#include <time.h>
+#include "fagpio.h"
+#include "fagpio_eint.h"
+#include "fagpio_timer.h"
+#include "fagpio_soc.h"
+#include "fagpio_wait.h"
+
+#define BACKOFF_MIN_NS		10000
+#define BACKOFF_MAX_NS		1000000
+
+static uint64_t now_us(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Level interrupt: fires at once if the level is already there, so no edge can be missed
+static int wait_eint(uint8_t pin, uint8_t level, uint64_t deadline) {
+	struct pio_bank *banks = fagpio_banks();
+	volatile uint32_t *cfg;
+	uint32_t saved;
+	int fd, ret = -1;
+
+	if (!banks || fagpio_soc_eint_bank(PIO_PIN_PORT(pin)) < 0)
+		return -2;
+	cfg = &banks[PIO_PIN_PORT(pin)].cfg[PIO_PIN_NUM(pin) >> 3];
+	saved = *cfg;
+	if ((fd = attachInterrupt(pin, level ? HIGH_LEVEL : LOW_LEVEL)) < 0)
+		return -2;
+
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+
+	for (;;) {
+		uint64_t now = now_us();
+		uint32_t count;
+
+		if (deadline && now >= deadline)
+			break;
+		if (poll(&pfd, 1, deadline ? (int)((deadline - now + 999) / 1000) : -1) <= 0)
+			continue;
+		if (read(fd, &count, sizeof(count)) != sizeof(count))
+			continue;
+		fagpio_eint_ack(PIO_PIN_PORT(pin));
+		if (!fagpio_digital_read(fagpio_default(), pin) == !level) {
+			ret = 0;
+			break;
+		}
+	}
+
+	fagpio_eint_mask(pin);
+	*cfg = saved;
+	return ret;
+}
+
+int fagpio_wait_pin(uint8_t pin, uint8_t level, uint32_t timeout_us, uint32_t spin_ns) {
+	uint64_t deadline = timeout_us ? now_us() + timeout_us : 0;
+	uint32_t spin = fagpio_ns_to_ticks(spin_ns), start = fagpio_ticks();
+
+	do {
+		if (!fagpio_digital_read(fagpio_default(), pin) == !level)
+			return 0;
+	} while (fagpio_ticks() - start < spin);
+
+	int ret = wait_eint(pin, level, deadline);
+
+	if (ret != -2)
+		return ret;
+
+	uint32_t backoff = BACKOFF_MIN_NS;
+
+	for (;;) {
+		struct timespec ts = { 0, backoff };
+
+		if (!fagpio_digital_read(fagpio_default(), pin) == !level)
+			return 0;
+		if (deadline && now_us() >= deadline)
+			return -1;
+		nanosleep(&ts, NULL);
+		if (backoff < BACKOFF_MAX_NS)
+			backoff *= 2;
+	}
+}
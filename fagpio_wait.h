@@ -0,0 +1,26 @@
+#ifndef _FAGPIO_WAIT_H
+#define _FAGPIO_WAIT_H
+
+#include <stdint.h>
+
+/*
+ * Spin-then-sleep wait for an input level. The first spin_ns are spent
+ * polling DAT, which catches short waits with no wake-up latency. After
+ * that the wait blocks on a level-triggered EINT interrupt when the pin
+ * is on an EINT port (PD/PE/PF on the F1C100s) with a UIO node
+ * (fagpio_eint.h), otherwise it sleeps with nanosleep in steps that
+ * double from 10 us to 1 ms.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 0 once pin reads level, -1 after timeout_us (0 waits forever)
+int fagpio_wait_pin(uint8_t pin, uint8_t level, uint32_t timeout_us, uint32_t spin_ns);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,77 @@
+#include <string.h>
+#include "fagpio_priv.h"
+#include "fagpio_ws2812.h"
+#include "fagpio_timer.h"
+#include "fagpio_transpose.h"
+
+int fagpio_ws2812_init(struct fagpio_ws2812 *ws, uint8_t first_pin, uint8_t strips, uint32_t *slots, unsigned int max_pixels) {
+	uint8_t port = PIO_PIN_PORT(first_pin);
+
+	if (port >= PIO_NPORTS || !strips || strips > 8 || PIO_PIN_NUM(first_pin) + strips > 32 || !slots)
+		return -1;
+
+	ws->port = port;
+	ws->shift = PIO_PIN_NUM(first_pin);
+	ws->strips = strips;
+	ws->mask = ((1u << strips) - 1) << ws->shift;
+	ws->slots = slots;
+	ws->max_pixels = max_pixels;
+	ws->nslots = 0;
+
+	digitalWritePort(port, ws->mask, 0);
+	pinModeMask(port, ws->mask, 0);
+	return 0;
+}
+
+int fagpio_ws2812_compile(struct fagpio_ws2812 *ws, const uint8_t *const grb[], unsigned int pixels) {
+	if (pixels > ws->max_pixels)
+		return -1;
+
+	uint32_t *slot = ws->slots;
+
+	for (unsigned int byte = 0; byte < pixels * 3; byte++, slot += 8) {
+		uint8_t lane[8] = { 0 };
+
+		for (unsigned int s = 0; s < ws->strips; s++)
+			lane[s] = grb[s][byte];
+		memset(slot, 0, 8 * sizeof(*slot));
+		fagpio_transpose8_slots(lane, slot, ws->shift);
+	}
+	ws->nslots = pixels * 24;
+	return 0;
+}
+
+static inline void wait_until(uint32_t target) {
+	while ((int32_t)(fagpio_ticks() - target) < 0)
+		;
+}
+
+FAGPIO_ARM_CODE int fagpio_ws2812_show(struct fagpio_ws2812 *ws) {
+	struct pio_bank *banks = fagpio_banks();
+
+	if (!banks)
+		return -1;
+
+	volatile uint32_t *dat = &banks[ws->port].dat;
+	uint32_t t0h = fagpio_ns_to_ticks(WS2812_T0H_NS);
+	uint32_t t1h = fagpio_ns_to_ticks(WS2812_T1H_NS);
+	uint32_t bit = fagpio_ns_to_ticks(WS2812_BIT_NS);
+	uint32_t low = *dat & ~ws->mask, high = low | ws->mask;
+	uint32_t t = fagpio_ticks() + bit;
+	int late = 0;
+
+	for (unsigned int i = 0; i < ws->nslots; i++, t += bit) {
+		if ((int32_t)(fagpio_ticks() - t) > 0)
+			late++;
+		wait_until(t);
+		*dat = high;
+		wait_until(t + t0h);
+		*dat = low | ws->slots[i];		//Strips sending a 0 fall here
+		wait_until(t + t1h);
+		*dat = low;
+	}
+
+	fagpio_shadow_sync(ws->port);
+	fagpio_delay_ns(WS2812_RESET_US * 1000);
+	return late;
+}
@@ -0,0 +1,45 @@
+#ifndef _FAGPIO_WS2812_H
+#define _FAGPIO_WS2812_H
+
+#include <stdint.h>
+
+/*
+ * WS2812 driver for 1 to 8 strips on consecutive pins of one port, e.g.
+ * PE0-PE7. fagpio_ws2812_compile() turns the GRB buffers into one word
+ * per bit slot holding the strip pins that send a 1, so fagpio_ws2812_show()
+ * only issues three whole-port stores per slot: all strips high, the
+ * 0-bit strips low after T0H, the rest low after T1H. Edges are timed on
+ * absolute AVS counter ticks; run from fagpio_rt_enter() (fagpio_rt.h),
+ * since a preemption longer than the reset time latches a partial frame.
+ */
+
+#define WS2812_T0H_NS		350
+#define WS2812_T1H_NS		700
+#define WS2812_BIT_NS		1250
+#define WS2812_RESET_US		300		//Latch, long enough for newer parts as well
+
+struct fagpio_ws2812 {
+	uint8_t port;
+	uint8_t shift;			//Number of the first strip pin
+	uint8_t strips;
+	uint32_t mask;			//All strip pins
+	uint32_t *slots;		//Caller storage, 24 words per pixel
+	unsigned int max_pixels;
+	unsigned int nslots;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fagpio_ws2812_init(struct fagpio_ws2812 *ws, uint8_t first_pin, uint8_t strips, uint32_t *slots, unsigned int max_pixels);
+
+// grb[i] is strip i's buffer, 3 bytes (G, R, B) per pixel
+int fagpio_ws2812_compile(struct fagpio_ws2812 *ws, const uint8_t *const grb[], unsigned int pixels);
+int fagpio_ws2812_show(struct fagpio_ws2812 *ws);		//Returns the number of late slots
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
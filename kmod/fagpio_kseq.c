@@ -0,0 +1,152 @@
+#include <linux/io.h>
+#include <linux/irqflags.h>
+#include <linux/miscdevice.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include "fagpio_kseq.h"
+
+/*
+Plays fagpio_seq ops with local interrupts off (see fagpio_kseq.h). The
+loop is fagpio_seq_play_ops(): wait for the op's tick on AVS counter 0,
+one DAT store from a copy of the port taken at the start. The counter is
+the one libfagpio starts and calibrates; the module only reads it.
+
+A timeline is refused when it has more than FAGPIO_KSEQ_MAX_OPS ops, an
+op out of order or on a port past PIO_NPORTS, or when any op is more than
+max_us away from now, before or after, counted at tick_hz: that bounds how
+long the interrupts stay off.
+*/
+
+#define PIO_NPORTS		7
+#define PIO_BANK_SIZE	0x24
+#define PIO_DAT			0x10
+#define AVS_CNT_CTL		0x80
+#define AVS_CNT0		0x84
+
+static unsigned long pio_phys = 0x01C20800;
+static unsigned long timer_phys = 0x01C20C00;
+static unsigned int tick_hz = 24000000;
+static unsigned int max_us = 2000;
+module_param(pio_phys, ulong, 0444);
+module_param(timer_phys, ulong, 0444);
+module_param(tick_hz, uint, 0444);
+module_param(max_us, uint, 0644);
+MODULE_PARM_DESC(max_us, "Longest interrupts-off playback in microseconds");
+
+static void __iomem *pio;
+static void __iomem *timer;
+static DEFINE_MUTEX(play_lock);
+static struct fagpio_kseq_op *ops;		//FAGPIO_KSEQ_MAX_OPS, under play_lock
+
+static int validate(const struct fagpio_kseq_op *op, u32 count, u32 start) {
+	u64 limit = (u64)max_us * tick_hz / 1000000;
+	u32 now = readl_relaxed(timer + AVS_CNT0);
+	u32 prev = 0, i;
+
+	for (i = 0; i < count; i++) {
+		u32 target = start + op[i].at;
+
+		if (op[i].port >= PIO_NPORTS || op[i].at < prev)
+			return -EINVAL;
+		// Unsigned both ways: a target 2^31 ticks ahead must not pass as past
+		if ((u32)(now - target) > limit && (u32)(target - now) > limit)
+			return -E2BIG;
+		prev = op[i].at;
+	}
+	return 0;
+}
+
+static u32 play(const struct fagpio_kseq_op *op, u32 count, u32 start) {
+	u32 cur[PIO_NPORTS], used = 0, late = 0, i;
+	unsigned long flags;
+
+	for (i = 0; i < count; i++)
+		used |= 1u << op[i].port;
+
+	local_irq_save(flags);
+	for (i = 0; i < PIO_NPORTS; i++) {
+		if (used & (1u << i))
+			cur[i] = readl_relaxed(pio + i * PIO_BANK_SIZE + PIO_DAT);
+	}
+	for (i = 0; i < count; i++) {
+		u32 target = start + op[i].at;
+
+		if ((s32)(readl_relaxed(timer + AVS_CNT0) - target) > 0)
+			late++;
+		else while ((s32)(readl_relaxed(timer + AVS_CNT0) - target) < 0)
+			;
+		cur[op[i].port] = (cur[op[i].port] & ~op[i].mask) | (op[i].value & op[i].mask);
+		writel_relaxed(cur[op[i].port], pio + op[i].port * PIO_BANK_SIZE + PIO_DAT);
+	}
+	local_irq_restore(flags);
+	return late;
+}
+
+static long kseq_ioctl(struct file *file, unsigned int cmd, unsigned long arg) {
+	struct fagpio_kseq_play req;
+	int ret;
+
+	if (cmd != FAGPIO_KSEQ_PLAY)
+		return -ENOTTY;
+	if (copy_from_user(&req, (void __user *)arg, sizeof(req)))
+		return -EFAULT;
+	if (req.count > FAGPIO_KSEQ_MAX_OPS)
+		return -E2BIG;
+	if (!(readl_relaxed(timer + AVS_CNT_CTL) & 1))
+		return -ENODEV;		//libfagpio has not started the counter
+
+	mutex_lock(&play_lock);
+	if (copy_from_user(ops, u64_to_user_ptr(req.ops), req.count * sizeof(*ops))) {
+		ret = -EFAULT;
+	} else if (!(ret = validate(ops, req.count, req.start))) {
+		req.late = play(ops, req.count, req.start);
+		if (copy_to_user((void __user *)arg, &req, sizeof(req)))
+			ret = -EFAULT;
+	}
+	mutex_unlock(&play_lock);
+	return ret;
+}
+
+static const struct file_operations kseq_fops = {
+	.owner = THIS_MODULE,
+	.unlocked_ioctl = kseq_ioctl,
+};
+
+static struct miscdevice kseq_dev = {
+	.minor = MISC_DYNAMIC_MINOR,
+	.name = "fagpio-seq",
+	.fops = &kseq_fops,
+	.mode = 0660,
+};
+
+static int __init kseq_init(void) {
+	int ret = -ENOMEM;
+
+	if (!tick_hz)
+		return -EINVAL;
+	ops = kmalloc_array(FAGPIO_KSEQ_MAX_OPS, sizeof(*ops), GFP_KERNEL);
+	pio = ioremap(pio_phys, PIO_NPORTS * PIO_BANK_SIZE);
+	timer = ioremap(timer_phys, 0x100);
+	if (ops && pio && timer && !(ret = misc_register(&kseq_dev)))
+		return 0;
+	if (timer)
+		iounmap(timer);
+	if (pio)
+		iounmap(pio);
+	kfree(ops);
+	return ret;
+}
+
+static void __exit kseq_exit(void) {
+	misc_deregister(&kseq_dev);
+	iounmap(timer);
+	iounmap(pio);
+	kfree(ops);
+}
+
+module_init(kseq_init);
+module_exit(kseq_exit);
+MODULE_DESCRIPTION("Interrupts-off playback of libfagpio sequencer timelines");
+MODULE_LICENSE("GPL");
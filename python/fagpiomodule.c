@@ -0,0 +1,374 @@
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include "fagpio.h"
+#include "fagpio_net.h"
+#include "fagpio_seq.h"
+#include "fagpio_seqfile.h"
+#include "fagpio_capture.h"
+#include "fagpio_pinname.h"
+#include "fagpio_timer.h"
+
+/*
+CPython binding. Single pin and port calls map one to one; the bulk calls
+take buffer-protocol objects (bytes, bytearray, array, numpy) laid out as
+the C structs, and run with the GIL released, so thousands of steps cost
+one Python call:
+
+	batch(ops)               ops: struct fagpio_net_op records (12 bytes),
+	                         run in order; returns the READ results as
+	                         uint32 bytes
+	seq_play(ops, start=0)   struct fagpio_seq_op records (16 bytes);
+	                         returns the number of late steps
+	seqfile_play(path)       a fagpio_seqfile.h file, in place
+	capture(port, mask, count, timeout_ticks=0)
+	                         bytes of struct fagpio_sample (ticks, value)
+	capture_into(port, mask, buf, timeout_ticks=0)
+	                         same into a writable buffer; returns entries
+
+Pins are numbers (PIO_PIN) or names such as "PE5".
+*/
+
+static int pin_arg(PyObject *obj, void *out) {
+	long pin;
+
+	if (PyUnicode_Check(obj)) {
+		const char *name = PyUnicode_AsUTF8(obj);
+
+		pin = name ? fagpio_pin_parse(name) : -1;
+		if (pin < 0) {
+			if (!PyErr_Occurred())
+				PyErr_Format(PyExc_ValueError, "unknown pin %R", obj);
+			return 0;
+		}
+	} else {
+		pin = PyLong_AsLong(obj);
+		if (pin == -1 && PyErr_Occurred())
+			return 0;
+		if (pin < 0 || pin > 0xFF) {
+			PyErr_SetString(PyExc_ValueError, "pin out of range");
+			return 0;
+		}
+	}
+	*(uint8_t *)out = (uint8_t)pin;
+	return 1;
+}
+
+static int ready(void) {
+	if (fagpio_setup() < 0) {
+		PyErr_SetString(PyExc_OSError, "cannot map the GPIO registers");
+		return 0;
+	}
+	return 1;
+}
+
+// Whole records only, at the struct's size
+static int get_records(PyObject *obj, Py_buffer *view, size_t size, int writable) {
+	if (PyObject_GetBuffer(obj, view, PyBUF_C_CONTIGUOUS | (writable ? PyBUF_WRITABLE : 0)) < 0)
+		return 0;
+	if (view->len % size) {
+		PyErr_Format(PyExc_ValueError, "buffer length is not a multiple of %zu", size);
+		PyBuffer_Release(view);
+		return 0;
+	}
+	return 1;
+}
+
+static PyObject *py_setup(PyObject *self, PyObject *args) {
+	if (!ready())
+		return NULL;
+	Py_RETURN_NONE;
+}
+
+static PyObject *py_free(PyObject *self, PyObject *args) {
+	fagpio_free();
+	Py_RETURN_NONE;
+}
+
+static PyObject *py_pin_mode(PyObject *self, PyObject *args) {
+	uint8_t pin, mode;
+
+	if (!PyArg_ParseTuple(args, "O&b", pin_arg, &pin, &mode) || !ready())
+		return NULL;
+	pinMode(pin, mode);
+	Py_RETURN_NONE;
+}
+
+static PyObject *py_pin_pull(PyObject *self, PyObject *args) {
+	uint8_t pin, pull;
+
+	if (!PyArg_ParseTuple(args, "O&b", pin_arg, &pin, &pull) || !ready())
+		return NULL;
+	pinPull(pin, pull);
+	Py_RETURN_NONE;
+}
+
+static PyObject *py_write(PyObject *self, PyObject *args) {
+	uint8_t pin;
+	int value;
+
+	if (!PyArg_ParseTuple(args, "O&p", pin_arg, &pin, &value) || !ready())
+		return NULL;
+	digitalWrite(pin, value);
+	Py_RETURN_NONE;
+}
+
+static PyObject *py_read(PyObject *self, PyObject *args) {
+	uint8_t pin;
+
+	if (!PyArg_ParseTuple(args, "O&", pin_arg, &pin) || !ready())
+		return NULL;
+	return PyLong_FromLong(digitalRead(pin));
+}
+
+static PyObject *py_port_mode(PyObject *self, PyObject *args) {
+	uint8_t port, mode;
+	unsigned int mask;
+
+	if (!PyArg_ParseTuple(args, "bIb", &port, &mask, &mode) || !ready())
+		return NULL;
+	pinModeMask(port, mask, mode);
+	Py_RETURN_NONE;
+}
+
+static PyObject *py_port_write(PyObject *self, PyObject *args) {
+	uint8_t port;
+	unsigned int mask, value;
+
+	if (!PyArg_ParseTuple(args, "bII", &port, &mask, &value) || !ready())
+		return NULL;
+	digitalWritePort(port, mask, value);
+	Py_RETURN_NONE;
+}
+
+static PyObject *py_port_toggle(PyObject *self, PyObject *args) {
+	uint8_t port;
+	unsigned int mask;
+
+	if (!PyArg_ParseTuple(args, "bI", &port, &mask) || !ready())
+		return NULL;
+	digitalTogglePort(port, mask);
+	Py_RETURN_NONE;
+}
+
+static PyObject *py_port_read(PyObject *self, PyObject *args) {
+	uint8_t port;
+
+	if (!PyArg_ParseTuple(args, "b", &port) || !ready())
+		return NULL;
+	return PyLong_FromUnsignedLong(digitalReadPort(port));
+}
+
+static PyObject *py_ticks(PyObject *self, PyObject *args) {
+	if (!ready())
+		return NULL;
+	return PyLong_FromUnsignedLong(fagpio_ticks());
+}
+
+static PyObject *py_tick_hz(PyObject *self, PyObject *args) {
+	if (!ready())
+		return NULL;
+	return PyLong_FromUnsignedLong(fagpio_tick_hz);
+}
+
+// Same op encoding as the UDP protocol, run in order without coalescing
+static unsigned int run_batch(const struct fagpio_net_op *ops, size_t n, uint32_t *reads) {
+	unsigned int nreads = 0;
+
+	for (size_t i = 0; i < n; i++) {
+		const struct fagpio_net_op *o = &ops[i];
+
+		switch (o->op) {
+		case FAGPIO_NET_WRITE:
+			digitalWritePort(o->port, o->mask, o->value);
+			break;
+		case FAGPIO_NET_TOGGLE:
+			digitalTogglePort(o->port, o->mask);
+			break;
+		case FAGPIO_NET_MODE:
+			pinModeMask(o->port, o->mask, o->arg);
+			break;
+		case FAGPIO_NET_PULL:
+			pinPullMask(o->port, o->mask, o->arg);
+			break;
+		case FAGPIO_NET_READ:
+			reads[nreads++] = digitalReadPort(o->port) & o->mask;
+			break;
+		}
+	}
+	return nreads;
+}
+
+static PyObject *py_batch(PyObject *self, PyObject *args) {
+	PyObject *obj, *out;
+	Py_buffer view;
+
+	if (!PyArg_ParseTuple(args, "O", &obj) || !ready())
+		return NULL;
+	if (!get_records(obj, &view, sizeof(struct fagpio_net_op), 0))
+		return NULL;
+
+	size_t n = view.len / sizeof(struct fagpio_net_op), nreads = 0;
+	const struct fagpio_net_op *ops = view.buf;
+
+	for (size_t i = 0; i < n; i++)
+		nreads += ops[i].op == FAGPIO_NET_READ;
+	if (!(out = PyBytes_FromStringAndSize(NULL, nreads * sizeof(uint32_t)))) {
+		PyBuffer_Release(&view);
+		return NULL;
+	}
+
+	uint32_t *reads = (uint32_t *)PyBytes_AS_STRING(out);
+
+	Py_BEGIN_ALLOW_THREADS
+	run_batch(ops, n, reads);
+	Py_END_ALLOW_THREADS
+	PyBuffer_Release(&view);
+	return out;
+}
+
+static PyObject *py_seq_play(PyObject *self, PyObject *args) {
+	PyObject *obj;
+	unsigned int start = 0;
+	Py_buffer view;
+	int late;
+
+	if (!PyArg_ParseTuple(args, "O|I", &obj, &start) || !ready())
+		return NULL;
+	if (!get_records(obj, &view, sizeof(struct fagpio_seq_op), 0))
+		return NULL;
+
+	const struct fagpio_seq_op *ops = view.buf;
+	size_t n = view.len / sizeof(*ops);
+
+	for (size_t i = 0; i < n; i++) {
+		if (ops[i].port >= PIO_NPORTS) {
+			PyBuffer_Release(&view);
+			return PyErr_Format(PyExc_ValueError, "op %zu: bad port", i);
+		}
+	}
+
+	Py_BEGIN_ALLOW_THREADS
+	late = fagpio_seq_play_ops(ops, n, start ? start : fagpio_ticks());
+	Py_END_ALLOW_THREADS
+	PyBuffer_Release(&view);
+	if (late < 0)
+		return PyErr_Format(PyExc_OSError, "sequencer failed");
+	return PyLong_FromLong(late);
+}
+
+static PyObject *py_seqfile_play(PyObject *self, PyObject *args) {
+	struct fagpio_seqfile f;
+	const char *path;
+	int ret;
+
+	if (!PyArg_ParseTuple(args, "s", &path) || !ready())
+		return NULL;
+	if (fagpio_seqfile_open(&f, path) < 0)
+		return PyErr_Format(PyExc_OSError, "%s: not a sequence file", path);
+
+	Py_BEGIN_ALLOW_THREADS
+	ret = fagpio_seqfile_play(&f);
+	Py_END_ALLOW_THREADS
+
+	unsigned int late = f.late;
+
+	fagpio_seqfile_close(&f);
+	if (ret < 0)
+		return PyErr_Format(PyExc_ValueError, "%s: bad record", path);
+	return PyLong_FromUnsignedLong(late);
+}
+
+static PyObject *py_capture(PyObject *self, PyObject *args) {
+	uint8_t port;
+	unsigned int mask, count, timeout = 0;
+	PyObject *out;
+	int n;
+
+	if (!PyArg_ParseTuple(args, "bII|I", &port, &mask, &count, &timeout) || !ready())
+		return NULL;
+	if (!count)
+		return PyErr_Format(PyExc_ValueError, "count must be positive");
+	if (!(out = PyBytes_FromStringAndSize(NULL, (Py_ssize_t)count * sizeof(struct fagpio_sample))))
+		return NULL;
+
+	struct fagpio_sample *buf = (struct fagpio_sample *)PyBytes_AS_STRING(out);
+
+	Py_BEGIN_ALLOW_THREADS
+	n = fagpio_capture_edges(port, mask, buf, count, timeout);
+	Py_END_ALLOW_THREADS
+	if (n < 0) {
+		Py_DECREF(out);
+		return PyErr_Format(PyExc_OSError, "capture failed");
+	}
+	if ((unsigned int)n < count)
+		_PyBytes_Resize(&out, n * sizeof(struct fagpio_sample));
+	return out;
+}
+
+static PyObject *py_capture_into(PyObject *self, PyObject *args) {
+	uint8_t port;
+	unsigned int mask, timeout = 0;
+	PyObject *obj;
+	Py_buffer view;
+	int n;
+
+	if (!PyArg_ParseTuple(args, "bIO|I", &port, &mask, &obj, &timeout) || !ready())
+		return NULL;
+	if (!get_records(obj, &view, sizeof(struct fagpio_sample), 1))
+		return NULL;
+	if (!view.len) {
+		PyBuffer_Release(&view);
+		return PyLong_FromLong(0);
+	}
+
+	Py_BEGIN_ALLOW_THREADS
+	n = fagpio_capture_edges(port, mask, view.buf, view.len / sizeof(struct fagpio_sample), timeout);
+	Py_END_ALLOW_THREADS
+	PyBuffer_Release(&view);
+	if (n < 0)
+		return PyErr_Format(PyExc_OSError, "capture failed");
+	return PyLong_FromLong(n);
+}
+
+static PyMethodDef methods[] = {
+	{ "setup", py_setup, METH_NOARGS, "Map the registers (done on first use)" },
+	{ "free", py_free, METH_NOARGS, "Unmap the registers" },
+	{ "pin_mode", py_pin_mode, METH_VARARGS, "pin_mode(pin, mode)" },
+	{ "pin_pull", py_pin_pull, METH_VARARGS, "pin_pull(pin, pull)" },
+	{ "write", py_write, METH_VARARGS, "write(pin, level)" },
+	{ "read", py_read, METH_VARARGS, "read(pin) -> 0 or 1" },
+	{ "port_mode", py_port_mode, METH_VARARGS, "port_mode(port, mask, mode)" },
+	{ "port_write", py_port_write, METH_VARARGS, "port_write(port, mask, value)" },
+	{ "port_toggle", py_port_toggle, METH_VARARGS, "port_toggle(port, mask)" },
+	{ "port_read", py_port_read, METH_VARARGS, "port_read(port) -> DAT" },
+	{ "ticks", py_ticks, METH_NOARGS, "AVS counter value" },
+	{ "tick_hz", py_tick_hz, METH_NOARGS, "Counter rate measured at setup" },
+	{ "batch", py_batch, METH_VARARGS, "batch(ops) -> bytes of uint32 READ results" },
+	{ "seq_play", py_seq_play, METH_VARARGS, "seq_play(ops, start=0) -> late steps" },
+	{ "seqfile_play", py_seqfile_play, METH_VARARGS, "seqfile_play(path) -> late steps" },
+	{ "capture", py_capture, METH_VARARGS, "capture(port, mask, count, timeout_ticks=0) -> bytes" },
+	{ "capture_into", py_capture_into, METH_VARARGS, "capture_into(port, mask, buf, timeout_ticks=0) -> entries" },
+	{ NULL, NULL, 0, NULL }
+};
+
+static struct PyModuleDef module = {
+	PyModuleDef_HEAD_INIT, "fagpio", "F1C100s GPIO through libfagpio", -1, methods,
+};
+
+PyMODINIT_FUNC PyInit_fagpio(void) {
+	PyObject *m = PyModule_Create(&module);
+
+	if (!m)
+		return NULL;
+	PyModule_AddIntConstant(m, "OUTPUT", OUTPUT);
+	PyModule_AddIntConstant(m, "INPUT", INPUT);
+	PyModule_AddIntConstant(m, "DISABLE", DISABLE);
+	PyModule_AddIntConstant(m, "PULL_UP", PULL_UP);
+	PyModule_AddIntConstant(m, "PULL_DOWN", PULL_DOWN);
+	PyModule_AddIntConstant(m, "OP_WRITE", FAGPIO_NET_WRITE);
+	PyModule_AddIntConstant(m, "OP_TOGGLE", FAGPIO_NET_TOGGLE);
+	PyModule_AddIntConstant(m, "OP_MODE", FAGPIO_NET_MODE);
+	PyModule_AddIntConstant(m, "OP_PULL", FAGPIO_NET_PULL);
+	PyModule_AddIntConstant(m, "OP_READ", FAGPIO_NET_READ);
+	return m;
+}
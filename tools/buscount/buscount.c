@@ -0,0 +1,292 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fagpio.h"
+#include "fagpio_sim.h"
+#include "fagpio_bbspi.h"
+#include "fagpio_bbi2c.h"
+#include "fagpio_onewire.h"
+#include "fagpio_shiftreg.h"
+#include "fagpio_suart.h"
+#include "fagpio_ws2812.h"
+#include "fagpio_dshot.h"
+#include "fagpio_lcd.h"
+
+/*
+Bus reads and writes of each API call, counted on the simulated PIO
+(FAGPIO_BACKEND=sim, see fagpio_sim.h). On the board every one of them
+is an uncached APB access.
+
+	buscount              prints "name reads writes" per call
+	buscount -c FILE      compares with such a listing, exit status 1
+	                      on any difference or call missing from it
+
+counts.txt is the listing of the known-good tree; make check compares
+against it and the default build of the library runs that check, so an
+extra access fails the build. The SPI, TWI and UART controllers are not
+counted: their registers lie outside the simulated window.
+*/
+
+#define PE(n)		PIO_PIN(PIO_PORT_E, n)
+#define PD(n)		PIO_PIN(PIO_PORT_D, n)
+
+struct bus_case {
+	const char *name;
+	void (*setup)(void);		//Not counted, may be NULL
+	void (*run)(void);
+};
+
+static struct fagpio_bbspi spi;
+static struct fagpio_bbi2c i2c;
+static struct fagpio_onewire ow;
+static struct fagpio_sr595 sr595;
+static struct fagpio_sr165 sr165;
+static uint8_t sr_storage[2 * 4], sr_bits[4];
+static struct fagpio_suart suart;
+static struct fagpio_seq_op suart_ops[10];
+static struct fagpio_ws2812 ws;
+static uint32_t ws_slots[24];
+static struct fagpio_dshot dshot;
+static struct fagpio_lcd lcd;
+
+static void outputs(void) {
+	fagpio_shadow_enable(0);
+	pinModeMask(PIO_PORT_E, 0xFF, OUTPUT);
+}
+
+static void shadowed(void) {
+	outputs();
+	fagpio_shadow_enable(1);
+}
+
+static void run_pin_mode(void) { pinMode(PE(3), OUTPUT); }
+static void run_pin_mode_mask(void) { pinModeMask(PIO_PORT_E, 0xFF, OUTPUT); }
+static void run_pin_pull(void) { pinPull(PE(4), PULL_UP); }
+static void run_write(void) { digitalWrite(PE(3), 1); }
+static void run_write_bit(void) { digitalWriteBit(PE(3), 1); }
+static void run_toggle(void) { digitalToggle(PE(3)); }
+static void run_read(void) { digitalRead(PE(3)); }
+static void run_write_port(void) { digitalWritePort(PIO_PORT_E, 0x0F, 0x05); }
+static void run_toggle_port(void) { digitalTogglePort(PIO_PORT_E, 0x0F); }
+static void run_read_port(void) { digitalReadPort(PIO_PORT_E); }
+
+static void run_bank_save(void) {
+	struct fagpio_bank_state st;
+
+	fagpio_bank_save(PIO_PORT_E, &st);
+}
+
+static void run_bank_restore(void) {
+	struct fagpio_bank_state st;
+
+	fagpio_shadow_enable(0);
+	fagpio_bank_save(PIO_PORT_E, &st);
+	fagpio_sim_log_reset();		//Only the restore
+	fagpio_bank_restore(PIO_PORT_E, &st);
+}
+
+static void setup_spi(void) {
+	fagpio_shadow_enable(0);
+	fagpio_bbspi_init(&spi, PE(0), PE(1), PE(2), 0, 0);
+}
+
+static void run_spi_byte(void) {
+	uint8_t tx = 0xA5, rx;
+
+	fagpio_bbspi_transfer(&spi, &tx, &rx, 1);
+}
+
+// Open-drain buses idle high through the pull-ups: the simulated slave drives them
+static void setup_i2c(void) {
+	fagpio_shadow_enable(0);
+	fagpio_bbi2c_init(&i2c, PE(5), PE(6), 400000, 1000);
+	fagpio_sim_input(PIO_PORT_E, PIO_PIN_MASK(PE(5)) | PIO_PIN_MASK(PE(6)), ~0u);
+}
+
+static void run_i2c_byte(void) {
+	uint8_t b = 0x5A;
+	struct fagpio_i2c_msg msg = { 0x50, 0, 1, &b };
+
+	fagpio_bbi2c_transfer(&i2c, &msg, 1);
+}
+
+static void setup_onewire(void) {
+	fagpio_shadow_enable(0);
+	fagpio_onewire_init(&ow, PE(7));
+	fagpio_sim_input(PIO_PORT_E, PIO_PIN_MASK(PE(7)), ~0u);
+}
+
+static void run_onewire_write(void) { fagpio_onewire_write(&ow, 0xCC); }
+static void run_onewire_read(void) { fagpio_onewire_read(&ow); }
+
+static void setup_sr595(void) {
+	fagpio_shadow_enable(0);
+	fagpio_sr595_init(&sr595, PE(0), PE(1), PE(8), 4, sr_storage, 0);
+	fagpio_sr595_set_byte(&sr595, 0, 0x81);
+}
+
+static void setup_sr595_sent(void) {
+	setup_sr595();
+	fagpio_sr595_commit(&sr595);
+}
+
+static void run_sr595_commit(void) { fagpio_sr595_commit(&sr595); }
+static void run_sr595_unchanged(void) { fagpio_sr595_commit_changed(&sr595); }
+
+static void setup_sr165(void) {
+	fagpio_shadow_enable(0);
+	fagpio_sr165_init(&sr165, PD(0), PD(1), PD(2), 4, 0);
+}
+
+static void run_sr165_read(void) { fagpio_sr165_read(&sr165, sr_bits); }
+
+static void setup_suart(void) {
+	fagpio_shadow_enable(0);
+	fagpio_suart_init(&suart, PE(9), PE(10), 115200, suart_ops, 10);
+}
+
+static void run_suart_byte(void) {
+	uint8_t b = 0x55;
+
+	fagpio_suart_write(&suart, &b, 1);
+}
+
+static void setup_ws2812(void) {
+	static const uint8_t grb[3] = { 0x12, 0x34, 0x56 };
+	const uint8_t *const strips[1] = { grb };
+
+	fagpio_shadow_enable(0);
+	fagpio_ws2812_init(&ws, PE(0), 1, ws_slots, 1);
+	fagpio_ws2812_compile(&ws, strips, 1);
+}
+
+static void run_ws2812_pixel(void) { fagpio_ws2812_show(&ws); }
+
+static void setup_dshot(void) {
+	uint16_t throttle = 1046;
+
+	fagpio_shadow_enable(0);
+	fagpio_dshot_init(&dshot, PE(0), 1, 600);
+	fagpio_dshot_compile(&dshot, &throttle, 0);
+}
+
+static void run_dshot_frame(void) { fagpio_dshot_send(&dshot); }
+
+static void setup_lcd(void) {
+	fagpio_shadow_enable(0);
+	fagpio_lcd_init(&lcd, PE(0), PE(8), PE(9), FAGPIO_LCD_NO_PIN, FAGPIO_LCD_8080, 0);
+}
+
+static void run_lcd_byte(void) {
+	uint8_t b = 0xA5;
+
+	fagpio_lcd_data(&lcd, &b, 1);
+}
+
+static void run_lcd_command(void) { fagpio_lcd_command(&lcd, 0x2C); }
+
+static const struct bus_case cases[] = {
+	{ "pinMode",				NULL,			run_pin_mode },
+	{ "pinModeMask",			NULL,			run_pin_mode_mask },
+	{ "pinPull",				NULL,			run_pin_pull },
+	{ "digitalWrite",			outputs,		run_write },
+	{ "digitalWrite/shadow",	shadowed,		run_write },
+	{ "digitalWriteBit",		outputs,		run_write_bit },
+	{ "digitalToggle",			outputs,		run_toggle },
+	{ "digitalToggle/shadow",	shadowed,		run_toggle },
+	{ "digitalRead",			outputs,		run_read },
+	{ "digitalWritePort",		outputs,		run_write_port },
+	{ "digitalWritePort/shadow", shadowed,		run_write_port },
+	{ "digitalTogglePort",		outputs,		run_toggle_port },
+	{ "digitalReadPort",		outputs,		run_read_port },
+	{ "fagpio_bank_save",		outputs,		run_bank_save },
+	{ "fagpio_bank_restore",	outputs,		run_bank_restore },
+	{ "bbspi/byte",				setup_spi,		run_spi_byte },
+	{ "bbi2c/byte",				setup_i2c,		run_i2c_byte },
+	{ "onewire/write",			setup_onewire,	run_onewire_write },
+	{ "onewire/read",			setup_onewire,	run_onewire_read },
+	{ "sr595/commit",			setup_sr595,	run_sr595_commit },
+	{ "sr595/unchanged",		setup_sr595_sent,	run_sr595_unchanged },
+	{ "sr165/read",				setup_sr165,	run_sr165_read },
+	{ "suart/byte",				setup_suart,	run_suart_byte },
+	{ "ws2812/pixel",			setup_ws2812,	run_ws2812_pixel },
+	{ "dshot/frame",			setup_dshot,	run_dshot_frame },
+	{ "lcd/byte",				setup_lcd,		run_lcd_byte },
+	{ "lcd/command",			setup_lcd,		run_lcd_command },
+};
+
+#define NCASES		(sizeof(cases) / sizeof(cases[0]))
+
+static void measure(const struct bus_case *c, struct fagpio_sim_counts *counts) {
+	if (c->setup)
+		c->setup();
+	fagpio_sim_log_reset();
+	c->run();
+	fagpio_sim_counts(counts);
+}
+
+static int compare(const char *path, const struct fagpio_sim_counts *got) {
+	FILE *f = fopen(path, "r");
+	char line[128], name[64];
+	unsigned int reads, writes;
+	uint8_t seen[NCASES] = { 0 };
+	int status = 0;
+
+	if (!f) {
+		perror(path);
+		return 1;
+	}
+	while (fgets(line, sizeof(line), f)) {
+		if (line[0] == '#' || sscanf(line, "%63s %u %u", name, &reads, &writes) != 3)
+			continue;
+
+		unsigned int i;
+
+		for (i = 0; i < NCASES && strcmp(cases[i].name, name); i++)
+			;
+		if (i == NCASES) {
+			printf("%s: no longer measured\n", name);
+			status = 1;
+			continue;
+		}
+		seen[i] = 1;
+		if (got[i].reads != reads || got[i].writes != writes) {
+			printf("%s: %u reads %u writes, was %u %u\n", name, got[i].reads, got[i].writes, reads, writes);
+			status = 1;
+		}
+	}
+	fclose(f);
+	for (unsigned int i = 0; i < NCASES; i++) {
+		if (!seen[i]) {
+			printf("%s: not in %s\n", cases[i].name, path);
+			status = 1;
+		}
+	}
+	return status;
+}
+
+int main(int argc, char **argv) {
+	struct fagpio_sim_counts got[NCASES];
+
+	if (argc != 1 && (argc != 3 || strcmp(argv[1], "-c"))) {
+		fprintf(stderr, "usage: buscount [-c FILE]\n");
+		return 2;
+	}
+	if (!getenv("FAGPIO_BACKEND"))
+		setenv("FAGPIO_BACKEND", "sim", 0);
+	if (fagpio_setup() < 0 || fagpio_handle_backend(fagpio_default()) != FAGPIO_BACKEND_SIM || !fagpio_sim_trapping()) {
+		fprintf(stderr, "buscount: needs the trapping simulated PIO (libfagpio_sim.so on x86)\n");
+		return 2;
+	}
+
+	for (unsigned int i = 0; i < NCASES; i++)
+		measure(&cases[i], &got[i]);
+	fagpio_free();
+
+	if (argc == 3)
+		return compare(argv[2], got);
+	printf("# call reads writes\n");
+	for (unsigned int i = 0; i < NCASES; i++)
+		printf("%-24s %4u %4u\n", cases[i].name, got[i].reads, got[i].writes);
+	return 0;
+}
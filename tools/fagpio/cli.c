@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "fagpio.h"
+#include "fagpio_pinname.h"
+
+/*
+Shell access to the GPIOs, one mapping per run.
+
+	fagpio set PIN 0|1        fagpio toggle PIN
+	fagpio get PIN            fagpio mode PIN in|out|off
+	fagpio pull PIN up|down|none
+	fagpio write PORT MASK VALUE    fagpio read PORT
+	fagpio --batch < script
+
+Several commands may follow each other on one command line, separated by
+"--". --batch reads one command per line from stdin (plus "sleep US";
+'#' starts a comment) against the same mapping, so a script toggling
+hundreds of pins pays the startup once. get and read print one line each.
+PIN is a name such as PE5, PORT a letter or number, MASK and VALUE C
+integers. A bad line is reported with its number and skipped; the exit
+status is then 1.
+*/
+
+#define MAX_ARGS	8
+
+static int parse_port(const char *s) {
+	char *end;
+	long port;
+
+	if (((*s >= 'A' && *s <= 'Z') || (*s >= 'a' && *s <= 'z')) && !s[1])
+		port = (*s | 0x20) - 'a';
+	else if ((port = strtol(s, &end, 0)) < 0 || *end || end == s)
+		return -1;
+	return port < PIO_NPORTS ? port : -1;
+}
+
+static int parse_u32(const char *s, uint32_t *out) {
+	char *end;
+
+	*out = strtoul(s, &end, 0);
+	return *end || end == s ? -1 : 0;
+}
+
+// 0 on success; a message for the caller to report otherwise
+static const char *run(int argc, char **argv) {
+	const char *cmd = argv[0];
+	int pin = argc > 1 ? fagpio_pin_parse(argv[1]) : -1;
+	uint32_t mask, value;
+
+	if (!strcmp(cmd, "set") || !strcmp(cmd, "get") || !strcmp(cmd, "toggle") || !strcmp(cmd, "mode") || !strcmp(cmd, "pull")) {
+		if (pin < 0)
+			return "no such pin";
+	}
+
+	if (!strcmp(cmd, "set")) {
+		if (argc != 3 || (strcmp(argv[2], "0") && strcmp(argv[2], "1")))
+			return "usage: set PIN 0|1";
+		digitalWrite(pin, argv[2][0] - '0');
+	} else if (!strcmp(cmd, "get")) {
+		printf("%u\n", digitalRead(pin));
+	} else if (!strcmp(cmd, "toggle")) {
+		digitalToggle(pin);
+	} else if (!strcmp(cmd, "mode")) {
+		if (argc != 3)
+			return "usage: mode PIN in|out|off";
+		if (!strcmp(argv[2], "out"))
+			pinMode(pin, OUTPUT);
+		else if (!strcmp(argv[2], "in"))
+			pinMode(pin, INPUT);
+		else if (!strcmp(argv[2], "off"))
+			pinMode(pin, DISABLE);
+		else
+			return "usage: mode PIN in|out|off";
+	} else if (!strcmp(cmd, "pull")) {
+		if (argc != 3)
+			return "usage: pull PIN up|down|none";
+		if (!strcmp(argv[2], "up"))
+			pinPull(pin, PULL_UP);
+		else if (!strcmp(argv[2], "down"))
+			pinPull(pin, PULL_DOWN);
+		else if (!strcmp(argv[2], "none"))
+			pinPull(pin, PULL_NONE);
+		else
+			return "usage: pull PIN up|down|none";
+	} else if (!strcmp(cmd, "write")) {
+		int port = argc == 4 ? parse_port(argv[1]) : -1;
+
+		if (port < 0 || parse_u32(argv[2], &mask) < 0 || parse_u32(argv[3], &value) < 0)
+			return "usage: write PORT MASK VALUE";
+		digitalWritePort(port, mask, value);
+	} else if (!strcmp(cmd, "read")) {
+		int port = argc == 2 ? parse_port(argv[1]) : -1;
+
+		if (port < 0)
+			return "usage: read PORT";
+		printf("0x%08x\n", digitalReadPort(port));
+	} else if (!strcmp(cmd, "sleep")) {
+		if (argc != 2 || parse_u32(argv[1], &value) < 0)
+			return "usage: sleep US";
+		usleep(value);
+	} else {
+		return "unknown command";
+	}
+	return NULL;
+}
+
+static int batch(void) {
+	char line[256];
+	unsigned int n = 0;
+	int status = 0;
+
+	setvbuf(stdout, NULL, _IOLBF, 0);		//Readers of get/read see each answer at once
+	while (fgets(line, sizeof(line), stdin)) {
+		char *argv[MAX_ARGS], *save, *tok;
+		int argc = 0;
+
+		n++;
+		if ((tok = strchr(line, '#')))
+			*tok = 0;
+		for (tok = strtok_r(line, " \t\r\n", &save); tok && argc < MAX_ARGS; tok = strtok_r(NULL, " \t\r\n", &save))
+			argv[argc++] = tok;
+		if (!argc)
+			continue;
+
+		const char *err = run(argc, argv);
+
+		if (err) {
+			fprintf(stderr, "fagpio: line %u: %s\n", n, err);
+			status = 1;
+		}
+	}
+	return status;
+}
+
+int main(int argc, char **argv) {
+	int status = 0;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: fagpio set|get|toggle|mode|pull|write|read ... [-- ...] | --batch\n");
+		return 1;
+	}
+	if (fagpio_setup() < 0) {
+		fprintf(stderr, "fagpio: cannot map the GPIO registers\n");
+		return 1;
+	}
+
+	if (!strcmp(argv[1], "--batch")) {
+		status = batch();
+	} else {
+		for (int i = 1; i < argc; ) {
+			int n = 0;
+
+			while (i + n < argc && strcmp(argv[i + n], "--"))
+				n++;
+			if (n) {
+				const char *err = run(n, &argv[i]);
+
+				if (err) {
+					fprintf(stderr, "fagpio: %s: %s\n", argv[i], err);
+					status = 1;
+					break;
+				}
+			}
+			i += n + 1;
+		}
+	}
+
+	fagpio_free();
+	return status;
+}
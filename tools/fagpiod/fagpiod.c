@@ -0,0 +1,64 @@
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include "fagpio.h"
+#include "fagpio_daemon.h"
+#include "fagpio_net.h"
+#include "fagpio_rt.h"
+
+/*
+Owns the GPIO mapping for clients that connect with fagpiod_connect().
+
+	fagpiod [segment-name [mode [prio [udp-port]]]]
+
+mode is the octal permission of the /dev/shm segment, e.g. 0660 together
+with a gpio group, and decides who may drive the GPIOs. A non-zero prio
+runs the daemon SCHED_FIFO with locked memory. A udp-port also serves the
+remote protocol of fagpio_net.h on that port, from a second thread; it
+is unauthenticated, so bind it to a trusted network only.
+*/
+
+static volatile int stop;
+static uint16_t udp_port;
+
+static void *net_thread(void *arg) {
+	(void)arg;
+	if (fagpio_net_serve(udp_port, &stop) < 0)
+		fprintf(stderr, "fagpiod: remote protocol not served\n");
+	return NULL;
+}
+
+static void on_signal(int sig) {
+	(void)sig;
+	stop = 1;
+}
+
+int main(int argc, char **argv) {
+	const char *name = argc > 1 ? argv[1] : FAGPIOD_SHM_NAME;
+	mode_t mode = argc > 2 ? (mode_t)strtoul(argv[2], NULL, 8) : 0600;
+	int prio = argc > 3 ? atoi(argv[3]) : 0;
+	pthread_t net;
+
+	if (fagpio_setup() < 0) {
+		fprintf(stderr, "fagpiod: cannot map the GPIO registers\n");
+		return 1;
+	}
+	if (prio && fagpio_rt_enter(prio) < 0)
+		fprintf(stderr, "fagpiod: real-time setup incomplete\n");
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	udp_port = argc > 4 ? (uint16_t)atoi(argv[4]) : 0;
+	if (udp_port && pthread_create(&net, NULL, net_thread, NULL) != 0)
+		udp_port = 0;
+	int ret = fagpiod_serve(name, mode, &stop);
+
+	stop = 1;
+	if (udp_port)
+		pthread_join(net, NULL);
+	if (ret < 0)
+		return 1;
+
+	fagpio_free();
+	return 0;
+}
@@ -0,0 +1,112 @@
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "fagpio_stats.h"
+
+/*
+Prints the operation counters of processes running with FAGPIO_STATS set
+(fagpio_stats.h). The pages are only mapped read-only, the processes are
+not slowed down.
+
+	fagpiostat [pid [top]]
+
+Without a pid every live process is listed. Per port: calls and the time
+spent in them; then the top (default 10) pins by operations.
+*/
+
+#define SHM_DIR		"/dev/shm"
+
+static void show(const struct fagpio_stats *s, unsigned int top) {
+	static const struct fagpio_stats_pin zero;
+	uint8_t shown[FAGPIO_STATS_NPORTS * 32] = { 0 };
+
+	printf("pid %u\n  port     writes      reads      modes    time_us\n", s->pid);
+	for (int port = 0; port < FAGPIO_STATS_NPORTS; port++) {
+		const struct fagpio_stats_port *p = &s->port[port];
+
+		if (!p->writes && !p->reads && !p->modes)
+			continue;
+		printf("  P%c  %10u %10u %10u %10llu\n", 'A' + port, p->writes, p->reads, p->modes,
+			(unsigned long long)(s->tick_hz ? p->ticks * 1000000 / s->tick_hz : 0));
+	}
+	printf("  pin      writes      reads      modes\n");
+	for (unsigned int n = 0; n < top; n++) {
+		const struct fagpio_stats_pin *best = &zero;
+		int pin = -1;
+
+		for (int i = 0; i < FAGPIO_STATS_NPORTS * 32; i++) {
+			const struct fagpio_stats_pin *q = &s->pin[i];
+
+			if (!shown[i] && (uint64_t)q->writes + q->reads + q->modes > (uint64_t)best->writes + best->reads + best->modes) {
+				best = q;
+				pin = i;
+			}
+		}
+		if (pin < 0)
+			break;
+		shown[pin] = 1;
+		printf("  P%c%-2d %10u %10u %10u\n", 'A' + pin / 32, pin % 32, best->writes, best->reads, best->modes);
+	}
+}
+
+static int show_file(const char *name, int pid, unsigned int top) {
+	char path[300];
+	int fd;
+
+	snprintf(path, sizeof(path), SHM_DIR "/%s", name);
+	if ((fd = open(path, O_RDONLY)) < 0) {
+		perror(path);
+		return -1;
+	}
+
+	const struct fagpio_stats *s = mmap(NULL, sizeof(*s), PROT_READ, MAP_SHARED, fd, 0);
+
+	close(fd);
+	if (s == MAP_FAILED) {
+		perror(path);
+		return -1;
+	}
+	if (s->magic != FAGPIO_STATS_MAGIC)
+		fprintf(stderr, "%s: not a fagpio stats page\n", path);
+	else if (!pid && kill(s->pid, 0) < 0 && errno == ESRCH)
+		printf("pid %u exited, remove %s\n", s->pid, path);
+	else
+		show(s, top);
+	munmap((void *)s, sizeof(*s));
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	int pid = argc > 1 ? atoi(argv[1]) : 0;
+	unsigned int top = argc > 2 ? strtoul(argv[2], NULL, 0) : 10;
+	const char *prefix = FAGPIO_STATS_PREFIX + 1;		//Names under /dev/shm have no slash
+	char name[64];
+
+	if (pid) {
+		snprintf(name, sizeof(name), "%s%d", prefix, pid);
+		return show_file(name, pid, top) < 0;
+	}
+
+	DIR *dir = opendir(SHM_DIR);
+	struct dirent *e;
+	int found = 0;
+
+	if (!dir) {
+		perror(SHM_DIR);
+		return 1;
+	}
+	while ((e = readdir(dir))) {
+		if (!strncmp(e->d_name, prefix, strlen(prefix)) && show_file(e->d_name, 0, top) == 0)
+			found++;
+	}
+	closedir(dir);
+	if (!found)
+		printf("no process runs with FAGPIO_STATS set\n");
+	return 0;
+}
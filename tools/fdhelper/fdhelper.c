@@ -0,0 +1,41 @@
+#include <stdio.h>
+#include <sys/stat.h>
+#include "fagpio.h"
+#include "fagpio_fdpass.h"
+
+/*
+Keeps /dev/mem open and hands the fd to libfagpio clients started with
+FAGPIO_FD_SOCKET set (empty value means the default socket).
+
+	fagpio-fdhelper [socket-path [mode]]
+
+mode is the octal permission of the socket, e.g. 0660 together with a
+group. Whoever may connect gets /dev/mem itself, with access to all of
+physical memory: the same as root, not just the GPIOs.
+*/
+
+int main(int argc, char **argv) {
+	if (argc > 3) {
+		fprintf(stderr, "usage: %s [socket-path [mode]]\n"
+			"Hands an open /dev/mem fd to every client of the socket: access to all\n"
+			"of physical memory, the same as root. Default mode 0600.\n", argv[0]);
+		return 1;
+	}
+
+	const char *path = argc > 1 ? argv[1] : FAGPIO_FD_SOCKET;
+	mode_t mode = argc > 2 ? (mode_t)strtoul(argv[2], NULL, 8) : 0600;
+	int fd = open("/dev/mem", O_RDWR|O_SYNC);
+
+	if (fd < 0) {
+		perror("/dev/mem");
+		return 1;
+	}
+
+	umask(~mode & 0777);
+	if (fagpio_fd_serve(path, fd) < 0) {
+		perror(path);
+		return 1;
+	}
+
+	return 0;
+}
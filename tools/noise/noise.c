@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "fagpio.h"
+#include "fagpio_inline.h"
+#include "fagpio_rt.h"
+#include "fagpio_timer.h"
+
+/*
+Kernel noise on the target. Spins on the hardware counter under SCHED_FIFO
+for the given time, toggling PE3 on every pass so a scope shows the same
+gaps, and records every pass that took longer than the threshold: that is
+time the CPU spent in the tick, interrupts, RCU callbacks or anything else
+the kernel ran instead. The summary gives how often gaps occur, how long
+they last, the spacing between them (a steady spacing is the timer tick)
+and, for each window length, the share of start times at which a window
+of that length would be hit by a gap: the failure rate of software
+timing for a transfer that long.
+
+	noise [-d seconds] [-t threshold_us] [-p prio] [-w window_us]... [-o gaps.csv]
+
+-o writes every gap as at_us,gap_us for plotting.
+RT throttling stops SCHED_FIFO spinners for 50 ms every second; run with
+`sysctl kernel.sched_rt_runtime_us=-1` unless that is what you measure.
+*/
+
+#define OUT_PIN			PIO_PIN(PIO_PORT_E, 3)
+#define MAX_GAPS		(256 * 1024)
+#define MAX_WINDOWS		8
+#define NBUCKETS		8		//Doubling from the threshold up
+
+struct gap {
+	uint64_t at;		//Ticks from the start
+	uint32_t len;
+};
+
+static struct gap *gaps;
+static unsigned int ngaps, lost;
+
+static int cmp_u32(const void *a, const void *b) {
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static double us(uint64_t ticks) {
+	return ticks * 1e6 / fagpio_tick_hz;
+}
+
+// Ticks of the timeline [0, total - w) at which a window of w ticks overlaps a gap
+static uint64_t disturbed(uint64_t total, uint64_t w) {
+	uint64_t hit = 0, from = 0, to = 0, end = total > w ? total - w : 0;
+
+	for (unsigned int i = 0; i < ngaps; i++) {
+		uint64_t a = gaps[i].at > w ? gaps[i].at - w : 0, b = gaps[i].at + gaps[i].len;
+
+		if (b > end)
+			b = end;
+		if (a >= b)
+			continue;
+		if (a > to) {
+			hit += to - from;
+			from = a;
+		}
+		if (b > to)
+			to = b;
+	}
+	return hit + (to - from);
+}
+
+static uint64_t spin(struct pio_bank *banks, uint64_t total, uint32_t threshold, uint32_t *fastest) {
+	uint64_t elapsed = 0;
+	uint32_t last = fagpio_ticks(), best = ~0u;
+	uint8_t level = 0;
+
+	while (elapsed < total) {
+		uint32_t t = fagpio_ticks(), d = t - last;
+
+		last = t;
+		elapsed += d;
+		if (d < best)
+			best = d;
+		if (d > threshold) {
+			if (ngaps < MAX_GAPS) {
+				gaps[ngaps].at = elapsed - d;
+				gaps[ngaps].len = d;
+				ngaps++;
+			} else {
+				lost++;
+			}
+		}
+		digitalWriteFast(banks, OUT_PIN, level ^= 1);
+	}
+	*fastest = best;
+	return elapsed;
+}
+
+static void summary(uint64_t total, uint32_t threshold, uint32_t fastest, const uint32_t *windows, unsigned int nwindows) {
+	uint32_t *v = malloc((ngaps ? ngaps : 1) * sizeof(*v));
+	unsigned int bucket[NBUCKETS] = { 0 };
+	uint64_t sum = 0;
+
+	printf("%.1f s, fastest pass %.2f us, threshold %.1f us\n", us(total) / 1e6, us(fastest), us(threshold));
+	printf("gaps: %u (%.1f/s)%s\n", ngaps + lost, (ngaps + lost) * 1e6 / us(total), lost ? ", recording full" : "");
+	if (!ngaps || !v) {
+		free(v);
+		return;
+	}
+
+	for (unsigned int i = 0; i < ngaps; i++) {
+		unsigned int b = 0;
+
+		v[i] = gaps[i].len;
+		sum += v[i];
+		while (b < NBUCKETS - 1 && v[i] >= (uint64_t)threshold << (b + 1))
+			b++;
+		bucket[b]++;
+	}
+	qsort(v, ngaps, sizeof(*v), cmp_u32);
+	printf("length us: median %.1f, p99 %.1f, max %.1f; %.3f%% of the time lost\n",
+		us(v[ngaps / 2]), us(v[(ngaps * 99 + 99) / 100 - 1]), us(v[ngaps - 1]), 100.0 * sum / total);
+	for (unsigned int b = 0; b < NBUCKETS; b++) {
+		if (b < NBUCKETS - 1)
+			printf("  %8.1f - %8.1f us: %u\n", us((uint64_t)threshold << b), us((uint64_t)threshold << (b + 1)), bucket[b]);
+		else
+			printf("  %8.1f us and up:   %u\n", us((uint64_t)threshold << b), bucket[b]);
+	}
+
+	if (ngaps > 1) {
+		for (unsigned int i = 1; i < ngaps; i++)
+			v[i - 1] = gaps[i].at - gaps[i - 1].at > ~0u ? ~0u : gaps[i].at - gaps[i - 1].at;
+		qsort(v, ngaps - 1, sizeof(*v), cmp_u32);
+		printf("spacing: median %.1f us (%.1f Hz)\n", us(v[(ngaps - 1) / 2]), 1e6 / us(v[(ngaps - 1) / 2]));
+	}
+	for (unsigned int i = 0; i < nwindows; i++) {
+		uint64_t w = (uint64_t)windows[i] * fagpio_tick_hz / 1000000;
+
+		printf("window %6u us: %.3f%% of starts hit\n", windows[i], total > w ? 100.0 * disturbed(total, w) / (total - w) : 100.0);
+	}
+	free(v);
+}
+
+int main(int argc, char **argv) {
+	uint32_t windows[MAX_WINDOWS];
+	unsigned int nwindows = 0;
+	double seconds = 10, threshold_us = 10;
+	int prio = 90, c;
+	const char *out = NULL;
+
+	while ((c = getopt(argc, argv, "d:t:p:w:o:")) != -1) {
+		switch (c) {
+		case 'd': seconds = atof(optarg); break;
+		case 't': threshold_us = atof(optarg); break;
+		case 'p': prio = atoi(optarg); break;
+		case 'w':
+			if (nwindows < MAX_WINDOWS)
+				windows[nwindows++] = atoi(optarg);
+			break;
+		case 'o': out = optarg; break;
+		default:
+			fprintf(stderr, "usage: %s [-d seconds] [-t threshold_us] [-p prio] [-w window_us]... [-o gaps.csv]\n", argv[0]);
+			return 2;
+		}
+	}
+	if (!nwindows) {
+		windows[nwindows++] = 100;
+		windows[nwindows++] = 1000;
+		windows[nwindows++] = 10000;
+	}
+
+	// Allocated and touched before the pages are locked, so recording never faults
+	if (!(gaps = malloc(MAX_GAPS * sizeof(*gaps))))
+		return 1;
+	memset(gaps, 0, MAX_GAPS * sizeof(*gaps));
+	if (fagpio_rt_enter(prio) < 0)
+		fprintf(stderr, "not fully real time: gaps include preemption\n");
+
+	struct pio_bank *banks = fagpio_banks();
+
+	if (!banks || !fagpio_counter) {
+		fprintf(stderr, "needs the register mapping: run as root on the board\n");
+		return 1;
+	}
+	pinMode(OUT_PIN, OUTPUT);
+
+	uint32_t threshold = fagpio_ns_to_ticks(threshold_us * 1000), fastest;
+	uint64_t total = spin(banks, (uint64_t)(seconds * fagpio_tick_hz), threshold, &fastest);
+
+	summary(total, threshold, fastest, windows, nwindows);
+
+	if (out) {
+		FILE *f = fopen(out, "w");
+
+		if (!f) {
+			perror(out);
+			return 1;
+		}
+		fprintf(f, "at_us,gap_us\n");
+		for (unsigned int i = 0; i < ngaps; i++)
+			fprintf(f, "%.1f,%.1f\n", us(gaps[i].at), us(gaps[i].len));
+		fclose(f);
+	}
+	fagpio_free();
+	return 0;
+}
@@ -0,0 +1,117 @@
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "fagpio.h"
+#include "fagpio_pinmap.h"
+
+/*
+Early-boot pin setup: applies a compiled pin map (tools/pinmap) straight
+to the PIO registers, then optionally executes the real init.
+
+	pininit MAP [PROGRAM [ARGS...]]
+
+e.g. rdinit=/sbin/pininit on the kernel command line with
+/sbin/pininit /etc/board.bin /sbin/init in a wrapper, or as the first
+line of an init script. One mmap() of the map, one of /dev/mem, and for
+every register word the map owns bits of: one load (none if it owns the
+whole word) and one store, DAT, DRV and PULL before CFG, so outputs come
+up at their level. No stdio, no library setup, no timer calibration;
+build static (the Makefile does) so nothing is loaded either.
+*/
+
+static void say(const char *a, const char *b) {
+	write(2, "pininit: ", 9);
+	write(2, a, strlen(a));
+	if (b) {
+		write(2, ": ", 2);
+		write(2, b, strlen(b));
+	}
+	write(2, "\n", 1);
+}
+
+static void store(volatile uint32_t *reg, uint32_t value, uint32_t mask) {
+	if (mask == ~0u)
+		*reg = value;
+	else if (mask)
+		*reg = (*reg & ~mask) | (value & mask);
+}
+
+static int apply(const void *blob, size_t size, struct pio_bank *banks) {
+	const struct fagpio_pinmap_header *hdr = blob;
+	const struct fagpio_pinmap_port *rec = (const void *)(hdr + 1);
+
+	if (size < sizeof(*hdr) || hdr->magic != FAGPIO_PINMAP_MAGIC || hdr->version != FAGPIO_PINMAP_VERSION)
+		return -1;
+	if (size < sizeof(*hdr) + hdr->nports * sizeof(*rec))
+		return -1;
+
+	for (unsigned int i = 0; i < hdr->nports; i++, rec++) {
+		if (rec->port >= PIO_NPORTS)
+			return -1;
+
+		struct pio_bank *b = &banks[rec->port];
+
+		store(&b->dat, rec->dat, rec->dat_mask);
+		for (unsigned int w = 0; w < 2; w++) {
+			store(&b->drv[w], rec->drv[w], rec->drv_mask[w]);
+			store(&b->pull[w], rec->pull[w], rec->pull_mask[w]);
+		}
+		for (unsigned int w = 0; w < 4; w++)
+			store(&b->cfg[w], rec->cfg[w], rec->cfg_mask[w]);
+	}
+	return 0;
+}
+
+static int run(const char *path) {
+	struct stat st;
+	int fd = open(path, O_RDONLY);
+
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		say(path, "cannot open");
+		return -1;
+	}
+
+	void *blob = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	close(fd);
+	if (blob == MAP_FAILED) {
+		say(path, "cannot map");
+		return -1;
+	}
+
+	int mem = open("/dev/mem", O_RDWR | O_SYNC);
+	void *map = mem < 0 ? MAP_FAILED : mmap(NULL, BLOCK_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, mem, GPIO_PAGE_OFFSET);
+
+	if (map == MAP_FAILED) {
+		say("/dev/mem", "cannot map the PIO");
+		return -1;
+	}
+
+	int ret = apply(blob, st.st_size, (struct pio_bank *)((unsigned char *)map + GPIO_BASE_OFFSET));
+
+	if (ret < 0)
+		say(path, "not a fagpio pin map");
+	munmap(map, BLOCK_SIZE);
+	close(mem);
+	munmap(blob, st.st_size);
+	return ret;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		say("usage: pininit MAP [PROGRAM [ARGS...]]", NULL);
+		return 2;
+	}
+
+	int ret = run(argv[1]);
+
+	// The next stage starts whatever happened: a bad map must not stop the boot
+	if (argc > 2) {
+		execv(argv[2], &argv[2]);
+		say(argv[2], "cannot execute");
+		return 127;
+	}
+	return ret < 0;
+}
@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fagpio_pinname.h"
+#include "fagpio_pinmap.h"
+
+/*
+Compiles a board pin map (format in fagpio_pinmap.h) to the binary that
+fagpio_pinmap_load() and FAGPIO_PINMAP apply. Options a line leaves out
+keep the register bits of that pin untouched.
+
+	pinmap board.txt board.bin
+*/
+
+static struct fagpio_pinmap_port ports[PIO_NPORTS];
+static uint32_t seen[PIO_NPORTS];
+
+static int parse_mode(const char *s) {
+	char *end;
+	long fn;
+
+	if (!strcmp(s, "input"))
+		return 0;
+	if (!strcmp(s, "output"))
+		return 1;
+	if (!strcmp(s, "disable"))
+		return 7;
+	if (strncmp(s, "func", 4))
+		return -1;
+	fn = strtol(s + 4, &end, 10);
+	return *end || end == s + 4 || fn < 2 || fn > 7 ? -1 : fn;
+}
+
+static int parse_option(struct fagpio_pinmap_port *rec, unsigned int n, const char *opt) {
+	const char *v = strchr(opt, '=');
+	unsigned int w = n >> 4, shift = (n & 15) * 2;
+	long level;
+
+	if (!v)
+		return -1;
+	v++;
+	if (!strncmp(opt, "pull=", 5)) {
+		if (!strcmp(v, "none"))
+			level = PULL_NONE;
+		else if (!strcmp(v, "up"))
+			level = PULL_UP;
+		else if (!strcmp(v, "down"))
+			level = PULL_DOWN;
+		else
+			return -1;
+		rec->pull[w] |= level << shift;
+		rec->pull_mask[w] |= 3u << shift;
+	} else if (!strncmp(opt, "drive=", 6)) {
+		if (v[0] < '0' || v[0] > '3' || v[1])
+			return -1;
+		rec->drv[w] |= (uint32_t)(v[0] - '0') << shift;
+		rec->drv_mask[w] |= 3u << shift;
+	} else if (!strncmp(opt, "value=", 6)) {
+		if (!strcmp(v, "1") || !strcmp(v, "high"))
+			rec->dat |= 1u << n;
+		else if (strcmp(v, "0") && strcmp(v, "low"))
+			return -1;
+		rec->dat_mask |= 1u << n;
+	} else {
+		return -1;
+	}
+	return 0;
+}
+
+static int parse_line(char *line, const char *file, int lineno) {
+	char *tok[8], *p, *hash = strchr(line, '#');
+	int ntok = 0, pin, mode;
+	unsigned int port, n;
+
+	if (hash)
+		*hash = '\0';
+	for (p = strtok(line, " \t\r\n"); p && ntok < 8; p = strtok(NULL, " \t\r\n"))
+		tok[ntok++] = p;
+	if (!ntok)
+		return 0;
+
+	if (ntok < 2 || (pin = fagpio_pin_parse_n(tok[0], strlen(tok[0]))) < 0 || (mode = parse_mode(tok[1])) < 0) {
+		fprintf(stderr, "%s:%d: expected <pin> <input|output|disable|funcN> [options]\n", file, lineno);
+		return -1;
+	}
+	port = PIO_PIN_PORT(pin);
+	n = PIO_PIN_NUM(pin);
+	if (seen[port] & (1u << n)) {
+		fprintf(stderr, "%s:%d: %s listed twice\n", file, lineno, tok[0]);
+		return -1;
+	}
+	seen[port] |= 1u << n;
+
+	ports[port].cfg[n >> 3] |= (uint32_t)mode << ((n & 7) * 4);
+	ports[port].cfg_mask[n >> 3] |= 15u << ((n & 7) * 4);
+	for (int i = 2; i < ntok; i++) {
+		if (parse_option(&ports[port], n, tok[i]) < 0) {
+			fprintf(stderr, "%s:%d: bad option %s (pull=none|up|down, drive=0-3, value=0|1)\n", file, lineno, tok[i]);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	struct fagpio_pinmap_header hdr = { FAGPIO_PINMAP_MAGIC, FAGPIO_PINMAP_VERSION, 0 };
+	char line[256];
+	int lineno = 0, pins = 0;
+	FILE *in, *out;
+
+	if (argc != 3) {
+		fprintf(stderr, "usage: %s board.txt board.bin\n", argv[0]);
+		return 1;
+	}
+	if (!(in = fopen(argv[1], "r"))) {
+		perror(argv[1]);
+		return 1;
+	}
+	while (fgets(line, sizeof(line), in))
+		if (parse_line(line, argv[1], ++lineno) < 0)
+			return 1;
+	fclose(in);
+
+	for (unsigned int p = 0; p < PIO_NPORTS; p++) {
+		ports[p].port = p;
+		if (seen[p])
+			hdr.nports++;
+		pins += __builtin_popcount(seen[p]);
+	}
+	if (!(out = fopen(argv[2], "wb"))) {
+		perror(argv[2]);
+		return 1;
+	}
+	fwrite(&hdr, sizeof(hdr), 1, out);
+	for (unsigned int p = 0; p < PIO_NPORTS; p++)
+		if (seen[p])
+			fwrite(&ports[p], sizeof(ports[p]), 1, out);
+	if (fclose(out)) {
+		perror(argv[2]);
+		return 1;
+	}
+	fprintf(stderr, "%d pins on %u ports, %zu bytes\n", pins, hdr.nports, sizeof(hdr) + hdr.nports * sizeof(ports[0]));
+	return 0;
+}
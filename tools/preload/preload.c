@@ -0,0 +1,249 @@
+#define _GNU_SOURCE		//RTLD_NEXT
+#include <dlfcn.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "fagpio.h"
+#include "fagpio_pinname.h"
+#include "fagpio_timer.h"
+#include "fagpio_trace.h"
+
+/*
+Traces the pin calls of a program linked against libfagpio.so without
+rebuilding it:
+
+	LD_PRELOAD=/rom/work/libfagpio_preload.so ./app
+
+At load it starts the trace ring (fagpio_trace.h), so every digitalWrite,
+digitalRead and pinMode is recorded by the library with its counter value,
+and wraps the three calls to count them per pin and time them on the same
+counter. Calls the library's own drivers make through them count too;
+inline fagpio_inline.h paths compiled into the program are not seen.
+Every period a line goes to the report fd:
+
+	preload: 5000 ms: writes 120004/s 180 ns, reads 10/s 240 ns, modes 0/s; hot PE3 120000/s PE4 4/s
+
+and at exit the totals, with the ring saved for tools/trace2vcd or
+tools/trace2json. Set in the environment:
+
+	FAGPIO_PRELOAD_RECORDS	ring size, default 65536, 0 counts only
+	FAGPIO_PRELOAD_DUMP		file for the ring at exit, default /tmp/fagpio-trace.PID
+	FAGPIO_PRELOAD_PERIOD	seconds between reports, default 5, 0 only at exit
+	FAGPIO_PRELOAD_TOP		hot pins per report, default 5
+	FAGPIO_PRELOAD_FD		report fd, default 2
+
+The counters are plain increments: concurrent threads may lose counts, as
+with FAGPIO_STATS.
+*/
+
+#define NPINS		256
+#define DEF_RECORDS	65536
+#define DEF_PERIOD	5
+#define DEF_TOP		5
+#define MAX_TOP		16		//Keeps a report within its line
+
+enum { OP_WRITE, OP_READ, OP_MODE, NOPS };
+
+struct counts {
+	uint32_t pin[NOPS][NPINS];
+	uint64_t calls[NOPS];
+	uint64_t ticks[NOPS];
+};
+
+static void (*real_write)(uint8_t, uint8_t);
+static uint8_t (*real_read)(uint8_t);
+static void (*real_mode)(uint8_t, uint8_t);
+
+static struct counts now, last;
+static int report_fd = 2;
+static unsigned int period, top = DEF_TOP;
+static char dump_path[64];
+static pthread_t reporter;
+static pthread_mutex_t wake_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+static int stopping, reporting, tracing;
+
+static unsigned int env_num(const char *name, unsigned int def) {
+	const char *s = getenv(name);
+
+	return s && *s ? (unsigned int)strtoul(s, NULL, 0) : def;
+}
+
+static void resolve(void) {
+	real_write = (void (*)(uint8_t, uint8_t))dlsym(RTLD_NEXT, "digitalWrite");
+	real_read = (uint8_t (*)(uint8_t))dlsym(RTLD_NEXT, "digitalRead");
+	real_mode = (void (*)(uint8_t, uint8_t))dlsym(RTLD_NEXT, "pinMode");
+}
+
+static inline void count(int op, uint8_t pin, uint32_t start) {
+	now.pin[op][pin]++;
+	now.calls[op]++;
+	now.ticks[op] += fagpio_ticks() - start;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+	uint32_t start = fagpio_ticks();
+
+	if (!real_write)
+		resolve();
+	real_write(pin, value);
+	count(OP_WRITE, pin, start);
+}
+
+uint8_t digitalRead(uint8_t pin) {
+	uint32_t start = fagpio_ticks();
+
+	if (!real_read)
+		resolve();
+
+	uint8_t v = real_read(pin);
+
+	count(OP_READ, pin, start);
+	return v;
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+	uint32_t start = fagpio_ticks();
+
+	if (!real_mode)
+		resolve();
+	real_mode(pin, mode);
+	count(OP_MODE, pin, start);
+}
+
+static uint64_t mono_ms(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Average ns per call over ticks; before setup the counter is the coarse clock in ns
+static unsigned long per_call_ns(uint64_t ticks, uint64_t calls) {
+	if (!calls)
+		return 0;
+	if (!fagpio_tick_hz)
+		return ticks / calls;
+	return ticks * 1000000000ull / fagpio_tick_hz / calls;
+}
+
+// The calls since *prev, over ms; prev is brought up to snap
+static void report(const struct counts *snap, struct counts *prev, uint64_t ms, const char *what) {
+	static const char *const names[NOPS] = { "writes", "reads", "modes" };
+	uint8_t shown[NPINS] = { 0 };
+	char line[512];
+	int n = snprintf(line, sizeof(line), "preload: %s%llu ms:", what, (unsigned long long)ms);
+
+	if (!ms)
+		ms = 1;
+	for (int op = 0; op < NOPS; op++) {
+		uint64_t calls = snap->calls[op] - prev->calls[op];
+
+		n += snprintf(line + n, sizeof(line) - n, "%s %s %llu/s", op ? "," : "", names[op],
+			(unsigned long long)(calls * 1000 / ms));
+		if (calls)
+			n += snprintf(line + n, sizeof(line) - n, " %lu ns", per_call_ns(snap->ticks[op] - prev->ticks[op], calls));
+	}
+	for (unsigned int k = 0; k < top; k++) {
+		uint32_t best = 0;
+		int pin = -1;
+
+		for (int i = 0; i < NPINS; i++) {
+			uint32_t d = 0;
+
+			for (int op = 0; op < NOPS; op++)
+				d += snap->pin[op][i] - prev->pin[op][i];
+			if (!shown[i] && d > best) {
+				best = d;
+				pin = i;
+			}
+		}
+		if (pin < 0)
+			break;
+		shown[pin] = 1;
+
+		char name[12];
+
+		if (!fagpio_pin_name(pin, name))
+			snprintf(name, sizeof(name), "%d", pin);
+		n += snprintf(line + n, sizeof(line) - n, "%s %s %llu/s", k ? "" : "; hot", name,
+			(unsigned long long)best * 1000 / ms);
+	}
+	n += snprintf(line + n, sizeof(line) - n, "\n");
+	if (write(report_fd, line, n) < 0) {
+		//Nothing to tell it with
+	}
+	*prev = *snap;
+}
+
+static void *report_loop(void *arg) {
+	uint64_t t0 = mono_ms();
+
+	(void)arg;
+	pthread_mutex_lock(&wake_lock);
+	while (!stopping) {
+		struct timespec until;
+
+		clock_gettime(CLOCK_REALTIME, &until);
+		until.tv_sec += period;
+		if (pthread_cond_timedwait(&wake, &wake_lock, &until) == 0 || stopping)
+			continue;
+
+		uint64_t t = mono_ms();
+		struct counts snap = now;
+
+		report(&snap, &last, t - t0, "");
+		t0 = t;
+	}
+	pthread_mutex_unlock(&wake_lock);
+	return NULL;
+}
+
+static uint64_t start_ms;
+
+__attribute__((constructor)) static void preload_init(void) {
+	unsigned int records = env_num("FAGPIO_PRELOAD_RECORDS", DEF_RECORDS);
+	const char *dump = getenv("FAGPIO_PRELOAD_DUMP");
+
+	resolve();
+	report_fd = env_num("FAGPIO_PRELOAD_FD", 2);
+	period = env_num("FAGPIO_PRELOAD_PERIOD", DEF_PERIOD);
+	top = env_num("FAGPIO_PRELOAD_TOP", DEF_TOP);
+	if (top > MAX_TOP)
+		top = MAX_TOP;
+	if (dump && *dump)
+		snprintf(dump_path, sizeof(dump_path), "%s", dump);
+	else
+		snprintf(dump_path, sizeof(dump_path), "/tmp/fagpio-trace.%d", (int)getpid());
+	if (records && fagpio_trace_start(records) == 0)
+		tracing = 1;
+	else if (records)
+		dprintf(report_fd, "preload: no trace ring of %u records\n", records);
+	start_ms = mono_ms();
+	if (period && pthread_create(&reporter, NULL, report_loop, NULL) == 0)
+		reporting = 1;
+}
+
+__attribute__((destructor)) static void preload_exit(void) {
+	static struct counts zero;
+	struct counts snap;
+
+	if (reporting) {
+		pthread_mutex_lock(&wake_lock);
+		stopping = 1;
+		pthread_cond_signal(&wake);
+		pthread_mutex_unlock(&wake_lock);
+		pthread_join(reporter, NULL);
+	}
+	snap = now;
+	report(&snap, &zero, mono_ms() - start_ms, "total ");
+	if (!tracing)
+		return;
+	fagpio_trace_stop();
+	if (fagpio_trace_dump(dump_path) < 0)
+		dprintf(report_fd, "preload: could not save the trace to %s\n", dump_path);
+	else
+		dprintf(report_fd, "preload: trace saved to %s\n", dump_path);
+}
@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include "fagpio.h"
+#include "fagpio_pinname.h"
+#include "fagpio_rt.h"
+
+/*
+OpenOCD remote_bitbang server: JTAG and SWD for an attached MCU on the
+board's pins, driven by OpenOCD on the host over TCP.
+
+	remote_bitbang -c PE0 -m PE1 [-i PE2 -o PE3] [-t PE4] [-r PE5] [-l PE6] [-p port] [-P prio]
+
+-c is TCK/SWCLK, -m TMS/SWDIO, -i TDI and -o TDO (JTAG only), -t TRST and
+-r SRST (active low), -l a LED for OpenOCD's blink commands. TCK, TMS and
+TDI must share a port, so each clock edge is one port store. The default
+port is 3335. On the host:
+
+	adapter driver remote_bitbang
+	remote_bitbang host 192.168.1.100
+	remote_bitbang port 3335
+	transport select swd
+	source [find target/stm32f1x.cfg]
+
+Commands are taken a whole TCP segment at a time and the replies to its
+reads go back in one write, with TCP_NODELAY, so the speed is set by how
+many reads OpenOCD batches per round trip rather than by the pins.
+-P enters SCHED_FIFO at that priority (fagpio_rt.h).
+*/
+
+#define DEFAULT_PORT	3335
+#define NO_PIN			0xFF
+#define BUF_SIZE		4096
+
+static uint8_t tck = NO_PIN, tms = NO_PIN, tdi = NO_PIN, tdo = NO_PIN, trst = NO_PIN, srst = NO_PIN, led = NO_PIN;
+static uint8_t port;
+static uint32_t mask, level[8];		//level[v] for command '0' + v: TCK 4, TMS 2, TDI 1
+
+static int parse_pin(const char *name, uint8_t *pin) {
+	int p = fagpio_pin_parse(name);
+
+	if (p < 0) {
+		fprintf(stderr, "no such pin: %s\n", name);
+		return -1;
+	}
+	*pin = p;
+	return 0;
+}
+
+static int setup_pins(void) {
+	if (tck == NO_PIN || tms == NO_PIN || PIO_PIN_PORT(tms) != PIO_PIN_PORT(tck) || (tdi != NO_PIN && PIO_PIN_PORT(tdi) != PIO_PIN_PORT(tck))) {
+		fprintf(stderr, "TCK and TMS are needed, and TCK, TMS and TDI must share a port\n");
+		return -1;
+	}
+	port = PIO_PIN_PORT(tck);
+	mask = PIO_PIN_MASK(tck) | PIO_PIN_MASK(tms) | (tdi != NO_PIN ? PIO_PIN_MASK(tdi) : 0);
+	for (unsigned int v = 0; v < 8; v++)
+		level[v] = ((v & 4) ? PIO_PIN_MASK(tck) : 0) | ((v & 2) ? PIO_PIN_MASK(tms) : 0) | ((v & 1) && tdi != NO_PIN ? PIO_PIN_MASK(tdi) : 0);
+
+	digitalWritePort(port, mask, level[2]);		//TCK low, TMS high
+	pinMode(tck, OUTPUT);
+	pinMode(tms, OUTPUT);
+	pinPull(tms, PULL_UP);		//Also SWDIO, input during turnarounds
+	if (tdi != NO_PIN)
+		pinMode(tdi, OUTPUT);
+	if (tdo != NO_PIN) {
+		pinMode(tdo, INPUT);
+		pinPull(tdo, PULL_UP);
+	}
+	if (trst != NO_PIN) {
+		digitalWrite(trst, HIGH);
+		pinMode(trst, OUTPUT);
+	}
+	if (srst != NO_PIN) {
+		digitalWrite(srst, HIGH);
+		pinMode(srst, OUTPUT);
+	}
+	if (led != NO_PIN)
+		pinMode(led, OUTPUT);
+	return 0;
+}
+
+static char read_pin(uint8_t pin) {
+	return pin != NO_PIN && (digitalReadPort(PIO_PIN_PORT(pin)) & PIO_PIN_MASK(pin)) ? '1' : '0';
+}
+
+// Replies go into out; 1 once OpenOCD sent Q
+static int run(const char *cmd, size_t len, char *out, size_t *nout) {
+	for (size_t i = 0; i < len; i++) {
+		char c = cmd[i];
+
+		switch (c) {
+		case '0' ... '7':
+			digitalWritePort(port, mask, level[c - '0']);
+			break;
+		case 'R':
+			out[(*nout)++] = read_pin(tdo);
+			break;
+		case 'c':
+			out[(*nout)++] = read_pin(tms);
+			break;
+		case 'd' ... 'g':		//SWCLK 2, SWDIO 1
+			digitalWritePort(port, mask, level[(((c - 'd') & 2) << 1) | (((c - 'd') & 1) << 1)]);
+			break;
+		case 'O':
+			pinMode(tms, OUTPUT);
+			break;
+		case 'o':
+			pinMode(tms, INPUT);
+			break;
+		case 'r' ... 'u':		//TRST 2, SRST 1, 1 asserts
+			if (trst != NO_PIN)
+				digitalWrite(trst, !((c - 'r') & 2));
+			if (srst != NO_PIN)
+				digitalWrite(srst, !((c - 'r') & 1));
+			break;
+		case 'B':
+		case 'b':
+			if (led != NO_PIN)
+				digitalWrite(led, c == 'B');
+			break;
+		case 'Q':
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void serve(int fd) {
+	char in[BUF_SIZE], out[BUF_SIZE];
+	ssize_t n;
+	int quit = 0;
+
+	while (!quit && (n = read(fd, in, sizeof(in))) > 0) {
+		size_t nout = 0;
+
+		quit = run(in, n, out, &nout);
+		if (nout && write(fd, out, nout) != (ssize_t)nout)
+			break;
+	}
+}
+
+int main(int argc, char **argv) {
+	struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_ANY) };
+	int tcp_port = DEFAULT_PORT, prio = 0, one = 1, c, sock;
+
+	while ((c = getopt(argc, argv, "c:m:i:o:t:r:l:p:P:")) != -1) {
+		int ret = 0;
+
+		switch (c) {
+		case 'c': ret = parse_pin(optarg, &tck); break;
+		case 'm': ret = parse_pin(optarg, &tms); break;
+		case 'i': ret = parse_pin(optarg, &tdi); break;
+		case 'o': ret = parse_pin(optarg, &tdo); break;
+		case 't': ret = parse_pin(optarg, &trst); break;
+		case 'r': ret = parse_pin(optarg, &srst); break;
+		case 'l': ret = parse_pin(optarg, &led); break;
+		case 'p': tcp_port = atoi(optarg); break;
+		case 'P': prio = atoi(optarg); break;
+		default:
+			ret = -1;
+		}
+		if (ret < 0) {
+			fprintf(stderr, "usage: %s -c TCK -m TMS [-i TDI -o TDO] [-t TRST] [-r SRST] [-l LED] [-p port] [-P prio]\n", argv[0]);
+			return 2;
+		}
+	}
+	if (!fagpio_banks()) {
+		fprintf(stderr, "needs the register mapping: run as root on the board\n");
+		return 1;
+	}
+	if (setup_pins() < 0)
+		return 2;
+	if (prio && fagpio_rt_enter(prio) < 0)
+		fprintf(stderr, "not real time\n");
+
+	signal(SIGPIPE, SIG_IGN);
+	addr.sin_port = htons(tcp_port);
+	if ((sock = socket(AF_INET, SOCK_STREAM, 0)) < 0 || setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0 ||
+		bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(sock, 1) < 0) {
+		perror("listen");
+		return 1;
+	}
+	fprintf(stderr, "remote_bitbang on port %d\n", tcp_port);
+
+	for (;;) {
+		int fd = accept(sock, NULL, NULL);
+
+		if (fd < 0)
+			continue;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		serve(fd);
+		close(fd);
+		digitalWritePort(port, mask, level[2]);
+		pinMode(tms, OUTPUT);
+		fprintf(stderr, "client gone\n");
+	}
+}
@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fagpio.h"
+#include "fagpio_trace.h"
+
+/*
+Converts a fagpio_trace_dump() file into Chrome trace event JSON for
+Perfetto (ui.perfetto.dev) or chrome://tracing. Every traced pin gets a
+counter track with its level (writes and sampled inputs) and a thread
+track with its reads and mode changes as instant events. An optional
+fagpio_loop_dump() capture (the text a SIGUSR1 dump prints) adds one
+global event per loop histogram, with its bins as arguments.
+
+	trace2json trace.bin [loops.txt] > trace.json
+
+Timestamps are the AVS counter in microseconds from the first record,
+32-bit wraps unwrapped, as in trace2vcd.
+*/
+
+#define NPINS	(PIO_NPORTS * 32)
+
+// pinMode() modes as the trace records them
+static const char *mode_name(unsigned int mode) {
+	static const char *names[] = { "output", "input", "disable" };
+
+	return mode < 3 ? names[mode] : "other";
+}
+
+static void pin_name(char *s, int pin) {
+	sprintf(s, "P%c%d", 'A' + pin / 32, pin % 32);
+}
+
+static void print_ts(uint64_t ns) {
+	printf("%llu.%03u", (unsigned long long)(ns / 1000), (unsigned int)(ns % 1000));
+}
+
+// One "name: periods N min A max B ticks at H Hz" line, then its "  2^k count" lines
+static void loops(FILE *f, uint64_t end_ns) {
+	char line[256], name[64];
+	unsigned int count, min, max, hz = 0;
+	int open = 0;
+
+	while (fgets(line, sizeof(line), f)) {
+		unsigned int bin, n;
+
+		if (sscanf(line, "%63[^:]: periods %u min %u max %u ticks at %u Hz", name, &count, &min, &max, &hz) == 5 && hz) {
+			if (open)
+				printf("}}");
+			printf(",\n{\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0,\"name\":\"loop %s\",\"ts\":", name);
+			print_ts(end_ns);
+			printf(",\"args\":{\"periods\":%u,\"min_us\":%.3f,\"max_us\":%.3f", count, min * 1e6 / hz, max * 1e6 / hz);
+			open = 1;
+		} else if (open && sscanf(line, " 2^%u %u", &bin, &n) == 2) {
+			printf(",\"2^%u ticks\":%u", bin, n);
+		}
+	}
+	if (open)
+		printf("}}");
+}
+
+int main(int argc, char **argv) {
+	struct fagpio_trace_file hdr;
+	struct fagpio_trace_rec *recs;
+	uint8_t used[NPINS] = { 0 };
+	char name[8];
+	FILE *f;
+
+	if (argc != 2 && argc != 3) {
+		fprintf(stderr, "usage: %s trace.bin [loops.txt] > trace.json\n", argv[0]);
+		return 1;
+	}
+	if (!(f = fopen(argv[1], "rb"))) {
+		perror(argv[1]);
+		return 1;
+	}
+	if (fread(&hdr, sizeof(hdr), 1, f) != 1 || hdr.magic != FAGPIO_TRACE_MAGIC || !hdr.tick_hz) {
+		fprintf(stderr, "%s: not a fagpio trace\n", argv[1]);
+		return 1;
+	}
+	if (!(recs = calloc(hdr.count ? hdr.count : 1, sizeof(*recs))) || fread(recs, sizeof(*recs), hdr.count, f) != hdr.count) {
+		fprintf(stderr, "%s: truncated\n", argv[1]);
+		return 1;
+	}
+	fclose(f);
+
+	for (uint32_t i = 0; i < hdr.count; i++) {
+		if (recs[i].pin < NPINS)
+			used[recs[i].pin] = 1;
+	}
+
+	printf("{\"displayTimeUnit\":\"ns\",\"otherData\":{\"records\":%u,\"dropped\":%u,\"tick_hz\":%u},\"traceEvents\":[",
+		hdr.count, hdr.dropped, hdr.tick_hz);
+	printf("\n{\"ph\":\"M\",\"pid\":1,\"name\":\"process_name\",\"args\":{\"name\":\"fagpio\"}}");
+	for (int pin = 0; pin < NPINS; pin++) {
+		if (!used[pin])
+			continue;
+		pin_name(name, pin);
+		printf(",\n{\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":\"%s\"}}", pin + 1, name);
+	}
+
+	uint64_t t = 0, ns = 0;
+
+	for (uint32_t i = 0; i < hdr.count; i++) {
+		const struct fagpio_trace_rec *r = &recs[i];
+
+		if (i)
+			t += r->ticks - recs[i - 1].ticks;
+		ns = t * 1000000000ull / hdr.tick_hz;
+		if (r->pin >= NPINS)
+			continue;
+		pin_name(name, r->pin);
+
+		switch (r->op) {
+		case FAGPIO_TRACE_WRITE:
+		case FAGPIO_TRACE_INPUT:
+			printf(",\n{\"ph\":\"C\",\"pid\":1,\"name\":\"%s\",\"ts\":", name);
+			print_ts(ns);
+			printf(",\"args\":{\"level\":%d}}", r->value ? 1 : 0);
+			break;
+		case FAGPIO_TRACE_READ:
+			printf(",\n{\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%d,\"name\":\"read %d\",\"ts\":", r->pin + 1, r->value ? 1 : 0);
+			print_ts(ns);
+			printf("}");
+			break;
+		case FAGPIO_TRACE_MODE:
+			printf(",\n{\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%d,\"name\":\"mode %s\",\"ts\":", r->pin + 1, mode_name(r->value));
+			print_ts(ns);
+			printf("}");
+			break;
+		}
+	}
+
+	if (argc == 3) {
+		if (!(f = fopen(argv[2], "r"))) {
+			perror(argv[2]);
+			return 1;
+		}
+		loops(f, ns);
+		fclose(f);
+	}
+	printf("\n]}\n");
+
+	free(recs);
+	return 0;
+}
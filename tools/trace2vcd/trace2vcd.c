@@ -0,0 +1,89 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fagpio.h"
+#include "fagpio_trace.h"
+
+/*
+Converts a fagpio_trace_dump() file into a VCD. Every traced pin gets a
+level wire (last value written, read or sampled) and a 4-bit mode register.
+Timestamps are the AVS counter converted to ns; 32-bit wraps are
+unwrapped.
+
+	trace2vcd trace.bin > trace.vcd
+*/
+
+#define NPINS	(PIO_NPORTS * 32)
+
+static void vcd_id(char *id, int pin, int mode) {
+	sprintf(id, "%c%c", '!' + pin % 90, '!' + pin / 90 + (mode ? 3 : 0));
+}
+
+int main(int argc, char **argv) {
+	struct fagpio_trace_file hdr;
+	struct fagpio_trace_rec *recs;
+	uint8_t used[NPINS] = { 0 };
+	char id[4];
+	FILE *f;
+
+	if (argc != 2) {
+		fprintf(stderr, "usage: %s trace.bin > trace.vcd\n", argv[0]);
+		return 1;
+	}
+	if (!(f = fopen(argv[1], "rb"))) {
+		perror(argv[1]);
+		return 1;
+	}
+	if (fread(&hdr, sizeof(hdr), 1, f) != 1 || hdr.magic != FAGPIO_TRACE_MAGIC || !hdr.tick_hz) {
+		fprintf(stderr, "%s: not a fagpio trace\n", argv[1]);
+		return 1;
+	}
+	if (!(recs = calloc(hdr.count ? hdr.count : 1, sizeof(*recs))) || fread(recs, sizeof(*recs), hdr.count, f) != hdr.count) {
+		fprintf(stderr, "%s: truncated\n", argv[1]);
+		return 1;
+	}
+	fclose(f);
+
+	for (uint32_t i = 0; i < hdr.count; i++) {
+		if (recs[i].pin < NPINS)
+			used[recs[i].pin] = 1;
+	}
+
+	printf("$comment fagpio trace, %u records, %u dropped $end\n", hdr.count, hdr.dropped);
+	printf("$timescale 1ns $end\n$scope module fagpio $end\n");
+	for (int pin = 0; pin < NPINS; pin++) {
+		if (!used[pin])
+			continue;
+		vcd_id(id, pin, 0);
+		printf("$var wire 1 %s P%c%d $end\n", id, 'A' + pin / 32, pin % 32);
+		vcd_id(id, pin, 1);
+		printf("$var reg 4 %s P%c%d_mode $end\n", id, 'A' + pin / 32, pin % 32);
+	}
+	printf("$upscope $end\n$enddefinitions $end\n");
+
+	uint64_t t = 0;
+	uint64_t last = UINT64_MAX;
+
+	for (uint32_t i = 0; i < hdr.count; i++) {
+		const struct fagpio_trace_rec *r = &recs[i];
+		uint64_t ns;
+
+		if (i)
+			t += r->ticks - recs[i - 1].ticks;
+		if (r->pin >= NPINS)
+			continue;
+		ns = t * 1000000000ull / hdr.tick_hz;
+		if (ns != last)
+			printf("#%llu\n", (unsigned long long)ns);
+		last = ns;
+
+		vcd_id(id, r->pin, r->op == FAGPIO_TRACE_MODE);
+		if (r->op == FAGPIO_TRACE_MODE)
+			printf("b%d%d%d%d %s\n", (r->value >> 3) & 1, (r->value >> 2) & 1, (r->value >> 1) & 1, r->value & 1, id);
+		else
+			printf("%d%s\n", r->value ? 1 : 0, id);
+	}
+
+	free(recs);
+	return 0;
+}